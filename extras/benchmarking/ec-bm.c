@@ -0,0 +1,165 @@
+/*
+  Copyright (c) 2010 Gluster, Inc. <http://www.gluster.com>
+  This file is part of GlusterFS.
+
+  GlusterFS is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Affero General Public License as published
+  by the Free Software Foundation; either version 3 of the License,
+  or (at your option) any later version.
+
+  GlusterFS is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Affero General Public License for more details.
+
+  You should have received a copy of the GNU Affero General Public License
+  along with this program.  If not, see
+  <http://www.gnu.org/licenses/>.
+*/
+
+/* ec-bm: encode/decode throughput of the erasure coded stripe mode.
+ *
+ * usage: ec-bm [-k data] [-m parity] [-b fragment-size] [-n iterations]
+ *
+ * For every region multiply the CPU supports, encodes 'n' stripes, then
+ * rebuilds the first 'm' data fragments from the rest, checks the result
+ * against the original data and prints the throughput in MB/s of data.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "stripe-ec.h"
+
+static double
+now (void)
+{
+        struct timeval tv;
+
+        gettimeofday (&tv, NULL);
+        return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static int
+run (const char *impl, int k, int m, size_t bs, int iterations)
+{
+        unsigned char  *frags[STRIPE_EC_MAX_FRAGMENTS];
+        unsigned char  *orig[STRIPE_EC_MAX_FRAGMENTS];
+        int             valid[STRIPE_EC_MAX_FRAGMENTS];
+        double          start = 0;
+        double          enc = 0;
+        double          dec = 0;
+        double          mb = 0;
+        int             ret = -1;
+        int             i = 0;
+        int             n = 0;
+
+        if (stripe_ec_set_impl (impl))
+                return 0;
+
+        for (i = 0; i < k + m; i++) {
+                frags[i] = malloc (bs);
+                orig[i]  = malloc (bs);
+                if (!frags[i] || !orig[i]) {
+                        fprintf (stderr, "out of memory\n");
+                        return -1;
+                }
+        }
+        for (i = 0; i < k; i++) {
+                for (n = 0; n < bs; n++)
+                        frags[i][n] = random ();
+                memcpy (orig[i], frags[i], bs);
+        }
+
+        start = now ();
+        for (n = 0; n < iterations; n++)
+                stripe_ec_encode (k, m, bs, frags, frags + k);
+        enc = now () - start;
+
+        for (i = 0; i < k + m; i++)
+                valid[i] = (i >= m);
+
+        start = now ();
+        for (n = 0; n < iterations; n++) {
+                /* really lose them, or a decode which does not write them
+                   back would still pass the check below */
+                for (i = 0; i < m; i++)
+                        memset (frags[i], 0, bs);
+
+                if (stripe_ec_decode (k, m, bs, frags, valid)) {
+                        fprintf (stderr, "%s: decode failed\n", impl);
+                        goto out;
+                }
+        }
+        dec = now () - start;
+
+        for (i = 0; i < k; i++) {
+                if (memcmp (frags[i], orig[i], bs)) {
+                        fprintf (stderr, "%s: fragment %d mismatch\n",
+                                 impl, i);
+                        goto out;
+                }
+        }
+
+        mb = (double)k * bs * iterations / (1024 * 1024);
+        printf ("%-8s k=%d m=%d fragment=%zu: encode %8.1f MB/s, "
+                "decode (%d lost) %8.1f MB/s\n", impl, k, m, bs,
+                mb / enc, m, mb / dec);
+        ret = 0;
+out:
+        for (i = 0; i < k + m; i++) {
+                free (frags[i]);
+                free (orig[i]);
+        }
+        return ret;
+}
+
+int
+main (int argc, char *argv[])
+{
+        int    k = 4;
+        int    m = 2;
+        int    iterations = 1000;
+        size_t bs = 128 * 1024;
+        int    ret = 0;
+        int    c = 0;
+
+        while ((c = getopt (argc, argv, "k:m:b:n:")) != -1) {
+                switch (c) {
+                case 'k':
+                        k = atoi (optarg);
+                        break;
+                case 'm':
+                        m = atoi (optarg);
+                        break;
+                case 'b':
+                        bs = strtoul (optarg, NULL, 0);
+                        break;
+                case 'n':
+                        iterations = atoi (optarg);
+                        break;
+                default:
+                        fprintf (stderr, "usage: %s [-k data] [-m parity] "
+                                 "[-b fragment-size] [-n iterations]\n",
+                                 argv[0]);
+                        return 1;
+                }
+        }
+
+        if ((k < 1) || (m < 1) || (k + m > STRIPE_EC_MAX_FRAGMENTS) ||
+            !bs || (iterations < 1)) {
+                fprintf (stderr, "invalid parameters\n");
+                return 1;
+        }
+
+        stripe_ec_init ();
+
+        ret |= run ("generic", k, m, bs, iterations);
+        ret |= run ("sse2", k, m, bs, iterations);
+        ret |= run ("avx2", k, m, bs, iterations);
+
+        return ret ? 1 : 0;
+}
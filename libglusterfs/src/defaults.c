@@ -425,6 +425,15 @@ default_getspec_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
         return 0;
 }
 
+int32_t
+default_compound_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                      int32_t op_ret, int32_t op_errno,
+                      gf_compound_op_t *ops, int32_t count)
+{
+        STACK_UNWIND_STRICT (compound, frame, op_ret, op_errno, ops, count);
+        return 0;
+}
+
 /* RESUME */
 
 int32_t
@@ -1201,6 +1210,250 @@ default_getspec (call_frame_t *frame, xlator_t *this, const char *key,
         return 0;
 }
 
+/* A translator which does not implement compound runs the chain as the
+   individual fops, wound to itself, so that its caching, ordering or
+   replication applies to every step. Translators for which the chain is
+   opaque wind it to their child as a whole instead. */
+
+typedef struct {
+        fd_t             *fd;
+        gf_compound_op_t *ops;
+        int32_t           count;
+        int32_t           idx;
+} default_compound_local_t;
+
+static int32_t
+default_compound_step (call_frame_t *frame, xlator_t *this);
+
+static int32_t
+default_compound_done (call_frame_t *frame, int32_t op_ret, int32_t op_errno)
+{
+        default_compound_local_t *local = NULL;
+        int32_t                   i     = 0;
+
+        local = frame->local;
+        frame->local = NULL;
+
+        STACK_UNWIND_STRICT (compound, frame, op_ret, op_errno, local->ops,
+                             local->count);
+
+        for (i = 0; i < local->count; i++) {
+                if (local->ops[i].rsp_iobref) {
+                        iobref_unref (local->ops[i].rsp_iobref);
+                        local->ops[i].rsp_iobref = NULL;
+                }
+        }
+
+        if (local->fd)
+                fd_unref (local->fd);
+        GF_FREE (local);
+
+        return 0;
+}
+
+static int32_t
+default_compound_step_done (call_frame_t *frame, xlator_t *this,
+                            int32_t op_ret, int32_t op_errno)
+{
+        default_compound_local_t *local = NULL;
+        gf_compound_op_t         *op    = NULL;
+
+        local = frame->local;
+        op    = &local->ops[local->idx];
+
+        op->op_ret   = op_ret;
+        op->op_errno = op_errno;
+
+        if (op_ret < 0)
+                return default_compound_done (frame, -1, op_errno);
+
+        local->idx++;
+        if (local->idx == local->count)
+                return default_compound_done (frame, 0, 0);
+
+        return default_compound_step (frame, this);
+}
+
+static int32_t
+default_compound_open_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                           int32_t op_ret, int32_t op_errno, fd_t *fd)
+{
+        return default_compound_step_done (frame, this, op_ret, op_errno);
+}
+
+static int32_t
+default_compound_create_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                             int32_t op_ret, int32_t op_errno, fd_t *fd,
+                             inode_t *inode, struct iatt *buf,
+                             struct iatt *preparent, struct iatt *postparent)
+{
+        default_compound_local_t *local = NULL;
+        gf_compound_op_t         *op    = NULL;
+
+        local = frame->local;
+        op    = &local->ops[local->idx];
+
+        if (op_ret >= 0) {
+                op->stbuf      = *buf;
+                op->preparent  = *preparent;
+                op->postparent = *postparent;
+        }
+
+        return default_compound_step_done (frame, this, op_ret, op_errno);
+}
+
+static int32_t
+default_compound_readv_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                            int32_t op_ret, int32_t op_errno,
+                            struct iovec *vector, int32_t count,
+                            struct iatt *stbuf, struct iobref *iobref)
+{
+        default_compound_local_t *local = NULL;
+        gf_compound_op_t         *op    = NULL;
+        struct iobuf             *iobuf = NULL;
+
+        local = frame->local;
+        op    = &local->ops[local->idx];
+
+        if (op_ret < 0)
+                goto out;
+
+        op->stbuf = *stbuf;
+
+        if (count == 1) {
+                op->rsp_vector = vector[0];
+                if (iobref)
+                        op->rsp_iobref = iobref_ref (iobref);
+                goto out;
+        }
+
+        /* the step hands back a single vector */
+        iobuf = iobuf_get2 (this->ctx->iobuf_pool, op_ret);
+        op->rsp_iobref = iobref_new ();
+        if (!iobuf || !op->rsp_iobref) {
+                op_ret   = -1;
+                op_errno = ENOMEM;
+                goto out;
+        }
+
+        iobref_add (op->rsp_iobref, iobuf);
+        iov_unload (iobuf->ptr, vector, count);
+        op->rsp_vector.iov_base = iobuf->ptr;
+        op->rsp_vector.iov_len  = op_ret;
+out:
+        if (iobuf)
+                iobuf_unref (iobuf);
+
+        return default_compound_step_done (frame, this, op_ret, op_errno);
+}
+
+static int32_t
+default_compound_writev_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                             int32_t op_ret, int32_t op_errno,
+                             struct iatt *prebuf, struct iatt *postbuf)
+{
+        default_compound_local_t *local = NULL;
+        gf_compound_op_t         *op    = NULL;
+
+        local = frame->local;
+        op    = &local->ops[local->idx];
+
+        if (op_ret >= 0) {
+                op->preparent = *prebuf;
+                op->stbuf     = *postbuf;
+        }
+
+        return default_compound_step_done (frame, this, op_ret, op_errno);
+}
+
+static int32_t
+default_compound_flush_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                            int32_t op_ret, int32_t op_errno)
+{
+        return default_compound_step_done (frame, this, op_ret, op_errno);
+}
+
+static int32_t
+default_compound_step (call_frame_t *frame, xlator_t *this)
+{
+        default_compound_local_t *local = NULL;
+        gf_compound_op_t         *op    = NULL;
+
+        local = frame->local;
+        op    = &local->ops[local->idx];
+
+        /* only the first step opens, the others work on its fd */
+        if ((local->idx > 0) &&
+            ((op->fop == GF_FOP_OPEN) || (op->fop == GF_FOP_CREATE)))
+                goto err;
+
+        switch (op->fop) {
+        case GF_FOP_OPEN:
+                STACK_WIND (frame, default_compound_open_cbk,
+                            this, this->fops->open,
+                            op->loc, op->flags, local->fd, 0);
+                break;
+
+        case GF_FOP_CREATE:
+                STACK_WIND (frame, default_compound_create_cbk,
+                            this, this->fops->create,
+                            op->loc, op->flags, op->mode, local->fd,
+                            op->params);
+                break;
+
+        case GF_FOP_READ:
+                STACK_WIND (frame, default_compound_readv_cbk,
+                            this, this->fops->readv,
+                            local->fd, op->size, op->offset);
+                break;
+
+        case GF_FOP_WRITE:
+                STACK_WIND (frame, default_compound_writev_cbk,
+                            this, this->fops->writev,
+                            local->fd, op->vector, op->count, op->offset,
+                            op->iobref);
+                break;
+
+        case GF_FOP_FLUSH:
+                STACK_WIND (frame, default_compound_flush_cbk,
+                            this, this->fops->flush, local->fd);
+                break;
+
+        default:
+                goto err;
+        }
+
+        return 0;
+err:
+        return default_compound_step_done (frame, this, -1, EINVAL);
+}
+
+int32_t
+default_compound (call_frame_t *frame, xlator_t *this, fd_t *fd,
+                  gf_compound_op_t *ops, int32_t count, int32_t flags)
+{
+        default_compound_local_t *local = NULL;
+
+        if (!fd || !ops || (count < 1) || (count > GF_COMPOUND_MAX_OPS)) {
+                STACK_UNWIND_STRICT (compound, frame, -1, EINVAL, ops, count);
+                return 0;
+        }
+
+        local = GF_CALLOC (1, sizeof (*local), gf_common_mt_compound_local_t);
+        if (!local) {
+                STACK_UNWIND_STRICT (compound, frame, -1, ENOMEM, ops, count);
+                return 0;
+        }
+
+        local->fd    = fd_ref (fd);
+        local->ops   = ops;
+        local->count = count;
+
+        frame->local = local;
+
+        return default_compound_step (frame, this);
+}
+
 /* notify */
 int
 default_notify (xlator_t *this, int32_t event, void *data, ...)
@@ -38,6 +38,13 @@ int32_t default_getspec (call_frame_t *frame,
                          const char *key,
                          int32_t flag);
 
+int32_t default_compound (call_frame_t *frame,
+                          xlator_t *this,
+                          fd_t *fd,
+                          gf_compound_op_t *ops,
+                          int32_t count,
+                          int32_t flags);
+
 int32_t default_rchecksum (call_frame_t *frame,
                            xlator_t *this,
                            fd_t *fd, off_t offset,
@@ -674,6 +681,11 @@ int32_t
 default_getspec_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                      int32_t op_ret, int32_t op_errno, char *spec_data);
 
+int32_t
+default_compound_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                      int32_t op_ret, int32_t op_errno,
+                      gf_compound_op_t *ops, int32_t count);
+
 int32_t
 default_mem_acct_init (xlator_t *this);
 #endif /* _DEFAULTS_H */
@@ -81,6 +81,7 @@ gf_op_list_init()
         gf_fop_list[GF_FOP_FSETATTR]    = "FSETATTR";
 	gf_fop_list[GF_FOP_READDIRP]    = "READDIRP";
 	gf_fop_list[GF_FOP_GETSPEC]     = "GETSPEC";
+	gf_fop_list[GF_FOP_COMPOUND]    = "COMPOUND";
 	gf_fop_list[GF_FOP_FORGET]      = "FORGET";
 	gf_fop_list[GF_FOP_RELEASE]     = "RELEASE";
 	gf_fop_list[GF_FOP_RELEASEDIR]  = "RELEASEDIR";
@@ -139,6 +139,7 @@ typedef enum {
         GF_FOP_RELEASE,
         GF_FOP_RELEASEDIR,
         GF_FOP_GETSPEC,
+        GF_FOP_COMPOUND,
         GF_FOP_MAXVALUE,
 } glusterfs_fop_t;
 
@@ -211,6 +212,7 @@ typedef enum {
 
 typedef enum {
 	GF_XATTROP_ADD_ARRAY,
+	GF_XATTROP_ADD_ARRAY64,
 } gf_xattrop_flags_t;
 
 
@@ -228,6 +230,13 @@ typedef enum {
 /* key value which quick read uses to get small files in lookup cbk */
 #define GF_CONTENT_KEY "glusterfs.content"
 
+/* largest write payload a brick takes in one request. It is an option of
+   the socket transport, which protocol/client carries too, so that the
+   translators packing writes together can keep below it */
+#define GF_MAX_WRITE_SIZE_KEY     "transport.socket.max-write-size"
+#define GF_MAX_WRITE_SIZE_DEFAULT (1 * 1048576)
+#define GF_MAX_WRITE_SIZE_MAX     (16 * 1048576)
+
 struct _xlator_cmdline_option {
 	struct list_head    cmd_args;
 	char               *volume;
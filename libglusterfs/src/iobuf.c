@@ -373,6 +373,44 @@ unlock:
 }
 
 
+/* Page aligned iobuf of at least @size bytes. Sizes up to the pool page
+   size come from the arenas, bigger ones are mapped on their own and
+   unmapped again on the last unref. */
+struct iobuf *
+iobuf_get2 (struct iobuf_pool *iobuf_pool, size_t size)
+{
+        struct iobuf *iobuf     = NULL;
+        size_t        page_size = 0;
+
+        if (size <= iobuf_pool->page_size)
+                return iobuf_get (iobuf_pool);
+
+        page_size = getpagesize ();
+        size = ((size + page_size - 1) / page_size) * page_size;
+
+        iobuf = GF_CALLOC (1, sizeof (*iobuf), gf_common_mt_iobuf);
+        if (!iobuf)
+                return NULL;
+
+        iobuf->ptr = mmap (NULL, size, PROT_READ|PROT_WRITE,
+                           MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+        if (iobuf->ptr == MAP_FAILED) {
+                gf_log ("", GF_LOG_WARNING,
+                        "mapping %"GF_PRI_SIZET" bytes failed (%s)",
+                        size, strerror (errno));
+                GF_FREE (iobuf);
+                return NULL;
+        }
+
+        INIT_LIST_HEAD (&iobuf->list);
+        LOCK_INIT (&iobuf->lock);
+        iobuf->size = size;
+        iobuf->ref  = 1;
+
+        return iobuf;
+}
+
+
 void
 __iobuf_put (struct iobuf *iobuf, struct iobuf_arena *iobuf_arena)
 {
@@ -407,6 +445,13 @@ iobuf_put (struct iobuf *iobuf)
         if (!iobuf)
                 return;
 
+        if (iobuf->size) {
+                munmap (iobuf->ptr, iobuf->size);
+                LOCK_DESTROY (&iobuf->lock);
+                GF_FREE (iobuf);
+                return;
+        }
+
         iobuf_arena = iobuf->iobuf_arena;
         if (!iobuf_arena)
                 return;
@@ -609,6 +654,11 @@ iobuf_size (struct iobuf *iobuf)
         if (!iobuf)
                 goto out;
 
+        if (iobuf->size) {
+                size = iobuf->size;
+                goto out;
+        }
+
         if (!iobuf->iobuf_arena)
                 goto out;
 
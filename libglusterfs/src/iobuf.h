@@ -64,6 +64,9 @@ struct iobuf {
         int                  ref;  /* 0 == passive, >0 == active */
 
         void                *ptr;  /* usable memory region by the consumer */
+
+        size_t               size; /* non-zero only for iobufs mapped on their
+                                      own by iobuf_get2 (), not from an arena */
 };
 
 
@@ -107,6 +110,7 @@ struct iobuf_pool {
 struct iobuf_pool *iobuf_pool_new (size_t arena_size, size_t page_size);
 void iobuf_pool_destroy (struct iobuf_pool *iobuf_pool);
 struct iobuf *iobuf_get (struct iobuf_pool *iobuf_pool);
+struct iobuf *iobuf_get2 (struct iobuf_pool *iobuf_pool, size_t size);
 void iobuf_unref (struct iobuf *iobuf);
 struct iobuf *iobuf_ref (struct iobuf *iobuf);
 void iobuf_pool_destroy (struct iobuf_pool *iobuf_pool);
@@ -117,6 +117,8 @@ gf_set_fop_from_fn_pointer (call_frame_t *frame, struct xlator_fops *fops, void
                 fop = GF_FOP_READDIRP;
         else if (fops->getspec == fn)
                 fop = GF_FOP_GETSPEC;
+        else if (fops->compound == fn)
+                fop = GF_FOP_COMPOUND;
         else
                 fop = -1;
 
@@ -91,6 +91,7 @@ fill_defaults (xlator_t *xl)
         SET_DEFAULT_FOP (fsetattr);
 
         SET_DEFAULT_FOP (getspec);
+        SET_DEFAULT_FOP (compound);
 
 	SET_DEFAULT_CBK (release);
 	SET_DEFAULT_CBK (releasedir);
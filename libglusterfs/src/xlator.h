@@ -83,6 +83,36 @@ struct _loc {
 	inode_t    *parent;
 };
 
+/* one step of a compound fop. The first step may be GF_FOP_OPEN or
+   GF_FOP_CREATE on @loc, every other step works on the fd of the compound
+   call. The results are filled in by the xlator which executes the chain:
+   a GF_FOP_WRITE step returns its prebuf in @preparent and its postbuf in
+   @stbuf, a GF_FOP_READ step its data in @rsp_vector, which stays valid
+   only as long as the caller holds a ref on @rsp_iobref. */
+#define GF_COMPOUND_MAX_OPS  8
+#define GF_COMPOUND_RELEASE  0x1  /* close the fd the chain opened */
+
+typedef struct {
+        glusterfs_fop_t  fop;
+        loc_t           *loc;
+        int32_t          flags;
+        mode_t           mode;
+        dict_t          *params;
+        off_t            offset;
+        size_t           size;
+        struct iovec    *vector;
+        int32_t          count;
+        struct iobref   *iobref;
+
+        int32_t          op_ret;
+        int32_t          op_errno;
+        struct iatt      stbuf;
+        struct iatt      preparent;
+        struct iatt      postparent;
+        struct iovec     rsp_vector;
+        struct iobref   *rsp_iobref;
+} gf_compound_op_t;
+
 
 typedef int32_t (*fop_getspec_cbk_t) (call_frame_t *frame,
 				      void *cookie,
@@ -91,6 +121,14 @@ typedef int32_t (*fop_getspec_cbk_t) (call_frame_t *frame,
 				      int32_t op_errno,
 				      char *spec_data);
 
+typedef int32_t (*fop_compound_cbk_t) (call_frame_t *frame,
+                                       void *cookie,
+                                       xlator_t *this,
+                                       int32_t op_ret,
+                                       int32_t op_errno,
+                                       gf_compound_op_t *ops,
+                                       int32_t count);
+
 typedef int32_t (*fop_rchecksum_cbk_t) (call_frame_t *frame,
                                         void *cookie,
                                         xlator_t *this,
@@ -105,6 +143,13 @@ typedef int32_t (*fop_getspec_t) (call_frame_t *frame,
 				  const char *key,
 				  int32_t flag);
 
+typedef int32_t (*fop_compound_t) (call_frame_t *frame,
+                                   xlator_t *this,
+                                   fd_t *fd,
+                                   gf_compound_op_t *ops,
+                                   int32_t count,
+                                   int32_t flags);
+
 typedef int32_t (*fop_rchecksum_t) (call_frame_t *frame,
                                     xlator_t *this,
                                     fd_t *fd, off_t offset,
@@ -666,6 +711,7 @@ struct xlator_fops {
         fop_setattr_t        setattr;
         fop_fsetattr_t       fsetattr;
         fop_getspec_t        getspec;
+        fop_compound_t       compound;
 
 	/* these entries are used for a typechecking hack in STACK_WIND _only_ */
 	fop_lookup_cbk_t         lookup_cbk;
@@ -709,6 +755,7 @@ struct xlator_fops {
         fop_setattr_cbk_t        setattr_cbk;
         fop_fsetattr_cbk_t       fsetattr_cbk;
         fop_getspec_cbk_t        getspec_cbk;
+        fop_compound_cbk_t       compound_cbk;
 };
 
 typedef int32_t (*cbk_forget_t) (xlator_t *this,
@@ -68,6 +68,8 @@
 struct rpc_transport_ops;
 typedef struct rpc_transport rpc_transport_t;
 
+#define RPC_TRANSPORT_BATCH_BUCKETS 6
+
 #include "dict.h"
 #include "compat.h"
 #include "rpcsvc-common.h"
@@ -210,6 +212,10 @@ struct rpc_transport {
 
         uint64_t                   total_bytes_read;
         uint64_t                   total_bytes_write;
+        uint64_t                   total_writev_calls;
+        uint64_t                   writev_batch[RPC_TRANSPORT_BATCH_BUCKETS];
+                                   /* number of writev calls which carried
+                                      1, 2-3, 4-7, ... queued messages */
 
         struct list_head           list;
 };
@@ -171,6 +171,7 @@ __socket_rwv (rpc_transport_t *this, struct iovec *vector, int count,
         while (opcount) {
                 if (write) {
                         ret = writev (sock, opvector, opcount);
+                        this->total_writev_calls++;
 
                         if (ret == 0 || (ret == -1 && errno == EAGAIN)) {
                                 /* done for now */
@@ -456,6 +457,7 @@ __socket_reset (rpc_transport_t *this)
         close (priv->sock);
         priv->sock = -1;
         priv->idx = -1;
+        priv->replies_due = 0;
         priv->connected = -1;
 
 out:
@@ -588,11 +590,43 @@ out:
 }
 
 
+static void
+__socket_account_batch (rpc_transport_t *this, int entries)
+{
+        int bucket = 0;
+
+        while ((entries >>= 1) && (bucket < (RPC_TRANSPORT_BATCH_BUCKETS - 1)))
+                bucket++;
+
+        this->writev_batch[bucket]++;
+}
+
+
+/* skip @bytes of an entry which went out partially as part of a batch */
+static void
+__socket_ioq_entry_advance (struct ioq *entry, size_t bytes)
+{
+        while (bytes && entry->pending_count) {
+                if (bytes >= entry->pending_vector[0].iov_len) {
+                        bytes -= entry->pending_vector[0].iov_len;
+                        entry->pending_vector++;
+                        entry->pending_count--;
+                } else {
+                        entry->pending_vector[0].iov_base += bytes;
+                        entry->pending_vector[0].iov_len  -= bytes;
+                        bytes = 0;
+                }
+        }
+}
+
+
 int
 __socket_ioq_churn_entry (rpc_transport_t *this, struct ioq *entry)
 {
         int ret = -1;
 
+        __socket_account_batch (this, 1);
+
         ret = __socket_writev (this, entry->pending_vector,
 			       entry->pending_count,
                                &entry->pending_vector,
@@ -611,9 +645,15 @@ __socket_ioq_churn_entry (rpc_transport_t *this, struct ioq *entry)
 int
 __socket_ioq_churn (rpc_transport_t *this)
 {
-        socket_private_t *priv = NULL;
-        int               ret = 0;
-        struct ioq       *entry = NULL;
+        socket_private_t *priv    = NULL;
+        int               ret     = 0;
+        struct ioq       *entry   = NULL;
+        struct ioq       *tmp     = NULL;
+        struct iovec      vector[GF_SOCKET_BATCH_IOVEC];
+        int               count   = 0;
+        int               entries = 0;
+        size_t            bytes   = 0;
+        size_t            len     = 0;
 
         if (!this || !this->private)
                 goto out;
@@ -621,10 +661,40 @@ __socket_ioq_churn (rpc_transport_t *this)
         priv = this->private;
 
         while (!list_empty (&priv->ioq)) {
-                /* pick next entry */
-                entry = priv->ioq_next;
+                /* gather as many queued entries as fit in one writev */
+                count   = 0;
+                entries = 0;
+                list_for_each_entry (entry, &priv->ioq, list) {
+                        if ((count + entry->pending_count)
+                            > GF_SOCKET_BATCH_IOVEC)
+                                break;
+
+                        memcpy (&vector[count], entry->pending_vector,
+                                entry->pending_count * sizeof (*vector));
+                        count += entry->pending_count;
+                        entries++;
+                }
+
+                ret = __socket_rwv (this, vector, count, NULL, NULL, &bytes, 1);
+
+                __socket_account_batch (this, entries);
+
+                /* retire the entries which went out completely and move
+                   the first partially written one forward */
+                list_for_each_entry_safe (entry, tmp, &priv->ioq, list) {
+                        if (!bytes)
+                                break;
+
+                        len = iov_length (entry->pending_vector,
+                                          entry->pending_count);
+                        if (bytes < len) {
+                                __socket_ioq_entry_advance (entry, bytes);
+                                break;
+                        }
 
-                ret = __socket_ioq_churn_entry (this, entry);
+                        bytes -= len;
+                        __socket_ioq_entry_free (entry);
+                }
 
                 if (ret != 0)
                         break;
@@ -786,6 +856,7 @@ __socket_read_vectored_request (rpc_transport_t *this)
         struct iobuf     *iobuf                  = NULL;
         uint32_t          remaining_size         = 0;
         uint32_t          gluster_write_proc_len = 0;
+        size_t            max_size               = 0;
         gfs3_write_req    write_req              = {{0,},};
 
         if (!this || !this->private)
@@ -853,7 +924,30 @@ __socket_read_vectored_request (rpc_transport_t *this)
 
         case SP_STATE_READ_VERFBYTES:
                 if (priv->incoming.payload_vector.iov_base == NULL) {
-                        iobuf = iobuf_get (this->ctx->iobuf_pool);
+                        /* the rest of the fragment is the write payload,
+                           read it straight into a page aligned buffer of
+                           its own, however big it is */
+                        remaining_size = RPC_FRAGSIZE (priv->incoming.fraghdr)
+                                - priv->incoming.frag.bytes_read;
+
+                        /* the fragment size comes from the peer and
+                           nothing has been authenticated yet */
+                        max_size = max (priv->max_write_size,
+                                        iobpool_pagesize ((struct iobuf_pool *)
+                                                          this->ctx->iobuf_pool));
+                        if (remaining_size > max_size) {
+                                gf_log (this->name, GF_LOG_ERROR,
+                                        "write payload of %"PRIu32" bytes "
+                                        "from peer %s exceeds the maximum "
+                                        "of %"GF_PRI_SIZET" bytes",
+                                        remaining_size,
+                                        this->peerinfo.identifier, max_size);
+                                ret = -1;
+                                break;
+                        }
+
+                        iobuf = iobuf_get2 (this->ctx->iobuf_pool,
+                                            remaining_size);
                         if (!iobuf) {
                                 gf_log (this->name, GF_LOG_ERROR,
                                         "unable to allocate IO buffer "
@@ -1616,10 +1710,23 @@ socket_event_poll_in (rpc_transport_t *this)
 {
         int                     ret    = -1;
         rpc_transport_pollin_t *pollin = NULL;
+        socket_private_t       *priv   = NULL;
+
+        priv = this->private;
 
         ret = socket_proto_state_machine (this, &pollin);
 
         if (pollin != NULL) {
+                if (!pollin->is_reply) {
+                        /* a reply to this call is due, see
+                           socket_submit_reply () */
+                        pthread_mutex_lock (&priv->lock);
+                        {
+                                priv->replies_due++;
+                        }
+                        pthread_mutex_unlock (&priv->lock);
+                }
+
                 ret = rpc_transport_notify (this, RPC_TRANSPORT_MSG_RECEIVED,
                                             pollin);
 
@@ -1850,6 +1957,7 @@ socket_server_event_handler (int fd, int idx, void *data,
                         new_trans->notify = this->notify;
                         new_trans->listener = this;
                         new_priv = new_trans->private;
+                        new_priv->max_write_size = priv->max_write_size;
 
                         pthread_mutex_lock (&new_priv->lock);
                         {
@@ -2303,7 +2411,20 @@ socket_submit_reply (rpc_transport_t *this, rpc_transport_reply_t *reply)
                 entry = __socket_ioq_new (this, &reply->msg);
                 if (!entry)
                         goto unlock;
-                if (list_empty (&priv->ioq)) {
+
+                if (priv->replies_due > 0)
+                        priv->replies_due--;
+
+                /* more replies are being worked on (by io-threads, say):
+                   hold this one back and let the poller write out
+                   whatever has been queued by the time it gets to
+                   POLLOUT, in one writev */
+                if (list_empty (&priv->ioq) && priv->replies_due) {
+                        list_add_tail (&entry->list, &priv->ioq);
+                        need_append = 0;
+                        need_poll_out = 1;
+                        ret = 0;
+                } else if (list_empty (&priv->ioq)) {
                         ret = __socket_ioq_churn_entry (this, entry);
 
                         if (ret == 0)
@@ -2434,6 +2555,7 @@ validate_options (rpc_transport_t *this, dict_t *options, char **op_errstr)
         char             *optstr = NULL;
         int               ret = -1;
         gf_boolean_t      tmp_bool = _gf_false;
+        uint64_t          max_write_size = 0;
         
         if (dict_get_str (options, "transport.socket.keepalive",
             &optstr) == 0) {
@@ -2447,6 +2569,16 @@ validate_options (rpc_transport_t *this, dict_t *options, char **op_errstr)
                     }
         }
 
+        if (dict_get_str (options, GF_MAX_WRITE_SIZE_KEY, &optstr) == 0) {
+                if ((gf_string2bytesize (optstr, &max_write_size) != 0)
+                    || (max_write_size < GF_MAX_WRITE_SIZE_DEFAULT)
+                    || (max_write_size > GF_MAX_WRITE_SIZE_MAX)) {
+                        *op_errstr = "Value should be between 1MB and 16MB";
+                        ret = -1;
+                        goto out;
+                }
+        }
+
         ret =0;
 out:
                 return ret;
@@ -2484,6 +2616,13 @@ reconfigure (rpc_transport_t *this, dict_t *options)
         }
         else
                 priv->keepalive = 1;
+
+        /* connections accepted from now on take the new size */
+        priv->max_write_size = GF_SOCKET_MAX_WRITE_SIZE;
+        if (dict_get_str (this->options, GF_MAX_WRITE_SIZE_KEY,
+                          &optstr) == 0)
+                gf_string2bytesize (optstr, &priv->max_write_size);
+
         ret = 0;
 out:
         return ret;
@@ -2521,6 +2660,7 @@ socket_init (rpc_transport_t *this)
         priv->nodelay = 1;
         priv->bio = 0;
         priv->windowsize = GF_DEFAULT_SOCKET_WINDOW_SIZE;
+        priv->max_write_size = GF_SOCKET_MAX_WRITE_SIZE;
 
         INIT_LIST_HEAD (&priv->ioq);
 
@@ -2608,6 +2748,20 @@ socket_init (rpc_transport_t *this)
                 priv->keepaliveidle = keepalive;
         }
 
+        optstr = NULL;
+        if (dict_get_str (this->options, GF_MAX_WRITE_SIZE_KEY,
+                          &optstr) == 0) {
+                if ((gf_string2bytesize (optstr, &priv->max_write_size) != 0)
+                    || (priv->max_write_size < GF_MAX_WRITE_SIZE_DEFAULT)
+                    || (priv->max_write_size > GF_MAX_WRITE_SIZE_MAX)) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "invalid '"GF_MAX_WRITE_SIZE_KEY" %s'",
+                                optstr);
+                        GF_FREE (priv);
+                        return -1;
+                }
+        }
+
         priv->windowsize = (int)windowsize;
 out:
         this->private = priv;
@@ -2710,5 +2864,13 @@ struct volume_options options[] = {
         { .key   = {"transport.socket.keepalive-time"},
           .type  = GF_OPTION_TYPE_INT
         },
+        { .key   = {GF_MAX_WRITE_SIZE_KEY},
+          .type  = GF_OPTION_TYPE_SIZET,
+          .min   = GF_MAX_WRITE_SIZE_DEFAULT,
+          .max   = GF_MAX_WRITE_SIZE_MAX,
+          .description = "Largest write payload taken in one request. A "
+                         "longer request is refused and the connection "
+                         "dropped."
+        },
         { .key = {NULL} }
 };
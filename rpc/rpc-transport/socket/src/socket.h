@@ -39,8 +39,17 @@
 
 #define GF_DEFAULT_SOCKET_LISTEN_PORT  GF_DEFAULT_BASE_PORT
 
+/* upper bound on the iovecs gathered from the ioq into a single writev */
+#define GF_SOCKET_BATCH_IOVEC (4 * MAX_IOVEC)
+
 #define RPC_MAX_FRAGMENT_SIZE 0x7fffffff
 
+/* largest write payload accepted in a request, unless
+   GF_MAX_WRITE_SIZE_KEY says otherwise. clients send at most an iobuf
+   page per write, a few of them when stripe aggregates writes, or an
+   extent of write-behind */
+#define GF_SOCKET_MAX_WRITE_SIZE GF_MAX_WRITE_SIZE_DEFAULT
+
 /* This is the size set through setsockopt for
  * both the TCP receive window size and the
  * send buffer size.
@@ -148,6 +157,8 @@ typedef struct {
         char                   bio;
         char                   connect_finish_log;
         char                   submit_log;
+        int                    replies_due; /* calls received which
+                                               were not replied to yet */
         union {
                 struct list_head     ioq;
                 struct {
@@ -192,6 +203,7 @@ typedef struct {
         int                    keepalive;
         int                    keepaliveidle;
         int                    keepaliveintvl;
+        uint64_t               max_write_size;
 } socket_private_t;
 
 
@@ -1967,8 +1967,9 @@ dht_getxattr (call_frame_t *frame, xlator_t *this,
                         local->layout = layout;
                         //layout = dht_layout_new (this, conf->subvolume_cnt);
 
-                        dht_selfheal_new_directory (frame, dht_fix_layout_cbk,
-                                                    layout);
+                        dht_selfheal_expand_directory (frame,
+                                                       dht_fix_layout_cbk,
+                                                       layout);
                         return 0;
                 }
                 op_errno = ENODATA;
@@ -1998,6 +1999,25 @@ dht_getxattr (call_frame_t *frame, xlator_t *this,
                 return 0;
         }
 
+        if (key && (strcmp (key, QUOTA_SIZE_KEY) == 0) &&
+            (loc->inode->ia_type == IA_IFDIR)) {
+                cnt = layout->cnt;
+                sub_volumes = alloca (cnt * sizeof (xlator_t *));
+                for (i = 0; i < cnt; i++)
+                        sub_volumes[i] = layout->list[i].xlator;
+
+                if (cluster_getmarkerattr (frame, this, loc, key,
+                                           local, dht_getxattr_unwind,
+                                           sub_volumes, cnt,
+                                           MARKER_QUOTA_TYPE,
+                                           conf->vol_uuid)) {
+                        op_errno = EINVAL;
+                        goto err;
+                }
+
+                return 0;
+        }
+
         if (key && *conf->vol_uuid) {
                 if ((match_uuid_local (key, conf->vol_uuid) == 0) &&
                     (-1 == frame->root->pid)) {
@@ -5041,6 +5061,8 @@ dht_notify (xlator_t *this, int event, void *data, ...)
                 /* one of the node came back up, do a stat update */
                 dht_get_du_info_for_subvol (this, cnt);
 
+                dht_du_poller_start (this);
+
 		break;
 
 	case GF_EVENT_CHILD_MODIFIED:
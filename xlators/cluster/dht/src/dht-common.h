@@ -24,6 +24,7 @@
 
 #include "dht-mem-types.h"
 #include "libxlator.h"
+#include "timer.h"
 
 #ifndef _DHT_H
 #define _DHT_H
@@ -31,6 +32,7 @@
 #define GF_XATTR_FIX_LAYOUT_KEY   "trusted.distribute.fix.layout"
 #define GF_DHT_LOOKUP_UNHASHED_ON   1
 #define GF_DHT_LOOKUP_UNHASHED_AUTO 2
+#define GF_DHT_DU_REFRESH_INTERVAL  5
 
 #include <fnmatch.h>
 
@@ -139,7 +141,10 @@ typedef struct dht_local dht_local_t;
 struct dht_du {
         double   avail_percent;
         uint64_t avail_space;
+        uint64_t total_space;
         uint32_t log;
+        uint64_t chosen;  /* creates placed here for lack of space
+                             on the hashed subvolume */
 };
 typedef struct dht_du dht_du_t;
 
@@ -159,7 +164,10 @@ struct dht_conf {
         char           disk_unit;
         int32_t        refresh_interval;
         gf_boolean_t   unhashed_sticky_bit;
+        gf_boolean_t   weighted_layout;
 	struct timeval last_stat_fetch;
+        gf_timer_t    *du_timer;
+        char           du_poller;
         gf_lock_t      layout_lock;
         void          *private;     /* Can be used by wrapper xlators over
                                        dht */
@@ -275,6 +283,9 @@ int
 dht_selfheal_directory (call_frame_t *frame, dht_selfheal_dir_cbk_t cbk,
 			loc_t *loc, dht_layout_t *layout);
 int
+dht_selfheal_expand_directory (call_frame_t *frame, dht_selfheal_dir_cbk_t cbk,
+                               dht_layout_t *layout);
+int
 dht_selfheal_new_directory (call_frame_t *frame, dht_selfheal_dir_cbk_t cbk,
 			    dht_layout_t *layout);
 int
@@ -291,6 +302,9 @@ int dht_get_du_info (call_frame_t *frame, xlator_t *this, loc_t *loc);
 int dht_is_subvol_filled (xlator_t *this, xlator_t *subvol);
 xlator_t *dht_free_disk_available_subvol (xlator_t *this, xlator_t *subvol);
 int dht_get_du_info_for_subvol (xlator_t *this, int subvol_idx);
+void dht_du_poller_start (xlator_t *this);
+void dht_du_poller_stop (xlator_t *this);
+uint64_t __dht_du_headroom (dht_conf_t *conf, int subvol_idx);
 
 int dht_layout_preset (xlator_t *this, xlator_t *subvol, inode_t *inode);
 int dht_layout_set (xlator_t *this, inode_t *inode, dht_layout_t *layout);
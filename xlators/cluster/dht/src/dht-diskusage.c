@@ -43,6 +43,7 @@ dht_du_info_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
         int            i = 0;
         double         percent = 0;
         uint64_t       bytes = 0;
+        uint64_t       total = 0;
 
         conf = this->private;
         prev = cookie;
@@ -53,6 +54,7 @@ dht_du_info_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
         if (statvfs && statvfs->f_blocks) {
                 percent = (statvfs->f_bfree * 100) / statvfs->f_blocks;
                 bytes = (statvfs->f_bfree * statvfs->f_frsize);
+                total = (statvfs->f_blocks * statvfs->f_frsize);
         }
         
         LOCK (&conf->subvolume_lock);
@@ -61,6 +63,7 @@ dht_du_info_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                         if (prev->this == conf->subvolumes[i]) {
                                 conf->du_stats[i].avail_percent = percent;
                                 conf->du_stats[i].avail_space   = bytes;
+                                conf->du_stats[i].total_space   = total;
                                 gf_log (this->name, GF_LOG_DEBUG,
                                         "on subvolume '%s': avail_percent is: "
                                         "%.2f and avail_space is: %"PRIu64"",
@@ -122,6 +125,100 @@ dht_get_du_info_for_subvol (xlator_t *this, int subvol_idx)
         return -1;
 }
 
+/*
+ * the free space of the subvolumes is refreshed every du-refresh-interval
+ * seconds from the timer thread, so that placement decisions never wait
+ * for, nor trigger, a round of statfs.
+ */
+static void
+dht_du_refresh (void *data)
+{
+        xlator_t       *this  = data;
+	dht_conf_t     *conf  = NULL;
+        gf_timer_t     *timer = NULL;
+        struct timeval  tv    = {0,};
+        struct timeval  delta = {0,};
+        int             i     = 0;
+
+        conf = this->private;
+        if (!conf)
+                return;
+
+        for (i = 0; i < conf->subvolume_cnt; i++) {
+                if (conf->subvolume_status[i])
+                        dht_get_du_info_for_subvol (this, i);
+        }
+
+	gettimeofday (&tv, NULL);
+        delta.tv_sec = (conf->refresh_interval > 0) ?
+                conf->refresh_interval : GF_DHT_DU_REFRESH_INTERVAL;
+
+        LOCK (&conf->subvolume_lock);
+        {
+                conf->last_stat_fetch.tv_sec = tv.tv_sec;
+
+                timer = conf->du_timer;
+                conf->du_timer = NULL;
+
+                if (conf->du_poller)
+                        conf->du_timer = gf_timer_call_after (this->ctx, delta,
+                                                              dht_du_refresh,
+                                                              this);
+        }
+        UNLOCK (&conf->subvolume_lock);
+
+        if (timer)
+                gf_timer_call_cancel (this->ctx, timer);
+}
+
+
+void
+dht_du_poller_start (xlator_t *this)
+{
+	dht_conf_t     *conf  = NULL;
+        struct timeval  delta = {0,};
+
+        conf = this->private;
+
+        delta.tv_sec = (conf->refresh_interval > 0) ?
+                conf->refresh_interval : GF_DHT_DU_REFRESH_INTERVAL;
+
+        LOCK (&conf->subvolume_lock);
+        {
+                if (!conf->du_poller) {
+                        conf->du_poller = 1;
+                        conf->du_timer = gf_timer_call_after (this->ctx, delta,
+                                                              dht_du_refresh,
+                                                              this);
+                        if (!conf->du_timer)
+                                conf->du_poller = 0;
+                }
+        }
+        UNLOCK (&conf->subvolume_lock);
+}
+
+
+void
+dht_du_poller_stop (xlator_t *this)
+{
+	dht_conf_t *conf  = NULL;
+        gf_timer_t *timer = NULL;
+
+        conf = this->private;
+
+        LOCK (&conf->subvolume_lock);
+        {
+                conf->du_poller = 0;
+                timer = conf->du_timer;
+                conf->du_timer = NULL;
+        }
+        UNLOCK (&conf->subvolume_lock);
+
+        if (timer)
+                gf_timer_call_cancel (this->ctx, timer);
+}
+
+
 int
 dht_get_du_info (call_frame_t *frame, xlator_t *this, loc_t *loc)
 {
@@ -133,6 +230,10 @@ dht_get_du_info (call_frame_t *frame, xlator_t *this, loc_t *loc)
 
 	conf  = this->private;
 
+        /* kept fresh in the background */
+        if (conf->du_poller)
+                return 0;
+
 	gettimeofday (&tv, NULL);
 	if (tv.tv_sec > (conf->refresh_interval 
 			 + conf->last_stat_fetch.tv_sec)) {
@@ -220,30 +321,68 @@ dht_is_subvol_filled (xlator_t *this, xlator_t *subvol)
         return subvol_filled;
 }
 
+/* the space a subvolume has above min-free-disk */
+uint64_t
+__dht_du_headroom (dht_conf_t *conf, int subvol_idx)
+{
+        dht_du_t *du      = NULL;
+        uint64_t  reserve = 0;
+
+        du = &conf->du_stats[subvol_idx];
+
+        if (conf->disk_unit == 'p')
+                reserve = (du->total_space / 100) * conf->min_free_disk;
+        else
+                reserve = conf->min_free_disk;
+
+        if (du->avail_space <= reserve)
+                return 0;
+
+        return du->avail_space - reserve;
+}
+
+
+/*
+ * picks a subvolume for a file whose hashed subvolume is full, at random
+ * among those which are up and have space above min-free-disk, in
+ * proportion to that space. a burst of creates is spread over all of them
+ * rather than landing on the emptiest one until the next statfs.
+ */
 xlator_t *
 dht_free_disk_available_subvol (xlator_t *this, xlator_t *subvol) 
 {
         int         i = 0;
-        double      max= 0;
+        uint64_t    total = 0;
+        uint64_t    pick = 0;
+        uint64_t   *headroom = NULL;
         xlator_t   *avail_subvol = NULL;
 	dht_conf_t *conf = NULL;
 
         conf = this->private;
 
+        headroom = alloca (conf->subvolume_cnt * sizeof (*headroom));
+
         LOCK (&conf->subvolume_lock);
         {
                 for (i = 0; i < conf->subvolume_cnt; i++) {
-                        if (conf->disk_unit == 'p') {
-                                if (conf->du_stats[i].avail_percent > max) {
-                                        max = conf->du_stats[i].avail_percent;
-                                        avail_subvol = conf->subvolumes[i];
-                                }
-                        } else {
-                                if (conf->du_stats[i].avail_space > max) {
-                                        max = conf->du_stats[i].avail_space;
-                                        avail_subvol = conf->subvolumes[i];
-                                }
+                        headroom[i] = 0;
+                        if (conf->subvolume_status[i])
+                                headroom[i] = __dht_du_headroom (conf, i);
+                        total += headroom[i];
+                }
+
+                if (total) {
+                        pick = ((((uint64_t) random ()) << 31) | random ())
+                                % total;
+
+                        for (i = 0; i < conf->subvolume_cnt; i++) {
+                                if (pick < headroom[i])
+                                        break;
+                                pick -= headroom[i];
                         }
+
+                        conf->du_stats[i].chosen++;
+                        avail_subvol = conf->subvolumes[i];
                 }
         }
         UNLOCK (&conf->subvolume_lock);
@@ -251,13 +390,8 @@ dht_free_disk_available_subvol (xlator_t *this, xlator_t *subvol)
         if (!avail_subvol) {
                 gf_log (this->name, GF_LOG_DEBUG,
                         "no subvolume has enough free space to create");
-        }
-
-        if (max < conf->min_free_disk)
                 avail_subvol = subvol;
-
-        if (!avail_subvol)
-                avail_subvol = subvol;                
+        }
 
         return avail_subvol;
 }
@@ -385,6 +385,74 @@ dht_selfheal_layout_alloc_start (xlator_t *this, loc_t *loc,
 }
 
 
+/*
+ * fills in the weight of each subvolume of @layout which was given a
+ * weight of 1 by the caller, and returns their sum. with weighted-layout
+ * a subvolume weighs the size of its brick as last seen by statfs, as
+ * long as the size of all of them is known.
+ */
+static uint64_t
+dht_selfheal_layout_weights (xlator_t *this, dht_layout_t *layout,
+                             uint64_t *weights)
+{
+        dht_conf_t *conf     = NULL;
+        uint64_t    total    = 0;
+        int         i        = 0;
+        int         j        = 0;
+        int         unknown  = 0;
+
+        conf = this->private;
+
+        if (conf->weighted_layout && conf->du_stats) {
+                LOCK (&conf->subvolume_lock);
+                {
+                        for (i = 0; i < layout->cnt; i++) {
+                                if (!weights[i])
+                                        continue;
+
+                                for (j = 0; j < conf->subvolume_cnt; j++)
+                                        if (conf->subvolumes[j]
+                                            == layout->list[i].xlator)
+                                                break;
+
+                                if ((j == conf->subvolume_cnt)
+                                    || !conf->du_stats[j].total_space) {
+                                        unknown = 1;
+                                        break;
+                                }
+
+                                weights[i] = conf->du_stats[j].total_space;
+                        }
+                }
+                UNLOCK (&conf->subvolume_lock);
+
+                if (unknown) {
+                        gf_log (this->name, GF_LOG_DEBUG,
+                                "brick sizes not known yet, "
+                                "not weighting the layout");
+                        for (i = 0; i < layout->cnt; i++)
+                                if (weights[i])
+                                        weights[i] = 1;
+                }
+        }
+
+        for (i = 0; i < layout->cnt; i++)
+                total += weights[i];
+
+        return total;
+}
+
+
+static uint32_t
+dht_selfheal_layout_share (uint64_t weight, uint64_t total)
+{
+        if (!total)
+                return 0;
+
+        return (uint32_t) (((double) 0xffffffff) * weight / total);
+}
+
+
 void
 dht_selfheal_layout_new_directory (call_frame_t *frame, loc_t *loc,
 				   dht_layout_t *layout)
@@ -396,6 +464,8 @@ dht_selfheal_layout_new_directory (call_frame_t *frame, loc_t *loc,
 	int          cnt = 0;
 	int          err = 0;
         int          start_subvol = 0;
+        uint64_t    *weights = NULL;
+        uint64_t     total = 0;
 
 	this = frame->this;
 
@@ -418,13 +488,19 @@ dht_selfheal_layout_new_directory (call_frame_t *frame, loc_t *loc,
                 }
         }
 
-	chunk = ((unsigned long) 0xffffffff) / ((cnt) ? cnt : 1);
+        weights = alloca (layout->cnt * sizeof (*weights));
+        for (i = 0; i < layout->cnt; i++)
+                weights[i] = (layout->list[i].err == -1);
+
+        total = dht_selfheal_layout_weights (this, layout, weights);
 
 	start_subvol = dht_selfheal_layout_alloc_start (this, loc, layout);
 
 	for (i = start_subvol; i < layout->cnt; i++) {
 		err = layout->list[i].err;
 		if (err == -1) {
+                        chunk = dht_selfheal_layout_share (weights[i], total);
+
 			layout->list[i].start = start;
 			layout->list[i].stop  = start + chunk - 1;
 			
@@ -444,6 +520,8 @@ dht_selfheal_layout_new_directory (call_frame_t *frame, loc_t *loc,
 	for (i = 0; i < start_subvol; i++) {
 		err = layout->list[i].err;
 		if (err == -1) {
+                        chunk = dht_selfheal_layout_share (weights[i], total);
+
 			layout->list[i].start = start;
 			layout->list[i].stop  = start + chunk - 1;
 			
@@ -462,6 +540,161 @@ dht_selfheal_layout_new_directory (call_frame_t *frame, loc_t *loc,
 }
 
 
+/*
+ * gives the subvolumes which have no range in @layout (bricks added to the
+ * volume) their share of the hash space, leaving everybody else's range in
+ * place but for the part carved out of it. a new range straddles the
+ * boundary between two ranges and is carved out of both in proportion to
+ * their sizes, so only the hash space handed to the new subvolume changes
+ * hands: adding one brick to N moves about 1/(N+1) of the files instead
+ * of about half of them. the boundary is picked by the hash of the path,
+ * which spreads the carving over all the subvolumes across directories.
+ *
+ * falls back to a fresh layout when the ranges we have do not cover the
+ * hash space exactly once.
+ */
+void
+dht_selfheal_layout_expand (call_frame_t *frame, loc_t *loc,
+                            dht_layout_t *layout)
+{
+        xlator_t *this     = NULL;
+        int      *order    = NULL;
+        uint64_t *weights  = NULL;
+        uint64_t  total    = 0;
+        uint64_t  len_l    = 0, len_r = 0;
+        uint32_t  size     = 0, from_l = 0, from_r = 0;
+        uint32_t  hashval  = 0;
+        uint32_t  next     = 0;
+        int       n        = 0;
+        int       added    = 0;
+        int       b        = 0;
+        int       i        = 0;
+        int       j        = 0;
+        int       l        = 0, r = 0;
+
+        this = frame->this;
+
+        order   = alloca (layout->cnt * sizeof (*order));
+        weights = alloca (layout->cnt * sizeof (*weights));
+
+        /* the ranges in place, ordered by their start */
+        for (i = 0; i < layout->cnt; i++) {
+                weights[i] = 0;
+
+                if ((layout->list[i].err != 0) && (layout->list[i].err != -1))
+                        continue;
+
+                weights[i] = 1;
+
+                if (layout->list[i].start == layout->list[i].stop)
+                        continue;
+
+                for (j = n; (j > 0) && (layout->list[order[j - 1]].start
+                                        > layout->list[i].start); j--)
+                        order[j] = order[j - 1];
+                order[j] = i;
+                n++;
+        }
+
+        for (i = 0; i < n; i++) {
+                if (layout->list[order[i]].start != next)
+                        break;
+                next = layout->list[order[i]].stop + 1;
+                if ((i < n - 1) && (next == 0))
+                        break;
+        }
+
+        if (!n || (i < n) || (next != 0)) {
+                gf_log (this->name, GF_LOG_DEBUG,
+                        "ranges of %s do not cover the hash space, "
+                        "giving it a fresh layout", loc->path);
+                dht_selfheal_layout_new_directory (frame, loc, layout);
+                return;
+        }
+
+        total = dht_selfheal_layout_weights (this, layout, weights);
+
+        dht_hash_compute (layout->type, loc->path, &hashval);
+
+        for (i = 0; i < layout->cnt; i++) {
+                if (!weights[i] || (layout->list[i].start
+                                    != layout->list[i].stop))
+                        continue;
+
+                size = dht_selfheal_layout_share (weights[i], total);
+                if (!size)
+                        continue;
+
+                if (n == 1) {
+                        /* only the tail of the one range there is */
+                        b = 0;
+                        l = order[0];
+                        len_l = (uint64_t) layout->list[l].stop
+                                - layout->list[l].start + 1;
+                        from_l = min (size, len_l - 1);
+                        from_r = 0;
+                } else {
+                        b = (hashval + added) % (n - 1);
+                        l = order[b];
+                        r = order[b + 1];
+
+                        len_l = (uint64_t) layout->list[l].stop
+                                - layout->list[l].start + 1;
+                        len_r = (uint64_t) layout->list[r].stop
+                                - layout->list[r].start + 1;
+
+                        from_l = (uint64_t) size * len_l / (len_l + len_r);
+                        from_r = size - from_l;
+
+                        from_l = min (from_l, len_l - 1);
+                        from_r = min (from_r, len_r - 1);
+                }
+
+                if (!from_l && !from_r)
+                        continue;
+
+                /* only a neighbour which gave up part of its range needs
+                   its layout rewritten */
+                layout->list[i].start = layout->list[l].stop - from_l + 1;
+                if (from_l) {
+                        layout->list[l].stop -= from_l;
+                        layout->list[l].err = -1;
+                }
+
+                if (n == 1) {
+                        layout->list[i].stop = layout->list[i].start
+                                + from_l - 1;
+                } else {
+                        layout->list[i].stop = layout->list[r].start
+                                + from_r - 1;
+                        if (from_r) {
+                                layout->list[r].start += from_r;
+                                layout->list[r].err = -1;
+                        }
+                }
+
+                layout->list[i].err = -1;
+
+                memmove (&order[b + 2], &order[b + 1],
+                         (n - b - 1) * sizeof (*order));
+                order[b + 1] = i;
+                n++;
+                added++;
+
+                gf_log (this->name, GF_LOG_TRACE,
+                        "carved %u - %u for %s out of %s and %s for %s",
+                        layout->list[i].start, layout->list[i].stop,
+                        layout->list[i].xlator->name,
+                        (from_l ? layout->list[l].xlator->name : "none"),
+                        (from_r ? layout->list[r].xlator->name : "none"),
+                        loc->path);
+        }
+
+        gf_log (this->name, GF_LOG_DEBUG,
+                "expanded layout of %s by %d subvolumes", loc->path, added);
+}
+
+
 int
 dht_selfheal_dir_getafix (call_frame_t *frame, loc_t *loc,
 			  dht_layout_t *layout)
@@ -513,6 +746,24 @@ dht_selfheal_dir_getafix (call_frame_t *frame, loc_t *loc,
 	return ret;
 }
 
+int
+dht_selfheal_expand_directory (call_frame_t *frame,
+                               dht_selfheal_dir_cbk_t dir_cbk,
+                               dht_layout_t *layout)
+{
+	dht_local_t *local = NULL;
+
+	local = frame->local;
+
+	local->selfheal.dir_cbk = dir_cbk;
+	local->selfheal.layout = dht_layout_ref (frame->this, layout);
+
+	dht_selfheal_layout_expand (frame, &local->loc, layout);
+	dht_selfheal_dir_xattr (frame, &local->loc, layout);
+	return 0;
+}
+
+
 int
 dht_selfheal_new_directory (call_frame_t *frame, 
 			    dht_selfheal_dir_cbk_t dir_cbk,
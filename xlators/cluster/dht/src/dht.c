@@ -144,16 +144,30 @@ dht_priv_dump (xlator_t *this)
         gf_proc_dump_write(key, "%d", conf->refresh_interval);
         gf_proc_dump_build_key(key, key_prefix, "unhashed_sticky_bit");
         gf_proc_dump_write(key, "%d", conf->unhashed_sticky_bit);
-        if (conf ->du_stats) {
+        gf_proc_dump_build_key(key, key_prefix, "weighted_layout");
+        gf_proc_dump_write(key, "%d", conf->weighted_layout);
+        for (i = 0; conf->du_stats && (i < conf->subvolume_cnt); i++) {
                 gf_proc_dump_build_key(key, key_prefix,
-                                "du_stats.avail_percent");
-                gf_proc_dump_write(key, "%lf", conf->du_stats->avail_percent);
+                                "du_stats[%d].subvolume", i);
+                gf_proc_dump_write(key, "%s", conf->subvolumes[i]->name);
                 gf_proc_dump_build_key(key, key_prefix,
-                                "du_stats.avail_space");
-                gf_proc_dump_write(key, "%lu", conf->du_stats->avail_space);
+                                "du_stats[%d].avail_percent", i);
+                gf_proc_dump_write(key, "%lf", conf->du_stats[i].avail_percent);
                 gf_proc_dump_build_key(key, key_prefix,
-                                "du_stats.log");
-                gf_proc_dump_write(key, "%lu", conf->du_stats->log);
+                                "du_stats[%d].avail_space", i);
+                gf_proc_dump_write(key, "%"PRIu64, conf->du_stats[i].avail_space);
+                gf_proc_dump_build_key(key, key_prefix,
+                                "du_stats[%d].total_space", i);
+                gf_proc_dump_write(key, "%"PRIu64, conf->du_stats[i].total_space);
+                gf_proc_dump_build_key(key, key_prefix,
+                                "du_stats[%d].headroom", i);
+                gf_proc_dump_write(key, "%"PRIu64, __dht_du_headroom (conf, i));
+                gf_proc_dump_build_key(key, key_prefix,
+                                "du_stats[%d].chosen", i);
+                gf_proc_dump_write(key, "%"PRIu64, conf->du_stats[i].chosen);
+                gf_proc_dump_build_key(key, key_prefix,
+                                "du_stats[%d].log", i);
+                gf_proc_dump_write(key, "%u", conf->du_stats[i].log);
         }
         gf_proc_dump_build_key(key, key_prefix, "last_stat_fetch");
         gf_proc_dump_write(key, "%s", ctime(&conf->last_stat_fetch.tv_sec));
@@ -208,6 +222,10 @@ fini (xlator_t *this)
         dht_conf_t *conf = NULL;
 
 	conf = this->private;
+
+        if (conf)
+                dht_du_poller_stop (this);
+
         this->private = NULL;
         if (conf) {
                 if (conf->file_layouts) {
@@ -350,6 +368,19 @@ reconfigure (xlator_t *this, dict_t *options)
                        temp_str);
 	}
 
+	if (dict_get (options, "du-refresh-interval")) {
+                conf->refresh_interval =
+                        data_to_int32 (dict_get (options,
+                                                 "du-refresh-interval"));
+		gf_log(this->name, GF_LOG_DEBUG, "Reconfigure:"
+                       " du-refresh-interval reconfigured to %d",
+                       conf->refresh_interval);
+	}
+
+	if (dict_get_str (options, "weighted-layout", &temp_str) == 0) {
+	        gf_string2boolean (temp_str, &conf->weighted_layout);
+	}
+
 out:
 	return ret;
 }
@@ -398,6 +429,13 @@ init (xlator_t *this)
 	        gf_string2boolean (temp_str, &conf->unhashed_sticky_bit);
 	}
 
+	conf->weighted_layout = 0;
+
+	if (dict_get_str (this->options, "weighted-layout",
+                          &temp_str) == 0) {
+	        gf_string2boolean (temp_str, &conf->weighted_layout);
+	}
+
 	conf->use_readdirp = 1;
 
 	if (dict_get_str (this->options, "use-readdirp",
@@ -408,6 +446,13 @@ init (xlator_t *this)
         conf->disk_unit = 'p';
         conf->min_free_disk = 10;
 
+        conf->refresh_interval = GF_DHT_DU_REFRESH_INTERVAL;
+	if (dict_get (this->options, "du-refresh-interval")) {
+                conf->refresh_interval =
+                        data_to_int32 (dict_get (this->options,
+                                                 "du-refresh-interval"));
+	}
+
 	if (dict_get_str (this->options, "min-free-disk", &temp_str) == 0) {
 		if (gf_string2percent (temp_str, &temp_free_disk) == 0) {
                         if (temp_free_disk > 100) {
@@ -549,5 +594,13 @@ struct volume_options options[] = {
         { .key = {"use-readdirp"},
           .type = GF_OPTION_TYPE_BOOL
         },
+        { .key = {"weighted-layout"},
+          .type = GF_OPTION_TYPE_BOOL
+        },
+        { .key = {"du-refresh-interval"},
+          .type = GF_OPTION_TYPE_INT,
+          .min  = 1,
+          .max  = 3600,
+        },
 	{ .key  = {NULL} },
 };
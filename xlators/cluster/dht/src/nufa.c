@@ -525,6 +525,9 @@ fini (xlator_t *this)
 
 	conf = this->private;
 
+        if (conf)
+                dht_du_poller_stop (this);
+
         if (conf) {
                 if (conf->file_layouts) {
                         for (i = 0; i < conf->subvolume_cnt; i++) {
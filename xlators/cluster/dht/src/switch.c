@@ -624,6 +624,9 @@ fini (xlator_t *this)
 
 	conf = this->private;
 
+        if (conf)
+                dht_du_poller_stop (this);
+
         if (conf) {
                 trav = (struct switch_struct *)conf->private;
                 conf->private = NULL;
@@ -0,0 +1,372 @@
+/*
+  Copyright (c) 2010 Gluster, Inc. <http://www.gluster.com>
+  This file is part of GlusterFS.
+
+  GlusterFS is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Affero General Public License as published
+  by the Free Software Foundation; either version 3 of the License,
+  or (at your option) any later version.
+
+  GlusterFS is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Affero General Public License for more details.
+
+  You should have received a copy of the GNU Affero General Public License
+  along with this program.  If not, see
+  <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdint.h>
+#include <string.h>
+
+#include "stripe-ec.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define STRIPE_EC_X86 1
+#include <immintrin.h>
+#endif
+
+/* x^8 + x^4 + x^3 + x^2 + 1 */
+#define GF_POLY 0x11d
+
+typedef void (*ec_mul_add_t) (unsigned char *dst, const unsigned char *src,
+                              unsigned char c, size_t len);
+
+static unsigned char gf_exp[512];
+static unsigned char gf_log[256];
+static unsigned char gf_mul_table[256][256];
+static int           ec_initialized;
+
+static ec_mul_add_t  ec_mul_add;
+static const char   *ec_impl_name = "generic";
+
+
+static inline unsigned char
+gf_mul (unsigned char a, unsigned char b)
+{
+        if (!a || !b)
+                return 0;
+        return gf_exp[gf_log[a] + gf_log[b]];
+}
+
+static inline unsigned char
+gf_inv (unsigned char a)
+{
+        return gf_exp[255 - gf_log[a]];
+}
+
+/* Cauchy matrix with its columns scaled so that the first parity row is
+   all ones: any square submatrix of it is still invertible, and 'm == 1'
+   degenerates to plain XOR parity. */
+static inline unsigned char
+ec_coef (int k, int j, int i)
+{
+        return gf_mul (k ^ i, gf_inv ((k + j) ^ i));
+}
+
+
+static void
+ec_mul_add_generic (unsigned char *dst, const unsigned char *src,
+                    unsigned char c, size_t len)
+{
+        const unsigned char *t = gf_mul_table[c];
+        size_t               i = 0;
+
+        if (c == 0)
+                return;
+
+        if (c == 1) {
+                for (i = 0; i < len; i++)
+                        dst[i] ^= src[i];
+                return;
+        }
+
+        for (i = 0; i < len; i++)
+                dst[i] ^= t[src[i]];
+}
+
+#ifdef STRIPE_EC_X86
+
+/* SSE2 has no byte shuffle, so multiply by 'c' the long way: Horner over
+   the bits of 'c', doubling 16 bytes at a time. */
+__attribute__ ((target ("sse2")))
+static void
+ec_mul_add_sse2 (unsigned char *dst, const unsigned char *src,
+                 unsigned char c, size_t len)
+{
+        const __m128i zero = _mm_setzero_si128 ();
+        const __m128i poly = _mm_set1_epi8 (GF_POLY & 0xff);
+        __m128i       s;
+        __m128i       acc;
+        __m128i       hi;
+        size_t        i = 0;
+        int           bit = 0;
+        int           top = 7;
+
+        if (c == 0)
+                return;
+
+        while (!(c & (1 << top)))
+                top--;
+
+        for (i = 0; i + 16 <= len; i += 16) {
+                s = _mm_loadu_si128 ((const __m128i *)(src + i));
+                if (c == 1) {
+                        acc = s;
+                } else {
+                        acc = s;
+                        for (bit = top - 1; bit >= 0; bit--) {
+                                hi  = _mm_cmpgt_epi8 (zero, acc);
+                                acc = _mm_add_epi8 (acc, acc);
+                                acc = _mm_xor_si128 (acc,
+                                                     _mm_and_si128 (hi, poly));
+                                if (c & (1 << bit))
+                                        acc = _mm_xor_si128 (acc, s);
+                        }
+                }
+                acc = _mm_xor_si128 (acc, _mm_loadu_si128 ((__m128i *)(dst + i)));
+                _mm_storeu_si128 ((__m128i *)(dst + i), acc);
+        }
+
+        ec_mul_add_generic (dst + i, src + i, c, len - i);
+}
+
+/* Split every byte into nibbles and look both up in 16 entry product
+   tables with a byte shuffle, 32 bytes at a time. */
+__attribute__ ((target ("avx2")))
+static void
+ec_mul_add_avx2 (unsigned char *dst, const unsigned char *src,
+                 unsigned char c, size_t len)
+{
+        unsigned char lo[16];
+        unsigned char hi[16];
+        __m256i       tlo;
+        __m256i       thi;
+        __m256i       mask;
+        __m256i       s;
+        __m256i       p;
+        size_t        i = 0;
+        int           x = 0;
+
+        if (c == 0)
+                return;
+
+        for (x = 0; x < 16; x++) {
+                lo[x] = gf_mul (c, x);
+                hi[x] = gf_mul (c, x << 4);
+        }
+
+        tlo  = _mm256_broadcastsi128_si256 (_mm_loadu_si128 ((__m128i *)lo));
+        thi  = _mm256_broadcastsi128_si256 (_mm_loadu_si128 ((__m128i *)hi));
+        mask = _mm256_set1_epi8 (0x0f);
+
+        for (i = 0; i + 32 <= len; i += 32) {
+                s = _mm256_loadu_si256 ((const __m256i *)(src + i));
+                if (c == 1) {
+                        p = s;
+                } else {
+                        p = _mm256_xor_si256 (
+                                _mm256_shuffle_epi8 (tlo,
+                                        _mm256_and_si256 (s, mask)),
+                                _mm256_shuffle_epi8 (thi,
+                                        _mm256_and_si256 (
+                                                _mm256_srli_epi64 (s, 4),
+                                                mask)));
+                }
+                p = _mm256_xor_si256 (p, _mm256_loadu_si256 ((__m256i *)(dst + i)));
+                _mm256_storeu_si256 ((__m256i *)(dst + i), p);
+        }
+
+        ec_mul_add_generic (dst + i, src + i, c, len - i);
+}
+
+#endif /* STRIPE_EC_X86 */
+
+
+int
+stripe_ec_set_impl (const char *name)
+{
+        if (!strcmp (name, "generic")) {
+                ec_mul_add   = ec_mul_add_generic;
+                ec_impl_name = "generic";
+                return 0;
+        }
+#ifdef STRIPE_EC_X86
+        __builtin_cpu_init ();
+        if (!strcmp (name, "sse2") && __builtin_cpu_supports ("sse2")) {
+                ec_mul_add   = ec_mul_add_sse2;
+                ec_impl_name = "sse2";
+                return 0;
+        }
+        if (!strcmp (name, "avx2") && __builtin_cpu_supports ("avx2")) {
+                ec_mul_add   = ec_mul_add_avx2;
+                ec_impl_name = "avx2";
+                return 0;
+        }
+#endif
+        return -1;
+}
+
+const char *
+stripe_ec_impl (void)
+{
+        return ec_impl_name;
+}
+
+void
+stripe_ec_init (void)
+{
+        int x = 1;
+        int i = 0;
+        int j = 0;
+
+        if (ec_initialized)
+                return;
+
+        for (i = 0; i < 255; i++) {
+                gf_exp[i] = x;
+                gf_log[x] = i;
+                x <<= 1;
+                if (x & 0x100)
+                        x ^= GF_POLY;
+        }
+        for (i = 255; i < 512; i++)
+                gf_exp[i] = gf_exp[i - 255];
+
+        for (i = 0; i < 256; i++)
+                for (j = 0; j < 256; j++)
+                        gf_mul_table[i][j] = gf_mul (i, j);
+
+        if (stripe_ec_set_impl ("avx2") && stripe_ec_set_impl ("sse2"))
+                stripe_ec_set_impl ("generic");
+
+        ec_initialized = 1;
+}
+
+
+int
+stripe_ec_encode (int k, int m, size_t len, unsigned char **data,
+                  unsigned char **parity)
+{
+        int i = 0;
+        int j = 0;
+
+        if ((k < 1) || (m < 0) || ((k + m) > STRIPE_EC_MAX_FRAGMENTS))
+                return -1;
+
+        for (j = 0; j < m; j++) {
+                memset (parity[j], 0, len);
+                for (i = 0; i < k; i++)
+                        ec_mul_add (parity[j], data[i], ec_coef (k, j, i),
+                                    len);
+        }
+
+        return 0;
+}
+
+/* Gauss-Jordan over GF(2^8); 'a' is destroyed */
+static int
+ec_invert (int n, unsigned char *a, unsigned char *inv)
+{
+        unsigned char f = 0;
+        unsigned char t = 0;
+        int           r = 0;
+        int           c = 0;
+        int           p = 0;
+
+        memset (inv, 0, n * n);
+        for (r = 0; r < n; r++)
+                inv[r * n + r] = 1;
+
+        for (c = 0; c < n; c++) {
+                for (p = c; p < n; p++)
+                        if (a[p * n + c])
+                                break;
+                if (p == n)
+                        return -1;
+
+                if (p != c) {
+                        for (r = 0; r < n; r++) {
+                                t = a[p * n + r];
+                                a[p * n + r] = a[c * n + r];
+                                a[c * n + r] = t;
+                                t = inv[p * n + r];
+                                inv[p * n + r] = inv[c * n + r];
+                                inv[c * n + r] = t;
+                        }
+                }
+
+                f = gf_inv (a[c * n + c]);
+                for (r = 0; r < n; r++) {
+                        a[c * n + r]   = gf_mul (f, a[c * n + r]);
+                        inv[c * n + r] = gf_mul (f, inv[c * n + r]);
+                }
+
+                for (p = 0; p < n; p++) {
+                        if ((p == c) || !a[p * n + c])
+                                continue;
+                        f = a[p * n + c];
+                        for (r = 0; r < n; r++) {
+                                a[p * n + r]   ^= gf_mul (f, a[c * n + r]);
+                                inv[p * n + r] ^= gf_mul (f, inv[c * n + r]);
+                        }
+                }
+        }
+
+        return 0;
+}
+
+int
+stripe_ec_decode (int k, int m, size_t len, unsigned char **frags,
+                  const int *valid)
+{
+        unsigned char a[STRIPE_EC_MAX_FRAGMENTS * STRIPE_EC_MAX_FRAGMENTS];
+        unsigned char inv[STRIPE_EC_MAX_FRAGMENTS * STRIPE_EC_MAX_FRAGMENTS];
+        int           rows[STRIPE_EC_MAX_FRAGMENTS];
+        int           missing = 0;
+        int           n = 0;
+        int           f = 0;
+        int           i = 0;
+        int           r = 0;
+
+        if ((k < 1) || (m < 0) || ((k + m) > STRIPE_EC_MAX_FRAGMENTS))
+                return -1;
+
+        for (i = 0; i < k; i++)
+                if (!valid[i])
+                        missing++;
+        if (!missing)
+                return 0;
+
+        /* Data fragments first, they give identity rows */
+        for (f = 0; (f < k + m) && (n < k); f++)
+                if (valid[f])
+                        rows[n++] = f;
+        if (n < k)
+                return -1;
+
+        for (r = 0; r < k; r++) {
+                f = rows[r];
+                for (i = 0; i < k; i++) {
+                        if (f < k)
+                                a[r * k + i] = (f == i);
+                        else
+                                a[r * k + i] = ec_coef (k, f - k, i);
+                }
+        }
+
+        if (ec_invert (k, a, inv))
+                return -1;
+
+        for (i = 0; i < k; i++) {
+                if (valid[i])
+                        continue;
+                memset (frags[i], 0, len);
+                for (r = 0; r < k; r++)
+                        ec_mul_add (frags[i], frags[rows[r]], inv[i * k + r],
+                                    len);
+        }
+
+        return 0;
+}
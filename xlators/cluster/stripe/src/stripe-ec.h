@@ -0,0 +1,59 @@
+/*
+  Copyright (c) 2010 Gluster, Inc. <http://www.gluster.com>
+  This file is part of GlusterFS.
+
+  GlusterFS is free software; you can redistribute it and/or modify
+  it under the terms of the GNU Affero General Public License as published
+  by the Free Software Foundation; either version 3 of the License,
+  or (at your option) any later version.
+
+  GlusterFS is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  Affero General Public License for more details.
+
+  You should have received a copy of the GNU Affero General Public License
+  along with this program.  If not, see
+  <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _STRIPE_EC_H_
+#define _STRIPE_EC_H_
+
+#include <stddef.h>
+
+/**
+ * Systematic Reed-Solomon code over GF(2^8), used by the erasure coded
+ * mode of stripe. A stripe is made of 'k' data fragments and 'm' parity
+ * fragments of equal length; any 'k' of the 'k + m' fragments are enough
+ * to rebuild the data. The first parity fragment is the plain XOR of the
+ * data fragments.
+ *
+ * This file does not depend on libglusterfs, so that the benchmark in
+ * extras/benchmarking can be built against it directly.
+ */
+
+#define STRIPE_EC_MAX_FRAGMENTS 128
+
+/* Builds the field tables and picks the fastest region multiply the CPU
+   supports. Safe to call more than once. */
+void stripe_ec_init (void);
+
+/* Name of the region multiply in use: "avx2", "sse2" or "generic" */
+const char *stripe_ec_impl (void);
+
+/* Forces a given implementation, returns -1 if the CPU lacks it */
+int stripe_ec_set_impl (const char *name);
+
+/* parity[j] = sum over i of coef(j, i) * data[i], for 'len' bytes */
+int stripe_ec_encode (int k, int m, size_t len, unsigned char **data,
+                      unsigned char **parity);
+
+/* 'frags' holds 'k' data pointers followed by 'm' parity pointers, and
+   'valid[i]' tells whether frags[i] can be trusted. Rebuilds the data
+   fragments which are not valid, in place. Returns -1 if fewer than 'k'
+   fragments are valid. */
+int stripe_ec_decode (int k, int m, size_t len, unsigned char **frags,
+                      const int *valid);
+
+#endif /* _STRIPE_EC_H_ */
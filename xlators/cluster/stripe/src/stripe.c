@@ -26,16 +26,36 @@
  *    show file size bigger than the actual size. But when one does
  *    'df' or 'du <file>', real size of the file on the server is shown.
  *
+ *    With 'option coalesce on', new files are laid out densely instead:
+ *    every child stores its blocks one after the other, so that reads of
+ *    a stripe are sequential on the bricks too. The layout is recorded
+ *    per file in the 'trusted.<name>.stripe-coalesce' xattr.
+ *
  * WARNING:
- *  Stripe translator can't regenerate data if a child node gets disconnected.
- *  So, no 'self-heal' for stripe. Hence the advice, use stripe only when its
- *  very much necessary, or else, use it in combination with AFR, to have a
- *  backup copy.
+ *  Stripe translator can't regenerate data if a child node gets disconnected,
+ *  unless the file was created with 'option redundancy <m>', which keeps
+ *  Reed-Solomon parity of every stripe on the last 'm' children: reads then
+ *  survive any 'm' of them (other than the first) being down. Writes still
+ *  need every child, and there is no 'self-heal' for stripe. Hence the
+ *  advice, use stripe only when its very much necessary, or else, use it in
+ *  combination with AFR, to have a backup copy.
  */
 
 #include "stripe.h"
 #include "libxlator.h"
 
+void stripe_ec_io_free (struct stripe_ec_io *ec);
+void stripe_fd_io_new (xlator_t *this, stripe_fd_ctx_t *fctx);
+int stripe_wa_pending (xlator_t *this, fd_t *fd);
+fd_t *stripe_wa_inode_fd (xlator_t *this, inode_t *inode, fd_t *skip);
+int stripe_wa_wait (call_frame_t *frame, xlator_t *this, fd_t *wfd,
+                    call_stub_t *stub);
+void stripe_wa_stbuf_set (xlator_t *this, fd_t *fd, struct iatt *stbuf);
+int32_t stripe_wa_error (xlator_t *this, fd_t *fd);
+void stripe_wa_flush (call_frame_t *frame, xlator_t *this, fd_t *fd,
+                      call_stub_t *stub);
+void stripe_ra_drop (xlator_t *this, fd_t *fd);
+
 void
 stripe_local_wipe (stripe_local_t *local)
 {
@@ -44,6 +64,9 @@ stripe_local_wipe (stripe_local_t *local)
 
         loc_wipe (&local->loc);
         loc_wipe (&local->loc2);
+
+        if (local->ec)
+                stripe_ec_io_free (local->ec);
 out:
         return;
 }
@@ -84,946 +107,1256 @@ out:
         return block_size;
 }
 
+static stripe_inode_ctx_t *
+stripe_inode_ctx_get (xlator_t *this, inode_t *inode)
+{
+        stripe_inode_ctx_t *ictx = NULL;
+        uint64_t           tmp_ictx = 0;
 
+        LOCK (&inode->lock);
+        {
+                __inode_ctx_get (inode, this, &tmp_ictx);
+                ictx = (stripe_inode_ctx_t *)(long)tmp_ictx;
+                if (ictx)
+                        goto unlock;
 
-int32_t
-stripe_sh_chown_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
-                     int32_t op_ret, int32_t op_errno,
-                     struct iatt *preop, struct iatt *postop)
-{
-        int             callcnt = -1;
-        stripe_local_t *local   = NULL;
+                ictx = GF_CALLOC (1, sizeof (*ictx), gf_stripe_mt_inode_ctx_t);
+                if (!ictx)
+                        goto unlock;
 
-        if (!this || !frame || !frame->local) {
-                gf_log ("stripe", GF_LOG_DEBUG, "possible NULL deref");
-                goto out;
+                LOCK_INIT (&ictx->lock);
+                INIT_LIST_HEAD (&ictx->waiting);
+                __inode_ctx_put (inode, this, (uint64_t)(long)ictx);
         }
+unlock:
+        UNLOCK (&inode->lock);
 
-        local = frame->local;
+        return ictx;
+}
 
-        LOCK (&frame->lock);
-        {
-                callcnt = --local->call_count;
-        }
-        UNLOCK (&frame->lock);
+/* The ctx of the inode, NULL if nothing is known about it yet */
+static stripe_inode_ctx_t *
+stripe_inode_ctx_find (xlator_t *this, inode_t *inode)
+{
+        uint64_t tmp_ictx = 0;
 
-        if (!callcnt) {
-                STRIPE_STACK_DESTROY (frame);
-        }
-out:
-        return 0;
+        if (!inode)
+                return NULL;
+
+        inode_ctx_get (inode, this, &tmp_ictx);
+        return (stripe_inode_ctx_t *)(long)tmp_ictx;
 }
 
-int32_t
-stripe_sh_make_entry_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
-                          int32_t op_ret, int32_t op_errno, inode_t *inode,
-                          struct iatt *buf, struct iatt *preparent,
-                          struct iatt *postparent)
+static void
+stripe_inode_set_coalesced (xlator_t *this, inode_t *inode,
+                            off_t stripe_size, int data_count)
 {
-        stripe_local_t *local = NULL;
-        call_frame_t    *prev = NULL;
+        stripe_inode_ctx_t *ictx = NULL;
 
-        if (!frame || !frame->local || !cookie || !this) {
-                gf_log ("stripe", GF_LOG_DEBUG, "possible NULL deref");
-                goto out;
+        if (!inode)
+                return;
+
+        ictx = stripe_inode_ctx_get (this, inode);
+        if (!ictx)
+                return;
+
+        LOCK (&ictx->lock);
+        {
+                ictx->stripe_size = stripe_size;
+                ictx->data_count  = data_count;
+                ictx->coalesce    = 1;
         }
+        UNLOCK (&ictx->lock);
+}
 
-        prev  = cookie;
-        local = frame->local;
+/* Position of a child in the volfile, which is its stripe-index */
+static int
+stripe_child_index (xlator_t *this, xlator_t *child)
+{
+        stripe_private_t *priv = NULL;
+        int               i = 0;
 
-        STACK_WIND (frame, stripe_sh_chown_cbk, prev->this,
-                    prev->this->fops->setattr, &local->loc,
-                    &local->stbuf, (GF_SET_ATTR_UID | GF_SET_ATTR_GID));
+        priv = this->private;
+        for (i = 0; i < priv->child_count; i++)
+                if (priv->xl_array[i] == child)
+                        return i;
 
-out:
         return 0;
 }
 
-int32_t
-stripe_entry_self_heal (call_frame_t *frame, xlator_t *this,
-                        stripe_local_t *local)
+/**
+ * stripe_child_offset - offset of the byte at 'offset' of the file in
+ *     the file of the child holding it. Plain files keep every byte at
+ *     its own offset, leaving holes for the blocks of the other children;
+ *     coalesced files pack the blocks of each child one after the other.
+ */
+off_t
+stripe_child_offset (off_t stripe_size, int data_count, int coalesce,
+                     off_t offset)
 {
-        xlator_list_t    *trav   = NULL;
-        call_frame_t     *rframe = NULL;
-        stripe_local_t   *rlocal = NULL;
-        stripe_private_t *priv   = NULL;
-        dict_t           *dict   = NULL;
-        int               ret    = 0;
-
-        if (!local || !this || !frame) {
-                gf_log ("stripe", GF_LOG_DEBUG, "possible NULL deref");
-                goto out;
-        }
+        off_t stripe_len = 0;
 
-        if (!(IA_ISREG (local->stbuf.ia_type) ||
-              IA_ISDIR (local->stbuf.ia_type)))
-                return 0;
+        if (!coalesce)
+                return offset;
 
-        priv = this->private;
-        trav = this->children;
-        rframe = copy_frame (frame);
-        if (!rframe) {
-                goto out;
-        }
-        rlocal = GF_CALLOC (1, sizeof (stripe_local_t),
-                            gf_stripe_mt_stripe_local_t);
-        if (!rlocal) {
-                goto out;
-        }
-        rframe->local = rlocal;
-        rlocal->call_count = priv->child_count;
-        loc_copy (&rlocal->loc, &local->loc);
-        memcpy (&rlocal->stbuf, &local->stbuf, sizeof (struct iatt));
+        stripe_len = stripe_size * data_count;
+        return ((offset / stripe_len) * stripe_size) +
+                (offset % stripe_size);
+}
 
-        dict = dict_new ();
-        if (!dict)
-                goto out;
+/**
+ * stripe_child_truncate_size - what the child 'index' has to be cut to
+ *     for the file to be 'size' long. Parity children only hold whole
+ *     stripes, they are cut where the stripe 'size' falls in begins.
+ */
+off_t
+stripe_child_truncate_size (off_t stripe_size, int data_count,
+                            int coalesce, int index, off_t size)
+{
+        off_t stripe_len = 0;
+        off_t rest = 0;
+
+        if (!stripe_size)
+                return size;
+
+        stripe_len = stripe_size * data_count;
+        if (index >= data_count)
+                return stripe_child_offset (stripe_size, data_count,
+                                            coalesce,
+                                            floor (size, stripe_len));
+        if (!coalesce)
+                return size;
+
+        rest = (size % stripe_len) - (index * stripe_size);
+        return ((size / stripe_len) * stripe_size) +
+                max (0, min (rest, stripe_size));
+}
 
-        ret = dict_set_static_bin (dict, "gfid-req", local->stbuf.ia_gfid, 16);
-        if (ret)
-                gf_log (this->name, GF_LOG_WARNING,
-                        "failed to set gfid-req");
+/**
+ * stripe_file_size - size of the file as far as the child 'index' can
+ *     tell from the 'size' of its own file: the end of its last block.
+ *     Parity is as long as the first fragment of each stripe.
+ */
+off_t
+stripe_file_size (off_t stripe_size, int data_count, int coalesce,
+                  int index, off_t size)
+{
+        off_t block = 0;
 
-        while (trav) {
-                if (IA_ISREG (local->stbuf.ia_type)) {
-                        STACK_WIND (rframe, stripe_sh_make_entry_cbk,
-                                    trav->xlator, trav->xlator->fops->mknod,
-                                    &local->loc,
-                                    st_mode_from_ia (local->stbuf.ia_prot,
-                                                     local->stbuf.ia_type), 0,
-                                    dict);
-                }
-                if (IA_ISDIR (local->stbuf.ia_type)) {
-                        STACK_WIND (rframe, stripe_sh_make_entry_cbk,
-                                    trav->xlator, trav->xlator->fops->mkdir,
-                                    &local->loc, st_mode_from_ia (local->stbuf.ia_prot,
-                                                                  local->stbuf.ia_type),
-                                    dict);
-                }
-                trav = trav->next;
-        }
+        if (!coalesce || !stripe_size || !size)
+                return size;
 
-out:
-        if (rframe)
-                STRIPE_STACK_DESTROY (rframe);
-        if (dict)
-                dict_unref (dict);
+        if (index >= data_count)
+                index = 0;
 
-        return 0;
+        block = (size - 1) / stripe_size;
+        return (((block * data_count) + index) * stripe_size) +
+                ((size - 1) % stripe_size) + 1;
 }
 
-int32_t
-stripe_lookup_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
-                   int32_t op_ret, int32_t op_errno, inode_t *inode,
-                   struct iatt *buf, dict_t *dict, struct iatt *postparent)
+/* stripe_file_size () for the iatt a child returned for 'ictx' */
+static off_t
+stripe_iatt_size (xlator_t *this, stripe_inode_ctx_t *ictx,
+                  xlator_t *child, struct iatt *buf)
 {
-        int32_t         callcnt = 0;
-        dict_t         *tmp_dict = NULL;
-        inode_t        *tmp_inode = NULL;
-        stripe_local_t *local = NULL;
-        call_frame_t   *prev = NULL;
-
-        if (!this || !frame || !frame->local || !cookie) {
-                gf_log ("stripe", GF_LOG_DEBUG, "possible NULL deref");
-                goto out;
-        }
+        if (!ictx || !ictx->coalesce || !IA_ISREG (buf->ia_type))
+                return buf->ia_size;
 
-        prev = cookie;
-        local = frame->local;
+        return stripe_file_size (ictx->stripe_size, ictx->data_count, 1,
+                                 stripe_child_index (this, child),
+                                 buf->ia_size);
+}
 
-        LOCK (&frame->lock);
-        {
-                callcnt = --local->call_count;
 
-                if (op_ret == -1) {
-                        if (op_errno != ENOENT)
-                                gf_log (this->name, GF_LOG_DEBUG,
-                                        "%s returned error %s",
-                                        prev->this->name,
-                                        strerror (op_errno));
-                        if (local->op_errno != ESTALE)
-                                local->op_errno = op_errno;
-                        if (((op_errno != ENOENT) && (op_errno != ENOTCONN)) ||
-                            (prev->this == FIRST_CHILD (this)))
-                                local->failed = 1;
-                        if (op_errno == ENOENT)
-                                local->entry_self_heal_needed = 1;
-                }
+/*
+ * Erasure coding: degraded reads and parity updates walk the stripes of
+ * a range one at a time, fetching the fragments of a stripe in parallel.
+ */
 
-                if (op_ret >= 0) {
-                        local->op_ret = 0;
+/* Lets the next queued parity update of the inode go, if any */
+static struct stripe_ec_io *
+stripe_ec_inode_next (xlator_t *this, inode_t *inode)
+{
+        stripe_inode_ctx_t   *ictx = NULL;
+        struct stripe_ec_io *next = NULL;
 
-                        if (FIRST_CHILD(this) == prev->this) {
-                                local->stbuf      = *buf;
-                                local->postparent = *postparent;
-                                local->inode = inode_ref (inode);
-                                local->dict = dict_ref (dict);
-                        }
-                        local->stbuf_blocks      += buf->ia_blocks;
-                        local->postparent_blocks += postparent->ia_blocks;
+        ictx = stripe_inode_ctx_get (this, inode);
+        if (!ictx)
+                return NULL;
 
-                        if (local->stbuf_size < buf->ia_size)
-                                local->stbuf_size = buf->ia_size;
-                        if (local->postparent_size < postparent->ia_size)
-                                local->postparent_size = postparent->ia_size;
+        LOCK (&ictx->lock);
+        {
+                if (list_empty (&ictx->waiting)) {
+                        ictx->busy = 0;
+                } else {
+                        next = list_entry (ictx->waiting.next,
+                                           struct stripe_ec_io, list);
+                        list_del_init (&next->list);
                 }
         }
-        UNLOCK (&frame->lock);
+        UNLOCK (&ictx->lock);
 
-        if (!callcnt) {
-                if (local->op_ret == 0 && local->entry_self_heal_needed)
-                        stripe_entry_self_heal (frame, this, local);
+        return next;
+}
 
-                if (local->failed)
-                        local->op_ret = -1;
+static struct stripe_ec_io *
+stripe_ec_io_new (call_frame_t *frame, stripe_fd_ctx_t *fctx, int fop,
+                  off_t offset, off_t end)
+{
+        struct stripe_ec_io *ec = NULL;
+        off_t                stripe_len = 0;
 
-                tmp_dict  = local->dict;
-                tmp_inode = local->inode;
+        stripe_len = fctx->stripe_size * fctx->data_count;
 
-                if (local->op_ret != -1) {
-                        local->stbuf.ia_blocks      = local->stbuf_blocks;
-                        local->stbuf.ia_size        = local->stbuf_size;
-                        local->postparent.ia_blocks = local->postparent_blocks;
-                        local->postparent.ia_size   = local->postparent_size;
-                }
+        ec = GF_CALLOC (1, sizeof (*ec), gf_stripe_mt_ec_io_t);
+        if (!ec)
+                goto err;
 
-                STRIPE_STACK_UNWIND (lookup, frame, local->op_ret,
-                                     local->op_errno, local->inode,
-                                     &local->stbuf, local->dict,
-                                     &local->postparent);
+        ec->buf = GF_MALLOC (fctx->stripe_count * fctx->stripe_size,
+                             gf_stripe_mt_char);
+        ec->len = GF_CALLOC (fctx->stripe_count, sizeof (int32_t),
+                             gf_stripe_mt_ec_io_t);
+        if (!ec->buf || !ec->len)
+                goto err;
 
-                if (tmp_inode)
-                        inode_unref (tmp_inode);
-                if (tmp_dict)
-                        dict_unref (tmp_dict);
-        }
-out:
-        return 0;
+        INIT_LIST_HEAD (&ec->list);
+        ec->frame  = frame;
+        ec->fop    = fop;
+        ec->stripe = floor (offset, stripe_len);
+        ec->end    = end;
+
+        return ec;
+err:
+        if (ec) {
+                if (ec->buf)
+                        GF_FREE (ec->buf);
+                if (ec->len)
+                        GF_FREE (ec->len);
+                GF_FREE (ec);
+        }
+        return NULL;
 }
 
-int32_t
-stripe_lookup (call_frame_t *frame, xlator_t *this, loc_t *loc,
-               dict_t *xattr_req)
+void
+stripe_ec_io_free (struct stripe_ec_io *ec)
 {
-        stripe_local_t   *local = NULL;
-        xlator_list_t    *trav = NULL;
-        stripe_private_t *priv = NULL;
-        int32_t           op_errno = EINVAL;
+        if (ec->iobref)
+                iobref_unref (ec->iobref);
+        if (ec->vector)
+                GF_FREE (ec->vector);
+        GF_FREE (ec->buf);
+        GF_FREE (ec->len);
+        GF_FREE (ec);
+}
 
-        VALIDATE_OR_GOTO (frame, err);
-        VALIDATE_OR_GOTO (this, err);
-        VALIDATE_OR_GOTO (loc, err);
-        VALIDATE_OR_GOTO (loc->path, err);
-        VALIDATE_OR_GOTO (loc->inode, err);
+static void stripe_ec_fetch (call_frame_t *frame, xlator_t *this);
+static void stripe_ec_lock (call_frame_t *frame, xlator_t *this);
+static void stripe_ec_unlock (call_frame_t *frame, xlator_t *this);
+static void stripe_ec_store_size (call_frame_t *frame, xlator_t *this);
+static void stripe_ec_size_fetch (call_frame_t *frame, xlator_t *this);
+
+/* Ends the fop, first recording the file size with the parity after an
+   update and dropping the lock of the range */
+static void
+stripe_ec_finish (call_frame_t *frame, xlator_t *this, int32_t op_ret,
+                  int32_t op_errno)
+{
+        stripe_local_t      *local = NULL;
+        struct stripe_ec_io *ec = NULL;
+        struct stripe_ec_io *next = NULL;
+        fd_t                *fd = NULL;
 
-        priv = this->private;
-        trav = this->children;
+        local = frame->local;
+        ec    = local->ec;
+        fd    = local->fd;
 
-        /* Initialization */
-        local = GF_CALLOC (1, sizeof (stripe_local_t),
-                           gf_stripe_mt_stripe_local_t);
-        if (!local) {
-                op_errno = ENOMEM;
-                goto err;
+        if ((op_ret == -1) && !ec->error)
+                ec->error = op_errno ? op_errno : EIO;
+
+        if ((ec->fop != GF_FOP_READ) && !ec->error && !ec->size_stored) {
+                ec->size_stored = 1;
+                stripe_ec_store_size (frame, this);
+                return;
         }
-        local->op_ret = -1;
-        frame->local = local;
-        loc_copy (&local->loc, loc);
 
-        /* Everytime in stripe lookup, all child nodes
-           should be looked up */
-        local->call_count = priv->child_count;
-        while (trav) {
-                STACK_WIND (frame, stripe_lookup_cbk, trav->xlator,
-                            trav->xlator->fops->lookup,
-                            loc, xattr_req);
-                trav = trav->next;
+        if (ec->locked) {
+                ec->locked = 0;
+                stripe_ec_unlock (frame, this);
+                return;
         }
 
-        return 0;
-err:
-        STRIPE_STACK_UNWIND (lookup, frame, -1, op_errno, NULL, NULL, NULL, NULL);
-        return 0;
-}
+        if (ec->fop == GF_FOP_READ) {
+                local->stbuf.ia_size = ec->size;
+                STRIPE_STACK_UNWIND (readv, frame, ec->error ? -1 : ec->done,
+                                     ec->error, ec->vector, ec->count,
+                                     &local->stbuf, ec->iobref);
+                fd_unref (fd);
+                return;
+        }
 
+        next = stripe_ec_inode_next (this, fd->inode);
 
-int32_t
-stripe_stat_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
-                 int32_t op_ret, int32_t op_errno, struct iatt *buf)
-{
-        int32_t         callcnt = 0;
-        stripe_local_t *local = NULL;
-        call_frame_t   *prev = NULL;
-
-        if (!this || !frame || !frame->local || !cookie) {
-                gf_log ("stripe", GF_LOG_DEBUG, "possible NULL deref");
-                goto out;
+        if (ec->error) {
+                local->op_ret   = -1;
+                local->op_errno = ec->error;
         }
-        prev  = cookie;
-        local = frame->local;
 
-        LOCK (&frame->lock);
-        {
-                callcnt = --local->call_count;
+        if (ec->fop == GF_FOP_WRITE)
+                STRIPE_STACK_UNWIND (writev, frame, local->op_ret,
+                                     local->op_errno, &local->pre_buf,
+                                     &local->post_buf);
+        else
+                STRIPE_STACK_UNWIND (ftruncate, frame, local->op_ret,
+                                     local->op_errno, &local->pre_buf,
+                                     &local->post_buf);
+        fd_unref (fd);
 
-                if (op_ret == -1) {
-                        gf_log (this->name, GF_LOG_DEBUG,
-                                "%s returned error %s",
-                                prev->this->name, strerror (op_errno));
-                        local->op_errno = op_errno;
-                        if ((op_errno != ENOENT) ||
-                            (prev->this == FIRST_CHILD (this)))
-                                local->failed = 1;
-                }
+        if (next)
+                stripe_ec_lock (next->frame, this);
+}
 
-                if (op_ret == 0) {
-                        local->op_ret = 0;
+/* Parity child 0 carries the lock and the logical size of the file: a
+   missing last block leaves nothing else to tell the size from */
+static void
+stripe_ec_size_key (xlator_t *this, char *key)
+{
+        sprintf (key, "trusted.%s.stripe-ec-size", this->name);
+}
 
-                        if (FIRST_CHILD(this) == prev->this) {
-                                local->stbuf = *buf;
-                        }
+int32_t
+stripe_ec_lock_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                    int32_t op_ret, int32_t op_errno)
+{
+        stripe_local_t      *local = NULL;
+        struct stripe_ec_io *ec = NULL;
 
-                        local->stbuf_blocks += buf->ia_blocks;
-                        if (local->stbuf_size < buf->ia_size)
-                                local->stbuf_size = buf->ia_size;
+        local = frame->local;
+        ec    = local->ec;
+
+        if (op_ret == -1) {
+                gf_log (this->name, GF_LOG_DEBUG,
+                        "locking stripes at %"PRId64" failed: %s",
+                        ec->stripe, strerror (op_errno));
+                /* a degraded read goes on without parity child 0 */
+                if (ec->fop != GF_FOP_READ) {
+                        stripe_ec_finish (frame, this, -1, op_errno);
+                        return 0;
                 }
+        } else {
+                ec->locked = 1;
         }
-        UNLOCK (&frame->lock);
-
-        if (!callcnt) {
-                if (local->failed)
-                        local->op_ret = -1;
 
-                if (local->op_ret != -1) {
-                        local->stbuf.ia_size   = local->stbuf_size;
-                        local->stbuf.ia_blocks = local->stbuf_blocks;
-                }
+        if (ec->fop == GF_FOP_READ)
+                stripe_ec_size_fetch (frame, this);
+        else
+                stripe_ec_fetch (frame, this);
 
-                STRIPE_STACK_UNWIND (stat, frame, local->op_ret,
-                                     local->op_errno, &local->stbuf);
-        }
-out:
         return 0;
 }
 
-int32_t
-stripe_stat (call_frame_t *frame, xlator_t *this, loc_t *loc)
+/* Locks the stripes of the range on parity child 0, shared for degraded
+   reads, so that updates from other clients do not interleave with the
+   fetch and parity write of this one */
+static void
+stripe_ec_lock (call_frame_t *frame, xlator_t *this)
 {
-        xlator_list_t    *trav = NULL;
-        stripe_local_t   *local = NULL;
-        stripe_private_t *priv = NULL;
-        int32_t           op_errno = EINVAL;
-
-        VALIDATE_OR_GOTO (frame, err);
-        VALIDATE_OR_GOTO (this, err);
-        VALIDATE_OR_GOTO (loc, err);
-        VALIDATE_OR_GOTO (loc->path, err);
-        VALIDATE_OR_GOTO (loc->inode, err);
+        stripe_local_t      *local = NULL;
+        stripe_fd_ctx_t     *fctx = NULL;
+        struct stripe_ec_io *ec = NULL;
+        xlator_t            *child = NULL;
+        off_t                stripe_len = 0;
 
-        priv = this->private;
-        trav = this->children;
+        local      = frame->local;
+        fctx       = local->fctx;
+        ec         = local->ec;
+        child      = fctx->xl_array[fctx->data_count];
+        stripe_len = fctx->stripe_size * fctx->data_count;
 
-        if (priv->first_child_down) {
-                op_errno = ENOTCONN;
-                goto err;
+        if (!child) {
+                stripe_ec_lock_cbk (frame, NULL, this, -1, ENOTCONN);
+                return;
         }
 
-        /* Initialization */
-        local = GF_CALLOC (1, sizeof (stripe_local_t),
-                           gf_stripe_mt_stripe_local_t);
-        if (!local) {
-                op_errno = ENOMEM;
-                goto err;
-        }
-        local->op_ret = -1;
-        frame->local = local;
-        local->call_count = priv->child_count;
+        /* lk-owner 0 would release every lock of the client */
+        frame->root->lk_owner = (uint64_t) (unsigned long)frame->root;
 
-        while (trav) {
-                STACK_WIND (frame, stripe_stat_cbk, trav->xlator,
-                            trav->xlator->fops->stat, loc);
-                trav = trav->next;
-        }
+        ec->flock.l_type   = (ec->fop == GF_FOP_READ) ? F_RDLCK : F_WRLCK;
+        ec->flock.l_whence = SEEK_SET;
+        ec->flock.l_start  = ec->stripe;
+        ec->flock.l_len    = roof (ec->end, stripe_len) - ec->stripe;
 
-        return 0;
+        STACK_WIND (frame, stripe_ec_lock_cbk, child, child->fops->finodelk,
+                    this->name, local->fd, F_SETLKW, &ec->flock);
+}
 
-err:
-        STRIPE_STACK_UNWIND (stat, frame, -1, op_errno, NULL);
+int32_t
+stripe_ec_unlock_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                      int32_t op_ret, int32_t op_errno)
+{
+        if (op_ret == -1)
+                gf_log (this->name, GF_LOG_DEBUG,
+                        "unlocking stripes failed: %s", strerror (op_errno));
+
+        stripe_ec_finish (frame, this, 0, 0);
         return 0;
 }
 
+static void
+stripe_ec_unlock (call_frame_t *frame, xlator_t *this)
+{
+        stripe_local_t      *local = NULL;
+        struct stripe_ec_io *ec = NULL;
+        xlator_t            *child = NULL;
+
+        local = frame->local;
+        ec    = local->ec;
+        child = local->fctx->xl_array[local->fctx->data_count];
+
+        ec->flock.l_type = F_UNLCK;
+
+        STACK_WIND (frame, stripe_ec_unlock_cbk, child, child->fops->finodelk,
+                    this->name, local->fd, F_SETLK, &ec->flock);
+}
 
 int32_t
-stripe_statfs_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
-                   int32_t op_ret, int32_t op_errno, struct statvfs *stbuf)
+stripe_ec_store_size_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                          int32_t op_ret, int32_t op_errno)
 {
-        stripe_local_t *local = NULL;
-        int32_t         callcnt = 0;
+        stripe_local_t      *local = NULL;
+        struct stripe_ec_io *ec = NULL;
+        int32_t              callcnt = 0;
 
-        if (!this || !frame || !frame->local) {
-                gf_log ("stripe", GF_LOG_DEBUG, "possible NULL deref");
-                goto out;
-        }
         local = frame->local;
+        ec    = local->ec;
 
-        LOCK(&frame->lock);
+        LOCK (&frame->lock);
         {
-                callcnt = --local->call_count;
-
-                if (op_ret && (op_errno != ENOTCONN)) {
-                        local->op_errno = op_errno;
-                }
-                if (op_ret == 0) {
-                        struct statvfs *dict_buf = &local->statvfs_buf;
-                        dict_buf->f_bsize   = stbuf->f_bsize;
-                        dict_buf->f_frsize  = stbuf->f_frsize;
-                        dict_buf->f_blocks += stbuf->f_blocks;
-                        dict_buf->f_bfree  += stbuf->f_bfree;
-                        dict_buf->f_bavail += stbuf->f_bavail;
-                        dict_buf->f_files  += stbuf->f_files;
-                        dict_buf->f_ffree  += stbuf->f_ffree;
-                        dict_buf->f_favail += stbuf->f_favail;
-                        dict_buf->f_fsid    = stbuf->f_fsid;
-                        dict_buf->f_flag    = stbuf->f_flag;
-                        dict_buf->f_namemax = stbuf->f_namemax;
-                        local->op_ret = 0;
+                callcnt = --ec->call_count;
+                if (op_ret == -1) {
+                        gf_log (this->name, GF_LOG_DEBUG,
+                                "storing the size on parity %ld failed: %s",
+                                (long)cookie, strerror (op_errno));
+                        ec->failed   = 1;
+                        ec->op_errno = op_errno;
                 }
         }
         UNLOCK (&frame->lock);
 
-        if (!callcnt) {
-                STRIPE_STACK_UNWIND (statfs, frame, local->op_ret,
-                                     local->op_errno, &local->statvfs_buf);
-        }
+        if (callcnt)
+                goto out;
+
+        if (ec->failed)
+                stripe_ec_finish (frame, this, -1, ec->op_errno);
+        else
+                stripe_ec_finish (frame, this, 0, 0);
 out:
         return 0;
 }
 
-int32_t
-stripe_statfs (call_frame_t *frame, xlator_t *this, loc_t *loc)
+/* Records the file size the update left, as seen by the fetch of the
+   data fragments, on every parity child */
+static void
+stripe_ec_store_size (call_frame_t *frame, xlator_t *this)
 {
-        stripe_local_t   *local = NULL;
-        xlator_list_t    *trav = NULL;
-        stripe_private_t *priv = NULL;
-        int32_t           op_errno = EINVAL;
+        stripe_local_t      *local = NULL;
+        stripe_fd_ctx_t     *fctx = NULL;
+        struct stripe_ec_io *ec = NULL;
+        dict_t              *dict = NULL;
+        xlator_t            *child = NULL;
+        char                 key[256] = {0,};
+        int                  j = 0;
 
-        VALIDATE_OR_GOTO (frame, err);
-        VALIDATE_OR_GOTO (this, err);
-        VALIDATE_OR_GOTO (loc, err);
+        local = frame->local;
+        fctx  = local->fctx;
+        ec    = local->ec;
 
-        trav = this->children;
-        priv = this->private;
+        dict = dict_new ();
+        stripe_ec_size_key (this, key);
+        if (!dict || dict_set_uint64 (dict, key, ec->size)) {
+                if (dict)
+                        dict_unref (dict);
+                stripe_ec_finish (frame, this, -1, ENOMEM);
+                return;
+        }
 
-        /* Initialization */
-        local = GF_CALLOC (1, sizeof (stripe_local_t),
-                           gf_stripe_mt_stripe_local_t);
-        if (!local) {
-                op_errno = ENOMEM;
-                goto err;
+        ec->call_count = 0;
+        ec->failed     = 0;
+        for (j = 0; j < fctx->redundancy; j++)
+                if (fctx->xl_array[fctx->data_count + j])
+                        ec->call_count++;
+
+        if (!ec->call_count) {
+                dict_unref (dict);
+                stripe_ec_finish (frame, this, -1, ENOTCONN);
+                return;
         }
-        local->op_ret = -1;
-        local->op_errno = ENOTCONN;
-        frame->local = local;
 
-        local->call_count = priv->child_count;
-        while (trav) {
-                STACK_WIND (frame, stripe_statfs_cbk, trav->xlator,
-                            trav->xlator->fops->statfs, loc);
-                trav = trav->next;
+        for (j = 0; j < fctx->redundancy; j++) {
+                child = fctx->xl_array[fctx->data_count + j];
+                if (!child)
+                        continue;
+                STACK_WIND_COOKIE (frame, stripe_ec_store_size_cbk,
+                                   (void *)(long)j, child,
+                                   child->fops->fsetxattr, local->fd, dict, 0);
         }
 
-        return 0;
-err:
-        STRIPE_STACK_UNWIND (statfs, frame, -1, op_errno, NULL);
-        return 0;
+        dict_unref (dict);
 }
 
-
-
 int32_t
-stripe_truncate_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
-                     int32_t op_ret, int32_t op_errno, struct iatt *prebuf,
-                     struct iatt *postbuf)
+stripe_ec_size_fetch_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                          int32_t op_ret, int32_t op_errno, dict_t *dict)
 {
-        int32_t         callcnt = 0;
-        stripe_local_t *local = NULL;
-        call_frame_t   *prev = NULL;
-
-        if (!this || !frame || !frame->local || !cookie) {
-                gf_log ("stripe", GF_LOG_DEBUG, "possible NULL deref");
-                goto out;
-        }
+        stripe_local_t      *local = NULL;
+        struct stripe_ec_io *ec = NULL;
+        char                 key[256] = {0,};
+        uint64_t             size = 0;
 
-        prev  = cookie;
         local = frame->local;
+        ec    = local->ec;
 
-        LOCK (&frame->lock);
-        {
-                callcnt = --local->call_count;
+        stripe_ec_size_key (this, key);
+        if ((op_ret == -1) || !dict || dict_get_uint64 (dict, key, &size))
+                gf_log (this->name, GF_LOG_DEBUG,
+                        "no size on parity %ld, going by the fragments",
+                        (long)cookie);
+        else
+                ec->size = size;
 
-                if (op_ret == -1) {
-                        gf_log (this->name, GF_LOG_DEBUG,
-                                "%s returned error %s",
-                                prev->this->name, strerror (op_errno));
-                        local->op_errno = op_errno;
-                        if ((op_errno != ENOENT) ||
-                            (prev->this == FIRST_CHILD (this)))
-                                local->failed = 1;
-                }
+        stripe_ec_fetch (frame, this);
+        return 0;
+}
 
-                if (op_ret == 0) {
-                        local->op_ret = 0;
-                        if (FIRST_CHILD(this) == prev->this) {
-                                local->pre_buf  = *prebuf;
-                                local->post_buf = *postbuf;
-                        }
+/* A degraded read takes the file size from the first parity child up */
+static void
+stripe_ec_size_fetch (call_frame_t *frame, xlator_t *this)
+{
+        stripe_local_t      *local = NULL;
+        stripe_fd_ctx_t     *fctx = NULL;
+        xlator_t            *child = NULL;
+        char                 key[256] = {0,};
+        int                  j = 0;
 
-                        local->prebuf_blocks  += prebuf->ia_blocks;
-                        local->postbuf_blocks += postbuf->ia_blocks;
+        local = frame->local;
+        fctx  = local->fctx;
 
-                        if (local->prebuf_size < prebuf->ia_size)
-                                local->prebuf_size = prebuf->ia_size;
+        for (j = 0; j < fctx->redundancy; j++) {
+                child = fctx->xl_array[fctx->data_count + j];
+                if (child)
+                        break;
+        }
 
-                        if (local->postbuf_size < postbuf->ia_size)
-                                local->postbuf_size = postbuf->ia_size;
-                }
+        if (!child) {
+                stripe_ec_fetch (frame, this);
+                return;
         }
-        UNLOCK (&frame->lock);
 
-        if (!callcnt) {
-                if (local->failed)
-                        local->op_ret = -1;
+        stripe_ec_size_key (this, key);
+        STACK_WIND_COOKIE (frame, stripe_ec_size_fetch_cbk, (void *)(long)j,
+                           child, child->fops->fgetxattr, local->fd, key);
+}
 
-                if (local->op_ret != -1) {
-                        local->pre_buf.ia_blocks  = local->prebuf_blocks;
-                        local->pre_buf.ia_size    = local->prebuf_size;
-                        local->post_buf.ia_blocks = local->postbuf_blocks;
-                        local->post_buf.ia_size   = local->postbuf_size;
+/* Appends to the degraded readv reply, packing the iobufs */
+static int
+stripe_ec_copy_out (xlator_t *this, struct stripe_ec_io *ec, char *data,
+                    size_t len)
+{
+        struct iobuf *iobuf = NULL;
+        struct iovec *last = NULL;
+        size_t        page = 0;
+        size_t        chunk = 0;
+
+        page = iobpool_pagesize ((struct iobuf_pool *)this->ctx->iobuf_pool);
+
+        while (len) {
+                last = ec->count ? &ec->vector[ec->count - 1] : NULL;
+                if (!last || (last->iov_len == page)) {
+                        if (ec->count == ec->max_count)
+                                return -1;
+                        iobuf = iobuf_get (this->ctx->iobuf_pool);
+                        if (!iobuf)
+                                return -1;
+                        if (iobref_add (ec->iobref, iobuf)) {
+                                iobuf_unref (iobuf);
+                                return -1;
+                        }
+                        iobuf_unref (iobuf);
+                        last = &ec->vector[ec->count++];
+                        last->iov_base = iobuf->ptr;
+                        last->iov_len  = 0;
                 }
 
-                STRIPE_STACK_UNWIND (truncate, frame, local->op_ret,
-                                     local->op_errno, &local->pre_buf,
-                                     &local->post_buf);
+                chunk = min (len, page - last->iov_len);
+                memcpy ((char *)last->iov_base + last->iov_len, data, chunk);
+                last->iov_len += chunk;
+                ec->done      += chunk;
+                data          += chunk;
+                len           -= chunk;
         }
-out:
+
         return 0;
 }
 
 int32_t
-stripe_truncate (call_frame_t *frame, xlator_t *this, loc_t *loc, off_t offset)
+stripe_ec_parity_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                      int32_t op_ret, int32_t op_errno, struct iatt *prebuf,
+                      struct iatt *postbuf)
 {
-        xlator_list_t    *trav = NULL;
-        stripe_local_t   *local = NULL;
-        stripe_private_t *priv = NULL;
-        int32_t           op_errno = EINVAL;
-
-        VALIDATE_OR_GOTO (frame, err);
-        VALIDATE_OR_GOTO (this, err);
-        VALIDATE_OR_GOTO (loc, err);
-        VALIDATE_OR_GOTO (loc->path, err);
-        VALIDATE_OR_GOTO (loc->inode, err);
+        stripe_local_t      *local = NULL;
+        struct stripe_ec_io *ec = NULL;
+        int32_t              callcnt = 0;
 
-        priv = this->private;
-        trav = this->children;
+        local = frame->local;
+        ec    = local->ec;
 
-        if (priv->first_child_down) {
-                op_errno = ENOTCONN;
-                goto err;
+        LOCK (&frame->lock);
+        {
+                callcnt = --ec->call_count;
+                if (op_ret == -1) {
+                        gf_log (this->name, GF_LOG_DEBUG,
+                                "parity %ld returned error %s",
+                                (long)cookie, strerror (op_errno));
+                        ec->failed   = 1;
+                        ec->op_errno = op_errno;
+                }
         }
+        UNLOCK (&frame->lock);
 
-        /* Initialization */
-        local = GF_CALLOC (1, sizeof (stripe_local_t),
-                           gf_stripe_mt_stripe_local_t);
-        if (!local) {
-                op_errno = ENOMEM;
-                goto err;
-        }
-        local->op_ret = -1;
-        frame->local = local;
-        local->call_count = priv->child_count;
+        if (callcnt)
+                goto out;
 
-        while (trav) {
-                STACK_WIND (frame, stripe_truncate_cbk, trav->xlator,
-                            trav->xlator->fops->truncate, loc, offset);
-                trav = trav->next;
+        if (ec->failed) {
+                stripe_ec_finish (frame, this, -1, ec->op_errno);
+                goto out;
         }
 
-        return 0;
-err:
-        STRIPE_STACK_UNWIND (truncate, frame, -1, op_errno, NULL, NULL);
+        ec->stripe += local->fctx->stripe_size * local->fctx->data_count;
+        if (ec->stripe >= ec->end)
+                stripe_ec_finish (frame, this, 0, 0);
+        else
+                stripe_ec_fetch (frame, this);
+out:
         return 0;
 }
 
-
-int32_t
-stripe_setattr_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
-                    int32_t op_ret, int32_t op_errno,
-                    struct iatt *preop, struct iatt *postop)
+/* Writes 'len' bytes of parity at the start of the stripe, in chunks of
+   an iobuf each */
+static void
+stripe_ec_write_parity (call_frame_t *frame, xlator_t *this, size_t len)
 {
-        int32_t         callcnt = 0;
-        stripe_local_t *local = NULL;
-        call_frame_t   *prev = NULL;
+        stripe_local_t      *local = NULL;
+        stripe_fd_ctx_t     *fctx = NULL;
+        struct stripe_ec_io *ec = NULL;
+        struct iobuf        *iobuf = NULL;
+        struct iobref       *iobref = NULL;
+        struct iovec         vec = {0,};
+        xlator_t            *child = NULL;
+        size_t               page = 0;
+        size_t               chunk = 0;
+        size_t               done = 0;
+        off_t                stripe = 0;
+        char                *parity = NULL;
+        int                  redundancy = 0;
+        int                  chunks = 0;
+        int                  j = 0;
+
+        local      = frame->local;
+        fctx       = local->fctx;
+        ec         = local->ec;
+        stripe     = stripe_child_offset (fctx->stripe_size, fctx->data_count,
+                                          fctx->coalesce, ec->stripe);
+        redundancy = fctx->redundancy;
+        page       = iobpool_pagesize ((struct iobuf_pool *)this->ctx->iobuf_pool);
+        chunks     = (len + page - 1) / page;
+
+        ec->call_count = chunks * redundancy;
+        ec->failed     = 0;
+
+        for (j = 0; j < redundancy; j++) {
+                child  = fctx->xl_array[fctx->data_count + j];
+                parity = ec->buf + (fctx->data_count + j) * fctx->stripe_size;
+
+                for (done = 0; done < len; done += chunk) {
+                        chunk  = min (len - done, page);
+                        if (!child) {
+                                stripe_ec_parity_cbk (frame,
+                                                      (void *)(long)j, this,
+                                                      -1, ENOTCONN, NULL,
+                                                      NULL);
+                                continue;
+                        }
+                        iobuf  = iobuf_get (this->ctx->iobuf_pool);
+                        iobref = iobref_new ();
+                        if (!iobuf || !iobref) {
+                                if (iobuf)
+                                        iobuf_unref (iobuf);
+                                if (iobref)
+                                        iobref_unref (iobref);
+                                stripe_ec_parity_cbk (frame,
+                                                      (void *)(long)j, this,
+                                                      -1, ENOMEM, NULL, NULL);
+                                continue;
+                        }
+                        memcpy (iobuf->ptr, parity + done, chunk);
+                        iobref_add (iobref, iobuf);
+                        vec.iov_base = iobuf->ptr;
+                        vec.iov_len  = chunk;
+
+                        STACK_WIND_COOKIE (frame, stripe_ec_parity_cbk,
+                                           (void *)(long)j, child,
+                                           child->fops->writev, local->fd,
+                                           &vec, 1, stripe + done, iobref);
+
+                        iobuf_unref (iobuf);
+                        iobref_unref (iobref);
+                }
+        }
+}
 
-        if (!this || !frame || !frame->local || !cookie) {
-                gf_log ("stripe", GF_LOG_DEBUG, "possible NULL deref");
-                goto out;
+/* All the fragments of the stripe in flight are in: rebuild what is
+   missing, then serve the read or refresh the parity */
+static void
+stripe_ec_stripe_done (call_frame_t *frame, xlator_t *this)
+{
+        stripe_local_t      *local = NULL;
+        stripe_fd_ctx_t     *fctx = NULL;
+        struct stripe_ec_io *ec = NULL;
+        unsigned char       *frags[STRIPE_EC_MAX_FRAGMENTS];
+        int                  valid[STRIPE_EC_MAX_FRAGMENTS];
+        off_t                stripe_len = 0;
+        off_t                from = 0;
+        off_t                to = 0;
+        off_t                len = 0;
+        int                  i = 0;
+
+        local      = frame->local;
+        fctx       = local->fctx;
+        ec         = local->ec;
+        stripe_len = fctx->stripe_size * fctx->data_count;
+
+        /* Bytes of the first data fragment, which is also how much parity
+           the stripe has: the rest of the stripe is beyond EOF otherwise */
+        len = min (fctx->stripe_size, ec->size - ec->stripe);
+        if (len <= 0) {
+                stripe_ec_finish (frame, this, 0, 0);
+                return;
+        }
+
+        for (i = 0; i < fctx->stripe_count; i++) {
+                frags[i] = (unsigned char *)ec->buf + i * fctx->stripe_size;
+                if (i < fctx->data_count)
+                        valid[i] = (ec->len[i] >= 0);
+                else
+                        valid[i] = (ec->len[i] >= len);
+        }
+
+        if (ec->fop != GF_FOP_READ) {
+                for (i = 0; i < fctx->data_count; i++) {
+                        if (!valid[i]) {
+                                gf_log (this->name, GF_LOG_WARNING,
+                                        "fragment %d of stripe at %"PRId64
+                                        " unreadable, parity not updated",
+                                        i, ec->stripe);
+                                stripe_ec_finish (frame, this, -1,
+                                                  ec->op_errno ?
+                                                  ec->op_errno : EIO);
+                                return;
+                        }
+                }
+                stripe_ec_encode (fctx->data_count, fctx->redundancy, len,
+                                  frags, frags + fctx->data_count);
+                stripe_ec_write_parity (frame, this, len);
+                return;
         }
 
-        prev  = cookie;
+        if (stripe_ec_decode (fctx->data_count, fctx->redundancy, len,
+                              frags, valid)) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "stripe at %"PRId64" has less than %d good "
+                        "fragments", ec->stripe, fctx->data_count);
+                stripe_ec_finish (frame, this, -1, EIO);
+                return;
+        }
+
+        /* data fragments are adjacent in the buffer */
+        from = max (ec->stripe, local->offset);
+        to   = min (min (ec->stripe + stripe_len, ec->end), ec->size);
+        if ((to > from) &&
+            stripe_ec_copy_out (this, ec, ec->buf + (from - ec->stripe),
+                                to - from)) {
+                stripe_ec_finish (frame, this, -1, ENOMEM);
+                return;
+        }
+
+        ec->stripe += stripe_len;
+        if ((ec->stripe >= ec->end) || (ec->stripe >= ec->size))
+                stripe_ec_finish (frame, this, 0, 0);
+        else
+                stripe_ec_fetch (frame, this);
+}
+
+int32_t
+stripe_ec_fetch_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                     int32_t op_ret, int32_t op_errno, struct iovec *vector,
+                     int32_t count, struct iatt *stbuf, struct iobref *iobref)
+{
+        stripe_local_t      *local = NULL;
+        struct stripe_ec_io *ec = NULL;
+        char                *frag = NULL;
+        int32_t              callcnt = 0;
+        int                  index = 0;
+        off_t                size = 0;
+
         local = frame->local;
+        ec    = local->ec;
+        index = (long)cookie;
+        frag  = ec->buf + index * local->fctx->stripe_size;
+
+        if (op_ret >= 0) {
+                iov_unload (frag, vector, count);
+                memset (frag + op_ret, 0, local->fctx->stripe_size - op_ret);
+        }
 
         LOCK (&frame->lock);
         {
-                callcnt = --local->call_count;
-
+                callcnt = --ec->call_count;
                 if (op_ret == -1) {
                         gf_log (this->name, GF_LOG_DEBUG,
-                                "%s returned error %s",
-                                prev->this->name, strerror (op_errno));
-                        local->op_errno = op_errno;
-                        if ((op_errno != ENOENT) ||
-                            (prev->this == FIRST_CHILD (this)))
-                                local->failed = 1;
-                }
-
-                if (op_ret == 0) {
-                        local->op_ret = 0;
-
-                        if (FIRST_CHILD(this) == prev->this) {
-                                local->pre_buf  = *preop;
-                                local->post_buf = *postop;
-                        }
-
-                        local->prebuf_blocks  += preop->ia_blocks;
-                        local->postbuf_blocks += postop->ia_blocks;
-
-                        if (local->prebuf_size < preop->ia_size)
-                                local->prebuf_size = preop->ia_size;
-                        if (local->postbuf_size < postop->ia_size)
-                                local->postbuf_size = postop->ia_size;
+                                "fragment %d returned error %s",
+                                index, strerror (op_errno));
+                        ec->op_errno = op_errno;
+                        ec->len[index] = -1;
+                } else {
+                        ec->len[index] = op_ret;
+                        local->stbuf   = *stbuf;
+                        /* parity holds whole stripes, no hint there */
+                        if (index < local->fctx->data_count)
+                                size = stripe_file_size (local->fctx->stripe_size,
+                                                         local->fctx->data_count,
+                                                         local->fctx->coalesce,
+                                                         index, stbuf->ia_size);
+                        if (ec->size < size)
+                                ec->size = size;
                 }
         }
         UNLOCK (&frame->lock);
 
-        if (!callcnt) {
-                if (local->failed)
-                        local->op_ret = -1;
-
-                if (local->op_ret != -1) {
-                        local->pre_buf.ia_blocks  = local->prebuf_blocks;
-                        local->pre_buf.ia_size    = local->prebuf_size;
-                        local->post_buf.ia_blocks = local->postbuf_blocks;
-                        local->post_buf.ia_size   = local->postbuf_size;
-                }
+        if (!callcnt)
+                stripe_ec_stripe_done (frame, this);
 
-                STRIPE_STACK_UNWIND (setattr, frame, local->op_ret,
-                                     local->op_errno, &local->pre_buf,
-                                     &local->post_buf);
-        }
-out:
         return 0;
 }
 
-
-int32_t
-stripe_setattr (call_frame_t *frame, xlator_t *this, loc_t *loc,
-                struct iatt *stbuf, int32_t valid)
+/* Reads the data fragments of the stripe in flight, and for degraded
+   reads its parity too. Data fragment 'i' is at its usual place in the
+   file, parity is where the stripe starts (both through
+   stripe_child_offset () for coalesced files). */
+static void
+stripe_ec_fetch (call_frame_t *frame, xlator_t *this)
 {
-        xlator_list_t    *trav = NULL;
-        stripe_local_t   *local = NULL;
-        stripe_private_t *priv = NULL;
-        int32_t           op_errno = EINVAL;
+        stripe_local_t      *local = NULL;
+        stripe_fd_ctx_t     *fctx = NULL;
+        struct stripe_ec_io *ec = NULL;
+        off_t                stripe = 0;
+        int                  count = 0;
+        int                  i = 0;
 
-        VALIDATE_OR_GOTO (frame, err);
-        VALIDATE_OR_GOTO (this, err);
-        VALIDATE_OR_GOTO (loc, err);
-        VALIDATE_OR_GOTO (loc->path, err);
-        VALIDATE_OR_GOTO (loc->inode, err);
+        local  = frame->local;
+        fctx   = local->fctx;
+        ec     = local->ec;
+        stripe = ec->stripe;
+        count  = (ec->fop == GF_FOP_READ) ? fctx->stripe_count :
+                 fctx->data_count;
+
+        ec->call_count = 0;
+        ec->op_errno   = 0;
+        for (i = 0; i < fctx->stripe_count; i++) {
+                ec->len[i] = -1;
+                if ((i < count) && fctx->xl_array[i])
+                        ec->call_count++;
+        }
+
+        if (!ec->call_count) {
+                stripe_ec_finish (frame, this, -1, ENOTCONN);
+                return;
+        }
+
+        for (i = 0; i < count; i++) {
+                if (!fctx->xl_array[i])
+                        continue;
+                STACK_WIND_COOKIE (frame, stripe_ec_fetch_cbk,
+                                   (void *)(long)i, fctx->xl_array[i],
+                                   fctx->xl_array[i]->fops->readv, local->fd,
+                                   fctx->stripe_size,
+                                   stripe_child_offset (fctx->stripe_size,
+                                                        fctx->data_count,
+                                                        fctx->coalesce,
+                                                        (i < fctx->data_count) ?
+                                                        (stripe + i *
+                                                         fctx->stripe_size) :
+                                                        stripe));
+        }
+}
 
-        priv = this->private;
-        trav = this->children;
+/**
+ * stripe_ec_readv - serve the readv described by the frame's local from
+ *     whichever fragments are available, rebuilding the missing ones.
+ */
+void
+stripe_ec_readv (call_frame_t *frame, xlator_t *this)
+{
+        stripe_local_t      *local = NULL;
+        stripe_fd_ctx_t     *fctx = NULL;
+        struct stripe_ec_io *ec = NULL;
+        off_t                stripe_len = 0;
+        fd_t                *fd = NULL;
+        int                  i = 0;
 
-        if (priv->first_child_down) {
-                op_errno = ENOTCONN;
-                goto err;
+        local = frame->local;
+        fctx  = local->fctx;
+        fd    = local->fd;
+
+        if (local->replies) {
+                for (i = 0; i < local->wind_count; i++)
+                        if (local->replies[i].vector)
+                                GF_FREE (local->replies[i].vector);
+                GF_FREE (local->replies);
+                local->replies = NULL;
+        }
+        if (local->iobref) {
+                iobref_unref (local->iobref);
+                local->iobref = NULL;
         }
 
-        /* Initialization */
-        local = GF_CALLOC (1, sizeof (stripe_local_t),
-                           gf_stripe_mt_stripe_local_t);
-        if (!local) {
-                op_errno = ENOMEM;
+        ec = stripe_ec_io_new (frame, fctx, GF_FOP_READ, local->offset,
+                               local->offset + local->readv_size);
+        if (!ec)
+                goto err;
+        local->ec = ec;
+
+        stripe_len    = fctx->stripe_size * fctx->data_count;
+        ec->max_count = (local->readv_size /
+                         iobpool_pagesize ((struct iobuf_pool *)this->ctx->iobuf_pool)) + 2;
+        ec->vector    = GF_CALLOC (ec->max_count, sizeof (struct iovec),
+                                   gf_stripe_mt_iovec);
+        ec->iobref    = iobref_new ();
+        if (!ec->vector || !ec->iobref)
                 goto err;
-        }
-        local->op_ret = -1;
-        frame->local = local;
-        local->call_count = priv->child_count;
 
-        while (trav) {
-                STACK_WIND (frame, stripe_setattr_cbk,
-                            trav->xlator, trav->xlator->fops->setattr,
-                            loc, stbuf, valid);
-                trav = trav->next;
-        }
+        gf_log (this->name, GF_LOG_DEBUG,
+                "degraded read of %"GF_PRI_SIZET" bytes at %"PRId64
+                " (%"PRId64" stripes)", local->readv_size, local->offset,
+                (ec->end - ec->stripe + stripe_len - 1) / stripe_len);
 
-        return 0;
+        stripe_ec_lock (frame, this);
+        return;
 err:
-        STRIPE_STACK_UNWIND (setattr, frame, -1, op_errno, NULL, NULL);
-        return 0;
+        STRIPE_STACK_UNWIND (readv, frame, -1, ENOMEM, NULL, 0, NULL, NULL);
+        fd_unref (fd);
 }
 
-
-int32_t
-stripe_fsetattr (call_frame_t *frame, xlator_t *this, fd_t *fd,
-                 struct iatt *stbuf, int32_t valid)
+/**
+ * stripe_ec_parity_update - recompute the parity of the stripes covering
+ *     [offset, end) once the data is in place, then unwind the write or
+ *     ftruncate. Updates of an inode are serialized, here and through an
+ *     inodelk on parity child 0 across clients, so that the parity always
+ *     ends up computed from the latest data. A client dying between the
+ *     data and the parity writes still leaves the stripe's parity stale
+ *     until it is written again.
+ */
+void
+stripe_ec_parity_update (call_frame_t *frame, xlator_t *this, int fop,
+                         off_t offset, off_t end)
 {
-        stripe_local_t   *local = NULL;
-        stripe_private_t *priv = NULL;
-        xlator_list_t    *trav = NULL;
-        int32_t           op_errno = EINVAL;
+        stripe_local_t      *local = NULL;
+        stripe_inode_ctx_t   *ictx = NULL;
+        struct stripe_ec_io *ec = NULL;
+        fd_t                *fd = NULL;
+        int                  queued = 0;
 
-        VALIDATE_OR_GOTO (frame, err);
-        VALIDATE_OR_GOTO (this, err);
-        VALIDATE_OR_GOTO (fd, err);
-        VALIDATE_OR_GOTO (fd->inode, err);
+        local = frame->local;
+        fd    = local->fd;
+
+        ictx = stripe_inode_ctx_get (this, fd->inode);
+        ec   = stripe_ec_io_new (frame, local->fctx, fop, offset, end);
+        if (!ictx || !ec) {
+                if (ec)
+                        stripe_ec_io_free (ec);
+                local->op_ret   = -1;
+                local->op_errno = ENOMEM;
+                if (fop == GF_FOP_WRITE)
+                        STRIPE_STACK_UNWIND (writev, frame, -1, ENOMEM,
+                                             NULL, NULL);
+                else
+                        STRIPE_STACK_UNWIND (ftruncate, frame, -1, ENOMEM,
+                                             NULL, NULL);
+                fd_unref (fd);
+                return;
+        }
+        local->ec = ec;
+
+        LOCK (&ictx->lock);
+        {
+                if (ictx->busy) {
+                        list_add_tail (&ec->list, &ictx->waiting);
+                        queued = 1;
+                } else {
+                        ictx->busy = 1;
+                }
+        }
+        UNLOCK (&ictx->lock);
 
-        priv = this->private;
-        trav = this->children;
+        if (!queued)
+                stripe_ec_lock (frame, this);
+}
 
-        /* Initialization */
-        local = GF_CALLOC (1, sizeof (stripe_local_t),
-                           gf_stripe_mt_stripe_local_t);
-        if (!local) {
-                op_errno = ENOMEM;
-                goto err;
-        }
-        local->op_ret = -1;
-        frame->local = local;
-        local->call_count = priv->child_count;
+int32_t
+stripe_forget (xlator_t *this, inode_t *inode)
+{
+        stripe_inode_ctx_t *ictx = NULL;
+        uint64_t           tmp_ictx = 0;
 
-        while (trav) {
-                STACK_WIND (frame, stripe_setattr_cbk, trav->xlator,
-                            trav->xlator->fops->fsetattr, fd, stbuf, valid);
-                trav = trav->next;
-        }
+        inode_ctx_del (inode, this, &tmp_ictx);
+        if (!tmp_ictx)
+                goto out;
 
-        return 0;
-err:
-        STRIPE_STACK_UNWIND (fsetattr, frame, -1, op_errno, NULL, NULL);
+        ictx = (stripe_inode_ctx_t *)(long)tmp_ictx;
+        LOCK_DESTROY (&ictx->lock);
+        GF_FREE (ictx);
+out:
         return 0;
 }
 
+
+
 int32_t
-stripe_stack_rename_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
-                         int32_t op_ret, int32_t op_errno, struct iatt *buf,
-                         struct iatt *preoldparent, struct iatt *postoldparent,
-                         struct iatt *prenewparent, struct iatt *postnewparent)
+stripe_sh_chown_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                     int32_t op_ret, int32_t op_errno,
+                     struct iatt *preop, struct iatt *postop)
 {
-        int32_t         callcnt = 0;
-        stripe_local_t *local = NULL;
-        call_frame_t   *prev = NULL;
+        int             callcnt = -1;
+        stripe_local_t *local   = NULL;
 
-        if (!this || !frame || !frame->local || !cookie) {
+        if (!this || !frame || !frame->local) {
                 gf_log ("stripe", GF_LOG_DEBUG, "possible NULL deref");
                 goto out;
         }
 
-        prev  = cookie;
         local = frame->local;
 
         LOCK (&frame->lock);
         {
                 callcnt = --local->call_count;
-
-                if (op_ret == -1) {
-                        gf_log (this->name, GF_LOG_DEBUG,
-                                "%s returned error %s",
-                                prev->this->name, strerror (op_errno));
-                        local->op_errno = op_errno;
-                        if ((op_errno != ENOENT) ||
-                            (prev->this == FIRST_CHILD (this)))
-                                local->failed = 1;
-                }
-
-                if (op_ret == 0) {
-                        local->op_ret = 0;
-
-                        local->stbuf.ia_blocks      += buf->ia_blocks;
-                        local->preparent.ia_blocks  += preoldparent->ia_blocks;
-                        local->postparent.ia_blocks += postoldparent->ia_blocks;
-                        local->pre_buf.ia_blocks    += prenewparent->ia_blocks;
-                        local->post_buf.ia_blocks   += postnewparent->ia_blocks;
-
-                        if (local->stbuf.ia_size < buf->ia_size)
-                                local->stbuf.ia_size =  buf->ia_size;
-
-                        if (local->preparent.ia_size < preoldparent->ia_size)
-                                local->preparent.ia_size = preoldparent->ia_size;
-
-                        if (local->postparent.ia_size < postoldparent->ia_size)
-                                local->postparent.ia_size = postoldparent->ia_size;
-
-                        if (local->pre_buf.ia_size < prenewparent->ia_size)
-                                local->pre_buf.ia_size = prenewparent->ia_size;
-
-                        if (local->post_buf.ia_size < postnewparent->ia_size)
-                                local->post_buf.ia_size = postnewparent->ia_size;
-                }
         }
         UNLOCK (&frame->lock);
 
         if (!callcnt) {
-                if (local->failed)
-                        local->op_ret = -1;
-
-                STRIPE_STACK_UNWIND (rename, frame, local->op_ret, local->op_errno,
-                                     &local->stbuf, &local->preparent,
-                                     &local->postparent,  &local->pre_buf,
-                                     &local->post_buf);
+                STRIPE_STACK_DESTROY (frame);
         }
 out:
         return 0;
 }
 
 int32_t
-stripe_first_rename_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
-                         int32_t op_ret, int32_t op_errno, struct iatt *buf,
-                         struct iatt *preoldparent, struct iatt *postoldparent,
-                         struct iatt *prenewparent, struct iatt *postnewparent)
+stripe_sh_make_entry_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                          int32_t op_ret, int32_t op_errno, inode_t *inode,
+                          struct iatt *buf, struct iatt *preparent,
+                          struct iatt *postparent)
 {
         stripe_local_t *local = NULL;
-        xlator_list_t  *trav = NULL;
+        call_frame_t    *prev = NULL;
 
-        if (!this || !frame || !frame->local) {
+        if (!frame || !frame->local || !cookie || !this) {
                 gf_log ("stripe", GF_LOG_DEBUG, "possible NULL deref");
-                op_errno = EINVAL;
-                goto unwind;
+                goto out;
         }
 
-        if (op_ret == -1) {
-                goto unwind;
+        prev  = cookie;
+        local = frame->local;
+
+        STACK_WIND (frame, stripe_sh_chown_cbk, prev->this,
+                    prev->this->fops->setattr, &local->loc,
+                    &local->stbuf, (GF_SET_ATTR_UID | GF_SET_ATTR_GID));
+
+out:
+        return 0;
+}
+
+int32_t
+stripe_entry_self_heal (call_frame_t *frame, xlator_t *this,
+                        stripe_local_t *local)
+{
+        xlator_list_t    *trav   = NULL;
+        call_frame_t     *rframe = NULL;
+        stripe_local_t   *rlocal = NULL;
+        stripe_private_t *priv   = NULL;
+        dict_t           *dict   = NULL;
+        int               ret    = 0;
+
+        if (!local || !this || !frame) {
+                gf_log ("stripe", GF_LOG_DEBUG, "possible NULL deref");
+                goto out;
         }
 
-        local = frame->local;
+        if (!(IA_ISREG (local->stbuf.ia_type) ||
+              IA_ISDIR (local->stbuf.ia_type)))
+                return 0;
+
+        priv = this->private;
         trav = this->children;
+        rframe = copy_frame (frame);
+        if (!rframe) {
+                goto out;
+        }
+        rlocal = GF_CALLOC (1, sizeof (stripe_local_t),
+                            gf_stripe_mt_stripe_local_t);
+        if (!rlocal) {
+                goto out;
+        }
+        rframe->local = rlocal;
+        rlocal->call_count = priv->child_count;
+        loc_copy (&rlocal->loc, &local->loc);
+        memcpy (&rlocal->stbuf, &local->stbuf, sizeof (struct iatt));
 
-        local->stbuf      = *buf;
-        local->preparent  = *preoldparent;
-        local->postparent = *postoldparent;
-        local->pre_buf    = *prenewparent;
-        local->post_buf   = *postnewparent;
+        dict = dict_new ();
+        if (!dict)
+                goto out;
 
-        local->op_ret = 0;
-        local->call_count--;
+        ret = dict_set_static_bin (dict, "gfid-req", local->stbuf.ia_gfid, 16);
+        if (ret)
+                gf_log (this->name, GF_LOG_WARNING,
+                        "failed to set gfid-req");
 
-        trav = trav->next; /* Skip first child */
         while (trav) {
-                STACK_WIND (frame, stripe_stack_rename_cbk,
-                            trav->xlator, trav->xlator->fops->rename,
-                            &local->loc, &local->loc2);
+                if (IA_ISREG (local->stbuf.ia_type)) {
+                        STACK_WIND (rframe, stripe_sh_make_entry_cbk,
+                                    trav->xlator, trav->xlator->fops->mknod,
+                                    &local->loc,
+                                    st_mode_from_ia (local->stbuf.ia_prot,
+                                                     local->stbuf.ia_type), 0,
+                                    dict);
+                }
+                if (IA_ISDIR (local->stbuf.ia_type)) {
+                        STACK_WIND (rframe, stripe_sh_make_entry_cbk,
+                                    trav->xlator, trav->xlator->fops->mkdir,
+                                    &local->loc, st_mode_from_ia (local->stbuf.ia_prot,
+                                                                  local->stbuf.ia_type),
+                                    dict);
+                }
                 trav = trav->next;
         }
-        return 0;
 
-unwind:
-        STRIPE_STACK_UNWIND (rename, frame, -1, op_errno, buf, preoldparent,
-                             postoldparent, prenewparent, postnewparent);
+out:
+        if (rframe)
+                STRIPE_STACK_DESTROY (rframe);
+        if (dict)
+                dict_unref (dict);
+
         return 0;
 }
 
-int32_t
-stripe_rename (call_frame_t *frame, xlator_t *this, loc_t *oldloc,
-               loc_t *newloc)
+/* Size of the file from one lookup reply. The layout of a coalesced
+   file comes along with it, and is kept in the inode for the fops which
+   only get an iatt back. */
+static off_t
+stripe_lookup_file_size (xlator_t *this, inode_t *inode, xlator_t *child,
+                         dict_t *dict, struct iatt *buf)
 {
         stripe_private_t *priv = NULL;
-        stripe_local_t   *local = NULL;
-        xlator_list_t    *trav = NULL;
-        int32_t           op_errno = EINVAL;
-
-        VALIDATE_OR_GOTO (frame, err);
-        VALIDATE_OR_GOTO (this, err);
-        VALIDATE_OR_GOTO (oldloc, err);
-        VALIDATE_OR_GOTO (oldloc->path, err);
-        VALIDATE_OR_GOTO (oldloc->inode, err);
-        VALIDATE_OR_GOTO (newloc, err);
+        data_t           *data = NULL;
+        char              key[256] = {0,};
+        int64_t           stripe_size = 0;
+        int32_t           redundancy = 0;
 
         priv = this->private;
-        trav = this->children;
 
-        /* If any one node is down, don't allow rename */
-        if (priv->nodes_down) {
-                op_errno = ENOTCONN;
-                goto err;
-        }
-
-        /* Initialization */
-        local = GF_CALLOC (1, sizeof (stripe_local_t),
-                           gf_stripe_mt_stripe_local_t);
-        if (!local) {
-                op_errno = ENOMEM;
-                goto err;
-        }
-        local->op_ret = -1;
-        loc_copy (&local->loc, oldloc);
-        loc_copy (&local->loc2, newloc);
+        if (!dict || !IA_ISREG (buf->ia_type))
+                return buf->ia_size;
 
-        local->call_count = priv->child_count;
+        sprintf (key, "trusted.%s.stripe-coalesce", this->name);
+        data = dict_get (dict, key);
+        if (!data || !data_to_int32 (data))
+                return buf->ia_size;
 
-        frame->local = local;
+        sprintf (key, "trusted.%s.stripe-size", this->name);
+        data = dict_get (dict, key);
+        if (data)
+                stripe_size = data_to_int64 (data);
 
-        STACK_WIND (frame, stripe_first_rename_cbk, trav->xlator,
-                    trav->xlator->fops->rename, oldloc, newloc);
+        sprintf (key, "trusted.%s.stripe-redundancy", this->name);
+        data = dict_get (dict, key);
+        if (data)
+                redundancy = data_to_int32 (data);
 
-        return 0;
-err:
-        STRIPE_STACK_UNWIND (rename, frame, -1, op_errno, NULL, NULL, NULL,
-                             NULL, NULL);
-        return 0;
-}
+        if ((stripe_size <= 0) || (redundancy < 0) ||
+            (redundancy >= priv->child_count))
+                return buf->ia_size;
 
+        stripe_inode_set_coalesced (this, inode, stripe_size,
+                                    priv->child_count - redundancy);
 
+        return stripe_file_size (stripe_size, priv->child_count - redundancy,
+                                 1, stripe_child_index (this, child),
+                                 buf->ia_size);
+}
 
 int32_t
-stripe_unlink_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
-                   int32_t op_ret, int32_t op_errno, struct iatt *preparent,
-                   struct iatt *postparent)
+stripe_lookup_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                   int32_t op_ret, int32_t op_errno, inode_t *inode,
+                   struct iatt *buf, dict_t *dict, struct iatt *postparent)
 {
         int32_t         callcnt = 0;
-        stripe_local_t *local   = NULL;
+        dict_t         *tmp_dict = NULL;
+        inode_t        *tmp_inode = NULL;
+        stripe_local_t *local = NULL;
         call_frame_t   *prev = NULL;
+        off_t           size = 0;
 
         if (!this || !frame || !frame->local || !cookie) {
                 gf_log ("stripe", GF_LOG_DEBUG, "possible NULL deref");
                 goto out;
         }
 
-        prev  = cookie;
+        prev = cookie;
         local = frame->local;
 
+        if (op_ret >= 0)
+                size = stripe_lookup_file_size (this, inode, prev->this,
+                                                dict, buf);
+
         LOCK (&frame->lock);
         {
                 callcnt = --local->call_count;
 
                 if (op_ret == -1) {
-                        gf_log (this->name, GF_LOG_DEBUG, "%s returned %s",
-                                prev->this->name, strerror (op_errno));
-                        local->op_errno = op_errno;
-                        if ((op_errno != ENOENT) ||
+                        if (op_errno != ENOENT)
+                                gf_log (this->name, GF_LOG_DEBUG,
+                                        "%s returned error %s",
+                                        prev->this->name,
+                                        strerror (op_errno));
+                        if (local->op_errno != ESTALE)
+                                local->op_errno = op_errno;
+                        if (((op_errno != ENOENT) && (op_errno != ENOTCONN)) ||
                             (prev->this == FIRST_CHILD (this)))
                                 local->failed = 1;
+                        if (op_errno == ENOENT)
+                                local->entry_self_heal_needed = 1;
                 }
+
                 if (op_ret >= 0) {
-                        local->op_ret = op_ret;
+                        local->op_ret = 0;
+
                         if (FIRST_CHILD(this) == prev->this) {
-                                local->preparent  = *preparent;
+                                local->stbuf      = *buf;
                                 local->postparent = *postparent;
+                                local->inode = inode_ref (inode);
+                                local->dict = dict_ref (dict);
                         }
-                        local->preparent_blocks  += preparent->ia_blocks;
+                        local->stbuf_blocks      += buf->ia_blocks;
                         local->postparent_blocks += postparent->ia_blocks;
 
-                        if (local->preparent_size < preparent->ia_size)
-                                local->preparent_size = preparent->ia_size;
-
+                        if (local->stbuf_size < size)
+                                local->stbuf_size = size;
                         if (local->postparent_size < postparent->ia_size)
                                 local->postparent_size = postparent->ia_size;
                 }
@@ -1031,31 +1364,49 @@ stripe_unlink_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
         UNLOCK (&frame->lock);
 
         if (!callcnt) {
+                if (local->op_ret == 0 && local->entry_self_heal_needed)
+                        stripe_entry_self_heal (frame, this, local);
+
                 if (local->failed)
                         local->op_ret = -1;
 
+                tmp_dict  = local->dict;
+                tmp_inode = local->inode;
+
                 if (local->op_ret != -1) {
-                        local->preparent.ia_blocks  = local->preparent_blocks;
-                        local->preparent.ia_size    = local->preparent_size;
+                        local->stbuf.ia_blocks      = local->stbuf_blocks;
+                        local->stbuf.ia_size        = local->stbuf_size;
                         local->postparent.ia_blocks = local->postparent_blocks;
                         local->postparent.ia_size   = local->postparent_size;
                 }
 
-                STRIPE_STACK_UNWIND (unlink, frame, local->op_ret,
-                                     local->op_errno, &local->preparent,
+                STRIPE_STACK_UNWIND (lookup, frame, local->op_ret,
+                                     local->op_errno, local->inode,
+                                     &local->stbuf, local->dict,
                                      &local->postparent);
+
+                if (tmp_inode)
+                        inode_unref (tmp_inode);
+                if (tmp_dict)
+                        dict_unref (tmp_dict);
         }
 out:
         return 0;
 }
 
 int32_t
-stripe_unlink (call_frame_t *frame, xlator_t *this, loc_t *loc)
+stripe_lookup (call_frame_t *frame, xlator_t *this, loc_t *loc,
+               dict_t *xattr_req)
 {
-        xlator_list_t    *trav = NULL;
         stripe_local_t   *local = NULL;
+        call_stub_t      *stub = NULL;
+        fd_t             *wfd = NULL;
+        xlator_list_t    *trav = NULL;
         stripe_private_t *priv = NULL;
+        dict_t           *req = NULL;
+        char              key[256] = {0,};
         int32_t           op_errno = EINVAL;
+        int               ret = 0;
 
         VALIDATE_OR_GOTO (frame, err);
         VALIDATE_OR_GOTO (this, err);
@@ -1063,19 +1414,18 @@ stripe_unlink (call_frame_t *frame, xlator_t *this, loc_t *loc)
         VALIDATE_OR_GOTO (loc->path, err);
         VALIDATE_OR_GOTO (loc->inode, err);
 
-        priv = this->private;
-        trav = this->children;
-
-        if (priv->first_child_down) {
-                op_errno = ENOTCONN;
-                goto err;
+        wfd = stripe_wa_inode_fd (this, loc->inode, NULL);
+        if (wfd) {
+                stub = fop_lookup_stub (frame, stripe_lookup, loc, xattr_req);
+                if (stripe_wa_wait (frame, this, wfd, stub)) {
+                        op_errno = ENOMEM;
+                        goto err;
+                }
+                return 0;
         }
 
-        /* Don't unlink a file if a node is down */
-        if (priv->nodes_down) {
-                op_errno = ENOTCONN;
-                goto err;
-        }
+        priv = this->private;
+        trav = this->children;
 
         /* Initialization */
         local = GF_CALLOC (1, sizeof (stripe_local_t),
@@ -1086,72 +1436,117 @@ stripe_unlink (call_frame_t *frame, xlator_t *this, loc_t *loc)
         }
         local->op_ret = -1;
         frame->local = local;
-        local->call_count = priv->child_count;
+        loc_copy (&local->loc, loc);
+
+        /* ask for the layout, to tell the size of coalesced files */
+        if (priv->xattr_supported) {
+                req = xattr_req ? dict_copy_with_ref (xattr_req, NULL) :
+                        dict_new ();
+                if (req) {
+                        sprintf (key, "trusted.%s.stripe-coalesce",
+                                 this->name);
+                        ret = dict_set_int32 (req, key, 0);
+                        sprintf (key, "trusted.%s.stripe-size", this->name);
+                        ret |= dict_set_int64 (req, key, 0);
+                        sprintf (key, "trusted.%s.stripe-redundancy",
+                                 this->name);
+                        ret |= dict_set_int32 (req, key, 0);
+                        if (ret)
+                                gf_log (this->name, GF_LOG_DEBUG,
+                                        "%s: failed to ask for the stripe "
+                                        "layout", loc->path);
+                        xattr_req = req;
+                }
+        }
 
+        /* Everytime in stripe lookup, all child nodes
+           should be looked up */
+        local->call_count = priv->child_count;
         while (trav) {
-                STACK_WIND (frame, stripe_unlink_cbk,
-                            trav->xlator, trav->xlator->fops->unlink,
-                            loc);
+                STACK_WIND (frame, stripe_lookup_cbk, trav->xlator,
+                            trav->xlator->fops->lookup,
+                            loc, xattr_req);
                 trav = trav->next;
         }
 
+        if (req)
+                dict_unref (req);
+
         return 0;
 err:
-        STRIPE_STACK_UNWIND (unlink, frame, -1, op_errno, NULL, NULL);
+        STRIPE_STACK_UNWIND (lookup, frame, -1, op_errno, NULL, NULL, NULL, NULL);
         return 0;
 }
 
 
 int32_t
-stripe_first_rmdir_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
-                        int32_t op_ret, int32_t op_errno,struct iatt *preparent,
-                        struct iatt *postparent)
-
+stripe_stat_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                 int32_t op_ret, int32_t op_errno, struct iatt *buf)
 {
-        xlator_list_t *trav = NULL;
+        int32_t         callcnt = 0;
         stripe_local_t *local = NULL;
+        call_frame_t   *prev = NULL;
+        off_t           size = 0;
 
-        if (!this || !frame || !frame->local) {
+        if (!this || !frame || !frame->local || !cookie) {
                 gf_log ("stripe", GF_LOG_DEBUG, "possible NULL deref");
-                op_errno = EINVAL;
-                goto err;
+                goto out;
         }
+        prev  = cookie;
+        local = frame->local;
 
-        if (op_ret == -1) {
-                goto err;
-        }
+        LOCK (&frame->lock);
+        {
+                callcnt = --local->call_count;
 
-        trav = this->children;
-        local = frame->local;
+                if (op_ret == -1) {
+                        gf_log (this->name, GF_LOG_DEBUG,
+                                "%s returned error %s",
+                                prev->this->name, strerror (op_errno));
+                        local->op_errno = op_errno;
+                        if ((op_errno != ENOENT) ||
+                            (prev->this == FIRST_CHILD (this)))
+                                local->failed = 1;
+                }
 
-        local->call_count--; /* First child successful */
-        trav = trav->next; /* Skip first child */
+                if (op_ret == 0) {
+                        local->op_ret = 0;
 
-        local->preparent  = *preparent;
-        local->postparent = *postparent;
-        local->preparent_size  = preparent->ia_size;
-        local->postparent_size = postparent->ia_size;
-        local->preparent_blocks  += preparent->ia_blocks;
-        local->postparent_blocks += postparent->ia_blocks;
+                        if (FIRST_CHILD(this) == prev->this) {
+                                local->stbuf = *buf;
+                        }
 
-        while (trav) {
-                STACK_WIND (frame, stripe_unlink_cbk, trav->xlator,
-                            trav->xlator->fops->rmdir, &local->loc,
-                            local->flags);
-                trav = trav->next;
+                        local->stbuf_blocks += buf->ia_blocks;
+                        size = stripe_iatt_size (this, local->ictx,
+                                                 prev->this, buf);
+                        if (local->stbuf_size < size)
+                                local->stbuf_size = size;
+                }
         }
+        UNLOCK (&frame->lock);
 
-        return 0;
-err:
-        STRIPE_STACK_UNWIND (rmdir, frame, op_ret, op_errno, NULL, NULL);
-        return 0;
+        if (!callcnt) {
+                if (local->failed)
+                        local->op_ret = -1;
+
+                if (local->op_ret != -1) {
+                        local->stbuf.ia_size   = local->stbuf_size;
+                        local->stbuf.ia_blocks = local->stbuf_blocks;
+                }
 
+                STRIPE_STACK_UNWIND (stat, frame, local->op_ret,
+                                     local->op_errno, &local->stbuf);
+        }
+out:
+        return 0;
 }
 
 int32_t
-stripe_rmdir (call_frame_t *frame, xlator_t *this, loc_t *loc, int flags)
+stripe_stat (call_frame_t *frame, xlator_t *this, loc_t *loc)
 {
         xlator_list_t    *trav = NULL;
+        call_stub_t      *stub = NULL;
+        fd_t             *wfd = NULL;
         stripe_local_t   *local = NULL;
         stripe_private_t *priv = NULL;
         int32_t           op_errno = EINVAL;
@@ -1162,11 +1557,20 @@ stripe_rmdir (call_frame_t *frame, xlator_t *this, loc_t *loc, int flags)
         VALIDATE_OR_GOTO (loc->path, err);
         VALIDATE_OR_GOTO (loc->inode, err);
 
+        wfd = stripe_wa_inode_fd (this, loc->inode, NULL);
+        if (wfd) {
+                stub = fop_stat_stub (frame, stripe_stat, loc);
+                if (stripe_wa_wait (frame, this, wfd, stub)) {
+                        op_errno = ENOMEM;
+                        goto err;
+                }
+                return 0;
+        }
+
         priv = this->private;
         trav = this->children;
 
-        /* don't delete a directory if any of the subvolume is down */
-        if (priv->nodes_down) {
+        if (priv->first_child_down) {
                 op_errno = ENOTCONN;
                 goto err;
         }
@@ -1180,121 +1584,120 @@ stripe_rmdir (call_frame_t *frame, xlator_t *this, loc_t *loc, int flags)
         }
         local->op_ret = -1;
         frame->local = local;
-        loc_copy (&local->loc, loc);
-        local->flags = flags;
+        local->ictx = stripe_inode_ctx_find (this, loc->inode);
         local->call_count = priv->child_count;
 
-        STACK_WIND (frame, stripe_first_rmdir_cbk,  trav->xlator,
-                    trav->xlator->fops->rmdir, loc, flags);
+        while (trav) {
+                STACK_WIND (frame, stripe_stat_cbk, trav->xlator,
+                            trav->xlator->fops->stat, loc);
+                trav = trav->next;
+        }
 
         return 0;
+
 err:
-        STRIPE_STACK_UNWIND (rmdir, frame, -1, op_errno, NULL, NULL);
+        STRIPE_STACK_UNWIND (stat, frame, -1, op_errno, NULL);
         return 0;
 }
 
 
 int32_t
-stripe_mknod_ifreg_fail_unlink_cbk (call_frame_t *frame, void *cookie,
-                                    xlator_t *this, int32_t op_ret,
-                                    int32_t op_errno, struct iatt *preparent,
-                                    struct iatt *postparent)
+stripe_statfs_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                   int32_t op_ret, int32_t op_errno, struct statvfs *stbuf)
 {
-        int32_t         callcnt = 0;
         stripe_local_t *local = NULL;
+        int32_t         callcnt = 0;
 
         if (!this || !frame || !frame->local) {
                 gf_log ("stripe", GF_LOG_DEBUG, "possible NULL deref");
                 goto out;
         }
-
         local = frame->local;
 
-        LOCK (&frame->lock);
+        LOCK(&frame->lock);
         {
                 callcnt = --local->call_count;
+
+                if (op_ret && (op_errno != ENOTCONN)) {
+                        local->op_errno = op_errno;
+                }
+                if (op_ret == 0) {
+                        struct statvfs *dict_buf = &local->statvfs_buf;
+                        dict_buf->f_bsize   = stbuf->f_bsize;
+                        dict_buf->f_frsize  = stbuf->f_frsize;
+                        dict_buf->f_blocks += stbuf->f_blocks;
+                        dict_buf->f_bfree  += stbuf->f_bfree;
+                        dict_buf->f_bavail += stbuf->f_bavail;
+                        dict_buf->f_files  += stbuf->f_files;
+                        dict_buf->f_ffree  += stbuf->f_ffree;
+                        dict_buf->f_favail += stbuf->f_favail;
+                        dict_buf->f_fsid    = stbuf->f_fsid;
+                        dict_buf->f_flag    = stbuf->f_flag;
+                        dict_buf->f_namemax = stbuf->f_namemax;
+                        local->op_ret = 0;
+                }
         }
         UNLOCK (&frame->lock);
 
         if (!callcnt) {
-                STRIPE_STACK_UNWIND (mknod, frame, local->op_ret, local->op_errno,
-                                     local->inode, &local->stbuf,
-                                     &local->preparent, &local->postparent);
+                STRIPE_STACK_UNWIND (statfs, frame, local->op_ret,
+                                     local->op_errno, &local->statvfs_buf);
         }
 out:
         return 0;
 }
 
-
-/**
- */
 int32_t
-stripe_mknod_ifreg_setxattr_cbk (call_frame_t *frame, void *cookie,
-                                 xlator_t *this, int32_t op_ret,
-                                 int32_t op_errno)
+stripe_statfs (call_frame_t *frame, xlator_t *this, loc_t *loc)
 {
-        int32_t           callcnt = 0;
         stripe_local_t   *local = NULL;
-        stripe_private_t *priv = NULL;
         xlator_list_t    *trav = NULL;
-        call_frame_t     *prev = NULL;
-
-        if (!this || !frame || !frame->local || !cookie) {
-                gf_log ("stripe", GF_LOG_DEBUG, "possible NULL deref");
-                goto out;
-        }
+        stripe_private_t *priv = NULL;
+        int32_t           op_errno = EINVAL;
 
-        prev  = cookie;
-        priv  = this->private;
-        local = frame->local;
+        VALIDATE_OR_GOTO (frame, err);
+        VALIDATE_OR_GOTO (this, err);
+        VALIDATE_OR_GOTO (loc, err);
 
-	LOCK (&frame->lock);
-        {
-                callcnt = --local->call_count;
+        trav = this->children;
+        priv = this->private;
 
-                if (op_ret == -1) {
-                        gf_log (this->name, GF_LOG_DEBUG,
-                                "%s returned error %s",
-                                prev->this->name, strerror (op_errno));
-                        local->op_ret = -1;
-                        local->op_errno = op_errno;
-                }
+        /* Initialization */
+        local = GF_CALLOC (1, sizeof (stripe_local_t),
+                           gf_stripe_mt_stripe_local_t);
+        if (!local) {
+                op_errno = ENOMEM;
+                goto err;
         }
-        UNLOCK (&frame->lock);
-
-        if (!callcnt) {
-                if (local->op_ret == -1) {
-                        local->call_count = priv->child_count;
-                        while (trav) {
-                                STACK_WIND (frame,
-                                            stripe_mknod_ifreg_fail_unlink_cbk,
-                                            trav->xlator,
-                                            trav->xlator->fops->unlink,
-                                            &local->loc);
-                                trav = trav->next;
-                        }
-                        return 0;
-                }
+        local->op_ret = -1;
+        local->op_errno = ENOTCONN;
+        frame->local = local;
 
-                STRIPE_STACK_UNWIND (mknod, frame, local->op_ret, local->op_errno,
-                                     local->inode, &local->stbuf,
-                                     &local->preparent, &local->postparent);
+        local->call_count = priv->child_count;
+        while (trav) {
+                STACK_WIND (frame, stripe_statfs_cbk, trav->xlator,
+                            trav->xlator->fops->statfs, loc);
+                trav = trav->next;
         }
-out:
+
+        return 0;
+err:
+        STRIPE_STACK_UNWIND (statfs, frame, -1, op_errno, NULL);
         return 0;
 }
 
+
+
 int32_t
-stripe_mknod_ifreg_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
-                        int32_t op_ret, int32_t op_errno, inode_t *inode,
-                        struct iatt *buf, struct iatt *preparent,
-                        struct iatt *postparent)
+stripe_truncate_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                     int32_t op_ret, int32_t op_errno, struct iatt *prebuf,
+                     struct iatt *postbuf)
 {
-        int               ret = 0;
-        int32_t           callcnt = 0;
-        stripe_local_t   *local = NULL;
-        stripe_private_t *priv = NULL;
-        call_frame_t     *prev = NULL;
+        int32_t         callcnt = 0;
+        stripe_local_t *local = NULL;
+        call_frame_t   *prev = NULL;
+        fd_t           *fd = NULL;
+        off_t           size = 0;
 
         if (!this || !frame || !frame->local || !cookie) {
                 gf_log ("stripe", GF_LOG_DEBUG, "possible NULL deref");
@@ -1302,7 +1705,6 @@ stripe_mknod_ifreg_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
         }
 
         prev  = cookie;
-	priv  = this->private;
         local = frame->local;
 
         LOCK (&frame->lock);
@@ -1313,31 +1715,31 @@ stripe_mknod_ifreg_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                         gf_log (this->name, GF_LOG_DEBUG,
                                 "%s returned error %s",
                                 prev->this->name, strerror (op_errno));
+                        local->op_errno = op_errno;
                         if ((op_errno != ENOENT) ||
                             (prev->this == FIRST_CHILD (this)))
                                 local->failed = 1;
-                        local->op_errno = op_errno;
                 }
 
-                if (op_ret >= 0) {
-                        local->op_ret = op_ret;
-
+                if (op_ret == 0) {
+                        local->op_ret = 0;
                         if (FIRST_CHILD(this) == prev->this) {
-                                local->stbuf      = *buf;
-                                local->preparent  = *preparent;
-                                local->postparent = *postparent;
+                                local->pre_buf  = *prebuf;
+                                local->post_buf = *postbuf;
                         }
 
-                        local->stbuf_blocks += buf->ia_blocks;
-                        local->preparent_blocks  += preparent->ia_blocks;
-                        local->postparent_blocks += postparent->ia_blocks;
+                        local->prebuf_blocks  += prebuf->ia_blocks;
+                        local->postbuf_blocks += postbuf->ia_blocks;
 
-                        if (local->stbuf_size < buf->ia_size)
-                                local->stbuf_size = buf->ia_size;
-                        if (local->preparent_size < preparent->ia_size)
-                                local->preparent_size = preparent->ia_size;
-                        if (local->postparent_size < postparent->ia_size)
-                                local->postparent_size = postparent->ia_size;
+                        size = stripe_iatt_size (this, local->ictx,
+                                                 prev->this, prebuf);
+                        if (local->prebuf_size < size)
+                                local->prebuf_size = size;
+
+                        size = stripe_iatt_size (this, local->ictx,
+                                                 prev->this, postbuf);
+                        if (local->postbuf_size < size)
+                                local->postbuf_size = size;
                 }
         }
         UNLOCK (&frame->lock);
@@ -1347,100 +1749,132 @@ stripe_mknod_ifreg_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                         local->op_ret = -1;
 
                 if (local->op_ret != -1) {
-                        local->preparent.ia_blocks  = local->preparent_blocks;
-                        local->preparent.ia_size    = local->preparent_size;
-                        local->postparent.ia_blocks = local->postparent_blocks;
-                        local->postparent.ia_size   = local->postparent_size;
-                        local->stbuf.ia_size        = local->stbuf_size;
-                        local->stbuf.ia_blocks      = local->stbuf_blocks;
+                        local->pre_buf.ia_blocks  = local->prebuf_blocks;
+                        local->pre_buf.ia_size    = local->prebuf_size;
+                        local->post_buf.ia_blocks = local->postbuf_blocks;
+                        local->post_buf.ia_size   = local->postbuf_size;
                 }
 
-                if ((local->op_ret != -1) && priv->xattr_supported) {
-                        /* Send a setxattr request to nodes where the
-                           files are created */
-                        int32_t  i              = 0;
-                        char     size_key[256]  = {0,};
-                        char     index_key[256] = {0,};
-                        char     count_key[256] = {0,};
-                        dict_t  *dict           = NULL;
-
-                        sprintf (size_key,
-                                 "trusted.%s.stripe-size", this->name);
-                        sprintf (count_key,
-                                 "trusted.%s.stripe-count", this->name);
-                        sprintf (index_key,
-                                 "trusted.%s.stripe-index", this->name);
+                /* the stripe cut by an ftruncate needs its parity back */
+                if (local->fctx && local->fctx->redundancy &&
+                    (local->op_ret != -1) &&
+                    (local->offset % (local->fctx->stripe_size *
+                                      local->fctx->data_count))) {
+                        stripe_ec_parity_update (frame, this,
+                                                 GF_FOP_FTRUNCATE,
+                                                 local->offset,
+                                                 local->offset);
+                        goto out;
+                }
 
-                        local->call_count = priv->child_count;
-                        memcpy (local->loc.inode->gfid, local->stbuf.ia_gfid, 16);
-                        for (i = 0; i < priv->child_count; i++) {
-                                dict = get_new_dict ();
-                                if (!dict) {
-                                        gf_log (this->name, GF_LOG_ERROR,
-                                                "failed to allocate dict");
-                                }
-
-                                dict_ref (dict);
-                                /* TODO: check return value */
-                                ret = dict_set_int64 (dict, size_key,
-                                                      local->stripe_size);
-                                if (ret)
-                                        gf_log (this->name, GF_LOG_ERROR,
-                                                "%s: set stripe-size failed",
-                                                local->loc.path);
-                                ret = dict_set_int32 (dict, count_key,
-                                                      priv->child_count);
-                                if (ret)
-                                        gf_log (this->name, GF_LOG_ERROR,
-                                                "%s: set child_count failed",
-                                                local->loc.path);
-                                ret = dict_set_int32 (dict, index_key, i);
-                                if (ret)
-                                        gf_log (this->name, GF_LOG_ERROR,
-                                                "%s: set stripe-index failed",
-                                                local->loc.path);
-
-                                STACK_WIND (frame,
-                                            stripe_mknod_ifreg_setxattr_cbk,
-                                            priv->xl_array[i],
-                                            priv->xl_array[i]->fops->setxattr,
-                                            &local->loc, dict, 0);
-
-                                dict_unref (dict);
-                        }
-                        return 0;
-                }
-
-                /* Create itself has failed.. so return
-                   without setxattring */
-                STRIPE_STACK_UNWIND (mknod, frame, local->op_ret, local->op_errno,
-                                     local->inode, &local->stbuf,
-                                     &local->preparent, &local->postparent);
+                fd = local->fd;
+                STRIPE_STACK_UNWIND (truncate, frame, local->op_ret,
+                                     local->op_errno, &local->pre_buf,
+                                     &local->post_buf);
+                if (fd)
+                        fd_unref (fd);
         }
 out:
         return 0;
 }
 
+/* Every child is cut to its share of the new size. Parity children of
+   an erasure coded file are cut at the start of the stripe the new size
+   falls in, which leaves that stripe without parity rather than with a
+   stale one. */
+static void
+stripe_truncate_wind (call_frame_t *frame, xlator_t *this, off_t offset,
+                      off_t stripe_size, int redundancy, int coalesce)
+{
+        stripe_local_t   *local = NULL;
+        stripe_private_t *priv = NULL;
+        int               i = 0;
+
+        local = frame->local;
+        priv  = this->private;
+
+        local->call_count = priv->child_count;
+        for (i = 0; i < priv->child_count; i++) {
+                STACK_WIND (frame, stripe_truncate_cbk, priv->xl_array[i],
+                            priv->xl_array[i]->fops->truncate, &local->loc,
+                            stripe_child_truncate_size (stripe_size,
+                                                        priv->child_count -
+                                                        redundancy, coalesce,
+                                                        i, offset));
+        }
+}
 
 int32_t
-stripe_single_mknod_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
-                         int32_t op_ret, int32_t op_errno, inode_t *inode,
-                         struct iatt *buf, struct iatt *preparent,
-                         struct iatt *postparent)
+stripe_truncate_getxattr_cbk (call_frame_t *frame, void *cookie,
+                              xlator_t *this, int32_t op_ret,
+                              int32_t op_errno, dict_t *dict)
 {
-        STRIPE_STACK_UNWIND (mknod, frame, op_ret, op_errno, inode, buf,
-                             preparent, postparent);
+        stripe_local_t   *local = NULL;
+        stripe_private_t *priv = NULL;
+        data_t           *data = NULL;
+        char              key[256] = {0,};
+        int64_t           stripe_size = 0;
+        int32_t           stripe_count = 0;
+        int32_t           redundancy = 0;
+        int32_t           coalesce = 0;
+        off_t             parity_offset = 0;
+        off_t             stripe_len = 0;
+
+        local = frame->local;
+        priv  = this->private;
+
+        if ((op_ret == 0) && dict) {
+                sprintf (key, "trusted.%s.stripe-redundancy", this->name);
+                data = dict_get (dict, key);
+                if (data)
+                        redundancy = data_to_int32 (data);
+
+                sprintf (key, "trusted.%s.stripe-coalesce", this->name);
+                data = dict_get (dict, key);
+                if (data)
+                        coalesce = data_to_int32 (data);
+
+                sprintf (key, "trusted.%s.stripe-size", this->name);
+                data = dict_get (dict, key);
+                if (data)
+                        stripe_size = data_to_int64 (data);
+
+                sprintf (key, "trusted.%s.stripe-count", this->name);
+                data = dict_get (dict, key);
+                if (data)
+                        stripe_count = data_to_int32 (data);
+        }
+
+        if (!stripe_size || (stripe_count != priv->child_count) ||
+            (redundancy < 0) || (redundancy >= stripe_count)) {
+                /* not striped the way this volume stripes, cut it all */
+                stripe_size = 0;
+                redundancy  = 0;
+                coalesce    = 0;
+        }
+
+        if (redundancy) {
+                stripe_len = stripe_size * (stripe_count - redundancy);
+                parity_offset = floor (local->offset, stripe_len);
+                if (parity_offset != local->offset)
+                        gf_log (this->name, GF_LOG_DEBUG,
+                                "%s: stripe at %"PRId64" has no parity until "
+                                "it is written again", local->loc.path,
+                                parity_offset);
+        }
+
+        stripe_truncate_wind (frame, this, local->offset, stripe_size,
+                              redundancy, coalesce);
         return 0;
 }
 
-
-int
-stripe_mknod (call_frame_t *frame, xlator_t *this, loc_t *loc, mode_t mode,
-              dev_t rdev, dict_t *params)
+int32_t
+stripe_truncate (call_frame_t *frame, xlator_t *this, loc_t *loc, off_t offset)
 {
-        stripe_private_t *priv = NULL;
         stripe_local_t   *local = NULL;
-        xlator_list_t    *trav = NULL;
+        call_stub_t      *stub = NULL;
+        fd_t             *wfd = NULL;
+        stripe_private_t *priv = NULL;
         int32_t           op_errno = EINVAL;
 
         VALIDATE_OR_GOTO (frame, err);
@@ -1449,77 +1883,62 @@ stripe_mknod (call_frame_t *frame, xlator_t *this, loc_t *loc, mode_t mode,
         VALIDATE_OR_GOTO (loc->path, err);
         VALIDATE_OR_GOTO (loc->inode, err);
 
+        wfd = stripe_wa_inode_fd (this, loc->inode, NULL);
+        if (wfd) {
+                stub = fop_truncate_stub (frame, stripe_truncate, loc, offset);
+                if (stripe_wa_wait (frame, this, wfd, stub)) {
+                        op_errno = ENOMEM;
+                        goto err;
+                }
+                return 0;
+        }
+
         priv = this->private;
-        trav = this->children;
 
         if (priv->first_child_down) {
                 op_errno = ENOTCONN;
                 goto err;
         }
 
-        if (S_ISREG(mode)) {
-                /* NOTE: on older kernels (older than 2.6.9),
-                   creat() fops is sent as mknod() + open(). Hence handling
-                   S_IFREG files is necessary */
-                if (priv->nodes_down) {
-                        gf_log (this->name, GF_LOG_WARNING,
-                                "Some node down, returning EIO");
-                        op_errno = EIO;
-                        goto err;
-                }
-
-                /* Initialization */
-                local = GF_CALLOC (1, sizeof (stripe_local_t),
-                                   gf_stripe_mt_stripe_local_t);
-                if (!local) {
-                        op_errno = ENOMEM;
-                        goto err;
-                }
-                local->op_ret = -1;
-                local->op_errno = ENOTCONN;
-                local->stripe_size = stripe_get_matching_bs (loc->path,
-                                                             priv->pattern,
-                                                             priv->block_size);
-                frame->local = local;
-                local->inode = loc->inode;
-                loc_copy (&local->loc, loc);
-
-                /* Everytime in stripe lookup, all child nodes should
-                   be looked up */
-                local->call_count = priv->child_count;
-
-                while (trav) {
-                        STACK_WIND (frame, stripe_mknod_ifreg_cbk,
-                                    trav->xlator, trav->xlator->fops->mknod,
-                                    loc, mode, rdev, params);
-                        trav = trav->next;
-                }
+        /* Initialization */
+        local = GF_CALLOC (1, sizeof (stripe_local_t),
+                           gf_stripe_mt_stripe_local_t);
+        if (!local) {
+                op_errno = ENOMEM;
+                goto err;
+        }
+        local->op_ret = -1;
+        frame->local = local;
+        local->ictx = stripe_inode_ctx_find (this, loc->inode);
+        local->offset = offset;
+        loc_copy (&local->loc, loc);
 
-                /* This case is handled, no need to continue further. */
+        /* find out whether the file carries parity first */
+        if (priv->xattr_supported) {
+                STACK_WIND (frame, stripe_truncate_getxattr_cbk,
+                            FIRST_CHILD (this),
+                            FIRST_CHILD (this)->fops->getxattr, loc, NULL);
                 return 0;
         }
 
-        STACK_WIND (frame, stripe_single_mknod_cbk,
-                    FIRST_CHILD(this), FIRST_CHILD(this)->fops->mknod,
-                    loc, mode, rdev, params);
+        stripe_truncate_wind (frame, this, offset, 0, 0, 0);
 
         return 0;
 err:
-        STRIPE_STACK_UNWIND (mknod, frame, -1, op_errno, NULL, NULL, NULL, NULL);
+        STRIPE_STACK_UNWIND (truncate, frame, -1, op_errno, NULL, NULL);
         return 0;
 }
 
 
 int32_t
-stripe_mkdir_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
-                  int32_t op_ret, int32_t op_errno, inode_t *inode,
-                  struct iatt *buf, struct iatt *preparent,
-                  struct iatt *postparent)
+stripe_setattr_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                    int32_t op_ret, int32_t op_errno,
+                    struct iatt *preop, struct iatt *postop)
 {
         int32_t         callcnt = 0;
-        stripe_local_t  *local   = NULL;
-        inode_t         *local_inode = NULL;
-        call_frame_t    *prev = NULL;
+        stripe_local_t *local = NULL;
+        call_frame_t   *prev = NULL;
+        off_t           size = 0;
 
         if (!this || !frame || !frame->local || !cookie) {
                 gf_log ("stripe", GF_LOG_DEBUG, "possible NULL deref");
@@ -1543,25 +1962,25 @@ stripe_mkdir_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                                 local->failed = 1;
                 }
 
-                if (op_ret >= 0) {
+                if (op_ret == 0) {
                         local->op_ret = 0;
 
                         if (FIRST_CHILD(this) == prev->this) {
-                                local->inode      = inode_ref (inode);
-                                local->stbuf      = *buf;
-                                local->postparent = *postparent;
-                                local->preparent  = *preparent;
+                                local->pre_buf  = *preop;
+                                local->post_buf = *postop;
                         }
-                        local->stbuf_blocks      += buf->ia_blocks;
-                        local->preparent_blocks  += preparent->ia_blocks;
-                        local->postparent_blocks += postparent->ia_blocks;
 
-                        if (local->stbuf_size < buf->ia_size)
-                                local->stbuf_size = buf->ia_size;
-                        if (local->preparent_size < preparent->ia_size)
-                                local->preparent_size = preparent->ia_size;
-                        if (local->postparent_size < postparent->ia_size)
-                                local->postparent_size = postparent->ia_size;
+                        local->prebuf_blocks  += preop->ia_blocks;
+                        local->postbuf_blocks += postop->ia_blocks;
+
+                        size = stripe_iatt_size (this, local->ictx,
+                                                 prev->this, preop);
+                        if (local->prebuf_size < size)
+                                local->prebuf_size = size;
+                        size = stripe_iatt_size (this, local->ictx,
+                                                 prev->this, postop);
+                        if (local->postbuf_size < size)
+                                local->postbuf_size = size;
                 }
         }
         UNLOCK (&frame->lock);
@@ -1570,37 +1989,32 @@ stripe_mkdir_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                 if (local->failed)
                         local->op_ret = -1;
 
-                local_inode = local->inode;
-
                 if (local->op_ret != -1) {
-                        local->preparent.ia_blocks  = local->preparent_blocks;
-                        local->preparent.ia_size    = local->preparent_size;
-                        local->postparent.ia_blocks = local->postparent_blocks;
-                        local->postparent.ia_size   = local->postparent_size;
-                        local->stbuf.ia_size        = local->stbuf_size;
-                        local->stbuf.ia_blocks      = local->stbuf_blocks;
+                        local->pre_buf.ia_blocks  = local->prebuf_blocks;
+                        local->pre_buf.ia_size    = local->prebuf_size;
+                        local->post_buf.ia_blocks = local->postbuf_blocks;
+                        local->post_buf.ia_size   = local->postbuf_size;
                 }
-                STRIPE_STACK_UNWIND (mkdir, frame, local->op_ret,
-                                     local->op_errno, local->inode,
-                                     &local->stbuf, &local->preparent,
-                                     &local->postparent);
 
-                if (local_inode)
-                        inode_unref (local_inode);
+                STRIPE_STACK_UNWIND (setattr, frame, local->op_ret,
+                                     local->op_errno, &local->pre_buf,
+                                     &local->post_buf);
         }
 out:
         return 0;
 }
 
 
-int
-stripe_mkdir (call_frame_t *frame, xlator_t *this, loc_t *loc, mode_t mode,
-              dict_t *params)
+int32_t
+stripe_setattr (call_frame_t *frame, xlator_t *this, loc_t *loc,
+                struct iatt *stbuf, int32_t valid)
 {
-        stripe_private_t *priv = NULL;
-        stripe_local_t   *local = NULL;
         xlator_list_t    *trav = NULL;
-        int32_t           op_errno = 1;
+        call_stub_t      *stub = NULL;
+        fd_t             *wfd = NULL;
+        stripe_local_t   *local = NULL;
+        stripe_private_t *priv = NULL;
+        int32_t           op_errno = EINVAL;
 
         VALIDATE_OR_GOTO (frame, err);
         VALIDATE_OR_GOTO (this, err);
@@ -1608,6 +2022,16 @@ stripe_mkdir (call_frame_t *frame, xlator_t *this, loc_t *loc, mode_t mode,
         VALIDATE_OR_GOTO (loc->path, err);
         VALIDATE_OR_GOTO (loc->inode, err);
 
+        wfd = stripe_wa_inode_fd (this, loc->inode, NULL);
+        if (wfd) {
+                stub = fop_setattr_stub (frame, stripe_setattr, loc, stbuf, valid);
+                if (stripe_wa_wait (frame, this, wfd, stub)) {
+                        op_errno = ENOMEM;
+                        goto err;
+                }
+                return 0;
+        }
+
         priv = this->private;
         trav = this->children;
 
@@ -1624,36 +2048,88 @@ stripe_mkdir (call_frame_t *frame, xlator_t *this, loc_t *loc, mode_t mode,
                 goto err;
         }
         local->op_ret = -1;
-        local->call_count = priv->child_count;
         frame->local = local;
+        local->ictx = stripe_inode_ctx_find (this, loc->inode);
+        local->call_count = priv->child_count;
 
-        /* Everytime in stripe lookup, all child nodes should be looked up */
         while (trav) {
-                STACK_WIND (frame, stripe_mkdir_cbk,
-                            trav->xlator, trav->xlator->fops->mkdir,
-                            loc, mode, params);
+                STACK_WIND (frame, stripe_setattr_cbk,
+                            trav->xlator, trav->xlator->fops->setattr,
+                            loc, stbuf, valid);
                 trav = trav->next;
         }
 
         return 0;
 err:
-        STRIPE_STACK_UNWIND (mkdir, frame, -1, op_errno, NULL, NULL, NULL, NULL);
+        STRIPE_STACK_UNWIND (setattr, frame, -1, op_errno, NULL, NULL);
         return 0;
 }
 
 
 int32_t
-stripe_link_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
-                 int32_t op_ret, int32_t op_errno, inode_t *inode,
-                 struct iatt *buf, struct iatt *preparent,
-                 struct iatt *postparent)
+stripe_fsetattr (call_frame_t *frame, xlator_t *this, fd_t *fd,
+                 struct iatt *stbuf, int32_t valid)
 {
-        int32_t         callcnt = 0;
-        stripe_local_t  *local   = NULL;
-        inode_t         *local_inode = NULL;
-        call_frame_t    *prev = NULL;
+        stripe_local_t   *local = NULL;
+        call_stub_t      *stub = NULL;
+        fd_t             *wfd = NULL;
+        stripe_private_t *priv = NULL;
+        xlator_list_t    *trav = NULL;
+        int32_t           op_errno = EINVAL;
 
-        if (!this || !frame || !frame->local || !cookie) {
+        VALIDATE_OR_GOTO (frame, err);
+        VALIDATE_OR_GOTO (this, err);
+        VALIDATE_OR_GOTO (fd, err);
+        VALIDATE_OR_GOTO (fd->inode, err);
+
+        wfd = stripe_wa_inode_fd (this, fd->inode, NULL);
+        if (wfd) {
+                stub = fop_fsetattr_stub (frame, stripe_fsetattr, fd, stbuf, valid);
+                if (stripe_wa_wait (frame, this, wfd, stub)) {
+                        op_errno = ENOMEM;
+                        goto err;
+                }
+                return 0;
+        }
+
+        priv = this->private;
+        trav = this->children;
+
+        /* Initialization */
+        local = GF_CALLOC (1, sizeof (stripe_local_t),
+                           gf_stripe_mt_stripe_local_t);
+        if (!local) {
+                op_errno = ENOMEM;
+                goto err;
+        }
+        local->op_ret = -1;
+        frame->local = local;
+        local->ictx = stripe_inode_ctx_find (this, fd->inode);
+        local->call_count = priv->child_count;
+
+        while (trav) {
+                STACK_WIND (frame, stripe_setattr_cbk, trav->xlator,
+                            trav->xlator->fops->fsetattr, fd, stbuf, valid);
+                trav = trav->next;
+        }
+
+        return 0;
+err:
+        STRIPE_STACK_UNWIND (fsetattr, frame, -1, op_errno, NULL, NULL);
+        return 0;
+}
+
+int32_t
+stripe_stack_rename_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                         int32_t op_ret, int32_t op_errno, struct iatt *buf,
+                         struct iatt *preoldparent, struct iatt *postoldparent,
+                         struct iatt *prenewparent, struct iatt *postnewparent)
+{
+        int32_t         callcnt = 0;
+        stripe_local_t *local = NULL;
+        call_frame_t   *prev = NULL;
+
+        if (!this || !frame || !frame->local || !cookie) {
                 gf_log ("stripe", GF_LOG_DEBUG, "possible NULL deref");
                 goto out;
         }
@@ -1675,25 +2151,29 @@ stripe_link_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                                 local->failed = 1;
                 }
 
-                if (op_ret >= 0) {
+                if (op_ret == 0) {
                         local->op_ret = 0;
 
-                        if (FIRST_CHILD(this) == prev->this) {
-                                local->inode      = inode_ref (inode);
-                                local->stbuf      = *buf;
-                                local->postparent = *postparent;
-                                local->preparent  = *preparent;
-                        }
-                        local->stbuf_blocks      += buf->ia_blocks;
-                        local->preparent_blocks  += preparent->ia_blocks;
-                        local->postparent_blocks += postparent->ia_blocks;
+                        local->stbuf.ia_blocks      += buf->ia_blocks;
+                        local->preparent.ia_blocks  += preoldparent->ia_blocks;
+                        local->postparent.ia_blocks += postoldparent->ia_blocks;
+                        local->pre_buf.ia_blocks    += prenewparent->ia_blocks;
+                        local->post_buf.ia_blocks   += postnewparent->ia_blocks;
 
-                        if (local->stbuf_size < buf->ia_size)
-                                local->stbuf_size = buf->ia_size;
-                        if (local->preparent_size < preparent->ia_size)
-                                local->preparent_size = preparent->ia_size;
-                        if (local->postparent_size < postparent->ia_size)
-                                local->postparent_size = postparent->ia_size;
+                        if (local->stbuf.ia_size < buf->ia_size)
+                                local->stbuf.ia_size =  buf->ia_size;
+
+                        if (local->preparent.ia_size < preoldparent->ia_size)
+                                local->preparent.ia_size = preoldparent->ia_size;
+
+                        if (local->postparent.ia_size < postoldparent->ia_size)
+                                local->postparent.ia_size = postoldparent->ia_size;
+
+                        if (local->pre_buf.ia_size < prenewparent->ia_size)
+                                local->pre_buf.ia_size = prenewparent->ia_size;
+
+                        if (local->post_buf.ia_size < postnewparent->ia_size)
+                                local->post_buf.ia_size = postnewparent->ia_size;
                 }
         }
         UNLOCK (&frame->lock);
@@ -1702,46 +2182,81 @@ stripe_link_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                 if (local->failed)
                         local->op_ret = -1;
 
-                local_inode = local->inode;
-
-                if (local->op_ret != -1) {
-                        local->preparent.ia_blocks  = local->preparent_blocks;
-                        local->preparent.ia_size    = local->preparent_size;
-                        local->postparent.ia_blocks = local->postparent_blocks;
-                        local->postparent.ia_size   = local->postparent_size;
-                        local->stbuf.ia_size        = local->stbuf_size;
-                        local->stbuf.ia_blocks      = local->stbuf_blocks;
-                }
-                STRIPE_STACK_UNWIND (link, frame, local->op_ret,
-                                     local->op_errno, local->inode,
+                STRIPE_STACK_UNWIND (rename, frame, local->op_ret, local->op_errno,
                                      &local->stbuf, &local->preparent,
-                                     &local->postparent);
-
-                if (local_inode)
-                        inode_unref (local_inode);
+                                     &local->postparent,  &local->pre_buf,
+                                     &local->post_buf);
         }
 out:
         return 0;
 }
 
 int32_t
-stripe_link (call_frame_t *frame, xlator_t *this, loc_t *oldloc, loc_t *newloc)
+stripe_first_rename_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                         int32_t op_ret, int32_t op_errno, struct iatt *buf,
+                         struct iatt *preoldparent, struct iatt *postoldparent,
+                         struct iatt *prenewparent, struct iatt *postnewparent)
+{
+        stripe_local_t *local = NULL;
+        xlator_list_t  *trav = NULL;
+
+        if (!this || !frame || !frame->local) {
+                gf_log ("stripe", GF_LOG_DEBUG, "possible NULL deref");
+                op_errno = EINVAL;
+                goto unwind;
+        }
+
+        if (op_ret == -1) {
+                goto unwind;
+        }
+
+        local = frame->local;
+        trav = this->children;
+
+        local->stbuf      = *buf;
+        local->preparent  = *preoldparent;
+        local->postparent = *postoldparent;
+        local->pre_buf    = *prenewparent;
+        local->post_buf   = *postnewparent;
+
+        local->op_ret = 0;
+        local->call_count--;
+
+        trav = trav->next; /* Skip first child */
+        while (trav) {
+                STACK_WIND (frame, stripe_stack_rename_cbk,
+                            trav->xlator, trav->xlator->fops->rename,
+                            &local->loc, &local->loc2);
+                trav = trav->next;
+        }
+        return 0;
+
+unwind:
+        STRIPE_STACK_UNWIND (rename, frame, -1, op_errno, buf, preoldparent,
+                             postoldparent, prenewparent, postnewparent);
+        return 0;
+}
+
+int32_t
+stripe_rename (call_frame_t *frame, xlator_t *this, loc_t *oldloc,
+               loc_t *newloc)
 {
-        xlator_list_t    *trav = NULL;
-        stripe_local_t   *local = NULL;
         stripe_private_t *priv = NULL;
-        int32_t           op_errno = 1;
+        stripe_local_t   *local = NULL;
+        xlator_list_t    *trav = NULL;
+        int32_t           op_errno = EINVAL;
 
         VALIDATE_OR_GOTO (frame, err);
         VALIDATE_OR_GOTO (this, err);
         VALIDATE_OR_GOTO (oldloc, err);
         VALIDATE_OR_GOTO (oldloc->path, err);
         VALIDATE_OR_GOTO (oldloc->inode, err);
+        VALIDATE_OR_GOTO (newloc, err);
 
         priv = this->private;
         trav = this->children;
 
-        /* If any one node is down, don't allow link operation */
+        /* If any one node is down, don't allow rename */
         if (priv->nodes_down) {
                 op_errno = ENOTCONN;
                 goto err;
@@ -1755,88 +2270,291 @@ stripe_link (call_frame_t *frame, xlator_t *this, loc_t *oldloc, loc_t *newloc)
                 goto err;
         }
         local->op_ret = -1;
-        frame->local = local;
+        loc_copy (&local->loc, oldloc);
+        loc_copy (&local->loc2, newloc);
+
         local->call_count = priv->child_count;
 
-        /* Everytime in stripe lookup, all child
-           nodes should be looked up */
-        while (trav) {
-                STACK_WIND (frame, stripe_link_cbk,
-                            trav->xlator, trav->xlator->fops->link,
-                            oldloc, newloc);
-                trav = trav->next;
-        }
+        frame->local = local;
+
+        STACK_WIND (frame, stripe_first_rename_cbk, trav->xlator,
+                    trav->xlator->fops->rename, oldloc, newloc);
 
         return 0;
 err:
-        STRIPE_STACK_UNWIND (link, frame, -1, op_errno, NULL, NULL, NULL, NULL);
+        STRIPE_STACK_UNWIND (rename, frame, -1, op_errno, NULL, NULL, NULL,
+                             NULL, NULL);
         return 0;
 }
 
+
+
 int32_t
-stripe_create_fail_unlink_cbk (call_frame_t *frame, void *cookie,
-                               xlator_t *this, int32_t op_ret,
-                               int32_t op_errno, struct iatt *preparent,
-                               struct iatt *postparent)
+stripe_unlink_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                   int32_t op_ret, int32_t op_errno, struct iatt *preparent,
+                   struct iatt *postparent)
 {
         int32_t         callcnt = 0;
-        fd_t           *lfd = NULL;
-        stripe_local_t *local = NULL;
-        inode_t        *local_inode = NULL;
+        stripe_local_t *local   = NULL;
+        call_frame_t   *prev = NULL;
 
-        if (!this || !frame || !frame->local) {
+        if (!this || !frame || !frame->local || !cookie) {
                 gf_log ("stripe", GF_LOG_DEBUG, "possible NULL deref");
                 goto out;
         }
 
+        prev  = cookie;
         local = frame->local;
 
         LOCK (&frame->lock);
         {
                 callcnt = --local->call_count;
+
+                if (op_ret == -1) {
+                        gf_log (this->name, GF_LOG_DEBUG, "%s returned %s",
+                                prev->this->name, strerror (op_errno));
+                        local->op_errno = op_errno;
+                        if ((op_errno != ENOENT) ||
+                            (prev->this == FIRST_CHILD (this)))
+                                local->failed = 1;
+                }
+                if (op_ret >= 0) {
+                        local->op_ret = op_ret;
+                        if (FIRST_CHILD(this) == prev->this) {
+                                local->preparent  = *preparent;
+                                local->postparent = *postparent;
+                        }
+                        local->preparent_blocks  += preparent->ia_blocks;
+                        local->postparent_blocks += postparent->ia_blocks;
+
+                        if (local->preparent_size < preparent->ia_size)
+                                local->preparent_size = preparent->ia_size;
+
+                        if (local->postparent_size < postparent->ia_size)
+                                local->postparent_size = postparent->ia_size;
+                }
         }
         UNLOCK (&frame->lock);
 
         if (!callcnt) {
-                local_inode = local->inode;
-                lfd = local->fd;
+                if (local->failed)
+                        local->op_ret = -1;
 
-                STRIPE_STACK_UNWIND (create, frame, local->op_ret, local->op_errno,
-                                     local->fd, local->inode, &local->stbuf,
-                                     &local->preparent, &local->postparent);
+                if (local->op_ret != -1) {
+                        local->preparent.ia_blocks  = local->preparent_blocks;
+                        local->preparent.ia_size    = local->preparent_size;
+                        local->postparent.ia_blocks = local->postparent_blocks;
+                        local->postparent.ia_size   = local->postparent_size;
+                }
 
-                if (local_inode)
-                        inode_unref (local_inode);
-                if (lfd)
-                        fd_unref (lfd);
+                STRIPE_STACK_UNWIND (unlink, frame, local->op_ret,
+                                     local->op_errno, &local->preparent,
+                                     &local->postparent);
         }
 out:
         return 0;
 }
 
-
 int32_t
-stripe_create_setxattr_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
-                            int32_t op_ret, int32_t op_errno)
+stripe_unlink (call_frame_t *frame, xlator_t *this, loc_t *loc)
 {
-        inode_t          *local_inode = NULL;
-        fd_t             *lfd = NULL;
+        xlator_list_t    *trav = NULL;
         stripe_local_t   *local = NULL;
         stripe_private_t *priv = NULL;
-        xlator_list_t    *trav = NULL;
-        int32_t           callcnt = 0;
-        call_frame_t   *prev = NULL;
+        int32_t           op_errno = EINVAL;
 
-        if (!this || !frame || !frame->local || !cookie) {
-                gf_log ("stripe", GF_LOG_DEBUG, "possible NULL deref");
-                goto out;
-        }
+        VALIDATE_OR_GOTO (frame, err);
+        VALIDATE_OR_GOTO (this, err);
+        VALIDATE_OR_GOTO (loc, err);
+        VALIDATE_OR_GOTO (loc->path, err);
+        VALIDATE_OR_GOTO (loc->inode, err);
+
+        priv = this->private;
+        trav = this->children;
+
+        if (priv->first_child_down) {
+                op_errno = ENOTCONN;
+                goto err;
+        }
+
+        /* Don't unlink a file if a node is down */
+        if (priv->nodes_down) {
+                op_errno = ENOTCONN;
+                goto err;
+        }
+
+        /* Initialization */
+        local = GF_CALLOC (1, sizeof (stripe_local_t),
+                           gf_stripe_mt_stripe_local_t);
+        if (!local) {
+                op_errno = ENOMEM;
+                goto err;
+        }
+        local->op_ret = -1;
+        frame->local = local;
+        local->call_count = priv->child_count;
+
+        while (trav) {
+                STACK_WIND (frame, stripe_unlink_cbk,
+                            trav->xlator, trav->xlator->fops->unlink,
+                            loc);
+                trav = trav->next;
+        }
+
+        return 0;
+err:
+        STRIPE_STACK_UNWIND (unlink, frame, -1, op_errno, NULL, NULL);
+        return 0;
+}
+
+
+int32_t
+stripe_first_rmdir_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                        int32_t op_ret, int32_t op_errno,struct iatt *preparent,
+                        struct iatt *postparent)
+
+{
+        xlator_list_t *trav = NULL;
+        stripe_local_t *local = NULL;
+
+        if (!this || !frame || !frame->local) {
+                gf_log ("stripe", GF_LOG_DEBUG, "possible NULL deref");
+                op_errno = EINVAL;
+                goto err;
+        }
+
+        if (op_ret == -1) {
+                goto err;
+        }
+
+        trav = this->children;
+        local = frame->local;
+
+        local->call_count--; /* First child successful */
+        trav = trav->next; /* Skip first child */
+
+        local->preparent  = *preparent;
+        local->postparent = *postparent;
+        local->preparent_size  = preparent->ia_size;
+        local->postparent_size = postparent->ia_size;
+        local->preparent_blocks  += preparent->ia_blocks;
+        local->postparent_blocks += postparent->ia_blocks;
+
+        while (trav) {
+                STACK_WIND (frame, stripe_unlink_cbk, trav->xlator,
+                            trav->xlator->fops->rmdir, &local->loc,
+                            local->flags);
+                trav = trav->next;
+        }
+
+        return 0;
+err:
+        STRIPE_STACK_UNWIND (rmdir, frame, op_ret, op_errno, NULL, NULL);
+        return 0;
+
+}
+
+int32_t
+stripe_rmdir (call_frame_t *frame, xlator_t *this, loc_t *loc, int flags)
+{
+        xlator_list_t    *trav = NULL;
+        stripe_local_t   *local = NULL;
+        stripe_private_t *priv = NULL;
+        int32_t           op_errno = EINVAL;
+
+        VALIDATE_OR_GOTO (frame, err);
+        VALIDATE_OR_GOTO (this, err);
+        VALIDATE_OR_GOTO (loc, err);
+        VALIDATE_OR_GOTO (loc->path, err);
+        VALIDATE_OR_GOTO (loc->inode, err);
+
+        priv = this->private;
+        trav = this->children;
+
+        /* don't delete a directory if any of the subvolume is down */
+        if (priv->nodes_down) {
+                op_errno = ENOTCONN;
+                goto err;
+        }
+
+        /* Initialization */
+        local = GF_CALLOC (1, sizeof (stripe_local_t),
+                           gf_stripe_mt_stripe_local_t);
+        if (!local) {
+                op_errno = ENOMEM;
+                goto err;
+        }
+        local->op_ret = -1;
+        frame->local = local;
+        loc_copy (&local->loc, loc);
+        local->flags = flags;
+        local->call_count = priv->child_count;
+
+        STACK_WIND (frame, stripe_first_rmdir_cbk,  trav->xlator,
+                    trav->xlator->fops->rmdir, loc, flags);
+
+        return 0;
+err:
+        STRIPE_STACK_UNWIND (rmdir, frame, -1, op_errno, NULL, NULL);
+        return 0;
+}
+
+
+int32_t
+stripe_mknod_ifreg_fail_unlink_cbk (call_frame_t *frame, void *cookie,
+                                    xlator_t *this, int32_t op_ret,
+                                    int32_t op_errno, struct iatt *preparent,
+                                    struct iatt *postparent)
+{
+        int32_t         callcnt = 0;
+        stripe_local_t *local = NULL;
+
+        if (!this || !frame || !frame->local) {
+                gf_log ("stripe", GF_LOG_DEBUG, "possible NULL deref");
+                goto out;
+        }
 
-        prev  = cookie;
-	priv  = this->private;
         local = frame->local;
 
         LOCK (&frame->lock);
+        {
+                callcnt = --local->call_count;
+        }
+        UNLOCK (&frame->lock);
+
+        if (!callcnt) {
+                STRIPE_STACK_UNWIND (mknod, frame, local->op_ret, local->op_errno,
+                                     local->inode, &local->stbuf,
+                                     &local->preparent, &local->postparent);
+        }
+out:
+        return 0;
+}
+
+
+/**
+ */
+int32_t
+stripe_mknod_ifreg_setxattr_cbk (call_frame_t *frame, void *cookie,
+                                 xlator_t *this, int32_t op_ret,
+                                 int32_t op_errno)
+{
+        int32_t           callcnt = 0;
+        stripe_local_t   *local = NULL;
+        stripe_private_t *priv = NULL;
+        xlator_list_t    *trav = NULL;
+        call_frame_t     *prev = NULL;
+
+        if (!this || !frame || !frame->local || !cookie) {
+                gf_log ("stripe", GF_LOG_DEBUG, "possible NULL deref");
+                goto out;
+        }
+
+        prev  = cookie;
+        priv  = this->private;
+        local = frame->local;
+
+	LOCK (&frame->lock);
         {
                 callcnt = --local->call_count;
 
@@ -1853,49 +2571,36 @@ stripe_create_setxattr_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
         if (!callcnt) {
                 if (local->op_ret == -1) {
                         local->call_count = priv->child_count;
-                        trav = this->children;
                         while (trav) {
                                 STACK_WIND (frame,
-                                            stripe_create_fail_unlink_cbk,
+                                            stripe_mknod_ifreg_fail_unlink_cbk,
                                             trav->xlator,
                                             trav->xlator->fops->unlink,
                                             &local->loc);
                                 trav = trav->next;
                         }
-
                         return 0;
                 }
 
-                lfd = local->fd;
-                local_inode = local->inode;
-
-                STRIPE_STACK_UNWIND (create, frame, local->op_ret, local->op_errno,
-                                     local->fd, local->inode, &local->stbuf,
+                STRIPE_STACK_UNWIND (mknod, frame, local->op_ret, local->op_errno,
+                                     local->inode, &local->stbuf,
                                      &local->preparent, &local->postparent);
-
-                if (local_inode)
-                        inode_unref (local_inode);
-                if (lfd)
-                        fd_unref (lfd);
         }
 out:
         return 0;
 }
 
 int32_t
-stripe_create_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
-                   int32_t op_ret, int32_t op_errno, fd_t *fd,
-                   inode_t *inode, struct iatt *buf, struct iatt *preparent,
-                   struct iatt *postparent)
+stripe_mknod_ifreg_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                        int32_t op_ret, int32_t op_errno, inode_t *inode,
+                        struct iatt *buf, struct iatt *preparent,
+                        struct iatt *postparent)
 {
+        int               ret = 0;
         int32_t           callcnt = 0;
         stripe_local_t   *local = NULL;
         stripe_private_t *priv = NULL;
-        fd_t             *lfd = NULL;
-        stripe_fd_ctx_t  *fctx = NULL;
-        inode_t          *local_inode = NULL;
         call_frame_t     *prev = NULL;
-        int               ret = 0;
 
         if (!this || !frame || !frame->local || !cookie) {
                 gf_log ("stripe", GF_LOG_DEBUG, "possible NULL deref");
@@ -1903,7 +2608,7 @@ stripe_create_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
         }
 
         prev  = cookie;
-        priv  = this->private;
+	priv  = this->private;
         local = frame->local;
 
         LOCK (&frame->lock);
@@ -1922,8 +2627,7 @@ stripe_create_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 
                 if (op_ret >= 0) {
                         local->op_ret = op_ret;
-                        /* Get the mapping in inode private */
-                        /* Get the stat buf right */
+
                         if (FIRST_CHILD(this) == prev->this) {
                                 local->stbuf      = *buf;
                                 local->preparent  = *preparent;
@@ -1957,40 +2661,34 @@ stripe_create_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                         local->stbuf.ia_blocks      = local->stbuf_blocks;
                 }
 
-                /* */
-                if (local->op_ret >= 0) {
-                        fctx = GF_CALLOC (1, sizeof (stripe_fd_ctx_t),
-                                          gf_stripe_mt_stripe_fd_ctx_t);
-                        if (!fctx) {
-                                local->op_ret = -1;
-                                local->op_errno = ENOMEM;
-                                goto unwind;
-                        }
+                if ((local->op_ret != -1) && priv->xattr_supported) {
+                        /* Send a setxattr request to nodes where the
+                           files are created */
+                        int32_t  i              = 0;
+                        char     size_key[256]  = {0,};
+                        char     index_key[256] = {0,};
+                        char     count_key[256] = {0,};
+                        char     redundancy_key[256] = {0,};
+                        char     coalesce_key[256] = {0,};
+                        dict_t  *dict           = NULL;
 
-                        fctx->stripe_size  = local->stripe_size;
-                        fctx->stripe_count = priv->child_count;
-                        fctx->static_array = 1;
-                        fctx->xl_array = priv->xl_array;
-                        fd_ctx_set (local->fd, this,
-                                    (uint64_t)(long)fctx);
-                }
-
-                if ((local->op_ret != -1) &&
-                    local->stripe_size && priv->xattr_supported) {
-                        /* Send a setxattr request to nodes where
-                           the files are created */
-                        int32_t        i = 0;
-                        char           size_key[256] = {0,};
-                        char           index_key[256] = {0,};
-                        char           count_key[256] = {0,};
-                        dict_t        *dict = NULL;
-
-                        sprintf (size_key,
-                                 "trusted.%s.stripe-size", this->name);
-                        sprintf (count_key,
-                                 "trusted.%s.stripe-count", this->name);
-                        sprintf (index_key,
-                                 "trusted.%s.stripe-index", this->name);
+                        sprintf (size_key,
+                                 "trusted.%s.stripe-size", this->name);
+                        sprintf (count_key,
+                                 "trusted.%s.stripe-count", this->name);
+                        sprintf (index_key,
+                                 "trusted.%s.stripe-index", this->name);
+                        sprintf (redundancy_key,
+                                 "trusted.%s.stripe-redundancy", this->name);
+                        sprintf (coalesce_key,
+                                 "trusted.%s.stripe-coalesce", this->name);
+
+                        if (priv->coalesce)
+                                stripe_inode_set_coalesced (this,
+                                                            local->inode,
+                                                            local->stripe_size,
+                                                            priv->child_count -
+                                                            priv->redundancy);
 
                         local->call_count = priv->child_count;
                         memcpy (local->loc.inode->gfid, local->stbuf.ia_gfid, 16);
@@ -1998,32 +2696,52 @@ stripe_create_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                                 dict = get_new_dict ();
                                 if (!dict) {
                                         gf_log (this->name, GF_LOG_ERROR,
-                                                "error allocating dict");
+                                                "failed to allocate dict");
                                 }
-                                dict_ref (dict);
 
-                                /* TODO: check return values */
+                                dict_ref (dict);
+                                /* TODO: check return value */
                                 ret = dict_set_int64 (dict, size_key,
                                                       local->stripe_size);
                                 if (ret)
                                         gf_log (this->name, GF_LOG_ERROR,
                                                 "%s: set stripe-size failed",
                                                 local->loc.path);
-
                                 ret = dict_set_int32 (dict, count_key,
                                                       priv->child_count);
                                 if (ret)
                                         gf_log (this->name, GF_LOG_ERROR,
-                                                "%s: set stripe-size failed",
+                                                "%s: set child_count failed",
                                                 local->loc.path);
-
                                 ret = dict_set_int32 (dict, index_key, i);
                                 if (ret)
                                         gf_log (this->name, GF_LOG_ERROR,
-                                                "%s: set stripe-size failed",
+                                                "%s: set stripe-index failed",
                                                 local->loc.path);
+                                if (priv->redundancy) {
+                                        ret = dict_set_int32 (dict,
+                                                              redundancy_key,
+                                                              priv->redundancy);
+                                        if (ret)
+                                                gf_log (this->name,
+                                                        GF_LOG_ERROR,
+                                                        "%s: set stripe-"
+                                                        "redundancy failed",
+                                                        local->loc.path);
+                                }
+                                if (priv->coalesce) {
+                                        ret = dict_set_int32 (dict,
+                                                              coalesce_key, 1);
+                                        if (ret)
+                                                gf_log (this->name,
+                                                        GF_LOG_ERROR,
+                                                        "%s: set stripe-"
+                                                        "coalesce failed",
+                                                        local->loc.path);
+                                }
 
-                                STACK_WIND (frame, stripe_create_setxattr_cbk,
+                                STACK_WIND (frame,
+                                            stripe_mknod_ifreg_setxattr_cbk,
                                             priv->xl_array[i],
                                             priv->xl_array[i]->fops->setxattr,
                                             &local->loc, dict, 0);
@@ -2033,37 +2751,32 @@ stripe_create_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                         return 0;
                 }
 
-unwind:
                 /* Create itself has failed.. so return
                    without setxattring */
-                lfd = local->fd;
-                local_inode = local->inode;
-
-                STRIPE_STACK_UNWIND (create, frame, local->op_ret,
-                                     local->op_errno, local->fd,
+                STRIPE_STACK_UNWIND (mknod, frame, local->op_ret, local->op_errno,
                                      local->inode, &local->stbuf,
                                      &local->preparent, &local->postparent);
-
-                if (local_inode)
-                        inode_unref (local_inode);
-                if (lfd)
-                        fd_unref (lfd);
         }
-
 out:
         return 0;
 }
 
 
-/**
- * stripe_create - If a block-size is specified for the 'name', create the
- *    file in all the child nodes. If not, create it in only first child.
- *
- * @name- complete path of the file to be created.
- */
 int32_t
-stripe_create (call_frame_t *frame, xlator_t *this, loc_t *loc,
-               int32_t flags, mode_t mode, fd_t *fd, dict_t *params)
+stripe_single_mknod_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                         int32_t op_ret, int32_t op_errno, inode_t *inode,
+                         struct iatt *buf, struct iatt *preparent,
+                         struct iatt *postparent)
+{
+        STRIPE_STACK_UNWIND (mknod, frame, op_ret, op_errno, inode, buf,
+                             preparent, postparent);
+        return 0;
+}
+
+
+int
+stripe_mknod (call_frame_t *frame, xlator_t *this, loc_t *loc, mode_t mode,
+              dev_t rdev, dict_t *params)
 {
         stripe_private_t *priv = NULL;
         stripe_local_t   *local = NULL;
@@ -2077,59 +2790,76 @@ stripe_create (call_frame_t *frame, xlator_t *this, loc_t *loc,
         VALIDATE_OR_GOTO (loc->inode, err);
 
         priv = this->private;
+        trav = this->children;
 
-        /* files created in O_APPEND mode does not allow lseek() on fd */
-        flags &= ~O_APPEND;
-
-        if (priv->first_child_down || priv->nodes_down) {
-                gf_log (this->name, GF_LOG_DEBUG,
-                        "First node down, returning EIO");
-                op_errno = EIO;
+        if (priv->first_child_down) {
+                op_errno = ENOTCONN;
                 goto err;
         }
 
-        /* Initialization */
-        local = GF_CALLOC (1, sizeof (stripe_local_t),
-                           gf_stripe_mt_stripe_local_t);
-        if (!local) {
-                op_errno = ENOMEM;
-                goto err;
-        }
-        local->op_ret = -1;
-        local->op_errno = ENOTCONN;
-        local->stripe_size = stripe_get_matching_bs (loc->path,
-                                                     priv->pattern,
-                                                     priv->block_size);
-        frame->local = local;
-        local->inode = inode_ref (loc->inode);
-        loc_copy (&local->loc, loc);
-        local->fd = fd_ref (fd);
+        if (S_ISREG(mode)) {
+                /* NOTE: on older kernels (older than 2.6.9),
+                   creat() fops is sent as mknod() + open(). Hence handling
+                   S_IFREG files is necessary */
+                if (priv->nodes_down) {
+                        gf_log (this->name, GF_LOG_WARNING,
+                                "Some node down, returning EIO");
+                        op_errno = EIO;
+                        goto err;
+                }
 
-        local->call_count = priv->child_count;
+                /* Initialization */
+                local = GF_CALLOC (1, sizeof (stripe_local_t),
+                                   gf_stripe_mt_stripe_local_t);
+                if (!local) {
+                        op_errno = ENOMEM;
+                        goto err;
+                }
+                local->op_ret = -1;
+                local->op_errno = ENOTCONN;
+                local->stripe_size = stripe_get_matching_bs (loc->path,
+                                                             priv->pattern,
+                                                             priv->block_size);
+                frame->local = local;
+                local->inode = loc->inode;
+                loc_copy (&local->loc, loc);
 
-        trav = this->children;
-        while (trav) {
-                STACK_WIND (frame, stripe_create_cbk, trav->xlator,
-                            trav->xlator->fops->create, loc, flags,
-                            mode, fd, params);
-                trav = trav->next;
+                /* Everytime in stripe lookup, all child nodes should
+                   be looked up */
+                local->call_count = priv->child_count;
+
+                while (trav) {
+                        STACK_WIND (frame, stripe_mknod_ifreg_cbk,
+                                    trav->xlator, trav->xlator->fops->mknod,
+                                    loc, mode, rdev, params);
+                        trav = trav->next;
+                }
+
+                /* This case is handled, no need to continue further. */
+                return 0;
         }
 
+        STACK_WIND (frame, stripe_single_mknod_cbk,
+                    FIRST_CHILD(this), FIRST_CHILD(this)->fops->mknod,
+                    loc, mode, rdev, params);
+
         return 0;
 err:
-        STRIPE_STACK_UNWIND (create, frame, -1, op_errno, NULL, NULL, NULL,
-                             NULL, NULL);
+        STRIPE_STACK_UNWIND (mknod, frame, -1, op_errno, NULL, NULL, NULL, NULL);
         return 0;
 }
 
+
 int32_t
-stripe_open_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
-                 int32_t op_ret, int32_t op_errno, fd_t *fd)
+stripe_mkdir_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                  int32_t op_ret, int32_t op_errno, inode_t *inode,
+                  struct iatt *buf, struct iatt *preparent,
+                  struct iatt *postparent)
 {
         int32_t         callcnt = 0;
-        stripe_local_t *local = NULL;
-        fd_t           *lfd = NULL;
-        call_frame_t   *prev = NULL;
+        stripe_local_t  *local   = NULL;
+        inode_t         *local_inode = NULL;
+        call_frame_t    *prev = NULL;
 
         if (!this || !frame || !frame->local || !cookie) {
                 gf_log ("stripe", GF_LOG_DEBUG, "possible NULL deref");
@@ -2144,18 +2874,35 @@ stripe_open_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                 callcnt = --local->call_count;
 
                 if (op_ret == -1) {
-
                         gf_log (this->name, GF_LOG_DEBUG,
                                 "%s returned error %s",
                                 prev->this->name, strerror (op_errno));
+                        local->op_errno = op_errno;
                         if ((op_errno != ENOENT) ||
                             (prev->this == FIRST_CHILD (this)))
                                 local->failed = 1;
-                        local->op_errno = op_errno;
                 }
 
-                if (op_ret >= 0)
-                        local->op_ret = op_ret;
+                if (op_ret >= 0) {
+                        local->op_ret = 0;
+
+                        if (FIRST_CHILD(this) == prev->this) {
+                                local->inode      = inode_ref (inode);
+                                local->stbuf      = *buf;
+                                local->postparent = *postparent;
+                                local->preparent  = *preparent;
+                        }
+                        local->stbuf_blocks      += buf->ia_blocks;
+                        local->preparent_blocks  += preparent->ia_blocks;
+                        local->postparent_blocks += postparent->ia_blocks;
+
+                        if (local->stbuf_size < buf->ia_size)
+                                local->stbuf_size = buf->ia_size;
+                        if (local->preparent_size < preparent->ia_size)
+                                local->preparent_size = preparent->ia_size;
+                        if (local->postparent_size < postparent->ia_size)
+                                local->postparent_size = postparent->ia_size;
+                }
         }
         UNLOCK (&frame->lock);
 
@@ -2163,227 +2910,1220 @@ stripe_open_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                 if (local->failed)
                         local->op_ret = -1;
 
-                if (local->op_ret == -1) {
-                        if (local->fctx) {
-                                if (!local->fctx->static_array)
-                                        GF_FREE (local->fctx->xl_array);
-                                GF_FREE (local->fctx);
-                        }
-                } else {
-                        fd_ctx_set (local->fd, this,
-                                    (uint64_t)(long)local->fctx);
-                }
-
-                lfd = local->fd;
+                local_inode = local->inode;
 
-                STRIPE_STACK_UNWIND (open, frame, local->op_ret,
-                                     local->op_errno, local->fd);
-                if (lfd)
-                        fd_unref (lfd);
+                if (local->op_ret != -1) {
+                        local->preparent.ia_blocks  = local->preparent_blocks;
+                        local->preparent.ia_size    = local->preparent_size;
+                        local->postparent.ia_blocks = local->postparent_blocks;
+                        local->postparent.ia_size   = local->postparent_size;
+                        local->stbuf.ia_size        = local->stbuf_size;
+                        local->stbuf.ia_blocks      = local->stbuf_blocks;
+                }
+                STRIPE_STACK_UNWIND (mkdir, frame, local->op_ret,
+                                     local->op_errno, local->inode,
+                                     &local->stbuf, &local->preparent,
+                                     &local->postparent);
 
+                if (local_inode)
+                        inode_unref (local_inode);
         }
 out:
         return 0;
 }
 
 
-int32_t
-stripe_open_getxattr_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
-                          int32_t op_ret, int32_t op_errno, dict_t *dict)
+int
+stripe_mkdir (call_frame_t *frame, xlator_t *this, loc_t *loc, mode_t mode,
+              dict_t *params)
 {
-        int32_t           index = 0;
-        int32_t           callcnt = 0;
-        char              key[256] = {0,};
+        stripe_private_t *priv = NULL;
         stripe_local_t   *local = NULL;
         xlator_list_t    *trav = NULL;
-        stripe_private_t *priv = NULL;
-        data_t           *data = NULL;
-        call_frame_t     *prev = NULL;
-        fd_t             *lfd = NULL;
+        int32_t           op_errno = 1;
 
-        if (!this || !frame || !frame->local || !cookie) {
-                gf_log ("stripe", GF_LOG_DEBUG, "possible NULL deref");
-                goto out;
-        }
+        VALIDATE_OR_GOTO (frame, err);
+        VALIDATE_OR_GOTO (this, err);
+        VALIDATE_OR_GOTO (loc, err);
+        VALIDATE_OR_GOTO (loc->path, err);
+        VALIDATE_OR_GOTO (loc->inode, err);
 
-        prev  = (call_frame_t *)cookie;
-        priv  = this->private;
-        local = frame->local;
+        priv = this->private;
+        trav = this->children;
 
-        LOCK (&frame->lock);
-        {
-                callcnt = --local->call_count;
+        if (priv->first_child_down) {
+                op_errno = ENOTCONN;
+                goto err;
+        }
 
-                if (op_ret == -1) {
-                        gf_log (this->name, GF_LOG_DEBUG,
-                                "%s returned error %s",
-                                prev->this->name, strerror (op_errno));
-                        local->op_ret = -1;
-                        if (local->op_errno != EIO)
-                                local->op_errno = op_errno;
+        /* Initialization */
+        local = GF_CALLOC (1, sizeof (stripe_local_t),
+                           gf_stripe_mt_stripe_local_t);
+        if (!local) {
+                op_errno = ENOMEM;
+                goto err;
+        }
+        local->op_ret = -1;
+        local->call_count = priv->child_count;
+        frame->local = local;
+
+        /* Everytime in stripe lookup, all child nodes should be looked up */
+        while (trav) {
+                STACK_WIND (frame, stripe_mkdir_cbk,
+                            trav->xlator, trav->xlator->fops->mkdir,
+                            loc, mode, params);
+                trav = trav->next;
+        }
+
+        return 0;
+err:
+        STRIPE_STACK_UNWIND (mkdir, frame, -1, op_errno, NULL, NULL, NULL, NULL);
+        return 0;
+}
+
+
+int32_t
+stripe_link_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                 int32_t op_ret, int32_t op_errno, inode_t *inode,
+                 struct iatt *buf, struct iatt *preparent,
+                 struct iatt *postparent)
+{
+        int32_t         callcnt = 0;
+        stripe_local_t  *local   = NULL;
+        inode_t         *local_inode = NULL;
+        call_frame_t    *prev = NULL;
+
+        if (!this || !frame || !frame->local || !cookie) {
+                gf_log ("stripe", GF_LOG_DEBUG, "possible NULL deref");
+                goto out;
+        }
+
+        prev  = cookie;
+        local = frame->local;
+
+        LOCK (&frame->lock);
+        {
+                callcnt = --local->call_count;
+
+                if (op_ret == -1) {
+                        gf_log (this->name, GF_LOG_DEBUG,
+                                "%s returned error %s",
+                                prev->this->name, strerror (op_errno));
+                        local->op_errno = op_errno;
                         if ((op_errno != ENOENT) ||
                             (prev->this == FIRST_CHILD (this)))
                                 local->failed = 1;
-                        goto unlock;
                 }
 
-                if (!dict)
-                        goto unlock;
+                if (op_ret >= 0) {
+                        local->op_ret = 0;
 
-                if (!local->fctx) {
-                        local->fctx =  GF_CALLOC (1, sizeof (stripe_fd_ctx_t),
-                                                  gf_stripe_mt_stripe_fd_ctx_t);
-                        if (!local->fctx) {
-                                local->op_errno = ENOMEM;
-                                local->op_ret = -1;
-                                goto unlock;
+                        if (FIRST_CHILD(this) == prev->this) {
+                                local->inode      = inode_ref (inode);
+                                local->stbuf      = *buf;
+                                local->postparent = *postparent;
+                                local->preparent  = *preparent;
                         }
+                        local->stbuf_blocks      += buf->ia_blocks;
+                        local->preparent_blocks  += preparent->ia_blocks;
+                        local->postparent_blocks += postparent->ia_blocks;
 
-                        local->fctx->static_array = 0;
+                        if (local->stbuf_size < buf->ia_size)
+                                local->stbuf_size = buf->ia_size;
+                        if (local->preparent_size < preparent->ia_size)
+                                local->preparent_size = preparent->ia_size;
+                        if (local->postparent_size < postparent->ia_size)
+                                local->postparent_size = postparent->ia_size;
                 }
-                /* Stripe block size */
-                sprintf (key, "trusted.%s.stripe-size", this->name);
-                data = dict_get (dict, key);
-                if (!data) {
-                        local->xattr_self_heal_needed = 1;
-                } else {
-                        if (!local->fctx->stripe_size) {
-                                local->fctx->stripe_size =
-                                        data_to_int64 (data);
-                        }
+        }
+        UNLOCK (&frame->lock);
 
-                        if (local->fctx->stripe_size != data_to_int64 (data)) {
-                                gf_log (this->name, GF_LOG_WARNING,
-                                        "stripe-size mismatch in blocks");
-                                local->xattr_self_heal_needed = 1;
-                        }
-                }
-                /* Stripe count */
-                sprintf (key, "trusted.%s.stripe-count", this->name);
-                data = dict_get (dict, key);
-                if (!data) {
-                        local->xattr_self_heal_needed = 1;
-                        goto unlock;
-                }
-                if (!local->fctx->xl_array) {
-                        local->fctx->stripe_count = data_to_int32 (data);
-                        if (!local->fctx->stripe_count) {
-                                gf_log (this->name, GF_LOG_ERROR,
-                                        "error with stripe-count xattr");
-                                local->op_ret   = -1;
-                                local->op_errno = EIO;
-                                goto unlock;
-                        }
+        if (!callcnt) {
+                if (local->failed)
+                        local->op_ret = -1;
 
-                        local->fctx->xl_array =
-                                GF_CALLOC (local->fctx->stripe_count,
-                                           sizeof (xlator_t *),
-                                           gf_stripe_mt_xlator_t);
-                        if (!local->fctx->xl_array) {
-                                local->op_errno = ENOMEM;
-                                local->op_ret   = -1;
-                                goto unlock;
-                        }
-                }
-                if (local->fctx->stripe_count != data_to_int32 (data)) {
-                        gf_log (this->name, GF_LOG_ERROR,
-                                "error with stripe-count xattr (%d != %d)",
-                                local->fctx->stripe_count, data_to_int32 (data));
-                        local->op_ret   = -1;
-                        local->op_errno = EIO;
-                        goto unlock;
-                }
+                local_inode = local->inode;
 
-                /* index */
-                sprintf (key, "trusted.%s.stripe-index", this->name);
-                data = dict_get (dict, key);
-                if (!data) {
-                        local->xattr_self_heal_needed = 1;
-                        goto unlock;
-                }
-                index = data_to_int32 (data);
-                if (index > priv->child_count) {
-                        gf_log (this->name, GF_LOG_ERROR,
-                                "error with stripe-index xattr (%d)", index);
-                        local->op_ret   = -1;
-                        local->op_errno = EIO;
-                        goto unlock;
-                }
-                if (local->fctx->xl_array) {
-                        if (local->fctx->xl_array[index]) {
-                                gf_log (this->name, GF_LOG_ERROR,
-                                        "duplicate entry @ index (%d)", index);
-                                local->op_ret   = -1;
-                                local->op_errno = EIO;
-                                goto unlock;
-                        }
-                        local->fctx->xl_array[index] = prev->this;
+                if (local->op_ret != -1) {
+                        local->preparent.ia_blocks  = local->preparent_blocks;
+                        local->preparent.ia_size    = local->preparent_size;
+                        local->postparent.ia_blocks = local->postparent_blocks;
+                        local->postparent.ia_size   = local->postparent_size;
+                        local->stbuf.ia_size        = local->stbuf_size;
+                        local->stbuf.ia_blocks      = local->stbuf_blocks;
                 }
-                local->entry_count++;
-                local->op_ret = 0;
+                STRIPE_STACK_UNWIND (link, frame, local->op_ret,
+                                     local->op_errno, local->inode,
+                                     &local->stbuf, &local->preparent,
+                                     &local->postparent);
+
+                if (local_inode)
+                        inode_unref (local_inode);
+        }
+out:
+        return 0;
+}
+
+int32_t
+stripe_link (call_frame_t *frame, xlator_t *this, loc_t *oldloc, loc_t *newloc)
+{
+        xlator_list_t    *trav = NULL;
+        stripe_local_t   *local = NULL;
+        stripe_private_t *priv = NULL;
+        int32_t           op_errno = 1;
+
+        VALIDATE_OR_GOTO (frame, err);
+        VALIDATE_OR_GOTO (this, err);
+        VALIDATE_OR_GOTO (oldloc, err);
+        VALIDATE_OR_GOTO (oldloc->path, err);
+        VALIDATE_OR_GOTO (oldloc->inode, err);
+
+        priv = this->private;
+        trav = this->children;
+
+        /* If any one node is down, don't allow link operation */
+        if (priv->nodes_down) {
+                op_errno = ENOTCONN;
+                goto err;
+        }
+
+        /* Initialization */
+        local = GF_CALLOC (1, sizeof (stripe_local_t),
+                           gf_stripe_mt_stripe_local_t);
+        if (!local) {
+                op_errno = ENOMEM;
+                goto err;
+        }
+        local->op_ret = -1;
+        frame->local = local;
+        local->call_count = priv->child_count;
+
+        /* Everytime in stripe lookup, all child
+           nodes should be looked up */
+        while (trav) {
+                STACK_WIND (frame, stripe_link_cbk,
+                            trav->xlator, trav->xlator->fops->link,
+                            oldloc, newloc);
+                trav = trav->next;
+        }
+
+        return 0;
+err:
+        STRIPE_STACK_UNWIND (link, frame, -1, op_errno, NULL, NULL, NULL, NULL);
+        return 0;
+}
+
+int32_t
+stripe_create_fail_unlink_cbk (call_frame_t *frame, void *cookie,
+                               xlator_t *this, int32_t op_ret,
+                               int32_t op_errno, struct iatt *preparent,
+                               struct iatt *postparent)
+{
+        int32_t         callcnt = 0;
+        fd_t           *lfd = NULL;
+        stripe_local_t *local = NULL;
+        inode_t        *local_inode = NULL;
+
+        if (!this || !frame || !frame->local) {
+                gf_log ("stripe", GF_LOG_DEBUG, "possible NULL deref");
+                goto out;
+        }
+
+        local = frame->local;
+
+        LOCK (&frame->lock);
+        {
+                callcnt = --local->call_count;
         }
-unlock:
         UNLOCK (&frame->lock);
 
         if (!callcnt) {
-                /* TODO: if self-heal flag is set, do it */
-                if (local->xattr_self_heal_needed) {
+                local_inode = local->inode;
+                lfd = local->fd;
+
+                STRIPE_STACK_UNWIND (create, frame, local->op_ret, local->op_errno,
+                                     local->fd, local->inode, &local->stbuf,
+                                     &local->preparent, &local->postparent);
+
+                if (local_inode)
+                        inode_unref (local_inode);
+                if (lfd)
+                        fd_unref (lfd);
+        }
+out:
+        return 0;
+}
+
+
+int32_t
+stripe_create_setxattr_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                            int32_t op_ret, int32_t op_errno)
+{
+        inode_t          *local_inode = NULL;
+        fd_t             *lfd = NULL;
+        stripe_local_t   *local = NULL;
+        stripe_private_t *priv = NULL;
+        xlator_list_t    *trav = NULL;
+        int32_t           callcnt = 0;
+        call_frame_t   *prev = NULL;
+
+        if (!this || !frame || !frame->local || !cookie) {
+                gf_log ("stripe", GF_LOG_DEBUG, "possible NULL deref");
+                goto out;
+        }
+
+        prev  = cookie;
+	priv  = this->private;
+        local = frame->local;
+
+        LOCK (&frame->lock);
+        {
+                callcnt = --local->call_count;
+
+                if (op_ret == -1) {
+                        gf_log (this->name, GF_LOG_DEBUG,
+                                "%s returned error %s",
+                                prev->this->name, strerror (op_errno));
+                        local->op_ret = -1;
+                        local->op_errno = op_errno;
+                }
+        }
+        UNLOCK (&frame->lock);
+
+        if (!callcnt) {
+                if (local->op_ret == -1) {
+                        local->call_count = priv->child_count;
+                        trav = this->children;
+                        while (trav) {
+                                STACK_WIND (frame,
+                                            stripe_create_fail_unlink_cbk,
+                                            trav->xlator,
+                                            trav->xlator->fops->unlink,
+                                            &local->loc);
+                                trav = trav->next;
+                        }
+
+                        return 0;
+                }
+
+                lfd = local->fd;
+                local_inode = local->inode;
+
+                STRIPE_STACK_UNWIND (create, frame, local->op_ret, local->op_errno,
+                                     local->fd, local->inode, &local->stbuf,
+                                     &local->preparent, &local->postparent);
+
+                if (local_inode)
+                        inode_unref (local_inode);
+                if (lfd)
+                        fd_unref (lfd);
+        }
+out:
+        return 0;
+}
+
+int32_t
+stripe_create_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                   int32_t op_ret, int32_t op_errno, fd_t *fd,
+                   inode_t *inode, struct iatt *buf, struct iatt *preparent,
+                   struct iatt *postparent)
+{
+        int32_t           callcnt = 0;
+        stripe_local_t   *local = NULL;
+        stripe_private_t *priv = NULL;
+        fd_t             *lfd = NULL;
+        stripe_fd_ctx_t  *fctx = NULL;
+        inode_t          *local_inode = NULL;
+        call_frame_t     *prev = NULL;
+        int               ret = 0;
+
+        if (!this || !frame || !frame->local || !cookie) {
+                gf_log ("stripe", GF_LOG_DEBUG, "possible NULL deref");
+                goto out;
+        }
+
+        prev  = cookie;
+        priv  = this->private;
+        local = frame->local;
+
+        LOCK (&frame->lock);
+        {
+                callcnt = --local->call_count;
+
+                if (op_ret == -1) {
+                        gf_log (this->name, GF_LOG_DEBUG,
+                                "%s returned error %s",
+                                prev->this->name, strerror (op_errno));
+                        if ((op_errno != ENOENT) ||
+                            (prev->this == FIRST_CHILD (this)))
+                                local->failed = 1;
+                        local->op_errno = op_errno;
+                }
+
+                if (op_ret >= 0) {
+                        local->op_ret = op_ret;
+                        /* Get the mapping in inode private */
+                        /* Get the stat buf right */
+                        if (FIRST_CHILD(this) == prev->this) {
+                                local->stbuf      = *buf;
+                                local->preparent  = *preparent;
+                                local->postparent = *postparent;
+                        }
+
+                        local->stbuf_blocks += buf->ia_blocks;
+                        local->preparent_blocks  += preparent->ia_blocks;
+                        local->postparent_blocks += postparent->ia_blocks;
+
+                        if (local->stbuf_size < buf->ia_size)
+                                local->stbuf_size = buf->ia_size;
+                        if (local->preparent_size < preparent->ia_size)
+                                local->preparent_size = preparent->ia_size;
+                        if (local->postparent_size < postparent->ia_size)
+                                local->postparent_size = postparent->ia_size;
+                }
+        }
+        UNLOCK (&frame->lock);
+
+        if (!callcnt) {
+                if (local->failed)
+                        local->op_ret = -1;
+
+                if (local->op_ret != -1) {
+                        local->preparent.ia_blocks  = local->preparent_blocks;
+                        local->preparent.ia_size    = local->preparent_size;
+                        local->postparent.ia_blocks = local->postparent_blocks;
+                        local->postparent.ia_size   = local->postparent_size;
+                        local->stbuf.ia_size        = local->stbuf_size;
+                        local->stbuf.ia_blocks      = local->stbuf_blocks;
+                }
+
+                /* */
+                if (local->op_ret >= 0) {
+                        fctx = GF_CALLOC (1, sizeof (stripe_fd_ctx_t),
+                                          gf_stripe_mt_stripe_fd_ctx_t);
+                        if (!fctx) {
+                                local->op_ret = -1;
+                                local->op_errno = ENOMEM;
+                                goto unwind;
+                        }
+
+                        fctx->stripe_size  = local->stripe_size;
+                        fctx->stripe_count = priv->child_count;
+                        fctx->static_array = 1;
+                        fctx->xl_array = priv->xl_array;
+                        if (local->stripe_size && priv->xattr_supported) {
+                                fctx->redundancy = priv->redundancy;
+                                fctx->coalesce   = priv->coalesce;
+                        }
+                        fctx->data_count = (fctx->stripe_count -
+                                            fctx->redundancy);
+                        if (fctx->coalesce)
+                                stripe_inode_set_coalesced (this,
+                                                            local->inode,
+                                                            fctx->stripe_size,
+                                                            fctx->data_count);
+                        stripe_fd_io_new (this, fctx);
+                        fd_ctx_set (local->fd, this,
+                                    (uint64_t)(long)fctx);
+                }
+
+                if ((local->op_ret != -1) &&
+                    local->stripe_size && priv->xattr_supported) {
+                        /* Send a setxattr request to nodes where
+                           the files are created */
+                        int32_t        i = 0;
+                        char           size_key[256] = {0,};
+                        char           index_key[256] = {0,};
+                        char           count_key[256] = {0,};
+                        char           redundancy_key[256] = {0,};
+                        char           coalesce_key[256] = {0,};
+                        dict_t        *dict = NULL;
+
+                        sprintf (size_key,
+                                 "trusted.%s.stripe-size", this->name);
+                        sprintf (count_key,
+                                 "trusted.%s.stripe-count", this->name);
+                        sprintf (index_key,
+                                 "trusted.%s.stripe-index", this->name);
+                        sprintf (redundancy_key,
+                                 "trusted.%s.stripe-redundancy", this->name);
+                        sprintf (coalesce_key,
+                                 "trusted.%s.stripe-coalesce", this->name);
+
+                        local->call_count = priv->child_count;
+                        memcpy (local->loc.inode->gfid, local->stbuf.ia_gfid, 16);
+                        for (i = 0; i < priv->child_count; i++) {
+                                dict = get_new_dict ();
+                                if (!dict) {
+                                        gf_log (this->name, GF_LOG_ERROR,
+                                                "error allocating dict");
+                                }
+                                dict_ref (dict);
+
+                                /* TODO: check return values */
+                                ret = dict_set_int64 (dict, size_key,
+                                                      local->stripe_size);
+                                if (ret)
+                                        gf_log (this->name, GF_LOG_ERROR,
+                                                "%s: set stripe-size failed",
+                                                local->loc.path);
+
+                                ret = dict_set_int32 (dict, count_key,
+                                                      priv->child_count);
+                                if (ret)
+                                        gf_log (this->name, GF_LOG_ERROR,
+                                                "%s: set stripe-size failed",
+                                                local->loc.path);
+
+                                ret = dict_set_int32 (dict, index_key, i);
+                                if (ret)
+                                        gf_log (this->name, GF_LOG_ERROR,
+                                                "%s: set stripe-size failed",
+                                                local->loc.path);
+
+                                if (fctx && fctx->redundancy) {
+                                        ret = dict_set_int32 (dict,
+                                                              redundancy_key,
+                                                              fctx->redundancy);
+                                        if (ret)
+                                                gf_log (this->name,
+                                                        GF_LOG_ERROR,
+                                                        "%s: set stripe-"
+                                                        "redundancy failed",
+                                                        local->loc.path);
+                                }
+
+                                if (fctx && fctx->coalesce) {
+                                        ret = dict_set_int32 (dict,
+                                                              coalesce_key, 1);
+                                        if (ret)
+                                                gf_log (this->name,
+                                                        GF_LOG_ERROR,
+                                                        "%s: set stripe-"
+                                                        "coalesce failed",
+                                                        local->loc.path);
+                                }
+
+                                STACK_WIND (frame, stripe_create_setxattr_cbk,
+                                            priv->xl_array[i],
+                                            priv->xl_array[i]->fops->setxattr,
+                                            &local->loc, dict, 0);
+
+                                dict_unref (dict);
+                        }
+                        return 0;
+                }
+
+unwind:
+                /* Create itself has failed.. so return
+                   without setxattring */
+                lfd = local->fd;
+                local_inode = local->inode;
+
+                STRIPE_STACK_UNWIND (create, frame, local->op_ret,
+                                     local->op_errno, local->fd,
+                                     local->inode, &local->stbuf,
+                                     &local->preparent, &local->postparent);
+
+                if (local_inode)
+                        inode_unref (local_inode);
+                if (lfd)
+                        fd_unref (lfd);
+        }
+
+out:
+        return 0;
+}
+
+
+/**
+ * stripe_create - If a block-size is specified for the 'name', create the
+ *    file in all the child nodes. If not, create it in only first child.
+ *
+ * @name- complete path of the file to be created.
+ */
+int32_t
+stripe_create (call_frame_t *frame, xlator_t *this, loc_t *loc,
+               int32_t flags, mode_t mode, fd_t *fd, dict_t *params)
+{
+        stripe_private_t *priv = NULL;
+        stripe_local_t   *local = NULL;
+        xlator_list_t    *trav = NULL;
+        int32_t           op_errno = EINVAL;
+
+        VALIDATE_OR_GOTO (frame, err);
+        VALIDATE_OR_GOTO (this, err);
+        VALIDATE_OR_GOTO (loc, err);
+        VALIDATE_OR_GOTO (loc->path, err);
+        VALIDATE_OR_GOTO (loc->inode, err);
+
+        priv = this->private;
+
+        /* files created in O_APPEND mode does not allow lseek() on fd */
+        flags &= ~O_APPEND;
+
+        if (priv->first_child_down || priv->nodes_down) {
+                gf_log (this->name, GF_LOG_DEBUG,
+                        "First node down, returning EIO");
+                op_errno = EIO;
+                goto err;
+        }
+
+        /* Initialization */
+        local = GF_CALLOC (1, sizeof (stripe_local_t),
+                           gf_stripe_mt_stripe_local_t);
+        if (!local) {
+                op_errno = ENOMEM;
+                goto err;
+        }
+        local->op_ret = -1;
+        local->op_errno = ENOTCONN;
+        local->stripe_size = stripe_get_matching_bs (loc->path,
+                                                     priv->pattern,
+                                                     priv->block_size);
+        frame->local = local;
+        local->inode = inode_ref (loc->inode);
+        loc_copy (&local->loc, loc);
+        local->fd = fd_ref (fd);
+
+        local->call_count = priv->child_count;
+
+        trav = this->children;
+        while (trav) {
+                STACK_WIND (frame, stripe_create_cbk, trav->xlator,
+                            trav->xlator->fops->create, loc, flags,
+                            mode, fd, params);
+                trav = trav->next;
+        }
+
+        return 0;
+err:
+        STRIPE_STACK_UNWIND (create, frame, -1, op_errno, NULL, NULL, NULL,
+                             NULL, NULL);
+        return 0;
+}
+
+int32_t
+stripe_open_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                 int32_t op_ret, int32_t op_errno, fd_t *fd)
+{
+        int32_t         callcnt = 0;
+        stripe_local_t *local = NULL;
+        fd_t           *lfd = NULL;
+        call_frame_t   *prev = NULL;
+
+        if (!this || !frame || !frame->local || !cookie) {
+                gf_log ("stripe", GF_LOG_DEBUG, "possible NULL deref");
+                goto out;
+        }
+
+        prev  = cookie;
+        local = frame->local;
+
+        LOCK (&frame->lock);
+        {
+                callcnt = --local->call_count;
+
+                if (op_ret == -1) {
+
+                        gf_log (this->name, GF_LOG_DEBUG,
+                                "%s returned error %s",
+                                prev->this->name, strerror (op_errno));
+                        if ((op_errno == ENOTCONN) && local->fctx &&
+                            local->fctx->redundancy &&
+                            (prev->this != FIRST_CHILD (this))) {
+                                /* reads of it are served from parity */
+                                local->count++;
+                                goto unlock;
+                        }
+                        if ((op_errno != ENOENT) ||
+                            (prev->this == FIRST_CHILD (this)))
+                                local->failed = 1;
+                        local->op_errno = op_errno;
+                }
+
+                if (op_ret >= 0)
+                        local->op_ret = op_ret;
+        }
+unlock:
+        UNLOCK (&frame->lock);
+
+        if (!callcnt) {
+                if (local->fctx && (local->count > local->fctx->redundancy)) {
+                        local->op_errno = ENOTCONN;
+                        local->failed = 1;
+                }
+                if (local->failed)
+                        local->op_ret = -1;
+
+                if (local->op_ret == -1) {
+                        if (local->fctx) {
+                                if (!local->fctx->static_array)
+                                        GF_FREE (local->fctx->xl_array);
+                                GF_FREE (local->fctx);
+                        }
+                } else {
+                        stripe_fd_io_new (this, local->fctx);
+                        fd_ctx_set (local->fd, this,
+                                    (uint64_t)(long)local->fctx);
+                }
+
+                lfd = local->fd;
+
+                STRIPE_STACK_UNWIND (open, frame, local->op_ret,
+                                     local->op_errno, local->fd);
+                if (lfd)
+                        fd_unref (lfd);
+
+        }
+out:
+        return 0;
+}
+
+
+int32_t
+stripe_open_getxattr_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                          int32_t op_ret, int32_t op_errno, dict_t *dict)
+{
+        int32_t           index = 0;
+        int32_t           callcnt = 0;
+        char              key[256] = {0,};
+        stripe_local_t   *local = NULL;
+        xlator_list_t    *trav = NULL;
+        stripe_private_t *priv = NULL;
+        data_t           *data = NULL;
+        call_frame_t     *prev = NULL;
+        fd_t             *lfd = NULL;
+
+        if (!this || !frame || !frame->local || !cookie) {
+                gf_log ("stripe", GF_LOG_DEBUG, "possible NULL deref");
+                goto out;
+        }
+
+        prev  = (call_frame_t *)cookie;
+        priv  = this->private;
+        local = frame->local;
+
+        LOCK (&frame->lock);
+        {
+                callcnt = --local->call_count;
+
+                if (op_ret == -1) {
+                        gf_log (this->name, GF_LOG_DEBUG,
+                                "%s returned error %s",
+                                prev->this->name, strerror (op_errno));
+                        if ((op_errno == ENOTCONN) &&
+                            (prev->this != FIRST_CHILD (this))) {
+                                /* fine as long as the file has parity
+                                   for it, checked below */
+                                local->count++;
+                                goto unlock;
+                        }
+                        local->op_ret = -1;
+                        if (local->op_errno != EIO)
+                                local->op_errno = op_errno;
+                        if ((op_errno != ENOENT) ||
+                            (prev->this == FIRST_CHILD (this)))
+                                local->failed = 1;
+                        goto unlock;
+                }
+
+                if (!dict)
+                        goto unlock;
+
+                if (!local->fctx) {
+                        local->fctx =  GF_CALLOC (1, sizeof (stripe_fd_ctx_t),
+                                                  gf_stripe_mt_stripe_fd_ctx_t);
+                        if (!local->fctx) {
+                                local->op_errno = ENOMEM;
+                                local->op_ret = -1;
+                                goto unlock;
+                        }
+
+                        local->fctx->static_array = 0;
+                }
+                /* Stripe block size */
+                sprintf (key, "trusted.%s.stripe-size", this->name);
+                data = dict_get (dict, key);
+                if (!data) {
+                        local->xattr_self_heal_needed = 1;
+                } else {
+                        if (!local->fctx->stripe_size) {
+                                local->fctx->stripe_size =
+                                        data_to_int64 (data);
+                        }
+
+                        if (local->fctx->stripe_size != data_to_int64 (data)) {
+                                gf_log (this->name, GF_LOG_WARNING,
+                                        "stripe-size mismatch in blocks");
+                                local->xattr_self_heal_needed = 1;
+                        }
+                }
+                /* Stripe count */
+                sprintf (key, "trusted.%s.stripe-count", this->name);
+                data = dict_get (dict, key);
+                if (!data) {
+                        local->xattr_self_heal_needed = 1;
+                        goto unlock;
+                }
+                if (!local->fctx->xl_array) {
+                        local->fctx->stripe_count = data_to_int32 (data);
+                        if (!local->fctx->stripe_count) {
+                                gf_log (this->name, GF_LOG_ERROR,
+                                        "error with stripe-count xattr");
+                                local->op_ret   = -1;
+                                local->op_errno = EIO;
+                                goto unlock;
+                        }
+
+                        local->fctx->xl_array =
+                                GF_CALLOC (local->fctx->stripe_count,
+                                           sizeof (xlator_t *),
+                                           gf_stripe_mt_xlator_t);
+                        if (!local->fctx->xl_array) {
+                                local->op_errno = ENOMEM;
+                                local->op_ret   = -1;
+                                goto unlock;
+                        }
+                }
+                if (local->fctx->stripe_count != data_to_int32 (data)) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "error with stripe-count xattr (%d != %d)",
+                                local->fctx->stripe_count, data_to_int32 (data));
+                        local->op_ret   = -1;
+                        local->op_errno = EIO;
+                        goto unlock;
+                }
+
+                /* parity fragments */
+                sprintf (key, "trusted.%s.stripe-redundancy", this->name);
+                data = dict_get (dict, key);
+                if (data)
+                        local->fctx->redundancy = data_to_int32 (data);
+
+                /* blocks packed on the children */
+                sprintf (key, "trusted.%s.stripe-coalesce", this->name);
+                data = dict_get (dict, key);
+                if (data)
+                        local->fctx->coalesce = data_to_int32 (data);
+
+                /* index */
+                sprintf (key, "trusted.%s.stripe-index", this->name);
+                data = dict_get (dict, key);
+                if (!data) {
+                        local->xattr_self_heal_needed = 1;
+                        goto unlock;
+                }
+                index = data_to_int32 (data);
+                if (index > priv->child_count) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "error with stripe-index xattr (%d)", index);
+                        local->op_ret   = -1;
+                        local->op_errno = EIO;
+                        goto unlock;
+                }
+                if (local->fctx->xl_array) {
+                        if (local->fctx->xl_array[index]) {
+                                gf_log (this->name, GF_LOG_ERROR,
+                                        "duplicate entry @ index (%d)", index);
+                                local->op_ret   = -1;
+                                local->op_errno = EIO;
+                                goto unlock;
+                        }
+                        local->fctx->xl_array[index] = prev->this;
+                }
+                local->entry_count++;
+                local->op_ret = 0;
+        }
+unlock:
+        UNLOCK (&frame->lock);
+
+        if (!callcnt) {
+                /* TODO: if self-heal flag is set, do it */
+                if (local->xattr_self_heal_needed) {
+                        gf_log (this->name, GF_LOG_DEBUG,
+                                "%s: stripe info need to be healed",
+                                local->loc.path);
+                }
+
+                if (local->failed)
+                        local->op_ret = -1;
+
+                if (local->op_ret)
+                        goto err;
+
+                if ((local->fctx->redundancy < 0) ||
+                    (local->fctx->redundancy >= local->fctx->stripe_count) ||
+                    (local->count > local->fctx->redundancy)) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "%s: %d subvolumes down, file has %d parity "
+                                "fragments", local->loc.path, local->count,
+                                local->fctx->redundancy);
+                        local->op_ret = -1;
+                        local->op_errno = (local->count ? ENOTCONN : EIO);
+                        goto err;
+                }
+                local->fctx->data_count = (local->fctx->stripe_count -
+                                           local->fctx->redundancy);
+                if (local->fctx->coalesce)
+                        stripe_inode_set_coalesced (this, local->fd->inode,
+                                                    local->fctx->stripe_size,
+                                                    local->fctx->data_count);
+
+                if ((local->entry_count + local->count) !=
+                    local->fctx->stripe_count) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "entry-count (%d) != stripe-count (%d)",
+                                local->entry_count, local->fctx->stripe_count);
+                        local->op_ret = -1;
+                        local->op_errno = EIO;
+                        goto err;
+                }
+                if (!local->fctx->stripe_size) {
+                        gf_log (this->name, GF_LOG_ERROR, "stripe size not set");
+                        local->op_ret = -1;
+                        local->op_errno = EIO;
+                        goto err;
+                }
+
+                local->call_count = local->fctx->stripe_count;
+                local->count = 0;
+
+                trav = this->children;
+                while (trav) {
+                        STACK_WIND (frame, stripe_open_cbk, trav->xlator,
+                                    trav->xlator->fops->open, &local->loc,
+                                    local->flags, local->fd, 0);
+                        trav = trav->next;
+                }
+        }
+
+        return 0;
+err:
+        lfd = local->fd;
+
+        STRIPE_STACK_UNWIND (open, frame, local->op_ret, local->op_errno,
+                             local->fd);
+        if (lfd)
+                fd_unref (lfd);
+out:
+        return 0;
+}
+
+/**
+ * stripe_open -
+ */
+int32_t
+stripe_open (call_frame_t *frame, xlator_t *this, loc_t *loc,
+             int32_t flags, fd_t *fd, int32_t wbflags)
+{
+        stripe_local_t   *local = NULL;
+        stripe_private_t *priv = NULL;
+        xlator_list_t    *trav = NULL;
+        int32_t           op_errno = 1;
+
+        VALIDATE_OR_GOTO (frame, err);
+        VALIDATE_OR_GOTO (this, err);
+        VALIDATE_OR_GOTO (loc, err);
+        VALIDATE_OR_GOTO (loc->path, err);
+        VALIDATE_OR_GOTO (loc->inode, err);
+
+        priv = this->private;
+        trav = this->children;
+
+        if (priv->first_child_down) {
+                op_errno = ENOTCONN;
+                goto err;
+        }
+
+        /* Initialization */
+        local = GF_CALLOC (1, sizeof (stripe_local_t),
+                           gf_stripe_mt_stripe_local_t);
+        if (!local) {
+                op_errno = ENOMEM;
+                goto err;
+        }
+
+        /* files opened in O_APPEND mode does not allow lseek() on fd */
+        flags &= ~O_APPEND;
+
+        local->fd = fd_ref (fd);
+        frame->local = local;
+        loc_copy (&local->loc, loc);
+
+        /* Striped files */
+        local->flags = flags;
+        local->call_count = priv->child_count;
+        local->stripe_size = stripe_get_matching_bs (loc->path,
+                                                     priv->pattern,
+                                                     priv->block_size);
+
+        if (priv->xattr_supported) {
+                while (trav) {
+                        STACK_WIND (frame, stripe_open_getxattr_cbk,
+                                    trav->xlator, trav->xlator->fops->getxattr,
+                                    loc, NULL);
+                        trav = trav->next;
+                }
+                return 0;
+        }
+        local->fctx =  GF_CALLOC (1, sizeof (stripe_fd_ctx_t),
+                                  gf_stripe_mt_stripe_fd_ctx_t);
+        if (!local->fctx) {
+                op_errno = ENOMEM;
+                goto err;
+        }
+
+        local->fctx->static_array = 1;
+        local->fctx->stripe_size  = local->stripe_size;
+        local->fctx->stripe_count = priv->child_count;
+        local->fctx->data_count   = priv->child_count;
+        local->fctx->xl_array     = priv->xl_array;
+
+        while (trav) {
+                STACK_WIND (frame, stripe_open_cbk, trav->xlator,
+                            trav->xlator->fops->open,
+                            &local->loc, local->flags, local->fd,
+                            wbflags);
+                trav = trav->next;
+        }
+        return 0;
+err:
+        STRIPE_STACK_UNWIND (open, frame, -1, op_errno, NULL);
+        return 0;
+}
+
+
+int32_t
+stripe_opendir_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                    int32_t op_ret, int32_t op_errno, fd_t *fd)
+{
+        int32_t         callcnt = 0;
+        stripe_local_t *local = NULL;
+        fd_t           *local_fd = NULL;
+        call_frame_t   *prev = NULL;
+
+        if (!this || !frame || !frame->local || !cookie) {
+                gf_log ("stripe", GF_LOG_DEBUG, "possible NULL deref");
+                goto out;
+        }
+
+        prev  = cookie;
+        local = frame->local;
+
+        LOCK (&frame->lock);
+        {
+                callcnt = --local->call_count;
+
+                if (op_ret == -1) {
                         gf_log (this->name, GF_LOG_DEBUG,
-                                "%s: stripe info need to be healed",
-                                local->loc.path);
+                                "%s returned error %s",
+                                prev->this->name, strerror (op_errno));
+                        local->op_ret = -1;
+                        local->op_errno = op_errno;
+                }
+
+                if (op_ret >= 0)
+                        local->op_ret = op_ret;
+        }
+        UNLOCK (&frame->lock);
+
+        if (!callcnt) {
+                local_fd = local->fd;
+                STRIPE_STACK_UNWIND (opendir, frame, local->op_ret,
+                                     local->op_errno, local->fd);
+                if (local_fd)
+                        fd_unref (local_fd);
+        }
+out:
+        return 0;
+}
+
+
+int32_t
+stripe_opendir (call_frame_t *frame, xlator_t *this, loc_t *loc, fd_t *fd)
+{
+        xlator_list_t    *trav = NULL;
+        stripe_local_t   *local = NULL;
+        stripe_private_t *priv = NULL;
+        int32_t           op_errno = EINVAL;
+
+        VALIDATE_OR_GOTO (frame, err);
+        VALIDATE_OR_GOTO (this, err);
+        VALIDATE_OR_GOTO (loc, err);
+        VALIDATE_OR_GOTO (loc->path, err);
+        VALIDATE_OR_GOTO (loc->inode, err);
+
+        priv = this->private;
+        trav = this->children;
+
+        if (priv->first_child_down) {
+                op_errno = ENOTCONN;
+                goto err;
+        }
+
+        /* Initialization */
+        local = GF_CALLOC (1, sizeof (stripe_local_t),
+                           gf_stripe_mt_stripe_local_t);
+        if (!local) {
+                op_errno = ENOMEM;
+                goto err;
+        }
+        frame->local = local;
+        local->call_count = priv->child_count;
+        local->fd = fd_ref (fd);
+
+        while (trav) {
+                STACK_WIND (frame, stripe_opendir_cbk, trav->xlator,
+                            trav->xlator->fops->opendir, loc, fd);
+                trav = trav->next;
+        }
+
+        return 0;
+err:
+        STRIPE_STACK_UNWIND (opendir, frame, -1, op_errno, NULL);
+        return 0;
+}
+
+int32_t
+stripe_lk_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+               int32_t op_ret, int32_t op_errno, struct gf_flock *lock)
+{
+        int32_t         callcnt = 0;
+        stripe_local_t *local = NULL;
+        call_frame_t   *prev = NULL;
+
+        if (!this || !frame || !frame->local || !cookie) {
+                gf_log ("stripe", GF_LOG_DEBUG, "possible NULL deref");
+                goto out;
+        }
+
+        prev  = cookie;
+        local = frame->local;
+
+        LOCK (&frame->lock);
+        {
+                callcnt = --local->call_count;
+                if (op_ret == -1) {
+                        gf_log (this->name, GF_LOG_DEBUG,
+                                "%s returned error %s",
+                                prev->this->name, strerror (op_errno));
+                        local->op_errno = op_errno;
+                        if ((op_errno != ENOENT) ||
+                            (prev->this == FIRST_CHILD (this)))
+                                local->failed = 1;
+                }
+                if (op_ret >= 0) {
+                        if (FIRST_CHILD(this) == prev->this) {
+                                /* First successful call, copy the *lock */
+                                local->op_ret = op_ret;
+                                local->lock = *lock;
+                        }
                 }
+        }
+        UNLOCK (&frame->lock);
 
+        if (!callcnt) {
                 if (local->failed)
                         local->op_ret = -1;
+                STRIPE_STACK_UNWIND (lk, frame, local->op_ret,
+                                     local->op_errno, &local->lock);
+        }
+out:
+        return 0;
+}
 
-                if (local->op_ret)
-                        goto err;
+int32_t
+stripe_lk (call_frame_t *frame, xlator_t *this, fd_t *fd, int32_t cmd,
+           struct gf_flock *lock)
+{
+        stripe_local_t   *local = NULL;
+        xlator_list_t    *trav = NULL;
+        stripe_private_t *priv = NULL;
+        int32_t           op_errno = EINVAL;
 
-                if (local->entry_count != local->fctx->stripe_count) {
-                        gf_log (this->name, GF_LOG_ERROR,
-                                "entry-count (%d) != stripe-count (%d)",
-                                local->entry_count, local->fctx->stripe_count);
-                        local->op_ret = -1;
-                        local->op_errno = EIO;
-                        goto err;
-                }
-                if (!local->fctx->stripe_size) {
-                        gf_log (this->name, GF_LOG_ERROR, "stripe size not set");
-                        local->op_ret = -1;
-                        local->op_errno = EIO;
-                        goto err;
-                }
+        VALIDATE_OR_GOTO (frame, err);
+        VALIDATE_OR_GOTO (this, err);
+        VALIDATE_OR_GOTO (fd, err);
+        VALIDATE_OR_GOTO (fd->inode, err);
 
-                local->call_count = local->fctx->stripe_count;
+        trav = this->children;
+        priv = this->private;
 
-                trav = this->children;
-                while (trav) {
-                        STACK_WIND (frame, stripe_open_cbk, trav->xlator,
-                                    trav->xlator->fops->open, &local->loc,
-                                    local->flags, local->fd, 0);
-                        trav = trav->next;
-                }
+        /* Initialization */
+        local = GF_CALLOC (1, sizeof (stripe_local_t),
+                           gf_stripe_mt_stripe_local_t);
+        if (!local) {
+                op_errno = ENOMEM;
+                goto err;
+        }
+        local->op_ret = -1;
+        frame->local = local;
+        local->call_count = priv->child_count;
+
+        while (trav) {
+                STACK_WIND (frame, stripe_lk_cbk, trav->xlator,
+                            trav->xlator->fops->lk, fd, cmd, lock);
+                trav = trav->next;
         }
 
         return 0;
 err:
-        lfd = local->fd;
+        STRIPE_STACK_UNWIND (lk, frame, -1, op_errno, NULL);
+        return 0;
+}
 
-        STRIPE_STACK_UNWIND (open, frame, local->op_ret, local->op_errno,
-                             local->fd);
-        if (lfd)
-                fd_unref (lfd);
+
+int32_t
+stripe_flush_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                  int32_t op_ret, int32_t op_errno)
+{
+        int32_t         callcnt = 0;
+        stripe_local_t *local   = NULL;
+        call_frame_t   *prev = NULL;
+
+        if (!this || !frame || !frame->local || !cookie) {
+                gf_log ("stripe", GF_LOG_DEBUG, "possible NULL deref");
+                goto out;
+        }
+
+        prev  = cookie;
+        local = frame->local;
+
+        LOCK (&frame->lock);
+        {
+                callcnt = --local->call_count;
+
+                if (op_ret == -1) {
+                        gf_log (this->name, GF_LOG_DEBUG,
+                                "%s returned %s",
+                                prev->this->name, strerror (op_errno));
+                        local->op_errno = op_errno;
+                        if ((op_errno != ENOENT) ||
+                            (prev->this == FIRST_CHILD (this)))
+                                local->failed = 1;
+                }
+                if (op_ret >= 0)
+                        local->op_ret = op_ret;
+        }
+        UNLOCK (&frame->lock);
+
+        if (!callcnt) {
+                if (local->failed)
+                        local->op_ret = -1;
+
+                STRIPE_STACK_UNWIND (flush, frame, local->op_ret,
+                                     local->op_errno);
+        }
 out:
         return 0;
 }
 
-/**
- * stripe_open -
- */
 int32_t
-stripe_open (call_frame_t *frame, xlator_t *this, loc_t *loc,
-             int32_t flags, fd_t *fd, int32_t wbflags)
+stripe_flush (call_frame_t *frame, xlator_t *this, fd_t *fd)
 {
+        call_stub_t      *stub = NULL;
+        fd_t             *wfd = NULL;
         stripe_local_t   *local = NULL;
         stripe_private_t *priv = NULL;
         xlator_list_t    *trav = NULL;
@@ -2391,9 +4131,21 @@ stripe_open (call_frame_t *frame, xlator_t *this, loc_t *loc,
 
         VALIDATE_OR_GOTO (frame, err);
         VALIDATE_OR_GOTO (this, err);
-        VALIDATE_OR_GOTO (loc, err);
-        VALIDATE_OR_GOTO (loc->path, err);
-        VALIDATE_OR_GOTO (loc->inode, err);
+        VALIDATE_OR_GOTO (fd, err);
+        VALIDATE_OR_GOTO (fd->inode, err);
+
+        wfd = stripe_wa_inode_fd (this, fd->inode, NULL);
+        if (wfd) {
+                stub = fop_flush_stub (frame, stripe_flush, fd);
+                if (stripe_wa_wait (frame, this, wfd, stub)) {
+                        op_errno = ENOMEM;
+                        goto err;
+                }
+                return 0;
+        }
+        op_errno = stripe_wa_error (this, fd);
+        if (op_errno)
+                goto err;
 
         priv = this->private;
         trav = this->children;
@@ -2402,7 +4154,6 @@ stripe_open (call_frame_t *frame, xlator_t *this, loc_t *loc,
                 op_errno = ENOTCONN;
                 goto err;
         }
-
         /* Initialization */
         local = GF_CALLOC (1, sizeof (stripe_local_t),
                            gf_stripe_mt_stripe_local_t);
@@ -2410,63 +4161,31 @@ stripe_open (call_frame_t *frame, xlator_t *this, loc_t *loc,
                 op_errno = ENOMEM;
                 goto err;
         }
-
-        /* files opened in O_APPEND mode does not allow lseek() on fd */
-        flags &= ~O_APPEND;
-
-        local->fd = fd_ref (fd);
+        local->op_ret = -1;
         frame->local = local;
-        loc_copy (&local->loc, loc);
-
-        /* Striped files */
-        local->flags = flags;
         local->call_count = priv->child_count;
-        local->stripe_size = stripe_get_matching_bs (loc->path,
-                                                     priv->pattern,
-                                                     priv->block_size);
-
-        if (priv->xattr_supported) {
-                while (trav) {
-                        STACK_WIND (frame, stripe_open_getxattr_cbk,
-                                    trav->xlator, trav->xlator->fops->getxattr,
-                                    loc, NULL);
-                        trav = trav->next;
-                }
-                return 0;
-        }
-        local->fctx =  GF_CALLOC (1, sizeof (stripe_fd_ctx_t),
-                                  gf_stripe_mt_stripe_fd_ctx_t);
-        if (!local->fctx) {
-                op_errno = ENOMEM;
-                goto err;
-        }
-
-        local->fctx->static_array = 1;
-        local->fctx->stripe_size  = local->stripe_size;
-        local->fctx->stripe_count = priv->child_count;
-        local->fctx->xl_array     = priv->xl_array;
 
         while (trav) {
-                STACK_WIND (frame, stripe_open_cbk, trav->xlator,
-                            trav->xlator->fops->open,
-                            &local->loc, local->flags, local->fd,
-                            wbflags);
+                STACK_WIND (frame, stripe_flush_cbk,  trav->xlator,
+                            trav->xlator->fops->flush, fd);
                 trav = trav->next;
         }
+
         return 0;
 err:
-        STRIPE_STACK_UNWIND (open, frame, -1, op_errno, NULL);
+        STRIPE_STACK_UNWIND (flush, frame, -1, op_errno);
         return 0;
 }
 
 
+
 int32_t
-stripe_opendir_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
-                    int32_t op_ret, int32_t op_errno, fd_t *fd)
+stripe_fsync_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                  int32_t op_ret, int32_t op_errno, struct iatt *prebuf,
+                  struct iatt *postbuf)
 {
         int32_t         callcnt = 0;
-        stripe_local_t *local = NULL;
-        fd_t           *local_fd = NULL;
+        stripe_local_t *local   = NULL;
         call_frame_t   *prev = NULL;
 
         if (!this || !frame || !frame->local || !cookie) {
@@ -2474,7 +4193,7 @@ stripe_opendir_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                 goto out;
         }
 
-        prev  = cookie;
+        prev = cookie;
         local = frame->local;
 
         LOCK (&frame->lock);
@@ -2483,51 +4202,81 @@ stripe_opendir_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 
                 if (op_ret == -1) {
                         gf_log (this->name, GF_LOG_DEBUG,
-                                "%s returned error %s",
+                                "%s returned %s",
                                 prev->this->name, strerror (op_errno));
-                        local->op_ret = -1;
                         local->op_errno = op_errno;
+                        if ((op_errno != ENOENT) ||
+                            (prev->this == FIRST_CHILD (this)))
+                                local->failed = 1;
                 }
-
-                if (op_ret >= 0)
+                if (op_ret >= 0) {
                         local->op_ret = op_ret;
+                        if (FIRST_CHILD(this) == prev->this) {
+                                local->pre_buf  = *prebuf;
+                                local->post_buf = *postbuf;
+                        }
+                        local->prebuf_blocks  += prebuf->ia_blocks;
+                        local->postbuf_blocks += postbuf->ia_blocks;
+
+                        if (local->prebuf_size < prebuf->ia_size)
+                                local->prebuf_size = prebuf->ia_size;
+
+                        if (local->postbuf_size < postbuf->ia_size)
+                                local->postbuf_size = postbuf->ia_size;
+                }
         }
         UNLOCK (&frame->lock);
 
         if (!callcnt) {
-                local_fd = local->fd;
-                STRIPE_STACK_UNWIND (opendir, frame, local->op_ret,
-                                     local->op_errno, local->fd);
-                if (local_fd)
-                        fd_unref (local_fd);
+                if (local->failed)
+                        local->op_ret = -1;
+
+                if (local->op_ret != -1) {
+                        local->pre_buf.ia_blocks  = local->prebuf_blocks;
+                        local->pre_buf.ia_size    = local->prebuf_size;
+                        local->post_buf.ia_blocks = local->postbuf_blocks;
+                        local->post_buf.ia_size   = local->postbuf_size;
+                }
+
+                STRIPE_STACK_UNWIND (fsync, frame, local->op_ret,
+                                     local->op_errno, &local->pre_buf,
+                                     &local->post_buf);
         }
 out:
         return 0;
 }
 
-
 int32_t
-stripe_opendir (call_frame_t *frame, xlator_t *this, loc_t *loc, fd_t *fd)
+stripe_fsync (call_frame_t *frame, xlator_t *this, fd_t *fd, int32_t flags)
 {
-        xlator_list_t    *trav = NULL;
+        call_stub_t      *stub = NULL;
+        fd_t             *wfd = NULL;
         stripe_local_t   *local = NULL;
         stripe_private_t *priv = NULL;
-        int32_t           op_errno = EINVAL;
+        xlator_list_t    *trav = NULL;
+        int32_t           op_errno = 1;
 
         VALIDATE_OR_GOTO (frame, err);
         VALIDATE_OR_GOTO (this, err);
-        VALIDATE_OR_GOTO (loc, err);
-        VALIDATE_OR_GOTO (loc->path, err);
-        VALIDATE_OR_GOTO (loc->inode, err);
+        VALIDATE_OR_GOTO (fd, err);
+        VALIDATE_OR_GOTO (fd->inode, err);
+
+        wfd = stripe_wa_inode_fd (this, fd->inode, NULL);
+        if (wfd) {
+                stub = fop_fsync_stub (frame, stripe_fsync, fd, flags);
+                if (stripe_wa_wait (frame, this, wfd, stub)) {
+                        op_errno = ENOMEM;
+                        goto err;
+                }
+                return 0;
+        }
+        op_errno = stripe_wa_error (this, fd);
+        if (op_errno)
+                goto err;
 
         priv = this->private;
         trav = this->children;
 
-        if (priv->first_child_down) {
-                op_errno = ENOTCONN;
-                goto err;
-        }
-
         /* Initialization */
         local = GF_CALLOC (1, sizeof (stripe_local_t),
                            gf_stripe_mt_stripe_local_t);
@@ -2535,29 +4284,30 @@ stripe_opendir (call_frame_t *frame, xlator_t *this, loc_t *loc, fd_t *fd)
                 op_errno = ENOMEM;
                 goto err;
         }
+        local->op_ret = -1;
         frame->local = local;
         local->call_count = priv->child_count;
-        local->fd = fd_ref (fd);
 
         while (trav) {
-                STACK_WIND (frame, stripe_opendir_cbk, trav->xlator,
-                            trav->xlator->fops->opendir, loc, fd);
+                STACK_WIND (frame, stripe_fsync_cbk, trav->xlator,
+                            trav->xlator->fops->fsync, fd, flags);
                 trav = trav->next;
         }
 
         return 0;
 err:
-        STRIPE_STACK_UNWIND (opendir, frame, -1, op_errno, NULL);
+        STRIPE_STACK_UNWIND (fsync, frame, -1, op_errno, NULL, NULL);
         return 0;
 }
 
 int32_t
-stripe_lk_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
-               int32_t op_ret, int32_t op_errno, struct gf_flock *lock)
+stripe_fstat_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                  int32_t op_ret, int32_t op_errno, struct iatt *buf)
 {
         int32_t         callcnt = 0;
         stripe_local_t *local = NULL;
         call_frame_t   *prev = NULL;
+        off_t           size = 0;
 
         if (!this || !frame || !frame->local || !cookie) {
                 gf_log ("stripe", GF_LOG_DEBUG, "possible NULL deref");
@@ -2570,6 +4320,7 @@ stripe_lk_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
         LOCK (&frame->lock);
         {
                 callcnt = --local->call_count;
+
                 if (op_ret == -1) {
                         gf_log (this->name, GF_LOG_DEBUG,
                                 "%s returned error %s",
@@ -2579,12 +4330,18 @@ stripe_lk_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                             (prev->this == FIRST_CHILD (this)))
                                 local->failed = 1;
                 }
-                if (op_ret >= 0) {
-                        if (FIRST_CHILD(this) == prev->this) {
-                                /* First successful call, copy the *lock */
-                                local->op_ret = op_ret;
-                                local->lock = *lock;
-                        }
+
+                if (op_ret == 0) {
+                        local->op_ret = 0;
+
+                        if (FIRST_CHILD(this) == prev->this)
+                                local->stbuf = *buf;
+
+                        local->stbuf_blocks += buf->ia_blocks;
+                        size = stripe_iatt_size (this, local->ictx,
+                                                 prev->this, buf);
+                        if (local->stbuf_size < size)
+                                local->stbuf_size = size;
                 }
         }
         UNLOCK (&frame->lock);
@@ -2592,29 +4349,110 @@ stripe_lk_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
         if (!callcnt) {
                 if (local->failed)
                         local->op_ret = -1;
-                STRIPE_STACK_UNWIND (lk, frame, local->op_ret,
-                                     local->op_errno, &local->lock);
+
+                if (local->op_ret != -1) {
+                        local->stbuf.ia_size   = local->stbuf_size;
+                        local->stbuf.ia_blocks = local->stbuf_blocks;
+                }
+
+                STRIPE_STACK_UNWIND (fstat, frame, local->op_ret,
+                                     local->op_errno, &local->stbuf);
         }
+
 out:
         return 0;
 }
 
 int32_t
-stripe_lk (call_frame_t *frame, xlator_t *this, fd_t *fd, int32_t cmd,
-           struct gf_flock *lock)
+stripe_fstat (call_frame_t *frame,
+              xlator_t *this,
+              fd_t *fd)
 {
+        call_stub_t      *stub = NULL;
+        fd_t             *wfd = NULL;
         stripe_local_t   *local = NULL;
-        xlator_list_t    *trav = NULL;
         stripe_private_t *priv = NULL;
-        int32_t           op_errno = EINVAL;
+        xlator_list_t    *trav = NULL;
+        int32_t           op_errno = 1;
 
         VALIDATE_OR_GOTO (frame, err);
         VALIDATE_OR_GOTO (this, err);
         VALIDATE_OR_GOTO (fd, err);
         VALIDATE_OR_GOTO (fd->inode, err);
 
+        wfd = stripe_wa_inode_fd (this, fd->inode, NULL);
+        if (wfd) {
+                stub = fop_fstat_stub (frame, stripe_fstat, fd);
+                if (stripe_wa_wait (frame, this, wfd, stub)) {
+                        op_errno = ENOMEM;
+                        goto err;
+                }
+                return 0;
+        }
+
+        priv = this->private;
         trav = this->children;
+
+        /* Initialization */
+        local = GF_CALLOC (1, sizeof (stripe_local_t),
+                           gf_stripe_mt_stripe_local_t);
+        if (!local) {
+                op_errno = ENOMEM;
+                goto err;
+        }
+        local->op_ret = -1;
+        frame->local = local;
+        local->ictx = stripe_inode_ctx_find (this, fd->inode);
+        local->call_count = priv->child_count;
+
+        while (trav) {
+                STACK_WIND (frame, stripe_fstat_cbk, trav->xlator,
+                            trav->xlator->fops->fstat, fd);
+                trav = trav->next;
+        }
+
+        return 0;
+err:
+        STRIPE_STACK_UNWIND (fstat, frame, -1, op_errno, NULL);
+        return 0;
+}
+
+
+int32_t
+stripe_ftruncate (call_frame_t *frame, xlator_t *this, fd_t *fd, off_t offset)
+{
+        call_stub_t      *stub = NULL;
+        fd_t             *wfd = NULL;
+        stripe_local_t   *local = NULL;
+        stripe_private_t *priv = NULL;
+        stripe_fd_ctx_t  *fctx = NULL;
+        xlator_list_t    *trav = NULL;
+        uint64_t          tmp_fctx = 0;
+        int32_t           op_errno = 1;
+        int               i = 0;
+
+        VALIDATE_OR_GOTO (frame, err);
+        VALIDATE_OR_GOTO (this, err);
+        VALIDATE_OR_GOTO (fd, err);
+        VALIDATE_OR_GOTO (fd->inode, err);
+
+        wfd = stripe_wa_inode_fd (this, fd->inode, NULL);
+        if (wfd) {
+                stub = fop_ftruncate_stub (frame, stripe_ftruncate, fd,
+                                           offset);
+                if (stripe_wa_wait (frame, this, wfd, stub)) {
+                        op_errno = ENOMEM;
+                        goto err;
+                }
+                return 0;
+        }
+        stripe_ra_drop (this, fd);
+
         priv = this->private;
+        trav = this->children;
+
+        fd_ctx_get (fd, this, &tmp_fctx);
+        fctx = (stripe_fd_ctx_t *)(long)tmp_fctx;
 
         /* Initialization */
         local = GF_CALLOC (1, sizeof (stripe_local_t),
@@ -2625,24 +4463,50 @@ stripe_lk (call_frame_t *frame, xlator_t *this, fd_t *fd, int32_t cmd,
         }
         local->op_ret = -1;
         frame->local = local;
+        local->ictx = stripe_inode_ctx_find (this, fd->inode);
         local->call_count = priv->child_count;
 
+        if (fctx && (fctx->redundancy || fctx->coalesce)) {
+                for (i = 0; i < fctx->stripe_count; i++) {
+                        if (!fctx->xl_array[i]) {
+                                op_errno = ENOTCONN;
+                                goto err;
+                        }
+                }
+
+                local->fctx       = fctx;
+                local->fd         = fd_ref (fd);
+                local->offset     = offset;
+                local->call_count = fctx->stripe_count;
+
+                for (i = 0; i < fctx->stripe_count; i++) {
+                        STACK_WIND (frame, stripe_truncate_cbk,
+                                    fctx->xl_array[i],
+                                    fctx->xl_array[i]->fops->ftruncate, fd,
+                                    stripe_child_truncate_size (
+                                            fctx->stripe_size,
+                                            fctx->data_count,
+                                            fctx->coalesce, i, offset));
+                }
+                return 0;
+        }
+
         while (trav) {
-                STACK_WIND (frame, stripe_lk_cbk, trav->xlator,
-                            trav->xlator->fops->lk, fd, cmd, lock);
+                STACK_WIND (frame, stripe_truncate_cbk, trav->xlator,
+                            trav->xlator->fops->ftruncate, fd, offset);
                 trav = trav->next;
         }
 
         return 0;
 err:
-        STRIPE_STACK_UNWIND (lk, frame, -1, op_errno, NULL);
+        STRIPE_STACK_UNWIND (ftruncate, frame, -1, op_errno, NULL, NULL);
         return 0;
 }
 
 
 int32_t
-stripe_flush_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
-                  int32_t op_ret, int32_t op_errno)
+stripe_fsyncdir_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                     int32_t op_ret, int32_t op_errno)
 {
         int32_t         callcnt = 0;
         stripe_local_t *local   = NULL;
@@ -2678,7 +4542,7 @@ stripe_flush_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                 if (local->failed)
                         local->op_ret = -1;
 
-                STRIPE_STACK_UNWIND (flush, frame, local->op_ret,
+                STRIPE_STACK_UNWIND (fsyncdir, frame, local->op_ret,
                                      local->op_errno);
         }
 out:
@@ -2686,7 +4550,7 @@ out:
 }
 
 int32_t
-stripe_flush (call_frame_t *frame, xlator_t *this, fd_t *fd)
+stripe_fsyncdir (call_frame_t *frame, xlator_t *this, fd_t *fd, int32_t flags)
 {
         stripe_local_t   *local = NULL;
         stripe_private_t *priv = NULL;
@@ -2701,10 +4565,6 @@ stripe_flush (call_frame_t *frame, xlator_t *this, fd_t *fd)
         priv = this->private;
         trav = this->children;
 
-        if (priv->first_child_down) {
-                op_errno = ENOTCONN;
-                goto err;
-        }
         /* Initialization */
         local = GF_CALLOC (1, sizeof (stripe_local_t),
                            gf_stripe_mt_stripe_local_t);
@@ -2717,274 +4577,408 @@ stripe_flush (call_frame_t *frame, xlator_t *this, fd_t *fd)
         local->call_count = priv->child_count;
 
         while (trav) {
-                STACK_WIND (frame, stripe_flush_cbk,  trav->xlator,
-                            trav->xlator->fops->flush, fd);
+                STACK_WIND (frame, stripe_fsyncdir_cbk, trav->xlator,
+                            trav->xlator->fops->fsyncdir, fd, flags);
                 trav = trav->next;
         }
 
         return 0;
 err:
-        STRIPE_STACK_UNWIND (flush, frame, -1, op_errno);
+        STRIPE_STACK_UNWIND (fsyncdir, frame, -1, op_errno);
         return 0;
 }
 
 
-
 int32_t
-stripe_fsync_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
-                  int32_t op_ret, int32_t op_errno, struct iatt *prebuf,
-                  struct iatt *postbuf)
+stripe_readv_fstat_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                        int32_t op_ret, int32_t op_errno, struct iatt *buf)
 {
+        int32_t         i = 0;
         int32_t         callcnt = 0;
-        stripe_local_t *local   = NULL;
+        int32_t         count = 0;
+        stripe_local_t *local = NULL;
+        struct iovec   *vec = NULL;
+        struct iatt     tmp_stbuf = {0,};
+        struct iobref  *tmp_iobref = NULL;
+        struct iobuf   *iobuf = NULL;
         call_frame_t   *prev = NULL;
+        off_t           size = 0;
 
-        if (!this || !frame || !frame->local || !cookie) {
+        if (!this || !frame || !frame->local) {
                 gf_log ("stripe", GF_LOG_DEBUG, "possible NULL deref");
                 goto out;
         }
 
-        prev = cookie;
+        prev  = cookie;
         local = frame->local;
 
         LOCK (&frame->lock);
         {
                 callcnt = --local->call_count;
-
-                if (op_ret == -1) {
-                        gf_log (this->name, GF_LOG_DEBUG,
-                                "%s returned %s",
-                                prev->this->name, strerror (op_errno));
-                        local->op_errno = op_errno;
-                        if ((op_errno != ENOENT) ||
-                            (prev->this == FIRST_CHILD (this)))
-                                local->failed = 1;
-                }
-                if (op_ret >= 0) {
-                        local->op_ret = op_ret;
-                        if (FIRST_CHILD(this) == prev->this) {
-                                local->pre_buf  = *prebuf;
-                                local->post_buf = *postbuf;
-                        }
-                        local->prebuf_blocks  += prebuf->ia_blocks;
-                        local->postbuf_blocks += postbuf->ia_blocks;
-
-                        if (local->prebuf_size < prebuf->ia_size)
-                                local->prebuf_size = prebuf->ia_size;
-
-                        if (local->postbuf_size < postbuf->ia_size)
-                                local->postbuf_size = postbuf->ia_size;
+                if (op_ret != -1) {
+                        size = stripe_file_size (local->fctx->stripe_size,
+                                                 local->fctx->data_count,
+                                                 local->fctx->coalesce,
+                                                 stripe_child_index (this,
+                                                         prev->this),
+                                                 buf->ia_size);
+                        if (local->stbuf_size < size)
+                                local->stbuf_size = size;
                 }
         }
         UNLOCK (&frame->lock);
 
         if (!callcnt) {
-                if (local->failed)
-                        local->op_ret = -1;
+                op_ret = 0;
 
-                if (local->op_ret != -1) {
-                        local->pre_buf.ia_blocks  = local->prebuf_blocks;
-                        local->pre_buf.ia_size    = local->prebuf_size;
-                        local->post_buf.ia_blocks = local->postbuf_blocks;
-                        local->post_buf.ia_size   = local->postbuf_size;
+                /* Keep extra space for filling in '\0's */
+                vec = GF_CALLOC ((local->count * 2), sizeof (struct iovec),
+                                 gf_stripe_mt_iovec);
+                if (!vec) {
+                        op_ret = -1;
+                        goto done;
                 }
 
-                STRIPE_STACK_UNWIND (fsync, frame, local->op_ret,
-                                     local->op_errno, &local->pre_buf,
-                                     &local->post_buf);
-        }
-out:
-        return 0;
-}
-
-int32_t
-stripe_fsync (call_frame_t *frame, xlator_t *this, fd_t *fd, int32_t flags)
-{
-        stripe_local_t   *local = NULL;
-        stripe_private_t *priv = NULL;
-        xlator_list_t    *trav = NULL;
-        int32_t           op_errno = 1;
+                for (i = 0; i < local->wind_count; i++) {
+                        if (local->replies[i].op_ret) {
+                                memcpy ((vec + count), local->replies[i].vector,
+                                        (local->replies[i].count * sizeof (struct iovec)));
+                                count +=  local->replies[i].count;
+                                op_ret += local->replies[i].op_ret;
+                        }
+                        if ((local->replies[i].op_ret <
+                             local->replies[i].requested_size) &&
+                            (local->stbuf_size > (local->offset + op_ret))) {
+                                /* Fill in 0s here */
+                                vec[count].iov_len  =
+                                        (local->replies[i].requested_size -
+                                         local->replies[i].op_ret);
+                                iobuf = iobuf_get (this->ctx->iobuf_pool);
+                                if (!iobuf) {
+                                        gf_log (this->name, GF_LOG_ERROR,
+                                                "Out of memory.");
+                                        op_ret = -1;
+                                        op_errno = ENOMEM;
+                                        goto done;
+                                }
+                                memset (iobuf->ptr, 0, vec[count].iov_len);
+                                iobref_add (local->iobref, iobuf);
+                                vec[count].iov_base = iobuf->ptr;
 
-        VALIDATE_OR_GOTO (frame, err);
-        VALIDATE_OR_GOTO (this, err);
-        VALIDATE_OR_GOTO (fd, err);
-        VALIDATE_OR_GOTO (fd->inode, err);
+                                op_ret += vec[count].iov_len;
+                                count++;
+                        }
+                        GF_FREE (local->replies[i].vector);
+                }
 
-        priv = this->private;
-        trav = this->children;
+                /* FIXME: notice that st_ino, and st_dev (gen) will be
+                 * different than what inode will have. Make sure this doesn't
+                 * cause any bugs at higher levels */
+                memcpy (&tmp_stbuf, &local->replies[0].stbuf,
+                        sizeof (struct iatt));
+                tmp_stbuf.ia_size = local->stbuf_size;
 
-        /* Initialization */
-        local = GF_CALLOC (1, sizeof (stripe_local_t),
-                           gf_stripe_mt_stripe_local_t);
-        if (!local) {
-                op_errno = ENOMEM;
-                goto err;
-        }
-        local->op_ret = -1;
-        frame->local = local;
-        local->call_count = priv->child_count;
+        done:
+                GF_FREE (local->replies);
+                tmp_iobref = local->iobref;
+                fd_unref (local->fd);
+                STRIPE_STACK_UNWIND (readv, frame, op_ret, op_errno, vec,
+                                     count, &tmp_stbuf, tmp_iobref);
 
-        while (trav) {
-                STACK_WIND (frame, stripe_fsync_cbk, trav->xlator,
-                            trav->xlator->fops->fsync, fd, flags);
-                trav = trav->next;
+                iobref_unref (tmp_iobref);
+                if (vec)
+                        GF_FREE (vec);
         }
-
-        return 0;
-err:
-        STRIPE_STACK_UNWIND (fsync, frame, -1, op_errno, NULL, NULL);
+out:
         return 0;
 }
 
+/**
+ * stripe_readv_cbk - get all the striped reads, and order it properly, send it
+ *        to above layer after putting it in a single vector.
+ */
 int32_t
-stripe_fstat_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
-                  int32_t op_ret, int32_t op_errno, struct iatt *buf)
+stripe_readv_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                  int32_t op_ret, int32_t op_errno, struct iovec *vector,
+                  int32_t count, struct iatt *stbuf, struct iobref *iobref)
 {
+        int32_t         index = 0;
         int32_t         callcnt = 0;
+        int32_t         final_count = 0;
+        int32_t         need_to_check_proper_size = 0;
+        call_frame_t   *mframe = NULL;
+        stripe_local_t *mlocal = NULL;
         stripe_local_t *local = NULL;
-        call_frame_t   *prev = NULL;
+        struct iovec   *final_vec = NULL;
+        struct iatt     tmp_stbuf = {0,};
+        struct iobref  *tmp_iobref = NULL;
+        stripe_fd_ctx_t  *fctx = NULL;
+        call_frame_t     *prev = NULL;
 
         if (!this || !frame || !frame->local || !cookie) {
                 gf_log ("stripe", GF_LOG_DEBUG, "possible NULL deref");
-                goto out;
+                goto end;
         }
 
-        prev  = cookie;
-        local = frame->local;
+        prev   = cookie;
+        local  = frame->local;
+        index  = local->node_index;
+        mframe = local->orig_frame;
+        if (!mframe)
+                goto out;
 
-        LOCK (&frame->lock);
+        mlocal = mframe->local;
+        if (!mlocal)
+                goto out;
+
+        fctx = mlocal->fctx;
+
+        LOCK (&mframe->lock);
         {
-                callcnt = --local->call_count;
+                mlocal->replies[index].op_ret = op_ret;
+                mlocal->replies[index].op_errno = op_errno;
+                mlocal->replies[index].requested_size = local->readv_size;
+                if (op_ret >= 0) {
+                        mlocal->replies[index].stbuf  = *stbuf;
+                        mlocal->replies[index].stbuf.ia_size =
+                                stripe_file_size (fctx->stripe_size,
+                                                  fctx->data_count,
+                                                  fctx->coalesce,
+                                                  stripe_child_index (this,
+                                                          prev->this),
+                                                  stbuf->ia_size);
+                        mlocal->replies[index].count  = count;
+                        mlocal->replies[index].vector = iov_dup (vector, count);
 
-                if (op_ret == -1) {
-                        gf_log (this->name, GF_LOG_DEBUG,
-                                "%s returned error %s",
-                                prev->this->name, strerror (op_errno));
-                        local->op_errno = op_errno;
-                        if ((op_errno != ENOENT) ||
-                            (prev->this == FIRST_CHILD (this)))
-                                local->failed = 1;
+                        if (!mlocal->iobref)
+                                mlocal->iobref = iobref_new ();
+                        iobref_merge (mlocal->iobref, iobref);
                 }
+                callcnt = ++mlocal->call_count;
+        }
+        UNLOCK(&mframe->lock);
 
-                if (op_ret == 0) {
-                        local->op_ret = 0;
+        if (callcnt == mlocal->wind_count) {
+                op_ret = 0;
 
-                        if (FIRST_CHILD(this) == prev->this)
-                                local->stbuf = *buf;
+                for (index=0; index < mlocal->wind_count; index++) {
+                        /* check whether each stripe returned
+                         * 'expected' number of bytes */
+                        if ((mlocal->replies[index].op_ret == -1) &&
+                            fctx->redundancy) {
+                                stripe_ec_readv (mframe, this);
+                                goto out;
+                        }
+                        if (mlocal->replies[index].op_ret == -1) {
+                                op_ret = -1;
+                                op_errno = mlocal->replies[index].op_errno;
+                                break;
+                        }
+                        /* TODO: handle the 'holes' within the read range
+                           properly */
+                        if (mlocal->replies[index].op_ret <
+                            mlocal->replies[index].requested_size) {
+                                need_to_check_proper_size = 1;
+                        }
 
-                        local->stbuf_blocks += buf->ia_blocks;
-                        if (local->stbuf_size < buf->ia_size)
-                                local->stbuf_size = buf->ia_size;
+                        op_ret       += mlocal->replies[index].op_ret;
+                        mlocal->count += mlocal->replies[index].count;
                 }
-        }
-        UNLOCK (&frame->lock);
+                if (op_ret == -1)
+                        goto done;
+                if (need_to_check_proper_size)
+                        goto check_size;
 
-        if (!callcnt) {
-                if (local->failed)
-                        local->op_ret = -1;
+                final_vec = GF_CALLOC (mlocal->count, sizeof (struct iovec),
+                                       gf_stripe_mt_iovec);
 
-                if (local->op_ret != -1) {
-                        local->stbuf.ia_size   = local->stbuf_size;
-                        local->stbuf.ia_blocks = local->stbuf_blocks;
+                if (!final_vec) {
+                        op_ret = -1;
+                        goto done;
                 }
 
-                STRIPE_STACK_UNWIND (fstat, frame, local->op_ret,
-                                     local->op_errno, &local->stbuf);
-        }
+                for (index = 0; index < mlocal->wind_count; index++) {
+                        memcpy ((final_vec + final_count),
+                                mlocal->replies[index].vector,
+                                (mlocal->replies[index].count *
+                                 sizeof (struct iovec)));
+                        final_count +=  mlocal->replies[index].count;
+                        GF_FREE (mlocal->replies[index].vector);
+                }
 
-out:
-        return 0;
-}
+                /* FIXME: notice that st_ino, and st_dev (gen) will be
+                 * different than what inode will have. Make sure this doesn't
+                 * cause any bugs at higher levels */
+                memcpy (&tmp_stbuf, &mlocal->replies[0].stbuf,
+                        sizeof (struct iatt));
 
-int32_t
-stripe_fstat (call_frame_t *frame,
-              xlator_t *this,
-              fd_t *fd)
-{
-        stripe_local_t   *local = NULL;
-        stripe_private_t *priv = NULL;
-        xlator_list_t    *trav = NULL;
-        int32_t           op_errno = 1;
+        done:
+                /* */
+                GF_FREE (mlocal->replies);
+                tmp_iobref = mlocal->iobref;
+                fd_unref (mlocal->fd);
+                STRIPE_STACK_UNWIND (readv, mframe, op_ret, op_errno, final_vec,
+                                     final_count, &tmp_stbuf, tmp_iobref);
 
-        VALIDATE_OR_GOTO (frame, err);
-        VALIDATE_OR_GOTO (this, err);
-        VALIDATE_OR_GOTO (fd, err);
-        VALIDATE_OR_GOTO (fd->inode, err);
+                iobref_unref (tmp_iobref);
+                if (final_vec)
+                        GF_FREE (final_vec);
+        }
 
-        priv = this->private;
-        trav = this->children;
+        goto out;
 
-        /* Initialization */
-        local = GF_CALLOC (1, sizeof (stripe_local_t),
-                           gf_stripe_mt_stripe_local_t);
-        if (!local) {
-                op_errno = ENOMEM;
-                goto err;
-        }
-        local->op_ret = -1;
-        frame->local = local;
-        local->call_count = priv->child_count;
+check_size:
+        mlocal->call_count = fctx->data_count;
 
-        while (trav) {
-                STACK_WIND (frame, stripe_fstat_cbk, trav->xlator,
-                            trav->xlator->fops->fstat, fd);
-                trav = trav->next;
+        for (index = 0; index < fctx->data_count; index++) {
+                STACK_WIND (mframe, stripe_readv_fstat_cbk,
+                            (fctx->xl_array[index]),
+                            (fctx->xl_array[index])->fops->fstat,
+                            mlocal->fd);
         }
 
-        return 0;
-err:
-        STRIPE_STACK_UNWIND (fstat, frame, -1, op_errno, NULL);
+out:
+        STRIPE_STACK_DESTROY (frame);
+end:
         return 0;
 }
 
 
 int32_t
-stripe_ftruncate (call_frame_t *frame, xlator_t *this, fd_t *fd, off_t offset)
+stripe_readv_blocks (call_frame_t *frame, xlator_t *this, fd_t *fd,
+                     size_t size, off_t offset)
 {
+        int32_t           op_errno = EINVAL;
+        int32_t           idx = 0;
+        int32_t           index = 0;
+        int32_t           num_stripe = 0;
+        int32_t           off_index = 0;
+        size_t            frame_size = 0;
+        off_t             rounded_end = 0;
+        uint64_t          tmp_fctx = 0;
+        uint64_t          stripe_size = 0;
+        off_t             rounded_start = 0;
+        off_t             frame_offset = offset;
         stripe_local_t   *local = NULL;
-        stripe_private_t *priv = NULL;
-        xlator_list_t    *trav = NULL;
-        int32_t           op_errno = 1;
+        call_frame_t     *rframe = NULL;
+        stripe_local_t   *rlocal = NULL;
+        stripe_fd_ctx_t  *fctx = NULL;
 
         VALIDATE_OR_GOTO (frame, err);
         VALIDATE_OR_GOTO (this, err);
         VALIDATE_OR_GOTO (fd, err);
         VALIDATE_OR_GOTO (fd->inode, err);
 
-        priv = this->private;
-        trav = this->children;
+        fd_ctx_get (fd, this, &tmp_fctx);
+        if (!tmp_fctx) {
+                op_errno = EBADFD;
+                goto err;
+        }
+        fctx = (stripe_fd_ctx_t *)(long)tmp_fctx;
+        stripe_size = fctx->stripe_size;
+
+        if (!stripe_size) {
+                gf_log (this->name, GF_LOG_DEBUG,
+                        "Wrong stripe size for the file");
+                goto err;
+        }
+        /* The file is stripe across the child nodes. Send the read request
+         * to the child nodes appropriately after checking which region of
+         * the file is in which child node. Always '0-<stripe_size>' part of
+         * the file resides in the first child.
+         */
+        rounded_start = floor (offset, stripe_size);
+        rounded_end = roof (offset+size, stripe_size);
+        num_stripe = (rounded_end- rounded_start)/stripe_size;
 
-        /* Initialization */
         local = GF_CALLOC (1, sizeof (stripe_local_t),
                            gf_stripe_mt_stripe_local_t);
         if (!local) {
                 op_errno = ENOMEM;
                 goto err;
         }
-        local->op_ret = -1;
         frame->local = local;
-        local->call_count = priv->child_count;
 
-        while (trav) {
-                STACK_WIND (frame, stripe_truncate_cbk, trav->xlator,
-                            trav->xlator->fops->ftruncate, fd, offset);
-                trav = trav->next;
+        off_index = (offset / stripe_size) % fctx->data_count;
+
+        /* A data subvolume was down at open, rebuild from parity */
+        for (index = off_index; index < (num_stripe + off_index); index++) {
+                if (!fctx->redundancy ||
+                    fctx->xl_array[index % fctx->data_count])
+                        continue;
+                local->readv_size = size;
+                local->offset     = offset;
+                local->fd         = fd_ref (fd);
+                local->fctx       = fctx;
+                stripe_ec_readv (frame, this);
+                return 0;
+        }
+
+        /* This is where all the vectors should be copied. */
+        local->replies = GF_CALLOC (num_stripe, sizeof (struct readv_replies),
+                                    gf_stripe_mt_readv_replies);
+        if (!local->replies) {
+                op_errno = ENOMEM;
+                goto err;
+        }
+
+        local->wind_count = num_stripe;
+        local->readv_size = size;
+        local->offset     = offset;
+        local->fd         = fd_ref (fd);
+        local->fctx       = fctx;
+
+        for (index = off_index; index < (num_stripe + off_index); index++) {
+                rframe = copy_frame (frame);
+                rlocal = GF_CALLOC (1, sizeof (stripe_local_t),
+                                    gf_stripe_mt_stripe_local_t);
+                if (!rlocal) {
+                        op_errno = ENOMEM;
+                        goto err;
+                }
+
+                frame_size = min (roof (frame_offset+1, stripe_size),
+                                  (offset + size)) - frame_offset;
+
+                rlocal->node_index = index - off_index;
+                rlocal->orig_frame = frame;
+                rlocal->readv_size = frame_size;
+                rframe->local = rlocal;
+                idx = (index % fctx->data_count);
+                STACK_WIND (rframe, stripe_readv_cbk, fctx->xl_array[idx],
+                            fctx->xl_array[idx]->fops->readv,
+                            fd, frame_size,
+                            stripe_child_offset (stripe_size,
+                                                 fctx->data_count,
+                                                 fctx->coalesce,
+                                                 frame_offset));
+
+                frame_offset += frame_size;
         }
 
         return 0;
 err:
-        STRIPE_STACK_UNWIND (ftruncate, frame, -1, op_errno, NULL, NULL);
+        if (local && local->fd)
+                fd_unref (local->fd);
+        if (rframe)
+                STRIPE_STACK_DESTROY (rframe);
+
+        STRIPE_STACK_UNWIND (readv, frame, -1, op_errno, NULL, 0, NULL, NULL);
         return 0;
 }
 
 
 int32_t
-stripe_fsyncdir_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
-                     int32_t op_ret, int32_t op_errno)
+stripe_writev_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                   int32_t op_ret, int32_t op_errno, struct iatt *prebuf,
+                   struct iatt *postbuf)
 {
         int32_t         callcnt = 0;
-        stripe_local_t *local   = NULL;
+        stripe_local_t *local = NULL;
         call_frame_t   *prev = NULL;
+        fd_t           *fd = NULL;
+        off_t           size = 0;
+        int             index = 0;
 
         if (!this || !frame || !frame->local || !cookie) {
                 gf_log ("stripe", GF_LOG_DEBUG, "possible NULL deref");
@@ -2994,543 +4988,958 @@ stripe_fsyncdir_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
         prev  = cookie;
         local = frame->local;
 
-        LOCK (&frame->lock);
+        LOCK(&frame->lock);
         {
-                callcnt = --local->call_count;
+                callcnt = ++local->call_count;
 
                 if (op_ret == -1) {
                         gf_log (this->name, GF_LOG_DEBUG,
-                                "%s returned %s",
+                                "%s returned error %s",
                                 prev->this->name, strerror (op_errno));
                         local->op_errno = op_errno;
-                        if ((op_errno != ENOENT) ||
-                            (prev->this == FIRST_CHILD (this)))
-                                local->failed = 1;
+                        local->op_ret = -1;
+                }
+                if (op_ret >= 0) {
+                        local->op_ret += op_ret;
+                        local->post_buf = *postbuf;
+                        local->pre_buf = *prebuf;
+                        if (local->fctx->coalesce) {
+                                index = stripe_child_index (this, prev->this);
+                                size  = stripe_file_size (
+                                        local->fctx->stripe_size,
+                                        local->fctx->data_count, 1, index,
+                                        postbuf->ia_size);
+                                if (local->postbuf_size < size)
+                                        local->postbuf_size = size;
+                                local->post_buf.ia_size = local->postbuf_size;
+                                local->pre_buf.ia_size  = stripe_file_size (
+                                        local->fctx->stripe_size,
+                                        local->fctx->data_count, 1, index,
+                                        prebuf->ia_size);
+                        }
                 }
-                if (op_ret >= 0)
-                        local->op_ret = op_ret;
         }
         UNLOCK (&frame->lock);
 
-        if (!callcnt) {
-                if (local->failed)
-                        local->op_ret = -1;
-
-                STRIPE_STACK_UNWIND (fsyncdir, frame, local->op_ret,
-                                     local->op_errno);
+        if ((callcnt == local->wind_count) && local->unwind) {
+                if (local->op_ret != -1)
+                        stripe_wa_stbuf_set (this, local->fd,
+                                             &local->post_buf);
+
+                if (local->fctx->redundancy) {
+                        if (local->op_ret != -1) {
+                                stripe_ec_parity_update (frame, this,
+                                                         GF_FOP_WRITE,
+                                                         local->offset,
+                                                         local->offset +
+                                                         local->readv_size);
+                                goto out;
+                        }
+                        fd_unref (local->fd);
+                } else {
+                        fd = local->fd;
+                }
+                STRIPE_STACK_UNWIND (writev, frame, local->op_ret,
+                                     local->op_errno, &local->pre_buf,
+                                     &local->post_buf);
+                if (fd)
+                        fd_unref (fd);
         }
 out:
         return 0;
 }
 
 int32_t
-stripe_fsyncdir (call_frame_t *frame, xlator_t *this, fd_t *fd, int32_t flags)
+stripe_writev_blocks (call_frame_t *frame, xlator_t *this, fd_t *fd,
+                      struct iovec *vector, int32_t count, off_t offset,
+                      struct iobref *iobref)
 {
+        struct iovec     *tmp_vec = NULL;
         stripe_local_t   *local = NULL;
-        stripe_private_t *priv = NULL;
-        xlator_list_t    *trav = NULL;
+        stripe_fd_ctx_t  *fctx = NULL;
         int32_t           op_errno = 1;
+        int32_t           idx = 0;
+        int32_t           total_size = 0;
+        int32_t           offset_offset = 0;
+        int32_t           remaining_size = 0;
+        int32_t           tmp_count = count;
+        off_t             fill_size = 0;
+        uint64_t          stripe_size = 0;
+        uint64_t          tmp_fctx = 0;
 
         VALIDATE_OR_GOTO (frame, err);
         VALIDATE_OR_GOTO (this, err);
         VALIDATE_OR_GOTO (fd, err);
         VALIDATE_OR_GOTO (fd->inode, err);
 
-        priv = this->private;
-        trav = this->children;
+        fd_ctx_get (fd, this, &tmp_fctx);
+        if (!tmp_fctx) {
+                op_errno = EINVAL;
+                goto err;
+        }
+        fctx = (stripe_fd_ctx_t *)(long)tmp_fctx;
+        stripe_size = fctx->stripe_size;
+
+        /* Parity can't be kept right without all the fragments */
+        for (idx = 0; fctx->redundancy && (idx < fctx->stripe_count); idx++) {
+                if (!fctx->xl_array[idx]) {
+                        gf_log (this->name, GF_LOG_DEBUG,
+                                "subvolume %d down, failing write", idx);
+                        op_errno = ENOTCONN;
+                        goto err;
+                }
+        }
+
+        /* File has to be stripped across the child nodes */
+        for (idx = 0; idx< count; idx ++) {
+                total_size += vector[idx].iov_len;
+        }
+        remaining_size = total_size;
 
-        /* Initialization */
         local = GF_CALLOC (1, sizeof (stripe_local_t),
                            gf_stripe_mt_stripe_local_t);
         if (!local) {
                 op_errno = ENOMEM;
                 goto err;
         }
-        local->op_ret = -1;
         frame->local = local;
-        local->call_count = priv->child_count;
+        local->stripe_size = stripe_size;
+        local->fctx = fctx;
+        local->fd   = fd_ref (fd);
+        if (fctx->redundancy) {
+                /* range whose parity is refreshed once the data is in */
+                local->offset     = offset;
+                local->readv_size = total_size;
+        }
 
-        while (trav) {
-                STACK_WIND (frame, stripe_fsyncdir_cbk, trav->xlator,
-                            trav->xlator->fops->fsyncdir, fd, flags);
-                trav = trav->next;
+        while (1) {
+                /* Send striped chunk of the vector to child
+                   nodes appropriately. */
+                idx = (((offset + offset_offset) /
+                        local->stripe_size) % fctx->data_count);
+
+                fill_size = (local->stripe_size -
+                             ((offset + offset_offset) % local->stripe_size));
+                if (fill_size > remaining_size)
+                        fill_size = remaining_size;
+
+                remaining_size -= fill_size;
+
+                tmp_count = iov_subset (vector, count, offset_offset,
+                                        offset_offset + fill_size, NULL);
+                tmp_vec = GF_CALLOC (tmp_count, sizeof (struct iovec),
+                                     gf_stripe_mt_iovec);
+                if (!tmp_vec) {
+                        op_errno = ENOMEM;
+                        goto err;
+                }
+                tmp_count = iov_subset (vector, count, offset_offset,
+                                        offset_offset + fill_size, tmp_vec);
+
+                local->wind_count++;
+                if (remaining_size == 0)
+                        local->unwind = 1;
+
+                STACK_WIND (frame, stripe_writev_cbk, fctx->xl_array[idx],
+                            fctx->xl_array[idx]->fops->writev, fd, tmp_vec,
+                            tmp_count,
+                            stripe_child_offset (stripe_size,
+                                                 fctx->data_count,
+                                                 fctx->coalesce,
+                                                 offset + offset_offset),
+                            iobref);
+                GF_FREE (tmp_vec);
+                offset_offset += fill_size;
+                if (remaining_size == 0)
+                        break;
         }
 
         return 0;
 err:
-        STRIPE_STACK_UNWIND (fsyncdir, frame, -1, op_errno);
+        if (local && local->fd)
+                fd_unref (local->fd);
+        STRIPE_STACK_UNWIND (writev, frame, -1, op_errno, NULL, NULL);
         return 0;
 }
 
 
-int32_t
-stripe_readv_fstat_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
-                        int32_t op_ret, int32_t op_errno, struct iatt *buf)
+/*
+ * Write aggregation and stripe-wide read-ahead
+ */
+
+static stripe_fd_io_t *
+stripe_fd_io_get (xlator_t *this, fd_t *fd)
 {
-        int32_t         i = 0;
-        int32_t         callcnt = 0;
-        int32_t         count = 0;
-        stripe_local_t *local = NULL;
-        struct iovec   *vec = NULL;
-        struct iatt     tmp_stbuf = {0,};
-        struct iobref  *tmp_iobref = NULL;
-        struct iobuf   *iobuf = NULL;
+        stripe_fd_ctx_t *fctx = NULL;
+        uint64_t         tmp_fctx = 0;
 
-        if (!this || !frame || !frame->local) {
-                gf_log ("stripe", GF_LOG_DEBUG, "possible NULL deref");
-                goto out;
+        fd_ctx_get (fd, this, &tmp_fctx);
+        fctx = (stripe_fd_ctx_t *)(long)tmp_fctx;
+
+        return fctx ? fctx->io : NULL;
+}
+
+void
+stripe_fd_io_new (xlator_t *this, stripe_fd_ctx_t *fctx)
+{
+        stripe_private_t *priv = NULL;
+        stripe_fd_io_t   *io = NULL;
+
+        priv = this->private;
+        if (!priv->aggregate_writes && !priv->read_ahead)
+                return;
+
+        io = GF_CALLOC (1, sizeof (*io), gf_stripe_mt_fd_io_t);
+        if (!io)
+                return;
+
+        LOCK_INIT (&io->lock);
+        INIT_LIST_HEAD (&io->wa_waiting);
+        fctx->io = io;
+}
+
+static void
+__stripe_ra_drop (stripe_fd_io_t *io)
+{
+        io->ra_gen++;
+        if (io->ra_iobref)
+                iobref_unref (io->ra_iobref);
+        if (io->ra_vector)
+                GF_FREE (io->ra_vector);
+        io->ra_iobref = NULL;
+        io->ra_vector = NULL;
+        io->ra_count  = 0;
+        io->ra_size   = 0;
+        io->ra_eof    = 0;
+}
+
+void
+stripe_ra_drop (xlator_t *this, fd_t *fd)
+{
+        stripe_fd_io_t *io = NULL;
+
+        io = stripe_fd_io_get (this, fd);
+        if (!io)
+                return;
+
+        LOCK (&io->lock);
+        {
+                __stripe_ra_drop (io);
         }
+        UNLOCK (&io->lock);
+}
 
-        local = frame->local;
+void
+stripe_fd_io_free (xlator_t *this, stripe_fd_io_t *io)
+{
+        if (io->wa_size)
+                gf_log (this->name, GF_LOG_WARNING,
+                        "released with %"GF_PRI_SIZET" bytes of aggregated "
+                        "writes at %"PRId64" never flushed", io->wa_size,
+                        io->wa_offset);
+        if (io->wa_iobref)
+                iobref_unref (io->wa_iobref);
+        __stripe_ra_drop (io);
+        LOCK_DESTROY (&io->lock);
+        GF_FREE (io);
+}
 
-        LOCK (&frame->lock);
+/* whether fops on the fd have to wait for buffered writes to go down */
+int
+stripe_wa_pending (xlator_t *this, fd_t *fd)
+{
+        stripe_fd_io_t *io = NULL;
+        int             pending = 0;
+
+        io = stripe_fd_io_get (this, fd);
+        if (!io)
+                return 0;
+
+        LOCK (&io->lock);
         {
-                callcnt = --local->call_count;
-                if (op_ret != -1)
-                        if (local->stbuf_size < buf->ia_size)
-                                local->stbuf_size = buf->ia_size;
+                pending = (io->wa_size || io->wa_flushing);
         }
-        UNLOCK (&frame->lock);
+        UNLOCK (&io->lock);
 
-        if (!callcnt) {
-                op_ret = 0;
+        return pending;
+}
 
-                /* Keep extra space for filling in '\0's */
-                vec = GF_CALLOC ((local->count * 2), sizeof (struct iovec),
-                                 gf_stripe_mt_iovec);
-                if (!vec) {
-                        op_ret = -1;
-                        goto done;
-                }
+/**
+ * stripe_wa_inode_fd - an fd of the inode, other than 'skip', with buffered
+ *     writes which did not reach the children yet. Path fops, and fops on
+ *     any fd of the inode, have to wait for those. Returns it with a ref.
+ */
+fd_t *
+stripe_wa_inode_fd (xlator_t *this, inode_t *inode, fd_t *skip)
+{
+        stripe_fd_io_t *io = NULL;
+        fd_t           *iter = NULL;
+        fd_t           *fd = NULL;
+        int             pending = 0;
 
-                for (i = 0; i < local->wind_count; i++) {
-                        if (local->replies[i].op_ret) {
-                                memcpy ((vec + count), local->replies[i].vector,
-                                        (local->replies[i].count * sizeof (struct iovec)));
-                                count +=  local->replies[i].count;
-                                op_ret += local->replies[i].op_ret;
+        if (!inode)
+                return NULL;
+
+        LOCK (&inode->lock);
+        {
+                list_for_each_entry (iter, &inode->fd_list, inode_list) {
+                        if (iter == skip)
+                                continue;
+
+                        io = stripe_fd_io_get (this, iter);
+                        if (!io)
+                                continue;
+
+                        LOCK (&io->lock);
+                        {
+                                pending = (io->wa_size || io->wa_flushing);
                         }
-                        if ((local->replies[i].op_ret <
-                             local->replies[i].requested_size) &&
-                            (local->stbuf_size > (local->offset + op_ret))) {
-                                /* Fill in 0s here */
-                                vec[count].iov_len  =
-                                        (local->replies[i].requested_size -
-                                         local->replies[i].op_ret);
-                                iobuf = iobuf_get (this->ctx->iobuf_pool);
-                                if (!iobuf) {
-                                        gf_log (this->name, GF_LOG_ERROR,
-                                                "Out of memory.");
-                                        op_ret = -1;
-                                        op_errno = ENOMEM;
-                                        goto done;
-                                }
-                                memset (iobuf->ptr, 0, vec[count].iov_len);
-                                iobref_add (local->iobref, iobuf);
-                                vec[count].iov_base = iobuf->ptr;
+                        UNLOCK (&io->lock);
 
-                                op_ret += vec[count].iov_len;
-                                count++;
+                        if (pending) {
+                                fd = _fd_ref (iter);
+                                break;
                         }
-                        GF_FREE (local->replies[i].vector);
                 }
+        }
+        UNLOCK (&inode->lock);
 
-                /* FIXME: notice that st_ino, and st_dev (gen) will be
-                 * different than what inode will have. Make sure this doesn't
-                 * cause any bugs at higher levels */
-                memcpy (&tmp_stbuf, &local->replies[0].stbuf,
-                        sizeof (struct iatt));
-                tmp_stbuf.ia_size = local->stbuf_size;
+        return fd;
+}
+
+/* holds 'stub' until the buffered writes of 'wfd' went down, and drops the
+   ref stripe_wa_inode_fd took on it */
+int
+stripe_wa_wait (call_frame_t *frame, xlator_t *this, fd_t *wfd,
+                call_stub_t *stub)
+{
+        if (stub)
+                stripe_wa_flush (frame, this, wfd, stub);
+        fd_unref (wfd);
+
+        return stub ? 0 : -1;
+}
+
+/* keeps the attributes a write on the fd returned, buffered writes are
+   answered with them */
+void
+stripe_wa_stbuf_set (xlator_t *this, fd_t *fd, struct iatt *stbuf)
+{
+        stripe_fd_io_t *io = NULL;
 
-        done:
-                GF_FREE (local->replies);
-                tmp_iobref = local->iobref;
-                fd_unref (local->fd);
-                STRIPE_STACK_UNWIND (readv, frame, op_ret, op_errno, vec,
-                                     count, &tmp_stbuf, tmp_iobref);
+        io = stripe_fd_io_get (this, fd);
+        if (!io)
+                return;
 
-                iobref_unref (tmp_iobref);
-                if (vec)
-                        GF_FREE (vec);
+        LOCK (&io->lock);
+        {
+                io->wa_stbuf = *stbuf;
+                io->wa_stbuf_valid = 1;
         }
-out:
-        return 0;
+        UNLOCK (&io->lock);
 }
 
-/**
- * stripe_readv_cbk - get all the striped reads, and order it properly, send it
- *        to above layer after putting it in a single vector.
- */
+/* error of an earlier flush of aggregated writes, reported once */
 int32_t
-stripe_readv_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
-                  int32_t op_ret, int32_t op_errno, struct iovec *vector,
-                  int32_t count, struct iatt *stbuf, struct iobref *iobref)
+stripe_wa_error (xlator_t *this, fd_t *fd)
 {
-        int32_t         index = 0;
-        int32_t         callcnt = 0;
-        int32_t         final_count = 0;
-        int32_t         need_to_check_proper_size = 0;
-        call_frame_t   *mframe = NULL;
-        stripe_local_t *mlocal = NULL;
-        stripe_local_t *local = NULL;
-        struct iovec   *final_vec = NULL;
-        struct iatt     tmp_stbuf = {0,};
-        struct iobref  *tmp_iobref = NULL;
-        stripe_fd_ctx_t  *fctx = NULL;
+        stripe_fd_io_t *io = NULL;
+        int32_t         op_errno = 0;
 
-        if (!this || !frame || !frame->local || !cookie) {
-                gf_log ("stripe", GF_LOG_DEBUG, "possible NULL deref");
-                goto end;
+        io = stripe_fd_io_get (this, fd);
+        if (!io)
+                return 0;
+
+        LOCK (&io->lock);
+        {
+                op_errno = io->wa_op_errno;
+                io->wa_op_errno = 0;
         }
+        UNLOCK (&io->lock);
 
-        local  = frame->local;
-        index  = local->node_index;
-        mframe = local->orig_frame;
-        if (!mframe)
-                goto out;
+        return op_errno;
+}
 
-        mlocal = mframe->local;
-        if (!mlocal)
-                goto out;
+static void
+stripe_wa_flush_done (xlator_t *this, fd_t *fd, int32_t op_ret,
+                      int32_t op_errno)
+{
+        stripe_fd_io_t   *io = NULL;
+        call_stub_t      *stub = NULL;
+        call_stub_t      *tmp = NULL;
+        struct list_head  waiting;
 
-        fctx = mlocal->fctx;
+        io = stripe_fd_io_get (this, fd);
+        INIT_LIST_HEAD (&waiting);
 
-        LOCK (&mframe->lock);
+        LOCK (&io->lock);
         {
-                mlocal->replies[index].op_ret = op_ret;
-                mlocal->replies[index].op_errno = op_errno;
-                mlocal->replies[index].requested_size = local->readv_size;
-                if (op_ret >= 0) {
-                        mlocal->replies[index].stbuf  = *stbuf;
-                        mlocal->replies[index].count  = count;
-                        mlocal->replies[index].vector = iov_dup (vector, count);
-
-                        if (!mlocal->iobref)
-                                mlocal->iobref = iobref_new ();
-                        iobref_merge (mlocal->iobref, iobref);
+                io->wa_flushing = 0;
+                if (op_ret == -1) {
+                        gf_log (this->name, GF_LOG_WARNING,
+                                "aggregated write failed: %s",
+                                strerror (op_errno));
+                        io->wa_op_errno = op_errno;
                 }
-                callcnt = ++mlocal->call_count;
+                list_splice_init (&io->wa_waiting, &waiting);
         }
-        UNLOCK(&mframe->lock);
+        UNLOCK (&io->lock);
 
-        if (callcnt == mlocal->wind_count) {
-                op_ret = 0;
+        list_for_each_entry_safe (stub, tmp, &waiting, list) {
+                list_del_init (&stub->list);
+                call_resume (stub);
+        }
+}
 
-                for (index=0; index < mlocal->wind_count; index++) {
-                        /* check whether each stripe returned
-                         * 'expected' number of bytes */
-                        if (mlocal->replies[index].op_ret == -1) {
-                                op_ret = -1;
-                                op_errno = mlocal->replies[index].op_errno;
-                                break;
-                        }
-                        /* TODO: handle the 'holes' within the read range
-                           properly */
-                        if (mlocal->replies[index].op_ret <
-                            mlocal->replies[index].requested_size) {
-                                need_to_check_proper_size = 1;
-                        }
+int32_t
+stripe_wa_flush_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                     int32_t op_ret, int32_t op_errno, struct iatt *prebuf,
+                     struct iatt *postbuf)
+{
+        fd_t *fd = NULL;
 
-                        op_ret       += mlocal->replies[index].op_ret;
-                        mlocal->count += mlocal->replies[index].count;
-                }
-                if (op_ret == -1)
-                        goto done;
-                if (need_to_check_proper_size)
-                        goto check_size;
+        fd = cookie;
+        STACK_DESTROY (frame->root);
 
-                final_vec = GF_CALLOC (mlocal->count, sizeof (struct iovec),
-                                       gf_stripe_mt_iovec);
+        stripe_wa_flush_done (this, fd, op_ret, op_errno);
+        fd_unref (fd);
+        return 0;
+}
 
-                if (!final_vec) {
-                        op_ret = -1;
-                        goto done;
+/**
+ * stripe_wa_flush - send the buffered writes of the fd down, and resume
+ *     'stub' (if any) once they are written.
+ */
+void
+stripe_wa_flush (call_frame_t *frame, xlator_t *this, fd_t *fd,
+                 call_stub_t *stub)
+{
+        stripe_fd_io_t *io = NULL;
+        call_frame_t   *flush_frame = NULL;
+        struct iobref  *iobref = NULL;
+        struct iovec    vector[STRIPE_IOBREF_MAX_IOBUFS];
+        off_t           offset = 0;
+        int             count = 0;
+        int             start = 0;
+        int             resume = 0;
+
+        io = stripe_fd_io_get (this, fd);
+
+        LOCK (&io->lock);
+        {
+                if (io->wa_flushing) {
+                        if (stub)
+                                list_add_tail (&stub->list, &io->wa_waiting);
+                        goto unlock;
                 }
-
-                for (index = 0; index < mlocal->wind_count; index++) {
-                        memcpy ((final_vec + final_count),
-                                mlocal->replies[index].vector,
-                                (mlocal->replies[index].count *
-                                 sizeof (struct iovec)));
-                        final_count +=  mlocal->replies[index].count;
-                        GF_FREE (mlocal->replies[index].vector);
+                if (!io->wa_size) {
+                        resume = 1;
+                        goto unlock;
                 }
 
-                /* FIXME: notice that st_ino, and st_dev (gen) will be
-                 * different than what inode will have. Make sure this doesn't
-                 * cause any bugs at higher levels */
-                memcpy (&tmp_stbuf, &mlocal->replies[0].stbuf,
-                        sizeof (struct iatt));
+                if (stub)
+                        list_add_tail (&stub->list, &io->wa_waiting);
 
-        done:
-                /* */
-                GF_FREE (mlocal->replies);
-                tmp_iobref = mlocal->iobref;
-                fd_unref (mlocal->fd);
-                STRIPE_STACK_UNWIND (readv, mframe, op_ret, op_errno, final_vec,
-                                     final_count, &tmp_stbuf, tmp_iobref);
+                iobref = io->wa_iobref;
+                offset = io->wa_offset;
+                count  = io->wa_count;
+                memcpy (vector, io->wa_vector, count * sizeof (*vector));
 
-                iobref_unref (tmp_iobref);
-                if (final_vec)
-                        GF_FREE (final_vec);
+                io->wa_iobref   = NULL;
+                io->wa_size     = 0;
+                io->wa_count    = 0;
+                io->wa_flushing = 1;
+                start = 1;
         }
+unlock:
+        UNLOCK (&io->lock);
 
-        goto out;
+        if (resume && stub)
+                call_resume (stub);
 
-check_size:
-        mlocal->call_count = fctx->stripe_count;
+        if (!start)
+                return;
 
-        for (index = 0; index < fctx->stripe_count; index++) {
-                STACK_WIND (mframe, stripe_readv_fstat_cbk,
-                            (fctx->xl_array[index]),
-                            (fctx->xl_array[index])->fops->fstat,
-                            mlocal->fd);
+        flush_frame = copy_frame (frame);
+        if (!flush_frame) {
+                iobref_unref (iobref);
+                stripe_wa_flush_done (this, fd, -1, ENOMEM);
+                return;
+        }
+
+        /* a frame of its own, the write which filled the buffer has
+           already been answered */
+        STACK_WIND_COOKIE (flush_frame, stripe_wa_flush_cbk, fd_ref (fd),
+                           this, this->fops->writev, fd, vector, count,
+                           offset, iobref);
+        iobref_unref (iobref);
+}
+
+/* Copies the write at the end of the buffer */
+static int
+__stripe_wa_append (xlator_t *this, stripe_fd_io_t *io, struct iovec *vector,
+                    int32_t count)
+{
+        struct iobuf *iobuf = NULL;
+        struct iovec *last = NULL;
+        size_t        page = 0;
+        size_t        chunk = 0;
+        size_t        done = 0;
+        int           i = 0;
+
+        page = iobpool_pagesize ((struct iobuf_pool *)this->ctx->iobuf_pool);
+
+        if (!io->wa_iobref) {
+                io->wa_iobref = iobref_new ();
+                if (!io->wa_iobref)
+                        return -1;
+        }
+
+        for (i = 0; i < count; i++) {
+                for (done = 0; done < vector[i].iov_len; done += chunk) {
+                        last = io->wa_count ?
+                                &io->wa_vector[io->wa_count - 1] : NULL;
+                        if (!last || (last->iov_len == page)) {
+                                if (io->wa_count == STRIPE_IOBREF_MAX_IOBUFS)
+                                        return -1;
+                                iobuf = iobuf_get (this->ctx->iobuf_pool);
+                                if (!iobuf)
+                                        return -1;
+                                iobref_add (io->wa_iobref, iobuf);
+                                iobuf_unref (iobuf);
+                                last = &io->wa_vector[io->wa_count++];
+                                last->iov_base = iobuf->ptr;
+                                last->iov_len  = 0;
+                        }
+
+                        chunk = min (vector[i].iov_len - done,
+                                     page - last->iov_len);
+                        memcpy ((char *)last->iov_base + last->iov_len,
+                                (char *)vector[i].iov_base + done, chunk);
+                        last->iov_len += chunk;
+                        io->wa_size   += chunk;
+                }
         }
 
-out:
-        STRIPE_STACK_DESTROY (frame);
-end:
         return 0;
 }
 
+/* the rest of the stripe did not come in time, or the fd got closed
+   without a flush: send the buffer down on a frame of our own */
+static void
+stripe_wa_timeout (void *data)
+{
+        xlator_t       *this = NULL;
+        stripe_fd_io_t *io = NULL;
+        call_frame_t   *frame = NULL;
+        gf_timer_t     *timer = NULL;
+        fd_t           *fd = NULL;
+
+        fd   = data;
+        this = THIS;
+
+        io = stripe_fd_io_get (this, fd);
+        if (!io)
+                goto out;
+
+        LOCK (&io->lock);
+        {
+                timer = io->wa_timer;
+                io->wa_timer = NULL;
+        }
+        UNLOCK (&io->lock);
+
+        if (timer)
+                gf_timer_call_cancel (this->ctx, timer);
+
+        frame = create_frame (this, this->ctx->pool);
+        if (!frame) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "out of memory, aggregated writes not sent");
+                goto out;
+        }
+
+        stripe_wa_flush (frame, this, fd, NULL);
+        STACK_DESTROY (frame->root);
+out:
+        fd_unref (fd);
+}
 
+/**
+ * stripe_writev - small sequential writes are buffered until the end of
+ *     the stripe they are in, so that the children see one write per
+ *     block instead of many tiny ones. Errors of the deferred write are
+ *     returned by the next write, fsync or flush on the fd.
+ */
 int32_t
-stripe_readv (call_frame_t *frame, xlator_t *this, fd_t *fd,
-              size_t size, off_t offset)
+stripe_writev (call_frame_t *frame, xlator_t *this, fd_t *fd,
+               struct iovec *vector, int32_t count, off_t offset,
+               struct iobref *iobref)
 {
-        int32_t           op_errno = EINVAL;
-        int32_t           idx = 0;
-        int32_t           index = 0;
-        int32_t           num_stripe = 0;
-        int32_t           off_index = 0;
-        size_t            frame_size = 0;
-        off_t             rounded_end = 0;
-        uint64_t          tmp_fctx = 0;
-        uint64_t          stripe_size = 0;
-        off_t             rounded_start = 0;
-        off_t             frame_offset = offset;
-        stripe_local_t   *local = NULL;
-        call_frame_t     *rframe = NULL;
-        stripe_local_t   *rlocal = NULL;
+        stripe_private_t *priv = NULL;
         stripe_fd_ctx_t  *fctx = NULL;
+        stripe_fd_io_t   *io = NULL;
+        call_stub_t      *stub = NULL;
+        struct iatt       prebuf = {0,};
+        struct iatt       postbuf = {0,};
+        struct timeval    timeout = {0,};
+        uint64_t          tmp_fctx = 0;
+        size_t            total_size = 0;
+        size_t            page = 0;
+        off_t             stripe_len = 0;
+        fd_t             *ref = NULL;
+        int32_t           op_errno = EINVAL;
+        int               buffered = 0;
+        int               full = 0;
 
         VALIDATE_OR_GOTO (frame, err);
         VALIDATE_OR_GOTO (this, err);
         VALIDATE_OR_GOTO (fd, err);
         VALIDATE_OR_GOTO (fd->inode, err);
 
-        fd_ctx_get (fd, this, &tmp_fctx);
-        if (!tmp_fctx) {
-                op_errno = EBADFD;
-                goto err;
+        priv = this->private;
+
+        /* the flush of a buffer goes down as is */
+        if (frame->ret == (ret_fn_t) stripe_wa_flush_cbk)
+                goto wind;
+
+        /* nor is a write buffered while another fd has some */
+        ref = stripe_wa_inode_fd (this, fd->inode, fd);
+        if (ref) {
+                stub = fop_writev_stub (frame, stripe_writev, fd, vector,
+                                        count, offset, iobref);
+                if (stripe_wa_wait (frame, this, ref, stub)) {
+                        op_errno = ENOMEM;
+                        goto err;
+                }
+                return 0;
         }
+
+        fd_ctx_get (fd, this, &tmp_fctx);
         fctx = (stripe_fd_ctx_t *)(long)tmp_fctx;
-        stripe_size = fctx->stripe_size;
+        if (!fctx || !fctx->io)
+                goto wind;
 
-        if (!stripe_size) {
-                gf_log (this->name, GF_LOG_DEBUG,
-                        "Wrong stripe size for the file");
-                goto err;
-        }
-        /* The file is stripe across the child nodes. Send the read request
-         * to the child nodes appropriately after checking which region of
-         * the file is in which child node. Always '0-<stripe_size>' part of
-         * the file resides in the first child.
-         */
-        rounded_start = floor (offset, stripe_size);
-        rounded_end = roof (offset+size, stripe_size);
-        num_stripe = (rounded_end- rounded_start)/stripe_size;
+        io = fctx->io;
+        total_size = iov_length (vector, count);
+        stripe_len = fctx->stripe_size * fctx->data_count;
+        page = iobpool_pagesize ((struct iobuf_pool *)this->ctx->iobuf_pool);
 
-        local = GF_CALLOC (1, sizeof (stripe_local_t),
-                           gf_stripe_mt_stripe_local_t);
-        if (!local) {
-                op_errno = ENOMEM;
-                goto err;
-        }
-        frame->local = local;
+        /* for the timer, should this write start a buffer */
+        if (priv->aggregate_writes)
+                ref = fd_ref (fd);
 
-        /* This is where all the vectors should be copied. */
-        local->replies = GF_CALLOC (num_stripe, sizeof (struct readv_replies),
-                                    gf_stripe_mt_readv_replies);
-        if (!local->replies) {
-                op_errno = ENOMEM;
-                goto err;
+        LOCK (&io->lock);
+        {
+                __stripe_ra_drop (io);
+
+                op_errno = io->wa_op_errno;
+                io->wa_op_errno = 0;
+                if (op_errno)
+                        goto unlock;
+
+                if (io->wa_flushing)
+                        goto unlock;
+
+                if (!io->wa_size) {
+                        /* buffered writes are answered with what the
+                           last write returned, until there is one they
+                           go down */
+                        if (!priv->aggregate_writes || !io->wa_stbuf_valid)
+                                goto unlock;
+                        io->wa_offset = offset;
+                        io->wa_limit  = min (roof (offset + 1, stripe_len) -
+                                             offset,
+                                             STRIPE_IOBREF_MAX_IOBUFS * page);
+                }
+
+                if (offset != io->wa_offset + io->wa_size)
+                        goto unlock;
+                /* a write which fills the stripe on its own goes as is */
+                if (io->wa_size ? (io->wa_size + total_size > io->wa_limit) :
+                    (total_size >= io->wa_limit))
+                        goto unlock;
+
+                if (__stripe_wa_append (this, io, vector, count)) {
+                        /* can't happen within wa_limit */
+                        op_errno = ENOMEM;
+                        goto unlock;
+                }
+                buffered = 1;
+                full = (io->wa_size == io->wa_limit);
+
+                prebuf  = io->wa_stbuf;
+                postbuf = io->wa_stbuf;
+                if (postbuf.ia_size < offset + total_size)
+                        postbuf.ia_size = offset + total_size;
+                io->wa_stbuf = postbuf;
+
+                /* the buffer must get down even if no other fop comes
+                   for the fd, nor a flush before it is released */
+                if (!full && !io->wa_timer) {
+                        timeout.tv_sec = STRIPE_WA_TIMEOUT;
+                        io->wa_timer = gf_timer_call_after (this->ctx,
+                                                            timeout,
+                                                            stripe_wa_timeout,
+                                                            ref);
+                        if (io->wa_timer)
+                                ref = NULL;
+                        else
+                                full = 1;
+                }
         }
+unlock:
+        UNLOCK (&io->lock);
 
-        off_index = (offset / stripe_size) % fctx->stripe_count;
-        local->wind_count = num_stripe;
-        local->readv_size = size;
-        local->offset     = offset;
-        local->fd         = fd_ref (fd);
-        local->fctx       = fctx;
+        if (ref)
+                fd_unref (ref);
 
-        for (index = off_index; index < (num_stripe + off_index); index++) {
-                rframe = copy_frame (frame);
-                rlocal = GF_CALLOC (1, sizeof (stripe_local_t),
-                                    gf_stripe_mt_stripe_local_t);
-                if (!rlocal) {
+        if (op_errno) {
+                STRIPE_STACK_UNWIND (writev, frame, -1, op_errno, NULL, NULL);
+                return 0;
+        }
+
+        if (buffered) {
+                if (full)
+                        stripe_wa_flush (frame, this, fd, NULL);
+                STRIPE_STACK_UNWIND (writev, frame, total_size, 0, &prebuf,
+                                     &postbuf);
+                return 0;
+        }
+
+        if (stripe_wa_pending (this, fd)) {
+                stub = fop_writev_stub (frame, stripe_writev, fd, vector,
+                                        count, offset, iobref);
+                if (!stub) {
                         op_errno = ENOMEM;
                         goto err;
                 }
+                stripe_wa_flush (frame, this, fd, stub);
+                return 0;
+        }
 
-                frame_size = min (roof (frame_offset+1, stripe_size),
-                                  (offset + size)) - frame_offset;
+wind:
+        return stripe_writev_blocks (frame, this, fd, vector, count, offset,
+                                     iobref);
+err:
+        STRIPE_STACK_UNWIND (writev, frame, -1, op_errno, NULL, NULL);
+        return 0;
+}
 
-                rlocal->node_index = index - off_index;
-                rlocal->orig_frame = frame;
-                rlocal->readv_size = frame_size;
-                rframe->local = rlocal;
-                idx = (index % fctx->stripe_count);
-                STACK_WIND (rframe, stripe_readv_cbk, fctx->xl_array[idx],
-                            fctx->xl_array[idx]->fops->readv,
-                            fd, frame_size, frame_offset);
+/* Serves the read from the read-ahead window, returns 0 if it can't */
+static int
+stripe_ra_serve (call_frame_t *frame, xlator_t *this, stripe_fd_io_t *io,
+                 size_t size, off_t offset)
+{
+        struct iovec  *vector = NULL;
+        struct iobref *iobref = NULL;
+        struct iatt    stbuf = {0,};
+        off_t          end = 0;
+        off_t          to = 0;
+        int32_t        count = 0;
+
+        LOCK (&io->lock);
+        {
+                end = io->ra_offset + io->ra_size;
+                if (!io->ra_iobref || (offset < io->ra_offset) ||
+                    ((offset + size > end) && !io->ra_eof))
+                        goto unlock;
 
-                frame_offset += frame_size;
+                to = min (offset + size, end);
+                if (offset > to)
+                        offset = to;
+
+                count  = iov_subset (io->ra_vector, io->ra_count,
+                                     offset - io->ra_offset,
+                                     to - io->ra_offset, NULL);
+                vector = GF_CALLOC (count + 1, sizeof (*vector),
+                                    gf_stripe_mt_iovec);
+                if (!vector)
+                        goto unlock;
+                count  = iov_subset (io->ra_vector, io->ra_count,
+                                     offset - io->ra_offset,
+                                     to - io->ra_offset, vector);
+                iobref = iobref_ref (io->ra_iobref);
+                stbuf  = io->ra_stbuf;
         }
+unlock:
+        UNLOCK (&io->lock);
 
-        return 0;
-err:
-        if (local && local->fd)
-                fd_unref (local->fd);
-        if (rframe)
-                STRIPE_STACK_DESTROY (rframe);
+        if (!iobref)
+                return 0;
 
-        STRIPE_STACK_UNWIND (readv, frame, -1, op_errno, NULL, 0, NULL, NULL);
-        return 0;
+        STRIPE_STACK_UNWIND (readv, frame, to - offset, 0, vector, count,
+                             &stbuf, iobref);
+        iobref_unref (iobref);
+        GF_FREE (vector);
+        return 1;
 }
 
-
 int32_t
-stripe_writev_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
-                   int32_t op_ret, int32_t op_errno, struct iatt *prebuf,
-                   struct iatt *postbuf)
+stripe_ra_fill_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                    int32_t op_ret, int32_t op_errno, struct iovec *vector,
+                    int32_t count, struct iatt *stbuf, struct iobref *iobref)
 {
-        int32_t         callcnt = 0;
         stripe_local_t *local = NULL;
-        call_frame_t   *prev = NULL;
+        stripe_fd_io_t *io = NULL;
+        struct iovec   *reply = NULL;
+        int32_t         reply_count = 0;
+        size_t          size = 0;
+        fd_t           *fd = NULL;
 
-        if (!this || !frame || !frame->local || !cookie) {
-                gf_log ("stripe", GF_LOG_DEBUG, "possible NULL deref");
-                goto out;
-        }
-
-        prev  = cookie;
         local = frame->local;
+        fd    = local->fd;
+        io    = stripe_fd_io_get (this, fd);
 
-        LOCK(&frame->lock);
+        LOCK (&io->lock);
         {
-                callcnt = ++local->call_count;
+                io->ra_filling = 0;
+                if ((op_ret < 0) || (io->ra_gen != local->gen))
+                        goto unlock;
 
-                if (op_ret == -1) {
-                        gf_log (this->name, GF_LOG_DEBUG,
-                                "%s returned error %s",
-                                prev->this->name, strerror (op_errno));
-                        local->op_errno = op_errno;
-                        local->op_ret = -1;
-                }
-                if (op_ret >= 0) {
-                        local->op_ret += op_ret;
-                        local->post_buf = *postbuf;
-                        local->pre_buf = *prebuf;
-                }
+                __stripe_ra_drop (io);
+                io->ra_vector = iov_dup (vector, count);
+                if (!io->ra_vector)
+                        goto unlock;
+                io->ra_iobref = iobref_ref (iobref);
+                io->ra_count  = count;
+                io->ra_offset = local->offset;
+                io->ra_size   = op_ret;
+                io->ra_eof    = (op_ret < local->stripe_size);
+                io->ra_stbuf  = *stbuf;
         }
-        UNLOCK (&frame->lock);
+unlock:
+        UNLOCK (&io->lock);
 
-        if ((callcnt == local->wind_count) && local->unwind) {
-                STRIPE_STACK_UNWIND (writev, frame, local->op_ret,
-                                     local->op_errno, &local->pre_buf,
-                                     &local->post_buf);
+        if (op_ret < 0) {
+                STRIPE_STACK_UNWIND (readv, frame, op_ret, op_errno, NULL, 0,
+                                     NULL, NULL);
+                goto out;
+        }
+
+        /* the caller gets the head of the window */
+        size = min (local->readv_size, op_ret);
+        reply_count = iov_subset (vector, count, 0, size, NULL);
+        reply = GF_CALLOC (reply_count + 1, sizeof (*reply),
+                           gf_stripe_mt_iovec);
+        if (!reply) {
+                STRIPE_STACK_UNWIND (readv, frame, -1, ENOMEM, NULL, 0,
+                                     NULL, NULL);
+                goto out;
         }
+        reply_count = iov_subset (vector, count, 0, size, reply);
+
+        STRIPE_STACK_UNWIND (readv, frame, size, 0, reply, reply_count,
+                             stbuf, iobref);
+        GF_FREE (reply);
 out:
+        fd_unref (fd);
         return 0;
 }
 
+/**
+ * stripe_readv - a sequential read which misses the read-ahead window
+ *     reads on up to the end of the next stripe, from all the children
+ *     in parallel. Reads which follow are answered from those replies
+ *     without copying the data.
+ */
 int32_t
-stripe_writev (call_frame_t *frame, xlator_t *this, fd_t *fd,
-               struct iovec *vector, int32_t count, off_t offset,
-               struct iobref *iobref)
+stripe_readv (call_frame_t *frame, xlator_t *this, fd_t *fd,
+              size_t size, off_t offset)
 {
-        struct iovec     *tmp_vec = NULL;
-        stripe_local_t   *local = NULL;
+        stripe_private_t *priv = NULL;
         stripe_fd_ctx_t  *fctx = NULL;
-        int32_t           op_errno = 1;
-        int32_t           idx = 0;
-        int32_t           total_size = 0;
-        int32_t           offset_offset = 0;
-        int32_t           remaining_size = 0;
-        int32_t           tmp_count = count;
-        off_t             fill_size = 0;
-        uint64_t          stripe_size = 0;
+        stripe_fd_io_t   *io = NULL;
+        stripe_local_t   *local = NULL;
+        call_stub_t      *stub = NULL;
+        fd_t             *wfd = NULL;
         uint64_t          tmp_fctx = 0;
+        uint64_t          gen = 0;
+        off_t             stripe_len = 0;
+        off_t             end = 0;
+        int32_t           op_errno = EINVAL;
+        int               sequential = 0;
 
         VALIDATE_OR_GOTO (frame, err);
         VALIDATE_OR_GOTO (this, err);
         VALIDATE_OR_GOTO (fd, err);
         VALIDATE_OR_GOTO (fd->inode, err);
 
-        fd_ctx_get (fd, this, &tmp_fctx);
-        if (!tmp_fctx) {
-                op_errno = EINVAL;
-                goto err;
-        }
-        fctx = (stripe_fd_ctx_t *)(long)tmp_fctx;
-        stripe_size = fctx->stripe_size;
+        priv = this->private;
 
-        /* File has to be stripped across the child nodes */
-        for (idx = 0; idx< count; idx ++) {
-                total_size += vector[idx].iov_len;
-        }
-        remaining_size = total_size;
+        /* the read filling the window has waited already */
+        if (frame->ret == (ret_fn_t) stripe_ra_fill_cbk)
+                goto wind;
 
-        local = GF_CALLOC (1, sizeof (stripe_local_t),
-                           gf_stripe_mt_stripe_local_t);
-        if (!local) {
-                op_errno = ENOMEM;
-                goto err;
+        wfd = stripe_wa_inode_fd (this, fd->inode, NULL);
+        if (wfd) {
+                stub = fop_readv_stub (frame, stripe_readv, fd, size, offset);
+                if (stripe_wa_wait (frame, this, wfd, stub)) {
+                        op_errno = ENOMEM;
+                        goto err;
+                }
+                return 0;
         }
-        frame->local = local;
-        local->stripe_size = stripe_size;
 
-        while (1) {
-                /* Send striped chunk of the vector to child
-                   nodes appropriately. */
-                idx = (((offset + offset_offset) /
-                        local->stripe_size) % fctx->stripe_count);
+        fd_ctx_get (fd, this, &tmp_fctx);
+        fctx = (stripe_fd_ctx_t *)(long)tmp_fctx;
+        if (!fctx || !fctx->io)
+                goto wind;
+        io = fctx->io;
 
-                fill_size = (local->stripe_size -
-                             ((offset + offset_offset) % local->stripe_size));
-                if (fill_size > remaining_size)
-                        fill_size = remaining_size;
+        if (!priv->read_ahead || !fctx->stripe_size)
+                goto wind;
 
-                remaining_size -= fill_size;
+        if (stripe_ra_serve (frame, this, io, size, offset))
+                return 0;
 
-                tmp_count = iov_subset (vector, count, offset_offset,
-                                        offset_offset + fill_size, NULL);
-                tmp_vec = GF_CALLOC (tmp_count, sizeof (struct iovec),
-                                     gf_stripe_mt_iovec);
-                if (!tmp_vec) {
-                        op_errno = ENOMEM;
-                        goto err;
+        /* window: through the end of the next stripe, as far as an
+           iobref can carry it */
+        stripe_len = fctx->stripe_size * fctx->data_count;
+        end = roof (offset + size, stripe_len) + stripe_len;
+        end = min (end, floor (offset, fctx->stripe_size) +
+                   (STRIPE_IOBREF_MAX_IOBUFS * fctx->stripe_size));
+
+        LOCK (&io->lock);
+        {
+                sequential = (offset == io->ra_next) && !io->ra_filling &&
+                        (end > offset + size);
+                io->ra_next = offset + size;
+                if (sequential) {
+                        io->ra_filling = 1;
+                        gen = io->ra_gen;
                 }
-                tmp_count = iov_subset (vector, count, offset_offset,
-                                        offset_offset + fill_size, tmp_vec);
+        }
+        UNLOCK (&io->lock);
 
-                local->wind_count++;
-                if (remaining_size == 0)
-                        local->unwind = 1;
+        if (!sequential)
+                goto wind;
 
-                STACK_WIND (frame, stripe_writev_cbk, fctx->xl_array[idx],
-                            fctx->xl_array[idx]->fops->writev, fd, tmp_vec,
-                            tmp_count, offset + offset_offset, iobref);
-                GF_FREE (tmp_vec);
-                offset_offset += fill_size;
-                if (remaining_size == 0)
-                        break;
+        local = GF_CALLOC (1, sizeof (stripe_local_t),
+                           gf_stripe_mt_stripe_local_t);
+        if (!local) {
+                LOCK (&io->lock);
+                {
+                        io->ra_filling = 0;
+                }
+                UNLOCK (&io->lock);
+                goto wind;
         }
+        frame->local      = local;
+        local->fd         = fd_ref (fd);
+        local->offset     = offset;
+        local->readv_size = size;
+        local->stripe_size = end - offset; /* size of the window */
+        local->gen        = gen;
 
+        STACK_WIND (frame, stripe_ra_fill_cbk, this, this->fops->readv,
+                    fd, end - offset, offset);
         return 0;
+
+wind:
+        return stripe_readv_blocks (frame, this, fd, size, offset);
 err:
-        STRIPE_STACK_UNWIND (writev, frame, -1, op_errno, NULL, NULL);
+        STRIPE_STACK_UNWIND (readv, frame, -1, op_errno, NULL, 0, NULL, NULL);
         return 0;
 }
 
@@ -3551,6 +5960,9 @@ stripe_release (xlator_t *this, fd_t *fd)
 
         fctx = (stripe_fd_ctx_t *)(long)tmp_fctx;
 
+        if (fctx->io)
+                stripe_fd_io_free (this, fctx->io);
+
         if (!fctx->static_array)
                 GF_FREE (fctx->xl_array);
 
@@ -3700,6 +6112,58 @@ out:
         return ret;
 }
 
+int
+set_stripe_redundancy (xlator_t *this, stripe_private_t *priv, char *data)
+{
+        int32_t redundancy = 0;
+
+        if ((gf_string2int32 (data, &redundancy) != 0) ||
+            (redundancy < 0) || (redundancy >= priv->child_count)) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "invalid redundancy \"%s\", has to be less than the "
+                        "number of subvolumes (%d)", data, priv->child_count);
+                return -1;
+        }
+
+        if (redundancy && !priv->xattr_supported) {
+                gf_log (this->name, GF_LOG_WARNING,
+                        "redundancy needs \"use-xattr\", files will be "
+                        "created without parity");
+                redundancy = 0;
+        }
+
+        if (redundancy)
+                gf_log (this->name, GF_LOG_INFO,
+                        "new files get %d data and %d parity fragments per "
+                        "stripe (%s coding)", priv->child_count - redundancy,
+                        redundancy, stripe_ec_impl ());
+
+        priv->redundancy = redundancy;
+        return 0;
+}
+
+int
+set_stripe_coalesce (xlator_t *this, stripe_private_t *priv, char *data)
+{
+        gf_boolean_t coalesce = _gf_false;
+
+        if (gf_string2boolean (data, &coalesce) == -1) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "\"coalesce\" takes a boolean, \"%s\" given", data);
+                return -1;
+        }
+
+        if (coalesce && !priv->xattr_supported) {
+                gf_log (this->name, GF_LOG_WARNING,
+                        "coalesce needs \"use-xattr\", files will be "
+                        "created sparse");
+                coalesce = _gf_false;
+        }
+
+        priv->coalesce = coalesce;
+        return 0;
+}
+
 int32_t
 mem_acct_init (xlator_t *this)
 {
@@ -3752,6 +6216,18 @@ validate_options (xlator_t *this, dict_t *options, char **op_errstr)
                         "Reconfigue: Block-Size reconfigured Successfully");
         }
 
+        data = dict_get (options, "redundancy");
+        if (data) {
+                int32_t redundancy = 0;
+
+                if ((gf_string2int32 (data->data, &redundancy) != 0) ||
+                    (redundancy < 0)) {
+                        *op_errstr = gf_strdup ("Error, invalid redundancy");
+                        ret = -1;
+                        goto out;
+                }
+        }
+
 out:
                 if (priv)
                 GF_FREE (priv);
@@ -3787,7 +6263,47 @@ reconfigure (xlator_t *this, dict_t *options)
         else {
                 priv->block_size = (128 * GF_UNIT_KB);
         }
-                        
+
+        data = dict_get (options, "redundancy");
+        if (data) {
+                ret = set_stripe_redundancy (this, priv, data->data);
+                if (ret)
+                        goto out;
+        } else {
+                priv->redundancy = 0;
+        }
+
+        data = dict_get (options, "coalesce");
+        if (data) {
+                ret = set_stripe_coalesce (this, priv, data->data);
+                if (ret)
+                        goto out;
+        } else {
+                priv->coalesce = _gf_false;
+        }
+
+        /* only fds opened from now on see the change */
+        priv->aggregate_writes = _gf_false;
+        data = dict_get (options, "aggregate-writes");
+        if (data && (gf_string2boolean (data->data,
+                                        &priv->aggregate_writes) == -1)) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "Reconfigure: invalid aggregate-writes \"%s\"",
+                        data->data);
+                ret = -1;
+                goto out;
+        }
+
+        priv->read_ahead = _gf_true;
+        data = dict_get (options, "read-ahead");
+        if (data && (gf_string2boolean (data->data,
+                                        &priv->read_ahead) == -1)) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "Reconfigure: invalid read-ahead \"%s\"",
+                        data->data);
+                ret = -1;
+                goto out;
+        }
 
 out:
 	return ret;
@@ -3893,6 +6409,53 @@ init (xlator_t *this)
                 }
         }
 
+        /* option redundancy 2 : Reed-Solomon parity on the last two
+           subvolumes, for files created from now on */
+        stripe_ec_init ();
+        data = dict_get (this->options, "redundancy");
+        if (data) {
+                ret = set_stripe_redundancy (this, priv, data->data);
+                if (ret)
+                        goto out;
+        }
+
+        /* option coalesce on : new files get a dense layout on the
+           subvolumes, told apart by an xattr */
+        priv->coalesce = _gf_false;
+        data = dict_get (this->options, "coalesce");
+        if (data) {
+                ret = set_stripe_coalesce (this, priv, data->data);
+                if (ret)
+                        goto out;
+        }
+
+        /* write-behind above usually does the aggregation already */
+        priv->aggregate_writes = _gf_false;
+        data = dict_get (this->options, "aggregate-writes");
+        if (data) {
+                if (gf_string2boolean (data->data,
+                                       &priv->aggregate_writes) == -1) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "\"aggregate-writes\" takes a boolean, "
+                                "\"%s\" given", data->data);
+                        ret = -1;
+                        goto out;
+                }
+        }
+
+        priv->read_ahead = _gf_true;
+        data = dict_get (this->options, "read-ahead");
+        if (data) {
+                if (gf_string2boolean (data->data,
+                                       &priv->read_ahead) == -1) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "\"read-ahead\" takes a boolean, "
+                                "\"%s\" given", data->data);
+                        ret = -1;
+                        goto out;
+                }
+        }
+
         /* notify related */
         priv->nodes_down = priv->child_count;
         this->private = priv;
@@ -4009,6 +6572,26 @@ stripe_getxattr (call_frame_t *frame, xlator_t *this,
                 return 0;
         }
 
+        if (name && (strcmp (name, QUOTA_SIZE_KEY) == 0)) {
+                local->marker.call_count = priv->child_count;
+
+                sub_volumes = alloca (priv->child_count *
+                                      sizeof (xlator_t *));
+                for (i = 0, trav = this->children; trav;
+                     trav = trav->next, i++)
+                        sub_volumes[i] = trav->xlator;
+
+                if (cluster_getmarkerattr (frame, this, loc, name,
+                                           local, stripe_getxattr_unwind,
+                                           sub_volumes, priv->child_count,
+                                           MARKER_QUOTA_TYPE,
+                                           priv->vol_uuid)) {
+                        op_errno = EINVAL;
+                        goto err;
+                }
+                return 0;
+        }
+
         if (*priv->vol_uuid) {
                 if ((match_uuid_local (name, priv->vol_uuid) == 0)
                     && (-1 == frame->root->pid)) {
@@ -4079,6 +6662,7 @@ struct xlator_fops fops = {
 
 struct xlator_cbks cbks = {
         .release = stripe_release,
+        .forget  = stripe_forget,
 };
 
 
@@ -4089,5 +6673,38 @@ struct volume_options options[] = {
         { .key  = {"use-xattr"},
           .type = GF_OPTION_TYPE_BOOL
         },
+        { .key  = {"redundancy"},
+          .type = GF_OPTION_TYPE_INT,
+          .min  = 0,
+          .max  = STRIPE_EC_MAX_FRAGMENTS - 1,
+          .description = "Number of subvolumes holding Reed-Solomon parity "
+                         "of each stripe for newly created files. Any "
+                         "'redundancy' subvolumes can be lost without losing "
+                         "data; 0 is plain striping. Parity updates lock "
+                         "their stripes on the first parity subvolume, and "
+                         "need it up. A client dying between a write and "
+                         "its parity update leaves that parity stale until "
+                         "the stripe is written again."
+        },
+        { .key  = {"coalesce"},
+          .type = GF_OPTION_TYPE_BOOL,
+          .description = "Store the blocks of newly created files back to "
+                         "back on each subvolume, instead of at their "
+                         "offset in the file with holes in between. Files "
+                         "keep the layout they were created with."
+        },
+        { .key  = {"aggregate-writes"},
+          .type = GF_OPTION_TYPE_BOOL,
+          .description = "Buffer small sequential writes on an fd until "
+                         "they fill the rest of the stripe, for a second at "
+                         "most, and send them down as one write. Errors are "
+                         "reported by the next write, flush or fsync."
+        },
+        { .key  = {"read-ahead"},
+          .type = GF_OPTION_TYPE_BOOL,
+          .description = "On sequential reads, read up to the end of the "
+                         "next stripe from all subvolumes in parallel and "
+                         "answer the following reads from it."
+        },
         { .key  = {NULL} },
 };
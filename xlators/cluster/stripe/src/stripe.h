@@ -34,6 +34,9 @@
 #include "compat-errno.h"
 #include "stripe-mem-types.h"
 #include "libxlator.h"
+#include "call-stub.h"
+#include "timer.h"
+#include "stripe-ec.h"
 #include <fnmatch.h>
 #include <signal.h>
 
@@ -51,6 +54,13 @@
                 }                                               \
         } while (0)
 
+/* an iobref holds at most this many iobufs, which bounds how much data
+   one aggregated write or read-ahead window can carry */
+#define STRIPE_IOBREF_MAX_IOBUFS 8
+
+/* seconds aggregated writes wait at most for the rest of their stripe */
+#define STRIPE_WA_TIMEOUT 1
+
 #define STRIPE_STACK_DESTROY(frame) do {                  \
                 stripe_local_t *__local = NULL;           \
                 __local = frame->local;                   \
@@ -84,7 +94,11 @@ struct stripe_private {
         int8_t                  first_child_down;
         int8_t                  child_count;
         int8_t                 *state; /* Current state of child node */
+        int8_t                  redundancy; /* parity fragments of new files */
         gf_boolean_t            xattr_supported;  /* default yes */
+        gf_boolean_t            coalesce;         /* default no */
+        gf_boolean_t            aggregate_writes; /* default no */
+        gf_boolean_t            read_ahead;       /* default yes */
         char                    vol_uuid[UUID_SIZE + 1];
 };
 
@@ -100,13 +114,104 @@ struct readv_replies {
         struct iatt   stbuf;    /* 'stbuf' is also a part of reply */
 };
 
+/**
+ * Per fd state of write aggregation and stripe-wide read-ahead.
+ * Sequential writes are buffered until they reach the end of a stripe,
+ * then go down as one write spanning all the data children. Sequential
+ * reads fetch up to the end of the next stripe from all the children in
+ * parallel, and the following reads are served from those replies.
+ */
+typedef struct _stripe_fd_io {
+        gf_lock_t          lock;
+
+        off_t              wa_offset;
+        size_t             wa_size;
+        size_t             wa_limit;    /* flushed once wa_size gets here */
+        struct iobref     *wa_iobref;
+        struct iovec       wa_vector[STRIPE_IOBREF_MAX_IOBUFS];
+        int                wa_count;
+        int                wa_flushing;
+        int32_t            wa_op_errno; /* of a failed flush, returned by
+                                           the next write, fsync or flush */
+        struct list_head   wa_waiting;  /* fops held until the flush ends */
+        gf_timer_t        *wa_timer;    /* sends down a buffer which no fop
+                                           flushes, holds a ref on the fd */
+        struct iatt        wa_stbuf;    /* last known, answers buffered
+                                           writes */
+        int                wa_stbuf_valid;
+
+        off_t              ra_offset;
+        size_t             ra_size;
+        int                ra_eof;
+        struct iobref     *ra_iobref;
+        struct iovec      *ra_vector;
+        int                ra_count;
+        struct iatt        ra_stbuf;
+        off_t              ra_next;     /* offset a sequential read has */
+        int                ra_filling;
+        uint64_t           ra_gen;      /* bumped whenever data changes */
+} stripe_fd_io_t;
+
 typedef struct _stripe_fd_ctx {
         off_t      stripe_size;
         int        stripe_count;
         int        static_array;
         xlator_t **xl_array;
+        int        redundancy;  /* parity fragments, 0 for plain stripe */
+        int        data_count;  /* stripe_count - redundancy */
+        int        coalesce;    /* blocks packed on the subvolumes */
+        stripe_fd_io_t *io;     /* NULL unless aggregating or reading ahead */
 } stripe_fd_ctx_t;
 
+/**
+ * Erasure coded files keep the data on the first 'data_count' children,
+ * laid out exactly like a plain striped file, and the parity of each
+ * stripe (data_count blocks) on the remaining children, at the offset
+ * where the stripe begins. Parity updates of an inode are serialized.
+ *
+ * Coalesced files (trusted.<name>.stripe-coalesce) store the blocks of
+ * each child back to back instead of at their offset in the file, so
+ * block 'n' of a child is at 'n * stripe_size' in its file. The inode
+ * remembers the layout of such a file, the sizes the children report
+ * have to be mapped back to the size of the whole file.
+ */
+typedef struct _stripe_inode_ctx {
+        gf_lock_t          lock;
+        int                busy;
+        struct list_head   waiting;
+
+        int                coalesce;
+        off_t              stripe_size;
+        int                data_count;
+} stripe_inode_ctx_t;
+
+/**
+ * State of one degraded readv or parity update, which walks the affected
+ * stripes one at a time.
+ */
+struct stripe_ec_io {
+        struct list_head   list;      /* waiting for the inode */
+        call_frame_t      *frame;
+        int                fop;       /* GF_FOP_READ, WRITE or FTRUNCATE */
+        off_t              stripe;    /* offset of the stripe in flight */
+        off_t              end;       /* end of the range to cover */
+        off_t              size;      /* file size seen by the fetch */
+        int                call_count;
+        int                failed;
+        int32_t            op_errno;
+        int32_t            error;     /* errno the fop fails with, if any */
+        char               locked;    /* holds the inodelk below */
+        struct gf_flock    flock;
+        char               size_stored;
+        char              *buf;       /* (data + parity) * stripe_size */
+        int32_t           *len;       /* bytes read per fragment, -1 if bad */
+        struct iobref     *iobref;
+        struct iovec      *vector;    /* degraded readv reply */
+        int32_t            count;
+        int32_t            max_count;
+        size_t             done;
+};
+
 
 /**
  * Local structure to be passed with all the frames in case of STACK_WIND
@@ -118,6 +223,7 @@ struct stripe_local {
         call_frame_t        *orig_frame;
 
         stripe_fd_ctx_t     *fctx;
+        stripe_inode_ctx_t  *ictx;  /* layout of a coalesced file */
 
         /* Used by _cbk functions */
         struct iatt          stbuf;
@@ -170,6 +276,7 @@ struct stripe_local {
         /* General usage */
         off_t                offset;
         off_t                stripe_size;
+        uint64_t             gen;   /* read-ahead generation at wind */
 
         int xattr_self_heal_needed;
         int entry_self_heal_needed;
@@ -179,6 +286,7 @@ struct stripe_local {
         fd_t                *fd;
         void                *value;
         struct iobref       *iobref;
+        struct stripe_ec_io *ec;
 };
 
 typedef struct stripe_local   stripe_local_t;
@@ -0,0 +1,332 @@
+/*
+   Copyright (c) 2010 Gluster, Inc. <http://www.gluster.com>
+   This file is part of GlusterFS.
+
+   GlusterFS is free software; you can redistribute it and/or modify
+   it under the terms of the GNU Affero General Public License as published
+   by the Free Software Foundation; either version 3 of the License,
+   or (at your option) any later version.
+
+   GlusterFS is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Affero General Public License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with this program.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "gf-changelog.h"
+
+struct gf_changelog {
+        unsigned char *map;
+        size_t         size;
+        size_t         offset;
+        uint64_t       start;
+        uint64_t       end;
+        uint32_t       flags;
+};
+
+static inline uint16_t
+get_be16 (const unsigned char *p)
+{
+        return ((uint16_t)p[0] << 8) | p[1];
+}
+
+static inline uint32_t
+get_be32 (const unsigned char *p)
+{
+        return ((uint32_t)get_be16 (p) << 16) | get_be16 (p + 2);
+}
+
+static inline uint64_t
+get_be64 (const unsigned char *p)
+{
+        return ((uint64_t)get_be32 (p) << 32) | get_be32 (p + 4);
+}
+
+/* reads the header at 'p', returns -1 if it is not one */
+static int
+gf_changelog_parse_header (const unsigned char *p, uint64_t *start,
+                           uint64_t *end, uint32_t *flags)
+{
+        if (memcmp (p, GF_CHANGELOG_MAGIC, sizeof (GF_CHANGELOG_MAGIC)) ||
+            (get_be32 (p + 8) != GF_CHANGELOG_VERSION))
+                return -1;
+
+        *flags = get_be32 (p + 12);
+        *start = get_be64 (p + 16);
+        *end   = get_be64 (p + 24);
+
+        return 0;
+}
+
+gf_changelog_t *
+gf_changelog_open (const char *path)
+{
+        gf_changelog_t *log = NULL;
+        struct stat     stbuf;
+        int             fd = -1;
+        int             saved_errno = 0;
+
+        fd = open (path, O_RDONLY);
+        if (fd == -1)
+                return NULL;
+
+        if (fstat (fd, &stbuf) == -1)
+                goto err;
+
+        if (stbuf.st_size < GF_CHANGELOG_HEADER_SIZE) {
+                errno = EINVAL;
+                goto err;
+        }
+
+        log = calloc (1, sizeof (*log));
+        if (!log)
+                goto err;
+
+        log->size = stbuf.st_size;
+        log->map  = mmap (NULL, log->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (log->map == MAP_FAILED) {
+                log->map = NULL;
+                goto err;
+        }
+
+        if (gf_changelog_parse_header (log->map, &log->start, &log->end,
+                                       &log->flags)) {
+                errno = EINVAL;
+                goto err;
+        }
+
+        madvise (log->map, log->size, MADV_SEQUENTIAL);
+        log->offset = GF_CHANGELOG_HEADER_SIZE;
+
+        close (fd);
+        return log;
+
+err:
+        saved_errno = errno;
+        if (log) {
+                if (log->map)
+                        munmap (log->map, log->size);
+                free (log);
+        }
+        close (fd);
+        errno = saved_errno;
+
+        return NULL;
+}
+
+void
+gf_changelog_close (gf_changelog_t *log)
+{
+        if (!log)
+                return;
+
+        munmap (log->map, log->size);
+        free (log);
+}
+
+uint64_t
+gf_changelog_start (gf_changelog_t *log)
+{
+        return log->start;
+}
+
+uint64_t
+gf_changelog_end (gf_changelog_t *log)
+{
+        return log->end;
+}
+
+int
+gf_changelog_complete (gf_changelog_t *log)
+{
+        return !!(log->flags & GF_CHANGELOG_COMPLETE);
+}
+
+int
+gf_changelog_next (gf_changelog_t *log, struct gf_changelog_record *record)
+{
+        const unsigned char *p     = NULL;
+        size_t               size  = 0;
+        size_t               used  = 0;
+        size_t               left  = 0;
+        int                  i     = 0;
+
+        left = log->size - log->offset;
+        if (!left)
+                return 0;
+
+        p = log->map + log->offset;
+        if (left < GF_CHANGELOG_RECORD_MIN)
+                goto bad;
+
+        size = get_be16 (p);
+        if ((size < GF_CHANGELOG_RECORD_MIN) || (size > left) || (size % 4))
+                goto bad;
+
+        memset (record, 0, sizeof (*record));
+        record->fop      = p[2];
+        record->type     = p[3] & 0x3;
+        record->nentries = p[3] >> 2;
+        record->gfid     = p + 4;
+
+        if (record->nentries > GF_CHANGELOG_MAX_ENTRIES)
+                goto bad;
+
+        used = GF_CHANGELOG_RECORD_MIN;
+        for (i = 0; i < record->nentries; i++) {
+                if (used + 18 > size)
+                        goto bad;
+                record->entries[i].pargfid = p + used;
+                record->entries[i].namelen = get_be16 (p + used + 16);
+                record->entries[i].name    = (const char *)(p + used + 18);
+                used += 18 + record->entries[i].namelen;
+                if (used > size)
+                        goto bad;
+        }
+
+        log->offset += size;
+        return 1;
+
+bad:
+        /* the tail of a file cut short by a crash is not an error */
+        if (!gf_changelog_complete (log)) {
+                log->offset = log->size;
+                return 0;
+        }
+        return -1;
+}
+
+struct gf_changelog_file {
+        uint64_t  start;
+        char     *path;
+};
+
+static int
+gf_changelog_file_cmp (const void *a, const void *b)
+{
+        const struct gf_changelog_file *fa = a;
+        const struct gf_changelog_file *fb = b;
+
+        if (fa->start == fb->start)
+                return 0;
+        return (fa->start < fb->start) ? -1 : 1;
+}
+
+int
+gf_changelog_scan (const char *dir, uint64_t since, char ***paths)
+{
+        struct gf_changelog_file *files = NULL;
+        struct gf_changelog_file *tmp   = NULL;
+        unsigned char             header[GF_CHANGELOG_HEADER_SIZE];
+        struct dirent            *entry = NULL;
+        DIR                      *dp    = NULL;
+        char                     *path  = NULL;
+        char                     *end   = NULL;
+        char                    **ret   = NULL;
+        uint64_t                  start = 0;
+        uint64_t                  stop  = 0;
+        uint32_t                  flags = 0;
+        int                       count = 0;
+        int                       alloc = 0;
+        int                       fd    = -1;
+        int                       i     = 0;
+        int                       saved_errno = 0;
+
+        dp = opendir (dir);
+        if (!dp)
+                return -1;
+
+        while ((entry = readdir (dp))) {
+                if (strncmp (entry->d_name, GF_CHANGELOG_CURRENT ".",
+                             sizeof (GF_CHANGELOG_CURRENT)))
+                        continue;
+                strtoull (entry->d_name + sizeof (GF_CHANGELOG_CURRENT),
+                          &end, 10);
+                if (*end)
+                        continue;
+
+                if (asprintf (&path, "%s/%s", dir, entry->d_name) < 0)
+                        goto err;
+
+                fd = open (path, O_RDONLY);
+                if ((fd == -1) ||
+                    (pread (fd, header, sizeof (header), 0) !=
+                     sizeof (header)) ||
+                    gf_changelog_parse_header (header, &start, &stop,
+                                               &flags) ||
+                    (stop <= since)) {
+                        if (fd != -1)
+                                close (fd);
+                        free (path);
+                        continue;
+                }
+                close (fd);
+
+                if (count == alloc) {
+                        alloc = alloc ? alloc * 2 : 64;
+                        tmp = realloc (files, alloc * sizeof (*files));
+                        if (!tmp) {
+                                free (path);
+                                goto err;
+                        }
+                        files = tmp;
+                }
+                files[count].start = start;
+                files[count].path  = path;
+                count++;
+        }
+
+        closedir (dp);
+        dp = NULL;
+
+        ret = calloc (count + 1, sizeof (*ret));
+        if (!ret)
+                goto err;
+
+        qsort (files, count, sizeof (*files), gf_changelog_file_cmp);
+        for (i = 0; i < count; i++)
+                ret[i] = files[i].path;
+
+        free (files);
+        *paths = ret;
+
+        return count;
+
+err:
+        saved_errno = errno;
+        if (dp)
+                closedir (dp);
+        for (i = 0; i < count; i++)
+                free (files[i].path);
+        free (files);
+        errno = saved_errno;
+
+        return -1;
+}
+
+void
+gf_changelog_scan_free (char **paths)
+{
+        int i = 0;
+
+        if (!paths)
+                return;
+
+        for (i = 0; paths[i]; i++)
+                free (paths[i]);
+        free (paths);
+}
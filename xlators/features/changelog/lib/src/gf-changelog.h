@@ -0,0 +1,120 @@
+/*
+   Copyright (c) 2010 Gluster, Inc. <http://www.gluster.com>
+   This file is part of GlusterFS.
+
+   GlusterFS is free software; you can redistribute it and/or modify
+   it under the terms of the GNU Affero General Public License as published
+   by the Free Software Foundation; either version 3 of the License,
+   or (at your option) any later version.
+
+   GlusterFS is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Affero General Public License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with this program.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _GF_CHANGELOG_H_
+#define _GF_CHANGELOG_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Changelog journal of a brick, as written by features/changelog.
+ *
+ * The journal is a directory of files. The one being written is named
+ * "CHANGELOG"; every rollover-time seconds (and only when something was
+ * recorded) it is closed and renamed to "CHANGELOG.<start>", <start> being
+ * the time it was opened, in seconds since the epoch. A rolled over file
+ * never changes again and can be mapped as a whole.
+ *
+ * A file starts with a GF_CHANGELOG_HEADER_SIZE bytes header:
+ *
+ *      char     magic[8]       GF_CHANGELOG_MAGIC
+ *      uint32_t version        GF_CHANGELOG_VERSION
+ *      uint32_t flags          GF_CHANGELOG_COMPLETE
+ *      uint64_t start          seconds, the changes recorded happened
+ *      uint64_t end              between 'start' and 'end'
+ *
+ * followed by records, each padded to a multiple of 4 bytes:
+ *
+ *      uint16_t size           of the record, padding included
+ *      uint8_t  fop            GF_FOP_* of glusterfs.h
+ *      uint8_t  flags          type | (number of entries << 2)
+ *      uint8_t  gfid[16]
+ *
+ * and per entry (creates and removals have one, renames two: the new name
+ * first, then the old one):
+ *
+ *      uint8_t  pargfid[16]
+ *      uint16_t namelen
+ *      char     name[namelen]  not NUL terminated
+ *
+ * All integers are big endian. Data and metadata changes of a file are
+ * recorded once per file and per journal file, not once per fop.
+ *
+ * A file without GF_CHANGELOG_COMPLETE was found still open when the
+ * brick started: the brick went down uncleanly and the file may lack the
+ * last changes before the crash, a consumer has to fall back to a crawl
+ * for the interval it covers.
+ */
+
+#define GF_CHANGELOG_MAGIC              "GFCHLOG"
+#define GF_CHANGELOG_VERSION            1
+#define GF_CHANGELOG_HEADER_SIZE        32
+#define GF_CHANGELOG_RECORD_MIN         20
+
+#define GF_CHANGELOG_CURRENT            "CHANGELOG"
+
+#define GF_CHANGELOG_COMPLETE           0x1
+
+#define GF_CHANGELOG_TYPE_ENTRY         0
+#define GF_CHANGELOG_TYPE_DATA          1
+#define GF_CHANGELOG_TYPE_METADATA      2
+
+#define GF_CHANGELOG_MAX_ENTRIES        2
+
+struct gf_changelog_entry {
+        const unsigned char *pargfid;
+        const char          *name;
+        size_t               namelen;
+};
+
+struct gf_changelog_record {
+        int                        fop;
+        int                        type;
+        const unsigned char       *gfid;
+        int                        nentries;
+        struct gf_changelog_entry  entries[GF_CHANGELOG_MAX_ENTRIES];
+};
+
+typedef struct gf_changelog gf_changelog_t;
+
+/* Maps a rolled over journal file. Returns NULL with errno set. */
+gf_changelog_t *gf_changelog_open (const char *path);
+
+void gf_changelog_close (gf_changelog_t *log);
+
+uint64_t gf_changelog_start (gf_changelog_t *log);
+uint64_t gf_changelog_end (gf_changelog_t *log);
+int gf_changelog_complete (gf_changelog_t *log);
+
+/* Fills 'record' with the next record, its pointers point into the
+   mapping and stay valid until the file is closed. Returns 1, 0 at the
+   end of the file, -1 if the file is corrupt. */
+int gf_changelog_next (gf_changelog_t *log,
+                       struct gf_changelog_record *record);
+
+/* Paths of the rolled over files of journal directory 'dir' with changes
+   later than 'since', oldest first, in a NULL terminated array to be
+   released with gf_changelog_scan_free(). Returns the number of paths, or
+   -1 with errno set. */
+int gf_changelog_scan (const char *dir, uint64_t since, char ***paths);
+
+void gf_changelog_scan_free (char **paths);
+
+#endif /* _GF_CHANGELOG_H_ */
@@ -0,0 +1,1198 @@
+/*
+   Copyright (c) 2010 Gluster, Inc. <http://www.gluster.com>
+   This file is part of GlusterFS.
+
+   GlusterFS is free software; you can redistribute it and/or modify
+   it under the terms of the GNU Affero General Public License as published
+   by the Free Software Foundation; either version 3 of the License,
+   or (at your option) any later version.
+
+   GlusterFS is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Affero General Public License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with this program.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _CONFIG_H
+#define _CONFIG_H
+#include "config.h"
+#endif
+
+#include <fcntl.h>
+#include <sys/time.h>
+
+#include "glusterfs.h"
+#include "xlator.h"
+#include "defaults.h"
+#include "logging.h"
+#include "changelog.h"
+
+void
+fini (xlator_t *this);
+
+/* Journal of the namespace and data changes of a brick, meant to sit right
+ * above storage/posix. Every successful creation, removal and rename gets a
+ * record with the gfid of the inode and the parent gfid and name of the
+ * entry; the first data and the first metadata change of an inode in every
+ * journal file get one too. Records are put in a buffer which is written
+ * to GF_CHANGELOG_CURRENT when full, and every 'rollover-time' seconds the
+ * file is completed and renamed out of the way for consumers, see
+ * gf-changelog.h for the format and the consumer API.
+ */
+
+static inline unsigned char *
+put_be16 (unsigned char *p, uint16_t v)
+{
+        p[0] = v >> 8;
+        p[1] = v;
+        return p + 2;
+}
+
+static inline unsigned char *
+put_be32 (unsigned char *p, uint32_t v)
+{
+        put_be16 (p, v >> 16);
+        return put_be16 (p + 2, v);
+}
+
+static inline unsigned char *
+put_be64 (unsigned char *p, uint64_t v)
+{
+        put_be32 (p, v >> 32);
+        return put_be32 (p + 4, v);
+}
+
+static void
+changelog_encode_header (unsigned char *p, uint32_t flags, uint64_t start,
+                         uint64_t end)
+{
+        memset (p, 0, GF_CHANGELOG_HEADER_SIZE);
+        memcpy (p, GF_CHANGELOG_MAGIC, sizeof (GF_CHANGELOG_MAGIC));
+        p = put_be32 (p + 8, GF_CHANGELOG_VERSION);
+        p = put_be32 (p, flags);
+        p = put_be64 (p, start);
+        put_be64 (p, end);
+}
+
+static int
+changelog_write (int fd, const void *buf, size_t len, off_t offset)
+{
+        ssize_t ret = 0;
+
+        while (len) {
+                ret = pwrite (fd, buf, len, offset);
+                if (ret == -1) {
+                        if (errno == EINTR)
+                                continue;
+                        return -1;
+                }
+                buf     = (const char *)buf + ret;
+                len    -= ret;
+                offset += ret;
+        }
+
+        return 0;
+}
+
+static void
+__changelog_flush_buf (xlator_t *this)
+{
+        changelog_priv_t *priv = NULL;
+
+        priv = this->private;
+
+        if (!priv->buf_used)
+                return;
+
+        if ((priv->fd == -1) ||
+            changelog_write (priv->fd, priv->buf, priv->buf_used,
+                             priv->offset)) {
+                if (!priv->error)
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "failed to write the journal (%s), records "
+                                "are lost until the next rollover",
+                                strerror (errno));
+                priv->error = 1;
+        } else {
+                priv->offset += priv->buf_used;
+        }
+
+        priv->buf_used = 0;
+}
+
+static void
+__changelog_seen_clear (changelog_priv_t *priv)
+{
+        changelog_seen_t *seen = NULL;
+        changelog_seen_t *tmp  = NULL;
+        int               i    = 0;
+
+        for (i = 0; i < CHANGELOG_SEEN_HASH_SIZE; i++) {
+                list_for_each_entry_safe (seen, tmp, &priv->seen[i], hash) {
+                        list_del (&seen->hash);
+                        GF_FREE (seen);
+                }
+        }
+}
+
+/* returns 1 if 'gfid' already has a record of 'type' in the current file */
+static int
+__changelog_seen (changelog_priv_t *priv, uuid_t gfid, int type)
+{
+        changelog_seen_t *seen   = NULL;
+        struct list_head *bucket = NULL;
+
+        bucket = &priv->seen[(gfid[15] | (gfid[14] << 8))
+                             % CHANGELOG_SEEN_HASH_SIZE];
+
+        list_for_each_entry (seen, bucket, hash) {
+                if ((seen->type == type) &&
+                    (uuid_compare (seen->gfid, gfid) == 0))
+                        return 1;
+        }
+
+        /* out of memory only means a duplicate record */
+        seen = GF_CALLOC (1, sizeof (*seen), gf_changelog_mt_seen_t);
+        if (seen) {
+                uuid_copy (seen->gfid, gfid);
+                seen->type = type;
+                list_add (&seen->hash, bucket);
+        }
+
+        return 0;
+}
+
+static int
+__changelog_open (xlator_t *this, uint64_t start)
+{
+        changelog_priv_t *priv = NULL;
+        unsigned char     header[GF_CHANGELOG_HEADER_SIZE];
+        char              path[PATH_MAX] = {0,};
+
+        priv = this->private;
+
+        snprintf (path, sizeof (path), "%s/" GF_CHANGELOG_CURRENT, priv->dir);
+
+        priv->start  = start;
+        priv->offset = GF_CHANGELOG_HEADER_SIZE;
+        priv->error  = 0;
+        priv->dirty  = 0;
+
+        priv->fd = open (path, O_WRONLY|O_CREAT|O_TRUNC, 0600);
+        if (priv->fd == -1)
+                goto err;
+
+        changelog_encode_header (header, 0, start, 0);
+        if (changelog_write (priv->fd, header, sizeof (header), 0))
+                goto err;
+
+        return 0;
+
+err:
+        gf_log (this->name, GF_LOG_ERROR, "failed to start %s (%s)",
+                path, strerror (errno));
+        if (priv->fd != -1) {
+                close (priv->fd);
+                priv->fd = -1;
+        }
+        priv->error = 1;
+
+        return -1;
+}
+
+/* completes the current file and renames it to its final name */
+static void
+__changelog_close (xlator_t *this, uint64_t end)
+{
+        changelog_priv_t *priv = NULL;
+        unsigned char     header[GF_CHANGELOG_HEADER_SIZE];
+        char              path[PATH_MAX] = {0,};
+        char              newpath[PATH_MAX] = {0,};
+
+        priv = this->private;
+
+        __changelog_flush_buf (this);
+        __changelog_seen_clear (priv);
+
+        if (priv->fd == -1)
+                return;
+
+        snprintf (path, sizeof (path), "%s/" GF_CHANGELOG_CURRENT, priv->dir);
+        snprintf (newpath, sizeof (newpath), "%s/" GF_CHANGELOG_CURRENT
+                  ".%"PRIu64, priv->dir, priv->start);
+
+        changelog_encode_header (header,
+                                 priv->error ? 0 : GF_CHANGELOG_COMPLETE,
+                                 priv->start, end);
+        if (changelog_write (priv->fd, header, sizeof (header), 0) ||
+            fsync (priv->fd))
+                gf_log (this->name, GF_LOG_ERROR,
+                        "failed to complete %s (%s)", path, strerror (errno));
+
+        close (priv->fd);
+        priv->fd = -1;
+
+        if (rename (path, newpath) == -1)
+                gf_log (this->name, GF_LOG_ERROR, "failed to rename %s to "
+                        "%s (%s)", path, newpath, strerror (errno));
+}
+
+static void
+changelog_rollover_cbk (void *data);
+
+/* called with priv->lock held */
+static void
+__changelog_disarm (xlator_t *this)
+{
+        changelog_priv_t *priv = NULL;
+
+        priv = this->private;
+
+        /* a fired event stays around until it is cancelled */
+        if (priv->timer) {
+                gf_timer_call_cancel (this->ctx, priv->timer);
+                priv->timer = NULL;
+        }
+}
+
+/* called with priv->lock held */
+static void
+__changelog_arm (xlator_t *this)
+{
+        changelog_priv_t *priv  = NULL;
+        struct timeval    delta = {0, };
+
+        priv = this->private;
+
+        __changelog_disarm (this);
+
+        if (priv->shutdown)
+                return;
+
+        delta.tv_sec = priv->rollover_time;
+        priv->timer = gf_timer_call_after (this->ctx, delta,
+                                           changelog_rollover_cbk, this);
+}
+
+static void
+changelog_rollover_cbk (void *data)
+{
+        xlator_t         *this = data;
+        changelog_priv_t *priv = NULL;
+        uint64_t          now  = 0;
+
+        THIS = this;
+        priv = this->private;
+        now  = time (NULL);
+
+        pthread_mutex_lock (&priv->lock);
+        {
+                if (priv->shutdown) {
+                        __changelog_disarm (this);
+                        goto unlock;
+                }
+
+                /* an idle period is simply covered by the next file, the
+                   file names are unique as long as time goes forward */
+                if ((priv->dirty || priv->fd == -1) && (now > priv->start)) {
+                        __changelog_close (this, now);
+                        __changelog_open (this, now);
+                }
+
+                __changelog_arm (this);
+        }
+unlock:
+        pthread_mutex_unlock (&priv->lock);
+}
+
+static void
+changelog_record (xlator_t *this, glusterfs_fop_t fop, int type, uuid_t gfid,
+                  int nentries, uuid_t *pargfid, char **name)
+{
+        changelog_priv_t *priv    = NULL;
+        unsigned char    *p       = NULL;
+        size_t            namelen[GF_CHANGELOG_MAX_ENTRIES] = {0,};
+        size_t            size    = GF_CHANGELOG_RECORD_MIN;
+        int               i       = 0;
+
+        priv = this->private;
+
+        if (uuid_is_null (gfid))
+                return;
+
+        for (i = 0; i < nentries; i++) {
+                namelen[i] = name[i] ? strlen (name[i]) : 0;
+                size += 18 + namelen[i];
+        }
+        size = (size + 3) & ~3;
+
+        if (size > priv->buf_size) {
+                gf_log (this->name, GF_LOG_WARNING,
+                        "record of %zu bytes does not fit, dropped", size);
+                return;
+        }
+
+        pthread_mutex_lock (&priv->lock);
+        {
+                if ((type != GF_CHANGELOG_TYPE_ENTRY) &&
+                    __changelog_seen (priv, gfid, type))
+                        goto unlock;
+
+                if (priv->buf_used + size > priv->buf_size)
+                        __changelog_flush_buf (this);
+
+                p = (unsigned char *)priv->buf + priv->buf_used;
+                memset (p, 0, size);
+
+                p = put_be16 (p, size);
+                *p++ = fop;
+                *p++ = type | (nentries << 2);
+                memcpy (p, gfid, 16);
+                p += 16;
+
+                for (i = 0; i < nentries; i++) {
+                        memcpy (p, pargfid[i], 16);
+                        p = put_be16 (p + 16, namelen[i]);
+                        memcpy (p, name[i], namelen[i]);
+                        p += namelen[i];
+                }
+
+                priv->buf_used += size;
+                priv->dirty     = 1;
+        }
+unlock:
+        pthread_mutex_unlock (&priv->lock);
+}
+
+
+static changelog_local_t *
+changelog_local_init (call_frame_t *frame, glusterfs_fop_t fop, inode_t *inode)
+{
+        changelog_local_t *local = NULL;
+
+        local = GF_CALLOC (1, sizeof (*local), gf_changelog_mt_local_t);
+        if (!local)
+                return NULL;
+
+        local->fop  = fop;
+        local->type = GF_CHANGELOG_TYPE_ENTRY;
+        if (inode)
+                uuid_copy (local->gfid, inode->gfid);
+
+        frame->local = local;
+
+        return local;
+}
+
+static void
+changelog_local_add_entry (changelog_local_t *local, loc_t *loc)
+{
+        int i = local->nentries;
+
+        if (!loc->parent || !loc->name)
+                return;
+
+        uuid_copy (local->pargfid[i], loc->parent->gfid);
+        local->name[i] = gf_strdup (loc->name);
+        if (local->name[i])
+                local->nentries++;
+}
+
+static void
+changelog_local_free (changelog_local_t *local)
+{
+        int i = 0;
+
+        if (!local)
+                return;
+
+        for (i = 0; i < local->nentries; i++)
+                GF_FREE (local->name[i]);
+        GF_FREE (local);
+}
+
+/* records the change described by the local, 'buf' if any names the inode */
+static void
+changelog_local_record (xlator_t *this, changelog_local_t *local,
+                        int32_t op_ret, struct iatt *buf)
+{
+        if (!local || (op_ret < 0))
+                return;
+
+        if (buf)
+                uuid_copy (local->gfid, buf->ia_gfid);
+
+        changelog_record (this, local->fop, local->type, local->gfid,
+                          local->nentries, local->pargfid, local->name);
+}
+
+#define CHANGELOG_STACK_UNWIND(fop, frame, params ...) do {             \
+                changelog_local_t *__local = NULL;                      \
+                __local = frame->local;                                 \
+                frame->local = NULL;                                    \
+                STACK_UNWIND_STRICT (fop, frame, params);               \
+                changelog_local_free (__local);                         \
+        } while (0)
+
+/* xattrs glusterfs keeps for itself (xtime, quota, afr changelogs) are not
+   changes anybody needs to find */
+static int
+changelog_xattr_internal (dict_t *dict, const char *name)
+{
+        data_pair_t *trav = NULL;
+
+        if (name)
+                return (strncmp (name, "trusted.glusterfs.", 18) == 0) ||
+                        (strncmp (name, "trusted.afr.", 12) == 0);
+
+        if (!dict)
+                return 1;
+
+        for (trav = dict->members_list; trav; trav = trav->next) {
+                if (!changelog_xattr_internal (NULL, trav->key))
+                        return 0;
+        }
+
+        return 1;
+}
+
+
+/* entry operations */
+
+int32_t
+changelog_create_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                      int32_t op_ret, int32_t op_errno, fd_t *fd,
+                      inode_t *inode, struct iatt *buf,
+                      struct iatt *preparent, struct iatt *postparent)
+{
+        changelog_local_record (this, frame->local, op_ret, buf);
+
+        CHANGELOG_STACK_UNWIND (create, frame, op_ret, op_errno, fd, inode,
+                                buf, preparent, postparent);
+        return 0;
+}
+
+int32_t
+changelog_create (call_frame_t *frame, xlator_t *this, loc_t *loc,
+                  int32_t flags, mode_t mode, fd_t *fd, dict_t *params)
+{
+        changelog_local_t *local = NULL;
+
+        local = changelog_local_init (frame, GF_FOP_CREATE, NULL);
+        if (local)
+                changelog_local_add_entry (local, loc);
+
+        STACK_WIND (frame, changelog_create_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->create, loc, flags, mode, fd,
+                    params);
+        return 0;
+}
+
+int32_t
+changelog_mkdir_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                     int32_t op_ret, int32_t op_errno, inode_t *inode,
+                     struct iatt *buf, struct iatt *preparent,
+                     struct iatt *postparent)
+{
+        changelog_local_record (this, frame->local, op_ret, buf);
+
+        CHANGELOG_STACK_UNWIND (mkdir, frame, op_ret, op_errno, inode, buf,
+                                preparent, postparent);
+        return 0;
+}
+
+int32_t
+changelog_mkdir (call_frame_t *frame, xlator_t *this, loc_t *loc,
+                 mode_t mode, dict_t *params)
+{
+        changelog_local_t *local = NULL;
+
+        local = changelog_local_init (frame, GF_FOP_MKDIR, NULL);
+        if (local)
+                changelog_local_add_entry (local, loc);
+
+        STACK_WIND (frame, changelog_mkdir_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->mkdir, loc, mode, params);
+        return 0;
+}
+
+int32_t
+changelog_mknod_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                     int32_t op_ret, int32_t op_errno, inode_t *inode,
+                     struct iatt *buf, struct iatt *preparent,
+                     struct iatt *postparent)
+{
+        changelog_local_record (this, frame->local, op_ret, buf);
+
+        CHANGELOG_STACK_UNWIND (mknod, frame, op_ret, op_errno, inode, buf,
+                                preparent, postparent);
+        return 0;
+}
+
+int32_t
+changelog_mknod (call_frame_t *frame, xlator_t *this, loc_t *loc,
+                 mode_t mode, dev_t rdev, dict_t *params)
+{
+        changelog_local_t *local = NULL;
+
+        local = changelog_local_init (frame, GF_FOP_MKNOD, NULL);
+        if (local)
+                changelog_local_add_entry (local, loc);
+
+        STACK_WIND (frame, changelog_mknod_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->mknod, loc, mode, rdev, params);
+        return 0;
+}
+
+int32_t
+changelog_symlink_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                       int32_t op_ret, int32_t op_errno, inode_t *inode,
+                       struct iatt *buf, struct iatt *preparent,
+                       struct iatt *postparent)
+{
+        changelog_local_record (this, frame->local, op_ret, buf);
+
+        CHANGELOG_STACK_UNWIND (symlink, frame, op_ret, op_errno, inode, buf,
+                                preparent, postparent);
+        return 0;
+}
+
+int32_t
+changelog_symlink (call_frame_t *frame, xlator_t *this, const char *linkpath,
+                   loc_t *loc, dict_t *params)
+{
+        changelog_local_t *local = NULL;
+
+        local = changelog_local_init (frame, GF_FOP_SYMLINK, NULL);
+        if (local)
+                changelog_local_add_entry (local, loc);
+
+        STACK_WIND (frame, changelog_symlink_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->symlink, linkpath, loc, params);
+        return 0;
+}
+
+int32_t
+changelog_link_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                    int32_t op_ret, int32_t op_errno, inode_t *inode,
+                    struct iatt *buf, struct iatt *preparent,
+                    struct iatt *postparent)
+{
+        changelog_local_record (this, frame->local, op_ret, buf);
+
+        CHANGELOG_STACK_UNWIND (link, frame, op_ret, op_errno, inode, buf,
+                                preparent, postparent);
+        return 0;
+}
+
+int32_t
+changelog_link (call_frame_t *frame, xlator_t *this, loc_t *oldloc,
+                loc_t *newloc)
+{
+        changelog_local_t *local = NULL;
+
+        local = changelog_local_init (frame, GF_FOP_LINK, NULL);
+        if (local)
+                changelog_local_add_entry (local, newloc);
+
+        STACK_WIND (frame, changelog_link_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->link, oldloc, newloc);
+        return 0;
+}
+
+int32_t
+changelog_unlink_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                      int32_t op_ret, int32_t op_errno,
+                      struct iatt *preparent, struct iatt *postparent)
+{
+        changelog_local_record (this, frame->local, op_ret, NULL);
+
+        CHANGELOG_STACK_UNWIND (unlink, frame, op_ret, op_errno, preparent,
+                                postparent);
+        return 0;
+}
+
+int32_t
+changelog_unlink (call_frame_t *frame, xlator_t *this, loc_t *loc)
+{
+        changelog_local_t *local = NULL;
+
+        local = changelog_local_init (frame, GF_FOP_UNLINK, loc->inode);
+        if (local)
+                changelog_local_add_entry (local, loc);
+
+        STACK_WIND (frame, changelog_unlink_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->unlink, loc);
+        return 0;
+}
+
+int32_t
+changelog_rmdir_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                     int32_t op_ret, int32_t op_errno,
+                     struct iatt *preparent, struct iatt *postparent)
+{
+        changelog_local_record (this, frame->local, op_ret, NULL);
+
+        CHANGELOG_STACK_UNWIND (rmdir, frame, op_ret, op_errno, preparent,
+                                postparent);
+        return 0;
+}
+
+int32_t
+changelog_rmdir (call_frame_t *frame, xlator_t *this, loc_t *loc, int flags)
+{
+        changelog_local_t *local = NULL;
+
+        local = changelog_local_init (frame, GF_FOP_RMDIR, loc->inode);
+        if (local)
+                changelog_local_add_entry (local, loc);
+
+        STACK_WIND (frame, changelog_rmdir_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->rmdir, loc, flags);
+        return 0;
+}
+
+int32_t
+changelog_rename_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                      int32_t op_ret, int32_t op_errno, struct iatt *buf,
+                      struct iatt *preoldparent, struct iatt *postoldparent,
+                      struct iatt *prenewparent, struct iatt *postnewparent)
+{
+        changelog_local_record (this, frame->local, op_ret, buf);
+
+        CHANGELOG_STACK_UNWIND (rename, frame, op_ret, op_errno, buf,
+                                preoldparent, postoldparent, prenewparent,
+                                postnewparent);
+        return 0;
+}
+
+int32_t
+changelog_rename (call_frame_t *frame, xlator_t *this, loc_t *oldloc,
+                  loc_t *newloc)
+{
+        changelog_local_t *local = NULL;
+
+        /* the new name first, a replaced target is implied by it */
+        local = changelog_local_init (frame, GF_FOP_RENAME, oldloc->inode);
+        if (local) {
+                changelog_local_add_entry (local, newloc);
+                changelog_local_add_entry (local, oldloc);
+        }
+
+        STACK_WIND (frame, changelog_rename_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->rename, oldloc, newloc);
+        return 0;
+}
+
+
+/* data and metadata operations, recorded once per inode and file */
+
+int32_t
+changelog_writev_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                      int32_t op_ret, int32_t op_errno, struct iatt *prebuf,
+                      struct iatt *postbuf)
+{
+        if (op_ret >= 0)
+                changelog_record (this, GF_FOP_WRITE, GF_CHANGELOG_TYPE_DATA,
+                                  postbuf->ia_gfid, 0, NULL, NULL);
+
+        STACK_UNWIND_STRICT (writev, frame, op_ret, op_errno, prebuf, postbuf);
+        return 0;
+}
+
+int32_t
+changelog_writev (call_frame_t *frame, xlator_t *this, fd_t *fd,
+                  struct iovec *vector, int32_t count, off_t offset,
+                  struct iobref *iobref)
+{
+        STACK_WIND (frame, changelog_writev_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->writev, fd, vector, count,
+                    offset, iobref);
+        return 0;
+}
+
+int32_t
+changelog_truncate_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                        int32_t op_ret, int32_t op_errno, struct iatt *prebuf,
+                        struct iatt *postbuf)
+{
+        if (op_ret >= 0)
+                changelog_record (this, GF_FOP_TRUNCATE,
+                                  GF_CHANGELOG_TYPE_DATA, postbuf->ia_gfid,
+                                  0, NULL, NULL);
+
+        STACK_UNWIND_STRICT (truncate, frame, op_ret, op_errno, prebuf,
+                             postbuf);
+        return 0;
+}
+
+int32_t
+changelog_truncate (call_frame_t *frame, xlator_t *this, loc_t *loc,
+                    off_t offset)
+{
+        STACK_WIND (frame, changelog_truncate_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->truncate, loc, offset);
+        return 0;
+}
+
+int32_t
+changelog_ftruncate_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                         int32_t op_ret, int32_t op_errno,
+                         struct iatt *prebuf, struct iatt *postbuf)
+{
+        if (op_ret >= 0)
+                changelog_record (this, GF_FOP_FTRUNCATE,
+                                  GF_CHANGELOG_TYPE_DATA, postbuf->ia_gfid,
+                                  0, NULL, NULL);
+
+        STACK_UNWIND_STRICT (ftruncate, frame, op_ret, op_errno, prebuf,
+                             postbuf);
+        return 0;
+}
+
+int32_t
+changelog_ftruncate (call_frame_t *frame, xlator_t *this, fd_t *fd,
+                     off_t offset)
+{
+        STACK_WIND (frame, changelog_ftruncate_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->ftruncate, fd, offset);
+        return 0;
+}
+
+int32_t
+changelog_setattr_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                       int32_t op_ret, int32_t op_errno, struct iatt *statpre,
+                       struct iatt *statpost)
+{
+        if (op_ret >= 0)
+                changelog_record (this, GF_FOP_SETATTR,
+                                  GF_CHANGELOG_TYPE_METADATA,
+                                  statpost->ia_gfid, 0, NULL, NULL);
+
+        STACK_UNWIND_STRICT (setattr, frame, op_ret, op_errno, statpre,
+                             statpost);
+        return 0;
+}
+
+int32_t
+changelog_setattr (call_frame_t *frame, xlator_t *this, loc_t *loc,
+                   struct iatt *stbuf, int32_t valid)
+{
+        STACK_WIND (frame, changelog_setattr_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->setattr, loc, stbuf, valid);
+        return 0;
+}
+
+int32_t
+changelog_fsetattr_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                        int32_t op_ret, int32_t op_errno, struct iatt *statpre,
+                        struct iatt *statpost)
+{
+        if (op_ret >= 0)
+                changelog_record (this, GF_FOP_FSETATTR,
+                                  GF_CHANGELOG_TYPE_METADATA,
+                                  statpost->ia_gfid, 0, NULL, NULL);
+
+        STACK_UNWIND_STRICT (fsetattr, frame, op_ret, op_errno, statpre,
+                             statpost);
+        return 0;
+}
+
+int32_t
+changelog_fsetattr (call_frame_t *frame, xlator_t *this, fd_t *fd,
+                    struct iatt *stbuf, int32_t valid)
+{
+        STACK_WIND (frame, changelog_fsetattr_cbk, FIRST_CHILD (this),
+                    FIRST_CHILD (this)->fops->fsetattr, fd, stbuf, valid);
+        return 0;
+}
+
+/* the xattr fops carry the inode being changed as cookie */
+int32_t
+changelog_setxattr_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                        int32_t op_ret, int32_t op_errno)
+{
+        inode_t *inode = cookie;
+
+        if (op_ret >= 0)
+                changelog_record (this, GF_FOP_SETXATTR,
+                                  GF_CHANGELOG_TYPE_METADATA, inode->gfid,
+                                  0, NULL, NULL);
+
+        STACK_UNWIND_STRICT (setxattr, frame, op_ret, op_errno);
+        return 0;
+}
+
+int32_t
+changelog_setxattr (call_frame_t *frame, xlator_t *this, loc_t *loc,
+                    dict_t *dict, int32_t flags)
+{
+        if (!loc->inode || changelog_xattr_internal (dict, NULL)) {
+                STACK_WIND (frame, default_setxattr_cbk, FIRST_CHILD (this),
+                            FIRST_CHILD (this)->fops->setxattr, loc, dict,
+                            flags);
+                return 0;
+        }
+
+        STACK_WIND_COOKIE (frame, changelog_setxattr_cbk, loc->inode,
+                           FIRST_CHILD (this),
+                           FIRST_CHILD (this)->fops->setxattr, loc, dict,
+                           flags);
+        return 0;
+}
+
+int32_t
+changelog_fsetxattr_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                         int32_t op_ret, int32_t op_errno)
+{
+        inode_t *inode = cookie;
+
+        if (op_ret >= 0)
+                changelog_record (this, GF_FOP_FSETXATTR,
+                                  GF_CHANGELOG_TYPE_METADATA, inode->gfid,
+                                  0, NULL, NULL);
+
+        STACK_UNWIND_STRICT (fsetxattr, frame, op_ret, op_errno);
+        return 0;
+}
+
+int32_t
+changelog_fsetxattr (call_frame_t *frame, xlator_t *this, fd_t *fd,
+                     dict_t *dict, int32_t flags)
+{
+        if (changelog_xattr_internal (dict, NULL)) {
+                STACK_WIND (frame, default_fsetxattr_cbk, FIRST_CHILD (this),
+                            FIRST_CHILD (this)->fops->fsetxattr, fd, dict,
+                            flags);
+                return 0;
+        }
+
+        STACK_WIND_COOKIE (frame, changelog_fsetxattr_cbk, fd->inode,
+                           FIRST_CHILD (this),
+                           FIRST_CHILD (this)->fops->fsetxattr, fd, dict,
+                           flags);
+        return 0;
+}
+
+int32_t
+changelog_removexattr_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                           int32_t op_ret, int32_t op_errno)
+{
+        inode_t *inode = cookie;
+
+        if (op_ret >= 0)
+                changelog_record (this, GF_FOP_REMOVEXATTR,
+                                  GF_CHANGELOG_TYPE_METADATA, inode->gfid,
+                                  0, NULL, NULL);
+
+        STACK_UNWIND_STRICT (removexattr, frame, op_ret, op_errno);
+        return 0;
+}
+
+int32_t
+changelog_removexattr (call_frame_t *frame, xlator_t *this, loc_t *loc,
+                       const char *name)
+{
+        if (!loc->inode || changelog_xattr_internal (NULL, name)) {
+                STACK_WIND (frame, default_removexattr_cbk, FIRST_CHILD (this),
+                            FIRST_CHILD (this)->fops->removexattr, loc, name);
+                return 0;
+        }
+
+        STACK_WIND_COOKIE (frame, changelog_removexattr_cbk, loc->inode,
+                           FIRST_CHILD (this),
+                           FIRST_CHILD (this)->fops->removexattr, loc, name);
+        return 0;
+}
+
+
+/* A GF_CHANGELOG_CURRENT left behind was not completed: the brick went
+   down without fini. Keep what it has, flagged as incomplete. */
+static void
+changelog_recover (xlator_t *this)
+{
+        changelog_priv_t *priv = NULL;
+        unsigned char     header[GF_CHANGELOG_HEADER_SIZE];
+        char              path[PATH_MAX] = {0,};
+        char              newpath[PATH_MAX] = {0,};
+        struct stat       stbuf;
+        uint64_t          start = 0;
+        int               fd = -1;
+        int               i  = 0;
+
+        priv = this->private;
+
+        snprintf (path, sizeof (path), "%s/" GF_CHANGELOG_CURRENT, priv->dir);
+
+        fd = open (path, O_RDWR);
+        if (fd == -1)
+                return;
+
+        if ((fstat (fd, &stbuf) == -1) ||
+            (pread (fd, header, sizeof (header), 0) != sizeof (header)) ||
+            memcmp (header, GF_CHANGELOG_MAGIC, sizeof (GF_CHANGELOG_MAGIC))) {
+                gf_log (this->name, GF_LOG_WARNING,
+                        "discarding unreadable %s", path);
+                close (fd);
+                unlink (path);
+                return;
+        }
+
+        for (i = 16; i < 24; i++)
+                start = (start << 8) | header[i];
+
+        changelog_encode_header (header, 0, start, stbuf.st_mtime);
+        if (changelog_write (fd, header, sizeof (header), 0) || fsync (fd))
+                gf_log (this->name, GF_LOG_ERROR, "failed to update %s (%s)",
+                        path, strerror (errno));
+        close (fd);
+
+        snprintf (newpath, sizeof (newpath), "%s/" GF_CHANGELOG_CURRENT
+                  ".%"PRIu64, priv->dir, start);
+        if (rename (path, newpath) == -1)
+                gf_log (this->name, GF_LOG_ERROR, "failed to rename %s to "
+                        "%s (%s)", path, newpath, strerror (errno));
+        else
+                gf_log (this->name, GF_LOG_WARNING, "%s was not completed, "
+                        "it may lack changes", newpath);
+}
+
+static int
+changelog_mkdir_p (char *dir)
+{
+        char *p = dir;
+
+        while ((p = strchr (p + 1, '/'))) {
+                *p = '\0';
+                if ((mkdir (dir, 0700) == -1) && (errno != EEXIST)) {
+                        *p = '/';
+                        return -1;
+                }
+                *p = '/';
+        }
+
+        if ((mkdir (dir, 0700) == -1) && (errno != EEXIST))
+                return -1;
+
+        return 0;
+}
+
+int32_t
+mem_acct_init (xlator_t *this)
+{
+        int     ret = -1;
+
+        if (!this)
+                return ret;
+
+        ret = xlator_mem_acct_init (this, gf_changelog_mt_end + 1);
+
+        if (ret != 0) {
+                gf_log (this->name, GF_LOG_ERROR, "Memory accounting init"
+                        "failed");
+                return ret;
+        }
+
+        return ret;
+}
+
+int
+reconfigure (xlator_t *this, dict_t *options)
+{
+        changelog_priv_t *priv = NULL;
+        data_t           *data = NULL;
+        uint32_t          rollover_time = 0;
+
+        priv = this->private;
+
+        data = dict_get (options, "rollover-time");
+        if (data) {
+                if ((gf_string2time (data->data, &rollover_time) != 0) ||
+                    !rollover_time) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "Reconfigure: invalid rollover-time '%s'",
+                                data->data);
+                        return -1;
+                }
+                /* picked up when the timer is armed next */
+                priv->rollover_time = rollover_time;
+        }
+
+        return 0;
+}
+
+int32_t
+init (xlator_t *this)
+{
+        changelog_priv_t *priv = NULL;
+        data_t           *data = NULL;
+        uint64_t          buf_size = 0;
+        int               i    = 0;
+
+        if (!this->children || this->children->next) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "changelog should have exactly one child");
+                return -1;
+        }
+
+        if (!this->parents) {
+                gf_log (this->name, GF_LOG_WARNING,
+                        "dangling volume. check volfile ");
+        }
+
+        data = dict_get (this->options, "changelog-dir");
+        if (!data) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "option changelog-dir is not set");
+                return -1;
+        }
+
+        priv = GF_CALLOC (1, sizeof (*priv), gf_changelog_mt_priv_t);
+        if (!priv)
+                goto err;
+        this->private = priv;
+
+        priv->fd = -1;
+        pthread_mutex_init (&priv->lock, NULL);
+
+        priv->dir = gf_strdup (data->data);
+        if (!priv->dir)
+                goto err;
+
+        priv->rollover_time = CHANGELOG_DEFAULT_ROLLOVER_TIME;
+        data = dict_get (this->options, "rollover-time");
+        if (data && ((gf_string2time (data->data, &priv->rollover_time) != 0)
+                     || !priv->rollover_time)) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "invalid rollover-time '%s'", data->data);
+                goto err;
+        }
+
+        buf_size = CHANGELOG_DEFAULT_BUFFER_SIZE;
+        data = dict_get (this->options, "buffer-size");
+        if (data && ((gf_string2bytesize (data->data, &buf_size) != 0) ||
+                     (buf_size < 4096))) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "invalid buffer-size '%s'", data->data);
+                goto err;
+        }
+        priv->buf_size = buf_size;
+
+        priv->buf = GF_MALLOC (priv->buf_size, gf_changelog_mt_buf_t);
+        priv->seen = GF_CALLOC (CHANGELOG_SEEN_HASH_SIZE,
+                                sizeof (struct list_head),
+                                gf_changelog_mt_seen_t);
+        if (!priv->buf || !priv->seen)
+                goto err;
+        for (i = 0; i < CHANGELOG_SEEN_HASH_SIZE; i++)
+                INIT_LIST_HEAD (&priv->seen[i]);
+
+        if (changelog_mkdir_p (priv->dir)) {
+                gf_log (this->name, GF_LOG_ERROR, "failed to create %s (%s)",
+                        priv->dir, strerror (errno));
+                goto err;
+        }
+
+        changelog_recover (this);
+
+        if (__changelog_open (this, time (NULL)))
+                goto err;
+
+        pthread_mutex_lock (&priv->lock);
+        {
+                __changelog_arm (this);
+        }
+        pthread_mutex_unlock (&priv->lock);
+
+        return 0;
+
+err:
+        gf_log (this->name, GF_LOG_ERROR, "changelog init failed");
+        fini (this);
+
+        return -1;
+}
+
+void
+fini (xlator_t *this)
+{
+        changelog_priv_t *priv = NULL;
+        char              path[PATH_MAX] = {0,};
+
+        priv = this->private;
+        if (!priv)
+                return;
+
+        /* a rollover running right now finishes under the lock first, and
+           does not arm the timer again */
+        pthread_mutex_lock (&priv->lock);
+        {
+                priv->shutdown = 1;
+                __changelog_disarm (this);
+        }
+        pthread_mutex_unlock (&priv->lock);
+
+        if (priv->fd != -1) {
+                if (priv->dirty) {
+                        __changelog_close (this, time (NULL));
+                } else {
+                        /* nothing happened since the last file */
+                        close (priv->fd);
+                        snprintf (path, sizeof (path),
+                                  "%s/" GF_CHANGELOG_CURRENT, priv->dir);
+                        unlink (path);
+                }
+        }
+
+        if (priv->seen) {
+                __changelog_seen_clear (priv);
+                GF_FREE (priv->seen);
+        }
+        if (priv->buf)
+                GF_FREE (priv->buf);
+        if (priv->dir)
+                GF_FREE (priv->dir);
+
+        pthread_mutex_destroy (&priv->lock);
+        GF_FREE (priv);
+        this->private = NULL;
+}
+
+struct xlator_fops fops = {
+        .create      = changelog_create,
+        .mkdir       = changelog_mkdir,
+        .mknod       = changelog_mknod,
+        .symlink     = changelog_symlink,
+        .link        = changelog_link,
+        .unlink      = changelog_unlink,
+        .rmdir       = changelog_rmdir,
+        .rename      = changelog_rename,
+        .writev      = changelog_writev,
+        .truncate    = changelog_truncate,
+        .ftruncate   = changelog_ftruncate,
+        .setattr     = changelog_setattr,
+        .fsetattr    = changelog_fsetattr,
+        .setxattr    = changelog_setxattr,
+        .fsetxattr   = changelog_fsetxattr,
+        .removexattr = changelog_removexattr,
+};
+
+struct xlator_cbks cbks = {
+};
+
+struct volume_options options[] = {
+        { .key  = {"changelog-dir"},
+          .type = GF_OPTION_TYPE_PATH
+        },
+        { .key  = {"rollover-time"},
+          .type = GF_OPTION_TYPE_TIME
+        },
+        { .key  = {"buffer-size"},
+          .type = GF_OPTION_TYPE_SIZET
+        },
+        { .key  = {NULL} },
+};
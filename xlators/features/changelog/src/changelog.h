@@ -0,0 +1,75 @@
+/*
+   Copyright (c) 2010 Gluster, Inc. <http://www.gluster.com>
+   This file is part of GlusterFS.
+
+   GlusterFS is free software; you can redistribute it and/or modify
+   it under the terms of the GNU Affero General Public License as published
+   by the Free Software Foundation; either version 3 of the License,
+   or (at your option) any later version.
+
+   GlusterFS is distributed in the hope that it will be useful, but
+   WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+   Affero General Public License for more details.
+
+   You should have received a copy of the GNU Affero General Public License
+   along with this program.  If not, see
+   <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef __CHANGELOG_H__
+#define __CHANGELOG_H__
+
+#ifndef _CONFIG_H
+#define _CONFIG_H
+#include "config.h"
+#endif
+
+#include "xlator.h"
+#include "timer.h"
+#include "changelog-mem-types.h"
+#include "gf-changelog.h"
+
+#define CHANGELOG_DEFAULT_ROLLOVER_TIME  15
+#define CHANGELOG_DEFAULT_BUFFER_SIZE    (128 * 1024)
+#define CHANGELOG_SEEN_HASH_SIZE         4096
+
+/* a file which already has a data or metadata record in the current
+   journal file */
+typedef struct {
+        struct list_head  hash;
+        uuid_t            gfid;
+        int               type;
+} changelog_seen_t;
+
+typedef struct {
+        char             *dir;
+        uint32_t          rollover_time;
+
+        pthread_mutex_t   lock;         /* held across file IO */
+        gf_timer_t       *timer;        /* under lock, as is shutdown */
+        char              shutdown;     /* no rollover is armed anymore */
+        int               fd;           /* of GF_CHANGELOG_CURRENT */
+        uint64_t          start;
+        off_t             offset;       /* where the buffer goes */
+        char              error;        /* records were lost */
+        char              dirty;        /* something since 'start' */
+
+        char             *buf;
+        size_t            buf_size;
+        size_t            buf_used;
+
+        struct list_head *seen;
+} changelog_priv_t;
+
+typedef struct {
+        glusterfs_fop_t   fop;
+        int               type;
+        uuid_t            gfid;
+        int               nentries;
+        uuid_t            pargfid[GF_CHANGELOG_MAX_ENTRIES];
+        char             *name[GF_CHANGELOG_MAX_ENTRIES];
+} changelog_local_t;
+
+#endif
@@ -27,6 +27,11 @@ enum gf_marker_mem_types_ {
         gf_marker_mt_marker_conf_t,
         gf_marker_mt_loc_t,
         gf_marker_mt_volume_mark,
+        gf_marker_mt_quota_inode_ctx_t,
+        gf_marker_mt_int64_t,
+        gf_marker_mt_xtime_entry_t,
+        gf_marker_mt_xtime_flush_t,
+        gf_marker_mt_list_head,
         gf_marker_mt_end
 };
 #endif
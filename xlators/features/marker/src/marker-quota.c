@@ -0,0 +1,620 @@
+/*Copyright (c) 2008-2010 Gluster, Inc. <http://www.gluster.com>
+  This file is part of GlusterFS.
+
+  GlusterFS is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published
+  by the Free Software Foundation; either version 3 of the License,
+  or (at your option) any later version.
+
+  GlusterFS is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see
+  <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _CONFIG_H
+#define _CONFIG_H
+#include "config.h"
+#endif
+
+#include "byte-order.h"
+#include "marker-quota.h"
+#include "marker-mem-types.h"
+
+/* Quota accounting.
+ *
+ * Fops only record how much an inode's contribution changed, in its inode
+ * ctx, and queue the inode on a dirty list. Every quota-update-interval a
+ * flush walks the list: each inode gets a single xattrop adding the delta
+ * to its contri key (and, for a directory, the changes of its children to
+ * its size key), and the delta is moved on to its parent, which is queued
+ * at the tail of the same batch. Many writes to a file, or to the files of
+ * a directory, thus cost one xattrop per ancestor and interval.
+ *
+ * An inode is accounted once its contri for the current parent is known,
+ * which a lookup gives for free. When the contri on disk does not match
+ * the inode's usage, the difference is queued, so data written before
+ * quota was enabled is picked up as it gets looked up.
+ */
+
+static void
+mq_contri_key (uuid_t parent, char *key)
+{
+        char uuid[UUID_SIZE + 1] = {0,};
+
+        uuid_unparse (parent, uuid);
+        snprintf (key, QUOTA_KEY_MAX, QUOTA_CONTRI_KEY_FMT, uuid);
+}
+
+static int
+mq_dict_get_int64 (dict_t *dict, char *key, int64_t *value)
+{
+        data_t *data = NULL;
+
+        data = dict_get (dict, key);
+        if (!data || (data->len != sizeof (int64_t)))
+                return -1;
+
+        *value = ntoh64 (*(int64_t *)data->data);
+        return 0;
+}
+
+static int
+mq_dict_set_int64 (dict_t *dict, char *key, int64_t value)
+{
+        int64_t *buf = NULL;
+        int      ret = -1;
+
+        buf = GF_CALLOC (1, sizeof (int64_t), gf_marker_mt_int64_t);
+        if (!buf)
+                return -1;
+
+        *buf = hton64 (value);
+
+        ret = dict_set_bin (dict, key, buf, sizeof (int64_t));
+        if (ret)
+                GF_FREE (buf);
+
+        return ret;
+}
+
+/* all the __mq_ functions are called with quota_lock held */
+
+static quota_inode_ctx_t *
+__mq_inode_ctx_find (xlator_t *this, inode_t *inode)
+{
+        uint64_t value = 0;
+
+        if (inode_ctx_get (inode, this, &value))
+                return NULL;
+
+        return (quota_inode_ctx_t *)(long) value;
+}
+
+static quota_inode_ctx_t *
+__mq_inode_ctx_get (xlator_t *this, inode_t *inode)
+{
+        quota_inode_ctx_t *ctx = NULL;
+
+        ctx = __mq_inode_ctx_find (this, inode);
+        if (ctx)
+                return ctx;
+
+        ctx = GF_CALLOC (1, sizeof (*ctx), gf_marker_mt_quota_inode_ctx_t);
+        if (!ctx) {
+                gf_log (this->name, GF_LOG_ERROR, "out of memory :(");
+                return NULL;
+        }
+
+        ctx->inode = inode;
+        INIT_LIST_HEAD (&ctx->dirty);
+
+        if (inode_ctx_put (inode, this, (uint64_t)(long) ctx)) {
+                GF_FREE (ctx);
+                return NULL;
+        }
+
+        return ctx;
+}
+
+static void
+mq_flush_timer_cbk (void *data);
+
+/* Queues 'ctx' on 'batch' when a flush is running, on the dirty list
+   otherwise. A queued inode is held by a ref. */
+static void
+__mq_mark_dirty (xlator_t *this, quota_inode_ctx_t *ctx,
+                 struct list_head *batch)
+{
+        marker_conf_t  *priv  = NULL;
+        struct timeval  delta = {0, };
+
+        priv = this->private;
+
+        if (!list_empty (&ctx->dirty))
+                return;
+
+        inode_ref (ctx->inode);
+
+        if (batch) {
+                list_add_tail (&ctx->dirty, batch);
+                return;
+        }
+
+        list_add_tail (&ctx->dirty, &priv->quota_dirty);
+
+        if (priv->quota_timer)
+                return;
+
+        delta.tv_sec = priv->quota_interval;
+        priv->quota_timer = gf_timer_call_after (this->ctx, delta,
+                                                 mq_flush_timer_cbk, this);
+}
+
+/* 'delta' bytes appeared below the directory 'parent' */
+static void
+__mq_parent_add (xlator_t *this, inode_t *parent, int64_t delta,
+                 struct list_head *batch)
+{
+        quota_inode_ctx_t *pctx = NULL;
+
+        if (!delta)
+                return;
+
+        pctx = __mq_inode_ctx_get (this, parent);
+        if (!pctx)
+                return;
+
+        pctx->size_delta += delta;
+        if (pctx->known && !uuid_is_null (pctx->parent)) {
+                pctx->contri       += delta;
+                pctx->contri_delta += delta;
+        }
+
+        __mq_mark_dirty (this, pctx, batch);
+}
+
+static int32_t
+mq_xattrop_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                int32_t op_ret, int32_t op_errno, dict_t *dict)
+{
+        if ((op_ret == -1) && (op_errno != ENOENT))
+                gf_log (this->name, GF_LOG_WARNING, "failed to update the "
+                        "quota xattrs (%s)", strerror (op_errno));
+
+        STACK_DESTROY (frame->root);
+        return 0;
+}
+
+static void
+mq_flush_one (xlator_t *this, quota_inode_ctx_t *ctx, struct list_head *batch)
+{
+        marker_conf_t *priv         = NULL;
+        call_frame_t  *frame        = NULL;
+        inode_t       *parent       = NULL;
+        dict_t        *dict         = NULL;
+        loc_t          loc          = {0, };
+        int64_t        size_delta   = 0;
+        int64_t        contri_delta = 0;
+        char           key[QUOTA_KEY_MAX] = {0,};
+        int            ret          = 0;
+
+        priv = this->private;
+
+        LOCK (&priv->quota_lock);
+        {
+                size_delta   = ctx->size_delta;
+                contri_delta = ctx->contri_delta;
+                ctx->size_delta   = 0;
+                ctx->contri_delta = 0;
+
+                if (contri_delta && !uuid_is_null (ctx->parent))
+                        parent = inode_find (ctx->inode->table, ctx->parent);
+
+                if (parent) {
+                        mq_contri_key (ctx->parent, key);
+                        __mq_parent_add (this, parent, contri_delta, batch);
+                } else {
+                        contri_delta = 0;
+                }
+        }
+        UNLOCK (&priv->quota_lock);
+
+        if (parent)
+                inode_unref (parent);
+
+        if (!size_delta && !contri_delta)
+                return;
+
+        ret = marker_inode_loc_fill (ctx->inode, &loc);
+        if (ret < 0) {
+                gf_log (this->name, GF_LOG_DEBUG, "inode is gone, dropping "
+                        "%"PRId64"/%"PRId64" bytes", size_delta, contri_delta);
+                return;
+        }
+
+        dict = dict_new ();
+        if (!dict)
+                goto out;
+
+        if (size_delta)
+                ret = mq_dict_set_int64 (dict, QUOTA_SIZE_KEY, size_delta);
+        if (!ret && contri_delta)
+                ret = mq_dict_set_int64 (dict, key, contri_delta);
+        if (ret)
+                goto out;
+
+        frame = create_frame (this, this->ctx->pool);
+        if (!frame)
+                goto out;
+
+        STACK_WIND (frame, mq_xattrop_cbk, FIRST_CHILD(this),
+                    FIRST_CHILD(this)->fops->xattrop, &loc,
+                    GF_XATTROP_ADD_ARRAY64, dict);
+out:
+        if (dict)
+                dict_unref (dict);
+
+        loc_wipe (&loc);
+}
+
+static void
+mq_flush (xlator_t *this)
+{
+        marker_conf_t     *priv  = NULL;
+        quota_inode_ctx_t *ctx   = NULL;
+        struct list_head   batch;
+
+        priv = this->private;
+
+        INIT_LIST_HEAD (&batch);
+
+        LOCK (&priv->quota_lock);
+        {
+                list_splice_init (&priv->quota_dirty, &batch);
+
+                /* the event fired, it is only freed by a cancel */
+                if (priv->quota_timer) {
+                        gf_timer_call_cancel (this->ctx, priv->quota_timer);
+                        priv->quota_timer = NULL;
+                }
+        }
+        UNLOCK (&priv->quota_lock);
+
+        for (;;) {
+                LOCK (&priv->quota_lock);
+                {
+                        ctx = NULL;
+                        if (!list_empty (&batch)) {
+                                ctx = list_entry (batch.next,
+                                                  quota_inode_ctx_t, dirty);
+                                list_del_init (&ctx->dirty);
+                        }
+                }
+                UNLOCK (&priv->quota_lock);
+
+                if (!ctx)
+                        break;
+
+                mq_flush_one (this, ctx, &batch);
+
+                /* may release the ctx */
+                inode_unref (ctx->inode);
+        }
+}
+
+static void
+mq_flush_timer_cbk (void *data)
+{
+        xlator_t *this = data;
+
+        THIS = this;
+
+        mq_flush (this);
+}
+
+static int32_t
+mq_removexattr_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                    int32_t op_ret, int32_t op_errno)
+{
+        STACK_DESTROY (frame->root);
+        return 0;
+}
+
+dict_t *
+mq_lookup_xattr_req (xlator_t *this, loc_t *loc, dict_t *xattr_req)
+{
+        quota_inode_ctx_t *ctx  = NULL;
+        dict_t            *dict = NULL;
+        uint64_t           value = 0;
+        char               key[QUOTA_KEY_MAX] = {0,};
+        int                ret  = 0;
+
+        /* contri is only read once, until the inode is forgotten */
+        if (loc->inode && !inode_ctx_get (loc->inode, this, &value)) {
+                ctx = (quota_inode_ctx_t *)(long) value;
+                if (ctx->known)
+                        return NULL;
+        }
+
+        if (xattr_req)
+                dict = dict_copy_with_ref (xattr_req, NULL);
+        else
+                dict = dict_new ();
+        if (!dict)
+                return NULL;
+
+        ret = dict_set_uint64 (dict, QUOTA_SIZE_KEY, 0);
+        if (!ret && loc->parent && !uuid_is_null (loc->parent->gfid)) {
+                mq_contri_key (loc->parent->gfid, key);
+                ret = dict_set_uint64 (dict, key, 0);
+        }
+        if (ret)
+                gf_log (this->name, GF_LOG_DEBUG, "failed to request the "
+                        "quota xattrs of %s", loc->path);
+
+        return dict;
+}
+
+void
+mq_lookup_done (xlator_t *this, loc_t *loc, struct iatt *buf, dict_t *dict)
+{
+        marker_conf_t     *priv   = NULL;
+        quota_inode_ctx_t *ctx    = NULL;
+        gf_boolean_t       root   = _gf_false;
+        int64_t            size   = 0;
+        int64_t            contri = 0;
+        int64_t            actual = 0;
+        char               key[QUOTA_KEY_MAX] = {0,};
+
+        priv = this->private;
+
+        if (!loc->inode || !loc->path)
+                return;
+
+        root = (strcmp (loc->path, "/") == 0);
+        if (!root && (!loc->parent || uuid_is_null (loc->parent->gfid)))
+                return;
+
+        if (dict) {
+                mq_dict_get_int64 (dict, QUOTA_SIZE_KEY, &size);
+                if (!root) {
+                        mq_contri_key (loc->parent->gfid, key);
+                        mq_dict_get_int64 (dict, key, &contri);
+                }
+        }
+
+        LOCK (&priv->quota_lock);
+        {
+                ctx = __mq_inode_ctx_get (this, loc->inode);
+                if (!ctx || ctx->known)
+                        goto unlock;
+
+                ctx->known = _gf_true;
+                if (root)
+                        goto unlock;
+
+                if (IA_ISDIR (buf->ia_type))
+                        actual = size + ctx->size_delta;
+                else if (IA_ISREG (buf->ia_type) || IA_ISLNK (buf->ia_type))
+                        actual = buf->ia_blocks * 512;
+
+                uuid_copy (ctx->parent, loc->parent->gfid);
+                ctx->contri       = actual;
+                ctx->contri_delta = actual - contri;
+
+                if (ctx->contri_delta)
+                        __mq_mark_dirty (this, ctx, NULL);
+        }
+unlock:
+        UNLOCK (&priv->quota_lock);
+}
+
+void
+mq_created (xlator_t *this, loc_t *loc, inode_t *inode, struct iatt *buf)
+{
+        marker_conf_t     *priv = NULL;
+        quota_inode_ctx_t *ctx  = NULL;
+
+        priv = this->private;
+
+        if (!inode || !loc->parent || uuid_is_null (loc->parent->gfid))
+                return;
+
+        LOCK (&priv->quota_lock);
+        {
+                ctx = __mq_inode_ctx_get (this, inode);
+                if (!ctx)
+                        goto unlock;
+
+                ctx->known = _gf_true;
+                uuid_copy (ctx->parent, loc->parent->gfid);
+
+                if (!IA_ISDIR (buf->ia_type))
+                        ctx->contri = buf->ia_blocks * 512;
+                ctx->contri_delta = ctx->contri;
+
+                if (ctx->contri_delta)
+                        __mq_mark_dirty (this, ctx, NULL);
+        }
+unlock:
+        UNLOCK (&priv->quota_lock);
+}
+
+void
+mq_size_changed (xlator_t *this, inode_t *inode, struct iatt *prebuf,
+                 struct iatt *postbuf)
+{
+        marker_conf_t     *priv  = NULL;
+        quota_inode_ctx_t *ctx   = NULL;
+        int64_t            delta = 0;
+
+        priv = this->private;
+
+        if (!inode || !prebuf || !postbuf)
+                return;
+
+        delta = ((int64_t) postbuf->ia_blocks - prebuf->ia_blocks) * 512;
+        if (!delta)
+                return;
+
+        LOCK (&priv->quota_lock);
+        {
+                ctx = __mq_inode_ctx_find (this, inode);
+                if (!ctx || !ctx->known || uuid_is_null (ctx->parent))
+                        goto unlock;
+
+                ctx->contri       += delta;
+                ctx->contri_delta += delta;
+
+                __mq_mark_dirty (this, ctx, NULL);
+        }
+unlock:
+        UNLOCK (&priv->quota_lock);
+}
+
+/* Takes what 'ctx' gave to its parent on disk back out of 'parent' and
+   detaches it. The part still pending was never given. */
+static void
+__mq_detach (xlator_t *this, quota_inode_ctx_t *ctx, inode_t *parent)
+{
+        __mq_parent_add (this, parent, ctx->contri_delta - ctx->contri,
+                         NULL);
+
+        ctx->contri       = 0;
+        ctx->contri_delta = 0;
+}
+
+void
+mq_removed (xlator_t *this, loc_t *loc)
+{
+        marker_conf_t     *priv = NULL;
+        quota_inode_ctx_t *ctx  = NULL;
+
+        priv = this->private;
+
+        if (!loc->inode || !loc->parent)
+                return;
+
+        LOCK (&priv->quota_lock);
+        {
+                ctx = __mq_inode_ctx_find (this, loc->inode);
+                if (!ctx || !ctx->known ||
+                    uuid_compare (ctx->parent, loc->parent->gfid))
+                        goto unlock;
+
+                __mq_detach (this, ctx, loc->parent);
+
+                /* another link, if any, is picked up by its next lookup */
+                uuid_clear (ctx->parent);
+                ctx->known = _gf_false;
+        }
+unlock:
+        UNLOCK (&priv->quota_lock);
+}
+
+void
+mq_renamed (xlator_t *this, loc_t *oldloc, loc_t *newloc)
+{
+        marker_conf_t     *priv  = NULL;
+        quota_inode_ctx_t *ctx   = NULL;
+        call_frame_t      *frame = NULL;
+        loc_t              loc   = {0, };
+        gf_boolean_t       stale = _gf_false;
+        int64_t            contri = 0;
+        char               key[QUOTA_KEY_MAX] = {0,};
+
+        priv = this->private;
+
+        if (!oldloc->inode || !oldloc->parent || !newloc->parent ||
+            uuid_is_null (newloc->parent->gfid))
+                return;
+
+        LOCK (&priv->quota_lock);
+        {
+                ctx = __mq_inode_ctx_find (this, oldloc->inode);
+                if (!ctx || !ctx->known ||
+                    uuid_compare (ctx->parent, oldloc->parent->gfid) ||
+                    !uuid_compare (ctx->parent, newloc->parent->gfid))
+                        goto unlock;
+
+                contri = ctx->contri;
+                __mq_detach (this, ctx, oldloc->parent);
+
+                /* all of it is new to the new parent, whose contri key
+                   does not exist yet */
+                uuid_copy (ctx->parent, newloc->parent->gfid);
+                ctx->contri       = contri;
+                ctx->contri_delta = contri;
+                if (contri)
+                        __mq_mark_dirty (this, ctx, NULL);
+
+                mq_contri_key (oldloc->parent->gfid, key);
+                stale = _gf_true;
+        }
+unlock:
+        UNLOCK (&priv->quota_lock);
+
+        if (!stale)
+                return;
+
+        if (loc_copy (&loc, newloc))
+                return;
+
+        if (loc.inode != oldloc->inode) {
+                if (loc.inode)
+                        inode_unref (loc.inode);
+                loc.inode = inode_ref (oldloc->inode);
+        }
+
+        frame = create_frame (this, this->ctx->pool);
+        if (frame)
+                STACK_WIND (frame, mq_removexattr_cbk, FIRST_CHILD(this),
+                            FIRST_CHILD(this)->fops->removexattr, &loc, key);
+
+        loc_wipe (&loc);
+}
+
+int
+mq_forget (xlator_t *this, inode_t *inode)
+{
+        uint64_t value = 0;
+
+        /* queued inodes are held, nothing to unlink here */
+        if (!inode_ctx_del (inode, this, &value) && value)
+                GF_FREE ((quota_inode_ctx_t *)(long) value);
+
+        return 0;
+}
+
+int
+mq_init (xlator_t *this)
+{
+        marker_conf_t *priv = NULL;
+
+        priv = this->private;
+
+        LOCK_INIT (&priv->quota_lock);
+        INIT_LIST_HEAD (&priv->quota_dirty);
+
+        return 0;
+}
+
+void
+mq_fini (xlator_t *this)
+{
+        marker_conf_t *priv = NULL;
+
+        priv = this->private;
+
+        if (priv->quota_timer) {
+                gf_timer_call_cancel (this->ctx, priv->quota_timer);
+                priv->quota_timer = NULL;
+        }
+
+        LOCK_DESTROY (&priv->quota_lock);
+}
@@ -0,0 +1,84 @@
+/*Copyright (c) 2008-2010 Gluster, Inc. <http://www.gluster.com>
+  This file is part of GlusterFS.
+
+  GlusterFS is free software; you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published
+  by the Free Software Foundation; either version 3 of the License,
+  or (at your option) any later version.
+
+  GlusterFS is distributed in the hope that it will be useful, but
+  WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+  General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see
+  <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef _MARKER_QUOTA_H
+#define _MARKER_QUOTA_H
+
+#ifndef _CONFIG_H
+#define _CONFIG_H
+#include "config.h"
+#endif
+
+#include "xlator.h"
+#include "libxlator.h"
+#include "marker.h"
+
+/* Every directory carries QUOTA_SIZE_KEY, the bytes used below it on this
+ * brick. Every file and directory carries one contribution key per parent,
+ * trusted.glusterfs.quota.<parent-gfid>.contri, the part of the parent's
+ * size it accounts for. Both are int64 in network order and only ever
+ * changed with GF_XATTROP_ADD_ARRAY64, so updates commute.
+ */
+#define QUOTA_CONTRI_KEY_FMT     MARKER_XATTR_PREFIX ".quota.%s.contri"
+#define QUOTA_KEY_MAX            128
+
+#define QUOTA_DEFAULT_INTERVAL   1
+
+struct quota_inode_ctx {
+        int64_t           contri;         /* what this inode adds to 'parent',
+                                             pending changes included */
+        int64_t           contri_delta;   /* not yet written to the contri
+                                             key nor to the parent */
+        int64_t           size_delta;     /* not yet written to the size
+                                             key, directories only */
+        uuid_t            parent;
+        gf_boolean_t      known;          /* contri matches the disk */
+        inode_t          *inode;
+        struct list_head  dirty;
+};
+typedef struct quota_inode_ctx quota_inode_ctx_t;
+
+int
+mq_init (xlator_t *this);
+
+void
+mq_fini (xlator_t *this);
+
+int
+mq_forget (xlator_t *this, inode_t *inode);
+
+dict_t *
+mq_lookup_xattr_req (xlator_t *this, loc_t *loc, dict_t *xattr_req);
+
+void
+mq_lookup_done (xlator_t *this, loc_t *loc, struct iatt *buf, dict_t *dict);
+
+void
+mq_created (xlator_t *this, loc_t *loc, inode_t *inode, struct iatt *buf);
+
+void
+mq_size_changed (xlator_t *this, inode_t *inode, struct iatt *prebuf,
+                 struct iatt *postbuf);
+
+void
+mq_removed (xlator_t *this, loc_t *loc);
+
+void
+mq_renamed (xlator_t *this, loc_t *oldloc, loc_t *newloc);
+
+#endif
@@ -25,14 +25,12 @@
 #include "defaults.h"
 #include "libxlator.h"
 #include "marker.h"
+#include "marker-quota.h"
 #include "marker-mem-types.h"
 
 void
 fini (xlator_t *this);
 
-int32_t
-marker_start_setxattr (call_frame_t *, xlator_t *);
-
 int
 marker_loc_fill (loc_t *loc, inode_t *inode, inode_t *parent, char *path)
 {
@@ -108,24 +106,6 @@ err:
         return ret;
 }
 
-int32_t
-marker_trav_parent (marker_local_t *local)
-{
-        int32_t ret = 0;
-        loc_t   loc = {0, };
-
-        ret = marker_inode_loc_fill (local->loc.parent, &loc);
-
-        if (ret == -1)
-                goto out;
-
-        loc_wipe (&local->loc);
-
-        local->loc = loc;
-out:
-        return ret;
-}
-
 int32_t
 marker_error_handler (xlator_t *this)
 {
@@ -252,128 +232,392 @@ marker_getxattr (call_frame_t *frame, xlator_t *this, loc_t *loc,
 }
 
 
-int32_t
-marker_setxattr_done (call_frame_t *frame)
+/* xtime updates are not written on every fop. The modified inode and its
+ * ancestors are put in a dirty set, and every xtime-update-interval seconds
+ * the set is written out, one setxattr at a time and every inode before its
+ * parent, with the time of the flush. So an ancestor never carries an xtime
+ * older than one of its descendants, and each of them is written at most
+ * once per interval however many fops went below it.
+ *
+ * While an inode is in the set so are its ancestors: a walk up the tree
+ * stops at the first one which is already there. The set is kept in the
+ * order it is flushed in, a newly dirtied chain going in front of the
+ * older entries, which can only be its ancestors.
+ */
+
+#define MARKER_XTIME_HASH_SIZE 1024
+
+struct marker_xtime_entry {
+        struct list_head  hash;
+        struct list_head  list;
+        inode_t          *inode;
+};
+typedef struct marker_xtime_entry marker_xtime_entry_t;
+
+struct marker_xtime_flush {
+        struct list_head  batch;
+        uint32_t          timebuf[2];
+        loc_t             loc;
+};
+typedef struct marker_xtime_flush marker_xtime_flush_t;
+
+static void
+marker_xtime_timer_cbk (void *data);
+
+static inline struct list_head *
+__marker_xtime_bucket (marker_conf_t *priv, inode_t *inode)
 {
-        marker_local_t *local = NULL;
+        return &priv->xtime_hash[((unsigned long) inode >> 6)
+                                 % MARKER_XTIME_HASH_SIZE];
+}
 
-        local = (marker_local_t *) frame->local;
+static marker_xtime_entry_t *
+__marker_xtime_find (marker_conf_t *priv, inode_t *inode)
+{
+        marker_xtime_entry_t *entry = NULL;
 
-        frame->local = NULL;
+        list_for_each_entry (entry, __marker_xtime_bucket (priv, inode),
+                             hash) {
+                if (entry->inode == inode)
+                        return entry;
+        }
 
-        STACK_DESTROY (frame->root);
+        return NULL;
+}
 
-        marker_free_local (local);
+static void
+__marker_xtime_arm (xlator_t *this)
+{
+        marker_conf_t  *priv  = NULL;
+        struct timeval  delta = {0, };
 
-        return 0;
+        priv = this->private;
+
+        if (priv->xtime_timer || priv->xtime_flushing ||
+            list_empty (&priv->xtime_dirty))
+                return;
+
+        delta.tv_sec = priv->xtime_interval;
+        priv->xtime_timer = gf_timer_call_after (this->ctx, delta,
+                                                 marker_xtime_timer_cbk,
+                                                 this);
 }
 
-int
-marker_specific_setxattr_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
-                              int32_t op_ret, int32_t op_errno)
+/* the event of a timer which fired stays around until it is cancelled */
+static void
+__marker_xtime_disarm (xlator_t *this)
 {
-        int32_t         ret   = 0;
-        int32_t         done  = 0;
-        marker_local_t *local = NULL;
+        marker_conf_t *priv = NULL;
 
-        local = (marker_local_t*) frame->local;
+        priv = this->private;
 
-        if (op_ret == -1 && op_errno == ENOSPC) {
-                marker_error_handler (this);
-                done = 1;
-                goto out;
+        if (priv->xtime_timer) {
+                gf_timer_call_cancel (this->ctx, priv->xtime_timer);
+                priv->xtime_timer = NULL;
         }
+}
 
-        if (strcmp (local->loc.path, "/") == 0) {
-                done = 1;
-                goto out;
+/* puts 'inode', or the parent of 'loc' when there is none, and all their
+   ancestors in the dirty set */
+void
+marker_xtime_mark (xlator_t *this, loc_t *loc)
+{
+        marker_conf_t        *priv   = NULL;
+        marker_xtime_entry_t *entry  = NULL;
+        inode_t              *trav   = NULL;
+        inode_t              *parent = NULL;
+        int                   leaf   = 0;
+        int                   dirty  = 0;
+        struct list_head      chain;
+
+        priv = this->private;
+
+        INIT_LIST_HEAD (&chain);
+
+        if (loc->inode) {
+                trav   = inode_ref (loc->inode);
+                parent = loc->parent ? inode_ref (loc->parent) : NULL;
+                leaf   = 1;
+        } else if (loc->parent) {
+                trav   = inode_ref (loc->parent);
         }
 
-        ret = marker_trav_parent (local);
+        while (trav) {
+                dirty = 0;
+
+                LOCK (&priv->xtime_lock);
+                {
+                        entry = __marker_xtime_find (priv, trav);
+                        if (entry) {
+                                dirty = 1;
+                                /* a renamed or new link keeps its place
+                                   below its new parent */
+                                if (leaf)
+                                        list_move_tail (&entry->list, &chain);
+                        } else {
+                                entry = GF_CALLOC (1, sizeof (*entry),
+                                                   gf_marker_mt_xtime_entry_t);
+                                if (entry) {
+                                        entry->inode = trav;
+                                        list_add (&entry->hash,
+                                                  __marker_xtime_bucket (priv,
+                                                                         trav));
+                                        list_add_tail (&entry->list, &chain);
+                                }
+                        }
+                }
+                UNLOCK (&priv->xtime_lock);
+
+                if (!entry) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "out of memory :(");
+                        inode_unref (trav);
+                        break;
+                }
 
-        if (ret == -1) {
-                gf_log (this->name, GF_LOG_DEBUG, "Error occured "
-                        "while traversing to the parent, stopping marker");
+                /* from here on its ancestors are dirty too */
+                if (dirty && !leaf) {
+                        inode_unref (trav);
+                        break;
+                }
 
-                done = 1;
+                if (!parent)
+                        parent = inode_parent (trav, 0, NULL);
 
-                goto out;
+                /* a new entry keeps the ref taken on 'trav' */
+                if (dirty)
+                        inode_unref (trav);
+
+                trav   = parent;
+                parent = NULL;
+                leaf   = 0;
         }
 
-        marker_start_setxattr (frame, this);
+        if (parent)
+                inode_unref (parent);
 
-out:
-        if (done) {
-                marker_setxattr_done (frame);
+        LOCK (&priv->xtime_lock);
+        {
+                list_splice (&chain, &priv->xtime_dirty);
+                __marker_xtime_arm (this);
+        }
+        UNLOCK (&priv->xtime_lock);
+}
+
+static void
+marker_xtime_flush_next (call_frame_t *frame, xlator_t *this);
+
+int
+marker_xtime_setxattr_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                           int32_t op_ret, int32_t op_errno)
+{
+        marker_xtime_flush_t *flush = NULL;
+        marker_xtime_entry_t *entry = NULL;
+        marker_xtime_entry_t *tmp   = NULL;
+
+        flush = frame->local;
+
+        loc_wipe (&flush->loc);
+
+        if (op_ret == -1 && op_errno == ENOSPC) {
+                marker_error_handler (this);
+
+                list_for_each_entry_safe (entry, tmp, &flush->batch, list) {
+                        list_del (&entry->list);
+                        inode_unref (entry->inode);
+                        GF_FREE (entry);
+                }
         }
 
+        marker_xtime_flush_next (frame, this);
+
         return 0;
 }
 
-int32_t
-marker_start_setxattr (call_frame_t *frame, xlator_t *this)
+/* winds the setxattr of the next inode of the batch which can still be
+   reached by path, finishes the flush when there is none */
+static void
+marker_xtime_flush_next (call_frame_t *frame, xlator_t *this)
 {
-        int32_t          ret   = 0;
-        dict_t          *dict  = NULL;
-        marker_local_t  *local = NULL;
-        marker_conf_t   *priv  = NULL;
+        marker_conf_t        *priv  = NULL;
+        marker_xtime_flush_t *flush = NULL;
+        marker_xtime_entry_t *entry = NULL;
+        dict_t               *dict  = NULL;
+        int                   ret   = -1;
 
-        priv = this->private;
+        priv  = this->private;
+        flush = frame->local;
 
-        local = (marker_local_t*) frame->local;
+        while (!list_empty (&flush->batch)) {
+                entry = list_entry (flush->batch.next, marker_xtime_entry_t,
+                                    list);
+                list_del (&entry->list);
 
-        dict = dict_new ();
+                ret = marker_inode_loc_fill (entry->inode, &flush->loc);
 
-        ret = dict_set_static_bin (dict, priv->marker_xattr,
-                                   (void *)local->timebuf, 8);
+                inode_unref (entry->inode);
+                GF_FREE (entry);
 
-        gf_log (this->name, GF_LOG_DEBUG, "path = %s", local->loc.path);
+                if (ret == 0)
+                        break;
+        }
 
-        STACK_WIND (frame, marker_specific_setxattr_cbk, FIRST_CHILD(this),
-                    FIRST_CHILD(this)->fops->setxattr, &local->loc, dict, 0);
+        if (ret) {
+                frame->local = NULL;
+                STACK_DESTROY (frame->root);
+                GF_FREE (flush);
 
-        dict_unref (dict);
+                LOCK (&priv->xtime_lock);
+                {
+                        priv->xtime_flushing = 0;
+                        __marker_xtime_arm (this);
+                }
+                UNLOCK (&priv->xtime_lock);
 
-        return 0;
+                return;
+        }
+
+        dict = dict_new ();
+        if (dict)
+                ret = dict_set_static_bin (dict, priv->marker_xattr,
+                                           (void *)flush->timebuf, 8);
+        if (!dict || ret) {
+                gf_log (this->name, GF_LOG_ERROR, "out of memory :(");
+                if (dict)
+                        dict_unref (dict);
+                marker_xtime_setxattr_cbk (frame, NULL, this, -1, ENOMEM);
+                return;
+        }
+
+        gf_log (this->name, GF_LOG_DEBUG, "path = %s", flush->loc.path);
+
+        STACK_WIND (frame, marker_xtime_setxattr_cbk, FIRST_CHILD(this),
+                    FIRST_CHILD(this)->fops->setxattr, &flush->loc, dict, 0);
+
+        dict_unref (dict);
 }
 
-void
-marker_gettimeofday (marker_local_t *local)
+static void
+marker_xtime_flush (xlator_t *this)
 {
-        struct timeval tv;
+        marker_conf_t        *priv  = NULL;
+        marker_xtime_flush_t *flush = NULL;
+        marker_xtime_entry_t *entry = NULL;
+        call_frame_t         *frame = NULL;
+        struct timeval        tv    = {0, };
+
+        priv = this->private;
+
+        flush = GF_CALLOC (1, sizeof (*flush), gf_marker_mt_xtime_flush_t);
+        frame = create_frame (this, this->ctx->pool);
+        if (!flush || !frame) {
+                gf_log (this->name, GF_LOG_ERROR, "out of memory :(");
+                if (flush)
+                        GF_FREE (flush);
+                if (frame)
+                        STACK_DESTROY (frame->root);
+
+                LOCK (&priv->xtime_lock);
+                {
+                        __marker_xtime_disarm (this);
+                        __marker_xtime_arm (this);
+                }
+                UNLOCK (&priv->xtime_lock);
+                return;
+        }
+
+        INIT_LIST_HEAD (&flush->batch);
+
+        LOCK (&priv->xtime_lock);
+        {
+                list_splice_init (&priv->xtime_dirty, &flush->batch);
+                list_for_each_entry (entry, &flush->batch, list)
+                        list_del_init (&entry->hash);
+
+                __marker_xtime_disarm (this);
+                priv->xtime_flushing = 1;
+        }
+        UNLOCK (&priv->xtime_lock);
 
         gettimeofday (&tv, NULL);
+        flush->timebuf[0] = htonl (tv.tv_sec);
+        flush->timebuf[1] = htonl (tv.tv_usec);
 
-        local->timebuf [0] = htonl (tv.tv_sec);
-        local->timebuf [1] = htonl (tv.tv_usec);
+        frame->local = flush;
 
-        return;
+        marker_xtime_flush_next (frame, this);
 }
 
-int32_t
-marker_create_frame (xlator_t *this, marker_local_t *local)
+static void
+marker_xtime_timer_cbk (void *data)
 {
-        call_frame_t *frame = NULL;
+        xlator_t *this = data;
 
-        frame = create_frame (this, this->ctx->pool);
+        THIS = this;
+
+        marker_xtime_flush (this);
+}
+
+int
+marker_xtime_init (xlator_t *this)
+{
+        marker_conf_t *priv = NULL;
+        int            i    = 0;
+
+        priv = this->private;
+
+        LOCK_INIT (&priv->xtime_lock);
+        INIT_LIST_HEAD (&priv->xtime_dirty);
+        priv->xtime_interval = MARKER_XTIME_DEFAULT_INTERVAL;
 
-        frame->local = (void *) local;
+        priv->xtime_hash = GF_CALLOC (MARKER_XTIME_HASH_SIZE,
+                                      sizeof (struct list_head),
+                                      gf_marker_mt_list_head);
+        if (!priv->xtime_hash) {
+                gf_log (this->name, GF_LOG_ERROR, "out of memory :(");
+                return -1;
+        }
 
-        marker_start_setxattr (frame, this);
+        for (i = 0; i < MARKER_XTIME_HASH_SIZE; i++)
+                INIT_LIST_HEAD (&priv->xtime_hash[i]);
 
         return 0;
 }
 
+void
+marker_xtime_fini (xlator_t *this)
+{
+        marker_conf_t        *priv  = NULL;
+        marker_xtime_entry_t *entry = NULL;
+        marker_xtime_entry_t *tmp   = NULL;
+
+        priv = this->private;
+
+        __marker_xtime_disarm (this);
+
+        list_for_each_entry_safe (entry, tmp, &priv->xtime_dirty, list) {
+                list_del (&entry->list);
+                inode_unref (entry->inode);
+                GF_FREE (entry);
+        }
+
+        if (priv->xtime_hash)
+                GF_FREE (priv->xtime_hash);
+
+        LOCK_DESTROY (&priv->xtime_lock);
+}
+
 int32_t
 update_marks (xlator_t *this, marker_local_t *local, int32_t ret)
 {
-        if (ret == -1 || local->pid < 0)
-                marker_free_local (local);
-        else {
-                marker_gettimeofday (local);
+        marker_conf_t *priv = NULL;
 
-                marker_create_frame (this, local);
-        }
+        priv = this->private;
+
+        if (ret != -1 && local->pid >= 0 && priv->xtime)
+                marker_xtime_mark (this, &local->loc);
+
+        marker_free_local (local);
 
         return 0;
 }
@@ -386,6 +630,7 @@ marker_mkdir_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 {
         int32_t             ret     = 0;
         marker_local_t     *local   = NULL;
+        marker_conf_t      *priv    = NULL;
 
         if (op_ret == -1) {
                 gf_log (this->name, GF_LOG_ERROR, "error occurred "
@@ -397,6 +642,10 @@ marker_mkdir_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 
         frame->local = NULL;
 
+        priv = this->private;
+        if ((op_ret >= 0) && priv->quota)
+                mq_created (this, &local->loc, inode, buf);
+
         STACK_UNWIND_STRICT (mkdir, frame, op_ret, op_errno, inode,
                              buf, preparent, postparent);
 
@@ -439,6 +688,7 @@ marker_create_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 {
         int32_t             ret     = 0;
         marker_local_t     *local   = NULL;
+        marker_conf_t      *priv    = NULL;
 
         if (op_ret == -1) {
                 gf_log (this->name, GF_LOG_ERROR, "error occurred "
@@ -450,6 +700,10 @@ marker_create_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 
         frame->local = NULL;
 
+        priv = this->private;
+        if ((op_ret >= 0) && priv->quota)
+                mq_created (this, &local->loc, inode, buf);
+
         STACK_UNWIND_STRICT (create, frame, op_ret, op_errno, fd, inode, buf,
                              preparent, postparent);
 
@@ -491,6 +745,7 @@ marker_writev_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 {
         int32_t             ret     = 0;
         marker_local_t     *local   = NULL;
+        marker_conf_t      *priv    = NULL;
 
         if (op_ret == -1) {
                 gf_log (this->name, GF_LOG_ERROR, "error occurred "
@@ -502,6 +757,10 @@ marker_writev_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 
         frame->local = NULL;
 
+        priv = this->private;
+        if ((op_ret >= 0) && priv->quota)
+                mq_size_changed (this, local->loc.inode, prebuf, postbuf);
+
         STACK_UNWIND_STRICT (writev, frame, op_ret, op_errno, prebuf, postbuf);
 
         update_marks (this, local, ret);
@@ -547,6 +806,7 @@ marker_rmdir_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 {
         int32_t             ret     = 0;
         marker_local_t     *local   = NULL;
+        marker_conf_t      *priv    = NULL;
 
         if (op_ret == -1) {
                 gf_log (this->name, GF_LOG_ERROR, "error occurred "
@@ -558,6 +818,10 @@ marker_rmdir_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 
         frame->local = NULL;
 
+        priv = this->private;
+        if ((op_ret >= 0) && priv->quota)
+                mq_removed (this, &local->loc);
+
         STACK_UNWIND_STRICT (rmdir, frame, op_ret, op_errno, preparent,
                              postparent);
 
@@ -597,6 +861,7 @@ marker_unlink_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 {
         int32_t             ret     = 0;
         marker_local_t     *local   = NULL;
+        marker_conf_t      *priv    = NULL;
 
         if (op_ret == -1) {
                 gf_log (this->name, GF_LOG_ERROR,
@@ -609,6 +874,10 @@ marker_unlink_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 
         frame->local = NULL;
 
+        priv = this->private;
+        if ((op_ret >= 0) && priv->quota)
+                mq_removed (this, &local->loc);
+
         STACK_UNWIND_STRICT (unlink, frame, op_ret, op_errno, preparent,
                              postparent);
 
@@ -701,6 +970,7 @@ marker_rename_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
         int32_t             ret     = 0;
         marker_local_t     *local   = NULL;
         marker_local_t	   *oplocal = NULL;
+        marker_conf_t      *priv    = NULL;
 
         if (op_ret == -1) {
                 gf_log (this->name, GF_LOG_ERROR, "%s occured while "
@@ -712,6 +982,16 @@ marker_rename_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 
         frame->local = NULL;
 
+        priv = this->private;
+        if ((op_ret >= 0) && priv->quota) {
+                /* an existing target got replaced */
+                if (local->loc.inode &&
+                    (local->loc.inode != local->oplocal->loc.inode))
+                        mq_removed (this, &local->loc);
+
+                mq_renamed (this, &local->oplocal->loc, &local->loc);
+        }
+
         STACK_UNWIND_STRICT (rename, frame, op_ret, op_errno, buf, preoldparent,
                              postoldparent, prenewparent, postnewparent);
 
@@ -770,6 +1050,7 @@ marker_truncate_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 {
         int32_t             ret     = 0;
         marker_local_t     *local   = NULL;
+        marker_conf_t      *priv    = NULL;
 
         if (op_ret == -1) {
                 gf_log (this->name, GF_LOG_ERROR, "%s occured while "
@@ -781,6 +1062,10 @@ marker_truncate_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 
         frame->local = NULL;
 
+        priv = this->private;
+        if ((op_ret >= 0) && priv->quota)
+                mq_size_changed (this, local->loc.inode, prebuf, postbuf);
+
         STACK_UNWIND_STRICT (truncate, frame, op_ret, op_errno, prebuf,
                              postbuf);
 
@@ -820,6 +1105,7 @@ marker_ftruncate_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 {
         int32_t             ret     = 0;
         marker_local_t     *local   = NULL;
+        marker_conf_t      *priv    = NULL;
 
         if (op_ret == -1) {
                 gf_log (this->name, GF_LOG_ERROR, "%s occured while "
@@ -831,6 +1117,10 @@ marker_ftruncate_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 
         frame->local = NULL;
 
+        priv = this->private;
+        if ((op_ret >= 0) && priv->quota)
+                mq_size_changed (this, local->loc.inode, prebuf, postbuf);
+
         STACK_UNWIND_STRICT (ftruncate, frame, op_ret, op_errno, prebuf,
                              postbuf);
 
@@ -871,6 +1161,7 @@ marker_symlink_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 {
         int32_t             ret     = 0;
         marker_local_t     *local   = NULL;
+        marker_conf_t      *priv    = NULL;
 
         if (op_ret == -1) {
                 gf_log (this->name, GF_LOG_ERROR, "%s occured while "
@@ -882,6 +1173,10 @@ marker_symlink_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 
         frame->local = NULL;
 
+        priv = this->private;
+        if ((op_ret >= 0) && priv->quota)
+                mq_created (this, &local->loc, inode, buf);
+
         STACK_UNWIND_STRICT (symlink, frame, op_ret, op_errno, inode, buf,
                              preparent, postparent);
 
@@ -923,6 +1218,7 @@ marker_mknod_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 {
         int32_t             ret     = 0;
         marker_local_t     *local   = NULL;
+        marker_conf_t      *priv    = NULL;
 
         if (op_ret == -1) {
                 gf_log (this->name, GF_LOG_ERROR, "%s occured while "
@@ -934,6 +1230,10 @@ marker_mknod_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 
         frame->local = NULL;
 
+        priv = this->private;
+        if ((op_ret >= 0) && priv->quota)
+                mq_created (this, &local->loc, inode, buf);
+
         STACK_UNWIND_STRICT (mknod, frame, op_ret, op_errno, inode,
                              buf, preparent, postparent);
 
@@ -1282,6 +1582,78 @@ err:
         return 0;
 }
 
+int32_t
+marker_lookup_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                   int32_t op_ret, int32_t op_errno, inode_t *inode,
+                   struct iatt *buf, dict_t *dict, struct iatt *postparent)
+{
+        marker_local_t     *local   = NULL;
+
+        local = (marker_local_t *) frame->local;
+
+        frame->local = NULL;
+
+        if (op_ret >= 0)
+                mq_lookup_done (this, &local->loc, buf, dict);
+
+        STACK_UNWIND_STRICT (lookup, frame, op_ret, op_errno, inode, buf,
+                             dict, postparent);
+
+        marker_free_local (local);
+
+        return 0;
+}
+
+int32_t
+marker_lookup (call_frame_t *frame, xlator_t *this, loc_t *loc,
+               dict_t *xattr_req)
+{
+        int32_t          ret   = 0;
+        marker_local_t  *local = NULL;
+        marker_conf_t   *priv  = NULL;
+        dict_t          *dict  = NULL;
+
+        priv = this->private;
+
+        if (!priv->quota)
+                goto wind;
+
+        ALLOCATE_OR_GOTO (local, marker_local_t, err);
+
+        MARKER_INIT_LOCAL (frame, local);
+
+        ret = loc_copy (&local->loc, loc);
+
+        if (ret == -1)
+                goto err;
+
+        dict = mq_lookup_xattr_req (this, loc, xattr_req);
+
+        STACK_WIND (frame, marker_lookup_cbk, FIRST_CHILD(this),
+                    FIRST_CHILD(this)->fops->lookup, loc,
+                    dict ? dict : xattr_req);
+
+        if (dict)
+                dict_unref (dict);
+
+        return 0;
+wind:
+        STACK_WIND (frame, default_lookup_cbk, FIRST_CHILD(this),
+                    FIRST_CHILD(this)->fops->lookup, loc, xattr_req);
+        return 0;
+err:
+        STACK_UNWIND_STRICT (lookup, frame, -1, ENOMEM, NULL, NULL, NULL,
+                             NULL);
+
+        return 0;
+}
+
+int32_t
+marker_forget (xlator_t *this, inode_t *inode)
+{
+        return mq_forget (this, inode);
+}
+
 int32_t
 mem_acct_init (xlator_t *this)
 {
@@ -1327,6 +1699,12 @@ init (xlator_t *this)
 
         priv = this->private;
 
+        mq_init (this);
+
+        ret = marker_xtime_init (this);
+        if (ret)
+                goto err;
+
         if( (data = dict_get (options, VOLUME_UUID)) != NULL) {
                 priv->volume_uuid = data->data;
 
@@ -1376,6 +1754,44 @@ init (xlator_t *this)
                 goto err;
         }
 
+        priv->xtime = _gf_true;
+        if ((data = dict_get (options, "xtime")) != NULL) {
+                ret = gf_string2boolean (data->data, &priv->xtime);
+                if (ret == -1) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "invalid value %s for xtime", data->data);
+                        goto err;
+                }
+        }
+
+        if ((data = dict_get (options, "quota")) != NULL) {
+                ret = gf_string2boolean (data->data, &priv->quota);
+                if (ret == -1) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "invalid value %s for quota", data->data);
+                        goto err;
+                }
+        }
+
+        priv->quota_interval = QUOTA_DEFAULT_INTERVAL;
+        if ((data = dict_get (options, "quota-update-interval")) != NULL) {
+                ret = gf_string2time (data->data, &priv->quota_interval);
+                if ((ret == -1) || !priv->quota_interval) {
+                        gf_log (this->name, GF_LOG_ERROR, "invalid value "
+                                "%s for quota-update-interval", data->data);
+                        goto err;
+                }
+        }
+
+        if ((data = dict_get (options, "xtime-update-interval")) != NULL) {
+                ret = gf_string2time (data->data, &priv->xtime_interval);
+                if ((ret == -1) || !priv->xtime_interval) {
+                        gf_log (this->name, GF_LOG_ERROR, "invalid value "
+                                "%s for xtime-update-interval", data->data);
+                        goto err;
+                }
+        }
+
         return 0;
 err:
         fini (this);
@@ -1402,12 +1818,17 @@ fini (xlator_t *this)
         if (priv->marker_xattr != NULL)
                 GF_FREE (priv->marker_xattr);
 
+        mq_fini (this);
+
+        marker_xtime_fini (this);
+
         GF_FREE (priv);
 out:
         return ;
 }
 
 struct xlator_fops fops = {
+        .lookup      = marker_lookup,
         .create      = marker_create,
         .unlink      = marker_unlink,
         .link        = marker_link,
@@ -1428,10 +1849,19 @@ struct xlator_fops fops = {
 };
 
 struct xlator_cbks cbks = {
+        .forget      = marker_forget,
 };
 
 struct volume_options options[] = {
         {.key = {"volume-uuid"}},
         {.key = {"timestamp-file"}},
+        {.key = {"xtime"},
+         .type = GF_OPTION_TYPE_BOOL},
+        {.key = {"quota"},
+         .type = GF_OPTION_TYPE_BOOL},
+        {.key = {"quota-update-interval"},
+         .type = GF_OPTION_TYPE_TIME},
+        {.key = {"xtime-update-interval"},
+         .type = GF_OPTION_TYPE_TIME},
         {.key = {NULL}}
 };
@@ -16,6 +16,9 @@
   <http://www.gnu.org/licenses/>.
 */
 
+#ifndef _MARKER_H
+#define _MARKER_H
+
 #ifndef _CONFIG_H
 #define _CONFIG_H
 #include "config.h"
@@ -24,6 +27,7 @@
 #include "xlator.h"
 #include "defaults.h"
 #include "uuid.h"
+#include "timer.h"
 
 #define MARKER_XATTR_PREFIX "trusted.glusterfs"
 #define XTIME               "xtime"
@@ -31,6 +35,8 @@
 #define VOLUME_UUID         "volume-uuid"
 #define TIMESTAMP_FILE      "timestamp-file"
 
+#define MARKER_XTIME_DEFAULT_INTERVAL 1
+
 /*initialize the local variable*/
 #define MARKER_INIT_LOCAL(_frame,_local) do {                   \
                 _frame->local = _local;                         \
@@ -51,7 +57,6 @@
         } while (0)
 
 struct marker_local{
-        uint32_t        timebuf[2];
         pid_t           pid;
         loc_t           loc;
 
@@ -64,5 +69,26 @@ struct marker_conf{
         uuid_t      volume_uuid_bin;
         char        *timestamp_file;
         char        *marker_xattr;
+        gf_boolean_t xtime;
+
+        /* batched xtime updates, see marker_xtime_mark() */
+        uint32_t          xtime_interval;
+        gf_lock_t         xtime_lock;
+        struct list_head *xtime_hash;
+        struct list_head  xtime_dirty;
+        gf_timer_t       *xtime_timer;
+        char              xtime_flushing;
+
+        /* quota accounting, see marker-quota.c */
+        gf_boolean_t      quota;
+        uint32_t          quota_interval;
+        gf_lock_t         quota_lock;
+        struct list_head  quota_dirty;
+        gf_timer_t       *quota_timer;
 };
 typedef struct marker_conf marker_conf_t;
+
+int
+marker_inode_loc_fill (inode_t *inode, loc_t *loc);
+
+#endif
@@ -23,7 +23,7 @@
 #include "mem-types.h"
 
 enum gf_quota_mem_types_ {
-        gf_quota_mt_quota_local = gf_common_mt_end + 1,
+        gf_quota_mt_quota_limit = gf_common_mt_end + 1,
         gf_quota_mt_quota_priv,
         gf_quota_mt_end
 };
@@ -27,23 +27,29 @@
 #include "xlator.h"
 #include "defaults.h"
 #include "common-utils.h"
+#include "byte-order.h"
+#include "libxlator.h"
 #include "quota-mem-types.h"
 
-#ifndef MAX_IOVEC
-#define MAX_IOVEC 16
-#endif
-
-struct quota_local {
-	struct iatt    stbuf;
-	inode_t       *inode;
-	char          *path;
-	fd_t          *fd;
-	off_t          offset;
-	int32_t        count;
-	struct iovec   vector[MAX_IOVEC];
-	struct iobref *iobref;
-	loc_t          loc;
-        int            flags;
+/* Directory limits are enforced against the usage the bricks keep in
+ * QUOTA_SIZE_KEY (see features/marker). The usage of a limited directory
+ * is read in the background every 'timeout' seconds; in between, the
+ * changes seen by this client are added to it. Fops themselves never wait
+ * for the bricks.
+ */
+
+#define QUOTA_DEFAULT_TIMEOUT 5
+
+struct quota_limit {
+	struct list_head  list;
+	char             *path;
+	int64_t           value;           /* bytes, 0 when not limited */
+	int64_t           size;            /* as last read from the bricks */
+	int64_t           pending;         /* changes seen since */
+	int64_t           refresh_pending; /* 'pending' when the read was sent */
+	uint32_t          refreshed;       /* when the read was sent */
+	char              refreshing;
+	loc_t             loc;             /* set once the directory is looked up */
 };
 
 
@@ -51,8 +57,8 @@ struct quota_priv {
 	char       only_first_time;          /* Used to make sure a call is done only one time */
 	gf_lock_t  lock;                     /* Used while updating variables */
 
-	uint64_t   disk_usage_limit;         /* Used for Disk usage quota */
-	uint64_t   current_disk_usage;       /* Keep the current usage value */
+	struct list_head limits;             /* Directory limits */
+	uint32_t   timeout;                  /* seconds a cached usage is trusted */
 
 	uint32_t   min_free_disk_limit;        /* user specified limit, in %*/
 	uint32_t   current_free_disk;          /* current free disk space available, in % */
@@ -79,37 +85,6 @@ quota_statvfs_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 }
 
 
-void
-gf_quota_usage_subtract (xlator_t *this, size_t size)
-{
-	struct quota_priv *priv = NULL;
-
-	priv = this->private;
-
-	LOCK (&priv->lock);
-	{
-		if (priv->current_disk_usage < size)
-			priv->current_disk_usage = 0;
-		else
-			priv->current_disk_usage -= size;
-	}
-	UNLOCK (&priv->lock);
-}
-
-
-void
-gf_quota_usage_add (xlator_t *this, size_t size)
-{
-	struct quota_priv *priv = this->private;
-
-	LOCK (&priv->lock);
-	{
-		priv->current_disk_usage += size;
-	}
-	UNLOCK (&priv->lock);
-}
-
-
 void 
 gf_quota_update_current_free_disk (xlator_t *this)
 {
@@ -154,228 +129,183 @@ gf_quota_check_free_disk (xlator_t *this)
 
 
 int
-quota_truncate_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
-		    int32_t op_ret, int32_t op_errno, struct iatt *prebuf,
-                    struct iatt *postbuf)
+quota_refresh_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+		   int32_t op_ret, int32_t op_errno, dict_t *dict)
 {
-	struct quota_priv *priv = this->private;
-	struct quota_local *local = NULL;
+	struct quota_priv  *priv  = NULL;
+	struct quota_limit *limit = NULL;
+	data_t             *data  = NULL;
+	int64_t             size  = 0;
 
-	local = frame->local;
+	priv  = this->private;
+	limit = cookie;
 
-	if ((op_ret >= 0) && priv->disk_usage_limit) {
-		gf_quota_usage_subtract (this, (local->stbuf.ia_blocks -
-						postbuf->ia_blocks) * 512);
-		loc_wipe (&local->loc);
+	if (op_ret >= 0) {
+		data = dict_get (dict, QUOTA_SIZE_KEY);
+		if (data && (data->len == sizeof (int64_t)))
+			size = ntoh64 (*(int64_t *)data->data);
+	} else if (op_errno != ENODATA) {
+		gf_log (this->name, GF_LOG_DEBUG,
+			"failed to read the usage of %s (%s)",
+			limit->path, strerror (op_errno));
 	}
 
-	STACK_UNWIND_STRICT (truncate, frame, op_ret, op_errno,
-                             prebuf, postbuf);
-	return 0;
-}
-
-
-int
-quota_truncate_stat_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
-			 int32_t op_ret, int32_t op_errno, struct iatt *buf)
-{
-	struct quota_local *local = NULL;
-
-	local = frame->local;
-
-	if (op_ret >= 0) {
-		local->stbuf = *buf;
+	LOCK (&priv->lock);
+	{
+		if ((op_ret >= 0) || (op_errno == ENODATA)) {
+			limit->size     = size;
+			limit->pending -= limit->refresh_pending;
+		}
+		limit->refreshing = 0;
 	}
+	UNLOCK (&priv->lock);
 
-	STACK_WIND (frame, quota_truncate_cbk,
-		    FIRST_CHILD (this), FIRST_CHILD (this)->fops->truncate,
-		    &local->loc, local->offset);
+	STACK_DESTROY (frame->root);
 	return 0;
 }
 
 
-int
-quota_truncate (call_frame_t *frame, xlator_t *this,
-		loc_t *loc, off_t offset)
+void
+quota_refresh (xlator_t *this, struct quota_limit *limit)
 {
-	struct quota_local *local = NULL;
-	struct quota_priv  *priv = NULL;
-
-	priv = this->private;
-
-	if (priv->disk_usage_limit) {
-		local = GF_CALLOC (1, sizeof (struct quota_local),
-                                   gf_quota_mt_quota_local);
-		frame->local  = local;
-
-		loc_copy (&local->loc, loc);
-		local->offset = offset;
+	call_frame_t *frame = NULL;
 
-		STACK_WIND (frame, quota_truncate_stat_cbk,
-			    FIRST_CHILD(this),
-			    FIRST_CHILD(this)->fops->stat, loc);
-		return 0;
+	frame = create_frame (this, this->ctx->pool);
+	if (!frame) {
+		limit->refreshing = 0;
+		return;
 	}
 
-	STACK_WIND (frame, quota_truncate_cbk,
-		    FIRST_CHILD(this),
-		    FIRST_CHILD(this)->fops->truncate,
-		    loc, offset);
-	return 0;
+	STACK_WIND_COOKIE (frame, quota_refresh_cbk, limit,
+			   FIRST_CHILD (this),
+			   FIRST_CHILD (this)->fops->getxattr,
+			   &limit->loc, QUOTA_SIZE_KEY);
 }
 
 
+/* Walks up from 'inode', adding 'delta' to the usage of every limited
+   directory on the way. Returns -1 if one of them is at its limit. */
 int
-quota_ftruncate_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
-		     int32_t op_ret, int32_t op_errno, struct iatt *prebuf,
-                     struct iatt *postbuf)
+quota_check_limit (xlator_t *this, inode_t *inode, int64_t delta)
 {
-	struct quota_priv  *priv = NULL;
-	struct quota_local *local = NULL;
+	struct quota_priv  *priv    = NULL;
+	struct quota_limit *limit   = NULL;
+	struct quota_limit *refresh = NULL;
+	inode_t            *trav    = NULL;
+	inode_t            *parent  = NULL;
+	struct timeval      tv      = {0, 0};
+	uint64_t            value   = 0;
+	int                 ret     = 0;
 
-	local = frame->local;
 	priv = this->private;
 
-	if ((op_ret >= 0) && priv->disk_usage_limit) {
-		gf_quota_usage_subtract (this, (local->stbuf.ia_blocks -
-						postbuf->ia_blocks) * 512);
-		fd_unref (local->fd);
-	}
+	if (!inode || list_empty (&priv->limits))
+		return 0;
 
-	STACK_UNWIND_STRICT (ftruncate, frame, op_ret, op_errno,
-                             prebuf, postbuf);
-	return 0;
-}
+	gettimeofday (&tv, NULL);
 
+	trav = inode_ref (inode);
+	while (trav) {
+		if (inode_ctx_get (trav, this, &value) == 0) {
+			limit   = (struct quota_limit *)(long) value;
+			refresh = NULL;
 
-int
-quota_ftruncate_fstat_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
-			   int32_t op_ret, int32_t op_errno, struct iatt *buf)
-{
-	struct quota_local *local = NULL;
+			LOCK (&priv->lock);
+			{
+				limit->pending += delta;
+
+				if (limit->value &&
+				    (limit->size + limit->pending >=
+				     limit->value)) {
+					gf_log (this->name, GF_LOG_DEBUG,
+						"limit (%"PRId64") of %s "
+						"reached", limit->value,
+						limit->path);
+					ret = -1;
+				}
+
+				if (!limit->refreshing && limit->loc.inode &&
+				    (tv.tv_sec >= limit->refreshed +
+				     priv->timeout)) {
+					limit->refreshing = 1;
+					limit->refreshed  = tv.tv_sec;
+					limit->refresh_pending =
+						limit->pending;
+					refresh = limit;
+				}
+			}
+			UNLOCK (&priv->lock);
 
-	local = frame->local;
+			if (refresh)
+				quota_refresh (this, refresh);
+		}
 
-	if (op_ret >= 0) {
-		local->stbuf = *buf;
+		parent = inode_parent (trav, 0, NULL);
+		inode_unref (trav);
+		trav = parent;
 	}
 
-	STACK_WIND (frame, quota_ftruncate_cbk,
-		    FIRST_CHILD (this), FIRST_CHILD (this)->fops->ftruncate,
-		    local->fd, local->offset);
-	return 0;
+	return ret;
 }
 
 
 int
-quota_ftruncate (call_frame_t *frame, xlator_t *this,
-		 fd_t *fd, off_t offset)
+quota_truncate_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+		    int32_t op_ret, int32_t op_errno, struct iatt *prebuf,
+                    struct iatt *postbuf)
 {
-	struct quota_local *local = NULL;
-	struct quota_priv  *priv = NULL;
-
-
-	priv = this->private;
-
-	if (priv->disk_usage_limit) {
-		local = GF_CALLOC (1, sizeof (struct quota_local),
-                                   gf_quota_mt_quota_local);
-		frame->local  = local;
-
-		local->fd = fd_ref (fd);
-		local->offset = offset;
-
-		STACK_WIND (frame, quota_ftruncate_fstat_cbk,
-			    FIRST_CHILD(this),
-			    FIRST_CHILD(this)->fops->fstat, fd);
-		return 0;
-	}
+	if (op_ret >= 0)
+		quota_check_limit (this, cookie, ((int64_t)postbuf->ia_blocks -
+						  prebuf->ia_blocks) * 512);
 
-	STACK_WIND (frame, quota_ftruncate_cbk,
-		    FIRST_CHILD(this),
-		    FIRST_CHILD(this)->fops->ftruncate,
-		    fd, offset);
+	STACK_UNWIND_STRICT (truncate, frame, op_ret, op_errno,
+                             prebuf, postbuf);
 	return 0;
 }
 
 
 int
-quota_mknod_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
-		 int32_t op_ret, int32_t op_errno,
-                 inode_t *inode, struct iatt *buf, struct iatt *preparent,
-                 struct iatt *postparent)
+quota_truncate (call_frame_t *frame, xlator_t *this,
+		loc_t *loc, off_t offset)
 {
-	struct quota_priv *priv = NULL;
-
-	priv = this->private;
-
-	if ((op_ret >= 0) && priv->disk_usage_limit) {
-		gf_quota_usage_add (this, buf->ia_blocks * 512);
-	}
-
-	STACK_UNWIND_STRICT (mknod, frame, op_ret, op_errno, inode, buf,
-                             preparent, postparent);
+	STACK_WIND_COOKIE (frame, quota_truncate_cbk, loc->inode,
+			   FIRST_CHILD(this),
+			   FIRST_CHILD(this)->fops->truncate,
+			   loc, offset);
 	return 0;
 }
 
 
 int
-quota_mknod (call_frame_t *frame, xlator_t *this,
-	     loc_t *loc, mode_t mode, dev_t rdev, dict_t *params)
+quota_ftruncate_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+		     int32_t op_ret, int32_t op_errno, struct iatt *prebuf,
+                     struct iatt *postbuf)
 {
-	struct quota_priv *priv = NULL;
-
-	priv = this->private;
-
-	if (gf_quota_check_free_disk (this) == -1) {
-		gf_log (this->name, GF_LOG_ERROR, 
-			"min-free-disk limit (%u) crossed, current available is %u",
-			priv->min_free_disk_limit, priv->current_free_disk);
-		STACK_UNWIND_STRICT (mknod, frame, -1, ENOSPC, NULL, NULL,
-                                     NULL, NULL);
-		return 0;
-	}
-
-        if (priv->current_disk_usage > priv->disk_usage_limit) {
-		gf_log (this->name, GF_LOG_ERROR, 
-			"Disk usage limit (%"PRIu64") crossed, current usage is %"PRIu64"",
-			priv->disk_usage_limit, priv->current_disk_usage);
-		STACK_UNWIND_STRICT (mknod, frame, -1, ENOSPC, NULL, NULL,
-                                     NULL, NULL);
-		return 0;
-        }
+	if (op_ret >= 0)
+		quota_check_limit (this, cookie, ((int64_t)postbuf->ia_blocks -
+						  prebuf->ia_blocks) * 512);
 
-	STACK_WIND (frame, quota_mknod_cbk,
-		    FIRST_CHILD(this),
-		    FIRST_CHILD(this)->fops->mknod,
-		    loc, mode, rdev, params);
+	STACK_UNWIND_STRICT (ftruncate, frame, op_ret, op_errno,
+                             prebuf, postbuf);
 	return 0;
 }
 
 
 int
-quota_mkdir_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
-		 int32_t op_ret, int32_t op_errno, inode_t *inode,
-                 struct iatt *buf, struct iatt *preparent,
-                 struct iatt *postparent)
+quota_ftruncate (call_frame_t *frame, xlator_t *this,
+		 fd_t *fd, off_t offset)
 {
-	struct quota_priv *priv = NULL;
-
-	priv = this->private;
-
-	if ((op_ret >= 0) && priv->disk_usage_limit) {
-		gf_quota_usage_subtract (this, buf->ia_blocks * 512);
-	}
-
-	STACK_UNWIND_STRICT (mkdir, frame, op_ret, op_errno, inode, buf,
-                             preparent, postparent);
+	STACK_WIND_COOKIE (frame, quota_ftruncate_cbk, fd->inode,
+			   FIRST_CHILD(this),
+			   FIRST_CHILD(this)->fops->ftruncate,
+			   fd, offset);
 	return 0;
 }
 
 
+/* checks done before anything is created under 'parent' */
 int
-quota_mkdir (call_frame_t *frame, xlator_t *this, loc_t *loc, mode_t mode,
-             dict_t *params)
+quota_check_create (xlator_t *this, inode_t *parent)
 {
 	struct quota_priv *priv = NULL;
 
@@ -385,370 +315,141 @@ quota_mkdir (call_frame_t *frame, xlator_t *this, loc_t *loc, mode_t mode,
 		gf_log (this->name, GF_LOG_ERROR, 
 			"min-free-disk limit (%u) crossed, current available is %u",
 			priv->min_free_disk_limit, priv->current_free_disk);
-		STACK_UNWIND_STRICT (mkdir, frame, -1, ENOSPC, NULL, NULL,
-                                     NULL, NULL);
-		return 0;
-		
+		return ENOSPC;
 	}
 
-        if (priv->current_disk_usage > priv->disk_usage_limit) {
-		gf_log (this->name, GF_LOG_ERROR, 
-			"Disk usage limit (%"PRIu64") crossed, current usage is %"PRIu64"",
-			priv->disk_usage_limit, priv->current_disk_usage);
-		STACK_UNWIND_STRICT (mkdir, frame, -1, ENOSPC, NULL, NULL,
-                                     NULL, NULL);
-		return 0;
-        }
-
-	STACK_WIND (frame, quota_mkdir_cbk,
-		    FIRST_CHILD(this),
-		    FIRST_CHILD(this)->fops->mkdir,
-		    loc, mode, params);
-
-	return 0;
-}
-
-
-int
-quota_unlink_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
-		  int32_t op_ret, int32_t op_errno, struct iatt *preparent,
-                  struct iatt *postparent)
-{
-	struct quota_local *local = NULL;
+	if (quota_check_limit (this, parent, 0) == -1)
+		return EDQUOT;
 
-	local = frame->local;
-
-	if (local) {
-		if (op_ret >= 0) {
-			gf_quota_usage_subtract (this,
-						 local->stbuf.ia_blocks * 512);
-		}
-		loc_wipe (&local->loc);
-	}
-
-	STACK_UNWIND_STRICT (unlink, frame, op_ret, op_errno, preparent, postparent);
 	return 0;
 }
 
 
 int
-quota_unlink_stat_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
-		       int32_t op_ret, int32_t op_errno, struct iatt *buf)
-{
-	struct quota_local *local = NULL;
-
-	local = frame->local;
-
-	if (op_ret >= 0) {
-		if (buf->ia_nlink == 1) {
-			local->stbuf = *buf;
-		}
-	}
-
-	STACK_WIND (frame, quota_unlink_cbk,
-		    FIRST_CHILD(this),
-		    FIRST_CHILD(this)->fops->unlink,
-		    &local->loc);
-
-	return 0;
-}
-
-
-int
-quota_unlink (call_frame_t *frame, xlator_t *this, loc_t *loc)
-{
-	struct quota_local *local = NULL;
-	struct quota_priv  *priv = NULL;
-
-	priv = this->private;
-
-	if (priv->disk_usage_limit) {
-		local = GF_CALLOC (1, sizeof (struct quota_local),
-                                   gf_quota_mt_quota_local);
-		frame->local = local;
-
-		loc_copy (&local->loc, loc);
-
-		STACK_WIND (frame,
-			    quota_unlink_stat_cbk,
-			    FIRST_CHILD(this),
-			    FIRST_CHILD(this)->fops->stat,
-			    loc);
-		return 0;
-	}
-
-	STACK_WIND (frame, quota_unlink_cbk,
-		    FIRST_CHILD(this),
-		    FIRST_CHILD(this)->fops->unlink,
-		    loc);
-	return 0;
-}
-
-
-int
-quota_rmdir_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
-		 int32_t op_ret, int32_t op_errno, struct iatt *preparent,
+quota_mknod_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+		 int32_t op_ret, int32_t op_errno,
+                 inode_t *inode, struct iatt *buf, struct iatt *preparent,
                  struct iatt *postparent)
 {
-	struct quota_local *local = NULL;
-
-	local = frame->local;
-
-	if (local) {
-		if (op_ret >= 0) {
-			gf_quota_usage_subtract (this, local->stbuf.ia_blocks * 512);
-		}
-		loc_wipe (&local->loc);
-	}
-
-	STACK_UNWIND_STRICT (rmdir, frame, op_ret, op_errno, preparent, postparent);
-	return 0;
-}
-
-
-int
-quota_rmdir_stat_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
-		      int32_t op_ret, int32_t op_errno, struct iatt *buf)
-{
-	struct quota_local *local = NULL;
-
-	local = frame->local;
-
-	if (op_ret >= 0) {
-		local->stbuf = *buf;
-	}
-
-	STACK_WIND (frame, quota_rmdir_cbk,
-		    FIRST_CHILD(this),
-		    FIRST_CHILD(this)->fops->rmdir,
-		    &local->loc, local->flags);
-
-	return 0;
-}
-
-
-int
-quota_rmdir (call_frame_t *frame, xlator_t *this, loc_t *loc, int flags)
-{
-	struct quota_local *local = NULL;
-	struct quota_priv  *priv = NULL;
-
-	priv = this->private;
-
-	if (priv->disk_usage_limit) {
-		local = GF_CALLOC (1, sizeof (struct quota_local),
-                                   gf_quota_mt_quota_local);
-		frame->local = local;
-
-		loc_copy (&local->loc, loc);
-                local->flags = flags;
-
-		STACK_WIND (frame, quota_rmdir_stat_cbk,
-			    FIRST_CHILD(this),
-			    FIRST_CHILD(this)->fops->stat, loc);
-		return 0;
-	}
-
-	STACK_WIND (frame, quota_rmdir_cbk,
-		    FIRST_CHILD(this),
-		    FIRST_CHILD(this)->fops->rmdir,
-		    loc, flags);
-	return 0;
-}
-
-
-int
-quota_symlink_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
-		   int32_t op_ret, int32_t op_errno, inode_t *inode,
-                   struct iatt *buf, struct iatt *preparent,
-                   struct iatt *postparent)
-{
-	struct quota_priv *priv = NULL;
-
-	priv = this->private;
-
-	if ((op_ret >= 0) && priv->disk_usage_limit) {
-		gf_quota_usage_add (this, buf->ia_blocks * 512);
-	}
+	if (op_ret >= 0)
+		quota_check_limit (this, cookie, buf->ia_blocks * 512);
 
-	STACK_UNWIND_STRICT (symlink, frame, op_ret, op_errno, inode, buf,
+	STACK_UNWIND_STRICT (mknod, frame, op_ret, op_errno, inode, buf,
                              preparent, postparent);
 	return 0;
 }
 
 
 int
-quota_symlink (call_frame_t *frame, xlator_t *this,
-	       const char *linkpath, loc_t *loc, dict_t *params)
+quota_mknod (call_frame_t *frame, xlator_t *this,
+	     loc_t *loc, mode_t mode, dev_t rdev, dict_t *params)
 {
-	struct quota_priv *priv = NULL;
-
-	priv = this->private;
+	int op_errno = 0;
 
-	if (gf_quota_check_free_disk (this) == -1) {
-		gf_log (this->name, GF_LOG_ERROR, 
-			"min-free-disk limit (%u) crossed, current available is %u",
-			priv->min_free_disk_limit, priv->current_free_disk);
-		STACK_UNWIND_STRICT (symlink, frame, -1, ENOSPC, NULL, NULL,
+	op_errno = quota_check_create (this, loc->parent);
+	if (op_errno) {
+		STACK_UNWIND_STRICT (mknod, frame, -1, op_errno, NULL, NULL,
                                      NULL, NULL);
 		return 0;
-		
 	}
-        if (priv->current_disk_usage > priv->disk_usage_limit) {
-		gf_log (this->name, GF_LOG_ERROR, 
-			"Disk usage limit (%"PRIu64") crossed, current usage is %"PRIu64"",
-			priv->disk_usage_limit, priv->current_disk_usage);
-		STACK_UNWIND_STRICT (symlink, frame, -1, ENOSPC, NULL, NULL,
-                                     NULL, NULL);
-		return 0;
-        }
 
-	STACK_WIND (frame, quota_symlink_cbk,
-		    FIRST_CHILD(this),
-		    FIRST_CHILD(this)->fops->symlink,
-		    linkpath, loc, params);
+	STACK_WIND_COOKIE (frame, quota_mknod_cbk, loc->parent,
+			   FIRST_CHILD(this),
+			   FIRST_CHILD(this)->fops->mknod,
+			   loc, mode, rdev, params);
 	return 0;
 }
 
 
 int
-quota_create_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
-		  int32_t op_ret, int32_t op_errno,
-		  fd_t *fd, inode_t *inode, struct iatt *buf,
-                  struct iatt *preparent, struct iatt *postparent)
-{
-	struct quota_priv *priv = this->private;
-
-	if ((op_ret >= 0) && priv->disk_usage_limit) {
-		gf_quota_usage_add (this, buf->ia_blocks * 512);
-
-		fd_ctx_set (fd, this, 1);
-	}
-
-	STACK_UNWIND_STRICT (create, frame, op_ret, op_errno, fd, inode, buf,
-                             preparent, postparent);
-	return 0;
-}
-
-
-int
-quota_create (call_frame_t *frame, xlator_t *this,
-	      loc_t *loc, int32_t flags, mode_t mode, fd_t *fd, dict_t *params)
+quota_mkdir (call_frame_t *frame, xlator_t *this, loc_t *loc, mode_t mode,
+             dict_t *params)
 {
-	struct quota_priv *priv = NULL;
-
-	priv = this->private;
+	int op_errno = 0;
 
-	if (gf_quota_check_free_disk (this) == -1) {
-		gf_log (this->name, GF_LOG_ERROR, 
-			"min-free-disk limit (%u) crossed, current available is %u",
-			priv->min_free_disk_limit, priv->current_free_disk);
-		STACK_UNWIND_STRICT (create, frame, -1, ENOSPC, NULL, NULL, NULL,
+	op_errno = quota_check_create (this, loc->parent);
+	if (op_errno) {
+		STACK_UNWIND_STRICT (mkdir, frame, -1, op_errno, NULL, NULL,
                                      NULL, NULL);
 		return 0;
-		
 	}
-        if (priv->current_disk_usage > priv->disk_usage_limit) {
-		gf_log (this->name, GF_LOG_ERROR, 
-			"Disk usage limit (%"PRIu64") crossed, current usage is %"PRIu64"",
-			priv->disk_usage_limit, priv->current_disk_usage);
-		STACK_UNWIND_STRICT (create, frame, -1, ENOSPC, NULL, NULL, NULL,
-                                     NULL, NULL);
-		return 0;
-        }
 
-	STACK_WIND (frame, quota_create_cbk,
+	STACK_WIND (frame, default_mkdir_cbk,
 		    FIRST_CHILD(this),
-		    FIRST_CHILD(this)->fops->create,
-		    loc, flags, mode, fd, params);
+		    FIRST_CHILD(this)->fops->mkdir,
+		    loc, mode, params);
+
 	return 0;
 }
 
 
 int
-quota_open_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
-		int32_t op_ret, int32_t op_errno, fd_t *fd)
+quota_symlink_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+		   int32_t op_ret, int32_t op_errno, inode_t *inode,
+                   struct iatt *buf, struct iatt *preparent,
+                   struct iatt *postparent)
 {
-
 	if (op_ret >= 0)
-		fd_ctx_set (fd, this, 1);
+		quota_check_limit (this, cookie, buf->ia_blocks * 512);
 
-	STACK_UNWIND_STRICT (open, frame, op_ret, op_errno, fd);
+	STACK_UNWIND_STRICT (symlink, frame, op_ret, op_errno, inode, buf,
+                             preparent, postparent);
 	return 0;
 }
 
 
 int
-quota_open (call_frame_t *frame, xlator_t *this, loc_t *loc, int32_t flags,
-            fd_t *fd, int32_t wbflags)
+quota_symlink (call_frame_t *frame, xlator_t *this,
+	       const char *linkpath, loc_t *loc, dict_t *params)
 {
-	STACK_WIND (frame, quota_open_cbk,
-		    FIRST_CHILD(this),
-		    FIRST_CHILD(this)->fops->open,
-		    loc, flags, fd, wbflags);
+	int op_errno = 0;
+
+	op_errno = quota_check_create (this, loc->parent);
+	if (op_errno) {
+		STACK_UNWIND_STRICT (symlink, frame, -1, op_errno, NULL, NULL,
+                                     NULL, NULL);
+		return 0;
+	}
+
+	STACK_WIND_COOKIE (frame, quota_symlink_cbk, loc->parent,
+			   FIRST_CHILD(this),
+			   FIRST_CHILD(this)->fops->symlink,
+			   linkpath, loc, params);
 	return 0;
 }
 
 
 int
-quota_writev_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
-		  int32_t op_ret, int32_t op_errno, struct iatt *prebuf,
-                  struct iatt *postbuf)
+quota_create (call_frame_t *frame, xlator_t *this,
+	      loc_t *loc, int32_t flags, mode_t mode, fd_t *fd, dict_t *params)
 {
-	struct quota_priv *priv = NULL;
-	struct quota_local *local = NULL;
-
-
-	priv = this->private;
-	local = frame->local;
+	int op_errno = 0;
 
-	if (priv->disk_usage_limit) {
-		if (op_ret >= 0) { 
-			gf_quota_usage_add (this, (postbuf->ia_blocks -
-						   prebuf->ia_blocks) * 512);
-		}
-		fd_unref (local->fd);
-		iobref_unref (local->iobref);
+	op_errno = quota_check_create (this, loc->parent);
+	if (op_errno) {
+		STACK_UNWIND_STRICT (create, frame, -1, op_errno, NULL, NULL,
+                                     NULL, NULL, NULL);
+		return 0;
 	}
 
-	STACK_UNWIND_STRICT (writev, frame, op_ret, op_errno, prebuf, postbuf);
+	STACK_WIND (frame, default_create_cbk,
+		    FIRST_CHILD(this),
+		    FIRST_CHILD(this)->fops->create,
+		    loc, flags, mode, fd, params);
 	return 0;
 }
 
 
 int
-quota_writev_fstat_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
-			int32_t op_ret,	int32_t op_errno, struct iatt *buf)
+quota_writev_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+		  int32_t op_ret, int32_t op_errno, struct iatt *prebuf,
+                  struct iatt *postbuf)
 {
-	struct quota_local *local = NULL;
-	struct quota_priv  *priv = NULL;
-	int                 iovlen = 0;
-
-
-	local = frame->local;
-	priv = this->private;
-
-	if (op_ret >= 0) {
-		if (priv->current_disk_usage > priv->disk_usage_limit) {
-			iovlen = iov_length (local->vector, local->count);
-
-			if (iovlen > (buf->ia_blksize - (buf->ia_size % buf->ia_blksize))) {
-				fd_unref (local->fd);
-				iobref_unref (local->iobref);
-				STACK_UNWIND_STRICT (writev, frame, -1, ENOSPC,
-                                                     NULL, NULL);
-				return 0;
-			}
-		}
-		local->stbuf = *buf;
-	}
-	
-	STACK_WIND (frame, quota_writev_cbk,
-		    FIRST_CHILD(this),
-		    FIRST_CHILD(this)->fops->writev,
-		    local->fd, local->vector, local->count, local->offset,
-                    local->iobref);
+	if (op_ret >= 0)
+		quota_check_limit (this, cookie, ((int64_t)postbuf->ia_blocks -
+						  prebuf->ia_blocks) * 512);
 
+	STACK_UNWIND_STRICT (writev, frame, op_ret, op_errno, prebuf, postbuf);
 	return 0;
 }
 
@@ -758,9 +459,7 @@ quota_writev (call_frame_t *frame, xlator_t *this, fd_t *fd,
 	      struct iovec *vector, int32_t count, off_t off,
               struct iobref *iobref)
 {
-	struct quota_local *local = NULL;
 	struct quota_priv  *priv  = NULL;
-        int                 i     = 0;
 
 	priv = this->private;
 
@@ -773,67 +472,16 @@ quota_writev (call_frame_t *frame, xlator_t *this, fd_t *fd,
 		return 0;
 	}
 
-	if (priv->disk_usage_limit) {
-		local = GF_CALLOC (1, sizeof (struct quota_local),
-                                   gf_quota_mt_quota_local);
-		local->fd     = fd_ref (fd);
-		local->iobref = iobref_ref (iobref);
-                for (i = 0; i < count; i++) {
-                        local->vector[i].iov_base = vector[i].iov_base;
-                        local->vector[i].iov_len = vector[i].iov_len;
-                }
-
-                local->count = count;
-		local->offset = off;
-		frame->local  = local;
-
-		STACK_WIND (frame, quota_writev_fstat_cbk,
-			    FIRST_CHILD(this),
-			    FIRST_CHILD(this)->fops->fstat, fd);
+	if (quota_check_limit (this, fd->inode, 0) == -1) {
+		STACK_UNWIND_STRICT (writev, frame, -1, EDQUOT,
+                                     NULL, NULL);
 		return 0;
 	}
 
-	STACK_WIND (frame, quota_writev_cbk,
-		    FIRST_CHILD(this),
-		    FIRST_CHILD(this)->fops->writev,
-		    fd, vector, count, off, iobref);
-	return 0;
-}
-
-
-int
-quota_removexattr_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
-		       int32_t op_ret, int32_t op_errno)
-{
-	if (op_ret == -1) {
-		gf_log (this->name, GF_LOG_CRITICAL, 
-			"failed to remove the disk-usage value: %s",
-			strerror (op_errno));
-	} 
-	
-	STACK_DESTROY (frame->root);
-	return 0;
-}
-
-
-int
-quota_setxattr_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
-		    int32_t op_ret, int32_t op_errno)
-{
-        dict_t            *dict = NULL;
-
-	if (op_ret == -1) {
-		gf_log (this->name, GF_LOG_CRITICAL, 
-			"failed to set the disk-usage value: %s",
-			strerror (op_errno));
-	} 
-
-        if (cookie) {
-                dict = (dict_t *) cookie;
-                dict_unref (dict);
-        }
-
-	STACK_DESTROY (frame->root);
+	STACK_WIND_COOKIE (frame, quota_writev_cbk, fd->inode,
+			   FIRST_CHILD(this),
+			   FIRST_CHILD(this)->fops->writev,
+			   fd, vector, count, off, iobref);
 	return 0;
 }
 
@@ -842,10 +490,13 @@ int
 quota_statfs_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 		  int32_t op_ret, int32_t op_errno, struct statvfs *statvfs)
 {
-	struct quota_priv *priv = NULL;
-	uint64_t           f_blocks = 0;
-	int64_t            f_bfree = 0;
-	uint64_t           f_bused = 0;
+	struct quota_priv  *priv = NULL;
+	struct quota_limit *limit = NULL;
+	uint64_t            f_blocks = 0;
+	int64_t             f_bfree = 0;
+	uint64_t            f_bused = 0;
+	int64_t             usage = 0;
+	int64_t             value = 0;
 
 
 	priv = this->private;
@@ -853,8 +504,23 @@ quota_statfs_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 	if (op_ret != 0)
 		goto unwind;
 
-	f_blocks = priv->disk_usage_limit / statvfs->f_frsize;
-	f_bused = priv->current_disk_usage / statvfs->f_frsize;
+	LOCK (&priv->lock);
+	{
+		list_for_each_entry (limit, &priv->limits, list) {
+			if (strcmp (limit->path, "/") == 0) {
+				value = limit->value;
+				usage = limit->size + limit->pending;
+				break;
+			}
+		}
+	}
+	UNLOCK (&priv->lock);
+
+	if (!value)
+		goto unwind;
+
+	f_blocks = value / statvfs->f_frsize;
+	f_bused = max (usage, 0) / statvfs->f_frsize;
 
 	if (f_blocks && (f_blocks < statvfs->f_blocks))
 		statvfs->f_blocks = f_blocks;
@@ -882,87 +548,6 @@ quota_statfs (call_frame_t *frame, xlator_t *this, loc_t *loc)
 }
 
 
-int
-quota_getxattr_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
-		    int32_t op_ret, int32_t op_errno, dict_t *value)
-{
-	data_t *data = NULL;
-	struct quota_priv *priv = this->private;
-	
-	if (op_ret >= 0) {
-		data = dict_get (value, "trusted.glusterfs-quota-du");
-		if (data) {
-			LOCK (&priv->lock);
-			{
-				priv->current_disk_usage = data_to_uint64 (data);
-			}
-			UNLOCK (&priv->lock);
-
-			return 0;
-		}
-	} 
-
-	STACK_DESTROY (frame->root);
-
-	return 0;
-}
-
-
-void
-gf_quota_get_disk_usage (xlator_t *this)
-{
-	call_frame_t *frame = NULL;
-	call_pool_t  *pool = NULL;
-
-	struct quota_priv *priv = NULL;
-
-	pool = this->ctx->pool;
-	frame = create_frame (this, pool);
-	priv = this->private;
-
-	STACK_WIND (frame, quota_getxattr_cbk,
-		    this->children->xlator,
-		    this->children->xlator->fops->getxattr,
-		    &(priv->root_loc),
-		    "trusted.glusterfs-quota-du");
-	return ;
-}
-
-
-void
-gf_quota_cache_sync (xlator_t *this)
-{
-	struct quota_priv *priv = NULL;
-	call_frame_t      *frame = NULL;
-	dict_t            *dict = get_new_dict ();
-
-
-
-	priv = this->private;
-
-	frame = create_frame (this, this->ctx->pool);
-	dict_set (dict, "trusted.glusterfs-quota-du", 
-		  data_from_uint64 (priv->current_disk_usage));
-
-        dict_ref (dict);
-
-	STACK_WIND_COOKIE (frame, quota_setxattr_cbk,
-                           (void *) (dict_t *) dict,
-                           this->children->xlator,
-                           this->children->xlator->fops->setxattr,
-                           &(priv->root_loc), dict, 0);
-}
-
-
-int
-quota_release (xlator_t *this, fd_t *fd)
-{
-	gf_quota_cache_sync (this);
-
-	return 0;
-}
-
-
 /* notify */
 int32_t
 notify (xlator_t *this,
@@ -985,6 +570,48 @@ quota_lookup_cbk (call_frame_t *frame,
                     dict_t *dict,
                     struct iatt *postparent)
 {
+	struct quota_priv  *priv  = NULL;
+	struct quota_limit *limit = NULL;
+	struct quota_limit *found = NULL;
+	loc_t              *loc   = NULL;
+
+	priv = this->private;
+	loc  = cookie;
+
+	if ((op_ret < 0) || !IA_ISDIR (buf->ia_type) ||
+	    list_empty (&priv->limits))
+		goto unwind;
+
+	LOCK (&priv->lock);
+	{
+		list_for_each_entry (limit, &priv->limits, list) {
+			if (strcmp (limit->path, loc->path) != 0)
+				continue;
+
+			if (limit->loc.inode != inode) {
+				loc_wipe (&limit->loc);
+				loc_copy (&limit->loc, loc);
+				if (limit->loc.inode != inode) {
+					if (limit->loc.inode)
+						inode_unref (limit->loc.inode);
+					limit->loc.inode = inode_ref (inode);
+				}
+				inode_ctx_put (inode, this,
+					       (uint64_t)(long) limit);
+				limit->refreshed = 0;
+			}
+
+			if (!limit->refreshing) {
+				limit->refreshing = 1;
+				limit->refresh_pending = limit->pending;
+				found = limit;
+			}
+			break;
+		}
+	}
+	UNLOCK (&priv->lock);
+
+unwind:
 	STACK_UNWIND_STRICT (
                      lookup, 
                      frame,
@@ -994,6 +621,12 @@ quota_lookup_cbk (call_frame_t *frame,
 		      buf,
                       dict,
                       postparent);
+
+	/* a fresh lookup of a limited directory re-reads its usage */
+	if (found) {
+		found->refreshed = time (NULL);
+		quota_refresh (this, found);
+	}
 	return 0;
 }
 
@@ -1011,17 +644,16 @@ quota_lookup (call_frame_t *frame,
 		if (strcmp (loc->path, "/") == 0) {
 			loc_copy(&(priv->root_loc), loc); 
 			priv->only_first_time = 0;
-			if (priv->disk_usage_limit)
-				gf_quota_get_disk_usage (this);
 		}
 	}
 
-	STACK_WIND (frame,
-		    quota_lookup_cbk,
-		    FIRST_CHILD(this),
-		    FIRST_CHILD(this)->fops->lookup,
-		    loc,
-		    xattr_req);
+	STACK_WIND_COOKIE (frame,
+			   quota_lookup_cbk,
+			   loc,
+			   FIRST_CHILD(this),
+			   FIRST_CHILD(this)->fops->lookup,
+			   loc,
+			   xattr_req);
 	return 0;
 }
 
@@ -1044,36 +676,156 @@ mem_acct_init (xlator_t *this)
         return ret;
 }
 
+
+/* called with priv->lock held when 'apply' is set */
+static int
+quota_limit_set (xlator_t *this, char *path, char *size, int apply)
+{
+	struct quota_priv  *priv  = NULL;
+	struct quota_limit *limit = NULL;
+	uint64_t            value = 0;
+
+	priv = this->private;
+
+	if ((path[0] != '/') || (gf_string2bytesize (size, &value) != 0)) {
+		gf_log (this->name, GF_LOG_ERROR,
+			"invalid limit '%s:%s'", path, size);
+		return -1;
+	}
+
+	if (!apply)
+		return 0;
+
+	list_for_each_entry (limit, &priv->limits, list) {
+		if (strcmp (limit->path, path) == 0) {
+			limit->value = value;
+			return 0;
+		}
+	}
+
+	limit = GF_CALLOC (1, sizeof (*limit), gf_quota_mt_quota_limit);
+	if (!limit)
+		return -1;
+
+	limit->path = gf_strdup (path);
+	if (!limit->path) {
+		GF_FREE (limit);
+		return -1;
+	}
+	limit->value = value;
+
+	/* limits are only dropped by fini, an inode ctx may point to them */
+	list_add_tail (&limit->list, &priv->limits);
+
+	gf_log (this->name, GF_LOG_DEBUG,
+		"limit of %s is %"PRIu64" bytes", path, value);
+
+	return 0;
+}
+
+
+/* "disk-usage-limit" limits "/", "limit-set" is a comma separated list
+   of <path>:<size>. Limits which are no longer set are turned off. */
+static int
+quota_parse_limits (xlator_t *this, dict_t *options, int apply)
+{
+	struct quota_priv  *priv   = NULL;
+	struct quota_limit *limit  = NULL;
+	data_t             *data   = NULL;
+	char               *dup    = NULL;
+	char               *entry  = NULL;
+	char               *size   = NULL;
+	char               *saveptr = NULL;
+	int                 ret    = 0;
+
+	priv = this->private;
+
+	if (apply)
+		list_for_each_entry (limit, &priv->limits, list)
+			limit->value = 0;
+
+	data = dict_get (options, "disk-usage-limit");
+	if (data) {
+		ret = quota_limit_set (this, "/", data->data, apply);
+		if (ret)
+			goto out;
+	}
+
+	data = dict_get (options, "limit-set");
+	if (!data)
+		goto out;
+
+	dup = gf_strdup (data->data);
+	if (!dup) {
+		ret = -1;
+		goto out;
+	}
+
+	for (entry = strtok_r (dup, ",", &saveptr); entry;
+	     entry = strtok_r (NULL, ",", &saveptr)) {
+		size = strrchr (entry, ':');
+		if (!size) {
+			gf_log (this->name, GF_LOG_ERROR,
+				"invalid limit '%s'", entry);
+			ret = -1;
+			goto out;
+		}
+		*size++ = '\0';
+
+		ret = quota_limit_set (this, entry, size, apply);
+		if (ret)
+			goto out;
+	}
+
+out:
+	if (dup)
+		GF_FREE (dup);
+
+	return ret;
+}
+
+
+static int
+quota_set_limits (xlator_t *this, dict_t *options)
+{
+	struct quota_priv *priv = NULL;
+	int                ret  = 0;
+
+	priv = this->private;
+
+	ret = quota_parse_limits (this, options, 0);
+	if (ret)
+		return ret;
+
+	LOCK (&priv->lock);
+	{
+		ret = quota_parse_limits (this, options, 1);
+	}
+	UNLOCK (&priv->lock);
+
+	return ret;
+}
+
+
 int
 reconfigure (xlator_t *this, dict_t *options)
 {
 
 	struct quota_priv *_private = NULL;
-	uint64_t	   disk_usage_limit;	
 	uint32_t   	   min_free_disk_limit;
+	uint32_t	   timeout;
 	data_t 		  *data = NULL;
 	int		   ret = 0;
 	
 	_private = this->private;
 
-	data = dict_get (options, "disk-usage-limit");
-	if (data) {
-		if (gf_string2bytesize (data->data, &disk_usage_limit) != 0) {
-                        gf_log (this->name, GF_LOG_ERROR, 
-                                "Reconfigure: Invalid number '%s' "
-				"for disk-usage limit", data->data);
-			//return -1;
-			ret = -1;
-			goto out;
-                }
-		_private->disk_usage_limit = disk_usage_limit;
-		gf_log (this->name, GF_LOG_TRACE,
-                        "Reconfiguring disk-usage-limit %"PRIu64"",
-			disk_usage_limit);
-
+	ret = quota_set_limits (this, options);
+	if (ret) {
+		gf_log (this->name, GF_LOG_ERROR,
+			"Reconfigure: invalid limits");
+		goto out;
 	}
-	
-    
+
         data = dict_get (options, "min-free-disk-limit");
         if (data) {
 		if (gf_string2percent (data->data, &min_free_disk_limit) != 0){
@@ -1090,6 +842,18 @@ reconfigure (xlator_t *this, dict_t *options)
 			min_free_disk_limit);
 		
         }
+
+	data = dict_get (options, "timeout");
+	if (data) {
+		if (gf_string2time (data->data, &timeout) != 0) {
+			gf_log (this->name, GF_LOG_ERROR,
+				"Reconfigure: invalid time '%s' for timeout",
+				data->data);
+			ret = -1;
+			goto out;
+		}
+		_private->timeout = timeout;
+	}
 out:	
 	return ret;
 
@@ -1115,18 +879,27 @@ init (xlator_t *this)
 
 	_private = GF_CALLOC (1, sizeof (struct quota_priv),
                               gf_quota_mt_quota_priv);
-        _private->disk_usage_limit = 0;
-        data = dict_get (this->options, "disk-usage-limit");
-        if (data) {
-		if (gf_string2bytesize (data->data, &_private->disk_usage_limit) != 0) {
-                        gf_log (this->name, GF_LOG_ERROR, 
-                                "invalid number '%s' for disk-usage limit", data->data);
+	if (!_private) {
+		ret = -1;
+		goto out;
+	}
+	LOCK_INIT (&_private->lock);
+	INIT_LIST_HEAD (&_private->limits);
+        this->private = (void *)_private;
+
+	ret = quota_set_limits (this, this->options);
+	if (ret)
+		goto out;
+
+	_private->timeout = QUOTA_DEFAULT_TIMEOUT;
+	data = dict_get (this->options, "timeout");
+	if (data) {
+		if (gf_string2time (data->data, &_private->timeout) != 0) {
+			gf_log (this->name, GF_LOG_ERROR,
+				"invalid time '%s' for timeout", data->data);
 			ret = -1;
 			goto out;
-                }
-
-		LOCK_INIT (&_private->lock);
-		_private->current_disk_usage = 0;
+		}
 	}
 	
         _private->min_free_disk_limit = 0;
@@ -1153,7 +926,6 @@ init (xlator_t *this)
         }
 
 	_private->only_first_time = 1;
-        this->private = (void *)_private;
 	ret = 0;
  out:
 	return ret;
@@ -1164,25 +936,34 @@ init (xlator_t *this)
 void 
 fini (xlator_t *this)
 {
-	struct quota_priv *_private = this->private;
+	struct quota_priv  *_private = this->private;
+	struct quota_limit *limit = NULL;
+	struct quota_limit *tmp = NULL;
+
+	if (!_private)
+		return;
 
-	if (_private) {
-		gf_quota_cache_sync (this);
-		this->private = NULL;
+	list_for_each_entry_safe (limit, tmp, &_private->limits, list) {
+		list_del (&limit->list);
+		loc_wipe (&limit->loc);
+		GF_FREE (limit->path);
+		GF_FREE (limit);
 	}
-	
+
+	loc_wipe (&_private->root_loc);
+	LOCK_DESTROY (&_private->lock);
+	GF_FREE (_private);
+	this->private = NULL;
+
 	return ;
 }
 
 struct xlator_fops fops = {
 	.create      = quota_create,
-	.open        = quota_open,
 	.lookup	     = quota_lookup,
 	.truncate    = quota_truncate,
 	.ftruncate   = quota_ftruncate,
 	.writev      = quota_writev,
-	.unlink      = quota_unlink,
-	.rmdir       = quota_rmdir,
 	.mknod       = quota_mknod,
 	.mkdir       = quota_mkdir,
 	.symlink     = quota_symlink,
@@ -1190,7 +971,6 @@ struct xlator_fops fops = {
 };
 
 struct xlator_cbks cbks = {
-	.release     = quota_release
 };
 
 struct volume_options options[] = {
@@ -1203,5 +983,11 @@ struct volume_options options[] = {
 	{ .key  = {"disk-usage-limit"}, 
 	  .type = GF_OPTION_TYPE_SIZET 
 	},
+	{ .key  = {"limit-set"},
+	  .type = GF_OPTION_TYPE_STR
+	},
+	{ .key  = {"timeout"},
+	  .type = GF_OPTION_TYPE_TIME
+	},
 	{ .key = {NULL} },
 };
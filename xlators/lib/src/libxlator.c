@@ -1,4 +1,5 @@
 #include "mem-types.h"
+#include "byte-order.h"
 #include "libxlator.h"
 
 
@@ -352,6 +353,102 @@ done:
 }
 
 
+/* Sum the quota size attrs of the cluster, each brick only accounts for
+   the data it holds */
+int32_t
+cluster_markerquota_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                         int op_ret, int op_errno, dict_t *dict)
+{
+        int32_t            callcnt = 0;
+        int                ret = -1;
+        int64_t           *size = NULL;
+        struct marker_str *local = NULL;
+
+        if (!this || !frame || !frame->local || !cookie) {
+                gf_log (this->name, GF_LOG_DEBUG, "possible NULL deref");
+                goto out;
+        }
+
+        local = frame->local;
+
+        LOCK (&frame->lock);
+        {
+                callcnt = --local->call_count;
+
+                if (op_ret) {
+                        if (op_errno == ENOTCONN)
+                                local->enotconn_count++;
+                        else if (op_errno == ENOENT)
+                                local->enoent_count++;
+                        else if (op_errno != ENODATA)
+                                local->esomerr = op_errno;
+                        goto unlock;
+                }
+
+                ret = dict_get_ptr (dict, QUOTA_SIZE_KEY, (void **)&size);
+                if (ret)
+                        goto unlock;
+
+                local->quota_size += ntoh64 (*size);
+                local->quota_count++;
+        }
+unlock:
+        UNLOCK (&frame->lock);
+
+        if (callcnt)
+                return 0;
+
+        op_ret = 0;
+        op_errno = 0;
+        dict = NULL;
+
+        if (local->esomerr) {
+                op_ret = -1;
+                op_errno = local->esomerr;
+                goto unwind;
+        }
+        if (local->enotconn_count) {
+                op_ret = -1;
+                op_errno = ENOTCONN;
+                goto unwind;
+        }
+        if (!local->quota_count) {
+                op_ret = -1;
+                op_errno = local->enoent_count ? ENOENT : ENODATA;
+                goto unwind;
+        }
+
+        dict = dict_new ();
+        size = GF_CALLOC (1, sizeof (int64_t), gf_common_mt_char);
+        if (!dict || !size) {
+                op_ret = -1;
+                op_errno = ENOMEM;
+                goto unwind;
+        }
+        *size = hton64 (local->quota_size);
+
+        ret = dict_set_bin (dict, QUOTA_SIZE_KEY, size, sizeof (int64_t));
+        if (ret) {
+                GF_FREE (size);
+                op_ret = -1;
+                op_errno = ENOMEM;
+        }
+
+unwind:
+        if (local->xl_specf_unwind) {
+                frame->local = local->xl_local;
+                local->xl_specf_unwind (frame, op_ret, op_errno, dict);
+                GF_FREE (local);
+        } else {
+                STACK_UNWIND_STRICT (getxattr, frame, op_ret, op_errno, dict);
+        }
+
+        if (dict)
+                dict_unref (dict);
+out:
+        return 0;
+}
+
 int32_t
 cluster_getmarkerattr (call_frame_t *frame,xlator_t *this, loc_t *loc,
                        const char *name, void *xl_local,
@@ -393,6 +490,11 @@ cluster_getmarkerattr (call_frame_t *frame,xlator_t *this, loc_t *loc,
                                     *(sub_volumes + i),
                                     (*(sub_volumes + i))->fops->getxattr,
                                     loc, name);
+                else if (MARKER_QUOTA_TYPE == type)
+                        STACK_WIND (frame, cluster_markerquota_cbk,
+                                    *(sub_volumes + i),
+                                    (*(sub_volumes + i))->fops->getxattr,
+                                    loc, name);
                 else {
                         gf_log (this->name, GF_LOG_WARNING,
                                  "Unrecognized type of marker attr recived");
@@ -22,6 +22,10 @@
 #define UUID_SIZE 36
 #define MARKER_UUID_TYPE    1
 #define MARKER_XTIME_TYPE   2
+#define MARKER_QUOTA_TYPE   3
+
+/* bytes used under a directory, int64 in network order, kept by marker */
+#define QUOTA_SIZE_KEY      MARKER_XATTR_PREFIX ".quota.size"
 
 
 typedef int32_t (*xlator_specf_unwind_t) (call_frame_t *frame,
@@ -49,6 +53,8 @@ struct marker_str {
         int32_t                enotconn_count;
         int32_t                enodata_count;
         int32_t                noxtime_count;
+        int64_t                quota_size;
+        int32_t                quota_count;
 
         int                    esomerr;
 
@@ -74,6 +80,10 @@ int32_t
 cluster_markeruuid_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                         int op_ret, int op_errno, dict_t *dict);
 
+int32_t
+cluster_markerquota_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+                         int op_ret, int op_errno, dict_t *dict);
+
 int32_t
 cluster_getmarkerattr (call_frame_t *frame,xlator_t *this, loc_t *loc,
                        const char *name, void *xl_local,
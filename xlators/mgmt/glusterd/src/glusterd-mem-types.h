@@ -60,7 +60,10 @@ enum gf_gld_mem_types_ {
         gf_gld_mt_log_rotate_ctx_t              = gf_common_mt_end + 34,
         gf_gld_mt_peerctx_t                     = gf_common_mt_end + 35,
         gf_gld_mt_sm_tr_log_t                = gf_common_mt_end + 36,
-        gf_gld_mt_end                           = gf_common_mt_end + 37
+        gf_gld_mt_defrag_worker_t               = gf_common_mt_end + 37,
+        gf_gld_mt_defrag_dir_t                  = gf_common_mt_end + 38,
+        gf_gld_mt_defrag_unit_t                 = gf_common_mt_end + 39,
+        gf_gld_mt_end                           = gf_common_mt_end + 40
 };
 #endif
 
@@ -38,215 +38,876 @@
 #include "glusterd-store.h"
 
 #include "syscall.h"
+#include "statedump.h"
 #include "cli1.h"
 
-int
-gf_glusterd_rebalance_move_data (glusterd_volinfo_t *volinfo, const char *dir)
+static void
+gf_defrag_worker_account (glusterd_defrag_info_t *defrag,
+                          struct gf_defrag_worker_ *worker, int lookedup,
+                          int migrated, uint64_t size, int failed)
 {
-        int                     ret                = -1;
-        int                     dst_fd             = -1;
-        int                     src_fd             = -1;
-        DIR                    *fd                 = NULL;
+        LOCK (&defrag->lock);
+        {
+                worker->files_lookedup += lookedup;
+                defrag->num_files_lookedup += lookedup;
+
+                if (migrated) {
+                        worker->files_migrated += 1;
+                        worker->data_migrated += size;
+                        defrag->total_files += 1;
+                        defrag->total_data += size;
+                }
+
+                worker->failures += failed;
+        }
+        UNLOCK (&defrag->lock);
+}
+
+
+static int
+gf_defrag_copy (struct gf_defrag_worker_ *worker, int src_fd, int dst_fd)
+{
+        off_t   offset = 0;
+        ssize_t ret    = -1;
+        ssize_t count  = 0;
+
+        while (1) {
+                ret = read (src_fd, worker->buf, GF_DEFRAG_CHUNK_SIZE);
+                if (ret <= 0)
+                        break;
+
+                count = ret;
+
+                /* have the next chunk read in while this one goes to the
+                   other brick */
+                posix_fadvise (src_fd, offset + count, GF_DEFRAG_CHUNK_SIZE,
+                               POSIX_FADV_WILLNEED);
+
+                ret = write (dst_fd, worker->buf, count);
+                if (ret != count) {
+                        ret = -1;
+                        break;
+                }
+
+                offset += count;
+        }
+
+        return (ret < 0) ? -1 : 0;
+}
+
+
+/*
+ * moves the file @name of the directory @dir of a local brick to the
+ * subvolume it hashes to, if it is not there already. when the volume is a
+ * plain distribute the data is read straight off the brick, so it crosses
+ * the network only once, on its way to the new brick.
+ *
+ * only files whose data the local brick holds are taken up, so the nodes
+ * running rebalance each move a disjoint set of files. the temp file is
+ * tagged with the node's uuid all the same, so that two nodes never write
+ * into one copy.
+ */
+static int
+gf_defrag_migrate_file (struct gf_defrag_worker_ *worker, const char *brick,
+                        const char *dir, const char *name)
+{
+        glusterd_volinfo_t     *volinfo           = NULL;
+        glusterd_defrag_info_t *defrag            = NULL;
+        int                     ret               = -1;
+        int                     dst_fd            = -1;
+        int                     src_fd            = -1;
+        struct stat             stbuf             = {0,};
+        struct stat             new_stbuf         = {0,};
+        char                    brick_path[PATH_MAX] = {0,};
+        char                    full_path[PATH_MAX]  = {0,};
+        char                    tmp_filename[PATH_MAX] = {0,};
+        char                    value[16]         = {0,};
+
+        volinfo = worker->volinfo;
+        defrag  = volinfo->defrag;
+
+        snprintf (brick_path, PATH_MAX, "%s%s/%s", brick, dir, name);
+        snprintf (full_path, PATH_MAX, "%s%s/%s", defrag->mount, dir, name);
+
+        /* the data may have been moved off this brick since the crawl */
+        ret = lstat (brick_path, &stbuf);
+        if ((ret == -1) || !S_ISREG (stbuf.st_mode))
+                return 0;
+
+        /* a linkfile only points at data which lives elsewhere */
+        ret = sys_lgetxattr (brick_path, "trusted.glusterfs.dht.linkto",
+                             &value, 16);
+        if (ret >= 0)
+                return 0;
+
+        /* with unhashed-sticky-bit, the mount shows the sticky bit on files
+           which are not on their hashed subvolume */
+        ret = stat (full_path, &stbuf);
+        if (ret == -1)
+                return 0;
+
+        if (!S_ISREG (stbuf.st_mode)) {
+                return 0;
+        }
+
+        gf_defrag_worker_account (defrag, worker, 1, 0, 0, 0);
+
+        if ((stbuf.st_mode & 01000) != 01000)
+                return 0;
+
+        /* If the file is open, don't run rebalance on it */
+        ret = sys_lgetxattr (full_path, GLUSTERFS_OPEN_FD_COUNT,
+                             &value, 16);
+        if ((ret < 0) || !strncmp (value, "1", 1))
+                return 0;
+
+        snprintf (tmp_filename, PATH_MAX, "%s%s/.%s.gfs%llu.%s",
+                  defrag->mount, dir, name, (unsigned long long)stbuf.st_size,
+                  defrag->node_uuid);
+
+        if (volinfo->type == GF_CLUSTER_TYPE_NONE)
+                src_fd = open (brick_path, O_RDONLY);
+        else
+                src_fd = open (full_path, O_RDONLY);
+        if (src_fd == -1)
+                goto fail;
+
+        dst_fd = creat (tmp_filename, (stbuf.st_mode & ~01000));
+        if (dst_fd == -1)
+                goto fail;
+
+        posix_fadvise (src_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+        ret = gf_defrag_copy (worker, src_fd, dst_fd);
+        if (ret)
+                goto fail;
+
+        ret = stat (full_path, &new_stbuf);
+        if (ret < 0)
+                goto fail;
+
+        /* No need to rebalance, if there is some
+           activity on source file */
+        if ((new_stbuf.st_mtime != stbuf.st_mtime)
+            || (new_stbuf.st_size != stbuf.st_size)) {
+                ret = -1;
+                goto fail;
+        }
+
+        ret = fchmod (dst_fd, stbuf.st_mode);
+        if (ret) {
+                gf_log ("", GF_LOG_WARNING,
+                        "failed to set the mode of file %s: %s",
+                        tmp_filename, strerror (errno));
+        }
+
+        ret = fchown (dst_fd, stbuf.st_uid, stbuf.st_gid);
+        if (ret) {
+                gf_log ("", GF_LOG_WARNING,
+                        "failed to set the uid/gid of file %s: %s",
+                        tmp_filename, strerror (errno));
+        }
+
+        close (src_fd);
+        close (dst_fd);
+
+        ret = rename (tmp_filename, full_path);
+        if (ret == -1) {
+                unlink (tmp_filename);
+                gf_defrag_worker_account (defrag, worker, 0, 0, 0, 1);
+                return 0;
+        }
+
+        gf_defrag_worker_account (defrag, worker, 0, 1, stbuf.st_size, 0);
+        return 0;
+
+fail:
+        gf_log ("rebalance", GF_LOG_DEBUG, "migration of %s failed: %s",
+                full_path, strerror (errno));
+
+        if (src_fd != -1)
+                close (src_fd);
+
+        if (dst_fd != -1) {
+                close (dst_fd);
+                unlink (tmp_filename);
+        }
+
+        gf_defrag_worker_account (defrag, worker, 0, 0, 0, 1);
+        return 0;
+}
+
+
+static void
+gf_defrag_unit_hold (glusterd_defrag_info_t *defrag,
+                     struct gf_defrag_unit_ *unit)
+{
+        if (!unit)
+                return;
+
+        pthread_mutex_lock (&defrag->queue_lock);
+        {
+                unit->pending++;
+        }
+        pthread_mutex_unlock (&defrag->queue_lock);
+}
+
+
+static int
+gf_defrag_queue_dir (glusterd_defrag_info_t *defrag, const char *brick,
+                     const char *path, struct gf_defrag_unit_ *unit)
+{
+        struct gf_defrag_dir_ *dir = NULL;
+
+        dir = GF_CALLOC (1, sizeof (*dir), gf_gld_mt_defrag_dir_t);
+        if (!dir)
+                goto fail;
+
+        INIT_LIST_HEAD (&dir->list);
+
+        dir->brick = gf_strdup (brick);
+        dir->path  = gf_strdup (path);
+        if (!dir->brick || !dir->path)
+                goto fail;
+
+        dir->unit = unit;
+
+        pthread_mutex_lock (&defrag->queue_lock);
+        {
+                if (unit)
+                        unit->pending++;
+
+                list_add_tail (&dir->list, &defrag->queue);
+                defrag->queue_len++;
+                pthread_cond_signal (&defrag->queue_cond);
+        }
+        pthread_mutex_unlock (&defrag->queue_lock);
+
+        return 0;
+
+fail:
+        gf_log ("rebalance", GF_LOG_ERROR, "out of memory");
+
+        if (dir) {
+                if (dir->brick)
+                        GF_FREE (dir->brick);
+                if (dir->path)
+                        GF_FREE (dir->path);
+                GF_FREE (dir);
+        }
+
+        return -1;
+}
+
+
+static void
+gf_defrag_dir_destroy (struct gf_defrag_dir_ *dir)
+{
+        GF_FREE (dir->brick);
+        GF_FREE (dir->path);
+        GF_FREE (dir);
+}
+
+
+/* one directory of @unit is through, the last one through checkpoints the
+   whole subtree unless any of it failed */
+static void
+gf_defrag_unit_done (glusterd_defrag_info_t *defrag,
+                     struct gf_defrag_unit_ *unit, int failed)
+{
+        char     complete = 0;
+        ssize_t  len      = 0;
+
+        if (!unit)
+                return;
+
+        pthread_mutex_lock (&defrag->queue_lock);
+        {
+                if (failed)
+                        unit->failed = 1;
+
+                complete = (--unit->pending == 0);
+        }
+        pthread_mutex_unlock (&defrag->queue_lock);
+
+        if (!complete)
+                return;
+
+        if (!unit->failed && (defrag->checkpoint_fd != -1)
+            && !strchr (unit->name, '\n')) {
+                len = strlen (unit->name);
+
+                LOCK (&defrag->lock);
+                {
+                        unit->name[len] = '\n';
+                        if (write (defrag->checkpoint_fd, unit->name,
+                                   len + 1) != (len + 1))
+                                gf_log ("rebalance", GF_LOG_WARNING,
+                                        "failed to checkpoint %s: %s",
+                                        unit->name, strerror (errno));
+                        unit->name[len] = '\0';
+                }
+                UNLOCK (&defrag->lock);
+        }
+
+        GF_FREE (unit->name);
+        GF_FREE (unit);
+}
+
+
+static void
+gf_defrag_queue_flush (glusterd_defrag_info_t *defrag)
+{
+        struct gf_defrag_dir_ *dir = NULL, *tmp = NULL;
+
+        list_for_each_entry_safe (dir, tmp, &defrag->queue, list) {
+                list_del_init (&dir->list);
+                gf_defrag_unit_done (defrag, dir->unit, 1);
+                gf_defrag_dir_destroy (dir);
+        }
+
+        defrag->queue_len = 0;
+}
+
+
+static int
+gf_defrag_crawl_dir (struct gf_defrag_worker_ *worker,
+                     struct gf_defrag_dir_ *dir)
+{
+        glusterd_volinfo_t     *volinfo            = NULL;
         glusterd_defrag_info_t *defrag             = NULL;
+        DIR                    *fd                 = NULL;
         struct dirent          *entry              = NULL;
         struct stat             stbuf              = {0,};
-        struct stat             new_stbuf          = {0,};
-        char                    full_path[1024]    = {0,};
-        char                    tmp_filename[1024] = {0,};
-        char                    value[16]          = {0,};
+        char                    brick_path[PATH_MAX] = {0,};
+        char                    sub_dir[PATH_MAX]  = {0,};
+        int                     ret                = -1;
 
-        if (!volinfo->defrag)
-                goto out;
+        volinfo = worker->volinfo;
+        defrag  = volinfo->defrag;
 
-        defrag = volinfo->defrag;
+        snprintf (brick_path, PATH_MAX, "%s%s", dir->brick, dir->path);
 
-        fd = opendir (dir);
-        if (!fd)
+        fd = opendir (brick_path);
+        if (!fd) {
+                gf_log ("rebalance", GF_LOG_WARNING, "failed to open %s: %s",
+                        brick_path, strerror (errno));
                 goto out;
-        while ((entry = readdir (fd))) {
-                if (!entry)
-                        break;
+        }
 
+        while ((entry = readdir (fd))) {
                 if (!strcmp (entry->d_name, ".") || !strcmp (entry->d_name, ".."))
                         continue;
 
-                snprintf (full_path, 1024, "%s/%s", dir, entry->d_name);
+                snprintf (brick_path, PATH_MAX, "%s%s/%s", dir->brick,
+                          dir->path, entry->d_name);
 
-                ret = stat (full_path, &stbuf);
+                ret = lstat (brick_path, &stbuf);
                 if (ret == -1)
                         continue;
 
+                if (S_ISDIR (stbuf.st_mode)) {
+                        snprintf (sub_dir, PATH_MAX, "%s/%s", dir->path,
+                                  entry->d_name);
+                        ret = gf_defrag_queue_dir (defrag, dir->brick,
+                                                   sub_dir, NULL);
+                        if (ret)
+                                break;
+                        continue;
+                }
+
                 if (S_ISREG (stbuf.st_mode))
-                        defrag->num_files_lookedup += 1;
+                        gf_defrag_migrate_file (worker, dir->brick, dir->path,
+                                                entry->d_name);
 
-                if (!(S_ISREG (stbuf.st_mode) &&
-                      ((stbuf.st_mode & 01000) == 01000)))
-                        continue;
+                if (volinfo->defrag_status == GF_DEFRAG_STATUS_STOPED)
+                        break;
+        }
+        closedir (fd);
 
-                /* If the file is open, don't run rebalance on it */
-                ret = sys_lgetxattr (full_path, GLUSTERFS_OPEN_FD_COUNT,
-                                     &value, 16);
-                if ((ret < 0) || !strncmp (value, "1", 1))
-                        continue;
+        LOCK (&defrag->lock);
+        {
+                worker->dirs_crawled += 1;
+        }
+        UNLOCK (&defrag->lock);
 
-                /* If its a regular file, and sticky bit is set, we need to
-                   rebalance that */
-                snprintf (tmp_filename, 1024, "%s/.%s.gfs%llu", dir,
-                          entry->d_name,
-                          (unsigned long long)stbuf.st_size);
+        ret = 0;
+out:
+        return ret;
+}
 
-                dst_fd = creat (tmp_filename, (stbuf.st_mode & ~01000));
-                if (dst_fd == -1)
-                        continue;
 
-                src_fd = open (full_path, O_RDONLY);
-                if (src_fd == -1) {
-                        close (dst_fd);
-                        continue;
-                }
+static void *
+gf_defrag_worker (void *data)
+{
+        struct gf_defrag_worker_ *worker  = data;
+        glusterd_volinfo_t       *volinfo = NULL;
+        glusterd_defrag_info_t   *defrag  = NULL;
+        struct gf_defrag_dir_    *dir     = NULL;
+        int                       ret     = -1;
 
-                while (1) {
-                        ret = read (src_fd, defrag->databuf, 131072);
-                        if (!ret || (ret < 0)) {
-                                close (dst_fd);
-                                close (src_fd);
-                                break;
-                        }
-                        ret = write (dst_fd, defrag->databuf, ret);
-                        if (ret < 0) {
-                                close (dst_fd);
-                                close (src_fd);
-                                break;
+        volinfo = worker->volinfo;
+        defrag  = volinfo->defrag;
+
+        while (1) {
+                dir = NULL;
+
+                pthread_mutex_lock (&defrag->queue_lock);
+                {
+                        /* a busy worker may still queue subdirectories */
+                        while (list_empty (&defrag->queue) && defrag->busy)
+                                pthread_cond_wait (&defrag->queue_cond,
+                                                   &defrag->queue_lock);
+
+                        if (!list_empty (&defrag->queue)) {
+                                dir = list_entry (defrag->queue.next,
+                                                  struct gf_defrag_dir_, list);
+                                list_del_init (&dir->list);
+                                defrag->queue_len--;
+                                defrag->busy++;
                         }
                 }
+                pthread_mutex_unlock (&defrag->queue_lock);
 
-                ret = stat (full_path, &new_stbuf);
-                if (ret < 0)
-                        continue;
-                /* No need to rebalance, if there is some
-                   activity on source file */
-                if (new_stbuf.st_mtime != stbuf.st_mtime)
-                        continue;
+                if (!dir)
+                        break;
 
-                ret = fchmod (dst_fd, stbuf.st_mode);
-                if (ret) {
-                        gf_log ("", GF_LOG_WARNING,
-                                "failed to set the mode of file %s: %s",
-                                tmp_filename, strerror (errno));
+                ret = -1;
+                if (volinfo->defrag_status != GF_DEFRAG_STATUS_STOPED)
+                        ret = worker->crawl (worker, dir);
+
+                gf_defrag_unit_done (defrag, dir->unit, ret);
+                gf_defrag_dir_destroy (dir);
+
+                pthread_mutex_lock (&defrag->queue_lock);
+                {
+                        defrag->busy--;
+                        if (!defrag->busy && list_empty (&defrag->queue))
+                                pthread_cond_broadcast (&defrag->queue_cond);
                 }
+                pthread_mutex_unlock (&defrag->queue_lock);
+        }
 
-                ret = fchown (dst_fd, stbuf.st_uid, stbuf.st_gid);
+        return NULL;
+}
+
+
+/* runs @count workers over the queued directories until none is left */
+static int
+gf_defrag_run_workers (glusterd_volinfo_t *volinfo, int count,
+                       gf_defrag_crawl_t crawl, size_t buf_size)
+{
+        glusterd_defrag_info_t   *defrag  = NULL;
+        struct gf_defrag_worker_ *workers = NULL, *old = NULL;
+        int                       started = 0;
+        int                       ret     = -1;
+        int                       i       = 0;
+
+        defrag = volinfo->defrag;
+
+        workers = GF_CALLOC (count, sizeof (*workers),
+                             gf_gld_mt_defrag_worker_t);
+        if (!workers)
+                goto out;
+
+        for (i = 0; i < count; i++) {
+                workers[i].idx     = i;
+                workers[i].volinfo = volinfo;
+                workers[i].crawl   = crawl;
+
+                if (!buf_size)
+                        continue;
+
+                workers[i].buf = GF_MALLOC (buf_size, gf_gld_mt_char);
+                if (!workers[i].buf)
+                        break;
+        }
+
+        count = i;
+
+        LOCK (&defrag->lock);
+        {
+                old = defrag->workers;
+                defrag->workers = workers;
+                defrag->worker_count = count;
+        }
+        UNLOCK (&defrag->lock);
+
+        if (old)
+                GF_FREE (old);
+
+        for (i = 0; i < count; i++) {
+                ret = pthread_create (&workers[i].th, NULL, gf_defrag_worker,
+                                      &workers[i]);
                 if (ret) {
-                        gf_log ("", GF_LOG_WARNING,
-                                "failed to set the uid/gid of file %s: %s",
-                                tmp_filename, strerror (errno));
+                        gf_log ("rebalance", GF_LOG_WARNING,
+                                "failed to start worker %d: %s", i,
+                                strerror (ret));
+                        break;
                 }
+                started++;
+        }
 
-                ret = rename (tmp_filename, full_path);
-                if (ret != -1) {
-                        LOCK (&defrag->lock);
-                        {
-                                defrag->total_files += 1;
-                                defrag->total_data += stbuf.st_size;
-                        }
-                        UNLOCK (&defrag->lock);
-                }
+        for (i = 0; i < started; i++)
+                pthread_join (workers[i].th, NULL);
 
-                if (volinfo->defrag_status == GF_DEFRAG_STATUS_STOPED) {
-                        closedir (fd);
-                        ret = -1;
-                        goto out;
-                }
+        for (i = 0; i < count; i++) {
+                if (workers[i].buf)
+                        GF_FREE (workers[i].buf);
+                workers[i].buf = NULL;
         }
-        closedir (fd);
 
-        fd = opendir (dir);
-        if (!fd)
+        ret = started ? 0 : -1;
+out:
+        gf_defrag_queue_flush (defrag);
+
+        return ret;
+}
+
+
+/*
+ * migrates the files held by the bricks of this node. every node holding
+ * bricks of the volume runs it for its own bricks, crawling them directly
+ * with a pool of GF_DEFRAG_THREADS workers instead of crawling the whole
+ * volume through the mount.
+ */
+int
+gf_glusterd_rebalance_move_data (glusterd_volinfo_t *volinfo)
+{
+        glusterd_conf_t          *priv      = NULL;
+        glusterd_defrag_info_t   *defrag    = NULL;
+        glusterd_brickinfo_t     *brickinfo = NULL;
+        int                       ret       = -1;
+        int                       index     = 0;
+
+        priv = THIS->private;
+
+        if (!volinfo->defrag)
                 goto out;
-        while ((entry = readdir (fd))) {
-                if (!entry)
-                        break;
 
-                if (!strcmp (entry->d_name, ".") || !strcmp (entry->d_name, ".."))
+        defrag = volinfo->defrag;
+
+        /* one brick of each replica or stripe set crawls for the set */
+        list_for_each_entry (brickinfo, &volinfo->bricks, brick_list) {
+                if ((volinfo->sub_count > 1)
+                    && (index++ % volinfo->sub_count))
                         continue;
 
-                snprintf (full_path, 1024, "%s/%s", dir, entry->d_name);
+                if (uuid_is_null (brickinfo->uuid)) {
+                        ret = glusterd_resolve_brick (brickinfo);
+                        if (ret)
+                                continue;
+                }
 
-                ret = stat (full_path, &stbuf);
-                if (ret == -1)
+                if (uuid_compare (brickinfo->uuid, priv->uuid))
                         continue;
 
-                if (!S_ISDIR (stbuf.st_mode))
-                        continue;
+                gf_log ("rebalance", GF_LOG_NORMAL, "migrating data of %s:%s",
+                        brickinfo->hostname, brickinfo->path);
 
-                ret = gf_glusterd_rebalance_move_data (volinfo,
-                                                       full_path);
-                if (ret)
-                        break;
+                ret = gf_defrag_queue_dir (defrag, brickinfo->path, "", NULL);
+                if (ret) {
+                        gf_defrag_queue_flush (defrag);
+                        goto out;
+                }
         }
-        closedir (fd);
 
-        if (!entry)
+        if (list_empty (&defrag->queue)) {
+                gf_log ("rebalance", GF_LOG_NORMAL, "no bricks of %s on this "
+                        "node, nothing to migrate", volinfo->volname);
                 ret = 0;
+                goto out;
+        }
+
+        ret = gf_defrag_run_workers (volinfo, GF_DEFRAG_THREADS,
+                                     gf_defrag_crawl_dir,
+                                     GF_DEFRAG_CHUNK_SIZE);
+        if (ret)
+                goto out;
+
+        ret = (volinfo->defrag_status == GF_DEFRAG_STATUS_STOPED) ? -1 : 0;
 out:
         return ret;
 }
 
-int
-gf_glusterd_rebalance_fix_layout (glusterd_volinfo_t *volinfo, const char *dir)
+
+/*
+ * the subtrees of the root whose layouts got fixed are appended to a
+ * checkpoint file as they complete, so that a fix-layout which got stopped
+ * or failed goes on where it left. the checkpoint holds only while the
+ * volume has the bricks it was taken with.
+ */
+static void
+gf_defrag_checkpoint_open (glusterd_volinfo_t *volinfo)
 {
-        int            ret             = -1;
-        char           value[128]      = {0,};
-        char           full_path[1024] = {0,};
-        struct stat    stbuf           = {0,};
-        DIR           *fd              = NULL;
-        struct dirent *entry           = NULL;
+        glusterd_conf_t        *priv      = NULL;
+        glusterd_defrag_info_t *defrag    = NULL;
+        FILE                   *fp        = NULL;
+        char                    voldir[PATH_MAX] = {0,};
+        char                    path[PATH_MAX]   = {0,};
+        char                    line[PATH_MAX]   = {0,};
+        char                   *nl        = NULL;
+        int                     bricks    = -1;
+        int                     done      = 0;
+        int                     flags     = O_WRONLY | O_CREAT | O_APPEND;
+
+        priv   = THIS->private;
+        defrag = volinfo->defrag;
 
-        if (!volinfo->defrag)
-                goto out;
+        defrag->checkpoint_fd = -1;
+
+        defrag->layout_done = dict_new ();
+        if (!defrag->layout_done)
+                return;
+
+        GLUSTERD_GET_VOLUME_DIR (voldir, volinfo, priv);
+        snprintf (path, PATH_MAX, "%s/%s", voldir,
+                  GF_DEFRAG_LAYOUT_CHECKPOINT);
+
+        fp = fopen (path, "r");
+        if (fp) {
+                if (fscanf (fp, "bricks %d\n", &bricks) != 1)
+                        bricks = -1;
+
+                while ((bricks == volinfo->brick_count)
+                       && fgets (line, PATH_MAX, fp)) {
+                        nl = strchr (line, '\n');
+                        if (!nl)
+                                continue;
+                        *nl = '\0';
+
+                        if (!dict_set_int32 (defrag->layout_done, line, 1))
+                                done++;
+                }
+                fclose (fp);
+        }
+
+        if (bricks != volinfo->brick_count) {
+                flags |= O_TRUNC;
+                done = 0;
+        }
+
+        defrag->checkpoint_fd = open (path, flags, 0600);
+        if (defrag->checkpoint_fd == -1) {
+                gf_log ("rebalance", GF_LOG_WARNING, "failed to open %s: %s",
+                        path, strerror (errno));
+                return;
+        }
+
+        if (flags & O_TRUNC) {
+                snprintf (line, PATH_MAX, "bricks %d\n", volinfo->brick_count);
+                if (write (defrag->checkpoint_fd, line, strlen (line)) < 0)
+                        gf_log ("rebalance", GF_LOG_WARNING,
+                                "failed to write %s: %s", path,
+                                strerror (errno));
+        }
+
+        if (done)
+                gf_log ("rebalance", GF_LOG_NORMAL, "resuming fix-layout of "
+                        "%s, %d subtrees of the root are fixed already",
+                        volinfo->volname, done);
+}
 
-        fd = opendir (dir);
-        if (!fd)
+
+static void
+gf_defrag_checkpoint_close (glusterd_volinfo_t *volinfo, int complete)
+{
+        glusterd_conf_t        *priv   = NULL;
+        glusterd_defrag_info_t *defrag = NULL;
+        char                    voldir[PATH_MAX] = {0,};
+        char                    path[PATH_MAX]   = {0,};
+
+        priv   = THIS->private;
+        defrag = volinfo->defrag;
+
+        if (defrag->checkpoint_fd != -1)
+                close (defrag->checkpoint_fd);
+        defrag->checkpoint_fd = -1;
+
+        if (defrag->layout_done)
+                dict_unref (defrag->layout_done);
+        defrag->layout_done = NULL;
+
+        if (!complete)
+                return;
+
+        GLUSTERD_GET_VOLUME_DIR (voldir, volinfo, priv);
+        snprintf (path, PATH_MAX, "%s/%s", voldir,
+                  GF_DEFRAG_LAYOUT_CHECKPOINT);
+        unlink (path);
+}
+
+
+static struct gf_defrag_unit_ *
+gf_defrag_unit_new (const char *name)
+{
+        struct gf_defrag_unit_ *unit = NULL;
+
+        unit = GF_CALLOC (1, sizeof (*unit), gf_gld_mt_defrag_unit_t);
+        if (!unit)
+                return NULL;
+
+        unit->name = gf_strdup (name);
+        if (!unit->name) {
+                GF_FREE (unit);
+                return NULL;
+        }
+
+        return unit;
+}
+
+
+/*
+ * fixes the layout of the directory and queues its subdirectories. once
+ * the queue is full, subdirectories are walked in place instead, which
+ * keeps the memory bounded however wide the tree is.
+ */
+static int
+gf_defrag_fix_layout_dir (struct gf_defrag_worker_ *worker,
+                          struct gf_defrag_dir_ *dir)
+{
+        glusterd_volinfo_t     *volinfo         = NULL;
+        glusterd_defrag_info_t *defrag          = NULL;
+        struct gf_defrag_unit_ *unit            = NULL;
+        struct gf_defrag_dir_   child           = {{0,},};
+        DIR                    *fd              = NULL;
+        struct dirent          *entry           = NULL;
+        struct stat             stbuf           = {0,};
+        char                    full_path[PATH_MAX] = {0,};
+        char                    sub_dir[PATH_MAX]   = {0,};
+        char                    value[128]      = {0,};
+        int                     queue_full      = 0;
+        int                     ret             = -1;
+
+        volinfo = worker->volinfo;
+        defrag  = volinfo->defrag;
+
+        snprintf (full_path, PATH_MAX, "%s%s", dir->brick, dir->path);
+
+        /* Fix the layout of the directory */
+        sys_lgetxattr (full_path, "trusted.distribute.fix.layout",
+                       &value, 128);
+
+        LOCK (&defrag->lock);
+        {
+                worker->layouts_fixed += 1;
+                defrag->total_files += 1;
+        }
+        UNLOCK (&defrag->lock);
+
+        fd = opendir (full_path);
+        if (!fd) {
+                gf_log ("rebalance", GF_LOG_WARNING, "failed to open %s: %s",
+                        full_path, strerror (errno));
                 goto out;
+        }
 
         while ((entry = readdir (fd))) {
-                if (!entry)
-                        break;
-
                 if (!strcmp (entry->d_name, ".") || !strcmp (entry->d_name, ".."))
                         continue;
 
-                snprintf (full_path, 1024, "%s/%s", dir, entry->d_name);
-
-                ret = stat (full_path, &stbuf);
-                if (ret == -1)
+                if (entry->d_type == DT_UNKNOWN) {
+                        snprintf (full_path, PATH_MAX, "%s%s/%s", dir->brick,
+                                  dir->path, entry->d_name);
+                        ret = stat (full_path, &stbuf);
+                        if ((ret == -1) || !S_ISDIR (stbuf.st_mode))
+                                continue;
+                } else if (entry->d_type != DT_DIR) {
                         continue;
+                }
 
-                if (S_ISDIR (stbuf.st_mode)) {
-                        /* Fix the layout of the directory */
-                        sys_lgetxattr (full_path, "trusted.distribute.fix.layout",
-                                       &value, 128);
+                snprintf (sub_dir, PATH_MAX, "%s/%s", dir->path,
+                          entry->d_name);
 
-                        volinfo->defrag->total_files += 1;
+                unit = dir->unit;
+                if (!unit) {
+                        /* a subtree of the root */
+                        if (defrag->layout_done
+                            && dict_get (defrag->layout_done, entry->d_name))
+                                continue;
 
-                        /* Traverse into subdirectory */
-                        ret = gf_glusterd_rebalance_fix_layout (volinfo,
-                                                                full_path);
-                        if (ret)
+                        unit = gf_defrag_unit_new (entry->d_name);
+                        if (!unit) {
+                                ret = -1;
                                 break;
+                        }
+                }
+
+                pthread_mutex_lock (&defrag->queue_lock);
+                {
+                        queue_full = (defrag->queue_len >= GF_DEFRAG_QUEUE_MAX);
+                }
+                pthread_mutex_unlock (&defrag->queue_lock);
+
+                if (queue_full) {
+                        child.brick = dir->brick;
+                        child.path  = sub_dir;
+                        child.unit  = unit;
+
+                        gf_defrag_unit_hold (defrag, unit);
+                        ret = gf_defrag_fix_layout_dir (worker, &child);
+                        gf_defrag_unit_done (defrag, unit, ret);
+                } else {
+                        ret = gf_defrag_queue_dir (defrag, dir->brick, sub_dir,
+                                                   unit);
+                        if (ret && (unit != dir->unit)) {
+                                GF_FREE (unit->name);
+                                GF_FREE (unit);
+                        }
                 }
 
+                if (ret)
+                        break;
+
                 if (volinfo->defrag_status == GF_DEFRAG_STATUS_STOPED) {
-                        closedir (fd);
                         ret = -1;
-                        goto out;
+                        break;
                 }
         }
         closedir (fd);
 
+        LOCK (&defrag->lock);
+        {
+                worker->dirs_crawled += 1;
+        }
+        UNLOCK (&defrag->lock);
+
         if (!entry)
                 ret = 0;
+out:
+        return ret;
+}
+
+
+/*
+ * fixes the layouts of all the directories, GF_DEFRAG_LAYOUT_THREADS of
+ * them at a time. a directory is only queued once its parent is fixed.
+ */
+int
+gf_glusterd_rebalance_fix_layout (glusterd_volinfo_t *volinfo)
+{
+        glusterd_defrag_info_t *defrag = NULL;
+        int                     ret    = -1;
+
+        if (!volinfo->defrag)
+                goto out;
+
+        defrag = volinfo->defrag;
+
+        gf_defrag_checkpoint_open (volinfo);
+
+        ret = gf_defrag_queue_dir (defrag, defrag->mount, "", NULL);
+        if (ret)
+                goto close;
+
+        ret = gf_defrag_run_workers (volinfo, GF_DEFRAG_LAYOUT_THREADS,
+                                     gf_defrag_fix_layout_dir, 0);
+        if (ret)
+                goto close;
 
+        ret = (volinfo->defrag_status == GF_DEFRAG_STATUS_STOPED) ? -1 : 0;
+close:
+        gf_defrag_checkpoint_close (volinfo, !ret);
 out:
         return ret;
 }
@@ -259,7 +920,6 @@ glusterd_defrag_start (void *data)
         char                    cmd_str[1024] = {0,};
         int                     ret     = -1;
         struct stat             stbuf   = {0,};
-        char                    value[128] = {0,};
 
         defrag = volinfo->defrag;
         if (!defrag)
@@ -280,15 +940,8 @@ glusterd_defrag_start (void *data)
                 }
         }
 
-        /* Fix the root ('/') first */
-        sys_lgetxattr (defrag->mount, "trusted.distribute.fix.layout",
-                       &value, 128);
-
-        /* root's layout got fixed */
-        defrag->total_files = 1;
-
-        /* Step 1: Fix layout of all the directories */
-        ret = gf_glusterd_rebalance_fix_layout (volinfo, defrag->mount);
+        /* Step 1: Fix layout of all the directories, root ('/') first */
+        ret = gf_glusterd_rebalance_fix_layout (volinfo);
         if (ret) {
                 volinfo->defrag_status   = GF_DEFRAG_STATUS_FAILED;
                 goto out;
@@ -300,8 +953,8 @@ glusterd_defrag_start (void *data)
         /* It was used by number of layout fixes on directories */
         defrag->total_files = 0;
 
-        /* Step 2: Iterate over directories to move data */
-        ret = gf_glusterd_rebalance_move_data (volinfo, defrag->mount);
+        /* Step 2: Migrate the data held by the bricks of this node */
+        ret = gf_glusterd_rebalance_move_data (volinfo);
         if (ret) {
                 volinfo->defrag_status   = GF_DEFRAG_STATUS_FAILED;
         }
@@ -321,7 +974,11 @@ out:
 
                 snprintf (cmd_str, 1024, "umount -l %s", defrag->mount);
                 ret = system (cmd_str);
+                pthread_mutex_destroy (&defrag->queue_lock);
+                pthread_cond_destroy (&defrag->queue_cond);
                 LOCK_DESTROY (&defrag->lock);
+                if (defrag->workers)
+                        GF_FREE (defrag->workers);
                 GF_FREE (defrag);
         }
 
@@ -377,6 +1034,66 @@ out:
         return 0;
 }
 
+void
+glusterd_defrag_dump (glusterd_volinfo_t *volinfo)
+{
+        glusterd_defrag_info_t   *defrag = NULL;
+        struct gf_defrag_worker_ *worker = NULL;
+        char                      key[GF_DUMP_MAX_BUF_LEN];
+        char                      key_prefix[GF_DUMP_MAX_BUF_LEN];
+        int                       i      = 0;
+
+        defrag = volinfo->defrag;
+        if (!defrag)
+                return;
+
+        snprintf (key_prefix, GF_DUMP_MAX_BUF_LEN, "glusterd.rebalance.%s",
+                  volinfo->volname);
+        gf_proc_dump_add_section (key_prefix);
+
+        LOCK (&defrag->lock);
+        {
+                gf_proc_dump_build_key (key, key_prefix, "status");
+                gf_proc_dump_write (key, "%d", volinfo->defrag_status);
+                gf_proc_dump_build_key (key, key_prefix, "files_lookedup");
+                gf_proc_dump_write (key, "%"PRIu64,
+                                    defrag->num_files_lookedup);
+                gf_proc_dump_build_key (key, key_prefix, "files_migrated");
+                gf_proc_dump_write (key, "%"PRIu64, defrag->total_files);
+                gf_proc_dump_build_key (key, key_prefix, "data_migrated");
+                gf_proc_dump_write (key, "%"PRIu64, defrag->total_data);
+
+                for (i = 0; i < defrag->worker_count; i++) {
+                        worker = &defrag->workers[i];
+
+                        gf_proc_dump_build_key (key, key_prefix,
+                                                "worker[%d].dirs_crawled", i);
+                        gf_proc_dump_write (key, "%"PRIu64,
+                                            worker->dirs_crawled);
+                        gf_proc_dump_build_key (key, key_prefix,
+                                                "worker[%d].layouts_fixed", i);
+                        gf_proc_dump_write (key, "%"PRIu64,
+                                            worker->layouts_fixed);
+                        gf_proc_dump_build_key (key, key_prefix,
+                                                "worker[%d].files_lookedup", i);
+                        gf_proc_dump_write (key, "%"PRIu64,
+                                            worker->files_lookedup);
+                        gf_proc_dump_build_key (key, key_prefix,
+                                                "worker[%d].files_migrated", i);
+                        gf_proc_dump_write (key, "%"PRIu64,
+                                            worker->files_migrated);
+                        gf_proc_dump_build_key (key, key_prefix,
+                                                "worker[%d].data_migrated", i);
+                        gf_proc_dump_write (key, "%"PRIu64,
+                                            worker->data_migrated);
+                        gf_proc_dump_build_key (key, key_prefix,
+                                                "worker[%d].failures", i);
+                        gf_proc_dump_write (key, "%"PRIu64, worker->failures);
+                }
+        }
+        UNLOCK (&defrag->lock);
+}
+
 int
 glusterd_handle_defrag_volume (rpcsvc_request_t *req)
 {
@@ -453,8 +1170,13 @@ glusterd_handle_defrag_volume (rpcsvc_request_t *req)
                 defrag = volinfo->defrag;
 
                 LOCK_INIT (&defrag->lock);
+                pthread_mutex_init (&defrag->queue_lock, NULL);
+                pthread_cond_init (&defrag->queue_cond, NULL);
+                INIT_LIST_HEAD (&defrag->queue);
+                defrag->checkpoint_fd = -1;
                 snprintf (defrag->mount, 1024, "%s/mount/%s",
                           priv->workdir, cli_req.volname);
+                uuid_utoa_r (priv->uuid, defrag->node_uuid);
                 /* Create a directory, mount glusterfs over it, start glusterfs-defrag */
                 snprintf (cmd_str, 4096, "mkdir -p %s", defrag->mount);
                 ret = system (cmd_str);
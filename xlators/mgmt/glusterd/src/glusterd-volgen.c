@@ -86,6 +86,8 @@ struct volopt_map_entry {
 static struct volopt_map_entry glusterd_volopt_map[] = {
         {"cluster.lookup-unhashed",              "cluster/distribute",        }, /* NODOC */
         {"cluster.min-free-disk",                "cluster/distribute",        }, /* NODOC */
+        {"cluster.weighted-rebalance",           "cluster/distribute",        "weighted-layout",},
+        {"cluster.du-refresh-interval",          "cluster/distribute",        "du-refresh-interval",},
 
         {"cluster.entry-change-log",             "cluster/replicate",         }, /* NODOC */
         {"cluster.read-subvolume",               "cluster/replicate",         }, /* NODOC */
@@ -100,6 +102,10 @@ static struct volopt_map_entry glusterd_volopt_map[] = {
         {"cluster.data-self-heal-algorithm",     "cluster/replicate",         "data-self-heal-algorithm"},
 
         {"cluster.stripe-block-size",            "cluster/stripe",            "block-size",},
+        {"cluster.stripe-redundancy",            "cluster/stripe",            "redundancy",},
+        {"cluster.stripe-coalesce",              "cluster/stripe",            "coalesce",},
+        {"cluster.stripe-aggregate-writes",      "cluster/stripe",            "aggregate-writes",},
+        {"cluster.stripe-read-ahead",            "cluster/stripe",            "read-ahead",},
 
         {"diagnostics.latency-measurement",      "debug/io-stats",            },
         {"diagnostics.dump-fd-stats",            "debug/io-stats",            },
@@ -115,15 +121,31 @@ static struct volopt_map_entry glusterd_volopt_map[] = {
         {"performance.flush-behind",             "performance/write-behind",      "flush-behind",},
 
         {"performance.io-thread-count",          "performance/io-threads",    "thread-count",},
+        {"performance.io-thread-fair-share",     "performance/io-threads",    "fair-share",},
+        {"performance.io-thread-deadline",       "performance/io-threads",    "deadline",},
+        {"performance.io-thread-auto-scale",     "performance/io-threads",    "auto-scale",},
+        {"performance.io-thread-min-count",      "performance/io-threads",    "min-threads",},
+        {"performance.io-thread-target-wait",    "performance/io-threads",    "target-wait",},
 
         {"performance.disk-usage-limit",         "performance/quota",         }, /* NODOC */
         {"performance.min-free-disk-limit",      "performance/quota",         }, /* NODOC */
 
+        {"features.limit-usage",                 "features/quota",            "limit-set",},
+        {"features.quota-timeout",               "features/quota",            "timeout",},
+        {"features.quota-update-interval",       "features/marker",           "quota-update-interval",}, /* NODOC */
+        {"features.xtime-update-interval",       "features/marker",           "xtime-update-interval",}, /* NODOC */
+
         {"performance.write-behind-window-size", "performance/write-behind",  "cache-size",},
+        {"performance.write-behind-extent-size", "performance/write-behind",  "extent-size",},
+        {"performance.write-behind-global-cache-size", "performance/write-behind", "global-cache-size",},
+
+        {"performance.stat-prefetch-negative-timeout", "performance/stat-prefetch", "negative-timeout",},
 
         {"network.frame-timeout",                "protocol/client",           },
         {"network.ping-timeout",                 "protocol/client",           },
         {"network.inode-lru-limit",              "protocol/server",           }, /* NODOC */
+        {"network.max-write-size",               "protocol/server",           GF_MAX_WRITE_SIZE_KEY,},
+        {"network.max-write-size",               "protocol/client",           GF_MAX_WRITE_SIZE_KEY,},
 
         {"auth.allow",                           "protocol/server",           "!server-auth", "*"},
         {"auth.reject",                          "protocol/server",           "!server-auth",},
@@ -140,6 +162,9 @@ static struct volopt_map_entry glusterd_volopt_map[] = {
         {"nfs.mem-factor",                       "nfs/server",                "nfs.mem-factor",},
 
         {MARKER_VOL_KEY,                         "features/marker",           "!marker", "off"},
+        {QUOTA_VOL_KEY,                          "features/marker",           "!quota", "off"},
+        {CHANGELOG_VOL_KEY,                      "features/changelog",        "!changelog", "off"},
+        {"features.changelog-rollover-time",     "features/changelog",        "rollover-time",},
 
         {NULL,                                                                }
 };
@@ -983,6 +1008,8 @@ server_spec_option_handler (glusterfs_graph_t *graph,
 }
 
 static void get_vol_tstamp_file (char *filename, glusterd_volinfo_t *volinfo);
+static void get_vol_changelog_dir (char *dirname, glusterd_volinfo_t *volinfo,
+                                   char *brickpath);
 
 static int
 server_graph_builder (glusterfs_graph_t *graph, glusterd_volinfo_t *volinfo,
@@ -999,6 +1026,11 @@ server_graph_builder (glusterfs_graph_t *graph, glusterd_volinfo_t *volinfo,
         char      tstamp_file[PATH_MAX] = {0,};
         char     *marker_val = NULL;
         gf_boolean_t marker = _gf_false;
+        char     *quota_val = NULL;
+        gf_boolean_t quota = _gf_false;
+        char     *changelog_val = NULL;
+        gf_boolean_t changelog = _gf_false;
+        char      changelog_dir[PATH_MAX] = {0,};
         int       ret = 0;
 
         path = param;
@@ -1013,6 +1045,26 @@ server_graph_builder (glusterfs_graph_t *graph, glusterd_volinfo_t *volinfo,
         if (ret)
                 return -1;
 
+        ret = volgen_dict_get (set_dict, CHANGELOG_VOL_KEY, &changelog_val);
+        if (ret)
+                return -1;
+        if (changelog_val)
+                ret = gf_string2boolean (changelog_val, &changelog);
+        if (ret) {
+                gf_log ("", GF_LOG_ERROR, "value for "CHANGELOG_VOL_KEY" option is junk");
+
+                return -1;
+        }
+        if (changelog) {
+                xl = volgen_graph_add (graph, "features/changelog", volname);
+                if (!xl)
+                        return -1;
+                get_vol_changelog_dir (changelog_dir, volinfo, path);
+                ret = xlator_set_option (xl, "changelog-dir", changelog_dir);
+                if (ret)
+                        return -1;
+        }
+
         xl = volgen_graph_add (graph, "features/access-control", volname);
         if (!xl)
                 return -1;
@@ -1062,7 +1114,20 @@ server_graph_builder (glusterfs_graph_t *graph, glusterd_volinfo_t *volinfo,
 
                 return -1;
         }
-        if (marker) {
+
+        ret = volgen_dict_get (set_dict, QUOTA_VOL_KEY, &quota_val);
+        if (ret)
+                return -1;
+        if (quota_val)
+                ret = gf_string2boolean (quota_val, &quota);
+        if (ret) {
+                gf_log ("", GF_LOG_ERROR, "value for "QUOTA_VOL_KEY" option is junk");
+
+                return -1;
+        }
+
+        /* marker keeps the xtimes and the quota usage, either or both */
+        if (marker || quota) {
                 xl = volgen_graph_add (graph, "features/marker", volname);
                 if (!xl)
                         return -1;
@@ -1074,6 +1139,12 @@ server_graph_builder (glusterfs_graph_t *graph, glusterd_volinfo_t *volinfo,
                 ret = xlator_set_option (xl, "timestamp-file", tstamp_file);
                 if (ret)
                         return -1;
+                ret = xlator_set_option (xl, "xtime", marker ? "on" : "off");
+                if (ret)
+                        return -1;
+                ret = xlator_set_option (xl, "quota", quota ? "on" : "off");
+                if (ret)
+                        return -1;
         }
 
         xl = volgen_graph_add_as (graph, "debug/io-stats", path);
@@ -1147,6 +1218,8 @@ client_graph_builder (glusterfs_graph_t *graph, glusterd_volinfo_t *volinfo,
         xlator_t                *xl                 = NULL;
         xlator_t                *txl                = NULL;
         xlator_t                *trav               = NULL;
+        char                    *quota_val          = NULL;
+        gf_boolean_t             quota              = _gf_false;
 
         volname = volinfo->volname;
         dict    = volinfo->dict;
@@ -1261,6 +1334,22 @@ client_graph_builder (glusterfs_graph_t *graph, glusterd_volinfo_t *volinfo,
                 }
         }
 
+        ret = volgen_dict_get (set_dict, QUOTA_VOL_KEY, &quota_val);
+        if (ret)
+                return -1;
+        if (quota_val)
+                ret = gf_string2boolean (quota_val, &quota);
+        if (ret) {
+                gf_log ("", GF_LOG_ERROR, "value for "QUOTA_VOL_KEY" option is junk");
+
+                return -1;
+        }
+        if (quota) {
+                xl = volgen_graph_add (graph, "features/quota", volname);
+                if (!xl)
+                        return -1;
+        }
+
         ret = volgen_graph_set_options_generic (graph, set_dict, volname,
                                                 &perfxl_option_handler);
         if (ret)
@@ -1474,6 +1563,23 @@ get_vol_tstamp_file (char *filename, glusterd_volinfo_t *volinfo)
                  PATH_MAX - strlen(filename) - 1);
 }
 
+/* kept out of the brick, so that clients do not see it */
+static void
+get_vol_changelog_dir (char *dirname, glusterd_volinfo_t *volinfo,
+                       char *brickpath)
+{
+        glusterd_conf_t *priv  = NULL;
+        char             brick[PATH_MAX] = {0,};
+        char             path[PATH_MAX] = {0,};
+
+        priv = THIS->private;
+
+        GLUSTERD_REMOVE_SLASH_FROM_PATH (brickpath, brick);
+        GLUSTERD_GET_VOLUME_DIR (path, volinfo, priv);
+
+        snprintf (dirname, PATH_MAX, "%s/changelogs/%s", path, brick);
+}
+
 static int
 generate_brick_volfiles (glusterd_volinfo_t *volinfo)
 {
@@ -28,6 +28,8 @@
 #include "glusterd.h"
 
 #define MARKER_VOL_KEY "monitor.xtime-marker"
+#define QUOTA_VOL_KEY "features.quota"
+#define CHANGELOG_VOL_KEY "features.changelog"
 
 int glusterd_create_rb_volfiles (glusterd_volinfo_t *volinfo,
                                  glusterd_brickinfo_t *brickinfo);
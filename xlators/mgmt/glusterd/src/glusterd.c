@@ -127,6 +127,17 @@ glusterd_fetchspec_notify (xlator_t *this)
 int
 glusterd_priv (xlator_t *this)
 {
+        glusterd_conf_t    *priv    = NULL;
+        glusterd_volinfo_t *volinfo = NULL;
+
+        priv = this->private;
+        if (!priv)
+                return 0;
+
+        list_for_each_entry (volinfo, &priv->volumes, vol_list) {
+                glusterd_defrag_dump (volinfo);
+        }
+
         return 0;
 }
 
@@ -52,6 +52,12 @@
 #define GLUSTERD_TR_LOG_SIZE            50
 #define GLUSTERD_NAME                   "glusterd"
 
+#define GF_DEFRAG_THREADS               8
+#define GF_DEFRAG_CHUNK_SIZE            (4 * GF_UNIT_MB)
+#define GF_DEFRAG_LAYOUT_THREADS        16
+#define GF_DEFRAG_QUEUE_MAX             65536
+#define GF_DEFRAG_LAYOUT_CHECKPOINT     "rebalance-layout.checkpoint"
+
 
 typedef enum glusterd_op_ {
         GD_OP_NONE = 0,
@@ -138,6 +144,41 @@ typedef enum gf_defrag_status_ {
         GF_DEFRAG_STATUS_FAILED,
 } gf_defrag_status_t;
 
+/* a subtree of the root whose layout fix is checkpointed once complete */
+struct gf_defrag_unit_ {
+        char             *name;
+        int               pending;
+        char              failed;
+};
+
+/* a directory still to be crawled, relative to @brick (a local brick or
+   the mount) */
+struct gf_defrag_dir_ {
+        struct list_head        list;
+        char                   *brick;
+        char                   *path;
+        struct gf_defrag_unit_ *unit;
+};
+
+struct gf_defrag_worker_;
+
+typedef int (*gf_defrag_crawl_t) (struct gf_defrag_worker_ *worker,
+                                  struct gf_defrag_dir_ *dir);
+
+struct gf_defrag_worker_ {
+        pthread_t                 th;
+        int                       idx;
+        struct glusterd_volinfo_ *volinfo;
+        gf_defrag_crawl_t         crawl;
+        char                     *buf;
+        uint64_t                  dirs_crawled;
+        uint64_t                  layouts_fixed;
+        uint64_t                  files_lookedup;
+        uint64_t                  files_migrated;
+        uint64_t                  data_migrated;
+        uint64_t                  failures;
+};
+
 struct glusterd_defrag_info_ {
         uint64_t                     total_files;
         uint64_t                     total_data;
@@ -145,8 +186,21 @@ struct glusterd_defrag_info_ {
         gf_lock_t                    lock;
         pthread_t                    th;
         char                         mount[1024];
-        char                         databuf[131072];
+        char                         node_uuid[50]; /* tags temp files */
         struct gf_defrag_brickinfo_ *bricks; /* volinfo->brick_count */
+
+        /* the workers of a step share a queue of directories */
+        pthread_mutex_t              queue_lock;
+        pthread_cond_t               queue_cond;
+        struct list_head             queue;
+        int                          queue_len;
+        int                          busy;
+        int                          worker_count;
+        struct gf_defrag_worker_    *workers;
+
+        /* subtrees of the root whose layouts are fixed already */
+        dict_t                      *layout_done;
+        int                          checkpoint_fd;
 };
 
 
@@ -351,6 +405,9 @@ glusterd_handle_create_volume (rpcsvc_request_t *req);
 int
 glusterd_handle_defrag_volume (rpcsvc_request_t *req);
 
+void
+glusterd_defrag_dump (glusterd_volinfo_t *volinfo);
+
 int
 glusterd_xfer_cli_probe_resp (rpcsvc_request_t *req, int32_t op_ret,
                               int32_t op_errno, char *hostname, int port);
@@ -33,10 +33,12 @@
 #include "xdr-rpc.h"
 #include "iobuf.h"
 #include "globals.h"
+#include "hashfn.h"
 
 #include <errno.h>
 #include <pthread.h>
 #include <stdlib.h>
+#include <unistd.h>
 #include <rpc/rpc.h>
 #include <rpc/pmap_clnt.h>
 #include <arpa/inet.h>
@@ -147,6 +149,31 @@ nfs_rpcsvc_init_options (rpcsvc_t *svc, dict_t *options)
                 gf_log (GF_RPCSVC, GF_LOG_DEBUG, "Portmap registration "
                         "disabled");
 
+        /* By default, run one stage per online CPU. */
+        ret = sysconf (_SC_NPROCESSORS_ONLN);
+        svc->stagecount = (ret > 0) ? ret : RPCSVC_MIN_STAGES;
+        if (dict_get (options, "rpc.thread-count")) {
+                ret = dict_get_str (options, "rpc.thread-count", &optstr);
+                if (ret < 0) {
+                        gf_log (GF_RPCSVC, GF_LOG_ERROR, "Failed to parse "
+                                "dict");
+                        goto out;
+                }
+
+                ret = gf_string2uint (optstr, &svc->stagecount);
+                if (ret < 0) {
+                        gf_log (GF_RPCSVC, GF_LOG_ERROR, "Failed to parse uint "
+                                "string");
+                        goto out;
+                }
+        }
+
+        if (svc->stagecount < RPCSVC_MIN_STAGES)
+                svc->stagecount = RPCSVC_MIN_STAGES;
+        else if (svc->stagecount > RPCSVC_MAX_STAGES)
+                svc->stagecount = RPCSVC_MAX_STAGES;
+
+        gf_log (GF_RPCSVC, GF_LOG_DEBUG, "RPC stages: %u", svc->stagecount);
         ret = 0;
 out:
         return ret;
@@ -162,6 +189,7 @@ nfs_rpcsvc_init (glusterfs_ctx_t *ctx, dict_t *options)
 {
         rpcsvc_t        *svc = NULL;
         int             ret = -1;
+        unsigned int    i = 0;
 
         if ((!ctx) || (!options))
                 return NULL;
@@ -171,7 +199,6 @@ nfs_rpcsvc_init (glusterfs_ctx_t *ctx, dict_t *options)
                 return NULL;
 
         pthread_mutex_init (&svc->rpclock, NULL);
-        INIT_LIST_HEAD (&svc->stages);
         INIT_LIST_HEAD (&svc->authschemes);
         INIT_LIST_HEAD (&svc->allprograms);
 
@@ -189,11 +216,27 @@ nfs_rpcsvc_init (glusterfs_ctx_t *ctx, dict_t *options)
         }
 
         ret = -1;
-        svc->defaultstage = nfs_rpcsvc_stage_init (svc);
-        if (!svc->defaultstage) {
-                gf_log (GF_RPCSVC, GF_LOG_ERROR,"RPC service init failed.");
+        svc->stages = GF_CALLOC (svc->stagecount, sizeof (*svc->stages),
+                                 gf_common_mt_rpcsvc_stage_t);
+        if (!svc->stages)
                 goto free_svc;
+
+        /* The stages are never torn down once started and their threads
+         * keep a reference to svc, so after a partial failure here svc is
+         * leaked instead of freed; it is not returned to the caller either.
+         */
+        for (i = 0; i < svc->stagecount; i++) {
+                svc->stages[i] = nfs_rpcsvc_stage_init (svc);
+                if (!svc->stages[i]) {
+                        gf_log (GF_RPCSVC, GF_LOG_ERROR, "RPC service init "
+                                "failed.");
+                        if (i > 0)
+                                return NULL;
+                        goto free_svc;
+                }
         }
+
+        svc->defaultstage = svc->stages[0];
         svc->options = options;
         svc->ctx = ctx;
         gf_log (GF_RPCSVC, GF_LOG_DEBUG, "RPC service inited.");
@@ -201,6 +244,7 @@ nfs_rpcsvc_init (glusterfs_ctx_t *ctx, dict_t *options)
         ret = 0;
 free_svc:
         if (ret == -1) {
+                GF_FREE (svc->stages);
                 GF_FREE (svc);
                 svc = NULL;
         }
@@ -209,17 +253,34 @@ free_svc:
 }
 
 
-/* Once multi-threaded support is complete, we'll be able to round-robin
- * the various incoming connections over the many available stages. This
- * function selects one from among all the stages.
+/* Selects the stage that will serve a connection. Listeners, i.e. a NULL
+ * conn, always run on the default stage. Accepted connections are spread
+ * over all the stages by a hash over the peer's address and port so that
+ * every request on a connection is decoded, authenticated and handed to the
+ * actor on the same thread.
  */
 rpcsvc_stage_t *
-nfs_rpcsvc_select_stage (rpcsvc_t *rpcservice)
+nfs_rpcsvc_select_stage (rpcsvc_t *rpcservice, rpcsvc_conn_t *conn)
 {
+        struct sockaddr_storage sa;
+        uint32_t                hash = 0;
+        int                     ret = -1;
+
         if (!rpcservice)
                 return NULL;
 
-        return rpcservice->defaultstage;
+        if ((!conn) || (rpcservice->stagecount <= 1))
+                return rpcservice->defaultstage;
+
+        memset (&sa, 0, sizeof (sa));
+        ret = nfs_rpcsvc_conn_peeraddr (conn, NULL, 0, (struct sockaddr *)&sa,
+                                        sizeof (sa));
+        if (ret != 0)
+                hash = (uint32_t)conn->sockfd;
+        else
+                hash = SuperFastHash ((const char *)&sa, sizeof (sa));
+
+        return rpcservice->stages[hash % rpcservice->stagecount];
 }
 
 
@@ -2673,7 +2734,7 @@ nfs_rpcsvc_conn_listening_handler (int fd, int idx, void *data, int poll_in,
                 goto err;
         }
 
-        selectedstage = nfs_rpcsvc_select_stage (svc);
+        selectedstage = nfs_rpcsvc_select_stage (svc, newconn);
         if (!selectedstage)
                 goto close_err;
 
@@ -2790,7 +2851,7 @@ nfs_rpcsvc_program_register (rpcsvc_t *svc, rpcsvc_program_t program)
         memcpy (newprog, &program, sizeof (program));
         INIT_LIST_HEAD (&newprog->proglist);
         list_add_tail (&newprog->proglist, &svc->allprograms);
-        selectedstage = nfs_rpcsvc_select_stage (svc);
+        selectedstage = nfs_rpcsvc_select_stage (svc, NULL);
 
         ret = nfs_rpcsvc_stage_program_register (selectedstage, newprog);
         if (ret == -1) {
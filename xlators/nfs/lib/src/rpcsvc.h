@@ -48,6 +48,8 @@
 #define RPCSVC_THREAD_STACK_SIZE ((size_t)(1024 * GF_UNIT_KB))
 
 #define RPCSVC_DEFAULT_MEMFACTOR        15
+#define RPCSVC_MIN_STAGES               1
+#define RPCSVC_MAX_STAGES               16
 #define RPCSVC_EVENTPOOL_SIZE_MULT      1024
 #define RPCSVC_POOLCOUNT_MULT           35
 #define RPCSVC_CONN_READ        (128 * GF_UNIT_KB)
@@ -499,16 +501,19 @@ typedef struct rpc_svc_state {
 
         /* This is the first stage that is inited, so that any RPC based
          * services that do not need multi-threaded support can just use the
-         * service right away. This is not added to the stages list
-         * declared later.
+         * service right away. It is also stages[0].
          * This is also the stage over which all service listeners are run.
          */
         rpcsvc_stage_t          *defaultstage;
 
-        /* When we have multi-threaded RPC support, we'll use this to link
-         * to the multiple Stages.
+        /* All the stages, including the default stage. Each accepted
+         * connection is bound to one of these by a hash over its peer
+         * address and stays there for its lifetime, so that decoding,
+         * authentication and the actor for every request on a connection
+         * run on the same thread.
          */
-        struct list_head        stages;         /* All stages */
+        rpcsvc_stage_t          **stages;
+        unsigned int            stagecount;
 
         unsigned int            memfactor;
 
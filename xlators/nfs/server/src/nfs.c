@@ -922,6 +922,16 @@ struct volume_options options[] = {
                          "portmap service. Use this option to turn off portmap "
                          "registration for Gluster NFS. On by default"
         },
+        { .key  = {"rpc.thread-count"},
+          .type = GF_OPTION_TYPE_INT,
+          .min  = GF_RPC_MIN_THREADS,
+          .max  = GF_RPC_MAX_THREADS,
+          .description = "Number of RPC threads that decode, authenticate and "
+                         "process NFS requests. Client connections are spread "
+                         "over these threads and each connection is always "
+                         "served by the same thread. Defaults to the number of"
+                         " online CPUs."
+        },
         { .key  = {"nfs.port"},
           .type = GF_OPTION_TYPE_INT,
           .description = "Use this option on systems that need Gluster NFS to "
@@ -32,59 +32,12 @@
 #include <assert.h>
 #include <sys/time.h>
 
-int ioc_log2_page_size;
-
 uint32_t
 ioc_get_priority (ioc_table_t *table, const char *path);
 
 uint32_t
 ioc_get_priority (ioc_table_t *table, const char *path);
 
-
-inline uint32_t
-ioc_hashfn (void *data, int len)
-{
-        off_t offset;
-
-        offset = *(off_t *) data;
-
-        return (offset >> ioc_log2_page_size);
-}
-
-inline ioc_inode_t *
-ioc_inode_reupdate (ioc_inode_t *ioc_inode)
-{
-	ioc_table_t *table = ioc_inode->table;
-
-	list_add_tail (&ioc_inode->inode_lru, 
-		       &table->inode_lru[ioc_inode->weight]);
-  
-	return ioc_inode;
-}
-
-inline ioc_inode_t *
-ioc_get_inode (dict_t *dict, char *name)
-{
-	ioc_inode_t *ioc_inode = NULL;
-	data_t      *ioc_inode_data = dict_get (dict, name);
-	ioc_table_t *table = NULL;
-
-	if (ioc_inode_data) {
-		ioc_inode = data_to_ptr (ioc_inode_data);
-		table = ioc_inode->table;
-
-		ioc_table_lock (table);
-		{
-			if (list_empty (&ioc_inode->inode_lru)) {
-				ioc_inode = ioc_inode_reupdate (ioc_inode);
-			}
-		}
-		ioc_table_unlock (table);
-	}
-  
-	return ioc_inode;
-}
-
 int32_t
 ioc_inode_need_revalidate (ioc_inode_t *ioc_inode)
 {
@@ -128,21 +81,11 @@ __ioc_inode_flush (ioc_inode_t *ioc_inode)
 void
 ioc_inode_flush (ioc_inode_t *ioc_inode)
 {
-	int64_t destroy_size = 0;    
-
 	ioc_inode_lock (ioc_inode);
 	{
-		destroy_size = __ioc_inode_flush (ioc_inode);
+		__ioc_inode_flush (ioc_inode);
 	}
 	ioc_inode_unlock (ioc_inode);
-  
-	if (destroy_size) {
-		ioc_table_lock (ioc_inode->table);
-		{
-			ioc_inode->table->cache_used -= destroy_size;
-		}
-		ioc_table_unlock (ioc_inode->table);
-	}
 
 	return;
 }
@@ -242,13 +185,6 @@ ioc_lookup_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
         if (!cache_still_valid) {
                 ioc_inode_flush (ioc_inode);
         } 
-		
-        ioc_table_lock (ioc_inode->table);
-        {
-                list_move_tail (&ioc_inode->inode_lru,
-                                &table->inode_lru[ioc_inode->weight]);
-        }
-        ioc_table_unlock (ioc_inode->table);
 	
 out:
         if (frame->local != NULL) {
@@ -336,7 +272,6 @@ ioc_cache_validate_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 {
 	ioc_local_t *local = NULL;
 	ioc_inode_t *ioc_inode = NULL;
-	size_t      destroy_size = 0;
 	struct iatt *local_stbuf = NULL;
 
         local = frame->local;
@@ -354,7 +289,7 @@ ioc_cache_validate_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 		 */
 		ioc_inode_lock (ioc_inode);
 		{
-			destroy_size = __ioc_inode_flush (ioc_inode);
+			__ioc_inode_flush (ioc_inode);
 			if (op_ret >= 0) {
 				ioc_inode->cache.mtime = stbuf->ia_mtime;
                                 ioc_inode->cache.mtime_nsec = stbuf->ia_mtime_nsec;
@@ -364,14 +299,6 @@ ioc_cache_validate_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 		local_stbuf = NULL;
 	}
 
-	if (destroy_size) {
-		ioc_table_lock (ioc_inode->table);
-		{
-			ioc_inode->table->cache_used -= destroy_size;
-		}
-		ioc_table_unlock (ioc_inode->table);
-	}
-
 	if (op_ret < 0)
 		local_stbuf = NULL;
   
@@ -543,13 +470,6 @@ ioc_open_cbk (call_frame_t *frame, void *cookie, xlator_t *this, int32_t op_ret,
 	if (op_ret != -1) {
                 inode_ctx_get (fd->inode, this, &tmp_ioc_inode);
                 ioc_inode = (ioc_inode_t *)(long)tmp_ioc_inode;
-                        
-                ioc_table_lock (ioc_inode->table);
-                {
-                        list_move_tail (&ioc_inode->inode_lru,
-                                        &table->inode_lru[ioc_inode->weight]);
-                }
-                ioc_table_unlock (ioc_inode->table);
 
                 ioc_inode_lock (ioc_inode);
                 {
@@ -882,23 +802,6 @@ ioc_readv_disabled_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 }
 
 
-int32_t
-ioc_need_prune (ioc_table_t *table)
-{
-	int64_t cache_difference = 0;
-  
-	ioc_table_lock (table);
-	{
-		cache_difference = table->cache_used - table->cache_size;
-	}
-	ioc_table_unlock (table);
-
-	if (cache_difference > 0)
-		return 1;
-	else 
-		return 0;
-}
-
 /*
  * ioc_dispatch_requests -
  * 
@@ -915,13 +818,17 @@ ioc_dispatch_requests (call_frame_t *frame, ioc_inode_t *ioc_inode, fd_t *fd,
 	ioc_table_t *table = NULL;
 	ioc_page_t  *trav = NULL;
 	ioc_waitq_t *waitq = NULL;
-	off_t       rounded_offset = 0;
-	off_t       rounded_end = 0;
 	off_t       trav_offset = 0;
+	off_t       trav_end = 0;
+	off_t       span_start = 0;
+	off_t       span_end = 0;
+	off_t       fault_offset = 0;
+	size_t      fault_size = 0;
 	int32_t     fault = 0;
         size_t      trav_size = 0;
         off_t       local_offset = 0;
         int32_t     ret = -1;
+	int8_t      sequential = 0;
 	int8_t      need_validate = 0;
 	int8_t      might_need_validate = 0;  /*
                                                * if a page exists, do we need 
@@ -930,9 +837,7 @@ ioc_dispatch_requests (call_frame_t *frame, ioc_inode_t *ioc_inode, fd_t *fd,
         local = frame->local;
         table = ioc_inode->table;
 
-	rounded_offset = floor (offset, table->page_size);
-	rounded_end = roof (offset + size, table->page_size);
-	trav_offset = rounded_offset;
+	trav_offset = offset;
 
 	/* once a frame does read, it should be waiting on something */
 	local->wait_count++;
@@ -946,34 +851,56 @@ ioc_dispatch_requests (call_frame_t *frame, ioc_inode_t *ioc_inode, fd_t *fd,
 
 	might_need_validate = ioc_inode_need_revalidate (ioc_inode);
 
-	while (trav_offset < rounded_end) {
+	ioc_inode_lock (ioc_inode);
+	{
+		/* readers which stay within a page of where the last read
+		 * stopped get page aligned extents */
+		sequential = ((offset + (off_t) table->page_size)
+			      >= ioc_inode->next_offset)
+			&& (offset <= (ioc_inode->next_offset
+				       + (off_t) table->page_size));
+		ioc_inode->next_offset = offset + size;
+	}
+	ioc_inode_unlock (ioc_inode);
+
+	while (trav_offset < (offset + size)) {
 		ioc_inode_lock (ioc_inode);
 		//{
 
 		/* look for requested region in the cache */
 		trav = ioc_page_get (ioc_inode, trav_offset);
 
-		local_offset = max (trav_offset, offset);
-		trav_size = min (((offset+size) - local_offset), 
-				 table->page_size);
-
 		if (!trav) {
-			/* page not in cache, we need to generate page fault */
-			trav = ioc_page_create (ioc_inode, trav_offset);
+			/* extent not in cache, we need to generate fault */
+			__ioc_extent_span (ioc_inode, trav_offset,
+					   offset + size, sequential,
+					   &span_start, &span_end);
+			trav = ioc_page_create (ioc_inode, span_start,
+						span_end - span_start);
 			fault = 1;
 			if (!trav) {
 				gf_log (frame->this->name, GF_LOG_CRITICAL,
 					"out of memory");
                                 local->op_ret = -1;
                                 local->op_errno = ENOMEM;
+                                ioc_inode_unlock (ioc_inode);
                                 goto out;
 			}
+			fault_offset = trav->offset;
+			fault_size = trav->length;
 		} 
 
+		local_offset = trav_offset;
+		trav_end = min ((off_t)(offset + size),
+				(off_t)(trav->offset + trav->length));
+		trav_size = trav_end - local_offset;
+
 		ioc_wait_on_page (trav, frame, local_offset, trav_size);
 
 		if (trav->ready) {
 			/* page found in cache */
+			ioc_page_hit (trav);
+
 			if (!might_need_validate && !ioc_inode->waitq) {
 				/* fresh enough */
 				gf_log (frame->this->name, GF_LOG_TRACE,
@@ -1012,8 +939,9 @@ ioc_dispatch_requests (call_frame_t *frame, ioc_inode_t *ioc_inode, fd_t *fd,
 
 		if (fault) {
 			fault = 0;
-			/* new page created, increase the table->cache_used */
-			ioc_page_fault (ioc_inode, frame, fd, trav_offset);
+			/* new extent created, charged to the inode's shard */
+			ioc_page_fault (ioc_inode, frame, fd, fault_offset,
+					fault_size);
 		}
 
 		if (need_validate) {
@@ -1036,14 +964,14 @@ ioc_dispatch_requests (call_frame_t *frame, ioc_inode_t *ioc_inode, fd_t *fd,
                         }
 		}
     
-		trav_offset += table->page_size;
+		trav_offset = trav_end;
 	}
 
 out:
 	ioc_frame_return (frame);
 
-	if (ioc_need_prune (ioc_inode->table)) {
-		ioc_prune (ioc_inode->table);
+	if (ioc_need_prune (ioc_inode->shard)) {
+		ioc_prune (ioc_inode->shard);
 	}
 
 	return;
@@ -1067,9 +995,7 @@ ioc_readv (call_frame_t *frame, xlator_t *this, fd_t *fd,
 	uint64_t     tmp_ioc_inode = 0;
 	ioc_inode_t  *ioc_inode = NULL;
 	ioc_local_t  *local = NULL;
-	uint32_t     weight = 0;
         ioc_table_t  *table = NULL;
-        uint32_t     num_pages = 0;
         int32_t      op_errno = -1;
 
         if (!this) {
@@ -1097,38 +1023,13 @@ ioc_readv (call_frame_t *frame, xlator_t *this, fd_t *fd,
         }
 
 
-        ioc_table_lock (table);
-        {
-                if (!table->mem_pool) {
-
-                        num_pages = (table->cache_size / table->page_size)
-                                + ((table->cache_size % table->page_size) 
-                                ? 1 : 0);
-
-                        table->mem_pool
-                                =  mem_pool_new (rbthash_entry_t, num_pages);
-
-                        if (!table->mem_pool) {
-                                gf_log (this->name, GF_LOG_ERROR,
-                                        "Unable to allocate mem_pool");
-                                op_errno = ENOMEM;
-                                ioc_table_unlock (table);
-                                goto out;
-                        }
-                }
-        }
-        ioc_table_unlock (table);
-
         ioc_inode_lock (ioc_inode);
         {
-                if (!ioc_inode->cache.page_table) {
-                        ioc_inode->cache.page_table
-                                = rbthash_table_init 
-                                                (IOC_PAGE_TABLE_BUCKET_COUNT,
-                                                 ioc_hashfn, NULL, 0,
-                                                 table->mem_pool);
-
-                        if (ioc_inode->cache.page_table == NULL) {
+                if (!ioc_inode->cache.page_tree) {
+                        ioc_inode->cache.page_tree
+                                = rb_create (ioc_extent_cmp, NULL, NULL);
+
+                        if (ioc_inode->cache.page_tree == NULL) {
                                 op_errno = ENOMEM;
                                 ioc_inode_unlock (ioc_inode);
                                 goto out;
@@ -1167,15 +1068,6 @@ ioc_readv (call_frame_t *frame, xlator_t *this, fd_t *fd,
 		"NEW REQ (%p) offset = %"PRId64" && size = %"GF_PRI_SIZET"", 
 		frame, offset, size);
 
-	weight = ioc_inode->weight;
-
-	ioc_table_lock (ioc_inode->table);
-	{
-		list_move_tail (&ioc_inode->inode_lru, 
-				&ioc_inode->table->inode_lru[weight]);
-	}
-	ioc_table_unlock (ioc_inode->table);
-
 	ioc_dispatch_requests (frame, ioc_inode, fd, offset, size);
 	return 0;
 
@@ -1405,8 +1297,8 @@ ioc_get_priority_list (const char *opt_str, struct list_head *first)
 	/* Get the pattern for cache priority. 
 	 * "option priority *.jpg:1,abc*:2" etc 
 	 */
-	/* TODO: inode_lru in table is statically hard-coded to 5, 
-	 * should be changed to run-time configuration 
+	/* NOTE: the shard lists are sized from max_pri at init time, a
+	 * priority added by reconfigure is clamped to the lowest one.
 	 */
 	stripe_str = strtok_r (string, ",", &tmp_str);
 	while (stripe_str) {
@@ -1736,6 +1628,7 @@ reconfigure (xlator_t *this, dict_t *options)
                 else
                         table->cache_size = IOC_CACHE_SIZE;
 
+                ioc_shards_resize (table);
 	
 		if (dict_get (options, "priority")) {
 			char *option_list = data_to_str (dict_get (options, 
@@ -1826,10 +1719,8 @@ init (xlator_t *this)
 {
 	ioc_table_t     *table = NULL;
 	dict_t          *options = this->options;
-	uint32_t         index = 0;
 	char            *cache_size_string = NULL, *tmp = NULL;
         int32_t          ret = -1;
-        glusterfs_ctx_t *ctx = NULL;
 
 	if (!this->children || this->children->next) {
 		gf_log (this->name, GF_LOG_ERROR,
@@ -1939,27 +1830,22 @@ init (xlator_t *this)
                         goto out;
         }
 
-	table->inode_lru = GF_CALLOC (table->max_pri, 
-                                      sizeof (struct list_head),
-                                      gf_ioc_mt_list_head);
-        if (table->inode_lru == NULL) {
+        LOCK_INIT (&table->used_lock);
+
+        if (ioc_shards_init (table) == -1) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "out of memory");
                 goto out;
         }
 
-	for (index = 0; index < (table->max_pri); index++)
-		INIT_LIST_HEAD (&table->inode_lru[index]);
-
 	pthread_mutex_init (&table->table_lock, NULL);
 	this->private = table;
         ret = 0;
 
-        ctx = this->ctx;
-        ioc_log2_page_size = log_base2 (ctx->page_size);
 
 out:
         if (ret == -1) {
                 if (table != NULL) {
-                        GF_FREE (table->inode_lru);
                         GF_FREE (table);
                 }
         }
@@ -1971,8 +1857,13 @@ int
 ioc_priv_dump (xlator_t *this)
 {
         ioc_table_t     *priv = NULL;
+        ioc_shard_t     *shard = NULL;
         char            key_prefix[GF_DUMP_MAX_BUF_LEN];
         char            key[GF_DUMP_MAX_BUF_LEN];
+        uint64_t        cache_used = 0;
+        uint64_t        hits = 0, misses = 0, recent_used = 0;
+        uint64_t        shard_size = 0, shard_used = 0;
+        uint32_t        i = 0;
 
         if (!this || !this->private)
                 goto out;
@@ -1986,10 +1877,50 @@ ioc_priv_dump (xlator_t *this)
         gf_proc_dump_write (key, "%ld", priv->page_size);
         gf_proc_dump_build_key (key, key_prefix, "cache_size");
         gf_proc_dump_write (key, "%ld", priv->cache_size);
-        gf_proc_dump_build_key (key, key_prefix, "cache_used");
-        gf_proc_dump_write (key, "%ld", priv->cache_used);
         gf_proc_dump_build_key (key, key_prefix, "inode_count");
         gf_proc_dump_write (key, "%u", priv->inode_count);
+        gf_proc_dump_build_key (key, key_prefix, "shard_count");
+        gf_proc_dump_write (key, "%u", priv->shard_count);
+
+        for (i = 0; i < priv->shard_count; i++) {
+                shard = &priv->shards[i];
+
+                ioc_shard_lock (shard);
+                {
+                        shard_size = shard->cache_size;
+                        shard_used = shard->cache_used;
+                        recent_used = shard->recent_used;
+                        hits = shard->hits;
+                        misses = shard->misses;
+                }
+                ioc_shard_unlock (shard);
+
+                cache_used += shard_used;
+
+                gf_proc_dump_build_key (key, key_prefix,
+                                        "shard[%d].cache_size", i);
+                gf_proc_dump_write (key, "%"PRIu64, shard_size);
+                gf_proc_dump_build_key (key, key_prefix,
+                                        "shard[%d].cache_used", i);
+                gf_proc_dump_write (key, "%"PRIu64, shard_used);
+                gf_proc_dump_build_key (key, key_prefix,
+                                        "shard[%d].recent_used", i);
+                gf_proc_dump_write (key, "%"PRIu64, recent_used);
+                gf_proc_dump_build_key (key, key_prefix,
+                                        "shard[%d].hits", i);
+                gf_proc_dump_write (key, "%"PRIu64, hits);
+                gf_proc_dump_build_key (key, key_prefix,
+                                        "shard[%d].misses", i);
+                gf_proc_dump_write (key, "%"PRIu64, misses);
+                gf_proc_dump_build_key (key, key_prefix,
+                                        "shard[%d].hit_ratio", i);
+                gf_proc_dump_write (key, "%"PRIu64"%%",
+                                    (hits + misses) ?
+                                    (hits * 100) / (hits + misses) : 0);
+        }
+
+        gf_proc_dump_build_key (key, key_prefix, "cache_used");
+        gf_proc_dump_write (key, "%"PRIu64, cache_used);
 
 out:
         return 0;
@@ -2011,11 +1942,8 @@ fini (xlator_t *this)
         if (table == NULL)
                 return;
 
-        if (table->mem_pool != NULL) {
-                mem_pool_destroy (table->mem_pool);
-                table->mem_pool = NULL;
-        }
-
+        ioc_shards_destroy (table);
+        LOCK_DESTROY (&table->used_lock);
 	pthread_mutex_destroy (&table->table_lock);
 	GF_FREE (table);
 
@@ -34,19 +34,22 @@
 #include "xlator.h"
 #include "common-utils.h"
 #include "call-stub.h"
-#include "rbthash.h"
+#include "rb.h"
 #include "hashfn.h"
 #include <sys/time.h>
 #include <fnmatch.h>
 
 #define IOC_PAGE_SIZE    (1024 * 128)   /* 128KB */
 #define IOC_CACHE_SIZE   (32 * 1024 * 1024)
-#define IOC_PAGE_TABLE_BUCKET_COUNT 1
+#define IOC_MIN_EXTENT_SIZE (4 * 1024)         /* granularity of random reads */
+#define IOC_MAX_SHARDS   16
+#define IOC_SHARD_MIN_SIZE (4 * 1024 * 1024) /* smallest cache per shard */
 
 struct ioc_table;
 struct ioc_local;
 struct ioc_page;
 struct ioc_inode;
+struct ioc_shard;
 
 struct ioc_priority {
 	struct list_head list;
@@ -110,26 +113,37 @@ struct ioc_local {
 };
 
 /*
- * ioc_page - structure to store page of data from file 
+ * ioc_page - structure to store an extent of data from file. extents do not
+ *            overlap, but their offset and length vary: random readers get
+ *            extents of the size they read, rounded to IOC_MIN_EXTENT_SIZE,
+ *            sequential readers get page_size aligned extents. no extent
+ *            is larger than page_size (the iobuf page), since each is
+ *            faulted in by one readv.
  *
  */
 struct ioc_page {
 	struct list_head    page_lru;
+	struct list_head    page_2q;  /* shard recent/frequent list */
 	struct ioc_inode    *inode;   /* inode this page belongs to */
 	struct ioc_priority *priority;
 	char                dirty;
 	char                ready;
+	char                frequent; /* promoted out of the recent list */
+	uint32_t            pri;      /* index of the shard lists */
+	uint64_t            tick;     /* shard->tick when created */
+	uint64_t            acct_size; /* bytes charged to the shard */
 	struct iovec        *vector;
 	int32_t             count;
 	off_t               offset;
-	size_t              size;
+	size_t              length;   /* span of the file covered */
+	size_t              size;     /* bytes actually read into the extent */
 	struct ioc_waitq    *waitq;
 	struct iobref       *iobref;
 	pthread_mutex_t     page_lock;
 };
 
 struct ioc_cache {
-        rbthash_table_t  *page_table;
+        struct rb_table  *page_tree;   /* extents, ordered by offset */
         struct list_head  page_lru;
 	time_t            mtime;       /*
                                         * seconds component of file mtime
@@ -144,30 +158,71 @@ struct ioc_cache {
 
 struct ioc_inode {
 	struct ioc_table      *table;
+	struct ioc_shard      *shard;       /* shard holding all our pages */
         off_t                  ia_size;
         struct ioc_cache       cache;        
 	struct list_head       inode_list; /*
                                             * list of inodes, maintained by
                                             * io-cache translator
                                             */
-	struct list_head       inode_lru;
 	struct ioc_waitq      *waitq;
 	pthread_mutex_t        inode_lock;
 	uint32_t               weight;      /*
                                              * weight of the inode, increases
                                              * on each read
                                              */
+	off_t                  next_offset; /*
+                                             * end of the last read, to tell
+                                             * sequential readers apart
+                                             */
+};
+
+/*
+ * ioc_shard - a slice of the page cache. inodes are spread over the shards
+ *             by hash, and all the pages of an inode are accounted and
+ *             evicted by its shard, under the shard's own lock.
+ *
+ *             cache_size is the share of cache-size the shard is sure to
+ *             keep. a shard can go past it while the whole cache is under
+ *             cache-size, so that a single hot file can use all of it;
+ *             once it is over, the shards past their share are pruned
+ *             first.
+ *
+ *             replacement is 2Q: a newly faulted page goes to the recent
+ *             list of its priority and is only promoted to the frequent list
+ *             when it is hit again after the shard has faulted in at least
+ *             'correlated' other pages. a sequential scan therefore churns
+ *             through the recent lists without displacing the frequent ones.
+ *
+ * lock ordering: inode lock -> shard lock. prune, which walks the shard lists
+ * under the shard lock, only ever trylocks an inode.
+ */
+struct ioc_shard {
+	pthread_mutex_t   shard_lock;
+	struct ioc_table *table;
+	uint64_t          cache_size;
+	uint64_t          cache_used;
+	uint64_t          recent_used;
+	uint64_t          correlated; /* pages */
+	uint64_t          tick;
+	struct list_head *recent;     /* one per priority, FIFO */
+	struct list_head *frequent;   /* one per priority, LRU */
+	uint32_t          pri_count;
+	uint64_t          hits;
+	uint64_t          misses;
 };
 
 struct ioc_table {
 	uint64_t         page_size;
 	uint64_t         cache_size;
-	uint64_t         cache_used;
         int64_t          min_file_size;
         int64_t          max_file_size;
 	struct list_head inodes; /* list of inodes cached */
 	struct list_head active; 
-	struct list_head *inode_lru;
+	struct ioc_shard *shards;
+	uint32_t         shard_count;
+	gf_lock_t        used_lock;  /* innermost, guards cache_used */
+	uint64_t         cache_used; /* sum over the shards */
 	struct list_head priority_list;
 	int32_t          readv_count;
 	pthread_mutex_t  table_lock;
@@ -175,7 +230,6 @@ struct ioc_table {
 	uint32_t         inode_count;
 	int32_t          cache_timeout;
 	int32_t          max_pri;
-        struct mem_pool  *mem_pool;
 };
 
 typedef struct ioc_table ioc_table_t;
@@ -184,6 +238,7 @@ typedef struct ioc_page ioc_page_t;
 typedef struct ioc_inode ioc_inode_t;
 typedef struct ioc_waitq ioc_waitq_t;
 typedef struct ioc_fill ioc_fill_t;
+typedef struct ioc_shard ioc_shard_t;
 
 void *
 str_to_ptr (char *string);
@@ -201,11 +256,18 @@ ioc_page_t *
 ioc_page_get (ioc_inode_t *ioc_inode, off_t offset);
 
 ioc_page_t *
-ioc_page_create (ioc_inode_t *ioc_inode, off_t offset);
+ioc_page_create (ioc_inode_t *ioc_inode, off_t offset, size_t length);
+
+void
+__ioc_extent_span (ioc_inode_t *ioc_inode, off_t offset, off_t end,
+		   int8_t sequential, off_t *span_start, off_t *span_end);
+
+int
+ioc_extent_cmp (const void *a, const void *b, void *param);
 
 void
 ioc_page_fault (ioc_inode_t *ioc_inode,	call_frame_t *frame, fd_t *fd,
-		off_t offset);
+		off_t offset, size_t size);
 void
 ioc_wait_on_page (ioc_page_t *page, call_frame_t *frame, off_t offset,
 		  size_t size);
@@ -264,6 +326,22 @@ ioc_frame_fill (ioc_page_t *page, call_frame_t *frame, off_t offset,
 	} while (0)
 
 
+#define ioc_shard_lock(shard)					\
+	do {							\
+		gf_log (shard->table->xl->name, GF_LOG_TRACE,	\
+			"locked shard(%p)", shard);		\
+		pthread_mutex_lock (&shard->shard_lock);	\
+	} while (0)
+
+
+#define ioc_shard_unlock(shard)					\
+	do {							\
+		gf_log (shard->table->xl->name, GF_LOG_TRACE,	\
+			"unlocked shard(%p)", shard);		\
+		pthread_mutex_unlock (&shard->shard_lock);	\
+	} while (0)
+
+
 #define ioc_local_lock(local)						\
 	do {								\
 		gf_log (local->inode->table->xl->name, GF_LOG_TRACE,	\
@@ -320,6 +398,21 @@ ioc_inode_update (ioc_table_t *table, inode_t *inode, uint32_t weight);
 int64_t 
 ioc_page_destroy (ioc_page_t *page);
 
+void
+ioc_page_account (ioc_page_t *page, uint64_t size);
+
+void
+ioc_page_hit (ioc_page_t *page);
+
+int32_t
+ioc_shards_init (ioc_table_t *table);
+
+void
+ioc_shards_resize (ioc_table_t *table);
+
+void
+ioc_shards_destroy (ioc_table_t *table);
+
 int64_t
 __ioc_inode_flush (ioc_inode_t *ioc_inode);
 
@@ -334,11 +427,8 @@ int8_t
 ioc_cache_still_valid (ioc_inode_t *ioc_inode, struct iatt *stbuf);
 
 int32_t
-ioc_prune (ioc_table_t *table);
+ioc_prune (ioc_shard_t *shard);
 
 int32_t
-ioc_need_prune (ioc_table_t *table);
-
-inline uint32_t
-ioc_hashfn (void *data, int len);
+ioc_need_prune (ioc_shard_t *shard);
 #endif /* __IO_CACHE_H */
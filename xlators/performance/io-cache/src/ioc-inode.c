@@ -24,8 +24,7 @@
 
 #include "io-cache.h"
 #include "ioc-mem-types.h"
-
-extern int ioc_log2_page_size;
+#include "hashfn.h"
 
 /*
  * str_to_ptr - convert a string to pointer
@@ -71,6 +70,8 @@ ioc_inode_wakeup (call_frame_t *frame, ioc_inode_t *ioc_inode,
 	ioc_local_t *local = NULL;
 	int8_t      need_fault = 0;
 	ioc_page_t  *waiter_page = NULL;
+	off_t        fault_offset = 0;
+	size_t       fault_size = 0;
 
         local = frame->local;
 	ioc_inode_lock (ioc_inode);
@@ -115,6 +116,8 @@ ioc_inode_wakeup (call_frame_t *frame, ioc_inode_t *ioc_inode,
 				if (waiter_page->ready) {
 					waiter_page->ready = 0;
 					need_fault = 1;
+					fault_offset = waiter_page->offset;
+					fault_size = waiter_page->length;
 				} else {
 					gf_log (frame->this->name, 
 						GF_LOG_TRACE,
@@ -129,7 +132,8 @@ ioc_inode_wakeup (call_frame_t *frame, ioc_inode_t *ioc_inode,
 					need_fault = 0;
 					ioc_page_fault (ioc_inode, frame, 
 							local->fd, 
-							waiter_page->offset);
+							fault_offset,
+							fault_size);
 				}
 			}
 		}
@@ -165,16 +169,14 @@ ioc_inode_update (ioc_table_t *table, inode_t *inode, uint32_t weight)
   
 	ioc_inode->table = table;
 	INIT_LIST_HEAD (&ioc_inode->cache.page_lru);
+	ioc_inode->shard = &table->shards[SuperFastHash ((char *)&inode,
+							 sizeof (inode))
+					  % table->shard_count];
 
 	ioc_table_lock (table);
 
 	table->inode_count++;
 	list_add (&ioc_inode->inode_list, &table->inodes);
-	list_add_tail (&ioc_inode->inode_lru, &table->inode_lru[weight]);
-
-	gf_log (table->xl->name,
-		GF_LOG_TRACE,
-		"adding to inode_lru[%d]", weight);
 
 	ioc_table_unlock (table);
 
@@ -203,11 +205,11 @@ ioc_inode_destroy (ioc_inode_t *ioc_inode)
 	ioc_table_lock (table);
 	table->inode_count--;
 	list_del (&ioc_inode->inode_list);
-	list_del (&ioc_inode->inode_lru);
 	ioc_table_unlock (table);
   
 	ioc_inode_flush (ioc_inode);
-        rbthash_table_destroy (ioc_inode->cache.page_table);
+        if (ioc_inode->cache.page_tree != NULL)
+                rb_destroy (ioc_inode->cache.page_tree, NULL);
 
 	pthread_mutex_destroy (&ioc_inode->inode_lock);
 	GF_FREE (ioc_inode);
@@ -34,6 +34,7 @@ enum gf_ioc_mem_types_ {
         gf_ioc_mt_ioc_inode_t,
         gf_ioc_mt_ioc_fill_t,
         gf_ioc_mt_ioc_newpage_t,
+        gf_ioc_mt_ioc_shard_t,
         gf_ioc_mt_end
 };
 #endif
@@ -37,18 +37,100 @@ ioc_empty (struct ioc_cache *cache)
         return list_empty (&cache->page_lru);
 }
 
+/*
+ * ioc_extent_cmp - order extents by offset. overlapping extents compare
+ *                  equal, which lets a lookup find the extent holding a
+ *                  given range.
+ */
+int
+ioc_extent_cmp (const void *a, const void *b, void *param)
+{
+	const ioc_page_t *x = a;
+	const ioc_page_t *y = b;
+
+	if ((x->offset + x->length) <= y->offset)
+		return -1;
+
+	if ((y->offset + y->length) <= x->offset)
+		return 1;
+
+	return 0;
+}
+
+
+/*
+ * __ioc_extent_find - find any cached extent overlapping [offset, end)
+ *
+ * assumes inode lock is held
+ */
+static ioc_page_t *
+__ioc_extent_find (ioc_inode_t *ioc_inode, off_t offset, off_t end)
+{
+	ioc_page_t key = {{0, }, };
+
+	if (ioc_inode->cache.page_tree == NULL)
+		return NULL;
+
+	key.offset = offset;
+	key.length = end - offset;
+
+	return rb_find (ioc_inode->cache.page_tree, &key);
+}
+
+
+/*
+ * __ioc_extent_span - pick the range of the file a new extent holding
+ *                     @offset should cover, for a read ending at @end.
+ *
+ * @sequential: the read continues where the previous one on this inode
+ *              stopped
+ *
+ * assumes inode lock is held and @offset is not cached
+ */
+void
+__ioc_extent_span (ioc_inode_t *ioc_inode, off_t offset, off_t end,
+		   int8_t sequential, off_t *span_start, off_t *span_end)
+{
+	ioc_table_t *table     = NULL;
+	ioc_page_t  *page      = NULL;
+	off_t        start     = 0;
+	off_t        stop      = 0;
+	off_t        align     = 0;
+
+        table = ioc_inode->table;
+
+	if (sequential)
+		align = table->page_size;
+	else
+		align = IOC_MIN_EXTENT_SIZE;
+
+	/* the fault goes out as a single readv, which neither the
+	   protocol nor posix can serve beyond one iobuf page */
+	start = floor (offset, align);
+	stop = roof (end, align);
+	if ((stop - start) > table->page_size)
+		stop = start + table->page_size;
+
+	/* never overlap what is already cached or in transit */
+	while ((start < offset)
+	       && ((page = __ioc_extent_find (ioc_inode, start, offset))
+		   != NULL))
+		start = page->offset + page->length;
+
+	while ((page = __ioc_extent_find (ioc_inode, offset, stop)) != NULL)
+		stop = page->offset;
+
+	*span_start = start;
+	*span_end = stop;
+}
+
+
 ioc_page_t *
 ioc_page_get (ioc_inode_t *ioc_inode, off_t offset)
 {
 	ioc_page_t   *page           = NULL;
-	ioc_table_t  *table          = NULL;
-	off_t         rounded_offset = 0;
 
-        table = ioc_inode->table;
-        rounded_offset = floor (offset, table->page_size);
- 
-        page = rbthash_get (ioc_inode->cache.page_table, &rounded_offset,
-                            sizeof (rounded_offset));
+        page = __ioc_extent_find (ioc_inode, offset, offset + 1);
 
         if (page != NULL) {
 		/* push the page to the end of the lru list */
@@ -59,142 +141,455 @@ ioc_page_get (ioc_inode_t *ioc_inode, off_t offset)
 }
 
 
+/* charge (or with a negative delta, refund) the whole cache */
+static void
+ioc_table_charge (ioc_table_t *table, int64_t delta)
+{
+	LOCK (&table->used_lock);
+	{
+		table->cache_used += delta;
+	}
+	UNLOCK (&table->used_lock);
+}
+
+
+static uint64_t
+ioc_table_excess (ioc_table_t *table)
+{
+	uint64_t excess = 0;
+
+	LOCK (&table->used_lock);
+	{
+		if (table->cache_used > table->cache_size)
+			excess = table->cache_used - table->cache_size;
+	}
+	UNLOCK (&table->used_lock);
+
+	return excess;
+}
+
+
+/*
+ * __ioc_page_unaccount - take a page off its shard's 2Q lists and give back
+ *                        the memory charged for it.
+ *
+ * assumes shard lock is held
+ */
+static void
+__ioc_page_unaccount (ioc_shard_t *shard, ioc_page_t *page)
+{
+	list_del_init (&page->page_2q);
+
+	shard->cache_used -= page->acct_size;
+	if (!page->frequent)
+		shard->recent_used -= page->acct_size;
+
+	ioc_table_charge (shard->table, -(int64_t)page->acct_size);
+	page->acct_size = 0;
+}
+
+
+/*
+ * ioc_page_free - unlink a page from its inode and free it
+ *
+ * assumes inode lock is held and nobody waits on the page
+ */
+static void
+ioc_page_free (ioc_page_t *page)
+{
+	rb_delete (page->inode->cache.page_tree, page);
+	list_del (&page->page_lru);
+
+	gf_log (page->inode->table->xl->name, GF_LOG_TRACE,
+		"destroying page = %p, offset = %"PRId64" "
+		"&& inode = %p",
+		page, page->offset, page->inode);
+
+	if (page->vector){
+		iobref_unref (page->iobref);
+		GF_FREE (page->vector);
+		page->vector = NULL;
+	}
+
+	page->inode = NULL;
+
+	pthread_mutex_destroy (&page->page_lock);
+	GF_FREE (page);
+}
+
+
 /*
  * ioc_page_destroy -
  *
  * @page:
  *
+ * returns the number of bytes released from the cache, or -1 if the page
+ * could not be destroyed since frames are waiting on it
  */
 int64_t
 ioc_page_destroy (ioc_page_t *page)
 {
-	int64_t  page_size = 0;
-
-	page_size = iobref_size (page->iobref);
+	ioc_shard_t *shard = NULL;
+	int64_t      page_size = 0;
 
 	if (page->waitq) {
 		/* frames waiting on this page, do not destroy this page */
-		page_size = -1;
-	} else {
-                rbthash_remove (page->inode->cache.page_table, &page->offset,
-                                sizeof (page->offset));
-		list_del (&page->page_lru);
-    
-		gf_log (page->inode->table->xl->name, GF_LOG_TRACE,
-			"destroying page = %p, offset = %"PRId64" "
-			"&& inode = %p",
-			page, page->offset, page->inode);
-    
-		if (page->vector){
-			iobref_unref (page->iobref);
-			GF_FREE (page->vector);
-			page->vector = NULL;
-		}
-    
-		page->inode = NULL;
+		return -1;
 	}
 
-	if (page_size != -1) {
-		pthread_mutex_destroy (&page->page_lock);
-		GF_FREE (page);
+	shard = page->inode->shard;
+
+	ioc_shard_lock (shard);
+	{
+		page_size = page->acct_size;
+		__ioc_page_unaccount (shard, page);
 	}
+	ioc_shard_unlock (shard);
+
+	ioc_page_free (page);
 
 	return page_size;
 }
 
+
 /*
- * ioc_prune - prune the cache. we have a limit to the number of pages we
- *             can have in-memory.
+ * ioc_page_account - charge the shard for the data now held by a page
  *
- * @table: ioc_table_t of this translator
+ * @page:
+ * @size: total bytes held by the page
  *
+ * assumes inode lock is held
  */
-int32_t
-ioc_prune (ioc_table_t *table)
+void
+ioc_page_account (ioc_page_t *page, uint64_t size)
+{
+	ioc_shard_t *shard = NULL;
+
+	shard = page->inode->shard;
+
+	ioc_shard_lock (shard);
+	{
+		shard->cache_used += size - page->acct_size;
+		if (!page->frequent)
+			shard->recent_used += size - page->acct_size;
+
+		ioc_table_charge (shard->table,
+				  (int64_t)size - (int64_t)page->acct_size);
+		page->acct_size = size;
+	}
+	ioc_shard_unlock (shard);
+}
+
+
+/*
+ * ioc_page_hit - a ready page served a read. promote it to the frequent list
+ *                if it was not faulted in by the same burst of reads.
+ *
+ * assumes inode lock is held
+ */
+void
+ioc_page_hit (ioc_page_t *page)
+{
+	ioc_shard_t *shard = NULL;
+
+	shard = page->inode->shard;
+
+	ioc_shard_lock (shard);
+	{
+		shard->hits++;
+
+		if (page->frequent) {
+			list_move_tail (&page->page_2q,
+					&shard->frequent[page->pri]);
+		} else if ((shard->tick - page->tick) >= shard->correlated) {
+			page->frequent = 1;
+			shard->recent_used -= page->acct_size;
+			list_move_tail (&page->page_2q,
+					&shard->frequent[page->pri]);
+		}
+	}
+	ioc_shard_unlock (shard);
+}
+
+
+/*
+ * __ioc_prune_list - destroy pages from the head of a 2Q list.
+ *
+ * @shard:
+ * @list: one of the shard's recent or frequent lists
+ * @size_to_prune:
+ * @recent_keep: stop pruning recent pages once recent_used drops to this
+ *
+ * assumes shard lock is held. inodes are only trylocked, since everybody
+ * else takes the inode lock before the shard lock.
+ */
+static uint64_t
+__ioc_prune_list (ioc_shard_t *shard, struct list_head *list,
+		  uint64_t size_to_prune, uint64_t recent_keep)
 {
-	ioc_inode_t *curr = NULL, *next_ioc_inode = NULL;
 	ioc_page_t  *page = NULL, *next = NULL;
-	int32_t     ret = -1;
+	ioc_inode_t *ioc_inode = NULL;
+	uint64_t     size_pruned = 0;
+
+	list_for_each_entry_safe (page, next, list, page_2q) {
+		if (size_pruned >= size_to_prune)
+			break;
+
+		if (!page->frequent && (shard->recent_used <= recent_keep))
+			break;
+
+		ioc_inode = page->inode;
+		if (pthread_mutex_trylock (&ioc_inode->inode_lock) != 0)
+			continue;
+
+		if (!page->waitq) {
+			size_pruned += page->acct_size;
+			__ioc_page_unaccount (shard, page);
+			ioc_page_free (page);
+		}
+
+		pthread_mutex_unlock (&ioc_inode->inode_lock);
+	}
+
+	return size_pruned;
+}
+
+
+/*
+ * ioc_shard_prune - evict up to @want bytes from a shard, not going below
+ *                   @floor bytes in it.
+ *
+ * lower priorities are pruned first. within a priority, pages seen only
+ * once go first while they hold more than a quarter of the shard, then the
+ * least recently used frequent pages, then the remaining recent ones.
+ *
+ * returns the number of bytes evicted
+ */
+static uint64_t
+ioc_shard_prune (ioc_shard_t *shard, uint64_t want, uint64_t floor)
+{
 	int32_t     index = 0;
 	uint64_t    size_to_prune = 0;
 	uint64_t    size_pruned = 0;
 
-	ioc_table_lock (table);
+	ioc_shard_lock (shard);
 	{
-		size_to_prune = table->cache_used - table->cache_size;
-		/* take out the least recently used inode */
-		for (index=0; index < table->max_pri; index++) {
-			list_for_each_entry_safe (curr, next_ioc_inode, 
-						  &table->inode_lru[index], 
-						  inode_lru) {
-				/* prune page-by-page for this inode, till 
-				 * we reach the equilibrium */
-				ioc_inode_lock (curr);
-				/* { */
-
-				list_for_each_entry_safe (page, next, 
-							  &curr->cache.page_lru,
-                                                          page_lru) {
-					/* done with all pages, and not 
-					 * reached equilibrium yet??
-					 * continue with next inode in 
-					 * lru_list */
-					size_pruned += page->size;
-					ret = ioc_page_destroy (page);
-
-					if (ret != -1)
-						table->cache_used -= ret;
-	    
-					gf_log (table->xl->name,
-						GF_LOG_TRACE,
-						"index = %d && table->cache_"
-						"used = %"PRIu64" && table->"
-						"cache_size = %"PRIu64, 
-						index, table->cache_used, 
-						table->cache_size);
-	    
-					if (size_pruned >= size_to_prune)
-						break;
-				} /* list_for_each_entry_safe(page...) */
-				if (ioc_empty (&curr->cache)) {
-					list_del_init (&curr->inode_lru);
-				}
+		if (shard->cache_used <= floor)
+			goto unlock;
 
-				/* } */ 
-				ioc_inode_unlock (curr);
-	
-				if (size_pruned >= size_to_prune)
-					break;
-			} /* list_for_each_entry_safe (curr...) */
-      
+		size_to_prune = min (want, shard->cache_used - floor);
+
+		for (index = 0; index < shard->pri_count; index++) {
+			size_pruned += __ioc_prune_list (shard,
+							 &shard->recent[index],
+							 size_to_prune
+							 - size_pruned,
+							 shard->cache_size / 4);
 			if (size_pruned >= size_to_prune)
 				break;
-		} /* for(index=0;...) */
 
-	} /* ioc_inode_table locked region end */
-	ioc_table_unlock (table);
+			size_pruned += __ioc_prune_list (shard,
+							 &shard->frequent[index],
+							 size_to_prune
+							 - size_pruned, 0);
+			if (size_pruned >= size_to_prune)
+				break;
+
+			size_pruned += __ioc_prune_list (shard,
+							 &shard->recent[index],
+							 size_to_prune
+							 - size_pruned, 0);
+			if (size_pruned >= size_to_prune)
+				break;
+		}
+
+		gf_log (shard->table->xl->name, GF_LOG_TRACE,
+			"shard = %p && cache_used = %"PRIu64" && "
+			"cache_size = %"PRIu64, shard, shard->cache_used,
+			shard->cache_size);
+	}
+unlock:
+	ioc_shard_unlock (shard);
+
+	return size_pruned;
+}
+
+
+/*
+ * ioc_prune - prune the cache back to cache-size. we have a limit to the
+ *             number of pages we can have in-memory.
+ *
+ * @shard: shard which took the cache past cache-size
+ *
+ * the shards holding more than their share give it back first, starting
+ * with @shard. only if that is not enough does @shard go below its share.
+ */
+int32_t
+ioc_prune (ioc_shard_t *shard)
+{
+	ioc_table_t *table = NULL;
+	ioc_shard_t *other = NULL;
+	uint64_t     excess = 0;
+	uint64_t     pruned = 0;
+	uint32_t     first = 0;
+	uint32_t     i = 0;
+
+	table = shard->table;
+	first = shard - table->shards;
+
+	excess = ioc_table_excess (table);
+
+	for (i = 0; (i < table->shard_count) && (excess > 0); i++) {
+		other = &table->shards[(first + i) % table->shard_count];
+		pruned = ioc_shard_prune (other, excess, other->cache_size);
+		excess -= min (pruned, excess);
+	}
+
+	if (excess > 0)
+		ioc_shard_prune (shard, excess, 0);
 
 	return 0;
 }
 
+
 /*
- * ioc_page_create - create a new page.
+ * ioc_need_prune - check whether the cache is over cache-size
+ *
+ * @shard:
+ */
+int32_t
+ioc_need_prune (ioc_shard_t *shard)
+{
+	return (ioc_table_excess (shard->table) > 0);
+}
+
+
+/*
+ * ioc_shards_init - split the cache into shards. the number of shards is
+ *                   fixed for the lifetime of the translator and derived
+ *                   from the initial cache-size, so that every shard holds
+ *                   at least IOC_SHARD_MIN_SIZE worth of pages.
+ *
+ * @table:
+ */
+int32_t
+ioc_shards_init (ioc_table_t *table)
+{
+	ioc_shard_t *shard = NULL;
+	uint32_t     i = 0, index = 0;
+
+	table->shard_count = table->cache_size / IOC_SHARD_MIN_SIZE;
+	if (table->shard_count < 1)
+		table->shard_count = 1;
+	if (table->shard_count > IOC_MAX_SHARDS)
+		table->shard_count = IOC_MAX_SHARDS;
+
+	table->shards = GF_CALLOC (table->shard_count, sizeof (ioc_shard_t),
+				   gf_ioc_mt_ioc_shard_t);
+	if (table->shards == NULL)
+		goto err;
+
+	for (i = 0; i < table->shard_count; i++) {
+		shard = &table->shards[i];
+
+		shard->table = table;
+		shard->pri_count = table->max_pri;
+		shard->recent = GF_CALLOC (shard->pri_count,
+					   sizeof (struct list_head),
+					   gf_ioc_mt_list_head);
+		shard->frequent = GF_CALLOC (shard->pri_count,
+					     sizeof (struct list_head),
+					     gf_ioc_mt_list_head);
+		if ((shard->recent == NULL) || (shard->frequent == NULL))
+			goto err;
+
+		for (index = 0; index < shard->pri_count; index++) {
+			INIT_LIST_HEAD (&shard->recent[index]);
+			INIT_LIST_HEAD (&shard->frequent[index]);
+		}
+
+		pthread_mutex_init (&shard->shard_lock, NULL);
+	}
+
+	ioc_shards_resize (table);
+
+	return 0;
+
+err:
+	if (table->shards != NULL) {
+		for (i = 0; i < table->shard_count; i++) {
+			GF_FREE (table->shards[i].recent);
+			GF_FREE (table->shards[i].frequent);
+		}
+		GF_FREE (table->shards);
+		table->shards = NULL;
+	}
+
+	return -1;
+}
+
+
+/*
+ * ioc_shards_resize - hand each shard its share of cache-size
+ *
+ * @table:
+ */
+void
+ioc_shards_resize (ioc_table_t *table)
+{
+	ioc_shard_t *shard = NULL;
+	uint32_t     i = 0;
+
+	for (i = 0; i < table->shard_count; i++) {
+		shard = &table->shards[i];
+
+		ioc_shard_lock (shard);
+		{
+			shard->cache_size = table->cache_size
+				/ table->shard_count;
+			/* a page has to survive the faulting of an eighth of
+			   the shard before a hit promotes it */
+			shard->correlated = (shard->cache_size
+					     / table->page_size) / 8;
+		}
+		ioc_shard_unlock (shard);
+	}
+}
+
+
+void
+ioc_shards_destroy (ioc_table_t *table)
+{
+	uint32_t i = 0;
+
+	if (table->shards == NULL)
+		return;
+
+	for (i = 0; i < table->shard_count; i++) {
+		pthread_mutex_destroy (&table->shards[i].shard_lock);
+		GF_FREE (table->shards[i].recent);
+		GF_FREE (table->shards[i].frequent);
+	}
+
+	GF_FREE (table->shards);
+	table->shards = NULL;
+}
+
+/*
+ * ioc_page_create - create a new extent.
  *
  * @ioc_inode:
  * @offset:
+ * @length: as picked by __ioc_extent_span
  *
  */
 ioc_page_t *
-ioc_page_create (ioc_inode_t *ioc_inode, off_t offset)
+ioc_page_create (ioc_inode_t *ioc_inode, off_t offset, size_t length)
 {
-	ioc_table_t *table          = NULL;
+	ioc_shard_t *shard          = NULL;
 	ioc_page_t  *page           = NULL;
-	off_t        rounded_offset = 0;
 	ioc_page_t  *newpage        = NULL;
 
-        table = ioc_inode->table;
-        rounded_offset = floor (offset, table->page_size);
-
         newpage = GF_CALLOC (1, sizeof (*newpage),
                              gf_ioc_mt_ioc_newpage_t);
         if (newpage == NULL) {
@@ -207,15 +602,33 @@ ioc_page_create (ioc_inode_t *ioc_inode, off_t offset)
                 goto out;
 	}
 
-	newpage->offset = rounded_offset;
+	newpage->offset = offset;
+	newpage->length = length;
 	newpage->inode = ioc_inode;
-	pthread_mutex_init (&newpage->page_lock, NULL);
 
-        rbthash_insert (ioc_inode->cache.page_table, newpage, &rounded_offset,
-                        sizeof (rounded_offset));
+        if (rb_insert (ioc_inode->cache.page_tree, newpage) != NULL) {
+                gf_log (ioc_inode->table->xl->name, GF_LOG_ERROR,
+                        "extent %"PRId64"[+%"GF_PRI_SIZET"] overlaps the "
+                        "cache of inode(%p)", offset, length, ioc_inode);
+                GF_FREE (newpage);
+                newpage = NULL;
+                goto out;
+        }
+
+	pthread_mutex_init (&newpage->page_lock, NULL);
 
 	list_add_tail (&newpage->page_lru, &ioc_inode->cache.page_lru);
 
+	shard = ioc_inode->shard;
+	ioc_shard_lock (shard);
+	{
+		newpage->pri = min (ioc_inode->weight, shard->pri_count - 1);
+		newpage->tick = ++shard->tick;
+		shard->misses++;
+		list_add_tail (&newpage->page_2q, &shard->recent[newpage->pri]);
+	}
+	ioc_shard_unlock (shard);
+
 	page = newpage;
 
 	gf_log ("io-cache", GF_LOG_TRACE,
@@ -335,18 +748,14 @@ ioc_fault_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 	ioc_local_t *local = NULL;
 	off_t       offset = 0;
 	ioc_inode_t *ioc_inode = NULL;
-	ioc_table_t *table = NULL;
 	ioc_page_t  *page = NULL;
-	int32_t     destroy_size = 0;
 	size_t      page_size = 0;
 	ioc_waitq_t *waitq = NULL;
-        size_t      iobref_page_size = 0;
         char        zero_filled = 0;
 
         local = frame->local;
         offset = local->pending_offset;
         ioc_inode = local->inode;
-        table = ioc_inode->table;
 
         zero_filled = ((op_ret >=0)
                        && (stbuf->ia_mtime == 0));
@@ -359,7 +768,7 @@ ioc_fault_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 			gf_log (ioc_inode->table->xl->name, GF_LOG_TRACE,
 				"cache for inode(%p) is invalid. flushing "
 				"all pages", ioc_inode);
-			destroy_size = __ioc_inode_flush (ioc_inode);
+			__ioc_inode_flush (ioc_inode);
 		}
 
 		if ((op_ret >= 0) && !zero_filled) {
@@ -372,20 +781,20 @@ ioc_fault_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 		if (op_ret < 0) {
 			/* error, readv returned -1 */
 			page = ioc_page_get (ioc_inode, offset);
-			if (page)
+			if (page && (page->offset == offset))
 				waitq = ioc_page_error (page, op_ret, 
 							op_errno);
 		} else {
 			gf_log (ioc_inode->table->xl->name, GF_LOG_TRACE,
 				"op_ret = %d", op_ret);
 			page = ioc_page_get (ioc_inode, offset);
-			if (!page) {
-				/* page was flushed */
-				/* some serious bug ? */
+			if (!page || (page->offset != offset)) {
+				/* page was flushed, and maybe replaced by an
+				 * extent starting elsewhere */
 				gf_log (this->name, GF_LOG_DEBUG,
-					"wasted copy: %"PRId64"[+%"PRId64"] "
-					"ioc_inode=%p", offset, 
-					table->page_size, ioc_inode);
+					"wasted copy: %"PRId64"[+%"GF_PRI_SIZET
+					"] ioc_inode=%p", offset,
+					local->pending_size, ioc_inode);
 			} else {
 				if (page->vector) {
 					iobref_unref (page->iobref);
@@ -424,7 +833,8 @@ ioc_fault_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 				page_size = iov_length(vector, count);
 				page->size = page_size;
 
-                                iobref_page_size = iobref_size (page->iobref);
+                                ioc_page_account (page,
+                                                  iobref_size (page->iobref));
 
 				if (page->waitq) {
 					/* wake up all the frames waiting on 
@@ -440,24 +850,8 @@ unlock:
 
 	ioc_waitq_return (waitq);
 
-	if (iobref_page_size) {
-		ioc_table_lock (table);
-		{
-			table->cache_used += iobref_page_size;
-		}
-		ioc_table_unlock (table);
-	}
-
-	if (destroy_size) {
-		ioc_table_lock (table);
-		{
-			table->cache_used -= destroy_size;
-		}
-		ioc_table_unlock (table);
-	}
-
-	if (ioc_need_prune (ioc_inode->table)) {
-		ioc_prune (ioc_inode->table);
+	if (ioc_need_prune (ioc_inode->shard)) {
+		ioc_prune (ioc_inode->shard);
 	}
 
 	gf_log (this->name, GF_LOG_TRACE, "fault frame %p returned", frame);
@@ -475,21 +869,20 @@ unlock:
  * @ioc_inode:
  * @frame:
  * @fd:
- * @offset:
+ * @offset: start of the extent
+ * @size: length of the extent
  *
  */
 void
 ioc_page_fault (ioc_inode_t *ioc_inode,	call_frame_t *frame, fd_t *fd,
-		off_t offset)
+		off_t offset, size_t size)
 {
-	ioc_table_t  *table = NULL;
 	call_frame_t *fault_frame = NULL;
 	ioc_local_t  *fault_local = NULL;
         int32_t      op_ret = -1, op_errno = -1;
         ioc_waitq_t  *waitq = NULL;
         ioc_page_t   *page = NULL;
 
-        table = ioc_inode->table;
         fault_frame = copy_frame (frame);
         if (fault_frame == NULL) {
                 op_ret = -1;
@@ -520,21 +913,22 @@ ioc_page_fault (ioc_inode_t *ioc_inode,	call_frame_t *frame, fd_t *fd,
 
 	INIT_LIST_HEAD (&fault_local->fill_list);
 	fault_local->pending_offset = offset;
-	fault_local->pending_size = table->page_size;
+	fault_local->pending_size = size;
 	fault_local->inode = ioc_inode;
 
 	gf_log (frame->this->name, GF_LOG_TRACE,
-		"stack winding page fault for offset = %"PRId64" with "
-		"frame %p", offset, fault_frame);
+		"stack winding page fault for offset = %"PRId64" "
+		"size = %"GF_PRI_SIZET" with frame %p", offset, size,
+		fault_frame);
   
 	STACK_WIND (fault_frame, ioc_fault_cbk, FIRST_CHILD(fault_frame->this),
 		    FIRST_CHILD(fault_frame->this)->fops->readv, fd,
-                    table->page_size, offset);
+                    size, offset);
 	return;
 
 err:
         page = ioc_page_get (ioc_inode, offset);
-        if (page != NULL) {
+        if ((page != NULL) && (page->offset == offset)) {
                 waitq = ioc_page_error (page, op_ret, op_errno);
                 if (waitq != NULL) {
                         ioc_waitq_return (waitq);
@@ -840,8 +1234,6 @@ ioc_page_error (ioc_page_t *page, int32_t op_ret, int32_t op_errno)
 {
 	ioc_waitq_t  *waitq = NULL, *trav = NULL;
 	call_frame_t *frame = NULL;
-	int64_t      ret = 0;
-	ioc_table_t  *table = NULL;
 	ioc_local_t  *local = NULL;
 
 	waitq = page->waitq;
@@ -865,12 +1257,7 @@ ioc_page_error (ioc_page_t *page, int32_t op_ret, int32_t op_errno)
 		ioc_local_unlock (local);
 	}
 
-	table = page->inode->table;
-	ret = ioc_page_destroy (page);
-
-	if (ret != -1) {
-		table->cache_used -= ret;
-	}
+	ioc_page_destroy (page);
 
 	return waitq;
 }
@@ -32,46 +32,451 @@
 #include <sys/time.h>
 #include <time.h>
 #include "locking.h"
+#include "statedump.h"
 
 void *iot_worker (void *arg);
 int iot_workers_scale (iot_conf_t *conf);
 int __iot_workers_scale (iot_conf_t *conf);
 
 
-call_stub_t *
-__iot_dequeue (iot_conf_t *conf)
+static iot_client_t *
+__iot_client_get (iot_conf_t *conf, void *key)
 {
-        call_stub_t  *stub = NULL;
+        iot_client_t *client = NULL;
+        int           bucket = 0;
         int           i = 0;
 
+        bucket = ((unsigned long) key >> 4) % IOT_CLIENT_HASH;
+
+        list_for_each_entry (client, &conf->clients[bucket], hash) {
+                if (client->key == key)
+                        return client;
+        }
+
+        client = GF_CALLOC (1, sizeof (*client), gf_iot_mt_client_t);
+        if (client == NULL)
+                return NULL;
+
+        client->key = key;
         for (i = 0; i < IOT_PRI_MAX; i++) {
-                if (list_empty (&conf->reqs[i]))
-                        continue;
-                stub = list_entry (conf->reqs[i].next, call_stub_t, list);
-                break;
+                INIT_LIST_HEAD (&client->active[i]);
+                INIT_LIST_HEAD (&client->reqs[i]);
         }
 
-        if (!stub)
+        list_add_tail (&client->hash, &conf->clients[bucket]);
+        conf->client_count++;
+
+        return client;
+}
+
+
+static void
+__iot_clients_reap (iot_conf_t *conf, time_t now)
+{
+        iot_client_t *client = NULL;
+        iot_client_t *tmp = NULL;
+        int           i = 0;
+
+        if (now - conf->last_reap < IOT_CLIENT_IDLE)
+                return;
+
+        conf->last_reap = now;
+
+        for (i = 0; i < IOT_CLIENT_HASH; i++) {
+                list_for_each_entry_safe (client, tmp, &conf->clients[i],
+                                          hash) {
+                        if (client->queue_size || client->parked ||
+                            (now - client->last_active < IOT_CLIENT_IDLE))
+                                continue;
+
+                        list_del (&client->hash);
+                        GF_FREE (client);
+                        conf->client_count--;
+                }
+        }
+}
+
+
+static int64_t
+iot_usec_since (struct timeval *now, struct timeval *then)
+{
+        return (now->tv_sec - then->tv_sec) * 1000000LL
+                + (now->tv_usec - then->tv_usec);
+}
+
+
+static int
+iot_wait_bucket (int64_t usec)
+{
+        int64_t limit = 1000;
+        int     bucket = 0;
+
+        while ((bucket < IOT_WAIT_BUCKETS - 1) && (usec >= limit)) {
+                bucket++;
+                limit *= 10;
+        }
+
+        return bucket;
+}
+
+
+/* the oldest request past the deadline among the clients not promoted
+   yet in this round. a client gets one promotion per round, and the round
+   only ends once every client with an overdue request had its turn, so a
+   client flooding the queue can not take all the promotions */
+static iot_req_t *
+__iot_overdue (iot_conf_t *conf, struct timeval *now)
+{
+        iot_client_t *client = NULL;
+        iot_req_t    *req = NULL;
+        iot_req_t    *oldest = NULL;
+        int64_t       deadline = 0;
+        char          waiting = 0;
+        int           pass = 0;
+        int           i = 0;
+
+        if (!conf->deadline)
                 return NULL;
 
+        deadline = conf->deadline * 1000LL;
+
+        for (pass = 0; pass < 2; pass++) {
+                waiting = 0;
+
+                for (i = 0; i < IOT_PRI_MAX; i++) {
+                        list_for_each_entry (client, &conf->active[i],
+                                             active[i]) {
+                                req = list_entry (client->reqs[i].next,
+                                                  iot_req_t, list);
+                                if (iot_usec_since (now, &req->queued)
+                                    < deadline)
+                                        continue;
+
+                                if (client->promoted_round == conf->round) {
+                                        waiting = 1;
+                                        continue;
+                                }
+
+                                if (!oldest ||
+                                    timercmp (&req->queued, &oldest->queued,
+                                              <))
+                                        oldest = req;
+                        }
+                }
+
+                if (oldest || !waiting)
+                        break;
+
+                conf->round++;
+        }
+
+        return oldest;
+}
+
+
+/* threads past this many wait even when there is work queued */
+static int32_t
+__iot_run_limit (iot_conf_t *conf)
+{
+        if (conf->auto_scale)
+                return conf->target;
+
+        return conf->max_count;
+}
+
+
+iot_req_t *
+__iot_dequeue (iot_conf_t *conf)
+{
+        iot_client_t   *client = NULL;
+        iot_req_t      *req = NULL;
+        struct timeval  now = {0, };
+        int64_t         wait = 0;
+        char            promoted = 0;
+        int             i = 0;
+
+        gettimeofday (&now, NULL);
+
+        req = __iot_overdue (conf, &now);
+        if (req) {
+                promoted = 1;
+        } else {
+                for (i = 0; i < IOT_PRI_MAX; i++) {
+                        if (list_empty (&conf->active[i]))
+                                continue;
+                        client = list_entry (conf->active[i].next,
+                                             iot_client_t, active[i]);
+                        req = list_entry (client->reqs[i].next, iot_req_t,
+                                          list);
+                        break;
+                }
+        }
+
+        if (!req)
+                return NULL;
+
+        client = req->client;
+        i = req->pri;
+
+        list_del_init (&req->list);
+
+        /* served once, the client goes to the back of the line */
+        list_del_init (&client->active[i]);
+        if (!list_empty (&client->reqs[i]))
+                list_add_tail (&client->active[i], &conf->active[i]);
+
+        wait = iot_usec_since (&now, &req->queued);
+
+        client->queue_size--;
+        client->served++;
+        client->wait_hist[iot_wait_bucket (wait)]++;
+        if (promoted) {
+                client->promoted_round = conf->round;
+                client->promoted++;
+                conf->promoted++;
+        }
+
         conf->queue_size--;
-        list_del_init (&stub->list);
+        conf->busy_count++;
 
-        return stub;
+        conf->win_wait += wait;
+        conf->win_dequeued++;
+
+        /* every thread allowed is taken and there is more to do: the
+           only state in which more threads could help */
+        if ((conf->busy_count >= __iot_run_limit (conf)) && conf->queue_size)
+                conf->win_full++;
+
+        return req;
 }
 
 
-void
-__iot_enqueue (iot_conf_t *conf, call_stub_t *stub, int pri)
+static void
+__iot_scale_record (iot_conf_t *conf, time_t now, int32_t to)
+{
+        iot_scale_event_t *event = NULL;
+
+        event = &conf->history[conf->history_idx];
+        conf->history_idx = (conf->history_idx + 1) % IOT_SCALE_HISTORY;
+
+        event->when = now;
+        event->from = conf->target;
+        event->to   = to;
+        event->wait = conf->last_wait;
+        event->svc  = conf->last_svc;
+
+        gf_log (conf->this->name, GF_LOG_DEBUG,
+                "auto-scale: %d -> %d threads (wait %"PRId64"us, "
+                "service %"PRId64"us, baseline %"PRId64"us)",
+                conf->target, to, conf->last_wait, conf->last_svc,
+                conf->svc_baseline);
+
+        conf->target = to;
+}
+
+
+/* Runs once a window (IOT_SCALE_INTERVAL) with enough completions in it.
+   The lowest service time seen, drifting slowly up, is taken as what the
+   device does unloaded. Service time well above it means the device is
+   saturated and more threads only add seeks, so the target backs off.
+   Otherwise requests waiting longer than target-wait in the queue, while
+   all the threads allowed were busy, means the device can take more in
+   parallel, and the target grows. Whether they were busy is sampled when
+   requests are dequeued: by the time one completes, its thread is no
+   longer counted. */
+static void
+__iot_scale_tick (iot_conf_t *conf, time_t now)
 {
+        int32_t  to = 0;
+        int32_t  step = 0;
+
+        if (now - conf->win_start < IOT_SCALE_INTERVAL)
+                return;
+
+        if (conf->win_done < IOT_SCALE_MIN_SAMPLES) {
+                /* too little traffic to tell, start over */
+                if (!conf->queue_size && !conf->busy_count)
+                        goto reset;
+                return;
+        }
+
+        conf->last_svc  = conf->win_svc / conf->win_done;
+        conf->last_wait = 0;
+        if (conf->win_dequeued)
+                conf->last_wait = conf->win_wait / conf->win_dequeued;
+
+        if (!conf->svc_baseline || conf->last_svc < conf->svc_baseline)
+                conf->svc_baseline = conf->last_svc;
+        else
+                conf->svc_baseline += (conf->last_svc
+                                       - conf->svc_baseline) / 16;
+
+        if (!conf->auto_scale)
+                goto reset;
+
+        to = conf->target;
+        if (conf->last_svc > (conf->svc_baseline * IOT_SATURATION_FACTOR)) {
+                step = conf->target / 4;
+                to = max (conf->min_count, conf->target - max (step, 1));
+        } else if ((conf->last_wait > conf->target_wait) &&
+                   conf->win_full) {
+                step = conf->target / 8;
+                to = min (conf->max_count, conf->target + max (step, 1));
+        }
+
+        if (to == conf->target)
+                goto reset;
+
+        if (to > conf->target)
+                conf->scale_ups++;
+        else
+                conf->scale_downs++;
+
+        __iot_scale_record (conf, now, to);
+
+        if (conf->queue_size) {
+                pthread_cond_broadcast (&conf->cond);
+                __iot_workers_scale (conf);
+        }
+
+reset:
+        conf->win_start    = now;
+        conf->win_wait     = 0;
+        conf->win_dequeued = 0;
+        conf->win_full     = 0;
+        conf->win_svc      = 0;
+        conf->win_done     = 0;
+}
+
+
+static void
+__iot_queue_req (iot_conf_t *conf, iot_req_t *req)
+{
+        iot_client_t *client = NULL;
+        int           pri = 0;
+
+        client = req->client;
+        pri    = req->pri;
+
+        if (list_empty (&client->reqs[pri]))
+                list_add_tail (&client->active[pri], &conf->active[pri]);
+        list_add_tail (&req->list, &client->reqs[pri]);
+
+        client->queue_size++;
+        if (client->queue_size > client->queue_max)
+                client->queue_max = client->queue_size;
+
+        conf->queue_size++;
+}
+
+
+static iot_inode_t *
+__iot_inode_get (iot_conf_t *conf, xlator_t *this, inode_t *inode)
+{
+        iot_inode_t *ictx = NULL;
+        uint64_t     value = 0;
+        int          ret = 0;
+
+        ret = inode_ctx_get (inode, this, &value);
+        if (ret == 0)
+                return (iot_inode_t *)(long) value;
+
+        ictx = GF_CALLOC (1, sizeof (*ictx), gf_iot_mt_inode_t);
+        if (ictx == NULL)
+                return NULL;
+
+        INIT_LIST_HEAD (&ictx->pending);
+
+        ret = inode_ctx_put (inode, this, (uint64_t)(long) ictx);
+        if (ret) {
+                GF_FREE (ictx);
+                return NULL;
+        }
+
+        conf->ordered_inodes++;
+
+        return ictx;
+}
+
+
+/* the ordered request of an inode is done, hand the inode its next one */
+static void
+__iot_inode_next (iot_conf_t *conf, iot_inode_t *ictx)
+{
+        iot_req_t *req = NULL;
+
+        if (list_empty (&ictx->pending)) {
+                ictx->busy = 0;
+                return;
+        }
+
+        req = list_entry (ictx->pending.next, iot_req_t, list);
+        list_del_init (&req->list);
+        conf->parked--;
+        req->client->parked--;
+
+        __iot_queue_req (conf, req);
+}
+
+
+int
+__iot_enqueue (iot_conf_t *conf, call_stub_t *stub, int pri, inode_t *inode)
+{
+        iot_client_t *client = NULL;
+        iot_inode_t  *ictx = NULL;
+        iot_req_t    *req = NULL;
+        void         *key = NULL;
+
         if (pri < 0 || pri >= IOT_PRI_MAX)
                 pri = IOT_PRI_MAX-1;
 
-        list_add_tail (&stub->list, &conf->reqs[pri]);
+        /* on a brick, trans is the server connection of the client */
+        if (conf->fair_share)
+                key = stub->frame->root->trans;
 
-        conf->queue_size++;
+        client = __iot_client_get (conf, key);
+        if (client == NULL)
+                return -ENOMEM;
+
+        if (inode) {
+                ictx = __iot_inode_get (conf, conf->this, inode);
+                if (ictx == NULL)
+                        return -ENOMEM;
+        }
+
+        req = mem_get0 (conf->req_pool);
+        if (req == NULL)
+                return -ENOMEM;
+
+        INIT_LIST_HEAD (&req->list);
+        req->stub   = stub;
+        req->client = client;
+        req->pri    = pri;
+        gettimeofday (&req->queued, NULL);
+
+        client->last_active = req->queued.tv_sec;
+
+        if (ictx) {
+                /* the inode ref keeps the ctx around until the request
+                   has handed the inode over to the next one */
+                req->inode = inode_ref (inode);
+                req->ictx  = ictx;
 
-        return;
+                if (ictx->busy) {
+                        list_add_tail (&req->list, &ictx->pending);
+                        conf->parked++;
+                        client->parked++;
+                        goto out;
+                }
+
+                ictx->busy = 1;
+        }
+
+        __iot_queue_req (conf, req);
+out:
+        __iot_clients_reap (conf, req->queued.tv_sec);
+
+        return 0;
 }
 
 
@@ -80,8 +485,11 @@ iot_worker (void *data)
 {
         iot_conf_t       *conf = NULL;
         xlator_t         *this = NULL;
-        call_stub_t      *stub = NULL;
+        iot_req_t        *req = NULL;
+        inode_t          *inode = NULL;
         struct timespec   sleep_till = {0, };
+        struct timeval    start = {0, };
+        struct timeval    end = {0, };
         int               ret = 0;
         char              timeout = 0;
         char              bye = 0;
@@ -95,7 +503,8 @@ iot_worker (void *data)
 
                 pthread_mutex_lock (&conf->mutex);
                 {
-                        while (conf->queue_size == 0) {
+                        while ((conf->queue_size == 0) ||
+                               (conf->busy_count >= __iot_run_limit (conf))) {
                                 conf->sleep_count++;
 
                                 ret = pthread_cond_timedwait (&conf->cond,
@@ -110,7 +519,7 @@ iot_worker (void *data)
                         }
 
                         if (timeout) {
-                                if (conf->curr_count > IOT_MIN_THREADS) {
+                                if (conf->curr_count > conf->min_count) {
                                         conf->curr_count--;
                                         bye = 1;
                                         gf_log (conf->this->name, GF_LOG_DEBUG,
@@ -121,12 +530,41 @@ iot_worker (void *data)
                                 }
                         }
 
-                        stub = __iot_dequeue (conf);
+                        if (conf->busy_count < __iot_run_limit (conf))
+                                req = __iot_dequeue (conf);
                 }
                 pthread_mutex_unlock (&conf->mutex);
 
-                if (stub) /* guard against spurious wakeups */
-                        call_resume (stub);
+                if (req) { /* guard against spurious wakeups */
+                        gettimeofday (&start, NULL);
+                        call_resume (req->stub);
+                        gettimeofday (&end, NULL);
+
+                        inode = req->inode;
+                        pthread_mutex_lock (&conf->mutex);
+                        {
+                                conf->busy_count--;
+                                conf->win_svc += iot_usec_since (&end, &start);
+                                conf->win_done++;
+
+                                if (req->ictx)
+                                        __iot_inode_next (conf, req->ictx);
+
+                                __iot_scale_tick (conf, end.tv_sec);
+
+                                if (conf->queue_size)
+                                        pthread_cond_signal (&conf->cond);
+                        }
+                        pthread_mutex_unlock (&conf->mutex);
+
+                        mem_put (conf->req_pool, req);
+                        req = NULL;
+
+                        if (inode) {
+                                inode_unref (inode);
+                                inode = NULL;
+                        }
+                }
 
                 if (bye)
                         break;
@@ -137,18 +575,22 @@ iot_worker (void *data)
 
 
 int
-do_iot_schedule (iot_conf_t *conf, call_stub_t *stub, int pri)
+do_iot_schedule (iot_conf_t *conf, call_stub_t *stub, int pri,
+                 inode_t *inode)
 {
         int   ret = 0;
 
         pthread_mutex_lock (&conf->mutex);
         {
-                __iot_enqueue (conf, stub, pri);
+                ret = __iot_enqueue (conf, stub, pri, inode);
+                if (ret < 0)
+                        goto unlock;
 
                 pthread_cond_signal (&conf->cond);
 
                 ret = __iot_workers_scale (conf);
         }
+unlock:
         pthread_mutex_unlock (&conf->mutex);
 
         return ret;
@@ -158,35 +600,38 @@ do_iot_schedule (iot_conf_t *conf, call_stub_t *stub, int pri)
 int
 iot_schedule_slow (iot_conf_t *conf, call_stub_t *stub)
 {
-        return do_iot_schedule (conf, stub, IOT_PRI_LO);
+        return do_iot_schedule (conf, stub, IOT_PRI_LO, NULL);
 }
 
 
 int
 iot_schedule_fast (iot_conf_t *conf, call_stub_t *stub)
 {
-        return do_iot_schedule (conf, stub, IOT_PRI_HI);
+        return do_iot_schedule (conf, stub, IOT_PRI_HI, NULL);
 }
 
 int
 iot_schedule (iot_conf_t *conf, call_stub_t *stub)
 {
-        return do_iot_schedule (conf, stub, IOT_PRI_NORMAL);
+        return do_iot_schedule (conf, stub, IOT_PRI_NORMAL, NULL);
 }
 
 
 int
-iot_schedule_unordered (iot_conf_t *conf, inode_t *inode, call_stub_t *stub)
+iot_schedule_unordered (iot_conf_t *conf, inode_t *inode, call_stub_t *stub,
+                        int pri)
 {
-        return do_iot_schedule (conf, stub, 0);
+        return do_iot_schedule (conf, stub, pri, NULL);
 }
 
 
+/* requests scheduled ordered on an inode run one at a time and in the
+   order they came in, other inodes are not held up by them */
 int
-iot_schedule_ordered (iot_conf_t *conf, inode_t *inode, call_stub_t *stub)
+iot_schedule_ordered (iot_conf_t *conf, inode_t *inode, call_stub_t *stub,
+                      int pri)
 {
-
-        return do_iot_schedule (conf, stub, 0);
+        return do_iot_schedule (conf, stub, pri, inode);
 }
 
 
@@ -280,7 +725,8 @@ iot_setattr (call_frame_t *frame, xlator_t *this, loc_t *loc,
                 goto out;
         }
 
-        ret = iot_schedule (this->private, stub);
+        ret = iot_schedule_ordered (this->private, loc->inode, stub,
+                                    IOT_PRI_NORMAL);
 
 out:
         if (ret < 0) {
@@ -331,7 +777,8 @@ iot_fsetattr (call_frame_t *frame, xlator_t *this, fd_t *fd,
                 goto out;
         }
 
-        ret = iot_schedule (this->private, stub);
+        ret = iot_schedule_ordered (this->private, fd->inode, stub,
+                                    IOT_PRI_NORMAL);
 
 out:
         if (ret < 0) {
@@ -893,7 +1340,8 @@ iot_flush (call_frame_t *frame, xlator_t *this, fd_t *fd)
                 goto out;
 	}
 
-        ret = iot_schedule (this->private, stub);
+        ret = iot_schedule_ordered (this->private, fd->inode, stub,
+                                    IOT_PRI_NORMAL);
 out:
         if (ret < 0) {
 		STACK_UNWIND_STRICT (flush, frame, -1, -ret);
@@ -943,7 +1391,8 @@ iot_fsync (call_frame_t *frame, xlator_t *this, fd_t *fd, int32_t datasync)
                 goto out;
 	}
 
-        ret = iot_schedule_slow (this->private, stub);
+        ret = iot_schedule_ordered (this->private, fd->inode, stub,
+                                    IOT_PRI_LO);
 
 out:
         if (ret < 0) {
@@ -999,7 +1448,8 @@ iot_writev (call_frame_t *frame, xlator_t *this, fd_t *fd,
                 goto out;
 	}
 
-        ret = iot_schedule_slow (this->private, stub);
+        ret = iot_schedule_ordered (this->private, fd->inode, stub,
+                                    IOT_PRI_LO);
 out:
         if (ret < 0) {
 		STACK_UNWIND_STRICT (writev, frame, -1, -ret, NULL, NULL);
@@ -1200,7 +1650,8 @@ iot_truncate (call_frame_t *frame, xlator_t *this, loc_t *loc, off_t offset)
                 goto out;
 	}
 
-        ret = iot_schedule_slow (this->private, stub);
+        ret = iot_schedule_ordered (this->private, loc->inode, stub,
+                                    IOT_PRI_LO);
 
 out:
         if (ret < 0) {
@@ -1253,7 +1704,8 @@ iot_ftruncate (call_frame_t *frame, xlator_t *this, fd_t *fd, off_t offset)
                 goto out;
 	}
 
-        ret = iot_schedule_slow (this->private, stub);
+        ret = iot_schedule_ordered (this->private, fd->inode, stub,
+                                    IOT_PRI_LO);
 out:
         if (ret < 0) {
 		STACK_UNWIND_STRICT (ftruncate, frame, -1, -ret, NULL, NULL);
@@ -1539,7 +1991,8 @@ iot_setxattr (call_frame_t *frame, xlator_t *this, loc_t *loc, dict_t *dict,
                 goto out;
         }
 
-        ret = iot_schedule (this->private, stub);
+        ret = iot_schedule_ordered (this->private, loc->inode, stub,
+                                    IOT_PRI_NORMAL);
 
 out:
         if (ret < 0) {
@@ -1683,7 +2136,8 @@ iot_fsetxattr (call_frame_t *frame, xlator_t *this, fd_t *fd, dict_t *dict,
                 goto out;
         }
 
-        ret = iot_schedule (this->private, stub);
+        ret = iot_schedule_ordered (this->private, fd->inode, stub,
+                                    IOT_PRI_NORMAL);
 out:
         if (ret < 0) {
                 STACK_UNWIND_STRICT (fsetxattr, frame, -1, -ret);
@@ -1731,7 +2185,8 @@ iot_removexattr (call_frame_t *frame, xlator_t *this, loc_t *loc,
                 goto out;
         }
 
-        ret = iot_schedule (this->private, stub);
+        ret = iot_schedule_ordered (this->private, loc->inode, stub,
+                                    IOT_PRI_NORMAL);
 out:
         if (ret < 0) {
                 STACK_UNWIND_STRICT (removexattr, frame, -1, -ret);
@@ -1874,7 +2329,8 @@ iot_xattrop (call_frame_t *frame, xlator_t *this, loc_t *loc,
                 goto out;
         }
 
-        ret = iot_schedule_slow (this->private, stub);
+        ret = iot_schedule_ordered (this->private, loc->inode, stub,
+                                    IOT_PRI_LO);
 out:
         if (ret < 0) {
                 STACK_UNWIND_STRICT (xattrop, frame, -1, -ret, NULL);
@@ -1921,7 +2377,8 @@ iot_fxattrop (call_frame_t *frame, xlator_t *this, fd_t *fd,
                 goto out;
         }
 
-        ret = iot_schedule_slow (this->private, stub);
+        ret = iot_schedule_ordered (this->private, fd->inode, stub,
+                                    IOT_PRI_LO);
 out:
         if (ret < 0) {
                 STACK_UNWIND_STRICT (fxattrop, frame, -1, -ret, NULL);
@@ -1996,11 +2453,17 @@ __iot_workers_scale (iot_conf_t *conf)
 
         scale = log2;
 
-        if (log2 < IOT_MIN_THREADS)
-                scale = IOT_MIN_THREADS;
+        if (conf->auto_scale) {
+                /* the controller decides how many run, just have them */
+                scale = min (conf->queue_size + conf->busy_count,
+                             conf->target);
+        }
 
-        if (log2 > conf->max_count)
-                scale = conf->max_count;
+        if (scale < conf->min_count)
+                scale = conf->min_count;
+
+        if (scale > __iot_run_limit (conf))
+                scale = __iot_run_limit (conf);
 
         if (conf->curr_count < scale) {
                 diff = scale - conf->curr_count;
@@ -2085,6 +2548,7 @@ validate_options ( xlator_t *this, dict_t *options, char **op_errstr)
 {
         int              ret = 0;
         int              thread_count;
+        int              min_count;
 
 
         if (dict_get (options, "thread-count")) {
@@ -2108,6 +2572,26 @@ validate_options ( xlator_t *this, dict_t *options, char **op_errstr)
                 }
         }
 
+        if (dict_get (options, "min-threads")) {
+                min_count = data_to_int32 (dict_get (options,
+                                                     "min-threads"));
+                thread_count = IOT_DEFAULT_THREADS;
+                if (dict_get (options, "thread-count"))
+                        thread_count = data_to_int32 (dict_get (options,
+                                                      "thread-count"));
+
+                if ((min_count < IOT_MIN_THREADS) ||
+                    (min_count > thread_count)) {
+                        gf_log ("io-threads", GF_LOG_DEBUG,
+                                "volume set min-threads WRONG, not between "
+                                "%d and thread-count", IOT_MIN_THREADS);
+                        *op_errstr = gf_strdup ("min. threads not between 1 "
+                                                "and thread-count");
+                        ret = -1;
+                        goto out;
+                }
+        }
+
         ret = 0;
 
 out:
@@ -2115,6 +2599,121 @@ out:
 }
 
 
+static int
+iot_sched_options (xlator_t *this, dict_t *options, iot_conf_t *conf)
+{
+        char            *str = NULL;
+        gf_boolean_t     fair_share = _gf_true;
+        int32_t          deadline = IOT_DEFAULT_DEADLINE;
+        int              ret = 0;
+
+        ret = dict_get_str (options, "fair-share", &str);
+        if (ret == 0) {
+                ret = gf_string2boolean (str, &fair_share);
+                if (ret == -1) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "'fair-share' takes only boolean arguments");
+                        return -1;
+                }
+        }
+
+        if (dict_get (options, "deadline")) {
+                deadline = data_to_int32 (dict_get (options, "deadline"));
+                if (deadline < 0) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "'deadline' (%d) cannot be negative",
+                                deadline);
+                        return -1;
+                }
+        }
+
+        pthread_mutex_lock (&conf->mutex);
+        {
+                conf->fair_share = fair_share;
+                conf->deadline   = deadline;
+        }
+        pthread_mutex_unlock (&conf->mutex);
+
+        gf_log (this->name, GF_LOG_DEBUG, "fair-share %s, deadline %dms",
+                fair_share ? "on" : "off", deadline);
+
+        return 0;
+}
+
+
+static int
+iot_scale_options (xlator_t *this, dict_t *options, iot_conf_t *conf)
+{
+        char            *str = NULL;
+        gf_boolean_t     auto_scale = _gf_false;
+        int32_t          min_count = IOT_MIN_THREADS;
+        int32_t          target_wait = IOT_DEFAULT_TARGET_WAIT;
+        int              ret = 0;
+
+        ret = dict_get_str (options, "auto-scale", &str);
+        if (ret == 0) {
+                ret = gf_string2boolean (str, &auto_scale);
+                if (ret == -1) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "'auto-scale' takes only boolean arguments");
+                        return -1;
+                }
+        }
+
+        if (dict_get (options, "min-threads")) {
+                min_count = data_to_int32 (dict_get (options, "min-threads"));
+                if ((min_count < IOT_MIN_THREADS) ||
+                    (min_count > conf->max_count)) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "'min-threads' (%d) has to be between %d and "
+                                "thread-count (%d)", min_count,
+                                IOT_MIN_THREADS, conf->max_count);
+                        return -1;
+                }
+        }
+
+        if (dict_get (options, "target-wait")) {
+                target_wait = data_to_int32 (dict_get (options,
+                                                       "target-wait"));
+                if (target_wait < 1) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "'target-wait' (%d) has to be positive",
+                                target_wait);
+                        return -1;
+                }
+        }
+
+        pthread_mutex_lock (&conf->mutex);
+        {
+                if (auto_scale && !conf->auto_scale) {
+                        /* start where a fixed pool would have been */
+                        conf->target = IOT_DEFAULT_THREADS;
+                        conf->win_start = time (NULL);
+                }
+
+                conf->auto_scale  = auto_scale;
+                conf->min_count   = min_count;
+                conf->target_wait = target_wait;
+
+                conf->target = max (conf->target, min_count);
+                conf->target = min (conf->target, conf->max_count);
+
+                /* a raised limit lets sleeping threads pick up work */
+                if (conf->queue_size) {
+                        pthread_cond_broadcast (&conf->cond);
+                        __iot_workers_scale (conf);
+                }
+        }
+        pthread_mutex_unlock (&conf->mutex);
+
+        gf_log (this->name, GF_LOG_DEBUG, "auto-scale %s, threads %d-%d, "
+                "target wait %dus", auto_scale ? "on" : "off", min_count,
+                conf->max_count, target_wait);
+
+        return 0;
+}
+
+
 int
 reconfigure ( xlator_t *this, dict_t *options)
 {
@@ -2152,6 +2751,14 @@ reconfigure ( xlator_t *this, dict_t *options)
         } else
                 conf->max_count = thread_count;
 
+        ret = iot_sched_options (this, options, conf);
+        if (ret)
+                goto out;
+
+        ret = iot_scale_options (this, options, conf);
+        if (ret)
+                goto out;
+
 	ret = 0;
 
 out:
@@ -2220,8 +2827,35 @@ init (xlator_t *this)
 
         conf->this = this;
 
+        pthread_mutex_init (&conf->mutex, NULL);
+        pthread_cond_init (&conf->cond, NULL);
+
         for (i = 0; i < IOT_PRI_MAX; i++) {
-                INIT_LIST_HEAD (&conf->reqs[i]);
+                INIT_LIST_HEAD (&conf->active[i]);
+        }
+
+        /* new clients start with promoted_round 0 */
+        conf->round = 1;
+
+        for (i = 0; i < IOT_CLIENT_HASH; i++) {
+                INIT_LIST_HEAD (&conf->clients[i]);
+        }
+
+        conf->req_pool = mem_pool_new (iot_req_t, IOT_REQ_POOL_SIZE);
+        if (conf->req_pool == NULL) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "out of memory");
+                GF_FREE (conf);
+                goto out;
+        }
+
+        ret = iot_sched_options (this, options, conf);
+        if (ret == 0)
+                ret = iot_scale_options (this, options, conf);
+        if (ret) {
+                mem_pool_destroy (conf->req_pool);
+                GF_FREE (conf);
+                goto out;
         }
 
 	ret = iot_workers_scale (conf);
@@ -2243,7 +2877,21 @@ out:
 void
 fini (xlator_t *this)
 {
-	iot_conf_t *conf = this->private;
+	iot_conf_t   *conf = this->private;
+        iot_client_t *client = NULL;
+        iot_client_t *tmp = NULL;
+        int           i = 0;
+
+        for (i = 0; i < IOT_CLIENT_HASH; i++) {
+                list_for_each_entry_safe (client, tmp, &conf->clients[i],
+                                          hash) {
+                        list_del (&client->hash);
+                        GF_FREE (client);
+                }
+        }
+
+        if (conf->req_pool)
+                mem_pool_destroy (conf->req_pool);
 
 	GF_FREE (conf);
 
@@ -2252,6 +2900,172 @@ fini (xlator_t *this)
 }
 
 
+int
+iot_forget (xlator_t *this, inode_t *inode)
+{
+        iot_inode_t *ictx = NULL;
+        uint64_t     value = 0;
+        iot_conf_t  *conf = NULL;
+
+        conf = this->private;
+
+        inode_ctx_del (inode, this, &value);
+        ictx = (iot_inode_t *)(long) value;
+        if (ictx == NULL)
+                return 0;
+
+        pthread_mutex_lock (&conf->mutex);
+        {
+                conf->ordered_inodes--;
+        }
+        pthread_mutex_unlock (&conf->mutex);
+
+        GF_FREE (ictx);
+
+        return 0;
+}
+
+
+int
+iot_priv_dump (xlator_t *this)
+{
+        static const char *wait_names[IOT_WAIT_BUCKETS] = {
+                "1ms", "10ms", "100ms", "1s", "10s", "more"
+        };
+        iot_conf_t        *conf = NULL;
+        iot_client_t      *client = NULL;
+        iot_scale_event_t *event = NULL;
+        char               key_prefix[GF_DUMP_MAX_BUF_LEN];
+        char               key[GF_DUMP_MAX_BUF_LEN];
+        int                i = 0;
+        int                j = 0;
+        int                idx = 0;
+
+        if (!this || !this->private)
+                goto out;
+
+        conf = this->private;
+
+        gf_proc_dump_build_key (key_prefix, "xlator.performance.io-threads",
+                                "priv");
+        gf_proc_dump_add_section (key_prefix);
+
+        pthread_mutex_lock (&conf->mutex);
+        {
+                gf_proc_dump_build_key (key, key_prefix, "max_count");
+                gf_proc_dump_write (key, "%d", conf->max_count);
+                gf_proc_dump_build_key (key, key_prefix, "curr_count");
+                gf_proc_dump_write (key, "%d", conf->curr_count);
+                gf_proc_dump_build_key (key, key_prefix, "sleep_count");
+                gf_proc_dump_write (key, "%d", conf->sleep_count);
+                gf_proc_dump_build_key (key, key_prefix, "queue_size");
+                gf_proc_dump_write (key, "%d", conf->queue_size);
+                gf_proc_dump_build_key (key, key_prefix, "fair_share");
+                gf_proc_dump_write (key, "%s",
+                                    conf->fair_share ? "on" : "off");
+                gf_proc_dump_build_key (key, key_prefix, "deadline");
+                gf_proc_dump_write (key, "%dms", conf->deadline);
+                gf_proc_dump_build_key (key, key_prefix, "promoted");
+                gf_proc_dump_write (key, "%"PRIu64, conf->promoted);
+                gf_proc_dump_build_key (key, key_prefix, "parked");
+                gf_proc_dump_write (key, "%d", conf->parked);
+                gf_proc_dump_build_key (key, key_prefix, "ordered_inodes");
+                gf_proc_dump_write (key, "%d", conf->ordered_inodes);
+                gf_proc_dump_build_key (key, key_prefix, "min_count");
+                gf_proc_dump_write (key, "%d", conf->min_count);
+                gf_proc_dump_build_key (key, key_prefix, "busy_count");
+                gf_proc_dump_write (key, "%d", conf->busy_count);
+                gf_proc_dump_build_key (key, key_prefix, "auto_scale");
+                gf_proc_dump_write (key, "%s",
+                                    conf->auto_scale ? "on" : "off");
+                gf_proc_dump_build_key (key, key_prefix, "target");
+                gf_proc_dump_write (key, "%d", conf->target);
+                gf_proc_dump_build_key (key, key_prefix, "target_wait");
+                gf_proc_dump_write (key, "%dus", conf->target_wait);
+                gf_proc_dump_build_key (key, key_prefix, "last_wait");
+                gf_proc_dump_write (key, "%"PRId64"us", conf->last_wait);
+                gf_proc_dump_build_key (key, key_prefix, "last_svc");
+                gf_proc_dump_write (key, "%"PRId64"us", conf->last_svc);
+                gf_proc_dump_build_key (key, key_prefix, "svc_baseline");
+                gf_proc_dump_write (key, "%"PRId64"us", conf->svc_baseline);
+                gf_proc_dump_build_key (key, key_prefix, "scale_ups");
+                gf_proc_dump_write (key, "%"PRIu64, conf->scale_ups);
+                gf_proc_dump_build_key (key, key_prefix, "scale_downs");
+                gf_proc_dump_write (key, "%"PRIu64, conf->scale_downs);
+
+                /* most recent decision first */
+                for (i = 0; i < IOT_SCALE_HISTORY; i++) {
+                        event = &conf->history[(conf->history_idx
+                                                + IOT_SCALE_HISTORY - 1 - i)
+                                               % IOT_SCALE_HISTORY];
+                        if (!event->when)
+                                break;
+                        gf_proc_dump_build_key (key, key_prefix,
+                                                "decision[%d]", i);
+                        gf_proc_dump_write (key, "%ld %d -> %d wait=%"PRId64
+                                            "us svc=%"PRId64"us",
+                                            (long) event->when, event->from,
+                                            event->to, event->wait,
+                                            event->svc);
+                }
+
+                gf_proc_dump_build_key (key, key_prefix, "client_count");
+                gf_proc_dump_write (key, "%d", conf->client_count);
+
+                for (i = 0; i < IOT_CLIENT_HASH; i++) {
+                        list_for_each_entry (client, &conf->clients[i], hash) {
+                                gf_proc_dump_build_key (key, key_prefix,
+                                                        "client[%d].id", idx);
+                                gf_proc_dump_write (key, "%p", client->key);
+                                gf_proc_dump_build_key (key, key_prefix,
+                                                        "client[%d].queue_size",
+                                                        idx);
+                                gf_proc_dump_write (key, "%d",
+                                                    client->queue_size);
+                                gf_proc_dump_build_key (key, key_prefix,
+                                                        "client[%d].queue_max",
+                                                        idx);
+                                gf_proc_dump_write (key, "%d",
+                                                    client->queue_max);
+                                gf_proc_dump_build_key (key, key_prefix,
+                                                        "client[%d].parked",
+                                                        idx);
+                                gf_proc_dump_write (key, "%d",
+                                                    client->parked);
+                                gf_proc_dump_build_key (key, key_prefix,
+                                                        "client[%d].served",
+                                                        idx);
+                                gf_proc_dump_write (key, "%"PRIu64,
+                                                    client->served);
+                                gf_proc_dump_build_key (key, key_prefix,
+                                                        "client[%d].promoted",
+                                                        idx);
+                                gf_proc_dump_write (key, "%"PRIu64,
+                                                    client->promoted);
+
+                                for (j = 0; j < IOT_WAIT_BUCKETS; j++) {
+                                        gf_proc_dump_build_key (key, key_prefix,
+                                                                "client[%d].wait<%s",
+                                                                idx,
+                                                                wait_names[j]);
+                                        gf_proc_dump_write (key, "%"PRIu64,
+                                                            client->wait_hist[j]);
+                                }
+                                idx++;
+                        }
+                }
+        }
+        pthread_mutex_unlock (&conf->mutex);
+out:
+        return 0;
+}
+
+
+struct xlator_dumpops dumpops = {
+        .priv        = iot_priv_dump,
+};
+
+
 struct xlator_fops fops = {
 	.open        = iot_open,
 	.create      = iot_create,
@@ -2292,6 +3106,7 @@ struct xlator_fops fops = {
 };
 
 struct xlator_cbks cbks = {
+        .forget      = iot_forget,
 };
 
 struct volume_options options[] = {
@@ -2305,6 +3120,40 @@ struct volume_options options[] = {
          .min   = 1,
          .max   = 0x7fffffff,
         },
+        { .key  = {"fair-share"},
+          .type = GF_OPTION_TYPE_BOOL,
+          .description = "Queue requests per client and serve the clients "
+                         "round robin within each priority"
+        },
+        { .key  = {"deadline"},
+          .type = GF_OPTION_TYPE_INT,
+          .min  = 0,
+          .max  = 3600000,
+          .description = "Milliseconds a request may wait before it is "
+                         "served ahead of its priority and turn. A client "
+                         "is promoted at most once until every other client "
+                         "with an overdue request was. 0 disables"
+        },
+        { .key  = {"auto-scale"},
+          .type = GF_OPTION_TYPE_BOOL,
+          .description = "Adjust the number of threads allowed to run "
+                         "between min-threads and thread-count from the "
+                         "measured queue wait and service times"
+        },
+        { .key  = {"min-threads"},
+          .type = GF_OPTION_TYPE_INT,
+          .min  = IOT_MIN_THREADS,
+          .max  = IOT_MAX_THREADS,
+          .description = "Threads kept around when idle, and the floor of "
+                         "auto-scale"
+        },
+        { .key  = {"target-wait"},
+          .type = GF_OPTION_TYPE_INT,
+          .min  = 1,
+          .max  = 0x7fffffff,
+          .description = "Microseconds of queue wait above which auto-scale "
+                         "adds threads, unless the device is saturated"
+        },
 	{ .key  = {NULL},
         },
 };
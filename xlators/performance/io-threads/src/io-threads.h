@@ -36,6 +36,7 @@
 #include <stdlib.h>
 #include "locking.h"
 #include "iot-mem-types.h"
+#include "call-stub.h"
 #include <semaphore.h>
 
 
@@ -47,11 +48,23 @@ struct iot_conf;
 
 #define IOT_MIN_THREADS         1
 #define IOT_DEFAULT_THREADS     16
-#define IOT_MAX_THREADS         64
+#define IOT_MAX_THREADS         512
 
 
 #define IOT_THREAD_STACK_SIZE   ((size_t)(1024*1024))
 
+#define IOT_DEFAULT_DEADLINE    1000    /* In msecs, 0 turns promotion off */
+#define IOT_CLIENT_HASH         64
+#define IOT_CLIENT_IDLE         600     /* In secs, before a client is reaped */
+#define IOT_REQ_POOL_SIZE       1024
+#define IOT_WAIT_BUCKETS        6       /* 1ms, 10ms, 100ms, 1s, 10s, more */
+
+#define IOT_DEFAULT_TARGET_WAIT 2000    /* In usecs */
+#define IOT_SCALE_INTERVAL      1       /* In secs, between two decisions */
+#define IOT_SCALE_MIN_SAMPLES   8       /* completions needed for a decision */
+#define IOT_SATURATION_FACTOR   2       /* service time over the baseline */
+#define IOT_SCALE_HISTORY       8
+
 
 typedef enum {
         IOT_PRI_HI = 0, /* low latency */
@@ -61,17 +74,104 @@ typedef enum {
 } iot_pri_t;
 
 
+/* requests of one client (the connection the frame came in on). The
+   clients with work pending at a priority take turns on conf->active,
+   plain round robin: every client gets the same share, there are no
+   weights. */
+struct iot_client {
+        struct list_head     hash;
+        struct list_head     active[IOT_PRI_MAX];
+        struct list_head     reqs[IOT_PRI_MAX];
+        void                *key;
+
+        int32_t              queue_size;
+        int32_t              queue_max;
+        int32_t              parked;      /* waiting on an iot_inode, these
+                                             keep the client from being
+                                             reaped as well */
+        uint64_t             served;
+        uint64_t             promoted;
+        uint32_t             promoted_round; /* conf->round it last was */
+        uint64_t             wait_hist[IOT_WAIT_BUCKETS];
+        time_t               last_active;
+};
+
+typedef struct iot_client iot_client_t;
+
+/* ordered requests of an inode, only one of them is queued or running
+   at any time and the rest wait on pending */
+struct iot_inode {
+        struct list_head     pending;
+        char                 busy;
+};
+
+typedef struct iot_inode iot_inode_t;
+
+struct iot_req {
+        struct list_head     list;
+        call_stub_t         *stub;
+        iot_client_t        *client;
+        int                  pri;
+        struct timeval       queued;
+        inode_t             *inode;
+        iot_inode_t         *ictx;
+};
+
+typedef struct iot_req iot_req_t;
+
+/* one decision of the auto-scale controller */
+struct iot_scale_event {
+        time_t               when;
+        int32_t              from;
+        int32_t              to;
+        int64_t              wait;        /* avg queue wait, usecs */
+        int64_t              svc;         /* avg service time, usecs */
+};
+
+typedef struct iot_scale_event iot_scale_event_t;
+
 struct iot_conf {
         pthread_mutex_t      mutex;
         pthread_cond_t       cond;
 
         int32_t              max_count;   /* configured maximum */
+        int32_t              min_count;   /* configured minimum */
         int32_t              curr_count;  /* actual number of threads running */
         int32_t              sleep_count;
+        int32_t              busy_count;  /* threads inside call_resume */
 
         int32_t              idle_time;   /* in seconds */
 
-        struct list_head     reqs[IOT_PRI_MAX];
+        gf_boolean_t         fair_share;
+        int32_t              deadline;    /* in msecs */
+
+        struct list_head     clients[IOT_CLIENT_HASH];
+        struct list_head     active[IOT_PRI_MAX];
+        int32_t              client_count;
+        time_t               last_reap;
+        uint64_t             promoted;
+        uint32_t             round;       /* of deadline promotions */
+        struct mem_pool     *req_pool;
+
+        int32_t              parked;      /* ordered, behind another one */
+        int32_t              ordered_inodes;
+
+        gf_boolean_t         auto_scale;
+        int32_t              target;      /* threads allowed to run */
+        int32_t              target_wait; /* in usecs */
+        time_t               win_start;
+        int64_t              win_wait;    /* sums over the window, usecs */
+        int32_t              win_dequeued;
+        int32_t              win_full;    /* dequeues leaving all busy */
+        int64_t              win_svc;
+        int32_t              win_done;
+        int64_t              svc_baseline;
+        int64_t              last_wait;
+        int64_t              last_svc;
+        uint64_t             scale_ups;
+        uint64_t             scale_downs;
+        iot_scale_event_t    history[IOT_SCALE_HISTORY];
+        int32_t              history_idx;
 
         int                  queue_size;
         pthread_attr_t       w_attr;
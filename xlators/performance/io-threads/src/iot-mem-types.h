@@ -25,6 +25,8 @@
 
 enum gf_iot_mem_types_ {
         gf_iot_mt_iot_conf_t  = gf_common_mt_end + 1,
+        gf_iot_mt_client_t,
+        gf_iot_mt_inode_t,
         gf_iot_mt_end
 };
 #endif
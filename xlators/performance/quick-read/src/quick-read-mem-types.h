@@ -31,6 +31,8 @@ enum gf_qr_mem_types_ {
         gf_qr_mt_qr_conf_t,
         gf_qr_mt_qr_priority_t,
         gf_qr_mt_qr_private_t,
+        gf_qr_mt_qr_chunk_list_t,
+        gf_qr_mt_qr_slab_t,
         gf_qr_mt_end
 };
 #endif
@@ -219,11 +219,426 @@ __qr_inode_alloc (xlator_t *this, char *path, inode_t *inode)
 
         qr_inode->inode = inode;
         qr_inode->priority = priority;
+        qr_inode->table = &priv->table;
 out:
         return qr_inode;
 }
 
 
+static inline int
+qr_chunks_needed (size_t size)
+{
+        return (size + QR_SLAB_CHUNK_SIZE - 1) / QR_SLAB_CHUNK_SIZE;
+}
+
+
+/* To be called with table->lock held */
+static int
+__qr_arena_grow (qr_inode_table_t *table)
+{
+        struct list_head *slab  = NULL;
+        char             *chunk = NULL;
+        int               i     = 0;
+
+        slab = GF_CALLOC (1, sizeof (*slab)
+                          + (QR_SLAB_CHUNKS * QR_SLAB_CHUNK_SIZE),
+                          gf_qr_mt_qr_slab_t);
+        if (slab == NULL) {
+                return -1;
+        }
+
+        list_add_tail (slab, &table->slabs);
+        table->arena_size += QR_SLAB_CHUNKS * QR_SLAB_CHUNK_SIZE;
+
+        chunk = (char *)(slab + 1);
+        for (i = 0; i < QR_SLAB_CHUNKS; i++) {
+                *(void **)chunk = table->free_chunks;
+                table->free_chunks = chunk;
+                chunk += QR_SLAB_CHUNK_SIZE;
+        }
+
+        return 0;
+}
+
+
+/* To be called with table->lock held */
+static void
+__qr_arena_destroy (qr_inode_table_t *table)
+{
+        struct list_head *slab = NULL;
+
+        while (!list_empty (&table->slabs)) {
+                slab = table->slabs.next;
+                list_del (slab);
+                GF_FREE (slab);
+        }
+
+        table->free_chunks = NULL;
+        table->arena_size = 0;
+}
+
+
+static char *
+qr_chunk_get (qr_inode_table_t *table)
+{
+        char *chunk = NULL;
+
+        if ((table->free_chunks == NULL) && __qr_arena_grow (table)) {
+                return NULL;
+        }
+
+        chunk = table->free_chunks;
+        table->free_chunks = *(void **)chunk;
+
+        return chunk;
+}
+
+
+static void
+qr_chunks_put (qr_inode_table_t *table, char **chunks, int count)
+{
+        int i = 0;
+
+        if (chunks == NULL) {
+                return;
+        }
+
+        for (i = 0; i < count; i++) {
+                if (chunks[i] != NULL) {
+                        *(void **)chunks[i] = table->free_chunks;
+                        table->free_chunks = chunks[i];
+                }
+        }
+
+        GF_FREE (chunks);
+}
+
+
+static char **
+qr_chunks_get (qr_inode_table_t *table, int count)
+{
+        char **chunks = NULL;
+        int    i      = 0;
+
+        chunks = GF_CALLOC (count, sizeof (*chunks),
+                            gf_qr_mt_qr_chunk_list_t);
+        if (chunks == NULL) {
+                goto out;
+        }
+
+        for (i = 0; i < count; i++) {
+                chunks[i] = qr_chunk_get (table);
+                if (chunks[i] == NULL) {
+                        qr_chunks_put (table, chunks, i);
+                        chunks = NULL;
+                        goto out;
+                }
+        }
+
+out:
+        return chunks;
+}
+
+
+/* To be called with qr_inode->table->lock held */
+void
+__qr_content_free (qr_inode_t *qr_inode)
+{
+        qr_inode_table_t *table = NULL;
+
+        table = qr_inode->table;
+
+        if (!qr_inode->cached) {
+                goto out;
+        }
+
+        if (qr_inode->compressed) {
+                table->bytes_saved -= (qr_chunks_needed (qr_inode->size)
+                                       - qr_inode->chunk_count)
+                        * QR_SLAB_CHUNK_SIZE;
+        }
+
+        qr_chunks_put (table, qr_inode->chunks, qr_inode->chunk_count);
+        table->cache_used -= qr_inode->chunk_count * QR_SLAB_CHUNK_SIZE;
+
+        qr_inode->chunks = NULL;
+        qr_inode->chunk_count = 0;
+        qr_inode->size = qr_inode->stored = 0;
+        qr_inode->compressed = qr_inode->incompressible = 0;
+        qr_inode->cached = 0;
+out:
+        return;
+}
+
+
+/* To be called with qr_inode->table->lock held */
+int
+__qr_content_store (qr_inode_t *qr_inode, char *data, size_t size)
+{
+        qr_inode_table_t *table  = NULL;
+        int               count  = 0;
+        int               i      = 0;
+        size_t            copied = 0;
+        int               ret    = -1;
+
+        table = qr_inode->table;
+
+        __qr_content_free (qr_inode);
+
+        count = qr_chunks_needed (size);
+        if (count > 0) {
+                qr_inode->chunks = qr_chunks_get (table, count);
+                if (qr_inode->chunks == NULL) {
+                        goto out;
+                }
+        }
+
+        for (i = 0; i < count; i++) {
+                copied = min (size - (i * QR_SLAB_CHUNK_SIZE),
+                              QR_SLAB_CHUNK_SIZE);
+                memcpy (qr_inode->chunks[i], data + (i * QR_SLAB_CHUNK_SIZE),
+                        copied);
+        }
+
+        qr_inode->chunk_count = count;
+        qr_inode->size = qr_inode->stored = size;
+        qr_inode->hits = 0;
+        qr_inode->cached = 1;
+        table->cache_used += count * QR_SLAB_CHUNK_SIZE;
+
+        ret = 0;
+out:
+        return ret;
+}
+
+
+/*
+ * copy @size bytes of uncompressed content from @offset into @dst
+ * To be called with qr_inode->table->lock held
+ */
+void
+__qr_content_copy (qr_inode_t *qr_inode, char *dst, off_t offset, size_t size)
+{
+        int    index  = 0;
+        off_t  skip   = 0;
+        size_t copied = 0;
+
+        while (size > 0) {
+                index = offset / QR_SLAB_CHUNK_SIZE;
+                skip = offset % QR_SLAB_CHUNK_SIZE;
+                copied = min (size, QR_SLAB_CHUNK_SIZE - skip);
+
+                memcpy (dst, qr_inode->chunks[index] + skip, copied);
+
+                dst += copied;
+                offset += copied;
+                size -= copied;
+        }
+}
+
+
+#ifdef HAVE_LIBZ
+/*
+ * deflate the content into fresh chunks. gives up, and remembers not to try
+ * again, unless it saves at least one chunk.
+ * To be called with qr_inode->table->lock held
+ */
+int
+__qr_content_compress (qr_inode_t *qr_inode)
+{
+        qr_inode_table_t *table       = NULL;
+        z_stream          strm        = {0, };
+        char            **chunks      = NULL;
+        int               max_chunks  = 0;
+        int               chunk_count = 0;
+        int               i           = 0;
+        int               flush       = Z_NO_FLUSH;
+        int               zret        = Z_OK;
+        int               ret         = -1;
+
+        table = qr_inode->table;
+
+        if (!qr_inode->cached || qr_inode->compressed
+            || qr_inode->incompressible) {
+                goto out;
+        }
+
+        max_chunks = qr_inode->chunk_count - 1;
+        if (max_chunks <= 0) {
+                qr_inode->incompressible = 1;
+                goto out;
+        }
+
+        chunks = GF_CALLOC (max_chunks, sizeof (*chunks),
+                            gf_qr_mt_qr_chunk_list_t);
+        if (chunks == NULL) {
+                goto out;
+        }
+
+        if (deflateInit (&strm, Z_BEST_SPEED) != Z_OK) {
+                GF_FREE (chunks);
+                goto out;
+        }
+
+        for (i = 0; i < qr_inode->chunk_count; i++) {
+                strm.next_in = (Bytef *)qr_inode->chunks[i];
+                strm.avail_in = min (qr_inode->size - (i * QR_SLAB_CHUNK_SIZE),
+                                     QR_SLAB_CHUNK_SIZE);
+                flush = (i == (qr_inode->chunk_count - 1)) ? Z_FINISH
+                        : Z_NO_FLUSH;
+
+                for (;;) {
+                        if (strm.avail_out == 0) {
+                                if (chunk_count == max_chunks) {
+                                        qr_inode->incompressible = 1;
+                                        goto end;
+                                }
+
+                                chunks[chunk_count] = qr_chunk_get (table);
+                                if (chunks[chunk_count] == NULL) {
+                                        goto end;
+                                }
+
+                                strm.next_out = (Bytef *)chunks[chunk_count];
+                                strm.avail_out = QR_SLAB_CHUNK_SIZE;
+                                chunk_count++;
+                        }
+
+                        zret = deflate (&strm, flush);
+                        if (zret == Z_STREAM_ERROR) {
+                                goto end;
+                        }
+
+                        if (flush == Z_FINISH) {
+                                if (zret == Z_STREAM_END) {
+                                        break;
+                                }
+                        } else if ((strm.avail_in == 0)
+                                   && (strm.avail_out != 0)) {
+                                break;
+                        }
+                }
+        }
+
+        qr_chunks_put (table, qr_inode->chunks, qr_inode->chunk_count);
+        table->cache_used -= (qr_inode->chunk_count - chunk_count)
+                * QR_SLAB_CHUNK_SIZE;
+        table->bytes_saved += (qr_inode->chunk_count - chunk_count)
+                * QR_SLAB_CHUNK_SIZE;
+        table->compressions++;
+
+        qr_inode->chunks = chunks;
+        qr_inode->chunk_count = chunk_count;
+        qr_inode->stored = strm.total_out;
+        qr_inode->compressed = 1;
+        chunks = NULL;
+
+        ret = 0;
+end:
+        deflateEnd (&strm);
+        if (chunks != NULL) {
+                qr_chunks_put (table, chunks, chunk_count);
+        }
+out:
+        return ret;
+}
+
+
+/* To be called with qr_inode->table->lock held */
+int
+__qr_content_decompress (qr_inode_t *qr_inode)
+{
+        qr_inode_table_t *table    = NULL;
+        z_stream          strm     = {0, };
+        struct timeval    start    = {0, };
+        struct timeval    end      = {0, };
+        char            **chunks   = NULL;
+        int               count    = 0;
+        int               in       = 0;
+        int               out      = 0;
+        int               zret     = Z_OK;
+        int               ret      = -1;
+
+        table = qr_inode->table;
+
+        gettimeofday (&start, NULL);
+
+        count = qr_chunks_needed (qr_inode->size);
+        chunks = qr_chunks_get (table, count);
+        if (chunks == NULL) {
+                goto out;
+        }
+
+        if (inflateInit (&strm) != Z_OK) {
+                qr_chunks_put (table, chunks, count);
+                goto out;
+        }
+
+        do {
+                if ((strm.avail_in == 0) && (in < qr_inode->chunk_count)) {
+                        strm.next_in = (Bytef *)qr_inode->chunks[in];
+                        strm.avail_in = min (qr_inode->stored
+                                             - (in * QR_SLAB_CHUNK_SIZE),
+                                             QR_SLAB_CHUNK_SIZE);
+                        in++;
+                }
+
+                if ((strm.avail_out == 0) && (out < count)) {
+                        strm.next_out = (Bytef *)chunks[out];
+                        strm.avail_out = min (qr_inode->size
+                                              - (out * QR_SLAB_CHUNK_SIZE),
+                                              QR_SLAB_CHUNK_SIZE);
+                        out++;
+                }
+
+                zret = inflate (&strm, Z_NO_FLUSH);
+        } while (zret == Z_OK);
+
+        inflateEnd (&strm);
+
+        if ((zret != Z_STREAM_END) || (strm.total_out != qr_inode->size)) {
+                qr_chunks_put (table, chunks, count);
+                goto out;
+        }
+
+        qr_chunks_put (table, qr_inode->chunks, qr_inode->chunk_count);
+        table->cache_used += (count - qr_inode->chunk_count)
+                * QR_SLAB_CHUNK_SIZE;
+        table->bytes_saved -= (count - qr_inode->chunk_count)
+                * QR_SLAB_CHUNK_SIZE;
+
+        qr_inode->chunks = chunks;
+        qr_inode->chunk_count = count;
+        qr_inode->stored = qr_inode->size;
+        qr_inode->compressed = 0;
+
+        ret = 0;
+out:
+        gettimeofday (&end, NULL);
+
+        table->decompressions++;
+        table->decompress_usec += ((end.tv_sec - start.tv_sec) * 1000000)
+                + (end.tv_usec - start.tv_usec);
+
+        return ret;
+}
+#else
+int
+__qr_content_compress (qr_inode_t *qr_inode)
+{
+        qr_inode->incompressible = 1;
+        return -1;
+}
+
+
+int
+__qr_content_decompress (qr_inode_t *qr_inode)
+{
+        return -1;
+}
+#endif /* HAVE_LIBZ */
+
+
 /* To be called with qr_inode->table->lock held */
 void
 __qr_inode_free (qr_inode_t *qr_inode)
@@ -232,9 +647,7 @@ __qr_inode_free (qr_inode_t *qr_inode)
                 goto out;
         }
 
-        if (qr_inode->xattr) {
-                dict_unref (qr_inode->xattr);
-        }
+        __qr_content_free (qr_inode);
 
         list_del (&qr_inode->lru);
 
@@ -243,7 +656,14 @@ out:
         return;
 }
 
-/* To be called with priv->table.lock held */
+/*
+ * To be called with priv->table.lock held
+ *
+ * the lru lists are swept like a clock, lowest priority first. a file read
+ * since the hand last passed has its hit count halved and goes round again.
+ * an unread file is compressed on its first pass, if enabled, and evicted on
+ * the next. if every file is still being read, plain lru takes over.
+ */
 void
 __qr_cache_prune (xlator_t *this)
 {
@@ -252,27 +672,55 @@ __qr_cache_prune (xlator_t *this)
         qr_inode_table_t *table = NULL;
 	qr_inode_t        *curr = NULL, *next = NULL;
 	int32_t           index = 0;
-	uint64_t          size_to_prune = 0;
-	uint64_t          size_pruned = 0;
+        struct list_head  aged;
 
         priv = this->private;
         table = &priv->table;
         conf = &priv->conf;
 
-        size_to_prune = table->cache_used - conf->cache_size;
-
         for (index=0; index < conf->max_pri; index++) {
+                INIT_LIST_HEAD (&aged);
+
                 list_for_each_entry_safe (curr, next, &table->lru[index], lru) {
-                        size_pruned += curr->stbuf.ia_size;
+                        if (table->cache_used <= conf->cache_size)
+                                break;
+
+                        if (curr->hits) {
+                                curr->hits >>= 1;
+                                list_move_tail (&curr->lru, &aged);
+                                continue;
+                        }
+
+                        if (conf->compress && !curr->compressed
+                            && !curr->incompressible) {
+                                __qr_content_compress (curr);
+                                list_move_tail (&curr->lru, &aged);
+                                continue;
+                        }
+
                         inode_ctx_del (curr->inode, this, NULL);
                         __qr_inode_free (curr);
-                        if (size_pruned >= size_to_prune)
+                        table->evictions++;
+                }
+
+                list_splice (&aged, table->lru[index].prev);
+
+                if (table->cache_used <= conf->cache_size)
+                        goto done;
+        }
+
+        for (index=0; index < conf->max_pri; index++) {
+                list_for_each_entry_safe (curr, next, &table->lru[index], lru) {
+                        if (table->cache_used <= conf->cache_size)
                                 goto done;
+
+                        inode_ctx_del (curr->inode, this, NULL);
+                        __qr_inode_free (curr);
+                        table->evictions++;
                 }
         }
 
 done:
-        table->cache_used -= size_pruned;
 	return;
 }
 
@@ -356,15 +804,16 @@ qr_lookup_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                         }
                 }
 
-                if (qr_inode->xattr) {
-                        dict_unref (qr_inode->xattr);
-                        qr_inode->xattr = NULL;
-                        table->cache_used -= qr_inode->stbuf.ia_size;
+                ret = __qr_content_store (qr_inode, content->data,
+                                          content->len);
+                if (ret == -1) {
+                        gf_log (this->name, GF_LOG_DEBUG,
+                                "cannot cache content of %s, out of memory",
+                                local->path);
+                        goto unlock;
                 }
 
-                qr_inode->xattr = dict_ref (dict);
                 qr_inode->stbuf = *buf;
-                table->cache_used += buf->ia_size;
 
                 gettimeofday (&qr_inode->tv, NULL);
                 if (__qr_need_cache_prune (conf, table)) {
@@ -425,7 +874,7 @@ qr_lookup (call_frame_t *frame, xlator_t *this, loc_t *loc, dict_t *xattr_req)
                 if (op_ret == 0) {
                         qr_inode = (qr_inode_t *)(long)value;
                         if (qr_inode != NULL) {
-                                if (qr_inode->xattr) {
+                                if (qr_inode->cached) {
                                         cached = 1;
                                 }
                         }
@@ -630,7 +1079,7 @@ qr_open (call_frame_t *frame, xlator_t *this, loc_t *loc, int32_t flags,
                 if (ret == 0) {
                         qr_inode = (qr_inode_t *)(long) filep;
                         if (qr_inode) {
-                                if (qr_inode->xattr) {
+                                if (qr_inode->cached) {
                                         content_cached = 1;
                                 }
                         }
@@ -920,7 +1369,6 @@ qr_readv (call_frame_t *frame, xlator_t *this, fd_t *fd, size_t size,
         struct iobuf      *iobuf = NULL;
         struct iobref     *iobref = NULL;
         struct iatt        stbuf = {0, };
-        data_t            *content = NULL;
         qr_fd_ctx_t       *qr_fd_ctx = NULL;
         call_stub_t       *stub = NULL;
         loc_t              loc = {0, };
@@ -965,7 +1413,7 @@ qr_readv (call_frame_t *frame, xlator_t *this, fd_t *fd, size_t size,
                 if (ret == 0) {
                         qr_inode = (qr_inode_t *)(long)value;
                         if (qr_inode) {
-                                if (qr_inode->xattr){
+                                if (qr_inode->cached){
                                         if (!just_validated
                                             && qr_need_validation (conf,
                                                                    qr_inode)) {
@@ -973,23 +1421,30 @@ qr_readv (call_frame_t *frame, xlator_t *this, fd_t *fd, size_t size,
                                                 goto unlock;
                                         }
 
-                                        content = dict_get (qr_inode->xattr,
-                                                            GF_CONTENT_KEY);
-
+                                        if (qr_inode->compressed
+                                            && (__qr_content_decompress (qr_inode)
+                                                == -1)) {
+                                                /* cannot inflate it, drop it
+                                                 * and read from below */
+                                                __qr_content_free (qr_inode);
+                                                goto unlock;
+                                        }
 
                                         stbuf = qr_inode->stbuf;
                                         content_cached = 1;
                                         list_move_tail (&qr_inode->lru,
                                                         &table->lru[qr_inode->priority]);
+                                        qr_inode->hits++;
+                                        table->hits++;
 
-                                        if (offset > content->len) {
+                                        if (offset > qr_inode->size) {
                                                 op_ret = 0;
-                                                end = content->len;
+                                                end = qr_inode->size;
                                         } else {
                                                 if ((offset + size)
-                                                    > content->len) {
-                                                        op_ret = content->len - offset;
-                                                        end = content->len;
+                                                    > qr_inode->size) {
+                                                        op_ret = qr_inode->size - offset;
+                                                        end = qr_inode->size;
                                                 } else {
                                                         op_ret = size;
                                                         end =  offset + size;
@@ -1043,9 +1498,9 @@ qr_readv (call_frame_t *frame, xlator_t *this, fd_t *fd, size_t size,
                                                                 ? (end - start)
                                                                 : iobuf_pool->page_size;
 
-                                                        memcpy (iobuf->ptr,
-                                                                content->data + start,
-                                                                len);
+                                                        __qr_content_copy (qr_inode,
+                                                                           iobuf->ptr,
+                                                                           start, len);
                                                 }
 
                                                 iobref_add (iobref, iobuf);
@@ -2346,6 +2801,11 @@ qr_priv_dump (xlator_t *this)
         uint32_t        i = 0;
         qr_inode_t     *curr = NULL;
         uint64_t       total_size = 0;
+        uint32_t        compressed_count = 0;
+        uint64_t        arena_used = 0, hits = 0, evictions = 0;
+        uint64_t        arena_size = 0;
+        uint64_t        bytes_saved = 0, compressions = 0;
+        uint64_t        decompressions = 0, decompress_usec = 0;
 
         if (!this)
                 return -1;
@@ -2378,18 +2838,59 @@ qr_priv_dump (xlator_t *this)
                         "table is NULL");
                 goto out;
         } else {
-                for (i = 0; i < conf->max_pri; i++) {
-                        list_for_each_entry (curr, &table->lru[i], lru) {
-                                file_count++;
-                                total_size += curr->stbuf.ia_size;
+                LOCK (&table->lock);
+                {
+                        for (i = 0; i < conf->max_pri; i++) {
+                                list_for_each_entry (curr, &table->lru[i],
+                                                     lru) {
+                                        file_count++;
+                                        total_size += curr->stbuf.ia_size;
+                                        if (curr->compressed)
+                                                compressed_count++;
+                                }
                         }
+
+                        arena_used = table->cache_used;
+                        arena_size = table->arena_size;
+                        hits = table->hits;
+                        evictions = table->evictions;
+                        bytes_saved = table->bytes_saved;
+                        compressions = table->compressions;
+                        decompressions = table->decompressions;
+                        decompress_usec = table->decompress_usec;
                 }
+                UNLOCK (&table->lock);
         }
 
         gf_proc_dump_build_key (key, key_prefix, "total_files_cached");
         gf_proc_dump_write (key, "%d", file_count);
         gf_proc_dump_build_key (key, key_prefix, "total_cache_used");
         gf_proc_dump_write (key, "%d", total_size);
+        gf_proc_dump_build_key (key, key_prefix, "cache_size");
+        gf_proc_dump_write (key, "%"PRIu64, conf->cache_size);
+        gf_proc_dump_build_key (key, key_prefix, "arena_used");
+        gf_proc_dump_write (key, "%"PRIu64, arena_used);
+        gf_proc_dump_build_key (key, key_prefix, "arena_size");
+        gf_proc_dump_write (key, "%"PRIu64, arena_size);
+        gf_proc_dump_build_key (key, key_prefix, "hits");
+        gf_proc_dump_write (key, "%"PRIu64, hits);
+        gf_proc_dump_build_key (key, key_prefix, "evictions");
+        gf_proc_dump_write (key, "%"PRIu64, evictions);
+        gf_proc_dump_build_key (key, key_prefix, "compression");
+        gf_proc_dump_write (key, "%s", conf->compress ? "on" : "off");
+        gf_proc_dump_build_key (key, key_prefix, "files_compressed");
+        gf_proc_dump_write (key, "%u", compressed_count);
+        gf_proc_dump_build_key (key, key_prefix, "bytes_saved");
+        gf_proc_dump_write (key, "%"PRIu64, bytes_saved);
+        gf_proc_dump_build_key (key, key_prefix, "compressions");
+        gf_proc_dump_write (key, "%"PRIu64, compressions);
+        gf_proc_dump_build_key (key, key_prefix, "decompressions");
+        gf_proc_dump_write (key, "%"PRIu64, decompressions);
+        gf_proc_dump_build_key (key, key_prefix, "decompress_usec_total");
+        gf_proc_dump_write (key, "%"PRIu64, decompress_usec);
+        gf_proc_dump_build_key (key, key_prefix, "decompress_usec_avg");
+        gf_proc_dump_write (key, "%"PRIu64, decompressions ?
+                            decompress_usec / decompressions : 0);
 
 out:
         return 0;
@@ -2481,6 +2982,41 @@ out:
 
 }
 
+static int
+qr_compression_option (xlator_t *this, dict_t *options,
+                       gf_boolean_t *compress)
+{
+        char         *str = NULL;
+        int           ret = 0;
+
+        *compress = _gf_false;
+
+        if (dict_get_str (options, "compression", &str) != 0) {
+                goto out;
+        }
+
+        ret = gf_string2boolean (str, compress);
+        if (ret == -1) {
+                gf_log (this->name, GF_LOG_ERROR,
+                        "invalid value \"%s\" of \"option compression\"",
+                        str);
+                goto out;
+        }
+
+#ifndef HAVE_LIBZ
+        if (*compress) {
+                gf_log (this->name, GF_LOG_WARNING,
+                        "built without zlib, ignoring \"option "
+                        "compression\"");
+                *compress = _gf_false;
+        }
+#endif
+
+out:
+        return ret;
+}
+
+
 int
 reconfigure (xlator_t *this, dict_t *options)
 {
@@ -2539,6 +3075,11 @@ reconfigure (xlator_t *this, dict_t *options)
         else
                 conf->cache_size = QR_DEFAULT_CACHE_SIZE;
 
+        ret = qr_compression_option (this, options, &conf->compress);
+        if (ret == -1) {
+                goto out;
+        }
+
         ret = 0;
 out:
         return ret;
@@ -2746,11 +3287,20 @@ init (xlator_t *this)
                 INIT_LIST_HEAD (&priv->table.lru[i]);
         }
 
+        ret = qr_compression_option (this, this->options, &conf->compress);
+        if (ret == -1) {
+                goto out;
+        }
+
+        /* the arena starts empty and grows with the cache */
+        INIT_LIST_HEAD (&priv->table.slabs);
+
         ret = 0;
 
         this->private = priv;
 out:
         if ((ret == -1) && priv) {
+                GF_FREE (priv->table.lru);
                 GF_FREE (priv);
         }
 
@@ -2761,6 +3311,28 @@ out:
 void
 fini (xlator_t *this)
 {
+        qr_private_t *priv = NULL;
+        qr_inode_t   *curr = NULL;
+        int           i    = 0;
+
+        priv = this->private;
+        if (priv == NULL) {
+                return;
+        }
+
+        /* the inodes may outlive us, their contents go with the arena */
+        LOCK (&priv->table.lock);
+        {
+                for (i = 0; i < priv->conf.max_pri; i++) {
+                        list_for_each_entry (curr, &priv->table.lru[i], lru) {
+                                __qr_content_free (curr);
+                        }
+                }
+
+                __qr_arena_destroy (&priv->table);
+        }
+        UNLOCK (&priv->table.lock);
+
         return;
 }
 
@@ -2812,4 +3384,7 @@ struct volume_options options[] = {
           .min  = 0,
           .max  = 1 * GF_UNIT_KB * 1000,
         },
+        { .key  = {"compression"},
+          .type = GF_OPTION_TYPE_BOOL
+        },
 };
@@ -41,8 +41,14 @@
 #include <sys/stat.h>
 #include <unistd.h>
 #include <fnmatch.h>
+#ifdef HAVE_LIBZ
+#include <zlib.h>
+#endif
 #include "quick-read-mem-types.h"
 
+#define QR_SLAB_CHUNK_SIZE 1024   /* unit of the content arena */
+#define QR_SLAB_CHUNKS     256    /* chunks the arena grows by at a time */
+
 struct qr_fd_ctx {
         char              opened;
         char              disabled;
@@ -67,13 +73,29 @@ struct qr_local {
 };
 typedef struct qr_local qr_local_t;
 
+/*
+ * the content of a cached file lives in QR_SLAB_CHUNK_SIZE chunks carved out
+ * of the table's arena. the arena is a list of slabs of QR_SLAB_CHUNKS
+ * chunks each, added as the cache fills up and kept until fini, so it
+ * never holds much more than cache-size. when compression is on, a file which reaches the
+ * cold end of its lru list without being read is deflated in place, and
+ * inflated again on its next read.
+ */
 struct qr_inode {
-        dict_t           *xattr;
         inode_t          *inode;
         int               priority;
         struct iatt       stbuf;
         struct timeval    tv;
         struct list_head  lru;
+        struct qr_inode_table *table;
+        char              cached;         /* content below is valid */
+        char              compressed;
+        char              incompressible;
+        uint32_t          hits;           /* halved on every prune pass */
+        size_t            size;           /* length of the file content */
+        size_t            stored;         /* bytes held in the chunks */
+        int               chunk_count;
+        char            **chunks;
 };
 typedef struct qr_inode qr_inode_t;
 
@@ -89,14 +111,24 @@ struct qr_conf {
         int32_t          cache_timeout;
         uint64_t         cache_size;
         int              max_pri;
+        gf_boolean_t     compress;
         struct list_head priority_list;
 };
 typedef struct qr_conf qr_conf_t;
 
 struct qr_inode_table {
-        uint64_t          cache_used;
+        uint64_t          cache_used;     /* arena bytes held by contents */
         struct list_head *lru;
         gf_lock_t         lock;
+        struct list_head  slabs;          /* the arena */
+        void             *free_chunks;    /* linked through their 1st word */
+        uint64_t          arena_size;     /* bytes in the slabs */
+        uint64_t          hits;
+        uint64_t          evictions;
+        uint64_t          bytes_saved;    /* by contents now compressed */
+        uint64_t          compressions;
+        uint64_t          decompressions;
+        uint64_t          decompress_usec;
 };
 typedef struct qr_inode_table qr_inode_table_t;
 
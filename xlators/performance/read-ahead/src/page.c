@@ -74,6 +74,12 @@ ra_page_create (ra_file_t *file, off_t offset)
 		page->prev->next = newpage;
 		page->prev = newpage;
 
+		ra_conf_lock (file->conf);
+		{
+			file->conf->cache_used += file->page_size;
+		}
+		ra_conf_unlock (file->conf);
+
 		page = newpage;
 	}
 
@@ -462,14 +468,39 @@ ra_page_wakeup (ra_page_t *page)
 /*
  * ra_page_purge -
  * @page:
+ * @account: count a page read ahead in vain as waste
  *
  */
 void
-ra_page_purge (ra_page_t *page)
+ra_page_purge (ra_page_t *page, int account)
 {
+	ra_file_t   *file = NULL;
+	ra_stream_t *stream = NULL;
+	char         wasted = 0;
+
+	file = page->file;
+
 	page->prev->next = page->next;
 	page->next->prev = page->prev;
 
+	/* a page that was filled but never read was read ahead too far,
+	   shrink the window of the stream which asked for it. pages dropped
+	   for fstat, flush or fsync say nothing about the window */
+	if (account && page->ready && !page->accessed) {
+		wasted = 1;
+		stream = &file->streams[page->stream];
+		stream->waste++;
+		stream->page_count /= 2;
+	}
+
+	ra_conf_lock (file->conf);
+	{
+		file->conf->cache_used -= file->page_size;
+		if (wasted)
+			file->conf->waste++;
+	}
+	ra_conf_unlock (file->conf);
+
 	if (page->iobref) {
 		iobref_unref (page->iobref);
 	}
@@ -506,11 +537,34 @@ ra_page_error (ra_page_t *page, int32_t op_ret, int32_t op_errno)
 		}
 	}
 
-	ra_page_purge (page);
+	ra_page_purge (page, 0);
 
 	return waitq;
 }
 
+/*
+ * ra_file_streams_init -
+ * @file:
+ *
+ * stream 0 starts out expecting a read at the beginning of the file, the
+ * rest are free and get picked up by the first reads which do not match
+ * any stream.
+ */
+void
+ra_file_streams_init (ra_file_t *file)
+{
+	int i = 0;
+
+	for (i = 0; i < RA_MAX_STREAMS; i++) {
+		file->streams[i].offset = -1;
+		file->streams[i].last = -1;
+	}
+
+	file->streams[0].offset = 0;
+	if (!file->disabled)
+		file->streams[0].page_count = 1;
+}
+
 /* 
  * ra_file_destroy -
  * @file:
@@ -39,7 +39,8 @@
 #include <sys/time.h>
 
 static void
-read_ahead (call_frame_t *frame, ra_file_t *file);
+read_ahead (call_frame_t *frame, ra_file_t *file, off_t offset,
+            uint32_t page_count, int32_t stream);
 
 
 int
@@ -77,7 +78,6 @@ ra_open_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                 file->disabled = 1;
         }
 
-	file->offset = (unsigned long long) 0;
 	file->conf = conf;
 	file->pages.next = &file->pages;
 	file->pages.prev = &file->pages;
@@ -94,13 +94,10 @@ ra_open_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 	ra_conf_unlock (conf);
 
 	file->fd = fd;
-	file->page_count = conf->page_count;
 	file->page_size = conf->page_size;
 	pthread_mutex_init (&file->file_lock, NULL);
 
-	if (!file->disabled) {
-		file->page_count = 1;
-	}
+	ra_file_streams_init (file);
 
 	ret = fd_ctx_set (fd, this, (uint64_t)(long)file);
         if (ret == -1) {
@@ -148,7 +145,6 @@ ra_create_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 	if ((fd->flags & O_DIRECT) || ((fd->flags & O_ACCMODE) == O_WRONLY))
 			file->disabled = 1;
 
-	file->offset = (unsigned long long) 0;
 	//file->size = fd->inode->buf.ia_size;
 	file->conf = conf;
 	file->pages.next = &file->pages;
@@ -166,10 +162,11 @@ ra_create_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 	ra_conf_unlock (conf);
 
 	file->fd = fd;
-	file->page_count = conf->page_count;
 	file->page_size = conf->page_size;
 	pthread_mutex_init (&file->file_lock, NULL);
 
+	ra_file_streams_init (file);
+
 	ret = fd_ctx_set (fd, this, (uint64_t)(long)file);
         if (ret == -1) {
                 ra_file_destroy (file);
@@ -212,11 +209,14 @@ ra_create (call_frame_t *frame, xlator_t *this, loc_t *loc, int32_t flags,
 }
 
 /* free cache pages between offset and offset+size,
-   does not touch pages with frames waiting on it
+   does not touch pages with frames waiting on it. @account is set when
+   the pages are dropped because they conflict with a modification, and
+   unread ones then count as waste
 */
 
 static void
-flush_region (call_frame_t *frame, ra_file_t *file, off_t offset, off_t size)
+flush_region (call_frame_t *frame, ra_file_t *file, off_t offset, off_t size,
+              int account)
 {
 	ra_page_t *trav = NULL;
 	ra_page_t *next = NULL;
@@ -229,7 +229,34 @@ flush_region (call_frame_t *frame, ra_file_t *file, off_t offset, off_t size)
 
 			next = trav->next;
 			if (trav->offset >= offset && !trav->waitq) {
-				ra_page_purge (trav);
+				ra_page_purge (trav, account);
+			}
+			trav = next;
+		}
+	}
+	ra_file_unlock (file);
+}
+
+
+/* like flush_region, but only frees the pages belonging to @stream */
+
+static void
+flush_stream_region (ra_file_t *file, int32_t stream, off_t offset,
+                     off_t size)
+{
+	ra_page_t *trav = NULL;
+	ra_page_t *next = NULL;
+
+	ra_file_lock (file);
+	{
+		trav = file->pages.next;
+		while (trav != &file->pages
+		       && trav->offset < (offset + size)) {
+
+			next = trav->next;
+			if (trav->offset >= offset && !trav->waitq
+			    && trav->stream == stream) {
+				ra_page_purge (trav, 1);
 			}
 			trav = next;
 		}
@@ -238,6 +265,49 @@ flush_region (call_frame_t *frame, ra_file_t *file, off_t offset, off_t size)
 }
 
 
+/* return the stream expecting a read at @offset. if there is none, the
+   least recently used stream is handed out to start a new one and
+   *sequential is set to 0. called with file lock held.
+*/
+
+static ra_stream_t *
+__ra_stream_get (ra_file_t *file, off_t offset, char *sequential)
+{
+	ra_stream_t *stream = NULL;
+	ra_stream_t *lru = NULL;
+	int          i = 0;
+
+	for (i = 0; i < RA_MAX_STREAMS; i++) {
+		if (file->streams[i].offset == offset) {
+			stream = &file->streams[i];
+			break;
+		}
+
+		if (!lru || file->streams[i].tick < lru->tick)
+			lru = &file->streams[i];
+	}
+
+	*sequential = (stream != NULL);
+
+	return stream ? stream : lru;
+}
+
+
+static int
+ra_cache_full (ra_conf_t *conf)
+{
+	int full = 0;
+
+	ra_conf_lock (conf);
+	{
+		full = (conf->cache_used + conf->page_size > conf->cache_size);
+	}
+	ra_conf_unlock (conf);
+
+	return full;
+}
+
+
 int
 ra_release (xlator_t *this, fd_t *fd)
 {
@@ -255,7 +325,8 @@ ra_release (xlator_t *this, fd_t *fd)
 
 
 void
-read_ahead (call_frame_t *frame, ra_file_t *file)
+read_ahead (call_frame_t *frame, ra_file_t *file, off_t offset,
+            uint32_t page_count, int32_t stream)
 {
 	off_t      ra_offset = 0;
 	size_t     ra_size = 0;
@@ -264,14 +335,14 @@ read_ahead (call_frame_t *frame, ra_file_t *file)
 	off_t      cap = 0;
 	char       fault = 0;
 
-	if (!file->page_count)
+	if (!page_count)
 		return;
 
-	ra_size   = file->page_size * file->page_count;
-	ra_offset = floor (file->offset, file->page_size);
-	cap       = file->size ? file->size : file->offset + ra_size;
+	ra_size   = file->page_size * page_count;
+	ra_offset = floor (offset, file->page_size);
+	cap       = file->size ? file->size : offset + ra_size;
 
-	while (ra_offset < min (file->offset + ra_size, cap)) {
+	while (ra_offset < min (offset + ra_size, cap)) {
 
 		ra_file_lock (file);
 		{
@@ -298,17 +369,19 @@ read_ahead (call_frame_t *frame, ra_file_t *file)
 		ra_file_lock (file);
 		{
 			trav = ra_page_get (file, trav_offset);
-			if (!trav) {
+			if (!trav && !ra_cache_full (file->conf)) {
 				fault = 1;
 				trav = ra_page_create (file, trav_offset);
-				if (trav) 
+				if (trav) {
 					trav->dirty = 1;
+					trav->stream = stream;
+				}
 			}
 		}
 		ra_file_unlock (file);
 
 		if (!trav) {
-			/* OUT OF MEMORY */
+			/* OUT OF MEMORY or over the cache budget */
 			break;
 		}
 
@@ -335,7 +408,7 @@ ra_need_atime_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 
 
 static void
-dispatch_requests (call_frame_t *frame, ra_file_t *file)
+dispatch_requests (call_frame_t *frame, ra_file_t *file, int32_t stream)
 {
 	ra_local_t    *local = NULL;
 	ra_conf_t     *conf = NULL;
@@ -373,6 +446,10 @@ dispatch_requests (call_frame_t *frame, ra_file_t *file)
  				goto unlock;
                         }
 
+			if (fault)
+				trav->stream = stream;
+			trav->accessed = 1;
+
 			if (trav->ready) {
 				gf_log (frame->this->name, GF_LOG_TRACE,
 					"HIT at offset=%"PRId64".",
@@ -437,9 +514,15 @@ ra_readv (call_frame_t *frame, xlator_t *this, fd_t *fd, size_t size,
 	ra_file_t    *file = NULL;
 	ra_local_t   *local = NULL;
 	ra_conf_t    *conf = NULL;
+	ra_stream_t  *stream = NULL;
 	int          op_errno = 0;
 	char         expected_offset = 1;
 	uint64_t     tmp_file = 0;
+	int32_t      stream_idx = 0;
+	uint32_t     page_count = 0;
+	off_t        stale_offset = -1;
+	off_t        stale_end = -1;
+	off_t        last = -1;
 
 	conf = this->private;
 
@@ -457,26 +540,59 @@ ra_readv (call_frame_t *frame, xlator_t *this, fd_t *fd, size_t size,
                 goto unwind;
         }
 
-	if (file->offset != offset) {
-		gf_log (this->name, GF_LOG_DEBUG,
-			"unexpected offset (%"PRId64" != %"PRId64") resetting",
-			file->offset, offset);
-
-		expected_offset = file->expected = file->page_count = 0;
-	} else {
-		gf_log (this->name, GF_LOG_TRACE,
-			"expected offset (%"PRId64") when page_count=%d",
-			offset, file->page_count);
-
-		if (file->expected < (conf->page_size * conf->page_count)) {
-			file->expected += size;
-			file->page_count = min ((file->expected / file->page_size),
-						conf->page_count);
+	ra_file_lock (file);
+	{
+		stream = __ra_stream_get (file, offset, &expected_offset);
+		stream_idx = stream - file->streams;
+
+		if (!expected_offset) {
+			gf_log (this->name, GF_LOG_DEBUG,
+				"unexpected offset (%"PRId64") starting stream"
+				" %d", offset, stream_idx);
+
+			/* whatever the recycled stream read ahead and
+			   has not been consumed yet */
+			if (stream->last != -1) {
+				stale_offset = stream->last;
+				stale_end = stream->offset
+					+ file->page_size * conf->page_count;
+			}
+			stream->page_count = 0;
+		} else {
+			gf_log (this->name, GF_LOG_TRACE,
+				"expected offset (%"PRId64") on stream %d when "
+				"page_count=%d", offset, stream_idx,
+				stream->page_count);
+
+			stream->hits++;
+			if (stream->page_count < conf->page_count)
+				stream->page_count = stream->page_count ?
+					min (stream->page_count * 2,
+					     conf->page_count) : 1;
 		}
+
+		last = stream->last;
+		page_count = stream->page_count;
+
+		stream->last = offset;
+		stream->offset = offset + size;
+		stream->tick = ++file->tick;
 	}
+	ra_file_unlock (file);
 
 	if (!expected_offset) {
-		flush_region (frame, file, 0, file->pages.prev->offset + 1);
+		if (stale_offset != -1)
+			flush_stream_region (file, stream_idx,
+					     floor (stale_offset,
+						    file->page_size),
+					     stale_end - floor (stale_offset,
+								file->page_size));
+	} else {
+		ra_conf_lock (conf);
+		{
+			conf->hits++;
+		}
+		ra_conf_unlock (conf);
 	}
 
 	if (file->disabled) {
@@ -508,16 +624,19 @@ ra_readv (call_frame_t *frame, xlator_t *this, fd_t *fd, size_t size,
 
 	frame->local = local;
 
-	dispatch_requests (frame, file);
+	dispatch_requests (frame, file, stream_idx);
 
-	flush_region (frame, file, 0, floor (offset, file->page_size));
+	/* pages this stream has read past */
+	if (expected_offset && (last != -1))
+		flush_stream_region (file, stream_idx,
+				     floor (last, file->page_size),
+				     floor (offset, file->page_size)
+				     - floor (last, file->page_size));
 
-        read_ahead (frame, file);
+        read_ahead (frame, file, offset, page_count, stream_idx);
 
 	ra_frame_return (frame);
 
-	file->offset = offset + size;
-
 	return 0;
 
 unwind:
@@ -562,7 +681,7 @@ ra_flush (call_frame_t *frame, xlator_t *this, fd_t *fd)
                 goto unwind;
         }
 
-        flush_region (frame, file, 0, file->pages.prev->offset+1);
+        flush_region (frame, file, 0, file->pages.prev->offset+1, 0);
 
 	STACK_WIND (frame, ra_flush_cbk,
 		    FIRST_CHILD (this),
@@ -593,7 +712,7 @@ ra_fsync (call_frame_t *frame, xlator_t *this, fd_t *fd, int32_t datasync)
         }
 
 	if (file) {
-		flush_region (frame, file, 0, file->pages.prev->offset+1);
+		flush_region (frame, file, 0, file->pages.prev->offset+1, 0);
 	}
 
 	STACK_WIND (frame, ra_fsync_cbk,
@@ -622,7 +741,7 @@ ra_writev_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 	fd_ctx_get (fd, this, &tmp_file);
 	file = (ra_file_t *)(long)tmp_file;
 
-        flush_region (frame, file, 0, file->pages.prev->offset+1);
+        flush_region (frame, file, 0, file->pages.prev->offset+1, 1);
 
 	frame->local = NULL;
 	STACK_UNWIND_STRICT (writev, frame, op_ret, op_errno, prebuf, postbuf);
@@ -637,6 +756,7 @@ ra_writev (call_frame_t *frame, xlator_t *this, fd_t *fd, struct iovec *vector,
 	ra_file_t *file = NULL;
 	uint64_t  tmp_file = 0;
         int32_t   op_errno = 0;
+        int       i = 0;
 
 	fd_ctx_get (fd, this, &tmp_file);
 	file = (ra_file_t *)(long)tmp_file;
@@ -647,10 +767,15 @@ ra_writev (call_frame_t *frame, xlator_t *this, fd_t *fd, struct iovec *vector,
                 goto unwind;
         }
 
-        flush_region (frame, file, 0, file->pages.prev->offset+1);
+        flush_region (frame, file, 0, file->pages.prev->offset+1, 1);
 
-        /* reset the read-ahead counters too */
-        file->expected = file->page_count = 0;
+        /* reset the read-ahead windows too */
+        ra_file_lock (file);
+        {
+                for (i = 0; i < RA_MAX_STREAMS; i++)
+                        file->streams[i].page_count = 0;
+        }
+        ra_file_unlock (file);
 
 	frame->local = fd;
 
@@ -706,7 +831,7 @@ ra_truncate (call_frame_t *frame, xlator_t *this, loc_t *loc, off_t offset)
 			if (!file)
 				continue;
 			flush_region (frame, file, 0,
-				      file->pages.prev->offset + 1);
+				      file->pages.prev->offset + 1, 1);
 		}
 	}
 	UNLOCK (&inode->lock);
@@ -738,7 +863,7 @@ ra_fstat (call_frame_t *frame, xlator_t *this, fd_t *fd)
 			if (!file)
 				continue;
 			flush_region (frame, file, 0,
-				      file->pages.prev->offset + 1);
+				      file->pages.prev->offset + 1, 0);
 		}
 	}
 	UNLOCK (&inode->lock);
@@ -769,7 +894,7 @@ ra_ftruncate (call_frame_t *frame, xlator_t *this, fd_t *fd, off_t offset)
 			if (!file)
 				continue;
 			flush_region (frame, file, 0,
-				      file->pages.prev->offset + 1);
+				      file->pages.prev->offset + 1, 1);
 		}
 	}
 	UNLOCK (&inode->lock);
@@ -818,12 +943,82 @@ ra_priv_dump (xlator_t *this)
         gf_proc_dump_write (key, "%d", conf->page_count);
         gf_proc_dump_build_key (key, key_prefix, "force_atime_update");
         gf_proc_dump_write (key, "%d", conf->force_atime_update);
+        gf_proc_dump_build_key (key, key_prefix, "cache_size");
+        gf_proc_dump_write (key, "%"PRIu64, conf->cache_size);
+        gf_proc_dump_build_key (key, key_prefix, "cache_used");
+        gf_proc_dump_write (key, "%"PRIu64, conf->cache_used);
+        gf_proc_dump_build_key (key, key_prefix, "hits");
+        gf_proc_dump_write (key, "%"PRIu64, conf->hits);
+        gf_proc_dump_build_key (key, key_prefix, "waste");
+        gf_proc_dump_write (key, "%"PRIu64, conf->waste);
 
         pthread_mutex_unlock (&conf->conf_lock);
 
         return 0;
 }
 
+
+int
+ra_fdctx_dump (xlator_t *this, fd_t *fd)
+{
+        ra_file_t       *file = NULL;
+        ra_stream_t     *stream = NULL;
+        uint64_t        tmp_file = 0;
+        int             ret = -1;
+        int             i = 0;
+        char            key[GF_DUMP_MAX_BUF_LEN];
+        char            key_prefix[GF_DUMP_MAX_BUF_LEN];
+
+        if ((fd == NULL) || (this == NULL))
+                return 0;
+
+        ret = fd_ctx_get (fd, this, &tmp_file);
+        if (ret == -1)
+                return 0;
+
+        file = (ra_file_t *)(long)tmp_file;
+        if (file == NULL)
+                return 0;
+
+        ret = pthread_mutex_trylock (&file->file_lock);
+        if (ret)
+                return -1;
+
+        gf_proc_dump_build_key (key_prefix,
+                                "xlator.performance.read-ahead",
+                                "file");
+
+        gf_proc_dump_add_section (key_prefix);
+
+        gf_proc_dump_build_key (key, key_prefix, "fd");
+        gf_proc_dump_write (key, "%p", fd);
+        gf_proc_dump_build_key (key, key_prefix, "disabled");
+        gf_proc_dump_write (key, "%d", file->disabled);
+
+        for (i = 0; i < RA_MAX_STREAMS; i++) {
+                stream = &file->streams[i];
+                if (stream->offset == -1)
+                        continue;
+
+                gf_proc_dump_build_key (key, key_prefix,
+                                        "stream[%d].offset", i);
+                gf_proc_dump_write (key, "%"PRId64, stream->offset);
+                gf_proc_dump_build_key (key, key_prefix,
+                                        "stream[%d].page_count", i);
+                gf_proc_dump_write (key, "%u", stream->page_count);
+                gf_proc_dump_build_key (key, key_prefix,
+                                        "stream[%d].hits", i);
+                gf_proc_dump_write (key, "%"PRIu64, stream->hits);
+                gf_proc_dump_build_key (key, key_prefix,
+                                        "stream[%d].waste", i);
+                gf_proc_dump_write (key, "%"PRIu64, stream->waste);
+        }
+
+        pthread_mutex_unlock (&file->file_lock);
+
+        return 0;
+}
+
 int32_t
 mem_acct_init (xlator_t *this)
 {
@@ -849,6 +1044,7 @@ init (xlator_t *this)
 	ra_conf_t *conf = NULL;
 	dict_t    *options = this->options;
 	char      *page_count_string = NULL;
+	char      *cache_size_string = NULL;
         int32_t   ret = -1;
 
 	if (!this->children || this->children->next) {
@@ -892,6 +1088,23 @@ init (xlator_t *this)
 		gf_log (this->name, GF_LOG_DEBUG, "Using conf->page_count = %u",
 			conf->page_count);
 	}
+
+	conf->cache_size = RA_DEFAULT_CACHE_SIZE;
+
+	if (dict_get (options, "cache-size"))
+		cache_size_string = data_to_str (dict_get (options,
+							   "cache-size"));
+	if (cache_size_string) {
+		if (gf_string2bytesize (cache_size_string, &conf->cache_size)
+		    != 0) {
+			gf_log (this->name, GF_LOG_ERROR,
+				"invalid number format \"%s\" of \"option "
+				"cache-size\"", cache_size_string);
+			goto out;
+		}
+		gf_log (this->name, GF_LOG_DEBUG, "Using conf->cache_size = "
+			"%"PRIu64, conf->cache_size);
+	}
   
 	if (dict_get (options, "force-atime-update")) {
 		char *force_atime_update_str = data_to_str (dict_get (options,
@@ -958,6 +1171,7 @@ struct xlator_cbks cbks = {
 
 struct xlator_dumpops dumpops = {
         .priv      =  ra_priv_dump,
+        .fdctx     =  ra_fdctx_dump,
 };
 
 struct volume_options options[] = {
@@ -969,5 +1183,10 @@ struct volume_options options[] = {
 	  .min  = 1, 
 	  .max  = 16 
 	},
+	{ .key  = {"cache-size"},
+	  .type = GF_OPTION_TYPE_SIZET,
+	  .min  = 1 * GF_UNIT_MB,
+	  .max  = 6 * GF_UNIT_GB
+	},
 	{ .key = {NULL} },
 };
@@ -33,11 +33,15 @@
 #include "common-utils.h"
 #include "read-ahead-mem-types.h"
 
+#define RA_MAX_STREAMS          4
+#define RA_DEFAULT_CACHE_SIZE   (32 * GF_UNIT_MB)
+
 struct ra_conf;
 struct ra_local;
 struct ra_page;
 struct ra_file;
 struct ra_waitq;
+struct ra_stream;
 
 
 struct ra_waitq {
@@ -78,6 +82,8 @@ struct ra_page {
 	struct ra_file   *file;
 	char              dirty;
 	char              ready;
+	char              accessed;     /* served to at least one readv */
+	int32_t           stream;       /* index into file->streams */
 	struct iovec     *vector;
 	int32_t           count;
 	off_t             offset;
@@ -87,27 +93,44 @@ struct ra_page {
 };
 
 
+/* A sequential reader on an fd. Each stream has its own window which
+ * doubles on every read at the expected offset and is halved whenever a
+ * page it read ahead is thrown away unread.
+ */
+struct ra_stream {
+	off_t              offset;      /* next expected read offset */
+	off_t              last;        /* offset of the last read */
+	uint32_t           page_count;  /* current window, in pages */
+	uint64_t           tick;        /* for recycling the LRU stream */
+	uint64_t           hits;
+	uint64_t           waste;
+};
+
+
 struct ra_file {
 	struct ra_file    *next;
 	struct ra_file    *prev;
 	struct ra_conf    *conf;
 	fd_t              *fd;
 	int                disabled;
-	size_t             expected;
 	struct ra_page     pages;
-	off_t              offset;
 	size_t             size;
 	int32_t            refcount;
 	pthread_mutex_t    file_lock;
 	struct iatt        stbuf;
 	uint64_t           page_size;
-	uint32_t           page_count;
+	struct ra_stream   streams[RA_MAX_STREAMS];
+	uint64_t           tick;
 };
 
 
 struct ra_conf {
 	uint64_t          page_size;
-	uint32_t          page_count;
+	uint32_t          page_count;   /* max window of a stream */
+	uint64_t          cache_size;   /* budget shared by all files */
+	uint64_t          cache_used;
+	uint64_t          hits;
+	uint64_t          waste;
 	void             *cache_block;
 	struct ra_file    files;
 	gf_boolean_t      force_atime_update;
@@ -121,6 +144,7 @@ typedef struct ra_page ra_page_t;
 typedef struct ra_file ra_file_t;
 typedef struct ra_waitq ra_waitq_t;
 typedef struct ra_fill ra_fill_t;
+typedef struct ra_stream ra_stream_t;
 
 ra_page_t *
 ra_page_get (ra_file_t *file,
@@ -149,7 +173,7 @@ ra_page_error (ra_page_t *page,
 	       int32_t op_ret,
 	       int32_t op_errno);
 void
-ra_page_purge (ra_page_t *page);
+ra_page_purge (ra_page_t *page, int account);
 
 void
 ra_frame_return (call_frame_t *frame);
@@ -161,6 +185,9 @@ ra_frame_fill (ra_page_t *page,
 void
 ra_file_destroy (ra_file_t *file);
 
+void
+ra_file_streams_init (ra_file_t *file);
+
 static inline void
 ra_file_lock (ra_file_t *file)
 {
@@ -226,6 +226,9 @@ sp_cache_unref (sp_cache_t *cache)
 
         if (refcount == 0) {
                 rbthash_table_destroy (cache->table);
+                if (cache->names) {
+                        rbthash_table_destroy (cache->names);
+                }
                 GF_FREE (cache);
         }
 
@@ -829,6 +832,362 @@ unlock:
 }
 
 
+void
+sp_listing_put (xlator_t *this, inode_t *inode, rbthash_table_t *names,
+                uint32_t count, uint64_t gen);
+
+
+static rbthash_table_t *
+sp_names_init (xlator_t *this)
+{
+        sp_private_t *priv = NULL;
+
+        priv = this->private;
+
+        return rbthash_table_init (GF_SP_CACHE_BUCKETS, sp_hashfn, __gf_free,
+                                   0, priv->mem_pool);
+}
+
+
+/*
+ * keeps the name of every entry of a directory read through @cache, as long
+ * as the reading started at offset 0 and went on where it left off. once
+ * the reading hits the end, the names are a complete listing and go to
+ * the inode of the directory.
+ */
+void
+sp_cache_add_names (xlator_t *this, sp_cache_t *cache, inode_t *inode,
+                    gf_dirent_t *entries, int32_t count, off_t offset,
+                    uint64_t gen)
+{
+        gf_dirent_t     *entry = NULL;
+        rbthash_table_t *names = NULL;
+        uint32_t         name_count = 0;
+        char            *name  = NULL;
+        char             complete = 0;
+        int32_t          ret   = -1;
+
+        LOCK (&cache->lock);
+        {
+                if (offset == 0) {
+                        names = cache->names;
+                        cache->names = sp_names_init (this);
+                        cache->name_count = 0;
+                        cache->names_gen = gen;
+                } else if (offset != cache->names_offset) {
+                        names = cache->names;
+                        cache->names = NULL;
+                }
+
+                if (cache->names == NULL) {
+                        goto unlock;
+                }
+
+                list_for_each_entry (entry, &entries->list, list) {
+                        cache->names_offset = entry->d_off;
+
+                        if (!strcmp (entry->d_name, ".")
+                            || !strcmp (entry->d_name, "..")) {
+                                continue;
+                        }
+
+                        name = gf_strdup (entry->d_name);
+                        if (name == NULL) {
+                                goto give_up;
+                        }
+
+                        ret = rbthash_insert (cache->names, name, name,
+                                              strlen (name));
+                        if (ret == -1) {
+                                GF_FREE (name);
+                                goto give_up;
+                        }
+
+                        if (++cache->name_count > SP_LISTING_MAX_ENTRIES) {
+                                goto give_up;
+                        }
+                }
+
+                if (count == 0) {
+                        complete = 1;
+                        names = cache->names;
+                        name_count = cache->name_count;
+                        gen = cache->names_gen;
+                        cache->names = NULL;
+                }
+
+                goto unlock;
+
+        give_up:
+                /* a listing we can not complete is no use */
+                if (names != NULL) {
+                        rbthash_table_destroy (names);
+                }
+                names = cache->names;
+                cache->names = NULL;
+        }
+unlock:
+        UNLOCK (&cache->lock);
+
+        if (complete) {
+                sp_listing_put (this, inode, names, name_count, gen);
+        } else if (names != NULL) {
+                rbthash_table_destroy (names);
+        }
+}
+
+
+/* takes the listing over if nothing changed the directory through us since
+   the reading started, and we know its mtime and ctime to check it with */
+void
+sp_listing_put (xlator_t *this, inode_t *inode, rbthash_table_t *names,
+                uint32_t count, uint64_t gen)
+{
+        sp_inode_ctx_t  *inode_ctx = NULL;
+        sp_private_t    *priv      = NULL;
+        rbthash_table_t *old       = NULL;
+        uint32_t         old_count = 0;
+        char             kept      = 0;
+
+        priv = this->private;
+
+        inode_ctx = sp_check_and_create_inode_ctx (this, inode, SP_DONT_CARE,
+                                                   GF_FOP_READDIR);
+        if (inode_ctx == NULL) {
+                goto out;
+        }
+
+        LOCK (&inode_ctx->lock);
+        {
+                if ((inode_ctx->listing_gen == gen)
+                    && IA_ISDIR (inode_ctx->stbuf.ia_type)) {
+                        old = inode_ctx->names;
+                        old_count = inode_ctx->name_count;
+
+                        inode_ctx->names = names;
+                        inode_ctx->name_count = count;
+                        inode_ctx->listed = time (NULL);
+                        inode_ctx->listed_stbuf = inode_ctx->stbuf;
+                        kept = 1;
+                }
+        }
+        UNLOCK (&inode_ctx->lock);
+
+out:
+        if (!kept) {
+                rbthash_table_destroy (names);
+                return;
+        }
+
+        if (old != NULL) {
+                rbthash_table_destroy (old);
+        }
+
+        LOCK (&priv->lock);
+        {
+                priv->listings++;
+                priv->listing_entries += count;
+                priv->listing_entries -= old_count;
+        }
+        UNLOCK (&priv->lock);
+}
+
+
+static void
+sp_listing_free (xlator_t *this, rbthash_table_t *names, uint32_t count,
+                 uint64_t *counter)
+{
+        sp_private_t *priv = NULL;
+
+        priv = this->private;
+
+        rbthash_table_destroy (names);
+
+        LOCK (&priv->lock);
+        {
+                priv->listing_entries -= count;
+                (*counter)++;
+        }
+        UNLOCK (&priv->lock);
+}
+
+
+/* an entry of the directory is being changed through us, its listing (and
+   any being read right now) can not be trusted anymore */
+void
+sp_listing_drop (xlator_t *this, inode_t *inode)
+{
+        sp_inode_ctx_t  *inode_ctx = NULL;
+        sp_private_t    *priv      = NULL;
+        rbthash_table_t *names     = NULL;
+        uint32_t         count     = 0;
+        uint64_t         value     = 0;
+        int32_t          ret       = -1;
+
+        if (inode == NULL) {
+                goto out;
+        }
+
+        priv = this->private;
+
+        ret = inode_ctx_get (inode, this, &value);
+        if ((ret == -1) || (value == 0)) {
+                goto out;
+        }
+
+        inode_ctx = (sp_inode_ctx_t *)(long) value;
+
+        LOCK (&inode_ctx->lock);
+        {
+                inode_ctx->listing_gen++;
+
+                names = inode_ctx->names;
+                count = inode_ctx->name_count;
+                inode_ctx->names = NULL;
+                inode_ctx->name_count = 0;
+        }
+        UNLOCK (&inode_ctx->lock);
+
+        if (names != NULL) {
+                sp_listing_free (this, names, count, &priv->listings_dropped);
+        }
+
+out:
+        return;
+}
+
+
+/* a listing read while the entry fop was in flight may still miss (or
+   still hold) the entry, drop it again now that the fop has returned */
+void
+sp_entry_done (xlator_t *this, inode_t *parent, int32_t op_ret,
+               struct iatt *postparent)
+{
+        if (parent == NULL) {
+                goto out;
+        }
+
+        sp_listing_drop (this, parent);
+
+        if ((op_ret == 0) && (postparent != NULL)) {
+                sp_update_inode_ctx (this, parent, NULL, NULL, NULL, NULL,
+                                     postparent, NULL, NULL);
+        }
+
+out:
+        return;
+}
+
+
+/*
+ * returns 1 if the complete listing of @parent says there is no @name in
+ * it. the listing is good for negative-timeout seconds, and as long as the
+ * mtime and ctime we last saw of the directory are the ones it was taken
+ * at.
+ */
+int32_t
+sp_listing_check (xlator_t *this, inode_t *parent, char *name,
+                  struct iatt *postparent)
+{
+        sp_inode_ctx_t  *inode_ctx = NULL;
+        sp_private_t    *priv      = NULL;
+        rbthash_table_t *names     = NULL;
+        uint64_t        *counter   = NULL;
+        uint32_t         count     = 0;
+        uint64_t         value     = 0;
+        int32_t          ret       = -1, absent = 0;
+        struct iatt     *then      = NULL, *now = NULL;
+
+        priv = this->private;
+
+        if ((parent == NULL) || (name == NULL) || !priv->negative_timeout) {
+                goto out;
+        }
+
+        ret = inode_ctx_get (parent, this, &value);
+        if ((ret == -1) || (value == 0)) {
+                goto out;
+        }
+
+        inode_ctx = (sp_inode_ctx_t *)(long) value;
+
+        LOCK (&inode_ctx->lock);
+        {
+                if (inode_ctx->names == NULL) {
+                        goto unlock;
+                }
+
+                then = &inode_ctx->listed_stbuf;
+                now  = &inode_ctx->stbuf;
+
+                if ((time (NULL) - inode_ctx->listed)
+                    >= priv->negative_timeout) {
+                        counter = &priv->listings_expired;
+                } else if ((then->ia_mtime != now->ia_mtime)
+                           || (then->ia_mtime_nsec != now->ia_mtime_nsec)
+                           || (then->ia_ctime != now->ia_ctime)
+                           || (then->ia_ctime_nsec != now->ia_ctime_nsec)) {
+                        counter = &priv->listings_stale;
+                }
+
+                if (counter != NULL) {
+                        names = inode_ctx->names;
+                        count = inode_ctx->name_count;
+                        inode_ctx->names = NULL;
+                        inode_ctx->name_count = 0;
+                        goto unlock;
+                }
+
+                if (rbthash_get (inode_ctx->names, name,
+                                 strlen (name)) == NULL) {
+                        *postparent = inode_ctx->stbuf;
+                        absent = 1;
+                }
+        }
+unlock:
+        UNLOCK (&inode_ctx->lock);
+
+        if (names != NULL) {
+                sp_listing_free (this, names, count, counter);
+        }
+
+out:
+        return absent;
+}
+
+
+/* keeps the attributes of a directory current, they are what its listing
+   is checked against */
+void
+sp_update_dir_stbuf (xlator_t *this, inode_t *inode, struct iatt *stbuf)
+{
+        sp_inode_ctx_t *inode_ctx = NULL;
+        uint64_t        value     = 0;
+        int32_t         ret       = -1;
+
+        if ((inode == NULL) || (stbuf == NULL)
+            || !IA_ISDIR (stbuf->ia_type)) {
+                goto out;
+        }
+
+        ret = inode_ctx_get (inode, this, &value);
+        if ((ret == -1) || (value == 0)) {
+                goto out;
+        }
+
+        inode_ctx = (sp_inode_ctx_t *)(long) value;
+
+        LOCK (&inode_ctx->lock);
+        {
+                inode_ctx->stbuf = *stbuf;
+        }
+        UNLOCK (&inode_ctx->lock);
+
+out:
+        return;
+}
+
+
 int32_t
 sp_lookup_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                int32_t op_ret, int32_t op_errno, inode_t *inode,
@@ -856,6 +1215,10 @@ sp_lookup_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                                                       (char *)local->loc.name);
         }
 
+        if ((op_ret == 0) || (op_errno == ENOENT)) {
+                sp_update_dir_stbuf (this, local->loc.parent, postparent);
+        }
+
         if (local->is_lookup)
                 need_unwind = 1;
 
@@ -1057,8 +1420,9 @@ int32_t
 sp_lookup (call_frame_t *frame, xlator_t *this, loc_t *loc, dict_t *xattr_req)
 {
         gf_dirent_t    *dirent          = NULL;
-        char            entry_cached    = 0; 
+        char            entry_cached    = 0, negative = 0; 
         uint64_t        value           = 0;
+        sp_private_t   *priv            = NULL;
         char            xattr_req_empty = 1, can_wind = 0;
         sp_cache_t     *cache           = NULL;
         struct iatt     postparent      = {0, }, buf = {0, };
@@ -1126,10 +1490,37 @@ sp_lookup (call_frame_t *frame, xlator_t *this, loc_t *loc, dict_t *xattr_req)
                 }
         }
 
+        if (!entry_cached) {
+                negative = sp_listing_check (this, loc->parent,
+                                             (char *)loc->name, &postparent);
+                if (negative) {
+                        op_ret = -1;
+                        op_errno = ENOENT;
+                }
+        }
+
 wind:
-        if (entry_cached) {
+        priv = this->private;
+
+        LOCK (&priv->lock);
+        {
+                if (entry_cached) {
+                        priv->lookup_hits++;
+                } else if (negative) {
+                        priv->lookup_negative_hits++;
+                } else {
+                        priv->lookup_misses++;
+                }
+        }
+        UNLOCK (&priv->lock);
+
+        if (entry_cached || negative) {
                 if (cache) {
-                        cache->hits++;
+                        if (entry_cached) {
+                                cache->hits++;
+                        } else {
+                                cache->miss++;
+                        }
                         sp_cache_unref (cache);
                 }
         } else {
@@ -1256,6 +1647,13 @@ unlock:
 
         if (cache != NULL) {
                 sp_cache_add_entries (cache, entries);
+
+                if (priv->negative_timeout) {
+                        sp_cache_add_names (this, cache, fd->inode, entries,
+                                            op_ret, local->offset,
+                                            local->gen);
+                }
+
                 if (was_present) {
                         sp_cache_unref (cache);
                 }
@@ -1271,10 +1669,11 @@ int32_t
 sp_readdir (call_frame_t *frame, xlator_t *this, fd_t *fd, size_t size,
             off_t off)
 {
-        sp_cache_t *cache    = NULL;
-        sp_local_t *local    = NULL;
-        char       *path     = NULL;
-        int32_t     ret      = -1;
+        sp_cache_t     *cache     = NULL;
+        sp_local_t     *local     = NULL;
+        sp_inode_ctx_t *inode_ctx = NULL;
+        char           *path      = NULL;
+        int32_t         ret       = -1;
 
         cache = sp_get_cache_fd (this, fd);
         if (cache) {
@@ -1303,7 +1702,24 @@ sp_readdir (call_frame_t *frame, xlator_t *this, fd_t *fd, size_t size,
         local = GF_CALLOC (1, sizeof (*local), gf_sp_mt_sp_local_t);
         if (local) {
                 local->fd = fd;
+                local->offset = off;
                 frame->local = local;
+
+                if (off == 0) {
+                        /* a listing begun now is only good if nothing
+                           changes the directory through us meanwhile */
+                        inode_ctx = sp_check_and_create_inode_ctx (this,
+                                                                   fd->inode,
+                                                                   SP_DONT_CARE,
+                                                                   GF_FOP_READDIR);
+                        if (inode_ctx != NULL) {
+                                LOCK (&inode_ctx->lock);
+                                {
+                                        local->gen = inode_ctx->listing_gen;
+                                }
+                                UNLOCK (&inode_ctx->lock);
+                        }
+                }
         }
 
 	STACK_WIND (frame, sp_readdir_cbk, FIRST_CHILD(this),
@@ -1334,12 +1750,47 @@ sp_rename_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                struct iatt *preoldparent, struct iatt *postoldparent,
                struct iatt *prenewparent, struct iatt *postnewparent)
 {
+        sp_parents_t *parents = cookie;
+
+        if (parents != NULL) {
+                sp_entry_done (this, parents->oldparent, op_ret,
+                               postoldparent);
+                sp_entry_done (this, parents->newparent, op_ret,
+                               postnewparent);
+
+                inode_unref (parents->oldparent);
+                inode_unref (parents->newparent);
+                GF_FREE (parents);
+        }
+
 	SP_STACK_UNWIND (rename, frame, op_ret, op_errno, buf, preoldparent,
                          postoldparent, prenewparent, postnewparent);
 	return 0;
 }
 
 
+void
+sp_rename_wind (call_frame_t *frame, xlator_t *this, loc_t *oldloc,
+                loc_t *newloc)
+{
+        sp_parents_t *parents = NULL;
+
+        parents = GF_CALLOC (1, sizeof (*parents), gf_sp_mt_sp_parents_t);
+        if (parents == NULL) {
+                gf_log (this->name, GF_LOG_ERROR, "out of memory");
+                SP_STACK_UNWIND (rename, frame, -1, ENOMEM, NULL, NULL, NULL,
+                                 NULL, NULL);
+                return;
+        }
+
+        parents->oldparent = inode_ref (oldloc->parent);
+        parents->newparent = inode_ref (newloc->parent);
+
+        STACK_WIND_COOKIE (frame, sp_rename_cbk, parents, FIRST_CHILD(this),
+                           FIRST_CHILD(this)->fops->rename, oldloc, newloc);
+}
+
+
 int32_t
 sp_fd_cbk (call_frame_t *frame, void *cookie, xlator_t *this, int32_t op_ret,
            int32_t op_errno, fd_t *fd)
@@ -1477,11 +1928,15 @@ sp_create_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
         sp_fd_ctx_t    *fd_ctx             = NULL;
         char            lookup_in_progress = 0, looked_up = 0;
 
+        local = frame->local;
+        if (local != NULL) {
+                sp_entry_done (this, local->loc.parent, op_ret, postparent);
+        }
+
         if (op_ret < 0) {
                 goto out;
         }
 
-        local = frame->local;
         GF_VALIDATE_OR_GOTO_WITH_ERROR (this->name, local, out, op_errno,
                                         EINVAL);
 
@@ -1493,9 +1948,6 @@ sp_create_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
                 goto out;
         }
 
-        sp_update_inode_ctx (this, local->loc.parent, NULL, NULL, NULL,
-                             NULL, postparent, NULL, NULL);
-
         fd_ctx = sp_fd_ctx_new (this, local->loc.parent,
                                 (char *)local->loc.name, NULL);
         GF_VALIDATE_OR_GOTO_WITH_ERROR (this->name, fd_ctx, out, op_errno,
@@ -1532,6 +1984,8 @@ sp_create (call_frame_t *frame,	xlator_t *this,	loc_t *loc, int32_t flags,
         GF_VALIDATE_OR_GOTO_WITH_ERROR (this->name, loc->inode, out,
                                         op_errno, EINVAL);
 
+        sp_listing_drop (this, loc->parent);
+
         ret = sp_cache_remove_parent_entry (frame, this, loc->inode->table,
                                             (char *)loc->path);
         if (ret == -1) {
@@ -1675,11 +2129,15 @@ sp_new_entry_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
         sp_local_t *local              = NULL;
         char        lookup_in_progress = 0, looked_up = 0;
 
+        local = frame->local;
+        if (local != NULL) {
+                sp_entry_done (this, local->loc.parent, op_ret, postparent);
+        }
+
         if (op_ret == -1) {
                 goto out;
         }
 
-        local = frame->local;
         if (local == NULL) {
                 op_errno = EINVAL;
                 goto out;
@@ -1689,12 +2147,6 @@ sp_new_entry_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
         op_ret = sp_update_inode_ctx (this, local->loc.inode, &op_ret,
                                       &op_errno, &lookup_in_progress,
                                       &looked_up, buf, NULL, &op_errno);
-        if (op_ret == -1) {
-                goto out;
-        }
-
-        sp_update_inode_ctx (this, local->loc.parent, NULL, NULL, NULL,
-                             NULL, postparent, NULL, NULL);
 
 out:
 	SP_STACK_UNWIND (mkdir, frame, op_ret, op_errno, inode, buf, preparent,
@@ -1721,6 +2173,8 @@ sp_mkdir (call_frame_t *frame, xlator_t *this, loc_t *loc, mode_t mode,
         GF_VALIDATE_OR_GOTO_WITH_ERROR (this->name, loc->inode, out,
                                         op_errno, EINVAL);
 
+        sp_listing_drop (this, loc->parent);
+
         ret = sp_cache_remove_parent_entry (frame, this, loc->inode->table,
                                             (char *)loc->path);
         if (ret == -1) {
@@ -1782,6 +2236,8 @@ sp_mknod (call_frame_t *frame, xlator_t *this, loc_t *loc, mode_t mode,
         GF_VALIDATE_OR_GOTO_WITH_ERROR (this->name, loc->inode, out,
                                         op_errno, EINVAL);
 
+        sp_listing_drop (this, loc->parent);
+
         ret = sp_cache_remove_parent_entry (frame, this, loc->inode->table,
                                             (char *)loc->path);
         if (ret == -1) {
@@ -1844,6 +2300,8 @@ sp_symlink (call_frame_t *frame, xlator_t *this, const char *linkpath,
         GF_VALIDATE_OR_GOTO_WITH_ERROR (this->name, loc->inode, out,
                                         op_errno, EINVAL);
 
+        sp_listing_drop (this, loc->parent);
+
         ret = sp_cache_remove_parent_entry (frame, this, loc->inode->table,
                                             (char *)loc->path);
         if (ret == -1) {
@@ -1893,6 +2351,11 @@ sp_link_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
              struct iatt *buf, struct iatt *preparent,
              struct iatt *postparent)
 {
+        inode_t *parent = cookie;
+
+        sp_entry_done (this, parent, op_ret, postparent);
+        inode_unref (parent);
+
 	SP_STACK_UNWIND (link, frame, op_ret, op_errno, inode, buf, preparent,
                          postparent);
 	return 0;
@@ -1929,8 +2392,9 @@ sp_link_helper (call_frame_t *frame, xlator_t *this, loc_t *oldloc,
                 goto unwind;
         }
 
-        STACK_WIND (frame, sp_link_cbk, FIRST_CHILD(this),
-                    FIRST_CHILD(this)->fops->link, oldloc, newloc);
+        STACK_WIND_COOKIE (frame, sp_link_cbk, inode_ref (newloc->parent),
+                           FIRST_CHILD(this), FIRST_CHILD(this)->fops->link,
+                           oldloc, newloc);
 
         return 0;
 
@@ -1959,6 +2423,8 @@ sp_link (call_frame_t *frame, xlator_t *this, loc_t *oldloc, loc_t *newloc)
         GF_VALIDATE_OR_GOTO_WITH_ERROR (this->name, oldloc->name, out,
                                         op_errno, EINVAL);
 
+        sp_listing_drop (this, newloc->parent);
+
         ret = sp_cache_remove_parent_entry (frame, this, newloc->parent->table,
                                             (char *)newloc->path);
         if (ret == -1) {
@@ -1988,8 +2454,11 @@ out:
                 STACK_WIND (frame, sp_lookup_cbk, FIRST_CHILD(this),
                             FIRST_CHILD(this)->fops->lookup, oldloc, NULL);
         } else if (can_wind) {
-                STACK_WIND (frame, sp_link_cbk, FIRST_CHILD(this),
-                            FIRST_CHILD(this)->fops->link, oldloc, newloc);
+                STACK_WIND_COOKIE (frame, sp_link_cbk,
+                                   inode_ref (newloc->parent),
+                                   FIRST_CHILD(this),
+                                   FIRST_CHILD(this)->fops->link, oldloc,
+                                   newloc);
         }
          
         return 0;
@@ -2309,6 +2778,22 @@ sp_unlink_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
 }
 
 
+int32_t
+sp_remove_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
+               int32_t op_ret, int32_t op_errno, struct iatt *preparent,
+               struct iatt *postparent)
+{
+        inode_t *parent = cookie;
+
+        sp_entry_done (this, parent, op_ret, postparent);
+        inode_unref (parent);
+
+	SP_STACK_UNWIND (unlink, frame, op_ret, op_errno, preparent,
+                         postparent);
+	return 0;
+}
+
+
 
 int32_t
 sp_err_cbk (call_frame_t *frame, void *cookie, xlator_t *this,
@@ -2349,8 +2834,9 @@ sp_unlink_helper (call_frame_t *frame, xlator_t *this, loc_t *loc)
                 goto unwind;
         }
 
-        STACK_WIND (frame, sp_unlink_cbk, FIRST_CHILD(this),
-                    FIRST_CHILD(this)->fops->unlink, loc);
+        STACK_WIND_COOKIE (frame, sp_remove_cbk, inode_ref (loc->parent),
+                           FIRST_CHILD(this), FIRST_CHILD(this)->fops->unlink,
+                           loc);
 
         return 0;
 
@@ -2375,6 +2861,8 @@ sp_unlink (call_frame_t *frame, xlator_t *this, loc_t *loc)
         sp_remove_caches_from_all_fds_opened (this, loc->parent,
                                               (char *)loc->name);
 
+        sp_listing_drop (this, loc->parent);
+
         ret = sp_cache_remove_parent_entry (frame, this, loc->parent->table,
                                             (char *)loc->path);
         if (ret == -1) {
@@ -2401,8 +2889,9 @@ out:
                  STACK_WIND (frame, sp_lookup_cbk, FIRST_CHILD(this),
                              FIRST_CHILD(this)->fops->lookup, loc, NULL);
          } else if (can_wind) {
-                 STACK_WIND (frame, sp_unlink_cbk, FIRST_CHILD(this),
-                             FIRST_CHILD(this)->fops->unlink, loc);
+                 STACK_WIND_COOKIE (frame, sp_remove_cbk,
+                                    inode_ref (loc->parent), FIRST_CHILD(this),
+                                    FIRST_CHILD(this)->fops->unlink, loc);
          }
 
          return 0;
@@ -2439,8 +2928,9 @@ sp_rmdir_helper (call_frame_t *frame, xlator_t *this, loc_t *loc, int flags)
                 goto unwind;
         }
 
-        STACK_WIND (frame, sp_unlink_cbk, FIRST_CHILD(this),
-                    FIRST_CHILD(this)->fops->rmdir, loc, flags);
+        STACK_WIND_COOKIE (frame, sp_remove_cbk, inode_ref (loc->parent),
+                           FIRST_CHILD(this), FIRST_CHILD(this)->fops->rmdir,
+                           loc, flags);
 
         return 0;
 
@@ -2468,6 +2958,8 @@ sp_rmdir (call_frame_t *frame, xlator_t *this, loc_t *loc, int flags)
 
         sp_remove_caches_from_all_fds_opened (this, loc->inode, NULL);
 
+        sp_listing_drop (this, loc->parent);
+
         ret = sp_cache_remove_parent_entry (frame, this, loc->inode->table,
                                             (char *)loc->path);
         if (ret == -1) {
@@ -2494,8 +2986,9 @@ out:
                 STACK_WIND (frame, sp_lookup_cbk, FIRST_CHILD(this),
                             FIRST_CHILD(this)->fops->lookup, loc, NULL);
         } else if (can_wind) {
-                STACK_WIND (frame, sp_unlink_cbk, FIRST_CHILD(this),
-                            FIRST_CHILD(this)->fops->rmdir, loc, flags);
+                STACK_WIND_COOKIE (frame, sp_remove_cbk,
+                                   inode_ref (loc->parent), FIRST_CHILD(this),
+                                   FIRST_CHILD(this)->fops->rmdir, loc, flags);
         }
 
         return 0;
@@ -2693,8 +3186,7 @@ sp_rename_helper (call_frame_t *frame, xlator_t *this, loc_t *oldloc,
         }
 
         if (can_wind) {
-                STACK_WIND (frame, sp_rename_cbk, FIRST_CHILD(this),
-                            FIRST_CHILD(this)->fops->rename, oldloc, newloc);
+                sp_rename_wind (frame, this, oldloc, newloc);
         }
 
         return 0;
@@ -2737,6 +3229,8 @@ sp_rename (call_frame_t *frame, xlator_t *this, loc_t *oldloc,loc_t *newloc)
         sp_remove_caches_from_all_fds_opened (this, newloc->parent,
                                               (char *)newloc->name);
 
+        sp_listing_drop (this, oldloc->parent);
+
         ret = sp_cache_remove_parent_entry (frame, this, oldloc->parent->table,
                                             (char *)oldloc->path);
         if (ret == -1) {
@@ -2744,6 +3238,8 @@ sp_rename (call_frame_t *frame, xlator_t *this, loc_t *oldloc,loc_t *newloc)
                 goto out;
         }
 
+        sp_listing_drop (this, newloc->parent);
+
         ret = sp_cache_remove_parent_entry (frame, this, newloc->parent->table,
                                             (char *)newloc->path);
         if (ret == -1) {
@@ -2827,8 +3323,7 @@ out:
                                     NULL);
                 }
         } else if (old_inode_can_wind && new_inode_can_wind) {
-                STACK_WIND (frame, sp_rename_cbk, FIRST_CHILD(this),
-                            FIRST_CHILD(this)->fops->rename, oldloc, newloc);
+                sp_rename_wind (frame, this, oldloc, newloc);
         }
          
         return 0;
@@ -3556,14 +4051,27 @@ out:
 int32_t
 sp_forget (xlator_t *this, inode_t *inode)
 {
-        struct iatt *buf   = NULL;
-        uint64_t     value = 0;
+        sp_inode_ctx_t *inode_ctx = NULL;
+        sp_private_t   *priv      = NULL;
+        uint64_t        value     = 0;
 
         inode_ctx_del (inode, this, &value);
         
         if (value) {
-                buf = (void *)(long)value;
-                GF_FREE (buf);
+                inode_ctx = (void *)(long)value;
+
+                if (inode_ctx->names) {
+                        priv = this->private;
+                        rbthash_table_destroy (inode_ctx->names);
+
+                        LOCK (&priv->lock);
+                        {
+                                priv->listing_entries -= inode_ctx->name_count;
+                        }
+                        UNLOCK (&priv->lock);
+                }
+
+                GF_FREE (inode_ctx);
         }
         
         return 0;
@@ -3598,6 +4106,7 @@ sp_priv_dump (xlator_t *this)
 {
         sp_private_t            *priv = NULL;
         uint32_t                total_entries = 0;
+        uint64_t                lookups = 0;
         uint32_t                ret = -1;
         char                    key[GF_DUMP_MAX_BUF_LEN];
         char                    key_prefix[GF_DUMP_MAX_BUF_LEN];
@@ -3618,6 +4127,43 @@ sp_priv_dump (xlator_t *this)
         gf_proc_dump_write (key, "%lu", GF_SP_CACHE_ENTRIES_EXPECTED);
         gf_proc_dump_build_key (key, key_prefix, "num_entries_cached");
         gf_proc_dump_write (key, "%lu",(unsigned long)total_entries);
+
+        LOCK (&priv->lock);
+        {
+                lookups = priv->lookup_hits + priv->lookup_negative_hits
+                        + priv->lookup_misses;
+
+                gf_proc_dump_build_key (key, key_prefix, "negative_timeout");
+                gf_proc_dump_write (key, "%d", priv->negative_timeout);
+                gf_proc_dump_build_key (key, key_prefix, "lookup_hits");
+                gf_proc_dump_write (key, "%"PRIu64, priv->lookup_hits);
+                gf_proc_dump_build_key (key, key_prefix,
+                                        "lookup_negative_hits");
+                gf_proc_dump_write (key, "%"PRIu64,
+                                    priv->lookup_negative_hits);
+                gf_proc_dump_build_key (key, key_prefix, "lookup_misses");
+                gf_proc_dump_write (key, "%"PRIu64, priv->lookup_misses);
+                gf_proc_dump_build_key (key, key_prefix, "lookup_hit_rate");
+                gf_proc_dump_write (key, "%.2f%%", lookups ?
+                                    (priv->lookup_hits * 100.0 / lookups) : 0);
+                gf_proc_dump_build_key (key, key_prefix,
+                                        "lookup_negative_hit_rate");
+                gf_proc_dump_write (key, "%.2f%%", lookups ?
+                                    (priv->lookup_negative_hits * 100.0
+                                     / lookups) : 0);
+                gf_proc_dump_build_key (key, key_prefix, "listings");
+                gf_proc_dump_write (key, "%"PRIu64, priv->listings);
+                gf_proc_dump_build_key (key, key_prefix, "listing_entries");
+                gf_proc_dump_write (key, "%"PRIu64, priv->listing_entries);
+                gf_proc_dump_build_key (key, key_prefix, "listings_dropped");
+                gf_proc_dump_write (key, "%"PRIu64, priv->listings_dropped);
+                gf_proc_dump_build_key (key, key_prefix, "listings_stale");
+                gf_proc_dump_write (key, "%"PRIu64, priv->listings_stale);
+                gf_proc_dump_build_key (key, key_prefix, "listings_expired");
+                gf_proc_dump_write (key, "%"PRIu64, priv->listings_expired);
+        }
+        UNLOCK (&priv->lock);
+
         ret = 0;
 
 out:
@@ -3643,6 +4189,29 @@ mem_acct_init (xlator_t *this)
         return ret;
 }
 
+static int
+sp_negative_timeout (xlator_t *this, dict_t *options, int32_t *timeout)
+{
+        *timeout = SP_DEFAULT_NEGATIVE_TIMEOUT;
+
+        if (dict_get (options, "negative-timeout")) {
+                *timeout = data_to_int32 (dict_get (options,
+                                                    "negative-timeout"));
+                if (*timeout < 0) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "'negative-timeout' (%d) cannot be negative",
+                                *timeout);
+                        return -1;
+                }
+        }
+
+        gf_log (this->name, GF_LOG_DEBUG, "negative lookups are answered "
+                "from directory listings for %d secs", *timeout);
+
+        return 0;
+}
+
+
 int32_t 
 init (xlator_t *this)
 {
@@ -3659,8 +4228,21 @@ init (xlator_t *this)
 
         priv = GF_CALLOC (1, sizeof(sp_private_t),
                           gf_sp_mt_sp_private_t);
+        if (priv == NULL) {
+                gf_log (this->name, GF_LOG_ERROR, "out of memory");
+                goto out;
+        }
+
         LOCK_INIT (&priv->lock);
 
+        ret = sp_negative_timeout (this, this->options,
+                                   &priv->negative_timeout);
+        if (ret == -1) {
+                LOCK_DESTROY (&priv->lock);
+                GF_FREE (priv);
+                goto out;
+        }
+
         this->private = priv;
 
         ret = 0;
@@ -3668,6 +4250,24 @@ out:
         return ret;
 }
 
+
+int
+reconfigure (xlator_t *this, dict_t *options)
+{
+        sp_private_t *priv    = NULL;
+        int32_t       timeout = 0;
+        int           ret     = -1;
+
+        priv = this->private;
+
+        ret = sp_negative_timeout (this, options, &timeout);
+        if (ret == 0) {
+                priv->negative_timeout = timeout;
+        }
+
+        return ret;
+}
+
 void
 fini (xlator_t *this)
 {
@@ -3731,3 +4331,14 @@ struct xlator_cbks cbks = {
 struct xlator_dumpops dumpops = {
         .priv = sp_priv_dump,
 };
+
+struct volume_options options[] = {
+        { .key  = {"negative-timeout"},
+          .type = GF_OPTION_TYPE_INT,
+          .min  = 0,
+          .max  = 3600,
+          .description = "Seconds a complete listing of a directory is used "
+                         "to answer lookups of names not in it. 0 disables"
+        },
+        { .key  = {NULL} },
+};
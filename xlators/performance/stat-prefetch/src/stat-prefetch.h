@@ -36,6 +36,9 @@
 #include "stat-prefetch-mem-types.h"
 #include <libgen.h>
 
+#define SP_DEFAULT_NEGATIVE_TIMEOUT 1        /* In secs, 0 disables */
+#define SP_LISTING_MAX_ENTRIES      65536
+
 struct sp_cache {
         rbthash_table_t *table;
         xlator_t        *this;
@@ -46,6 +49,15 @@ struct sp_cache {
         unsigned long    miss;
         unsigned long    hits;
         uint32_t         ref;
+        rbthash_table_t *names;              /* every name read so far, when
+                                              * reading started at offset 0
+                                              * and went on without a gap
+                                              */
+        uint32_t         name_count;
+        uint64_t         names_offset;
+        uint64_t         names_gen;          /* listing_gen of the directory
+                                              * when the reading started
+                                              */
 };
 typedef struct sp_cache sp_cache_t;
 
@@ -62,12 +74,21 @@ struct sp_fd_ctx {
 typedef struct sp_fd_ctx sp_fd_ctx_t;
 
 struct sp_local {
-        loc_t  loc;
-        fd_t  *fd;
-        char   is_lookup;
+        loc_t    loc;
+        fd_t    *fd;
+        char     is_lookup;
+        off_t    offset;
+        uint64_t gen;
 };
 typedef struct sp_local sp_local_t;
 
+/* parent directories of a rename, referenced until it returns */
+struct sp_parents {
+        inode_t *oldparent;
+        inode_t *newparent;
+};
+typedef struct sp_parents sp_parents_t;
+
 struct sp_inode_ctx {
         char             looked_up;
         char             lookup_in_progress;
@@ -77,6 +98,15 @@ struct sp_inode_ctx {
         struct iatt      stbuf;  
         gf_lock_t        lock;
         struct list_head waiting_ops;
+        rbthash_table_t *names;              /* complete listing of a
+                                              * directory
+                                              */
+        uint32_t         name_count;
+        time_t           listed;             /* when it was completed */
+        struct iatt      listed_stbuf;       /* directory as of then */
+        uint64_t         listing_gen;        /* bumped on every change made
+                                              * through us
+                                              */
 };
 typedef struct sp_inode_ctx sp_inode_ctx_t;
 
@@ -84,6 +114,15 @@ struct sp_private {
         struct mem_pool  *mem_pool;
         uint32_t         entries;
         gf_lock_t        lock;
+        int32_t          negative_timeout;
+        uint64_t         lookup_hits;        /* answered from readdir data */
+        uint64_t         lookup_negative_hits;
+        uint64_t         lookup_misses;
+        uint64_t         listings;           /* complete listings kept */
+        uint64_t         listing_entries;
+        uint64_t         listings_dropped;   /* changed through us */
+        uint64_t         listings_stale;     /* mtime/ctime moved on */
+        uint64_t         listings_expired;
 };
 typedef struct sp_private sp_private_t;
 
@@ -40,6 +40,9 @@
 #define MAX_VECTOR_COUNT 8
 #define WB_AGGREGATE_SIZE 131072 /* 128 KB */
 #define WB_WINDOW_SIZE 1048576 /* 1MB */
+#define WB_EXTENT_SIZE 1048576 /* 1MB */
+#define WB_GLOBAL_CACHE_SIZE 33554432 /* 32MB */
+#define WB_READ_MAX_RANGES 16
  
 typedef struct list_head list_head_t;
 struct wb_conf;
@@ -62,9 +65,19 @@ typedef struct wb_file {
         fd_t        *fd;
         gf_lock_t    lock;
         xlator_t    *this;
+        struct iatt  stbuf;         /* as of the last reply */
+        char         have_stbuf;
+        uint64_t     read_hits;     /* reads answered from the cache */
+        uint64_t     read_merges;   /* reads merged with the cache */
 }wb_file_t;
 
 
+typedef struct wb_range {
+        off_t        start;
+        off_t        end;
+} wb_range_t;
+
+
 typedef struct wb_request {
         list_head_t     list;
         list_head_t     winds;
@@ -72,6 +85,7 @@ typedef struct wb_request {
         list_head_t     other_requests;
         call_stub_t    *stub;
         size_t          write_size;
+        size_t          holder_size;   /* room in the buffer of a holder */
         int32_t         refcount;
         wb_file_t      *file;
         glusterfs_fop_t fop;
@@ -101,6 +115,10 @@ typedef struct wb_request {
 struct wb_conf {
         uint64_t     aggregate_size;
         uint64_t     window_size;
+        uint64_t     extent_size;
+        uint64_t     global_size;      /* shared by all the files */
+        uint64_t     global_current;
+        gf_lock_t    lock;
         uint64_t     disable_till;
         gf_boolean_t enable_O_SYNC;
         gf_boolean_t flush_behind;
@@ -118,6 +136,12 @@ typedef struct wb_local {
         int             op_errno;
         call_frame_t   *frame;
         int32_t         reply_count;
+        off_t           offset;
+        size_t          size;
+        struct iobref  *cached_iobref; /* what a read found in the cache */
+        char           *cached;
+        wb_range_t     *ranges;
+        int32_t         range_count;
 } wb_local_t;
 
 
@@ -136,6 +160,19 @@ __wb_mark_winds (list_head_t *list, list_head_t *winds, size_t aggregate_size,
                  char enable_trickling_writes);
 
 
+/* @charge bytes were written behind, @release bytes got their reply */
+static void
+wb_global_update (wb_conf_t *conf, size_t charge, size_t release)
+{
+        LOCK (&conf->lock);
+        {
+                conf->global_current += charge;
+                conf->global_current -= release;
+        }
+        UNLOCK (&conf->lock);
+}
+
+
 static int
 __wb_request_unref (wb_request_t *this)
 {
@@ -355,6 +392,7 @@ wb_sync_cbk (call_frame_t *frame, void *cookie, xlator_t *this, int32_t op_ret,
         wb_local_t   *per_request_local = NULL;
         int32_t       ret = -1;
         fd_t         *fd  = NULL;
+        size_t        released = 0;
 
 
         local = frame->local;
@@ -375,6 +413,7 @@ wb_sync_cbk (call_frame_t *frame, void *cookie, xlator_t *this, int32_t op_ret,
 
                         if (request->flags.write_request.write_behind) {
                                 file->window_current -= request->write_size;
+                                released += request->write_size;
                         }
 
                         __wb_request_unref (request);
@@ -383,11 +422,18 @@ wb_sync_cbk (call_frame_t *frame, void *cookie, xlator_t *this, int32_t op_ret,
                 if (op_ret == -1) {
                         file->op_ret = op_ret;
                         file->op_errno = op_errno;
+                } else if (postbuf) {
+                        file->stbuf = *postbuf;
+                        file->have_stbuf = 1;
                 }
                 fd = file->fd;
         }
         UNLOCK (&file->lock);
 
+        if (released) {
+                wb_global_update (this->private, 0, released);
+        }
+
         ret = wb_process_queue (frame, file);  
         if ((ret == -1) && (errno == ENOMEM)) {
                 LOCK (&file->lock);
@@ -420,6 +466,7 @@ wb_sync (call_frame_t *frame, wb_file_t *file, list_head_t *winds)
         struct iovec   *vector = NULL;
         ssize_t         current_size = 0, bytes = 0;
         size_t          bytecount = 0;
+        off_t           boundary = 0;
         wb_conf_t      *conf = NULL;
         fd_t           *fd   = NULL;
         int32_t         op_errno = -1;
@@ -478,6 +525,11 @@ wb_sync (call_frame_t *frame, wb_file_t *file, list_head_t *winds)
             
                         first_request = request;
                         current_size = 0;
+
+                        /* a write is not sent across an extent boundary */
+                        boundary = (request->stub->args.writev.off
+                                    / conf->extent_size + 1)
+                                * conf->extent_size;
                 }
 
                 count += request->stub->args.writev.count;
@@ -507,7 +559,9 @@ wb_sync (call_frame_t *frame, wb_file_t *file, list_head_t *winds)
                     || ((count + next->stub->args.writev.count)
                         > MAX_VECTOR_COUNT)
                     || ((current_size + next->write_size)
-                        > conf->aggregate_size))
+                        > conf->extent_size)
+                    || ((next->stub->args.writev.off + next->write_size)
+                        > boundary))
                 {
                         sync_frame = copy_frame (frame);  
                         if (sync_frame == NULL) {
@@ -1471,7 +1525,7 @@ __wb_mark_wind_all (wb_file_t *file, list_head_t *list, list_head_t *winds)
 
                         if ((file->flags & O_APPEND)
                             && (((size + request->write_size)
-                                 > conf->aggregate_size)
+                                 > conf->extent_size)
                                 || ((count + request->stub->args.writev.count)
                                     > MAX_VECTOR_COUNT))) {
                                 break;
@@ -1581,6 +1635,7 @@ size_t
 __wb_mark_unwind_till (list_head_t *list, list_head_t *unwinds, size_t size)
 {
         size_t        written_behind = 0;
+        size_t        charge         = 0;
         wb_request_t *request        = NULL;
         wb_file_t    *file           = NULL;
 
@@ -1606,6 +1661,7 @@ __wb_mark_unwind_till (list_head_t *list, list_head_t *unwinds, size_t size)
                                 
                                 if (!request->flags.write_request.got_reply) {
                                         file->window_current += request->write_size;
+                                        charge += request->write_size;
                                 }
                         }
                 } else {
@@ -1613,16 +1669,30 @@ __wb_mark_unwind_till (list_head_t *list, list_head_t *unwinds, size_t size)
                 }
         }
 
+        if (charge) {
+                wb_global_update (file->this->private, charge, 0);
+        }
+
 out:
         return written_behind;
 }
 
 
-void
+/*
+ * writes are acknowledged while both the window of the file and the cache
+ * shared by all the files have room. returns 1 when the shared cache is
+ * full and the file has to send what it holds, so that its own replies
+ * bring it back here. a file with nothing cached is always let through
+ * one write.
+ */
+char
 __wb_mark_unwinds (list_head_t *list, list_head_t *unwinds)
 {
         wb_request_t *request        = NULL;
         wb_file_t    *file           = NULL;
+        wb_conf_t    *conf           = NULL;
+        size_t        global_room    = 0;
+        char          starved        = 0;
 
         if (list_empty (list)) {
                 goto out;
@@ -1630,14 +1700,32 @@ __wb_mark_unwinds (list_head_t *list, list_head_t *unwinds)
 
         request = list_entry (list->next, typeof (*request), list);
         file = request->file;
+        conf = file->this->private;
 
-        if (file->window_current <= file->window_conf) {
-                __wb_mark_unwind_till (list, unwinds,
-                                       file->window_conf - file->window_current);
+        LOCK (&conf->lock);
+        {
+                if (conf->global_current < conf->global_size) {
+                        global_room = conf->global_size
+                                - conf->global_current;
+                }
         }
+        UNLOCK (&conf->lock);
+
+        if (file->window_current > file->window_conf) {
+                goto out;
+        }
+
+        if ((global_room == 0) && (file->window_current > 0)) {
+                starved = 1;
+                goto out;
+        }
+
+        __wb_mark_unwind_till (list, unwinds,
+                               min (file->window_conf - file->window_current,
+                                    global_room));
 
 out:
-        return;
+        return starved;
 }
 
 
@@ -1764,18 +1852,99 @@ out:
 }
 
 
+/*
+ * a cached write can go after the bytes [@start, @end) of a holder if it
+ * starts inside or right at the end of them, and does not end past the
+ * extent the holder starts in.
+ */
+static int
+__wb_can_extend (off_t start, off_t end, wb_request_t *request,
+                 size_t extent_size)
+{
+        off_t limit = 0;
+        off_t offset = 0;
+
+        if ((request->stub == NULL)
+            || (request->stub->fop != GF_FOP_WRITE)
+            || request->flags.write_request.stack_wound
+            || !request->flags.write_request.write_behind) {
+                return 0;
+        }
+
+        limit = max ((start / extent_size + 1) * extent_size, end);
+
+        offset = request->stub->args.writev.off;
+
+        /* the server decides where appending writes go, they can only be
+           put next to each other */
+        if ((request->file->flags & O_APPEND) && (offset != end)) {
+                return 0;
+        }
+
+        return ((offset >= start) && (offset <= end)
+                && ((offset + request->write_size) <= limit));
+}
+
+
+static int
+__wb_can_absorb (wb_request_t *holder, wb_request_t *request,
+                 size_t extent_size)
+{
+        off_t start = 0;
+
+        start = holder->stub->args.writev.off;
+
+        return __wb_can_extend (start, start + holder->write_size, request,
+                                extent_size);
+}
+
+
+/* bytes from @holder to the end of the writes queued after it, which can
+   all be packed into it one after the other, up to the end of its extent */
+static size_t
+__wb_run_size (wb_request_t *holder, list_head_t *requests,
+               size_t extent_size)
+{
+        wb_request_t *request = NULL;
+        off_t         start = 0, end = 0;
+
+        start = holder->stub->args.writev.off;
+        end   = start + holder->write_size;
+
+        for (request = list_entry (holder->list.next, typeof (*request), list);
+             &request->list != requests;
+             request = list_entry (request->list.next, typeof (*request),
+                                   list)) {
+                if (!__wb_can_extend (start, end, request, extent_size)) {
+                        break;
+                }
+
+                end = max (end, (off_t)(request->stub->args.writev.off
+                                        + request->write_size));
+        }
+
+        return end - start;
+}
+
+
 inline int
-__wb_copy_into_holder (wb_request_t *holder, wb_request_t *request)
+__wb_copy_into_holder (wb_request_t *holder, wb_request_t *request,
+                       size_t room)
 {
         char          *ptr    = NULL;
         struct iobuf  *iobuf  = NULL;
         struct iobref *iobref = NULL;
+        wb_file_t     *file   = NULL;
+        off_t          end    = 0, request_end = 0;
+        size_t         grown  = 0, overlap = 0;
         int            ret    = -1;
 
+        file = request->file;
+
         if (holder->flags.write_request.virgin) {
-                iobuf = iobuf_get (request->file->this->ctx->iobuf_pool);
+                iobuf = iobuf_get2 (file->this->ctx->iobuf_pool, room);
                 if (iobuf == NULL) {
-                        gf_log (request->file->this->name, GF_LOG_ERROR,
+                        gf_log (file->this->name, GF_LOG_ERROR,
                                 "out of memory");
                         goto out;
                 }
@@ -1783,7 +1952,7 @@ __wb_copy_into_holder (wb_request_t *holder, wb_request_t *request)
                 iobref = iobref_new ();
                 if (iobref == NULL) {
                         iobuf_unref (iobuf);
-                        gf_log (request->file->this->name, GF_LOG_ERROR,
+                        gf_log (file->this->name, GF_LOG_ERROR,
                                 "out of memory");
                         goto out;
                 }
@@ -1792,7 +1961,7 @@ __wb_copy_into_holder (wb_request_t *holder, wb_request_t *request)
                 if (ret != 0) {
                         iobuf_unref (iobuf);
                         iobref_unref (iobref);
-                        gf_log (request->file->this->name, GF_LOG_DEBUG,
+                        gf_log (file->this->name, GF_LOG_DEBUG,
                                 "cannot add iobuf (%p) into iobref (%p)",
                                 iobuf, iobref);
                         goto out;
@@ -1801,6 +1970,10 @@ __wb_copy_into_holder (wb_request_t *holder, wb_request_t *request)
                 iov_unload (iobuf->ptr, holder->stub->args.writev.vector,
                             holder->stub->args.writev.count);
                 holder->stub->args.writev.vector[0].iov_base = iobuf->ptr;
+                holder->stub->args.writev.vector[0].iov_len
+                        = holder->write_size;
+                holder->stub->args.writev.count = 1;
+                holder->holder_size = iobuf_size (iobuf);
                                                                           
                 iobref_unref (holder->stub->args.writev.iobref);
                 holder->stub->args.writev.iobref = iobref;
@@ -1810,17 +1983,35 @@ __wb_copy_into_holder (wb_request_t *holder, wb_request_t *request)
                 holder->flags.write_request.virgin = 0;
         }
 
-        ptr = holder->stub->args.writev.vector[0].iov_base + holder->write_size;
+        end = holder->stub->args.writev.off + holder->write_size;
+        request_end = request->stub->args.writev.off + request->write_size;
+
+        /* the later write wins where the two overlap */
+        ptr = holder->stub->args.writev.vector[0].iov_base
+                + (request->stub->args.writev.off
+                   - holder->stub->args.writev.off);
 
         iov_unload (ptr,
                     request->stub->args.writev.vector,
                     request->stub->args.writev.count);
 
-        holder->stub->args.writev.vector[0].iov_len += request->write_size;
-        holder->write_size += request->write_size;
+        if (request_end > end) {
+                grown = request_end - end;
+        }
+        overlap = request->write_size - grown;
+
+        holder->stub->args.writev.vector[0].iov_len += grown;
+        holder->write_size += grown;
+
+        /* the overwritten bytes are not going to be sent, nor waited for */
+        if (overlap) {
+                file->window_current -= overlap;
+                file->aggregate_current -= overlap;
+                wb_global_update (file->this->private, 0, overlap);
+        }
 
         request->flags.write_request.stack_wound = 1;
-        list_move_tail (&request->list, &request->file->passive_requests);
+        list_move_tail (&request->list, &file->passive_requests);
 
         ret = 0;
 out:
@@ -1828,14 +2019,19 @@ out:
 }
 
 
-/* this procedure assumes that write requests have only one vector to write */
+/*
+ * packs the cached writes queued after each other, which are adjacent to
+ * or overlap each other, into a single buffer each ("holder"), up to the
+ * end of the extent the holder starts in. the buffer of a holder is sized
+ * to the writes it can take when it is first used.
+ */
 void
-__wb_collapse_write_bufs (list_head_t *requests, size_t page_size)
+__wb_collapse_write_bufs (list_head_t *requests, size_t extent_size)
 {
-        off_t         offset_expected = 0;
-        size_t        space_left      = 0;
-        wb_request_t *request         = NULL, *tmp = NULL, *holder = NULL;
-        int           ret             = 0;
+        off_t         request_end = 0;
+        size_t        room        = 0;
+        wb_request_t *request     = NULL, *tmp = NULL, *holder = NULL;
+        int           ret         = 0;
 
         list_for_each_entry_safe (request, tmp, requests, list) {
                 if ((request->stub == NULL)
@@ -1851,26 +2047,32 @@ __wb_collapse_write_bufs (list_head_t *requests, size_t page_size)
                                 continue;
                         }
 
-                        offset_expected = holder->stub->args.writev.off
-                                + holder->write_size;
-
-                        if (request->stub->args.writev.off != offset_expected) {
+                        if (!__wb_can_absorb (holder, request, extent_size)) {
                                 holder = request;
                                 continue;
                         }
 
-                        space_left = page_size - holder->write_size;
-
-                        if (space_left >= request->write_size) {
-                                ret = __wb_copy_into_holder (holder, request);
-                                if (ret != 0) {
-                                        break;
-                                }
-                                
-                                __wb_request_unref (request);
+                        if (holder->flags.write_request.virgin) {
+                                room = __wb_run_size (holder, requests,
+                                                      extent_size);
                         } else {
+                                room = holder->holder_size;
+                        }
+
+                        request_end = request->stub->args.writev.off
+                                + request->write_size;
+                        if ((request_end - holder->stub->args.writev.off)
+                            > room) {
                                 holder = request;
+                                continue;
+                        }
+
+                        ret = __wb_copy_into_holder (holder, request, room);
+                        if (ret != 0) {
+                                break;
                         }
+                                
+                        __wb_request_unref (request);
                 } else { 
                         break;
                 }
@@ -1887,6 +2089,7 @@ wb_process_queue (call_frame_t *frame, wb_file_t *file)
         size_t      size = 0;
         wb_conf_t  *conf = NULL;
         uint32_t    count = 0;
+        char        starved = 0;
         int32_t     ret = -1; 
 
         INIT_LIST_HEAD (&winds);
@@ -1904,21 +2107,20 @@ wb_process_queue (call_frame_t *frame, wb_file_t *file)
         {
                 /* 
                  * make sure requests are marked for unwinding and adjacent
-                 * continguous write buffers (each of size less than that of
-                 * an iobuf) are packed properly so that iobufs are filled to
-                 * their maximum capacity, before calling __wb_mark_winds.
+                 * or overlapping write buffers are packed into extents
+                 * before calling __wb_mark_winds.
                  */
-                __wb_mark_unwinds (&file->request, &unwinds);
+                starved = __wb_mark_unwinds (&file->request, &unwinds);
 
-                __wb_collapse_write_bufs (&file->request,
-                                          file->this->ctx->page_size);
+                __wb_collapse_write_bufs (&file->request, conf->extent_size);
 
                 count = __wb_get_other_requests (&file->request,
                                                  &other_requests);
 
                 if (count == 0) {
                         __wb_mark_winds (&file->request, &winds, size,
-                                         conf->enable_trickling_writes);
+                                         (conf->enable_trickling_writes
+                                          || starved));
                 }
 
         }
@@ -2069,15 +2271,252 @@ unwind:
 }
 
 
+/* copies @size bytes from @offset into the data of @vector */
+static void
+wb_iov_copy_range (char *buf, struct iovec *vector, int count, off_t offset,
+                   size_t size)
+{
+        size_t copy = 0;
+        int    i    = 0;
+
+        for (i = 0; (i < count) && size; i++) {
+                if (offset >= vector[i].iov_len) {
+                        offset -= vector[i].iov_len;
+                        continue;
+                }
+
+                copy = min (size, vector[i].iov_len - offset);
+                memcpy (buf, vector[i].iov_base + offset, copy);
+
+                buf += copy;
+                size -= copy;
+                offset = 0;
+        }
+}
+
+
+/* sorts the ranges and merges the ones that touch, returns bytes covered */
+static size_t
+wb_ranges_merge (wb_range_t *ranges, int32_t *count)
+{
+        wb_range_t range   = {0, };
+        size_t     covered = 0;
+        int32_t    i = 0, j = 0;
+
+        for (i = 1; i < *count; i++) {
+                range = ranges[i];
+                for (j = i; (j > 0) && (ranges[j - 1].start > range.start);
+                     j--) {
+                        ranges[j] = ranges[j - 1];
+                }
+                ranges[j] = range;
+        }
+
+        for (i = 0, j = 0; i < *count; i++) {
+                if ((j > 0) && (ranges[i].start <= ranges[j - 1].end)) {
+                        ranges[j - 1].end = max (ranges[j - 1].end,
+                                                 ranges[i].end);
+                        continue;
+                }
+                ranges[j++] = ranges[i];
+        }
+        *count = j;
+
+        for (i = 0; i < *count; i++) {
+                covered += ranges[i].end - ranges[i].start;
+        }
+
+        return covered;
+}
+
+
+/*
+ * copies what the cached writes have of the range a read asks for into
+ * @local. the writes are walked in the order they came in, so where they
+ * overlap the later one wins. returns the bytes found, 0 if none, or -1 if
+ * the read has to wait behind the queue after all: another fop is queued
+ * in between, the file is appended to, or the writes are too scattered.
+ */
+static ssize_t
+__wb_read_cached (wb_file_t *file, wb_local_t *local, size_t size,
+                  off_t offset)
+{
+        wb_request_t  *request = NULL;
+        struct iobuf  *iobuf   = NULL;
+        wb_range_t     ranges[WB_READ_MAX_RANGES];
+        int32_t        count   = 0;
+        off_t          start   = 0, end = 0;
+        ssize_t        covered = 0;
+
+        if (file->flags & O_APPEND) {
+                return -1;
+        }
+
+        list_for_each_entry (request, &file->request, list) {
+                if (request->stub == NULL) {
+                        continue;
+                }
+
+                if (request->stub->fop != GF_FOP_WRITE) {
+                        return -1;
+                }
+
+                start = max (offset, request->stub->args.writev.off);
+                end   = min ((off_t)(offset + size),
+                             (off_t)(request->stub->args.writev.off
+                                     + request->write_size));
+                if (start >= end) {
+                        continue;
+                }
+
+                if (count == WB_READ_MAX_RANGES) {
+                        return -1;
+                }
+
+                ranges[count].start = start;
+                ranges[count].end   = end;
+                count++;
+        }
+
+        if (count == 0) {
+                return 0;
+        }
+
+        local->ranges = GF_CALLOC (count, sizeof (*local->ranges),
+                                   gf_wb_mt_wb_range_t);
+        if (local->ranges == NULL) {
+                goto nomem;
+        }
+
+        local->cached_iobref = iobref_new ();
+        if (local->cached_iobref == NULL) {
+                goto nomem;
+        }
+
+        iobuf = iobuf_get2 (file->this->ctx->iobuf_pool, size);
+        if (iobuf == NULL) {
+                goto nomem;
+        }
+
+        iobref_add (local->cached_iobref, iobuf);
+        iobuf_unref (iobuf);
+
+        local->cached = iobuf->ptr;
+
+        list_for_each_entry (request, &file->request, list) {
+                if (request->stub == NULL) {
+                        continue;
+                }
+
+                start = max (offset, request->stub->args.writev.off);
+                end   = min ((off_t)(offset + size),
+                             (off_t)(request->stub->args.writev.off
+                                     + request->write_size));
+                if (start >= end) {
+                        continue;
+                }
+
+                wb_iov_copy_range (local->cached + (start - offset),
+                                   request->stub->args.writev.vector,
+                                   request->stub->args.writev.count,
+                                   start - request->stub->args.writev.off,
+                                   end - start);
+        }
+
+        memcpy (local->ranges, ranges, count * sizeof (*ranges));
+        local->range_count = count;
+        covered = wb_ranges_merge (local->ranges, &local->range_count);
+
+        return covered;
+
+nomem:
+        gf_log (file->this->name, GF_LOG_DEBUG,
+                "out of memory, read is queued behind the writes instead");
+
+        if (local->cached_iobref) {
+                iobref_unref (local->cached_iobref);
+                local->cached_iobref = NULL;
+        }
+        GF_FREE (local->ranges);
+        local->ranges = NULL;
+        local->cached = NULL;
+
+        return -1;
+}
+
+
+/* the server's data with what the cache had of the range laid over it, in
+   a buffer of its own. the cached writes may extend the file past where
+   the server ended the read, the gap in between reads as zeroes. */
+static int32_t
+wb_read_merge (xlator_t *this, wb_local_t *local, int32_t op_ret,
+               struct iovec *vector, int32_t count, struct iatt *stbuf,
+               struct iovec *merged, struct iobref **iobref)
+{
+        struct iobuf *iobuf = NULL;
+        size_t        total = op_ret;
+        int32_t       i     = 0;
+        off_t         from  = 0;
+
+        for (i = 0; i < local->range_count; i++) {
+                total = max (total,
+                             (size_t)(local->ranges[i].end - local->offset));
+        }
+
+        *iobref = iobref_new ();
+        if (*iobref == NULL) {
+                goto nomem;
+        }
+
+        iobuf = iobuf_get2 (this->ctx->iobuf_pool, total);
+        if (iobuf == NULL) {
+                iobref_unref (*iobref);
+                *iobref = NULL;
+                goto nomem;
+        }
+
+        iobref_add (*iobref, iobuf);
+        iobuf_unref (iobuf);
+
+        iov_unload (iobuf->ptr, vector, count);
+        if (total > op_ret) {
+                memset (iobuf->ptr + op_ret, 0, total - op_ret);
+        }
+
+        for (i = 0; i < local->range_count; i++) {
+                from = local->ranges[i].start - local->offset;
+                memcpy (iobuf->ptr + from, local->cached + from,
+                        local->ranges[i].end - local->ranges[i].start);
+        }
+
+        merged->iov_base = iobuf->ptr;
+        merged->iov_len  = total;
+
+        if (stbuf && (stbuf->ia_size < (local->offset + total))) {
+                stbuf->ia_size = local->offset + total;
+        }
+
+        return total;
+
+nomem:
+        gf_log (this->name, GF_LOG_ERROR, "out of memory");
+        return -1;
+}
+
+
 int32_t
 wb_readv_cbk (call_frame_t *frame, void *cookie, xlator_t *this, int32_t op_ret,
               int32_t op_errno, struct iovec *vector, int32_t count,
               struct iatt *stbuf, struct iobref *iobref)
 {
-        wb_local_t   *local = NULL;
-        wb_file_t    *file = NULL;
-        wb_request_t *request = NULL;
-        int32_t       ret = 0;
+        wb_local_t    *local = NULL;
+        wb_file_t     *file = NULL;
+        wb_request_t  *request = NULL;
+        struct iobref *cached_iobref = NULL;
+        struct iobref *merged_iobref = NULL;
+        struct iovec   merged = {0, };
+        wb_range_t    *ranges = NULL;
+        int32_t        ret = 0;
 
         local = frame->local;
         file = local->file;
@@ -2093,8 +2532,42 @@ wb_readv_cbk (call_frame_t *frame, void *cookie, xlator_t *this, int32_t op_ret,
                 }
         }
 
+        if ((file != NULL) && (op_ret >= 0) && stbuf) {
+                LOCK (&file->lock);
+                {
+                        file->stbuf = *stbuf;
+                        file->have_stbuf = 1;
+                }
+                UNLOCK (&file->lock);
+        }
+
+        cached_iobref = local->cached_iobref;
+        ranges = local->ranges;
+
+        if (cached_iobref && (op_ret >= 0)) {
+                op_ret = wb_read_merge (this, local, op_ret, vector, count,
+                                        stbuf, &merged, &merged_iobref);
+                if (op_ret == -1) {
+                        op_errno = ENOMEM;
+                } else {
+                        vector = &merged;
+                        count = 1;
+                        iobref = merged_iobref;
+                }
+        }
+
         STACK_UNWIND_STRICT (readv, frame, op_ret, op_errno, vector, count, stbuf, iobref);
 
+        if (merged_iobref) {
+                iobref_unref (merged_iobref);
+        }
+
+        if (cached_iobref) {
+                iobref_unref (cached_iobref);
+        }
+
+        GF_FREE (ranges);
+
         return 0;
 }
 
@@ -2113,16 +2586,28 @@ wb_readv_helper (call_frame_t *frame, xlator_t *this, fd_t *fd, size_t size,
 }
 
 
+/*
+ * a read is answered from the cached writes when they cover all of it and
+ * a reply from the server has given us the file's attributes. otherwise it
+ * is sent right away, and the part the cache has is laid over the reply.
+ * neither waits for the cached writes to reach the server, nor makes them
+ * go.
+ */
 int32_t
 wb_readv (call_frame_t *frame, xlator_t *this, fd_t *fd, size_t size,
           off_t offset)
 {
-        wb_file_t    *file = NULL;
-        wb_local_t   *local = NULL;
-	uint64_t      tmp_file = 0;
-        call_stub_t  *stub = NULL;
-        int32_t       ret = -1;
-        wb_request_t *request = NULL;
+        wb_file_t     *file = NULL;
+        wb_local_t    *local = NULL;
+	uint64_t       tmp_file = 0;
+        call_stub_t   *stub = NULL;
+        int32_t        ret = -1;
+        wb_request_t  *request = NULL;
+        ssize_t        cached = -1;
+        struct iatt    stbuf = {0, };
+        struct iovec   vector = {0, };
+        struct iobref *iobref = NULL;
+        char           hit = 0;
 
         if ((!IA_ISDIR (fd->inode->ia_type))
             && fd_ctx_get (fd, this, &tmp_file)) {
@@ -2146,9 +2631,48 @@ wb_readv (call_frame_t *frame, xlator_t *this, fd_t *fd, size_t size,
         }
 
         local->file = file;
+        local->offset = offset;
+        local->size = size;
 
         frame->local = local;
-        if (file) {
+
+        if (file && size) {
+                LOCK (&file->lock);
+                {
+                        cached = __wb_read_cached (file, local, size, offset);
+
+                        if ((cached == size) && file->have_stbuf) {
+                                file->read_hits++;
+                                stbuf = file->stbuf;
+                                hit = 1;
+                        } else if (cached > 0) {
+                                file->read_merges++;
+                        }
+                }
+                UNLOCK (&file->lock);
+        }
+
+        if (hit) {
+                if (stbuf.ia_size < (offset + size)) {
+                        stbuf.ia_size = offset + size;
+                }
+
+                vector.iov_base = local->cached;
+                vector.iov_len  = size;
+
+                iobref = local->cached_iobref;
+                local->cached_iobref = NULL;
+                GF_FREE (local->ranges);
+                local->ranges = NULL;
+
+                STACK_UNWIND_STRICT (readv, frame, size, 0, &vector, 1,
+                                     &stbuf, iobref);
+
+                iobref_unref (iobref);
+                return 0;
+        }
+
+        if (file && (cached == -1)) {
                 stub = fop_readv_stub (frame, wb_readv_helper, fd, size,
                                        offset);
                 if (stub == NULL) {
@@ -2553,6 +3077,16 @@ wb_priv_dump (xlator_t *this)
         gf_proc_dump_write (key, "%d", conf->aggregate_size);
         gf_proc_dump_build_key (key, key_prefix, "window_size");
         gf_proc_dump_write (key, "%d", conf->window_size);
+        gf_proc_dump_build_key (key, key_prefix, "extent_size");
+        gf_proc_dump_write (key, "%"PRIu64, conf->extent_size);
+        gf_proc_dump_build_key (key, key_prefix, "global_cache_size");
+        gf_proc_dump_write (key, "%"PRIu64, conf->global_size);
+        gf_proc_dump_build_key (key, key_prefix, "global_cache_current");
+        LOCK (&conf->lock);
+        {
+                gf_proc_dump_write (key, "%"PRIu64, conf->global_current);
+        }
+        UNLOCK (&conf->lock);
         gf_proc_dump_build_key (key, key_prefix, "disable_till");
         gf_proc_dump_write (key, "%d", conf->disable_till);
         gf_proc_dump_build_key (key, key_prefix, "enable_O_SYNC");
@@ -2681,6 +3215,12 @@ wb_file_dump (xlator_t *this, fd_t *fd)
         gf_proc_dump_build_key (key, key_prefix, "aggregate_current");
         gf_proc_dump_write (key, "%"GF_PRI_SIZET, file->aggregate_current);
 
+        gf_proc_dump_build_key (key, key_prefix, "read_hits");
+        gf_proc_dump_write (key, "%"PRIu64, file->read_hits);
+
+        gf_proc_dump_build_key (key, key_prefix, "read_merges");
+        gf_proc_dump_write (key, "%"PRIu64, file->read_merges);
+
         gf_proc_dump_build_key (key, key_prefix, "refcount");
         gf_proc_dump_write (key, "%d", file->refcount);
 
@@ -2727,11 +3267,99 @@ mem_acct_init (xlator_t *this)
         return ret;
 }
 
+/* the smallest write payload the bricks under @xl take in one request,
+   as their protocol/client translators carry it */
+static uint64_t
+wb_transport_write_limit (xlator_t *xl)
+{
+        xlator_list_t *trav = NULL;
+        char          *str = NULL;
+        uint64_t       limit = GF_MAX_WRITE_SIZE_MAX;
+        uint64_t       size = 0;
+
+        if (xl->type && (strcmp (xl->type, "protocol/client") == 0)) {
+                size = GF_MAX_WRITE_SIZE_DEFAULT;
+                if ((dict_get_str (xl->options, GF_MAX_WRITE_SIZE_KEY,
+                                   &str) == 0)
+                    && (gf_string2bytesize (str, &size) != 0)) {
+                        size = GF_MAX_WRITE_SIZE_DEFAULT;
+                }
+                return size;
+        }
+
+        for (trav = xl->children; trav; trav = trav->next) {
+                size = wb_transport_write_limit (trav->xlator);
+                if (size < limit) {
+                        limit = size;
+                }
+        }
+
+        return limit;
+}
+
+
+static int
+wb_size_options (xlator_t *this, dict_t *options, uint64_t *extent_size,
+                 uint64_t *global_size, char clamp)
+{
+        char          *str = NULL;
+        uint64_t       limit = 0;
+        gf_loglevel_t  level = GF_LOG_ERROR;
+        int            ret = 0;
+
+        *extent_size = WB_EXTENT_SIZE;
+        ret = dict_get_str (options, "extent-size", &str);
+        if (ret == 0) {
+                ret = gf_string2bytesize (str, extent_size);
+                if ((ret != 0) || (*extent_size < (4 * GF_UNIT_KB))
+                    || (*extent_size > GF_MAX_WRITE_SIZE_MAX)) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "invalid \"option extent-size %s\", has to "
+                                "be between 4KB and 16MB", str);
+                        return -1;
+                }
+        }
+
+        /* a packed extent goes out as one write, which the bricks drop
+           the connection over if it is larger than they take */
+        limit = wb_transport_write_limit (this);
+        if (*extent_size > limit) {
+                level = clamp ? GF_LOG_WARNING : GF_LOG_ERROR;
+                gf_log (this->name, level,
+                        "extent-size %"PRIu64" is larger than the "
+                        "%"PRIu64" bytes the bricks take in one write (see "
+                        "network.max-write-size)%s", *extent_size, limit,
+                        clamp ? ", using that" : "");
+                if (!clamp) {
+                        return -1;
+                }
+                *extent_size = limit;
+        }
+
+        *global_size = WB_GLOBAL_CACHE_SIZE;
+        ret = dict_get_str (options, "global-cache-size", &str);
+        if (ret == 0) {
+                ret = gf_string2bytesize (str, global_size);
+                if ((ret != 0) || (*global_size < (1 * GF_UNIT_MB))
+                    || (*global_size > (8 * GF_UNIT_GB))) {
+                        gf_log (this->name, GF_LOG_ERROR,
+                                "invalid \"option global-cache-size %s\", "
+                                "has to be between 1MB and 8GB", str);
+                        return -1;
+                }
+        }
+
+        return 0;
+}
+
+
 int
 validate_options (xlator_t *this, dict_t *options, char **op_errstr)
 {
         char         *str=NULL;
         uint64_t     window_size;
+        uint64_t     extent_size;
+        uint64_t     global_size;
         gf_boolean_t flush_behind;
 
         int          ret = 0;
@@ -2786,6 +3414,15 @@ validate_options (xlator_t *this, dict_t *options, char **op_errstr)
                         goto out;
                 }
         }
+
+        ret = wb_size_options (this, options, &extent_size, &global_size,
+                               0);
+        if (ret != 0) {
+                *op_errstr = gf_strdup ("Error, invalid extent-size or "
+                                        "global-cache-size, or extent-size "
+                                        "above network.max-write-size");
+                goto out;
+        }
         ret =0;
 out:
                 return ret;
@@ -2797,6 +3434,8 @@ reconfigure (xlator_t *this, dict_t *options)
 {
 	char	     *str=NULL;
 	uint64_t     window_size;
+	uint64_t     extent_size;
+	uint64_t     global_size;
 	wb_conf_t    *conf = NULL;
 	int	     ret = 0;
 
@@ -2861,7 +3500,18 @@ reconfigure (xlator_t *this, dict_t *options)
                                 "disabling flush-behind");
         }
 
-                
+        ret = wb_size_options (this, options, &extent_size, &global_size,
+                               1);
+        if (ret == 0) {
+                conf->extent_size = extent_size;
+
+                LOCK (&conf->lock);
+                {
+                        conf->global_size = global_size;
+                }
+                UNLOCK (&conf->lock);
+        }
+
 out:
 	return 0;
 
@@ -2999,6 +3649,24 @@ init (xlator_t *this)
                 }
         }
 
+        /* configure 'option extent-size <size>' and
+           'option global-cache-size <size>' */
+        ret = wb_size_options (this, options, &conf->extent_size,
+                               &conf->global_size, 1);
+        if (ret != 0) {
+                GF_FREE (conf);
+                return -1;
+        }
+
+        if (conf->global_size < conf->window_size) {
+                gf_log (this->name, GF_LOG_WARNING,
+                        "global-cache-size(%"PRIu64") is less than "
+                        "window-size(%"PRIu64"), a single file can not fill "
+                        "its window", conf->global_size, conf->window_size);
+        }
+
+        LOCK_INIT (&conf->lock);
+
         this->private = conf;
         return 0;
 }
@@ -3012,6 +3680,7 @@ fini (xlator_t *this)
         if (!conf)
                 return;
         this->private = NULL;
+        LOCK_DESTROY (&conf->lock);
         GF_FREE (conf);
         return;
 }
@@ -3061,5 +3730,23 @@ struct volume_options options[] = {
         { .key = {"enable-trickling-writes"},
           .type = GF_OPTION_TYPE_BOOL,
         },
+        { .key  = {"extent-size"},
+          .type = GF_OPTION_TYPE_SIZET,
+          .min  = 4 * GF_UNIT_KB,
+          .max  = GF_MAX_WRITE_SIZE_MAX,
+          .description = "Cached writes are packed into extents of up to "
+                         "this size, which never cross a multiple of it. "
+                         "Set it to the stripe block-size on striped volumes. "
+                         "It can not be larger than the write payload the "
+                         "bricks take (network.max-write-size, 1MB by "
+                         "default)"
+        },
+        { .key  = {"global-cache-size"},
+          .type = GF_OPTION_TYPE_SIZET,
+          .min  = 1 * GF_UNIT_MB,
+          .max  = 8 * GF_UNIT_GB,
+          .description = "Bytes written behind and not yet acknowledged by "
+                         "the server, across all the open files"
+        },
         { .key = {NULL} },
 };
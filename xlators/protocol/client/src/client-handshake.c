@@ -40,6 +40,7 @@ int client_ping_cbk (struct rpc_req *req, struct iovec *iov, int count,
 
 /* Handshake */
 
+/* Every connection (lane) is pinged on its own, @data is the lane. */
 void
 rpc_client_ping_timer_expired (void *data)
 {
@@ -52,16 +53,17 @@ rpc_client_ping_timer_expired (void *data)
         struct rpc_clnt         *clnt               = NULL;
         xlator_t                *this               = NULL;
         clnt_conf_t             *conf               = NULL;
+        clnt_lane_t             *lane               = NULL;
 
-        this = data;
-
-        if (!this || !this->private) {
+        lane = data;
+        if (!lane || !lane->this || !lane->this->private) {
                 goto out;
         }
 
+        this = lane->this;
         conf = this->private;
 
-        clnt = conf->rpc;
+        clnt = lane->rpc;
         if (!clnt)
                 goto out;
 
@@ -95,7 +97,7 @@ rpc_client_ping_timer_expired (void *data)
                         conn->ping_timer =
                                 gf_timer_call_after (this->ctx, timeout,
                                                      rpc_client_ping_timer_expired,
-                                                     (void *) this);
+                                                     (void *) lane);
                         if (conn->ping_timer == NULL)
                                 gf_log (trans->name, GF_LOG_DEBUG,
                                         "unable to setup timer");
@@ -127,21 +129,23 @@ client_start_ping (void *data)
 {
         xlator_t                *this        = NULL;
         clnt_conf_t             *conf        = NULL;
+        clnt_lane_t             *lane        = NULL;
         rpc_clnt_connection_t   *conn        = NULL;
         int32_t                  ret         = -1;
         struct timeval           timeout     = {0, };
         call_frame_t            *frame       = NULL;
         int                      frame_count = 0;
 
-        this = data;
-        if (!this || !this->private)
+        lane = data;
+        if (!lane || !lane->this || !lane->this->private)
                 goto fail;
 
-        conf  = this->private;
-        if (!conf->rpc)
+        this = lane->this;
+        conf = this->private;
+        if (!lane->rpc)
                 goto fail;
 
-        conn = &conf->rpc->conn;
+        conn = &lane->rpc->conn;
 
         if (conf->opt.ping_timeout == 0)
                 return;
@@ -180,7 +184,7 @@ client_start_ping (void *data)
                 conn->ping_timer =
                         gf_timer_call_after (this->ctx, timeout,
                                              rpc_client_ping_timer_expired,
-                                             (void *) this);
+                                             (void *) lane);
 
                 if (conn->ping_timer == NULL) {
                         gf_log (this->name, GF_LOG_DEBUG,
@@ -195,9 +199,10 @@ client_start_ping (void *data)
         if (!frame)
                 goto fail;
 
-        ret = client_submit_request (this, NULL, frame, conf->handshake,
-                                     GF_HNDSK_PING, client_ping_cbk, NULL, NULL,
-                                     NULL, 0, NULL, 0, NULL);
+        ret = client_submit_request_on (this, lane->rpc, NULL, frame,
+                                        conf->handshake, GF_HNDSK_PING,
+                                        client_ping_cbk, NULL, NULL,
+                                        NULL, 0, NULL, 0, NULL);
         if (ret)
                 goto fail;
 
@@ -221,6 +226,7 @@ client_ping_cbk (struct rpc_req *req, struct iovec *iov, int count,
         struct timeval         timeout = {0, };
         call_frame_t          *frame   = NULL;
         clnt_conf_t           *conf    = NULL;
+        clnt_lane_t           *lane    = NULL;
 
         if (!myframe)
                 goto out;
@@ -231,7 +237,10 @@ client_ping_cbk (struct rpc_req *req, struct iovec *iov, int count,
                 goto out;
 
         conf = this->private;
-        conn = &conf->rpc->conn;
+        conn = req->conn;
+        lane = client_rpc_to_lane (conf, conn->rpc_clnt);
+        if (!lane)
+                goto out;
 
         if (req->rpc_status == -1) {
 		 if (conn->ping_timer != NULL) {
@@ -257,7 +266,7 @@ client_ping_cbk (struct rpc_req *req, struct iovec *iov, int count,
 
                 conn->ping_timer =
                         gf_timer_call_after (this->ctx, timeout,
-                                             client_start_ping, (void *)this);
+                                             client_start_ping, (void *)lane);
 
                 if (conn->ping_timer == NULL)
                         gf_log (this->name, GF_LOG_DEBUG,
@@ -755,6 +764,7 @@ client_setvolume_cbk (struct rpc_req *req, struct iovec *iov, int count, void *m
 {
         call_frame_t         *frame         = NULL;
         clnt_conf_t          *conf          = NULL;
+        clnt_lane_t          *lane          = NULL;
         xlator_t             *this          = NULL;
         dict_t               *reply         = NULL;
         xlator_list_t        *parent        = NULL;
@@ -769,6 +779,7 @@ client_setvolume_cbk (struct rpc_req *req, struct iovec *iov, int count, void *m
         frame = myframe;
         this  = frame->this;
         conf  = this->private;
+        lane  = client_rpc_to_lane (conf, req->conn->rpc_clnt);
 
         if (-1 == req->rpc_status) {
                 op_ret = -1;
@@ -814,6 +825,13 @@ client_setvolume_cbk (struct rpc_req *req, struct iovec *iov, int count, void *m
                         "failed to get 'process-uuid' from reply dict");
         }
 
+        if ((op_ret < 0) && lane && lane->index) {
+                gf_log (this->name, GF_LOG_WARNING,
+                        "SETVOLUME on connection %d failed: %s", lane->index,
+                        remote_error ? remote_error : strerror (op_errno));
+                goto out;
+        }
+
         if (op_ret < 0) {
                 gf_log (this->name, GF_LOG_ERROR,
                         "SETVOLUME on remote-host failed: %s",
@@ -857,6 +875,20 @@ client_setvolume_cbk (struct rpc_req *req, struct iovec *iov, int count, void *m
         }
         */
 
+        if (lane && lane->index) {
+                /* data lane: fds and locks are shared with the primary
+                   connection on the server, nothing to reopen */
+                gf_log (this->name, GF_LOG_DEBUG,
+                        "connection %d attached to remote volume '%s'",
+                        lane->index, remote_subvol);
+
+                rpc_clnt_set_connected (&lane->rpc->conn);
+                lane->drained  = 0;
+                lane->attached = 1;
+                op_ret = 0;
+                goto out;
+        }
+
         gf_log (this->name, GF_LOG_NORMAL,
                 "Connected to %s, attached to remote volume '%s'.",
                 conf->rpc->conn.trans->peerinfo.identifier,
@@ -867,13 +899,19 @@ client_setvolume_cbk (struct rpc_req *req, struct iovec *iov, int count, void *m
         op_ret = 0;
         conf->connecting = 0;
         conf->connected = 1;
+        conf->lanes[0].attached = 1;
 
         /* TODO: more to test */
         client_post_handshake (frame, frame->this);
 
+        client_lanes_start (this);
+
 out:
 
-        if (-1 == op_ret) {
+        if (lane && lane->index) {
+                if ((-1 == op_ret) && lane->connected)
+                        rpc_transport_disconnect (lane->rpc->conn.trans);
+        } else if (-1 == op_ret) {
                 /* Let the connection/re-connection happen in
                  * background, for now, don't hang here,
                  * tell the parents that i am all ok..
@@ -986,15 +1024,16 @@ client_setvolume (xlator_t *this, struct rpc_clnt *rpc)
         if (!fr)
                 goto fail;
 
-        ret = client_submit_request (this, &req, fr, conf->handshake,
-                                     GF_HNDSK_SETVOLUME, client_setvolume_cbk,
-                                     NULL, xdr_from_setvolume_req, NULL, 0,
-                                     NULL, 0, NULL);
+        ret = client_submit_request_on (this, rpc, &req, fr, conf->handshake,
+                                        GF_HNDSK_SETVOLUME,
+                                        client_setvolume_cbk, NULL,
+                                        xdr_from_setvolume_req, NULL, 0,
+                                        NULL, 0, NULL);
 
 fail:
         if (ret) {
                 config.remote_port = -1;
-                rpc_clnt_reconfig (conf->rpc, &config);
+                rpc_clnt_reconfig (rpc, &config);
         }
 
         if (req.dict.dict_val)
@@ -1169,10 +1208,14 @@ client_dump_version_cbk (struct rpc_req *req, struct iovec *iov, int count,
         gf_prog_detail *next  = NULL;
         call_frame_t   *frame = NULL;
         clnt_conf_t    *conf  = NULL;
+        struct rpc_clnt *rpc  = NULL;
         int             ret   = 0;
 
+        struct rpc_clnt_config config = {0, };
+
         frame = myframe;
         conf  = frame->this->private;
+        rpc   = req->conn->rpc_clnt;
 
         if (-1 == req->rpc_status) {
                 gf_log ("", 1, "some error, retry again later");
@@ -1191,6 +1234,14 @@ client_dump_version_cbk (struct rpc_req *req, struct iovec *iov, int count,
         }
 
         if (server_has_portmap (frame->this, rsp.prog) == 0) {
+                if (rpc != conf->rpc) {
+                        /* data lane reached glusterd before the primary
+                           connection learnt the brick port, reconnect */
+                        config.remote_port = conf->rpc->conn.config.remote_port;
+                        rpc_clnt_reconfig (rpc, &config);
+                        ret = -1;
+                        goto out;
+                }
                 ret = client_query_portmap (frame->this, conf->rpc);
                 goto out;
         }
@@ -1205,7 +1256,7 @@ client_dump_version_cbk (struct rpc_req *req, struct iovec *iov, int count,
                 goto out;
         }
 
-        client_setvolume (frame->this, conf->rpc);
+        client_setvolume (frame->this, rpc);
 
 out:
         /* don't use GF_FREE, buffer was allocated by libc */
@@ -1222,7 +1273,7 @@ out:
         STACK_DESTROY (frame->root);
 
         if (ret != 0)
-                rpc_transport_disconnect (conf->rpc->conn.trans);
+                rpc_transport_disconnect (rpc->conn.trans);
 
         return ret;
 }
@@ -1244,10 +1295,10 @@ client_handshake (xlator_t *this, struct rpc_clnt *rpc)
                 goto out;
 
         req.gfs_id = 0xbabe;
-        ret = client_submit_request (this, &req, frame, conf->dump,
-                                     GF_DUMP_DUMP, client_dump_version_cbk,
-                                     NULL, xdr_from_dump_req, NULL, 0, NULL, 0,
-                                     NULL);
+        ret = client_submit_request_on (this, rpc, &req, frame, conf->dump,
+                                        GF_DUMP_DUMP, client_dump_version_cbk,
+                                        NULL, xdr_from_dump_req, NULL, 0,
+                                        NULL, 0, NULL);
 
 out:
         return ret;
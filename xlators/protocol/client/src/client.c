@@ -41,6 +41,59 @@ void client_start_ping (void *data);
 int client_init_rpc (xlator_t *this);
 int client_destroy_rpc (xlator_t *this);
 
+clnt_lane_t *
+client_rpc_to_lane (clnt_conf_t *conf, struct rpc_clnt *rpc)
+{
+        int i = 0;
+
+        for (i = 0; i < conf->lane_count; i++) {
+                if (conf->lanes[i].rpc == rpc)
+                        return &conf->lanes[i];
+        }
+
+        return NULL;
+}
+
+
+/* Pick the connection for a fop on @remote_fd. Falls back to the primary
+   connection while the data lane is not (yet) attached. A lane which just
+   attached is only used once nothing is in flight on the primary
+   connection, so that fops on an fd are not overtaken by later ones sent
+   on the new lane. */
+struct rpc_clnt *
+client_lane_rpc (xlator_t *this, int64_t remote_fd)
+{
+        clnt_conf_t           *conf = NULL;
+        clnt_lane_t           *lane = NULL;
+        rpc_clnt_connection_t *conn = NULL;
+
+        conf = this->private;
+
+        if ((conf->lane_count < 2) || (remote_fd < 0))
+                return conf->rpc;
+
+        lane = &conf->lanes[1 + (remote_fd % (conf->lane_count - 1))];
+        if (!lane->attached)
+                return conf->rpc;
+
+        if (!lane->drained) {
+                conn = &conf->rpc->conn;
+                pthread_mutex_lock (&conn->lock);
+                {
+                        if (!conn->saved_frames
+                            || (conn->saved_frames->count <= 0))
+                                lane->drained = 1;
+                }
+                pthread_mutex_unlock (&conn->lock);
+
+                if (!lane->drained)
+                        return conf->rpc;
+        }
+
+        return lane->rpc;
+}
+
+
 int
 client_submit_request (xlator_t *this, void *req, call_frame_t *frame,
                        rpc_clnt_prog_t *prog, int procnum, fop_cbk_fn_t cbk,
@@ -48,6 +101,29 @@ client_submit_request (xlator_t *this, void *req, call_frame_t *frame,
                        struct iovec *rsphdr, int rsphdr_count,
                        struct iovec *rsp_payload, int rsp_payload_count,
                        struct iobref *rsp_iobref)
+{
+        clnt_conf_t *conf = NULL;
+
+        if (!this)
+                return -1;
+
+        conf = this->private;
+
+        return client_submit_request_on (this, conf->rpc, req, frame, prog,
+                                         procnum, cbk, iobref, sfunc, rsphdr,
+                                         rsphdr_count, rsp_payload,
+                                         rsp_payload_count, rsp_iobref);
+}
+
+
+int
+client_submit_request_on (xlator_t *this, struct rpc_clnt *rpc, void *req,
+                          call_frame_t *frame, rpc_clnt_prog_t *prog,
+                          int procnum, fop_cbk_fn_t cbk,
+                          struct iobref *iobref, gfs_serialize_t sfunc,
+                          struct iovec *rsphdr, int rsphdr_count,
+                          struct iovec *rsp_payload, int rsp_payload_count,
+                          struct iobref *rsp_iobref)
 {
         int            ret         = -1;
         clnt_conf_t   *conf        = NULL;
@@ -56,8 +132,9 @@ client_submit_request (xlator_t *this, void *req, call_frame_t *frame,
         int            count       = 0;
         char           start_ping  = 0;
         struct iobref *new_iobref  = NULL;
+        clnt_lane_t   *lane        = NULL;
 
-        if (!this || !prog || !frame)
+        if (!this || !rpc || !prog || !frame)
                 goto out;
 
         conf = this->private;
@@ -110,22 +187,23 @@ client_submit_request (xlator_t *this, void *req, call_frame_t *frame,
                 count = 1;
         }
         /* Send the msg */
-        ret = rpc_clnt_submit (conf->rpc, prog, procnum, cbk, &iov, count, NULL,
+        ret = rpc_clnt_submit (rpc, prog, procnum, cbk, &iov, count, NULL,
                                0, new_iobref, frame, rsphdr, rsphdr_count,
                                rsp_payload, rsp_payload_count, rsp_iobref);
 
         if (ret == 0) {
-                pthread_mutex_lock (&conf->rpc->conn.lock);
+                pthread_mutex_lock (&rpc->conn.lock);
                 {
-                        if (!conf->rpc->conn.ping_started) {
+                        if (!rpc->conn.ping_started) {
                                 start_ping = 1;
                         }
                 }
-                pthread_mutex_unlock (&conf->rpc->conn.lock);
+                pthread_mutex_unlock (&rpc->conn.lock);
         }
 
-        if (start_ping)
-                client_start_ping ((void *) this);
+        lane = client_rpc_to_lane (conf, rpc);
+        if (start_ping && lane)
+                client_start_ping ((void *) lane);
 
         ret = 0;
 out:
@@ -1593,6 +1671,13 @@ client_rpc_notify (struct rpc_clnt *rpc, void *mydata, rpc_clnt_event_t event,
         }
         case RPC_CLNT_DISCONNECT:
 
+                conf->lanes[0].attached = 0;
+
+                /* the server keeps fds and locks as long as any transport
+                   of this process-uuid is attached, drop the data lanes
+                   too so that the reopen below starts from a clean slate */
+                client_lanes_disconnect (this);
+
                 client_mark_fd_bad (this);
 
                 if (!conf->skip_notify) {
@@ -1623,6 +1708,122 @@ out:
 }
 
 
+int
+client_lane_notify (struct rpc_clnt *rpc, void *mydata, rpc_clnt_event_t event,
+                    void *data)
+{
+        clnt_lane_t *lane = NULL;
+        clnt_conf_t *conf = NULL;
+        xlator_t    *this = NULL;
+        int          ret  = 0;
+
+        lane = mydata;
+        if (!lane || !lane->this || !lane->this->private)
+                goto out;
+
+        this = lane->this;
+        conf = this->private;
+
+        switch (event) {
+        case RPC_CLNT_CONNECT:
+                lane->connected = 1;
+
+                gf_log (this->name, GF_LOG_TRACE,
+                        "got RPC_CLNT_CONNECT on connection %d", lane->index);
+
+                /* wait for the primary connection to attach first, it
+                   starts the handshake on the data lanes when it does */
+                if (!conf->lanes[0].attached)
+                        break;
+
+                ret = client_handshake (this, rpc);
+                if (ret)
+                        gf_log (this->name, GF_LOG_DEBUG,
+                                "handshake on connection %d returned %d",
+                                lane->index, ret);
+                break;
+
+        case RPC_CLNT_DISCONNECT:
+                if (lane->attached)
+                        gf_log (this->name, GF_LOG_DEBUG,
+                                "connection %d disconnected", lane->index);
+
+                lane->attached  = 0;
+                lane->drained   = 0;
+                lane->connected = 0;
+                break;
+
+        default:
+                gf_log (this->name, GF_LOG_TRACE,
+                        "got some other RPC event %d on connection %d",
+                        event, lane->index);
+                break;
+        }
+
+out:
+        return 0;
+}
+
+
+/* Called once the primary connection is attached: bring up the data lanes
+   on the port the primary connection ended up using. */
+int
+client_lanes_start (xlator_t *this)
+{
+        clnt_conf_t            *conf   = NULL;
+        clnt_lane_t            *lane   = NULL;
+        struct rpc_clnt_config  config = {0, };
+        int                     i      = 0;
+
+        conf = this->private;
+
+        config.remote_port = conf->rpc->conn.config.remote_port;
+
+        for (i = 1; i < conf->lane_count; i++) {
+                lane = &conf->lanes[i];
+                if (!lane->rpc)
+                        continue;
+
+                rpc_clnt_reconfig (lane->rpc, &config);
+
+                if (!lane->started) {
+                        lane->started = 1;
+                        rpc_clnt_start (lane->rpc);
+                        continue;
+                }
+
+                if (lane->connected && !lane->attached)
+                        client_handshake (this, lane->rpc);
+        }
+
+        return 0;
+}
+
+
+int
+client_lanes_disconnect (xlator_t *this)
+{
+        clnt_conf_t *conf = NULL;
+        clnt_lane_t *lane = NULL;
+        int          i    = 0;
+
+        conf = this->private;
+
+        for (i = 1; i < conf->lane_count; i++) {
+                lane = &conf->lanes[i];
+                if (!lane->rpc)
+                        continue;
+
+                lane->attached = 0;
+                lane->drained  = 0;
+                if (lane->connected)
+                        rpc_transport_disconnect (lane->rpc->conn.trans);
+        }
+
+        return 0;
+}
+
+
 int
 notify (xlator_t *this, int32_t event, void *data, ...)
 {
@@ -1695,6 +1896,19 @@ build_client_config (xlator_t *this, clnt_conf_t *conf)
                 conf->opt.ping_timeout = GF_UNIVERSAL_ANSWER;
         }
 
+        ret = dict_get_int32 (this->options, "connection-count",
+                              &conf->opt.connection_count);
+        if ((ret < 0) || (conf->opt.connection_count < 1)) {
+                conf->opt.connection_count = 1;
+        } else if (conf->opt.connection_count > CLIENT_MAX_CONNECTIONS) {
+                gf_log (this->name, GF_LOG_WARNING,
+                        "connection-count %d too big, using %d",
+                        conf->opt.connection_count, CLIENT_MAX_CONNECTIONS);
+                conf->opt.connection_count = CLIENT_MAX_CONNECTIONS;
+        }
+        gf_log (this->name, GF_LOG_DEBUG, "using %d connection(s)",
+                conf->opt.connection_count);
+
         ret = dict_get_str (this->options, "remote-subvolume",
                             &conf->opt.remote_subvolume);
         if (ret) {
@@ -1735,13 +1949,24 @@ client_destroy_rpc (xlator_t *this)
 {
         int          ret  = -1;
         clnt_conf_t *conf = NULL;
+        clnt_lane_t *lane = NULL;
+        int          i    = 0;
 
         conf = this->private;
         if (!conf)
                 goto out;
 
+        for (i = 1; i < conf->lane_count; i++) {
+                lane = &conf->lanes[i];
+                if (lane->rpc)
+                        rpc_clnt_unref (lane->rpc);
+                memset (lane, 0, sizeof (*lane));
+        }
+
         if (conf->rpc) {
                 conf->rpc = rpc_clnt_unref (conf->rpc);
+                memset (&conf->lanes[0], 0, sizeof (conf->lanes[0]));
+                conf->lane_count = 0;
                 ret = 0;
                 gf_log (this->name, GF_LOG_DEBUG,
                         "Client rpc conn destroyed");
@@ -1761,6 +1986,8 @@ client_init_rpc (xlator_t *this)
 {
         int          ret  = -1;
         clnt_conf_t *conf = NULL;
+        clnt_lane_t *lane = NULL;
+        int          i    = 0;
 
         conf = this->private;
 
@@ -1787,6 +2014,30 @@ client_init_rpc (xlator_t *this)
         if (ret)
                 goto out;
 
+        conf->lanes[0].rpc   = conf->rpc;
+        conf->lanes[0].this  = this;
+        conf->lanes[0].index = 0;
+        conf->lane_count     = 1;
+
+        for (i = 1; i < conf->opt.connection_count; i++) {
+                lane = &conf->lanes[i];
+
+                lane->rpc = rpc_clnt_new (&conf->rpc_conf, this->options,
+                                          this->ctx, this->name);
+                if (!lane->rpc) {
+                        gf_log (this->name, GF_LOG_WARNING,
+                                "failed to create connection %d, continuing "
+                                "with %d connection(s)", i, i);
+                        break;
+                }
+
+                lane->this  = this;
+                lane->index = i;
+                rpc_clnt_register_notify (lane->rpc, client_lane_notify, lane);
+
+                conf->lane_count++;
+        }
+
         ret = 0;
 
         gf_log (this->name, GF_LOG_DEBUG, "client init successful");
@@ -2037,11 +2288,17 @@ void
 fini (xlator_t *this)
 {
         clnt_conf_t *conf = NULL;
+        int          i    = 0;
 
         conf = this->private;
         this->private = NULL;
 
         if (conf) {
+                for (i = 1; i < conf->lane_count; i++) {
+                        if (conf->lanes[i].rpc)
+                                rpc_clnt_unref (conf->lanes[i].rpc);
+                }
+
                 if (conf->rpc)
                        rpc_clnt_unref (conf->rpc);
 
@@ -2061,7 +2318,9 @@ client_priv_dump (xlator_t *this)
         clnt_conf_t    *conf = NULL;
         int             ret   = -1;
         clnt_fd_ctx_t  *tmp = NULL;
+        clnt_lane_t    *lane = NULL;
         int             i = 0;
+        int             j = 0;
         char            key[GF_DUMP_MAX_BUF_LEN];
         char            key_prefix[GF_DUMP_MAX_BUF_LEN];
 
@@ -2109,6 +2368,38 @@ client_priv_dump (xlator_t *this)
                 gf_proc_dump_write(key, "%"PRIu64,
                                    conf->rpc->conn.trans->total_bytes_write);
         }
+
+        gf_proc_dump_build_key(key, key_prefix, "connection_count");
+        gf_proc_dump_write(key, "%d", conf->lane_count);
+
+        for (i = 0; i < conf->lane_count; i++) {
+                lane = &conf->lanes[i];
+                if (!lane->rpc || !lane->rpc->conn.trans)
+                        continue;
+
+                gf_proc_dump_build_key(key, key_prefix,
+                                       "connection.%d.attached", i);
+                gf_proc_dump_write(key, "%d", lane->attached);
+                gf_proc_dump_build_key(key, key_prefix,
+                                       "connection.%d.bytes_read", i);
+                gf_proc_dump_write(key, "%"PRIu64,
+                                   lane->rpc->conn.trans->total_bytes_read);
+                gf_proc_dump_build_key(key, key_prefix,
+                                       "connection.%d.bytes_written", i);
+                gf_proc_dump_write(key, "%"PRIu64,
+                                   lane->rpc->conn.trans->total_bytes_write);
+                gf_proc_dump_build_key(key, key_prefix,
+                                       "connection.%d.writev_calls", i);
+                gf_proc_dump_write(key, "%"PRIu64,
+                                   lane->rpc->conn.trans->total_writev_calls);
+                for (j = 0; j < RPC_TRANSPORT_BATCH_BUCKETS; j++) {
+                        gf_proc_dump_build_key(key, key_prefix,
+                                               "connection.%d.writev_batch.%d",
+                                               i, 1 << j);
+                        gf_proc_dump_write(key, "%"PRIu64,
+                                           lane->rpc->conn.trans->writev_batch[j]);
+                }
+        }
         pthread_mutex_unlock(&conf->lock);
 
         return 0;
@@ -2231,5 +2522,21 @@ struct volume_options options[] = {
           .min   = 1,
           .max   = 1013,
         },
+        { .key   = {"connection-count"},
+          .type  = GF_OPTION_TYPE_INT,
+          .min   = 1,
+          .max   = CLIENT_MAX_CONNECTIONS,
+          .description = "Number of connections to open to the brick. "
+                         "The first one carries metadata fops, fd based "
+                         "fops are spread over the others by fd."
+        },
+        { .key   = {GF_MAX_WRITE_SIZE_KEY},
+          .type  = GF_OPTION_TYPE_SIZET,
+          .min   = GF_MAX_WRITE_SIZE_DEFAULT,
+          .max   = GF_MAX_WRITE_SIZE_MAX,
+          .description = "Largest write payload the brick takes in one "
+                         "request, as set on its side. Translators packing "
+                         "writes together keep below it."
+        },
         { .key   = {NULL} },
 };
@@ -34,11 +34,33 @@
 #define CLIENT_CMD_CONNECT "trusted.glusterfs.client-connect"
 #define CLIENT_CMD_DISCONNECT "trusted.glusterfs.client-disconnect"
 #define CLIENT_DUMP_LOCKS "trusted.glusterfs.clientlk-dump"
+
+#define CLIENT_MAX_CONNECTIONS 8
+
 struct clnt_options {
         char *remote_subvolume;
         int   ping_timeout;
+        int   connection_count;
 };
 
+/* One transport to the brick. Lane 0 is the primary connection (conf->rpc):
+   it queries the portmapper, carries all loc based and metadata fops,
+   reopens fds and decides CHILD_UP/CHILD_DOWN. Lanes 1..n-1 only carry fd
+   based fops, hashed on the remote fd so that ordering per fd is kept.
+   All lanes send the same process-uuid, so the server shares one fdtable
+   and lock table between them. Each lane runs its own ping timer. */
+typedef struct clnt_lane {
+        struct rpc_clnt *rpc;
+        xlator_t        *this;
+        int              index;
+        char             started;   /* rpc_clnt_start () done */
+        char             connected; /* transport is up */
+        char             attached;  /* SETVOLUME succeeded */
+        char             drained;   /* nothing sent before attaching is
+                                       still in flight on the primary
+                                       connection */
+} clnt_lane_t;
+
 typedef struct clnt_conf {
         struct rpc_clnt       *rpc;
         struct clnt_options    opt;
@@ -59,6 +81,9 @@ typedef struct clnt_conf {
                                                    connection is established */
         gf_lock_t              rec_lock;
         int                    skip_notify;
+
+        int                    lane_count;
+        clnt_lane_t            lanes[CLIENT_MAX_CONNECTIONS];
 } clnt_conf_t;
 
 typedef struct _client_fd_ctx {
@@ -155,6 +180,17 @@ int client_submit_request (xlator_t *this, void *req,
                            struct iovec *rsphdr, int rsphdr_count,
                            struct iovec *rsp_payload, int rsp_count,
                            struct iobref *rsp_iobref);
+int client_submit_request_on (xlator_t *this, struct rpc_clnt *rpc, void *req,
+                              call_frame_t *frame, rpc_clnt_prog_t *prog,
+                              int procnum, fop_cbk_fn_t cbk,
+                              struct iobref *iobref, gfs_serialize_t sfunc,
+                              struct iovec *rsphdr, int rsphdr_count,
+                              struct iovec *rsp_payload, int rsp_count,
+                              struct iobref *rsp_iobref);
+struct rpc_clnt *client_lane_rpc (xlator_t *this, int64_t remote_fd);
+clnt_lane_t *client_rpc_to_lane (clnt_conf_t *conf, struct rpc_clnt *rpc);
+int client_lanes_start (xlator_t *this);
+int client_lanes_disconnect (xlator_t *this);
 
 int protocol_client_reopendir (xlator_t *this, clnt_fd_ctx_t *fdctx);
 int protocol_client_reopen (xlator_t *this, clnt_fd_ctx_t *fdctx);
@@ -32,8 +32,9 @@ void client_start_ping (void *data);
 rpc_clnt_prog_t clnt3_1_fop_prog;
 
 int
-client_submit_vec_request (xlator_t  *this, void *req, call_frame_t  *frame,
-                           rpc_clnt_prog_t *prog, int procnum, fop_cbk_fn_t cbk,
+client_submit_vec_request (xlator_t  *this, struct rpc_clnt *rpc, void *req,
+                           call_frame_t  *frame, rpc_clnt_prog_t *prog,
+                           int procnum, fop_cbk_fn_t cbk,
                            struct iovec  *payload, int payloadcnt,
                            struct iobref *iobref, gfs_serialize_t sfunc)
 {
@@ -44,6 +45,7 @@ client_submit_vec_request (xlator_t  *this, void *req, call_frame_t  *frame,
         int            count      = 0;
         int            start_ping = 0;
         struct iobref *new_iobref = NULL;
+        clnt_lane_t   *lane       = NULL;
 
         start_ping = 0;
 
@@ -90,22 +92,23 @@ client_submit_vec_request (xlator_t  *this, void *req, call_frame_t  *frame,
                 count = 1;
         }
         /* Send the msg */
-        ret = rpc_clnt_submit (conf->rpc, prog, procnum, cbk, &iov, count,
+        ret = rpc_clnt_submit (rpc, prog, procnum, cbk, &iov, count,
                                payload, payloadcnt, new_iobref, frame, NULL, 0,
                                NULL, 0, NULL);
 
         if (ret == 0) {
-                pthread_mutex_lock (&conf->rpc->conn.lock);
+                pthread_mutex_lock (&rpc->conn.lock);
                 {
-                        if (!conf->rpc->conn.ping_started) {
+                        if (!rpc->conn.ping_started) {
                                 start_ping = 1;
                         }
                 }
-                pthread_mutex_unlock (&conf->rpc->conn.lock);
+                pthread_mutex_unlock (&rpc->conn.lock);
         }
 
-        if (start_ping)
-                client_start_ping ((void *) this);
+        lane = client_rpc_to_lane (conf, rpc);
+        if (start_ping && lane)
+                client_start_ping ((void *) lane);
 
 out:
         if (new_iobref != NULL) {
@@ -2058,19 +2061,21 @@ client_fdctx_destroy (xlator_t *this, clnt_fd_ctx_t *fdctx)
         if (fdctx->is_dir) {
                 gfs3_releasedir_req  req = {{0,},};
                 req.fd = fdctx->remote_fd;
-                ret = client_submit_request (this, &req, fr, &clnt3_1_fop_prog,
-                                             GFS3_OP_RELEASEDIR,
-                                             client3_1_releasedir_cbk,
-                                             NULL, xdr_from_releasedir_req,
-                                             NULL, 0, NULL, 0, NULL);
+                ret = client_submit_request_on (this, client_lane_rpc (this, req.fd),
+                                                &req, fr, &clnt3_1_fop_prog,
+                                                GFS3_OP_RELEASEDIR,
+                                                client3_1_releasedir_cbk,
+                                                NULL, xdr_from_releasedir_req,
+                                                NULL, 0, NULL, 0, NULL);
         } else {
                 gfs3_release_req  req = {{0,},};
                 req.fd = fdctx->remote_fd;
-                ret = client_submit_request (this, &req, fr, &clnt3_1_fop_prog,
-                                             GFS3_OP_RELEASE,
-                                             client3_1_release_cbk, NULL,
-                                             xdr_from_release_req, NULL, 0,
-                                             NULL, 0, NULL);
+                ret = client_submit_request_on (this, client_lane_rpc (this, req.fd),
+                                                &req, fr, &clnt3_1_fop_prog,
+                                                GFS3_OP_RELEASE,
+                                                client3_1_release_cbk, NULL,
+                                                xdr_from_release_req, NULL, 0,
+                                                NULL, 0, NULL);
         }
 
 out:
@@ -2124,11 +2129,12 @@ client3_1_releasedir (call_frame_t *frame, xlator_t *this,
 
         if (remote_fd != -1) {
                 req.fd = remote_fd;
-                ret = client_submit_request (this, &req, frame, conf->fops,
-                                             GFS3_OP_RELEASEDIR,
-                                             client3_1_releasedir_cbk,
-                                             NULL, xdr_from_releasedir_req,
-                                             NULL, 0, NULL, 0, NULL);
+                ret = client_submit_request_on (this, client_lane_rpc (this, req.fd),
+                                                &req, frame, conf->fops,
+                                                GFS3_OP_RELEASEDIR,
+                                                client3_1_releasedir_cbk,
+                                                NULL, xdr_from_releasedir_req,
+                                                NULL, 0, NULL, 0, NULL);
                 inode_unref (fdctx->inode);
                 GF_FREE (fdctx);
         }
@@ -2181,11 +2187,12 @@ client3_1_release (call_frame_t *frame, xlator_t *this,
 
                 delete_granted_locks_fd (fdctx);
 
-                ret = client_submit_request (this, &req, frame, conf->fops,
-                                             GFS3_OP_RELEASE,
-                                             client3_1_release_cbk, NULL,
-                                             xdr_from_release_req, NULL, 0,
-                                             NULL, 0, NULL);
+                ret = client_submit_request_on (this, client_lane_rpc (this, req.fd),
+                                                &req, frame, conf->fops,
+                                                GFS3_OP_RELEASE,
+                                                client3_1_release_cbk, NULL,
+                                                xdr_from_release_req, NULL, 0,
+                                                NULL, 0, NULL);
                 inode_unref (fdctx->inode);
                 GF_FREE (fdctx);
         }
@@ -2447,11 +2454,12 @@ client3_1_ftruncate (call_frame_t *frame, xlator_t *this,
         req.offset = args->offset;
         req.fd     = fdctx->remote_fd;
 
-        ret = client_submit_request (this, &req, frame, conf->fops,
-                                     GFS3_OP_FTRUNCATE,
-                                     client3_1_ftruncate_cbk, NULL,
-                                     xdr_from_ftruncate_req, NULL, 0, NULL, 0,
-                                     NULL);
+        ret = client_submit_request_on (this, client_lane_rpc (this, req.fd),
+                                        &req, frame, conf->fops,
+                                        GFS3_OP_FTRUNCATE,
+                                        client3_1_ftruncate_cbk, NULL,
+                                        xdr_from_ftruncate_req, NULL, 0, NULL, 0,
+                                        NULL);
         if (ret) {
                 op_errno = ENOTCONN;
                 goto unwind;
@@ -3174,10 +3182,11 @@ client3_1_readv (call_frame_t *frame, xlator_t *this,
         rsp_iobref = NULL;
         frame->local = local;
 
-        ret = client_submit_request (this, &req, frame, conf->fops,
-                                     GFS3_OP_READ, client3_1_readv_cbk, NULL,
-                                     xdr_from_readv_req, NULL, 0, &rsp_vec, 1,
-                                     local->iobref);
+        ret = client_submit_request_on (this, client_lane_rpc (this, req.fd),
+                                        &req, frame, conf->fops,
+                                        GFS3_OP_READ, client3_1_readv_cbk, NULL,
+                                        xdr_from_readv_req, NULL, 0, &rsp_vec, 1,
+                                        local->iobref);
         if (ret) {
                 op_errno = ENOTCONN;
                 goto unwind;
@@ -3239,7 +3248,8 @@ client3_1_writev (call_frame_t *frame, xlator_t *this, void *data)
         req.offset = args->offset;
         req.fd     = fdctx->remote_fd;
 
-        ret = client_submit_vec_request (this, &req, frame, conf->fops, GFS3_OP_WRITE,
+        ret = client_submit_vec_request (this, client_lane_rpc (this, req.fd),
+                                         &req, frame, conf->fops, GFS3_OP_WRITE,
                                          client3_1_writev_cbk,
                                          args->vector, args->count,
                                          args->iobref, xdr_from_writev_req);
@@ -3309,10 +3319,11 @@ client3_1_flush (call_frame_t *frame, xlator_t *this,
 
         req.fd = fdctx->remote_fd;
 
-        ret = client_submit_request (this, &req, frame, conf->fops,
-                                     GFS3_OP_FLUSH, client3_1_flush_cbk, NULL,
-                                     xdr_from_flush_req, NULL, 0, NULL, 0,
-                                     NULL);
+        ret = client_submit_request_on (this, client_lane_rpc (this, req.fd),
+                                        &req, frame, conf->fops,
+                                        GFS3_OP_FLUSH, client3_1_flush_cbk, NULL,
+                                        xdr_from_flush_req, NULL, 0, NULL, 0,
+                                        NULL);
         if (ret) {
                 op_errno = ENOTCONN;
                 goto unwind;
@@ -3366,10 +3377,11 @@ client3_1_fsync (call_frame_t *frame, xlator_t *this,
         req.fd   = fdctx->remote_fd;
         req.data = args->flags;
 
-        ret = client_submit_request (this, &req, frame, conf->fops,
-                                     GFS3_OP_FSYNC, client3_1_fsync_cbk, NULL,
-                                     xdr_from_fsync_req, NULL, 0, NULL, 0,
-                                     NULL);
+        ret = client_submit_request_on (this, client_lane_rpc (this, req.fd),
+                                        &req, frame, conf->fops,
+                                        GFS3_OP_FSYNC, client3_1_fsync_cbk, NULL,
+                                        xdr_from_fsync_req, NULL, 0, NULL, 0,
+                                        NULL);
         if (ret) {
                 op_errno = ENOTCONN;
                 goto unwind;
@@ -3422,10 +3434,11 @@ client3_1_fstat (call_frame_t *frame, xlator_t *this,
 
         req.fd = fdctx->remote_fd;
 
-        ret = client_submit_request (this, &req, frame, conf->fops,
-                                     GFS3_OP_FSTAT, client3_1_fstat_cbk, NULL,
-                                     xdr_from_fstat_req, NULL, 0, NULL, 0,
-                                     NULL);
+        ret = client_submit_request_on (this, client_lane_rpc (this, req.fd),
+                                        &req, frame, conf->fops,
+                                        GFS3_OP_FSTAT, client3_1_fstat_cbk, NULL,
+                                        xdr_from_fstat_req, NULL, 0, NULL, 0,
+                                        NULL);
         if (ret) {
                 op_errno = ENOTCONN;
                 goto unwind;
@@ -3533,10 +3546,11 @@ client3_1_fsyncdir (call_frame_t *frame, xlator_t *this, void *data)
 
         conf = this->private;
 
-        ret = client_submit_request (this, &req, frame, conf->fops,
-                                     GFS3_OP_FSYNCDIR, client3_1_fsyncdir_cbk,
-                                     NULL, xdr_from_fsyncdir_req, NULL, 0,
-                                     NULL, 0, NULL);
+        ret = client_submit_request_on (this, client_lane_rpc (this, req.fd),
+                                        &req, frame, conf->fops,
+                                        GFS3_OP_FSYNCDIR, client3_1_fsyncdir_cbk,
+                                        NULL, xdr_from_fsyncdir_req, NULL, 0,
+                                        NULL, 0, NULL);
         if (ret) {
                 op_errno = ENOTCONN;
                 goto unwind;
@@ -3707,10 +3721,11 @@ client3_1_fsetxattr (call_frame_t *frame, xlator_t *this,
                 req.dict.dict_len = dict_len;
         }
 
-        ret = client_submit_request (this, &req, frame, conf->fops,
-                                     GFS3_OP_FSETXATTR, client3_1_fsetxattr_cbk,
-                                     NULL, xdr_from_fsetxattr_req, NULL, 0,
-                                     NULL, 0, NULL);
+        ret = client_submit_request_on (this, client_lane_rpc (this, req.fd),
+                                        &req, frame, conf->fops,
+                                        GFS3_OP_FSETXATTR, client3_1_fsetxattr_cbk,
+                                        NULL, xdr_from_fsetxattr_req, NULL, 0,
+                                        NULL, 0, NULL);
         if (ret) {
                 op_errno = ENOTCONN;
                 goto unwind;
@@ -3820,11 +3835,12 @@ client3_1_fgetxattr (call_frame_t *frame, xlator_t *this,
                 req.namelen = 0;
         }
 
-        ret = client_submit_request (this, &req, frame, conf->fops,
-                                     GFS3_OP_FGETXATTR,
-                                     client3_1_fgetxattr_cbk, NULL,
-                                     xdr_from_fgetxattr_req, rsphdr, count,
-                                     NULL, 0, local->iobref);
+        ret = client_submit_request_on (this, client_lane_rpc (this, req.fd),
+                                        &req, frame, conf->fops,
+                                        GFS3_OP_FGETXATTR,
+                                        client3_1_fgetxattr_cbk, NULL,
+                                        xdr_from_fgetxattr_req, rsphdr, count,
+                                        NULL, 0, local->iobref);
         if (ret) {
                 op_errno = ENOTCONN;
                 goto unwind;
@@ -4200,11 +4216,12 @@ client3_1_fxattrop (call_frame_t *frame, xlator_t *this,
                 req.dict.dict_len = dict_len;
         }
 
-        ret = client_submit_request (this, &req, frame, conf->fops,
-                                     GFS3_OP_FXATTROP,
-                                     client3_1_fxattrop_cbk, NULL,
-                                     xdr_from_fxattrop_req, rsphdr, count,
-                                     NULL, 0, local->iobref);
+        ret = client_submit_request_on (this, client_lane_rpc (this, req.fd),
+                                        &req, frame, conf->fops,
+                                        GFS3_OP_FXATTROP,
+                                        client3_1_fxattrop_cbk, NULL,
+                                        xdr_from_fxattrop_req, rsphdr, count,
+                                        NULL, 0, local->iobref);
         if (ret) {
                 op_errno = ENOTCONN;
                 goto unwind;
@@ -4358,9 +4375,10 @@ client3_1_lk (call_frame_t *frame, xlator_t *this,
         req.type  = gf_type;
         gf_proto_flock_from_flock (&req.flock, args->flock);
 
-        ret = client_submit_request (this, &req, frame, conf->fops, GFS3_OP_LK,
-                                     client3_1_lk_cbk, NULL, xdr_from_lk_req,
-                                     NULL, 0, NULL, 0, NULL);
+        ret = client_submit_request_on (this, client_lane_rpc (this, req.fd),
+                                        &req, frame, conf->fops, GFS3_OP_LK,
+                                        client3_1_lk_cbk, NULL, xdr_from_lk_req,
+                                        NULL, 0, NULL, 0, NULL);
         if (ret) {
                 op_errno = ENOTCONN;
                 goto unwind;
@@ -4514,11 +4532,12 @@ client3_1_finodelk (call_frame_t *frame, xlator_t *this,
         req.type  = gf_type;
         gf_proto_flock_from_flock (&req.flock, args->flock);
 
-        ret = client_submit_request (this, &req, frame, conf->fops,
-                                     GFS3_OP_FINODELK,
-                                     client3_1_finodelk_cbk, NULL,
-                                     xdr_from_finodelk_req, NULL, 0, NULL, 0,
-                                     NULL);
+        ret = client_submit_request_on (this, client_lane_rpc (this, req.fd),
+                                        &req, frame, conf->fops,
+                                        GFS3_OP_FINODELK,
+                                        client3_1_finodelk_cbk, NULL,
+                                        xdr_from_finodelk_req, NULL, 0, NULL, 0,
+                                        NULL);
         if (ret) {
                 op_errno = ENOTCONN;
                 goto unwind;
@@ -4628,11 +4647,12 @@ client3_1_fentrylk (call_frame_t *frame, xlator_t *this,
                 req.namelen = 1;
         }
 
-        ret = client_submit_request (this, &req, frame, conf->fops,
-                                     GFS3_OP_FENTRYLK,
-                                     client3_1_fentrylk_cbk, NULL,
-                                     xdr_from_fentrylk_req, NULL, 0, NULL, 0,
-                                     NULL);
+        ret = client_submit_request_on (this, client_lane_rpc (this, req.fd),
+                                        &req, frame, conf->fops,
+                                        GFS3_OP_FENTRYLK,
+                                        client3_1_fentrylk_cbk, NULL,
+                                        xdr_from_fentrylk_req, NULL, 0, NULL, 0,
+                                        NULL);
         if (ret) {
                 op_errno = ENOTCONN;
                 goto unwind;
@@ -4687,11 +4707,12 @@ client3_1_rchecksum (call_frame_t *frame, xlator_t *this,
         req.offset = args->offset;
         req.fd     = fdctx->remote_fd;
 
-        ret = client_submit_request (this, &req, frame, conf->fops,
-                                     GFS3_OP_RCHECKSUM,
-                                     client3_1_rchecksum_cbk, NULL,
-                                     xdr_from_rchecksum_req, NULL, 0, NULL,
-                                     0, NULL);
+        ret = client_submit_request_on (this, client_lane_rpc (this, req.fd),
+                                        &req, frame, conf->fops,
+                                        GFS3_OP_RCHECKSUM,
+                                        client3_1_rchecksum_cbk, NULL,
+                                        xdr_from_rchecksum_req, NULL, 0, NULL,
+                                        0, NULL);
         if (ret) {
                 op_errno = ENOTCONN;
                 goto unwind;
@@ -4795,11 +4816,12 @@ client3_1_readdir (call_frame_t *frame, xlator_t *this,
         req.offset = args->offset;
         req.fd = fdctx->remote_fd;
 
-        ret = client_submit_request (this, &req, frame, conf->fops,
-                                     GFS3_OP_READDIR,
-                                     client3_1_readdir_cbk, NULL,
-                                     xdr_from_readdir_req, rsphdr, count,
-                                     NULL, 0, rsp_iobref);
+        ret = client_submit_request_on (this, client_lane_rpc (this, req.fd),
+                                        &req, frame, conf->fops,
+                                        GFS3_OP_READDIR,
+                                        client3_1_readdir_cbk, NULL,
+                                        xdr_from_readdir_req, rsphdr, count,
+                                        NULL, 0, rsp_iobref);
         rsp_iobref = NULL;
 
         if (ret) {
@@ -4919,11 +4941,12 @@ client3_1_readdirp (call_frame_t *frame, xlator_t *this,
         req.offset = args->offset;
         req.fd = fdctx->remote_fd;
 
-        ret = client_submit_request (this, &req, frame, conf->fops,
-                                     GFS3_OP_READDIRP,
-                                     client3_1_readdirp_cbk, NULL,
-                                     xdr_from_readdirp_req, rsphdr, count, NULL,
-                                     0, rsp_iobref);
+        ret = client_submit_request_on (this, client_lane_rpc (this, req.fd),
+                                        &req, frame, conf->fops,
+                                        GFS3_OP_READDIRP,
+                                        client3_1_readdirp_cbk, NULL,
+                                        xdr_from_readdirp_req, rsphdr, count, NULL,
+                                        0, rsp_iobref);
         if (ret) {
                 op_errno = ENOTCONN;
                 goto unwind;
@@ -5030,11 +5053,12 @@ client3_1_fsetattr (call_frame_t *frame, xlator_t *this, void *data)
         req.valid = args->valid;
         gf_stat_from_iatt (&req.stbuf, args->stbuf);
 
-        ret = client_submit_request (this, &req, frame, conf->fops,
-                                     GFS3_OP_FSETATTR,
-                                     client3_1_fsetattr_cbk, NULL,
-                                     xdr_from_fsetattr_req, NULL, 0, NULL, 0,
-                                     NULL);
+        ret = client_submit_request_on (this, client_lane_rpc (this, req.fd),
+                                        &req, frame, conf->fops,
+                                        GFS3_OP_FSETATTR,
+                                        client3_1_fsetattr_cbk, NULL,
+                                        xdr_from_fsetattr_req, NULL, 0, NULL, 0,
+                                        NULL);
         if (ret) {
                 op_errno = ENOTCONN;
                 goto unwind;
@@ -238,6 +238,8 @@ server_priv (xlator_t *this)
         char              key[GF_DUMP_MAX_BUF_LEN] = {0,};
         uint64_t          total_read = 0;
         uint64_t          total_write = 0;
+        int               i = 0;
+        int               j = 0;
 
         conf = this->private;
         if (!conf)
@@ -254,6 +256,22 @@ server_priv (xlator_t *this)
         gf_proc_dump_build_key(key, "server", "total-bytes-write");
         gf_proc_dump_write(key, "%"PRIu64, total_write);
 
+        list_for_each_entry (xprt, &conf->xprt_list, list) {
+                gf_proc_dump_build_key(key, "server", "xprt.%d.peer", i);
+                gf_proc_dump_write(key, "%s", xprt->peerinfo.identifier);
+                gf_proc_dump_build_key(key, "server", "xprt.%d.writev-calls",
+                                       i);
+                gf_proc_dump_write(key, "%"PRIu64, xprt->total_writev_calls);
+                for (j = 0; j < RPC_TRANSPORT_BATCH_BUCKETS; j++) {
+                        gf_proc_dump_build_key(key, "server",
+                                               "xprt.%d.writev-batch.%d",
+                                               i, 1 << j);
+                        gf_proc_dump_write(key, "%"PRIu64,
+                                           xprt->writev_batch[j]);
+                }
+                i++;
+        }
+
         return 0;
 }
 
@@ -2430,18 +2430,27 @@ __posix_writev (int fd, struct iovec *vector, int count, off_t startoff,
                         max_buf_size = vector[idx].iov_len;
         }
 
-        alloc_buf = GF_MALLOC (1 * (max_buf_size + align), gf_posix_mt_char);
-        if (!alloc_buf) {
-                op_ret = -errno;
-                goto err;
-        }
-
         internal_off = startoff;
         for (idx = 0; idx < count; idx++) {
-                /* page aligned buffer */
-                buf = ALIGN_BUF (alloc_buf, align);
+                /* payloads received into their own iobuf are already
+                   page aligned, only bounce the ones which are not */
+                if (!((unsigned long) vector[idx].iov_base % align)
+                    && !(vector[idx].iov_len % align)) {
+                        buf = vector[idx].iov_base;
+                } else {
+                        if (!alloc_buf) {
+                                alloc_buf = GF_MALLOC (max_buf_size + align,
+                                                       gf_posix_mt_char);
+                                if (!alloc_buf) {
+                                        op_ret = -errno;
+                                        goto err;
+                                }
+                        }
 
-                memcpy (buf, vector[idx].iov_base, vector[idx].iov_len);
+                        buf = ALIGN_BUF (alloc_buf, align);
+                        memcpy (buf, vector[idx].iov_base,
+                                vector[idx].iov_len);
+                }
 
                 /* not sure whether writev works on O_DIRECT'd fd */
                 retval = pwrite (fd, buf, vector[idx].iov_len, internal_off);
@@ -3506,11 +3515,28 @@ __add_array (int32_t *dest, int32_t *src, int count)
 }
 
 
+/**
+ * add_array64 - same as add_array, for 64-bit numbers
+ * @count: number of 64-bit numbers
+ */
+
+static void
+__add_array64 (int64_t *dest, int64_t *src, int count)
+{
+	int i = 0;
+	for (i = 0; i < count; i++) {
+		dest[i] = hton64 (ntoh64 (dest[i]) + ntoh64 (src[i]));
+	}
+}
+
+
 /**
  * xattrop - xattr operations - for internal use by GlusterFS
  * @optype: ADD_ARRAY:
  *            dict should contain:
  *               "key" ==> array of 32-bit numbers
+ *          ADD_ARRAY64:
+ *               "key" ==> array of 64-bit numbers
  */
 
 int
@@ -3612,6 +3638,12 @@ do_xattrop (call_frame_t *frame, xlator_t *this,
                                              trav->value->len / 4);
                                 break;
 
+                        case GF_XATTROP_ADD_ARRAY64:
+                                __add_array64 ((int64_t *) array,
+                                               (int64_t *) trav->value->data,
+                                               trav->value->len / 8);
+                                break;
+
                         default:
                                 gf_log (this->name, GF_LOG_ERROR,
                                         "Unknown xattrop type (%d) on %s. Please send "